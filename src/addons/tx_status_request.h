@@ -7,6 +7,7 @@
 #include "../platform/m256.h"
 #include "../platform/debugging.h"
 #include "../platform/memory_util.h"
+#include "../platform/virtual_memory.h"
 
 #include "../network_messages/header.h"
 #include "../network_messages/network_message_type.h"
@@ -23,20 +24,52 @@ typedef struct
     m256i digest;
 } ConfirmedTx;
 
-constexpr unsigned long long confirmedTxCurrentEpochLength = (((unsigned long long)MAX_NUMBER_OF_TICKS_PER_EPOCH) * NUMBER_OF_TRANSACTIONS_PER_TICK);
-constexpr unsigned long long confirmedTxPreviousEpochLength = (((unsigned long long)TICKS_TO_KEEP_FROM_PRIOR_EPOCH) * NUMBER_OF_TRANSACTIONS_PER_TICK);
-constexpr unsigned long long confirmedTxLength = confirmedTxCurrentEpochLength + confirmedTxPreviousEpochLength;
-
-// Memory to store confirmed TX's (arrays store data of current epoch, followed by last ticks of previous epoch)
-static ConfirmedTx *confirmedTx = NULL;
+// Confirmed TX's are appended to a store that is paged to disk, so only actually executed TX's take space and only
+// the most recent pages are kept in RAM. The store isn't reset at the epoch transition, so the ticks kept from the
+// previous epoch stay where they are. Pages before the first kept tick are pruned from disk at the epoch transition.
+#ifdef NO_UEFI
+#define TEXT_CONF_AS_NUMBER 0
+#define TEXT_TXST_AS_NUMBER 0
+#else
+#define TEXT_CONF_AS_NUMBER 28710920078164067ULL // L"conf"
+#define TEXT_TXST_AS_NUMBER 32651591227539572ULL // L"txst"
+#endif
+constexpr unsigned long long confirmedTxPageCapacity = 65536;
+constexpr unsigned long long confirmedTxNumCachePages = 16;
+static VirtualMemory<ConfirmedTx, TEXT_CONF_AS_NUMBER, TEXT_TXST_AS_NUMBER, confirmedTxPageCapacity, confirmedTxNumCachePages> confirmedTxStore;
 static volatile char confirmedTxLock = 0;
 
+#if ADDON_TX_STATUS_INDEX
+// Hash map digest -> (tick, moneyFlew) of the TX's stored for the current epoch and the ticks kept from the previous
+// epoch (open addressing with linear probing). It is only written by the tick processor (under confirmedTxLock) and
+// read lock-free by the request processors. An entry is used if its generation matches
+// txStatusData.confirmedTxIndexGeneration, which is incremented at the epoch transition instead of clearing the index.
+// When an entry is (re)used, generation is reset before and written after the other fields.
+struct ConfirmedTxIndexEntry
+{
+    volatile m256i digest;
+    volatile unsigned int tick;
+    volatile unsigned short moneyFlew;
+    volatile unsigned short generation;
+};
+
+static_assert((TX_STATUS_INDEX_CAPACITY & (TX_STATUS_INDEX_CAPACITY - 1)) == 0, "TX_STATUS_INDEX_CAPACITY must be power of 2");
+constexpr unsigned long long confirmedTxIndexMaxEntries = TX_STATUS_INDEX_CAPACITY / 8 * 7;
+static ConfirmedTxIndexEntry* confirmedTxIndex = NULL;
+#endif
+
 static struct
 {
     unsigned int tickTxCounter[MAX_NUMBER_OF_TICKS_PER_EPOCH + TICKS_TO_KEEP_FROM_PRIOR_EPOCH];    // store the amount of tx per tick
-    unsigned int tickTxIndexStart[MAX_NUMBER_OF_TICKS_PER_EPOCH + TICKS_TO_KEEP_FROM_PRIOR_EPOCH]; // store the index position per tick
+    unsigned int tickTxIndexStart[MAX_NUMBER_OF_TICKS_PER_EPOCH + TICKS_TO_KEEP_FROM_PRIOR_EPOCH]; // store the index position per tick (relative to store begin of epoch)
     unsigned int confirmedTxPreviousEpochBeginTick;  // first tick kept from previous epoch (or 0 if no tick from prev. epoch available)
     unsigned int confirmedTxCurrentEpochBeginTick;   // first tick of current epoch stored
+    unsigned long long confirmedTxPreviousEpochStoreBegin; // index of first TX of previous epoch in confirmedTxStore
+    unsigned long long confirmedTxCurrentEpochStoreBegin;  // index of first TX of current epoch in confirmedTxStore
+    unsigned long long confirmedTxPrunedPages;       // number of pages of confirmedTxStore that have been removed from disk
+    unsigned long long confirmedTxIndexEntries;      // number of used entries in confirmedTxIndex
+    unsigned long long confirmedTxIndexDroppedTxs;   // number of TX's not added to confirmedTxIndex because it was full
+    unsigned short confirmedTxIndexGeneration;       // generation of the used entries in confirmedTxIndex (never 0)
 } txStatusData;
 
 
@@ -78,17 +111,131 @@ struct RespondTxStatus
 #pragma pack(pop)
 static RespondTxStatus* tickTxStatusStorage = NULL;
 
+
+#if ADDON_TX_STATUS_INDEX
+// Request status of up to maxDigests TX's given by digest
+struct RequestTxStatusBatch
+{
+    static constexpr unsigned int maxDigests = 256;
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::REQUEST_TX_STATUS_BATCH;
+    }
+
+    unsigned int digestCount;
+    unsigned int _padding;
+
+    // only digestCount digests are sent with this message
+    m256i digests[maxDigests];
+
+    // return size of message with digestCount digests
+    unsigned int size() const
+    {
+        return offsetof(RequestTxStatusBatch, digests) + digestCount * sizeof(m256i);
+    }
+};
+
+// Status of the requested TX's in order of the request. A tick of 0 means that the TX hasn't been executed in the
+// ticks available in the node (it may be pending, invalid, or in a tick that isn't stored anymore).
+struct RespondTxStatusBatch
+{
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_TX_STATUS_BATCH;
+    }
+
+    unsigned int currentTickOfNode;
+    unsigned int digestCount;
+    unsigned int ticks[RequestTxStatusBatch::maxDigests];
+    unsigned char moneyFlew[(RequestTxStatusBatch::maxDigests + 7) / 8];
+};
+
+static_assert(sizeof(RespondTxStatusBatch) == 8 + 4 * RequestTxStatusBatch::maxDigests + RequestTxStatusBatch::maxDigests / 8, "unexpected size");
+
+
+// Get first slot of digest in confirmedTxIndex
+static inline unsigned long long getConfirmedTxIndexSlot(const m256i& digest)
+{
+    return digest.m256i_u64[1] & (TX_STATUS_INDEX_CAPACITY - 1);
+}
+
+// Add TX to index (only tick processor with confirmedTxLock or while request processors are halted).
+// If the digest is already in the index, the entry is updated. Returns false if the index is full.
+static bool addConfirmedTxToIndex(const m256i& digest, unsigned int tick, bool moneyFlew)
+{
+    ASSERT(tick);
+    const unsigned short generation = txStatusData.confirmedTxIndexGeneration;
+    unsigned long long slot = getConfirmedTxIndexSlot(digest);
+    while (confirmedTxIndex[slot].generation == generation && confirmedTxIndex[slot].digest != digest)
+        slot = (slot + 1) & (TX_STATUS_INDEX_CAPACITY - 1);
+
+    ConfirmedTxIndexEntry& entry = confirmedTxIndex[slot];
+    if (entry.generation != generation)
+    {
+        if (txStatusData.confirmedTxIndexEntries >= confirmedTxIndexMaxEntries)
+            return false;
+        ++txStatusData.confirmedTxIndexEntries;
+        entry.generation = 0;
+        entry.digest = digest;
+        entry.moneyFlew = moneyFlew;
+        entry.tick = tick;
+        entry.generation = generation;
+    }
+    else
+    {
+        entry.moneyFlew = moneyFlew;
+        entry.tick = tick;
+    }
+    return true;
+}
+
+// Look up TX in index (can be called from any processor). Returns tick of TX or 0 if it isn't in the index.
+static unsigned int findConfirmedTxInIndex(const m256i& digest, bool& moneyFlew)
+{
+    const unsigned short generation = txStatusData.confirmedTxIndexGeneration;
+    unsigned long long slot = getConfirmedTxIndexSlot(digest);
+    while (true)
+    {
+        const ConfirmedTxIndexEntry& entry = confirmedTxIndex[slot];
+        if (entry.generation != generation)
+            return 0;
+        if (entry.digest == digest)
+        {
+            const unsigned int tick = entry.tick;
+            moneyFlew = entry.moneyFlew;
+
+            // the entry may have been reused by the tick processor while reading it
+            return (entry.generation == generation) ? tick : 0;
+        }
+        slot = (slot + 1) & (TX_STATUS_INDEX_CAPACITY - 1);
+    }
+}
+#endif
+
+
 // Allocate buffers
 static bool initTxStatusRequestAddOn()
 {
-    // Allocate pool to store confirmed TX's
-    if (!allocPoolWithErrorLog(L"confirmedTx", confirmedTxLength * sizeof(ConfirmedTx), (void**)&confirmedTx, __LINE__))
+    // Init paged store of confirmed TX's
+    if (!confirmedTxStore.init())
+        return false;
+#if ADDON_TX_STATUS_INDEX
+    // Allocate index digest -> tx status
+    if (!allocPoolWithErrorLog(L"confirmedTxIndex", TX_STATUS_INDEX_CAPACITY * sizeof(ConfirmedTxIndexEntry), (void**)&confirmedTxIndex, __LINE__))
         return false;
+#endif
     // allocate tickTxStatus responses storage
     if (!allocPoolWithErrorLog(L"tickTxStatusStorage", MAX_NUMBER_OF_PROCESSORS * sizeof(RespondTxStatus), (void**)&tickTxStatusStorage, __LINE__))
         return false;
     txStatusData.confirmedTxPreviousEpochBeginTick = 0;
     txStatusData.confirmedTxCurrentEpochBeginTick = 0;
+    txStatusData.confirmedTxPreviousEpochStoreBegin = 0;
+    txStatusData.confirmedTxCurrentEpochStoreBegin = 0;
+    txStatusData.confirmedTxPrunedPages = 0;
+    txStatusData.confirmedTxIndexEntries = 0;
+    txStatusData.confirmedTxIndexDroppedTxs = 0;
+    txStatusData.confirmedTxIndexGeneration = 1; // entries of the zeroed index are unused
     return true;
 }
 
@@ -96,8 +243,19 @@ static bool initTxStatusRequestAddOn()
 // Free buffers
 static void deinitTxStatusRequestAddOn()
 {
-    if (confirmedTx)
-        freePool(confirmedTx);
+    confirmedTxStore.deinit();
+#if ADDON_TX_STATUS_INDEX
+    if (confirmedTxIndex)
+    {
+        freePool(confirmedTxIndex);
+        confirmedTxIndex = NULL;
+    }
+#endif
+    if (tickTxStatusStorage)
+    {
+        freePool(tickTxStatusStorage);
+        tickTxStatusStorage = NULL;
+    }
 }
 
 
@@ -108,47 +266,53 @@ static void beginEpochTxStatusRequestAddOn(unsigned int newInitialTick)
     unsigned int& tickBegin = txStatusData.confirmedTxCurrentEpochBeginTick;
     unsigned int& oldTickBegin = txStatusData.confirmedTxPreviousEpochBeginTick;
 
+    // all entries of the index become unused by switching to the next generation
+    if (!++txStatusData.confirmedTxIndexGeneration)
+        txStatusData.confirmedTxIndexGeneration = 1;
+    txStatusData.confirmedTxIndexEntries = 0;
+    txStatusData.confirmedTxIndexDroppedTxs = 0;
+
     bool keepTicks = tickBegin && newInitialTick > tickBegin && newInitialTick <= tickBegin + MAX_NUMBER_OF_TICKS_PER_EPOCH;
     if (keepTicks)
     {
         // Seamless epoch transition: keep some ticks of prior epoch
         // The number of ticks to keep is limited by:
         // - the length of the previous epoch tick buffer (tickCount < TICKS_TO_KEEP_FROM_PRIOR_EPOCH)
-        // - the length of the previous epoch confirmedTx array (confirmedTxPreviousEpochLength)
         // - the number of ticks available from in ended epoch (tickIndex >= 0)
-        unsigned int tickCount = 0;
-        unsigned int txCount = 0;
-        for (int tickIndex = (newInitialTick - 1) - tickBegin; tickIndex >= 0; --tickIndex)
-        {
-            unsigned int newTxCount = txCount + txStatusData.tickTxCounter[tickIndex];
-            if (newTxCount <= confirmedTxPreviousEpochLength && tickCount < TICKS_TO_KEEP_FROM_PRIOR_EPOCH)
-            {
-                txCount = newTxCount;
-                ++tickCount;
-            }
-            else
-            {
-                break;
-            }
-        }
-
+        const unsigned int tickCount = (newInitialTick - tickBegin < TICKS_TO_KEEP_FROM_PRIOR_EPOCH) ? newInitialTick - tickBegin : TICKS_TO_KEEP_FROM_PRIOR_EPOCH;
         oldTickBegin = newInitialTick - tickCount;
-        const unsigned int oldTickEnd = newInitialTick;
         const unsigned int tickIndex = oldTickBegin - tickBegin;
 
-        // copy confirmedTx and tickTxCounter from recently ended epoch into storage of previous epoch
+        // copy tickTxCounter and tickTxIndexStart from recently ended epoch into storage of previous epoch
+        // (the TX's stay in confirmedTxStore, indices are relative to store begin of the epoch)
         copyMem(txStatusData.tickTxCounter + MAX_NUMBER_OF_TICKS_PER_EPOCH, txStatusData.tickTxCounter + tickIndex, tickCount * sizeof(txStatusData.tickTxCounter[0]));
-        copyMem(confirmedTx + confirmedTxCurrentEpochLength, confirmedTx + txStatusData.tickTxIndexStart[tickIndex], txCount * sizeof(confirmedTx[0]));
+        copyMem(txStatusData.tickTxIndexStart + MAX_NUMBER_OF_TICKS_PER_EPOCH, txStatusData.tickTxIndexStart + tickIndex, tickCount * sizeof(txStatusData.tickTxIndexStart[0]));
+        txStatusData.confirmedTxPreviousEpochStoreBegin = txStatusData.confirmedTxCurrentEpochStoreBegin;
 
-        // copy adjusted tickTxIndexStart
-        const unsigned int indexStartDelta = confirmedTxCurrentEpochLength - txStatusData.tickTxIndexStart[tickIndex];
+#if ADDON_TX_STATUS_INDEX
+        // add TX's of kept ticks to index
         for (unsigned int tickOffset = 0; tickOffset < tickCount; ++tickOffset)
         {
-            txStatusData.tickTxIndexStart[MAX_NUMBER_OF_TICKS_PER_EPOCH + tickOffset] = txStatusData.tickTxIndexStart[tickIndex + tickOffset] + indexStartDelta;
+            const unsigned long long storeIndex = txStatusData.confirmedTxPreviousEpochStoreBegin + txStatusData.tickTxIndexStart[MAX_NUMBER_OF_TICKS_PER_EPOCH + tickOffset];
+            for (unsigned int i = 0; i < txStatusData.tickTxCounter[MAX_NUMBER_OF_TICKS_PER_EPOCH + tickOffset]; ++i)
+            {
+                ConfirmedTx tx;
+                confirmedTxStore.getOne(storeIndex + i, &tx);
+                if (!addConfirmedTxToIndex(tx.digest, tx.tick, tx.moneyFlew))
+                    ++txStatusData.confirmedTxIndexDroppedTxs;
+            }
         }
+#endif
+
+#ifndef NO_UEFI
+        // remove pages from disk that only contain TX's of ticks that aren't available anymore
+        // (removing files is done by the main thread's async file IO, which isn't running in NO_UEFI builds)
+        const unsigned long long firstNeededPage = (txStatusData.confirmedTxPreviousEpochStoreBegin + txStatusData.tickTxIndexStart[MAX_NUMBER_OF_TICKS_PER_EPOCH]) / confirmedTxPageCapacity;
+        for (; txStatusData.confirmedTxPrunedPages < firstNeededPage; ++txStatusData.confirmedTxPrunedPages)
+            confirmedTxStore.prune(txStatusData.confirmedTxPrunedPages);
+#endif
 
-        // init pool of current epoch with 0
-        setMem(confirmedTx, confirmedTxCurrentEpochLength * sizeof(ConfirmedTx), 0);
+        // init data of current epoch with 0
         setMem(txStatusData.tickTxCounter, MAX_NUMBER_OF_TICKS_PER_EPOCH * sizeof(txStatusData.tickTxCounter[0]), 0);
         setMem(txStatusData.tickTxIndexStart, MAX_NUMBER_OF_TICKS_PER_EPOCH * sizeof(txStatusData.tickTxIndexStart[0]), 0);
     }
@@ -157,13 +321,13 @@ static void beginEpochTxStatusRequestAddOn(unsigned int newInitialTick)
         // node startup with no data of prior epoch or no ticks to keep
         oldTickBegin = 0;
 
-        // init pool with 0
-        setMem(confirmedTx, confirmedTxLength * sizeof(ConfirmedTx), 0);
+        // init data with 0
         setMem(txStatusData.tickTxCounter, sizeof(txStatusData.tickTxCounter), 0);
         setMem(txStatusData.tickTxIndexStart, sizeof(txStatusData.tickTxIndexStart), 0);
     }
 
     tickBegin = newInitialTick;
+    txStatusData.confirmedTxCurrentEpochStoreBegin = confirmedTxStore.size();
 }
 
 
@@ -177,17 +341,23 @@ static bool saveConfirmedTx(unsigned int txNumberMinusOne, bool moneyFlew, unsig
     ASSERT(txStatusData.confirmedTxCurrentEpochBeginTick == system.initialTick);
     ASSERT(tick >= system.initialTick && tick < system.initialTick + MAX_NUMBER_OF_TICKS_PER_EPOCH);
 
-    // skip if confirmedTx storage is full
-    if (txNumberMinusOne >= confirmedTxCurrentEpochLength)
+    // TX's are appended in order of execution, so the store index is given by the tx number
+    if (txStatusData.confirmedTxCurrentEpochStoreBegin + txNumberMinusOne != confirmedTxStore.size())
         return false;
 
     ACQUIRE(confirmedTxLock);
 
-    // set confirmedTx data
-    ConfirmedTx & txConfirmation = confirmedTx[txNumberMinusOne];
+    // append confirmedTx data
+    ConfirmedTx txConfirmation;
     txConfirmation.tick = tick;
     txConfirmation.moneyFlew = moneyFlew;
+    setMem(txConfirmation._padding, sizeof(txConfirmation._padding), 0);
     txConfirmation.digest = digest;
+    confirmedTxStore.append(txConfirmation);
+#if ADDON_TX_STATUS_INDEX
+    if (!addConfirmedTxToIndex(digest, tick, moneyFlew))
+        ++txStatusData.confirmedTxIndexDroppedTxs;
+#endif
 
     // get current tick number in epoch
     int tickIndex = tick - system.initialTick;
@@ -214,15 +384,18 @@ static void processRequestConfirmedTx(long long processorNumber, Peer *peer, Req
         return;
 
     int tickIndex;
+    unsigned long long storeBegin;
     if (request->tick >= txStatusData.confirmedTxCurrentEpochBeginTick && request->tick < txStatusData.confirmedTxCurrentEpochBeginTick + MAX_NUMBER_OF_TICKS_PER_EPOCH)
     {
         // current epoch
         tickIndex = request->tick - txStatusData.confirmedTxCurrentEpochBeginTick;
+        storeBegin = txStatusData.confirmedTxCurrentEpochStoreBegin;
     }
     else if (txStatusData.confirmedTxPreviousEpochBeginTick != 0 && request->tick >= txStatusData.confirmedTxPreviousEpochBeginTick && request->tick < txStatusData.confirmedTxCurrentEpochBeginTick)
     {
         // available tick of previous epoch (stored behind current epoch data)
         tickIndex = request->tick - txStatusData.confirmedTxPreviousEpochBeginTick + MAX_NUMBER_OF_TICKS_PER_EPOCH;
+        storeBegin = txStatusData.confirmedTxPreviousEpochStoreBegin;
     }
     else
     {
@@ -230,8 +403,8 @@ static void processRequestConfirmedTx(long long processorNumber, Peer *peer, Req
         return;
     }
 
-    // get index where confirmedTx are starting to be stored in memory
-    int index = txStatusData.tickTxIndexStart[tickIndex];
+    // get index where confirmedTx are starting to be stored
+    const unsigned long long index = storeBegin + txStatusData.tickTxIndexStart[tickIndex];
 
     // init response message data, get it from the storage to avoid increasing stack mem
     RespondTxStatus& tickTxStatus = tickTxStatusStorage[processorNumber];
@@ -244,9 +417,9 @@ static void processRequestConfirmedTx(long long processorNumber, Peer *peer, Req
     ASSERT(tickTxStatus.txCount <= NUMBER_OF_TRANSACTIONS_PER_TICK);
     for (unsigned int i = 0; i < tickTxStatus.txCount; i++)
     {
-        ConfirmedTx& localConfirmedTx = confirmedTx[index + i];
+        ConfirmedTx localConfirmedTx;
+        confirmedTxStore.getOne(index + i, &localConfirmedTx);
 
-        ASSERT(index + i < confirmedTxLength);
         ASSERT(localConfirmedTx.tick == request->tick);
         ASSERT(localConfirmedTx.moneyFlew == 1 || localConfirmedTx.moneyFlew == 0);
 
@@ -258,6 +431,33 @@ static void processRequestConfirmedTx(long long processorNumber, Peer *peer, Req
     enqueueResponse(peer, tickTxStatus.size(), RespondTxStatus::type(), header->dejavu(), &tickTxStatus);
 }
 
+
+#if ADDON_TX_STATUS_INDEX
+static void processRequestTxStatusBatch(Peer* peer, RequestResponseHeader* header)
+{
+    RequestTxStatusBatch* request = header->getPayload<RequestTxStatusBatch>();
+    if (header->getPayloadSize() < offsetof(RequestTxStatusBatch, digests)
+        || request->digestCount > RequestTxStatusBatch::maxDigests
+        || !header->checkPayloadSize(request->size()))
+        return;
+
+    RespondTxStatusBatch response;
+    response.currentTickOfNode = system.tick;
+    response.digestCount = request->digestCount;
+    setMem(response.ticks, sizeof(response.ticks), 0);
+    setMem(response.moneyFlew, sizeof(response.moneyFlew), 0);
+    for (unsigned int i = 0; i < request->digestCount; i++)
+    {
+        bool moneyFlew = false;
+        response.ticks[i] = findConfirmedTxInIndex(request->digests[i], moneyFlew);
+        if (response.ticks[i] && moneyFlew)
+            response.moneyFlew[i >> 3] |= (1 << (i & 7));
+    }
+
+    enqueueResponse(peer, sizeof(response), RespondTxStatusBatch::type(), header->dejavu(), &response);
+}
+#endif
+
 #if TICK_STORAGE_AUTOSAVE_MODE
 // can only be called from main thread
 static bool saveStateTxStatus(const unsigned int numberOfTransactions, CHAR16* directory)
@@ -270,13 +470,28 @@ static bool saveStateTxStatus(const unsigned int numberOfTransactions, CHAR16* d
         return false;
     }
 
+    // current page of confirmedTxStore (previous pages are already on disk)
+    const unsigned long long vmStateSize = confirmedTxStore.getPageSize() + 16;
+    __ScopedScratchpad scratchpad(vmStateSize, /*initZero=*/false);
+    ASSERT(scratchpad.ptr);
+    confirmedTxStore.dumpVMState((unsigned char*)scratchpad.ptr);
     static unsigned short CONFIRMED_TX_SNAPSHOT_FILE_NAME[] = L"snapshotConfirmedTx";
-    savedSize = saveLargeFile(CONFIRMED_TX_SNAPSHOT_FILE_NAME, numberOfTransactions*sizeof(ConfirmedTx), (unsigned char*)confirmedTx, directory);
-    if (savedSize != numberOfTransactions * sizeof(ConfirmedTx))
+    savedSize = save(CONFIRMED_TX_SNAPSHOT_FILE_NAME, vmStateSize, (unsigned char*)scratchpad.ptr, directory);
+    if (savedSize != vmStateSize)
     {
         logToConsole(L"Failed to save ConfirmedTx");
         return false;
     }
+
+#if ADDON_TX_STATUS_INDEX
+    static unsigned short CONFIRMED_TX_INDEX_SNAPSHOT_FILE_NAME[] = L"snapshotConfirmedTxIndex";
+    savedSize = saveLargeFile(CONFIRMED_TX_INDEX_SNAPSHOT_FILE_NAME, TX_STATUS_INDEX_CAPACITY * sizeof(ConfirmedTxIndexEntry), (unsigned char*)confirmedTxIndex, directory);
+    if (savedSize != TX_STATUS_INDEX_CAPACITY * sizeof(ConfirmedTxIndexEntry))
+    {
+        logToConsole(L"Failed to save ConfirmedTxIndex");
+        return false;
+    }
+#endif
     return true;
 }
 
@@ -292,17 +507,33 @@ static bool loadStateTxStatus(const unsigned int numberOfTransactions, CHAR16* d
         return false;
     }
 
-    if (numberOfTransactions)
+    const unsigned long long vmStateSize = confirmedTxStore.getPageSize() + 16;
+    __ScopedScratchpad scratchpad(vmStateSize, /*initZero=*/false);
+    ASSERT(scratchpad.ptr);
+    static unsigned short CONFIRMED_TX_SNAPSHOT_FILE_NAME[] = L"snapshotConfirmedTx";
+    loadedSize = load(CONFIRMED_TX_SNAPSHOT_FILE_NAME, vmStateSize, (unsigned char*)scratchpad.ptr, directory);
+    if (loadedSize != vmStateSize)
     {
-        static unsigned short CONFIRMED_TX_SNAPSHOT_FILE_NAME[] = L"snapshotConfirmedTx";
-        loadedSize = loadLargeFile(CONFIRMED_TX_SNAPSHOT_FILE_NAME, numberOfTransactions * sizeof(ConfirmedTx), (unsigned char*)confirmedTx, directory);
-        if (loadedSize != numberOfTransactions * sizeof(ConfirmedTx))
-        {
-            logToConsole(L"Failed to load ConfirmedTx");
-            return false;
-        }
+        logToConsole(L"Failed to load ConfirmedTx");
+        return false;
+    }
+    confirmedTxStore.loadVMState((unsigned char*)scratchpad.ptr);
+    if (confirmedTxStore.size() != txStatusData.confirmedTxCurrentEpochStoreBegin + numberOfTransactions)
+    {
+        logToConsole(L"ConfirmedTx doesn't match numberOfTransactions");
+        return false;
+    }
+
+#if ADDON_TX_STATUS_INDEX
+    static unsigned short CONFIRMED_TX_INDEX_SNAPSHOT_FILE_NAME[] = L"snapshotConfirmedTxIndex";
+    loadedSize = loadLargeFile(CONFIRMED_TX_INDEX_SNAPSHOT_FILE_NAME, TX_STATUS_INDEX_CAPACITY * sizeof(ConfirmedTxIndexEntry), (unsigned char*)confirmedTxIndex, directory);
+    if (loadedSize != TX_STATUS_INDEX_CAPACITY * sizeof(ConfirmedTxIndexEntry))
+    {
+        logToConsole(L"Failed to load ConfirmedTxIndex");
+        return false;
     }
+#endif
     return true;
 }
 #endif // TICK_STORAGE_AUTOSAVE_MODE
-#endif // ADDON_TX_STATUS_REQUEST
\ No newline at end of file
+#endif // ADDON_TX_STATUS_REQUEST
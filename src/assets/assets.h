@@ -3,8 +3,10 @@
 #include "platform/global_var.h"
 #include "platform/m256.h"
 #include "platform/concurrency.h"
+#include "platform/sequence_lock.h"
 #include <lib/platform_efi/uefi.h>
 #include "platform/file_io.h"
+#include "platform/incremental_file.h"
 #include "platform/time_stamp_counter.h"
 #include "platform/memory_util.h"
 #include "platform/profiling.h"
@@ -28,9 +30,16 @@
 //   or during a single-threading phase (node startup); NO WRITING OF ASSETS IN REQUEST PROCESSOR OR MAIN THREAD!
 // - QPI asset iteration classes do not allow writing access to the universe (if this is changed in the future,
 //   note that all write access requires locking universeLock)
+//
+// Writers additionally wrap each change of assets in universeSequenceLock.beginWrite() / endWrite(), so that
+// numberOfPossessedShares(), numberOfShares(), and the network request handlers can read without universeLock. They
+// read optimistically and repeat the read if the universe has been changed meanwhile (see SequenceLock).
+// reorganizeUniverse() moves records and rebuilds the index lists. It runs during the epoch transition, while the
+// request processors are parked, so iterator positions kept across validated reads remain meaningful.
 
 // TODO: move this into AssetStorage class
 GLOBAL_VAR_DECL volatile char universeLock GLOBAL_VAR_INIT(0);
+GLOBAL_VAR_DECL SequenceLock universeSequenceLock;
 GLOBAL_VAR_DECL AssetRecord* assets GLOBAL_VAR_INIT(nullptr);
 GLOBAL_VAR_DECL m256i* assetDigests GLOBAL_VAR_INIT(nullptr);
 static constexpr unsigned long long assetDigestsSizeInBytes = (ASSETS_CAPACITY * 2 - 1) * 32ULL;
@@ -39,6 +48,43 @@ static constexpr char CONTRACT_ASSET_UNIT_OF_MEASUREMENT[7] = { 0, 0, 0, 0, 0, 0
 
 static constexpr unsigned int NO_ASSET_INDEX = 0xffffffff;
 
+// Layout of the universe hash map. In version 1, all records were placed by the low 32 bits of their public key, so the
+// issuance, ownership, and possession records of all assets of a key (for example a contract holding shares of many
+// assets) shared one probe sequence. Since version 2, each record type has its own probe start, derived from the public
+// key mixed with the asset (see issuanceHashIndex(), ownershipHashIndex(), possessionHashIndex()). Universe files of
+// version 1 are migrated in loadUniverse().
+static constexpr unsigned int UNIVERSE_LAYOUT_VERSION = 2;
+
+// Get start index for probing the universe hash map from public key and asset key
+static inline unsigned int universeHashIndex(const m256i& publicKey, unsigned long long assetKey)
+{
+    unsigned long long h = publicKey.m256i_u64[0] ^ publicKey.m256i_u64[1] ^ publicKey.m256i_u64[2] ^ publicKey.m256i_u64[3];
+    h ^= assetKey * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return (unsigned int)h & (ASSETS_CAPACITY - 1);
+}
+
+// Get start index for probing issuance records of issuer and assetName
+static inline unsigned int issuanceHashIndex(const m256i& issuer, unsigned long long assetName)
+{
+    return universeHashIndex(issuer, (assetName & 0xFFFFFFFFFFFFFF) | ((unsigned long long)ISSUANCE << 56));
+}
+
+// Get start index for probing ownership records of owner of the asset at issuanceIndex
+static inline unsigned int ownershipHashIndex(const m256i& owner, unsigned int issuanceIndex)
+{
+    return universeHashIndex(owner, issuanceIndex | ((unsigned long long)OWNERSHIP << 56));
+}
+
+// Get start index for probing possession records of possessor of the asset at issuanceIndex. The issuance (not the
+// ownership) is mixed in, so all possessions of the asset by possessor are found in one probe sequence.
+static inline unsigned int possessionHashIndex(const m256i& possessor, unsigned int issuanceIndex)
+{
+    return universeHashIndex(possessor, issuanceIndex | ((unsigned long long)POSSESSION << 56));
+}
+
 
 struct AssetStorage
 {
@@ -142,7 +188,7 @@ static unsigned int issuanceIndex(const m256i& issuer, unsigned long long assetN
 {
     PROFILE_SCOPE();
 
-    unsigned int idx = issuer.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+    unsigned int idx = issuanceHashIndex(issuer, assetName);
     while (assets[idx].varStruct.issuance.type != EMPTY)
     {
         if (assets[idx].varStruct.issuance.type == ISSUANCE
@@ -173,6 +219,7 @@ static bool initAssets()
         return false;
     }
     setMem(assetChangeFlags, ASSETS_CAPACITY / 8, 0xFF);
+    universeSequenceLock.reset();
     return true;
 }
 
@@ -200,20 +247,22 @@ static long long issueAsset(const m256i& issuerPublicKey, const char name[7], ch
 {
     PROFILE_SCOPE();
 
-    *issuanceIndex = issuerPublicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+    *issuanceIndex = issuanceHashIndex(issuerPublicKey, *((unsigned long long*)name));
 
     ACQUIRE(universeLock);
 
 iteration:
     if (assets[*issuanceIndex].varStruct.issuance.type == EMPTY)
     {
+        universeSequenceLock.beginWrite();
+
         assets[*issuanceIndex].varStruct.issuance.publicKey = issuerPublicKey;
         assets[*issuanceIndex].varStruct.issuance.type = ISSUANCE;
         copyMem(assets[*issuanceIndex].varStruct.issuance.name, name, sizeof(assets[*issuanceIndex].varStruct.issuance.name));
         assets[*issuanceIndex].varStruct.issuance.numberOfDecimalPlaces = numberOfDecimalPlaces;
         copyMem(assets[*issuanceIndex].varStruct.issuance.unitOfMeasurement, unitOfMeasurement, sizeof(assets[*issuanceIndex].varStruct.issuance.unitOfMeasurement));
 
-        *ownershipIndex = (*issuanceIndex + 1) & (ASSETS_CAPACITY - 1);
+        *ownershipIndex = ownershipHashIndex(issuerPublicKey, *issuanceIndex);
     iteration2:
         if (assets[*ownershipIndex].varStruct.ownership.type == EMPTY)
         {
@@ -223,7 +272,7 @@ iteration:
             assets[*ownershipIndex].varStruct.ownership.issuanceIndex = *issuanceIndex;
             assets[*ownershipIndex].varStruct.ownership.numberOfShares = numberOfShares;
 
-            *possessionIndex = (*ownershipIndex + 1) & (ASSETS_CAPACITY - 1);
+            *possessionIndex = possessionHashIndex(issuerPublicKey, *issuanceIndex);
         iteration3:
             if (assets[*possessionIndex].varStruct.possession.type == EMPTY)
             {
@@ -241,6 +290,7 @@ iteration:
                 as.indexLists.addOwnership(*issuanceIndex, *ownershipIndex);
                 as.indexLists.addPossession(*ownershipIndex, *possessionIndex);
 
+                universeSequenceLock.endWrite();
                 RELEASE(universeLock);
 
                 AssetIssuance assetIssuance;
@@ -284,32 +334,133 @@ iteration:
     }
 }
 
-static sint64 numberOfShares(
-    const Asset& asset,
-    const AssetOwnershipSelect& ownership = AssetOwnershipSelect::any(),
-    const AssetPossessionSelect& possession = AssetPossessionSelect::any())
+// Add shares of the possession records of ownershipIdx matching the possession filter to numOfShares, reading without
+// universeLock like readNumberOfShares(). Returns false if the records read are inconsistent or the universe has been
+// changed (sequence number isn't sequence anymore).
+static bool readNumberOfPossessedSharesOfOwnership(unsigned int issuanceIdx, unsigned int ownershipIdx,
+    const AssetPossessionSelect& possession, long long sequence, sint64& numOfShares)
 {
-    PROFILE_SCOPE();
+    AssetRecord record;
+    if (!possession.anyPossessor)
+    {
+        // specific possessor -> probe hash map
+        for (unsigned int idx = possessionHashIndex(possession.possessor, issuanceIdx); ; idx = (idx + 1) & (ASSETS_CAPACITY - 1))
+        {
+            copyMem(&record, &assets[idx], sizeof(AssetRecord));
+            if (universeSequenceLock.getSequence() != sequence)
+                return false;
+            if (record.varStruct.possession.type == EMPTY)
+                return true;
+            if (record.varStruct.possession.type == POSSESSION
+                && record.varStruct.possession.ownershipIndex == ownershipIdx
+                && record.varStruct.possession.publicKey == possession.possessor
+                && (possession.anyManagingContract || record.varStruct.possession.managingContractIndex == possession.managingContract))
+            {
+                numOfShares += record.varStruct.possession.numberOfShares;
+            }
+        }
+    }
 
-    ACQUIRE(universeLock);
+    // any possessor -> follow list of possessions of ownership, checking each record before using its link
+    for (unsigned int idx = as.indexLists.ownershipsPossessionsFirstIdx[ownershipIdx]; idx != NO_ASSET_INDEX; idx = as.indexLists.nextIdx[idx])
+    {
+        if (idx >= ASSETS_CAPACITY)
+            return false;
+        copyMem(&record, &assets[idx], sizeof(AssetRecord));
+        if (universeSequenceLock.getSequence() != sequence
+            || record.varStruct.possession.type != POSSESSION
+            || record.varStruct.possession.ownershipIndex != ownershipIdx)
+            return false;
+        if (possession.anyManagingContract || record.varStruct.possession.managingContractIndex == possession.managingContract)
+            numOfShares += record.varStruct.possession.numberOfShares;
+    }
+    return true;
+}
 
+// Count shares of the ownership records (or their possession records, if a possession filter is given) of asset
+// without universeLock, to be validated with universeSequenceLock by the caller. In contrast to the QPI iterators,
+// each record is copied and checked before its index list link is followed, so inconsistent data read while the
+// universe is changed never leads to an invalid index. Returns early if the sequence number isn't sequence anymore.
+static sint64 readNumberOfShares(const Asset& asset, const AssetOwnershipSelect& ownership, const AssetPossessionSelect& possession,
+    long long sequence)
+{
+    const bool countOwnedShares = possession.anyPossessor && possession.anyManagingContract;
+    AssetRecord record;
     sint64 numOfShares = 0;
-    if (possession.anyPossessor && possession.anyManagingContract)
+
+    // find issuance
+    unsigned int issuanceIdx = issuanceHashIndex(asset.issuer, asset.assetName);
+    while (true)
+    {
+        copyMem(&record, &assets[issuanceIdx], sizeof(AssetRecord));
+        if (universeSequenceLock.getSequence() != sequence || record.varStruct.issuance.type == EMPTY)
+            return 0;
+        if (record.varStruct.issuance.type == ISSUANCE
+            && ((*((unsigned long long*)record.varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) == asset.assetName
+            && record.varStruct.issuance.publicKey == asset.issuer)
+            break;
+        issuanceIdx = (issuanceIdx + 1) & (ASSETS_CAPACITY - 1);
+    }
+
+    if (!ownership.anyOwner)
     {
-        for (AssetOwnershipIterator iter(asset, ownership); !iter.reachedEnd(); iter.next())
+        // specific owner -> probe hash map
+        for (unsigned int idx = ownershipHashIndex(ownership.owner, issuanceIdx); ; idx = (idx + 1) & (ASSETS_CAPACITY - 1))
         {
-            numOfShares += iter.numberOfOwnedShares();
+            copyMem(&record, &assets[idx], sizeof(AssetRecord));
+            if (universeSequenceLock.getSequence() != sequence)
+                return 0;
+            if (record.varStruct.ownership.type == EMPTY)
+                return numOfShares;
+            if (record.varStruct.ownership.type == OWNERSHIP
+                && record.varStruct.ownership.issuanceIndex == issuanceIdx
+                && record.varStruct.ownership.publicKey == ownership.owner
+                && (ownership.anyManagingContract || record.varStruct.ownership.managingContractIndex == ownership.managingContract))
+            {
+                if (countOwnedShares)
+                    numOfShares += record.varStruct.ownership.numberOfShares;
+                else if (!readNumberOfPossessedSharesOfOwnership(issuanceIdx, idx, possession, sequence, numOfShares))
+                    return 0;
+            }
         }
     }
-    else
+
+    // any owner -> follow list of ownerships of issuance, checking each record before using its link
+    for (unsigned int idx = as.indexLists.ownershipsPossessionsFirstIdx[issuanceIdx]; idx != NO_ASSET_INDEX; idx = as.indexLists.nextIdx[idx])
     {
-        for (AssetPossessionIterator iter(asset, ownership, possession); !iter.reachedEnd(); iter.next())
+        if (idx >= ASSETS_CAPACITY)
+            return 0;
+        copyMem(&record, &assets[idx], sizeof(AssetRecord));
+        if (universeSequenceLock.getSequence() != sequence
+            || record.varStruct.ownership.type != OWNERSHIP
+            || record.varStruct.ownership.issuanceIndex != issuanceIdx)
+            return 0;
+        if (ownership.anyManagingContract || record.varStruct.ownership.managingContractIndex == ownership.managingContract)
         {
-            numOfShares += iter.numberOfPossessedShares();
+            if (countOwnedShares)
+                numOfShares += record.varStruct.ownership.numberOfShares;
+            else if (!readNumberOfPossessedSharesOfOwnership(issuanceIdx, idx, possession, sequence, numOfShares))
+                return 0;
         }
     }
+    return numOfShares;
+}
 
-    RELEASE(universeLock);
+static sint64 numberOfShares(
+    const Asset& asset,
+    const AssetOwnershipSelect& ownership = AssetOwnershipSelect::any(),
+    const AssetPossessionSelect& possession = AssetPossessionSelect::any())
+{
+    PROFILE_SCOPE();
+
+    // read without universeLock, repeating if the universe is changed meanwhile
+    sint64 numOfShares;
+    long long sequence;
+    do
+    {
+        sequence = universeSequenceLock.beginRead();
+        numOfShares = readNumberOfShares(asset, ownership, possession, sequence);
+    } while (!universeSequenceLock.validateRead(sequence));
 
     return numOfShares;
 }
@@ -352,7 +503,7 @@ static bool transferShareManagementRights(int sourceOwnershipIndex, int sourcePo
     const m256i& possessionPublicKey = assets[sourcePossessionIndex].varStruct.possession.publicKey;
     const int issuanceIndex = assets[sourceOwnershipIndex].varStruct.ownership.issuanceIndex;
 
-    int destinationOwnershipIndex = ownershipPublicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+    int destinationOwnershipIndex = ownershipHashIndex(ownershipPublicKey, issuanceIndex);
 iteration:
     if (assets[destinationOwnershipIndex].varStruct.ownership.type == EMPTY
         || (assets[destinationOwnershipIndex].varStruct.ownership.type == OWNERSHIP
@@ -361,6 +512,7 @@ iteration:
             && assets[destinationOwnershipIndex].varStruct.ownership.publicKey == ownershipPublicKey))
     {
         // found empty slot for ownership record or existing record to update
+        universeSequenceLock.beginWrite();
         assets[sourceOwnershipIndex].varStruct.ownership.numberOfShares -= numberOfShares;
 
         if (assets[destinationOwnershipIndex].varStruct.ownership.type == EMPTY)
@@ -374,7 +526,7 @@ iteration:
         }
         assets[destinationOwnershipIndex].varStruct.ownership.numberOfShares += numberOfShares;
 
-        int destinationPossessionIndex = possessionPublicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+        int destinationPossessionIndex = possessionHashIndex(possessionPublicKey, issuanceIndex);
     iteration2:
         if (assets[destinationPossessionIndex].varStruct.possession.type == EMPTY
             || (assets[destinationPossessionIndex].varStruct.possession.type == POSSESSION
@@ -400,6 +552,7 @@ iteration:
             assetChangeFlags[sourcePossessionIndex >> 6] |= (1ULL << (sourcePossessionIndex & 63));
             assetChangeFlags[destinationOwnershipIndex >> 6] |= (1ULL << (destinationOwnershipIndex & 63));
             assetChangeFlags[destinationPossessionIndex >> 6] |= (1ULL << (destinationPossessionIndex & 63));
+            universeSequenceLock.endWrite();
 
             if (lock)
             {
@@ -502,10 +655,12 @@ static bool transferShareOwnershipAndPossession(int sourceOwnershipIndex, int so
         }
 
         // Burn by subtracting shares from source records
+        universeSequenceLock.beginWrite();
         assets[sourceOwnershipIndex].varStruct.ownership.numberOfShares -= numberOfShares;
         assets[sourcePossessionIndex].varStruct.possession.numberOfShares -= numberOfShares;
         assetChangeFlags[sourceOwnershipIndex >> 6] |= (1ULL << (sourceOwnershipIndex & 63));
         assetChangeFlags[sourcePossessionIndex >> 6] |= (1ULL << (sourcePossessionIndex & 63));
+        universeSequenceLock.endWrite();
 
         if (lock)
         {
@@ -540,7 +695,7 @@ static bool transferShareOwnershipAndPossession(int sourceOwnershipIndex, int so
     // Default case: transfer shares to destinationPublicKey
     ASSERT(destinationOwnershipIndex != nullptr);
     ASSERT(destinationPossessionIndex != nullptr);
-    *destinationOwnershipIndex = destinationPublicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+    *destinationOwnershipIndex = ownershipHashIndex(destinationPublicKey, assets[sourceOwnershipIndex].varStruct.ownership.issuanceIndex);
 iteration:
     if (assets[*destinationOwnershipIndex].varStruct.ownership.type == EMPTY
         || (assets[*destinationOwnershipIndex].varStruct.ownership.type == OWNERSHIP
@@ -548,6 +703,7 @@ iteration:
             && assets[*destinationOwnershipIndex].varStruct.ownership.issuanceIndex == assets[sourceOwnershipIndex].varStruct.ownership.issuanceIndex
             && assets[*destinationOwnershipIndex].varStruct.ownership.publicKey == destinationPublicKey))
     {
+        universeSequenceLock.beginWrite();
         assets[sourceOwnershipIndex].varStruct.ownership.numberOfShares -= numberOfShares;
 
         if (assets[*destinationOwnershipIndex].varStruct.ownership.type == EMPTY)
@@ -561,7 +717,7 @@ iteration:
         }
         assets[*destinationOwnershipIndex].varStruct.ownership.numberOfShares += numberOfShares;
 
-        *destinationPossessionIndex = destinationPublicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+        *destinationPossessionIndex = possessionHashIndex(destinationPublicKey, assets[sourceOwnershipIndex].varStruct.ownership.issuanceIndex);
     iteration2:
         if (assets[*destinationPossessionIndex].varStruct.possession.type == EMPTY
             || (assets[*destinationPossessionIndex].varStruct.possession.type == POSSESSION
@@ -586,6 +742,7 @@ iteration:
             assetChangeFlags[sourcePossessionIndex >> 6] |= (1ULL << (sourcePossessionIndex & 63));
             assetChangeFlags[*destinationOwnershipIndex >> 6] |= (1ULL << (*destinationOwnershipIndex & 63));
             assetChangeFlags[*destinationPossessionIndex >> 6] |= (1ULL << (*destinationPossessionIndex & 63));
+            universeSequenceLock.endWrite();
 
             if (lock)
             {
@@ -631,18 +788,15 @@ iteration:
     }
 }
 
-static long long numberOfPossessedShares(unsigned long long assetName, const m256i& issuer, const m256i& owner, const m256i& possessor, unsigned short ownershipManagingContractIndex, unsigned short possessionManagingContractIndex)
+// Probe for possession record without locking, to be validated with universeSequenceLock by the caller. Returns 0 early
+// if the sequence number of the universe isn't sequence anymore.
+static long long readNumberOfPossessedShares(unsigned long long assetName, const m256i& issuer, const m256i& owner, const m256i& possessor, unsigned short ownershipManagingContractIndex, unsigned short possessionManagingContractIndex,
+    long long sequence)
 {
-    PROFILE_SCOPE();
-
-    ACQUIRE(universeLock);
-
-    int issuanceIndex = issuer.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+    int issuanceIndex = issuanceHashIndex(issuer, assetName);
 iteration:
     if (assets[issuanceIndex].varStruct.issuance.type == EMPTY)
     {
-        RELEASE(universeLock);
-
         return 0;
     }
     else
@@ -651,12 +805,10 @@ iteration:
             && ((*((unsigned long long*)assets[issuanceIndex].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) == assetName
             && assets[issuanceIndex].varStruct.issuance.publicKey == issuer)
         {
-            int ownershipIndex = owner.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+            int ownershipIndex = ownershipHashIndex(owner, issuanceIndex);
         iteration2:
             if (assets[ownershipIndex].varStruct.ownership.type == EMPTY)
             {
-                RELEASE(universeLock);
-
                 return 0;
             }
             else
@@ -666,12 +818,10 @@ iteration:
                     && assets[ownershipIndex].varStruct.ownership.publicKey == owner
                     && assets[ownershipIndex].varStruct.ownership.managingContractIndex == ownershipManagingContractIndex)
                 {
-                    int possessionIndex = possessor.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+                    int possessionIndex = possessionHashIndex(possessor, issuanceIndex);
                 iteration3:
                     if (assets[possessionIndex].varStruct.possession.type == EMPTY)
                     {
-                        RELEASE(universeLock);
-
                         return 0;
                     }
                     else
@@ -681,14 +831,13 @@ iteration:
                             && assets[possessionIndex].varStruct.possession.publicKey == possessor
                             && assets[possessionIndex].varStruct.possession.managingContractIndex == possessionManagingContractIndex)
                         {
-                            const long long numberOfPossessedShares = assets[possessionIndex].varStruct.possession.numberOfShares;
-
-                            RELEASE(universeLock);
-
-                            return numberOfPossessedShares;
+                            return assets[possessionIndex].varStruct.possession.numberOfShares;
                         }
                         else
                         {
+                            if (universeSequenceLock.getSequence() != sequence)
+                                return 0;
+
                             possessionIndex = (possessionIndex + 1) & (ASSETS_CAPACITY - 1);
 
                             goto iteration3;
@@ -697,6 +846,9 @@ iteration:
                 }
                 else
                 {
+                    if (universeSequenceLock.getSequence() != sequence)
+                        return 0;
+
                     ownershipIndex = (ownershipIndex + 1) & (ASSETS_CAPACITY - 1);
 
                     goto iteration2;
@@ -705,6 +857,9 @@ iteration:
         }
         else
         {
+            if (universeSequenceLock.getSequence() != sequence)
+                return 0;
+
             issuanceIndex = (issuanceIndex + 1) & (ASSETS_CAPACITY - 1);
 
             goto iteration;
@@ -712,6 +867,163 @@ iteration:
     }
 }
 
+static long long numberOfPossessedShares(unsigned long long assetName, const m256i& issuer, const m256i& owner, const m256i& possessor, unsigned short ownershipManagingContractIndex, unsigned short possessionManagingContractIndex)
+{
+    PROFILE_SCOPE();
+
+    // read without universeLock, repeating if the universe is changed meanwhile
+    long long numberOfPossessedShares;
+    long long sequence;
+    do
+    {
+        sequence = universeSequenceLock.beginRead();
+        numberOfPossessedShares = readNumberOfPossessedShares(assetName, issuer, owner, possessor, ownershipManagingContractIndex, possessionManagingContractIndex, sequence);
+    } while (!universeSequenceLock.validateRead(sequence));
+
+    return numberOfPossessedShares;
+}
+
+// Rebuild asset hash map with the current layout, getting rid of all elements with zero shares. Caller has to hold
+// universeLock.
+static void reorganizeUniverse()
+{
+    PROFILE_SCOPE();
+
+    AssetRecord* reorgAssets = (AssetRecord*)commonBuffers.acquireBuffer(universeSizeInBytes);
+    setMem(reorgAssets, universeSizeInBytes, 0);
+    for (unsigned int i = 0; i < ASSETS_CAPACITY; i++)
+    {
+        if (assets[i].varStruct.possession.type == POSSESSION
+            && assets[i].varStruct.possession.numberOfShares > 0)
+        {
+            const unsigned int oldOwnershipIndex = assets[i].varStruct.possession.ownershipIndex;
+            const unsigned int oldIssuanceIndex = assets[oldOwnershipIndex].varStruct.ownership.issuanceIndex;
+            const m256i& issuerPublicKey = assets[oldIssuanceIndex].varStruct.issuance.publicKey;
+            char* name = assets[oldIssuanceIndex].varStruct.issuance.name;
+            int issuanceIndex = issuanceHashIndex(issuerPublicKey, *((unsigned long long*)name));
+        iteration2:
+            if (reorgAssets[issuanceIndex].varStruct.issuance.type == EMPTY
+                || (reorgAssets[issuanceIndex].varStruct.issuance.type == ISSUANCE
+                    && ((*((unsigned long long*)reorgAssets[issuanceIndex].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) == ((*((unsigned long long*)name)) & 0xFFFFFFFFFFFFFF)
+                    && reorgAssets[issuanceIndex].varStruct.issuance.publicKey == issuerPublicKey))
+            {
+                if (reorgAssets[issuanceIndex].varStruct.issuance.type == EMPTY)
+                {
+                    copyMem(&reorgAssets[issuanceIndex], &assets[oldIssuanceIndex], sizeof(AssetRecord));
+                }
+
+                const m256i& ownerPublicKey = assets[oldOwnershipIndex].varStruct.ownership.publicKey;
+                int ownershipIndex = ownershipHashIndex(ownerPublicKey, issuanceIndex);
+            iteration3:
+                if (reorgAssets[ownershipIndex].varStruct.ownership.type == EMPTY
+                    || (reorgAssets[ownershipIndex].varStruct.ownership.type == OWNERSHIP
+                        && reorgAssets[ownershipIndex].varStruct.ownership.managingContractIndex == assets[oldOwnershipIndex].varStruct.ownership.managingContractIndex
+                        && reorgAssets[ownershipIndex].varStruct.ownership.issuanceIndex == issuanceIndex
+                        && reorgAssets[ownershipIndex].varStruct.ownership.publicKey == ownerPublicKey))
+                {
+                    if (reorgAssets[ownershipIndex].varStruct.ownership.type == EMPTY)
+                    {
+                        reorgAssets[ownershipIndex].varStruct.ownership.publicKey = ownerPublicKey;
+                        reorgAssets[ownershipIndex].varStruct.ownership.type = OWNERSHIP;
+                        reorgAssets[ownershipIndex].varStruct.ownership.managingContractIndex = assets[oldOwnershipIndex].varStruct.ownership.managingContractIndex;
+                        reorgAssets[ownershipIndex].varStruct.ownership.issuanceIndex = issuanceIndex;
+                    }
+                    reorgAssets[ownershipIndex].varStruct.ownership.numberOfShares += assets[i].varStruct.possession.numberOfShares;
+
+                    int possessionIndex = possessionHashIndex(assets[i].varStruct.possession.publicKey, issuanceIndex);
+                iteration4:
+                    if (reorgAssets[possessionIndex].varStruct.possession.type == EMPTY
+                        || (reorgAssets[possessionIndex].varStruct.possession.type == POSSESSION
+                            && reorgAssets[possessionIndex].varStruct.possession.managingContractIndex == assets[i].varStruct.possession.managingContractIndex
+                            && reorgAssets[possessionIndex].varStruct.possession.ownershipIndex == ownershipIndex
+                            && reorgAssets[possessionIndex].varStruct.possession.publicKey == assets[i].varStruct.possession.publicKey))
+                    {
+                        if (reorgAssets[possessionIndex].varStruct.possession.type == EMPTY)
+                        {
+                            reorgAssets[possessionIndex].varStruct.possession.publicKey = assets[i].varStruct.possession.publicKey;
+                            reorgAssets[possessionIndex].varStruct.possession.type = POSSESSION;
+                            reorgAssets[possessionIndex].varStruct.possession.managingContractIndex = assets[i].varStruct.possession.managingContractIndex;
+                            reorgAssets[possessionIndex].varStruct.possession.ownershipIndex = ownershipIndex;
+                        }
+                        reorgAssets[possessionIndex].varStruct.possession.numberOfShares += assets[i].varStruct.possession.numberOfShares;
+                    }
+                    else
+                    {
+                        possessionIndex = (possessionIndex + 1) & (ASSETS_CAPACITY - 1);
+
+                        goto iteration4;
+                    }
+                }
+                else
+                {
+                    ownershipIndex = (ownershipIndex + 1) & (ASSETS_CAPACITY - 1);
+
+                    goto iteration3;
+                }
+            }
+            else
+            {
+                issuanceIndex = (issuanceIndex + 1) & (ASSETS_CAPACITY - 1);
+
+                goto iteration2;
+            }
+        }
+    }
+    universeSequenceLock.beginWrite();
+    copyMem(assets, reorgAssets, ASSETS_CAPACITY * sizeof(AssetRecord));
+    commonBuffers.releaseBuffer(reorgAssets);
+
+    setMem(assetChangeFlags, ASSETS_CAPACITY / 8, 0xFF);
+
+    as.indexLists.rebuild();
+    universeSequenceLock.endWrite();
+}
+
+// Get start index for probing of the record at universe index in the current layout version, NO_ASSET_INDEX if the
+// record is empty or invalid
+static unsigned int universeHashIndexOfRecord(unsigned int index)
+{
+    const AssetRecord& record = assets[index];
+    switch (record.varStruct.issuance.type)
+    {
+    case ISSUANCE:
+        return issuanceHashIndex(record.varStruct.issuance.publicKey, *((unsigned long long*)record.varStruct.issuance.name));
+    case OWNERSHIP:
+        return ownershipHashIndex(record.varStruct.ownership.publicKey, record.varStruct.ownership.issuanceIndex);
+    case POSSESSION:
+        if (record.varStruct.possession.ownershipIndex >= ASSETS_CAPACITY)
+            return NO_ASSET_INDEX;
+        return possessionHashIndex(record.varStruct.possession.publicKey, assets[record.varStruct.possession.ownershipIndex].varStruct.ownership.issuanceIndex);
+    default:
+        return NO_ASSET_INDEX;
+    }
+}
+
+// Check that each record can be found by probing from its start index of the current layout version
+static bool isUniverseLayoutCurrent()
+{
+    PROFILE_SCOPE();
+
+    for (unsigned int i = 0; i < ASSETS_CAPACITY; i++)
+    {
+        if (assets[i].varStruct.issuance.type == EMPTY)
+            continue;
+
+        unsigned int idx = universeHashIndexOfRecord(i);
+        if (idx == NO_ASSET_INDEX)
+            return false;
+
+        // records are never removed between reorganizations, so there is no empty slot in the probe sequence
+        while (idx != i)
+        {
+            if (assets[idx].varStruct.issuance.type == EMPTY)
+                return false;
+            idx = (idx + 1) & (ASSETS_CAPACITY - 1);
+        }
+    }
+    return true;
+}
+
 // Should only be called from tick processor to avoid concurrent asset state changes, which may cause race conditions
 static void getUniverseDigest(m256i& digest)
 {
@@ -748,7 +1060,9 @@ static void getUniverseDigest(m256i& digest)
 }
 
 
-static bool saveUniverse(const CHAR16* fileName = UNIVERSE_FILE_NAME, const CHAR16* directory = NULL)
+// If incremental is true, the universe is saved in chunks and only chunks changed since the last save are written
+// (used for node state snapshots).
+static bool saveUniverse(const CHAR16* fileName = UNIVERSE_FILE_NAME, const CHAR16* directory = NULL, bool incremental = false)
 {
     PROFILE_SCOPE();
 
@@ -756,14 +1070,17 @@ static bool saveUniverse(const CHAR16* fileName = UNIVERSE_FILE_NAME, const CHAR
 
     const unsigned long long beginningTick = __rdtsc();
 
+    unsigned long long writtenSize = ASSETS_CAPACITY * sizeof(AssetRecord);
     ACQUIRE(universeLock);
-    long long savedSize = save(fileName, ASSETS_CAPACITY * sizeof(AssetRecord), (unsigned char*)assets, directory);
+    long long savedSize = (incremental)
+        ? saveIncrementalFile(fileName, ASSETS_CAPACITY * sizeof(AssetRecord), (unsigned char*)assets, directory, &writtenSize)
+        : save(fileName, ASSETS_CAPACITY * sizeof(AssetRecord), (unsigned char*)assets, directory);
     RELEASE(universeLock);
 
     if (savedSize == ASSETS_CAPACITY * sizeof(AssetRecord))
     {
-        setNumber(message, savedSize, TRUE);
-        appendText(message, L" bytes of the universe data are saved (");
+        setNumber(message, writtenSize, TRUE);
+        appendText(message, L" bytes of the universe data are written (");
         appendNumber(message, (__rdtsc() - beginningTick) * 1000000 / frequency, TRUE);
         appendText(message, L" microseconds).");
         logToConsole(message);
@@ -772,11 +1089,15 @@ static bool saveUniverse(const CHAR16* fileName = UNIVERSE_FILE_NAME, const CHAR
     return false;
 }
 
-static bool loadUniverse(const CHAR16* fileName = UNIVERSE_FILE_NAME, CHAR16* directory = NULL, bool rebuildIndexLists = true)
+// If incremental is true, the universe is loaded from chunk files written by saveUniverse() with incremental = true.
+// A universe of an older layout version is migrated to the current one (not possible if rebuildIndexLists is false).
+static bool loadUniverse(const CHAR16* fileName = UNIVERSE_FILE_NAME, CHAR16* directory = NULL, bool rebuildIndexLists = true, bool incremental = false)
 {
     PROFILE_SCOPE();
 
-    long long loadedSize = load(fileName, ASSETS_CAPACITY * sizeof(AssetRecord), (unsigned char*)assets, directory);
+    long long loadedSize = (incremental)
+        ? loadIncrementalFile(fileName, ASSETS_CAPACITY * sizeof(AssetRecord), (unsigned char*)assets, directory)
+        : load(fileName, ASSETS_CAPACITY * sizeof(AssetRecord), (unsigned char*)assets, directory);
     if (loadedSize != ASSETS_CAPACITY * sizeof(AssetRecord))
     {
         logStatusToConsole(L"EFI_FILE_PROTOCOL.Read() reads invalid number of bytes", loadedSize, __LINE__);
@@ -784,6 +1105,27 @@ static bool loadUniverse(const CHAR16* fileName = UNIVERSE_FILE_NAME, CHAR16* di
         return false;
     }
 
+    if (!isUniverseLayoutCurrent())
+    {
+        // Snapshots need the saved index lists, which don't match after migration
+        if (!rebuildIndexLists)
+        {
+            logToConsole(L"Universe of old layout version cannot be loaded from snapshot");
+            return false;
+        }
+
+        setText(message, L"Migrating universe to layout version ");
+        appendNumber(message, UNIVERSE_LAYOUT_VERSION, FALSE);
+        appendText(message, L"...");
+        logToConsole(message);
+
+        // reinsert all records (also rebuilds index lists)
+        ACQUIRE(universeLock);
+        reorganizeUniverse();
+        RELEASE(universeLock);
+        return true;
+    }
+
     if (rebuildIndexLists)
         as.indexLists.rebuild();
 
@@ -818,97 +1160,7 @@ static bool loadSnapshotUniverseIndex(const CHAR16* fileName, CHAR16* directory
 
 static void assetsEndEpoch()
 {
-    PROFILE_SCOPE();
-
     ACQUIRE(universeLock);
-
-    // rebuild asset hash map, getting rid of all elements with zero shares
-    AssetRecord* reorgAssets = (AssetRecord*)commonBuffers.acquireBuffer(universeSizeInBytes);
-    setMem(reorgAssets, universeSizeInBytes, 0);
-    for (unsigned int i = 0; i < ASSETS_CAPACITY; i++)
-    {
-        if (assets[i].varStruct.possession.type == POSSESSION
-            && assets[i].varStruct.possession.numberOfShares > 0)
-        {
-            const unsigned int oldOwnershipIndex = assets[i].varStruct.possession.ownershipIndex;
-            const unsigned int oldIssuanceIndex = assets[oldOwnershipIndex].varStruct.ownership.issuanceIndex;
-            const m256i& issuerPublicKey = assets[oldIssuanceIndex].varStruct.issuance.publicKey;
-            char* name = assets[oldIssuanceIndex].varStruct.issuance.name;
-            int issuanceIndex = issuerPublicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
-        iteration2:
-            if (reorgAssets[issuanceIndex].varStruct.issuance.type == EMPTY
-                || (reorgAssets[issuanceIndex].varStruct.issuance.type == ISSUANCE
-                    && ((*((unsigned long long*)reorgAssets[issuanceIndex].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) == ((*((unsigned long long*)name)) & 0xFFFFFFFFFFFFFF)
-                    && reorgAssets[issuanceIndex].varStruct.issuance.publicKey == issuerPublicKey))
-            {
-                if (reorgAssets[issuanceIndex].varStruct.issuance.type == EMPTY)
-                {
-                    copyMem(&reorgAssets[issuanceIndex], &assets[oldIssuanceIndex], sizeof(AssetRecord));
-                }
-
-                const m256i& ownerPublicKey = assets[oldOwnershipIndex].varStruct.ownership.publicKey;
-                int ownershipIndex = ownerPublicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
-            iteration3:
-                if (reorgAssets[ownershipIndex].varStruct.ownership.type == EMPTY
-                    || (reorgAssets[ownershipIndex].varStruct.ownership.type == OWNERSHIP
-                        && reorgAssets[ownershipIndex].varStruct.ownership.managingContractIndex == assets[oldOwnershipIndex].varStruct.ownership.managingContractIndex
-                        && reorgAssets[ownershipIndex].varStruct.ownership.issuanceIndex == issuanceIndex
-                        && reorgAssets[ownershipIndex].varStruct.ownership.publicKey == ownerPublicKey))
-                {
-                    if (reorgAssets[ownershipIndex].varStruct.ownership.type == EMPTY)
-                    {
-                        reorgAssets[ownershipIndex].varStruct.ownership.publicKey = ownerPublicKey;
-                        reorgAssets[ownershipIndex].varStruct.ownership.type = OWNERSHIP;
-                        reorgAssets[ownershipIndex].varStruct.ownership.managingContractIndex = assets[oldOwnershipIndex].varStruct.ownership.managingContractIndex;
-                        reorgAssets[ownershipIndex].varStruct.ownership.issuanceIndex = issuanceIndex;
-                    }
-                    reorgAssets[ownershipIndex].varStruct.ownership.numberOfShares += assets[i].varStruct.possession.numberOfShares;
-
-                    int possessionIndex = assets[i].varStruct.possession.publicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
-                iteration4:
-                    if (reorgAssets[possessionIndex].varStruct.possession.type == EMPTY
-                        || (reorgAssets[possessionIndex].varStruct.possession.type == POSSESSION
-                            && reorgAssets[possessionIndex].varStruct.possession.managingContractIndex == assets[i].varStruct.possession.managingContractIndex
-                            && reorgAssets[possessionIndex].varStruct.possession.ownershipIndex == ownershipIndex
-                            && reorgAssets[possessionIndex].varStruct.possession.publicKey == assets[i].varStruct.possession.publicKey))
-                    {
-                        if (reorgAssets[possessionIndex].varStruct.possession.type == EMPTY)
-                        {
-                            reorgAssets[possessionIndex].varStruct.possession.publicKey = assets[i].varStruct.possession.publicKey;
-                            reorgAssets[possessionIndex].varStruct.possession.type = POSSESSION;
-                            reorgAssets[possessionIndex].varStruct.possession.managingContractIndex = assets[i].varStruct.possession.managingContractIndex;
-                            reorgAssets[possessionIndex].varStruct.possession.ownershipIndex = ownershipIndex;
-                        }
-                        reorgAssets[possessionIndex].varStruct.possession.numberOfShares += assets[i].varStruct.possession.numberOfShares;
-                    }
-                    else
-                    {
-                        possessionIndex = (possessionIndex + 1) & (ASSETS_CAPACITY - 1);
-
-                        goto iteration4;
-                    }
-                }
-                else
-                {
-                    ownershipIndex = (ownershipIndex + 1) & (ASSETS_CAPACITY - 1);
-
-                    goto iteration3;
-                }
-            }
-            else
-            {
-                issuanceIndex = (issuanceIndex + 1) & (ASSETS_CAPACITY - 1);
-
-                goto iteration2;
-            }
-        }
-    }
-    copyMem(assets, reorgAssets, ASSETS_CAPACITY * sizeof(AssetRecord));
-    commonBuffers.releaseBuffer(reorgAssets);
-
-    setMem(assetChangeFlags, ASSETS_CAPACITY / 8, 0xFF);
-
-    as.indexLists.rebuild();
-
+    reorganizeUniverse();
     RELEASE(universeLock);
 }
@@ -4,6 +4,25 @@
 
 #include "network_core/peers.h"
 
+// Get index of first issuance (if issuanceIndex is NO_ASSET_INDEX) or of the issuance following issuanceIndex in the
+// list of all issuances. Reads without universeLock.
+static unsigned int readNextIssuanceIndex(unsigned int issuanceIndex)
+{
+    unsigned int nextIndex;
+    long long sequence;
+    do
+    {
+        sequence = universeSequenceLock.beginRead();
+        nextIndex = (issuanceIndex < ASSETS_CAPACITY) ? as.indexLists.nextIdx[issuanceIndex] : as.indexLists.issuancesFirstIdx;
+    } while (!universeSequenceLock.validateRead(sequence));
+    return nextIndex;
+}
+
+// The asset request handlers don't lock universeLock, so they don't block the tick and contract processors and
+// each other. Each record is copied optimistically and the copy is repeated if the universe has been changed
+// meanwhile (see universeSequenceLock). Each response is consistent in itself, but the responses to one request
+// may reflect different states of the universe.
+
 static void processRequestIssuedAssets(Peer* peer, RequestResponseHeader* header)
 {
     RespondIssuedAssets response;
@@ -12,35 +31,29 @@ static void processRequestIssuedAssets(Peer* peer, RequestResponseHeader* header
         return;
     RequestIssuedAssets* request = header->getPayload<RequestIssuedAssets>();
 
-    unsigned int universeIndex = request->publicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
-
-    ACQUIRE(universeLock);
-
-iteration:
-    if (universeIndex >= ASSETS_CAPACITY
-        || assets[universeIndex].varStruct.issuance.type == EMPTY)
-    {
-        enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
-    }
-    else
+    // issuances are placed by issuer and asset name, so check the list of all issuances
+    for (unsigned int universeIndex = readNextIssuanceIndex(NO_ASSET_INDEX); universeIndex < ASSETS_CAPACITY; universeIndex = readNextIssuanceIndex(universeIndex))
     {
-        if (assets[universeIndex].varStruct.issuance.type == ISSUANCE
-            && assets[universeIndex].varStruct.issuance.publicKey == request->publicKey)
+        bool found;
+        long long sequence;
+        do
+        {
+            sequence = universeSequenceLock.beginRead();
+            found = assets[universeIndex].varStruct.issuance.publicKey == request->publicKey;
+            if (found)
+                copyMem(&response.asset, &assets[universeIndex], sizeof(AssetRecord));
+        } while (!universeSequenceLock.validateRead(sequence));
+
+        if (found)
         {
-            copyMem(&response.asset, &assets[universeIndex], sizeof(AssetRecord));
             response.tick = system.tick;
             response.universeIndex = universeIndex;
             getSiblings<ASSETS_DEPTH>(response.universeIndex, assetDigests, response.siblings);
 
             enqueueResponse(peer, sizeof(response), RespondIssuedAssets::type(), header->dejavu(), &response);
         }
-
-        universeIndex = (universeIndex + 1) & (ASSETS_CAPACITY - 1);
-
-        goto iteration;
     }
-
-    RELEASE(universeLock);
+    enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
 }
 
 static void processRequestOwnedAssets(Peer* peer, RequestResponseHeader* header)
@@ -51,36 +64,41 @@ static void processRequestOwnedAssets(Peer* peer, RequestResponseHeader* header)
         return;
     RequestOwnedAssets* request = header->getPayload<RequestOwnedAssets>();
 
-    unsigned int universeIndex = request->publicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
-
-    ACQUIRE(universeLock);
-
-iteration:
-    if (universeIndex >= ASSETS_CAPACITY
-        || assets[universeIndex].varStruct.issuance.type == EMPTY)
-    {
-        enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
-    }
-    else
+    // ownerships are placed by owner and issuance, so probe the hash map for the owner of each issuance
+    for (unsigned int issuanceIndex = readNextIssuanceIndex(NO_ASSET_INDEX); issuanceIndex < ASSETS_CAPACITY; issuanceIndex = readNextIssuanceIndex(issuanceIndex))
     {
-        if (assets[universeIndex].varStruct.issuance.type == OWNERSHIP
-            && assets[universeIndex].varStruct.issuance.publicKey == request->publicKey)
+        for (unsigned int universeIndex = ownershipHashIndex(request->publicKey, issuanceIndex); ; universeIndex = (universeIndex + 1) & (ASSETS_CAPACITY - 1))
         {
-            copyMem(&response.asset, &assets[universeIndex], sizeof(AssetRecord));
-            copyMem(&response.issuanceAsset, &assets[assets[universeIndex].varStruct.ownership.issuanceIndex], sizeof(AssetRecord));
-            response.tick = system.tick;
-            response.universeIndex = universeIndex;
-            getSiblings<ASSETS_DEPTH>(response.universeIndex, assetDigests, response.siblings);
+            bool empty, found;
+            long long sequence;
+            do
+            {
+                sequence = universeSequenceLock.beginRead();
+                const AssetRecord& record = assets[universeIndex];
+                empty = record.varStruct.issuance.type == EMPTY;
+                found = record.varStruct.ownership.type == OWNERSHIP
+                    && record.varStruct.ownership.issuanceIndex == issuanceIndex
+                    && record.varStruct.ownership.publicKey == request->publicKey;
+                if (found)
+                {
+                    copyMem(&response.asset, &record, sizeof(AssetRecord));
+                    copyMem(&response.issuanceAsset, &assets[issuanceIndex], sizeof(AssetRecord));
+                }
+            } while (!universeSequenceLock.validateRead(sequence));
+
+            if (empty)
+                break;
+            if (found)
+            {
+                response.tick = system.tick;
+                response.universeIndex = universeIndex;
+                getSiblings<ASSETS_DEPTH>(response.universeIndex, assetDigests, response.siblings);
 
-            enqueueResponse(peer, sizeof(response), RespondOwnedAssets::type(), header->dejavu(), &response);
+                enqueueResponse(peer, sizeof(response), RespondOwnedAssets::type(), header->dejavu(), &response);
+            }
         }
-
-        universeIndex = (universeIndex + 1) & (ASSETS_CAPACITY - 1);
-
-        goto iteration;
     }
-
-    RELEASE(universeLock);
+    enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
 }
 
 static void processRequestPossessedAssets(Peer* peer, RequestResponseHeader* header)
@@ -91,54 +109,91 @@ static void processRequestPossessedAssets(Peer* peer, RequestResponseHeader* hea
         return;
     RequestPossessedAssets* request = header->getPayload<RequestPossessedAssets>();
 
-    unsigned int universeIndex = request->publicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
-
-    ACQUIRE(universeLock);
-
-iteration:
-    if (universeIndex >= ASSETS_CAPACITY
-        || assets[universeIndex].varStruct.issuance.type == EMPTY)
+    // possessions are placed by possessor and issuance, so probe the hash map for the possessor of each issuance
+    for (unsigned int issuanceIndex = readNextIssuanceIndex(NO_ASSET_INDEX); issuanceIndex < ASSETS_CAPACITY; issuanceIndex = readNextIssuanceIndex(issuanceIndex))
     {
-        enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
-    }
-    else
-    {
-        if (assets[universeIndex].varStruct.issuance.type == POSSESSION
-            && assets[universeIndex].varStruct.issuance.publicKey == request->publicKey)
+        for (unsigned int universeIndex = possessionHashIndex(request->publicKey, issuanceIndex); ; universeIndex = (universeIndex + 1) & (ASSETS_CAPACITY - 1))
         {
-            copyMem(&response.asset, &assets[universeIndex], sizeof(AssetRecord));
-            copyMem(&response.ownershipAsset, &assets[assets[universeIndex].varStruct.possession.ownershipIndex], sizeof(AssetRecord));
-            copyMem(&response.issuanceAsset, &assets[assets[assets[universeIndex].varStruct.possession.ownershipIndex].varStruct.ownership.issuanceIndex], sizeof(AssetRecord));
-            response.tick = system.tick;
-            response.universeIndex = universeIndex;
-            getSiblings<ASSETS_DEPTH>(response.universeIndex, assetDigests, response.siblings);
+            bool empty, found;
+            long long sequence;
+            do
+            {
+                sequence = universeSequenceLock.beginRead();
+                const AssetRecord& record = assets[universeIndex];
+                const unsigned int ownershipIndex = record.varStruct.possession.ownershipIndex;
+                empty = record.varStruct.issuance.type == EMPTY;
+                found = record.varStruct.possession.type == POSSESSION
+                    && record.varStruct.possession.publicKey == request->publicKey
+                    && ownershipIndex < ASSETS_CAPACITY // may be invalid until the read is validated
+                    && assets[ownershipIndex].varStruct.ownership.issuanceIndex == issuanceIndex;
+                if (found)
+                {
+                    copyMem(&response.asset, &record, sizeof(AssetRecord));
+                    copyMem(&response.ownershipAsset, &assets[ownershipIndex], sizeof(AssetRecord));
+                    copyMem(&response.issuanceAsset, &assets[issuanceIndex], sizeof(AssetRecord));
+                }
+            } while (!universeSequenceLock.validateRead(sequence));
+
+            if (empty)
+                break;
+            if (found)
+            {
+                response.tick = system.tick;
+                response.universeIndex = universeIndex;
+                getSiblings<ASSETS_DEPTH>(response.universeIndex, assetDigests, response.siblings);
 
-            enqueueResponse(peer, sizeof(response), RespondPossessedAssets::type(), header->dejavu(), &response);
+                enqueueResponse(peer, sizeof(response), RespondPossessedAssets::type(), header->dejavu(), &response);
+            }
         }
-
-        universeIndex = (universeIndex + 1) & (ASSETS_CAPACITY - 1);
-
-        goto iteration;
     }
-
-    RELEASE(universeLock);
+    enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
 }
 
-static void processRequestAssetsSendRecord(Peer* peer, RequestResponseHeader* responseHeader, unsigned int universeIndex)
+// Copy record at universeIndex into the response payload (without siblings). Call while reading optimistically.
+static void processRequestAssetsCopyRecord(RequestResponseHeader* responseHeader, unsigned int universeIndex)
 {
-    if (universeIndex >= ASSETS_CAPACITY)
-        return;
+    ASSERT(universeIndex < ASSETS_CAPACITY);
     RespondAssetsWithSiblings* payload = responseHeader->getPayload<RespondAssetsWithSiblings>();
     copyMemory(payload->asset, assets[universeIndex]);
-    payload->tick = system.tick;
     payload->universeIndex = universeIndex;
+}
+
+// Add tick and siblings (if requested) to response with record copied by processRequestAssetsCopyRecord() and send it
+static void processRequestAssetsSendRecord(Peer* peer, RequestResponseHeader* responseHeader)
+{
+    RespondAssetsWithSiblings* payload = responseHeader->getPayload<RespondAssetsWithSiblings>();
+    payload->tick = system.tick;
     if (responseHeader->size() == sizeof(RequestResponseHeader) + sizeof(RespondAssetsWithSiblings))
     {
-        getSiblings<ASSETS_DEPTH>(universeIndex, assetDigests, payload->siblings);
+        getSiblings<ASSETS_DEPTH>(payload->universeIndex, assetDigests, payload->siblings);
     }
     enqueueResponse(peer, responseHeader);
 }
 
+// Send the records found by iter (AssetIssuanceIterator, AssetOwnershipIterator, or AssetPossessionIterator, whose
+// current position has been validated), recordIndex is the iterator's method returning the index of the record to
+// send. Each step copies the record and advances the iterator optimistically, restarting from the previous
+// position if the universe has been changed meanwhile.
+template <typename AssetIterator>
+static void processRequestAssetsSendRecords(Peer* peer, RequestResponseHeader* responseHeader, AssetIterator& iter,
+    unsigned int (AssetIterator::*recordIndex)() const)
+{
+    while (!iter.reachedEnd())
+    {
+        const AssetIterator position = iter;
+        long long sequence;
+        do
+        {
+            iter = position;
+            sequence = universeSequenceLock.beginRead();
+            processRequestAssetsCopyRecord(responseHeader, (iter.*recordIndex)());
+            iter.next();
+        } while (!universeSequenceLock.validateRead(sequence));
+
+        processRequestAssetsSendRecord(peer, responseHeader);
+    }
+}
+
 static void processRequestAssets(Peer* peer, RequestResponseHeader* header)
 {
     // check size of received message (request by universe index may be smaller than sizeof(RequestAssets))
@@ -187,14 +242,14 @@ static void processRequestAssets(Peer* peer, RequestResponseHeader* header)
         }
 
         // iterate through assets records with filter
-        ACQUIRE(universeLock);
+        long long sequence = universeSequenceLock.beginRead();
         AssetIssuanceIterator iter(issuanceFilter);
-        while (!iter.reachedEnd())
+        while (!universeSequenceLock.validateRead(sequence))
         {
-            processRequestAssetsSendRecord(peer, &response.header, iter.issuanceIndex());
-            iter.next();
+            sequence = universeSequenceLock.beginRead();
+            iter.begin(issuanceFilter);
         }
-        RELEASE(universeLock);
+        processRequestAssetsSendRecords(peer, &response.header, iter, &AssetIssuanceIterator::issuanceIndex);
     }
     break;
 
@@ -223,14 +278,14 @@ static void processRequestAssets(Peer* peer, RequestResponseHeader* header)
         if (request->assetReqType == RequestAssets::requestOwnershipRecords)
         {
             // iterate through asset ownership records with filter
-            ACQUIRE(universeLock);
+            long long sequence = universeSequenceLock.beginRead();
             AssetOwnershipIterator iter(asset, ownershipFilter);
-            while (!iter.reachedEnd())
+            while (!universeSequenceLock.validateRead(sequence))
             {
-                processRequestAssetsSendRecord(peer, &response.header, iter.ownershipIndex());
-                iter.next();
+                sequence = universeSequenceLock.beginRead();
+                iter.begin(asset, ownershipFilter);
             }
-            RELEASE(universeLock);
+            processRequestAssetsSendRecords(peer, &response.header, iter, &AssetOwnershipIterator::ownershipIndex);
         }
         else
         {
@@ -252,23 +307,31 @@ static void processRequestAssets(Peer* peer, RequestResponseHeader* header)
             }
 
             // iterate through asset possession records with filter
-            ACQUIRE(universeLock);
+            long long sequence = universeSequenceLock.beginRead();
             AssetPossessionIterator iter(asset, ownershipFilter, possessionFilter);
-            while (!iter.reachedEnd())
+            while (!universeSequenceLock.validateRead(sequence))
             {
-                processRequestAssetsSendRecord(peer, &response.header, iter.possessionIndex());
-                iter.next();
+                sequence = universeSequenceLock.beginRead();
+                iter.begin(asset, ownershipFilter, possessionFilter);
             }
-            RELEASE(universeLock);
+            processRequestAssetsSendRecords(peer, &response.header, iter, &AssetPossessionIterator::possessionIndex);
         }
     }
     break;
 
     case RequestAssets::requestByUniverseIdx:
     {
-        ACQUIRE(universeLock);
-        processRequestAssetsSendRecord(peer, &response.header, request->byUniverseIdx.universeIdx);
-        RELEASE(universeLock);
+        const unsigned int universeIndex = request->byUniverseIdx.universeIdx;
+        if (universeIndex < ASSETS_CAPACITY)
+        {
+            long long sequence;
+            do
+            {
+                sequence = universeSequenceLock.beginRead();
+                processRequestAssetsCopyRecord(&response.header, universeIndex);
+            } while (!universeSequenceLock.validateRead(sequence));
+            processRequestAssetsSendRecord(peer, &response.header);
+        }
     }
     break;
     }
@@ -23,6 +23,7 @@
 #include "system.h"
 
 #include <lib/platform_common/long_jump.h>
+#include <lib/platform_common/processor.h>
 
 
 enum ContractError
@@ -57,6 +58,10 @@ GLOBAL_VAR_DECL ContractExecErrorData contractExecutionErrorData[contractCount];
 GLOBAL_VAR_DECL ReadWriteLock contractStateLock[contractCount];
 GLOBAL_VAR_DECL unsigned char* contractStates[contractCount];
 
+// The leaves of the K12 digests of large contract states are computed in parallel by the tick processor and the
+// request processors helping with contractDigestJob (see KangarooTwelveParallel()).
+GLOBAL_VAR_DECL ChunkedJob contractDigestJob;
+
 // Total contract execution time (as CPU clock cycles) accumulated over the whole runtime of the node (reset on restart, includes contract functions).
 GLOBAL_VAR_DECL volatile long long contractTotalExecutionTime[contractCount];
 GLOBAL_VAR_DECL ExecutionTimeAccumulator executionTimeAccumulator;
@@ -75,6 +80,14 @@ static void __markContractStateDirty(unsigned int contractIndex)
         contractStateChangeFlags[contractIndex >> 6] |= (1ULL << (contractIndex & 63));
 }
 
+// Merkle tree of contract state digests, updated by getComputerDigest()
+GLOBAL_VAR_DECL m256i contractStateDigests[MAX_NUMBER_OF_CONTRACTS * 2 - 1];
+static constexpr unsigned long long contractStateDigestsSizeInBytes = sizeof(contractStateDigests);
+
+// Run-time of K12 of contract states for comparing different versions of K12 (first 500 measurements)
+GLOBAL_VAR_DECL unsigned long long K12MeasurementsCount GLOBAL_VAR_INIT(0);
+GLOBAL_VAR_DECL unsigned long long K12MeasurementsSum GLOBAL_VAR_INIT(0);
+
 // Forward declaration for getContractFeeReserve (defined in qpi_spectrum_impl.h)
 static long long getContractFeeReserve(unsigned int contractIndex);
 
@@ -243,28 +256,107 @@ static void deinitContractExec()
     contractActionTracker.freeBuffer();
 }
 
+// Should only be called from tick processor to avoid concurrent state changes, which can cause race conditions as detailed in FIXME below.
+static void getComputerDigest(m256i& digest)
+{
+    PROFILE_SCOPE();
+
+    unsigned int digestIndex;
+    for (digestIndex = 0; digestIndex < MAX_NUMBER_OF_CONTRACTS; digestIndex++)
+    {
+        if (contractStateChangeFlags[digestIndex >> 6] & (1ULL << (digestIndex & 63)))
+        {
+            const unsigned long long size = digestIndex < contractCount ? contractDescriptions[digestIndex].stateSize : 0;
+            if (!size)
+            {
+                contractStateDigests[digestIndex] = m256i::zero();
+            }
+            else
+            {
+                // FIXME: We may have a race condition here if a digest is computed here by thread A, the state is changed
+                // + contractStateChangeFlags set afterwards by thread B and contractStateChangeFlags cleared below below
+                // by thread A. We then have a changed state but a cleared contractStateChangeFlags flag leading to wrong
+                // digest.
+                // This is currently avoided by calling getComputerDigest() from tick processor only (and in non-concurrent init)
+                contractStateLock[digestIndex].acquireRead();
+
+                const unsigned long long startTime = __rdtsc();
+                KangarooTwelveParallel(contractStates[digestIndex], (unsigned int)size, &contractStateDigests[digestIndex], 32, contractDigestJob);
+                const unsigned long long executionTime = __rdtsc() - startTime;
+
+                contractStateLock[digestIndex].releaseRead();
+
+                // K12 of state is included in contract execution time
+                _interlockedadd64(&contractTotalExecutionTime[digestIndex], executionTime);
+                // do not charge contract 0 state digest computation,
+                // only charge execution time if contract is already constructed/not in IPO
+                // TODO: enable this after adding proper tracking of contract state writes
+                //if (digestIndex > 0 && system.epoch >= contractDescriptions[digestIndex].constructionEpoch)
+                //{
+                //    executionTimeAccumulator.addTime(digestIndex, executionTime);
+                //}
+
+                // Gather data for comparing different versions of K12
+                if (K12MeasurementsCount < 500)
+                {
+                    K12MeasurementsSum += executionTime;
+                    K12MeasurementsCount++;
+                }
+            }
+        }
+    }
+    unsigned int previousLevelBeginning = 0;
+    unsigned int numberOfLeafs = MAX_NUMBER_OF_CONTRACTS;
+    while (numberOfLeafs > 1)
+    {
+        for (unsigned int i = 0; i < numberOfLeafs; i += 2)
+        {
+            if (contractStateChangeFlags[i >> 6] & (3ULL << (i & 63)))
+            {
+                KangarooTwelve64To32(&contractStateDigests[previousLevelBeginning + i], &contractStateDigests[digestIndex]);
+                contractStateChangeFlags[i >> 6] &= ~(3ULL << (i & 63));
+                contractStateChangeFlags[i >> 7] |= (1ULL << ((i >> 1) & 63));
+            }
+            digestIndex++;
+        }
+        previousLevelBeginning += numberOfLeafs;
+        numberOfLeafs >>= 1;
+    }
+    contractStateChangeFlags[0] = 0;
+
+    digest = contractStateDigests[(MAX_NUMBER_OF_CONTRACTS * 2 - 1) - 1];
+}
+
 // Acquire lock of an currently unused stack (may block if all in use)
 // stacksToIgnore > 0 can be passed by low priority tasks to keep some stacks reserved for high prio purposes.
+// Each processor first tries its preferred stack, so processors don't contend for the same locks and the stack
+// memory is likely still in the processor's cache. If it is in use, the other stacks are tried round-robin.
 static void acquireContractLocalsStack(int& stackIdx, unsigned int stacksToIgnore = 0)
 {
     static_assert(NUMBER_OF_CONTRACT_EXECUTION_BUFFERS >= 2, "NUMBER_OF_CONTRACT_EXECUTION_BUFFERS should be at least 2.");
     ASSERT(stackIdx < 0);
     ASSERT(stacksToIgnore < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
 
-    long waitingCount = _InterlockedIncrement(&contractLocalsStackLockWaitingCount);
-    if (contractLocalsStackLockWaitingCountMax < waitingCount)
-        contractLocalsStackLockWaitingCountMax = waitingCount;
-
-    int i = stacksToIgnore;
-    BEGIN_WAIT_WHILE(TRY_ACQUIRE(contractLocalsStackLock[i]) == false)
+    int i = stacksToIgnore + (int)(getRunningProcessorID() % (NUMBER_OF_CONTRACT_EXECUTION_BUFFERS - stacksToIgnore));
+    if (!TRY_ACQUIRE(contractLocalsStackLock[i]))
     {
+        long waitingCount = _InterlockedIncrement(&contractLocalsStackLockWaitingCount);
+        if (contractLocalsStackLockWaitingCountMax < waitingCount)
+            contractLocalsStackLockWaitingCountMax = waitingCount;
+
         ++i;
         if (i == NUMBER_OF_CONTRACT_EXECUTION_BUFFERS)
             i = stacksToIgnore;
-    }
-    END_WAIT_WHILE();
+        BEGIN_WAIT_WHILE(TRY_ACQUIRE(contractLocalsStackLock[i]) == false)
+        {
+            ++i;
+            if (i == NUMBER_OF_CONTRACT_EXECUTION_BUFFERS)
+                i = stacksToIgnore;
+        }
+        END_WAIT_WHILE();
 
-    _InterlockedDecrement(&contractLocalsStackLockWaitingCount);
+        _InterlockedDecrement(&contractLocalsStackLockWaitingCount);
+    }
 
     stackIdx = i;
     ASSERT(stackIdx >= 0);
@@ -280,6 +372,11 @@ static void releaseContractLocalsStack(int& stackIdx)
     ASSERT(stackIdx >= 0);
     ASSERT(stackIdx < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
     ASSERT(contractLocalsStackLock[stackIdx]);
+
+    // Clear the memory used by this execution in one go while it is still in cache, so the zeroed allocations
+    // of the next execution on this stack don't need to clear it.
+    contractLocalsStack[stackIdx].zeroUnused();
+
     RELEASE(contractLocalsStackLock[stackIdx]);
     stackIdx = -1;
 }
@@ -301,7 +398,7 @@ void* QPI::QpiContextFunctionCall::__qpiAllocLocals(unsigned int sizeOfLocals) c
         // abort execution of contract here
         __qpiAbort(ContractErrorAllocLocalsFailed);
     }
-    void* p = contractLocalsStack[_stackIndex].allocate(sizeOfLocals);
+    void* p = contractLocalsStack[_stackIndex].allocateZeroed(sizeOfLocals);
     if (!p)
     {
 #ifndef NDEBUG
@@ -320,7 +417,6 @@ void* QPI::QpiContextFunctionCall::__qpiAllocLocals(unsigned int sizeOfLocals) c
         // abort execution of contract here
         __qpiAbort(ContractErrorAllocLocalsFailed);
     }
-    setMem(p, sizeOfLocals, 0);
     return p;
 }
 
@@ -761,10 +857,9 @@ bool QPI::QpiContextProcedureCall::__qpiCallSystemProc(unsigned int sysProcContr
 
     // Alloc locals
     unsigned short localsSize = contractSystemProcedureLocalsSizes[sysProcContractIndex][sysProcId];
-    char* localsBuffer = contractLocalsStack[_stackIndex].allocate(localsSize);
+    char* localsBuffer = contractLocalsStack[_stackIndex].allocateZeroed(localsSize);
     if (!localsBuffer)
         __qpiAbort(ContractErrorAllocLocalsFailed);
-    setMem(localsBuffer, localsSize, 0);
 
     // Run procedure
     contractSystemProcedures[sysProcContractIndex][sysProcId](*context, state, &input, &output, localsBuffer);
@@ -1028,10 +1123,9 @@ private:
         else
         {
             // locals required: use stack (should not block because stack 0 is reserved for procedures)
-            char* localsBuffer = contractLocalsStack[_stackIndex].allocate(localsSize);
+            char* localsBuffer = contractLocalsStack[_stackIndex].allocateZeroed(localsSize);
             if (!localsBuffer)
                 __qpiAbort(ContractErrorAllocLocalsFailed);
-            setMem(localsBuffer, localsSize, 0);
 
             // call system proc
             startTime = __rdtsc();
@@ -1098,7 +1192,7 @@ struct QpiContextUserProcedureCall : public QPI::QpiContextProcedureCall
         unsigned short fullInputSize = contractUserProcedureInputSizes[_currentContractIndex][inputType];
         outputSize = contractUserProcedureOutputSizes[_currentContractIndex][inputType];
         unsigned int localsSize = contractUserProcedureLocalsSizes[_currentContractIndex][inputType];
-        char* inputBuffer = contractLocalsStack[_stackIndex].allocate(fullInputSize + outputSize + localsSize);
+        char* inputBuffer = contractLocalsStack[_stackIndex].allocateZeroed(fullInputSize + outputSize + localsSize);
         if (!inputBuffer)
         {
 #ifndef NDEBUG
@@ -1126,18 +1220,13 @@ struct QpiContextUserProcedureCall : public QPI::QpiContextProcedureCall
 
         outputBuffer = inputBuffer + fullInputSize;
         char* localsBuffer = outputBuffer + outputSize;
-        if (inputSize < fullInputSize)
-        {
-            // less input data than expected by contract -> fill with 0
-            setMem(inputBuffer + inputSize, fullInputSize - inputSize, 0);
-        }
-        else if (inputSize > fullInputSize)
+        if (inputSize > fullInputSize)
         {
             // more input data than expected by contract -> discard additional bytes
             inputSize = fullInputSize;
         }
+        // less input data than expected by contract -> remaining bytes stay 0
         copyMem(inputBuffer, inputPtr, inputSize);
-        setMem(outputBuffer, outputSize + localsSize, 0);
 
         // acquire lock of contract state for writing (shouldn't block because 1 stack is not used by functions and thus kept free for procedures)
         contractStateLock[_currentContractIndex].acquireWrite();
@@ -1218,7 +1307,7 @@ struct QpiContextUserFunctionCall : public QPI::QpiContextFunctionCall
         unsigned short fullInputSize = contractUserFunctionInputSizes[_currentContractIndex][inputType];
         outputSize = contractUserFunctionOutputSizes[_currentContractIndex][inputType];
         unsigned int localsSize = contractUserFunctionLocalsSizes[_currentContractIndex][inputType];
-        char* inputBuffer = contractLocalsStack[_stackIndex].allocate(fullInputSize + outputSize + localsSize);
+        char* inputBuffer = contractLocalsStack[_stackIndex].allocateZeroed(fullInputSize + outputSize + localsSize);
         if (!inputBuffer)
         {
 #ifndef NDEBUG
@@ -1245,18 +1334,13 @@ struct QpiContextUserFunctionCall : public QPI::QpiContextFunctionCall
         }
         outputBuffer = inputBuffer + fullInputSize;
         char* localsBuffer = outputBuffer + outputSize;
-        if (inputSize < fullInputSize)
-        {
-            // less input data than expected by contract -> fill with 0
-            setMem(inputBuffer + inputSize, fullInputSize - inputSize, 0);
-        }
-        else if (inputSize > fullInputSize)
+        if (inputSize > fullInputSize)
         {
             // more input data than expected by contract -> discard additional bytes
             inputSize = fullInputSize;
         }
+        // less input data than expected by contract -> remaining bytes stay 0
         copyMem(inputBuffer, inputPtr, inputSize);
-        setMem(outputBuffer, outputSize + localsSize, 0);
 
         // set error handler for canceling
         contractExecutionErrorData[_stackIndex].errorCode = NoContractError;
@@ -1339,7 +1423,7 @@ struct QpiContextUserProcedureNotificationCall : public QPI::QpiContextProcedure
         contractStateLock[_currentContractIndex].acquireWrite();
 
         QPI::NoData output;
-        char* input = contractLocalsStack[_stackIndex].allocate(notif.inputSize + notif.localsSize);
+        char* input = contractLocalsStack[_stackIndex].allocateZeroed(notif.inputSize + notif.localsSize);
         if (!input)
         {
 #ifndef NDEBUG
@@ -1362,7 +1446,6 @@ struct QpiContextUserProcedureNotificationCall : public QPI::QpiContextProcedure
         }
         char* locals = input + notif.inputSize;
         copyMem(input, inputPtr, notif.inputSize);
-        setMem(locals, notif.localsSize, 0);
 
         // call user procedure
         const unsigned long long startTick = __rdtsc();
@@ -1423,10 +1506,9 @@ struct QpiContextMigrateProcedureCall : public QPI::QpiContextProcedureCall
         else
         {
             // locals required: use stack (should not block because stack 0 is reserved for procedures)
-            char* localsBuffer = contractLocalsStack[_stackIndex].allocate(localsSize);
+            char* localsBuffer = contractLocalsStack[_stackIndex].allocateZeroed(localsSize);
             if (!localsBuffer)
                 return ContractErrorAllocLocalsFailed;
-            setMem(localsBuffer, localsSize, 0);
 
             // call system proc
             startTime = __rdtsc();
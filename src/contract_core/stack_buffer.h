@@ -1,11 +1,14 @@
 #pragma once
 
 #include "../platform/debugging.h"
+#include "../platform/memory.h"
 
 // Last-In-First-Out storage for data of different size.
 // Size type used for StackBuffer needs to be unsigned.
 // Supports unwinding for analyzing stack in error handling and tagging blocks as "special" (for example those
 // with infos about locks that need to be released).
+// allocateZeroed() only clears the part of a block that may have been written before. zeroUnused() clears the
+// whole written part above the current size in one call, so following zeroed allocations are free.
 // #define TRACK_MAX_STACK_BUFFER_SIZE to collect info on how much stack is used.
 template <typename StackBufferSizeType, StackBufferSizeType bufferSize>
 struct StackBuffer
@@ -24,6 +27,7 @@ struct StackBuffer
     void init()
     {
         _allocatedSize = 0;
+        _dirtySize = bufferSize;
 #ifdef TRACK_MAX_STACK_BUFFER_SIZE
         _maxAllocatedSize = 0;
         _failedAllocAttempts = 0;
@@ -96,6 +100,8 @@ struct StackBuffer
          
         // update size
         _allocatedSize = newSize;
+        if (_dirtySize < _allocatedSize)
+            _dirtySize = _allocatedSize;
 #ifdef TRACK_MAX_STACK_BUFFER_SIZE
         ASSERT(_maxAllocatedSize <= bufferSize);
         if (_allocatedSize > _maxAllocatedSize)
@@ -111,6 +117,29 @@ struct StackBuffer
         return allocate(size, true);
     }
 
+    // Allocate storage in buffer that is set to zero.
+    char* allocateZeroed(SizeType size)
+    {
+        const SizeType dirtySize = _dirtySize;
+        char* allocatedBuffer = allocate(size);
+        if (allocatedBuffer)
+        {
+            // memory above dirtySize is still zero
+            const SizeType offset = SizeType(allocatedBuffer - _buffer);
+            if (offset < dirtySize)
+                setMem(allocatedBuffer, (size < dirtySize - offset) ? size : dirtySize - offset, 0);
+        }
+        return allocatedBuffer;
+    }
+
+    // Set the memory above the current size that may have been written since the last call to zero.
+    void zeroUnused()
+    {
+        if (_dirtySize > _allocatedSize)
+            setMem(_buffer + _allocatedSize, _dirtySize - _allocatedSize, 0);
+        _dirtySize = _allocatedSize;
+    }
+
     // Free storage allocated by last call to allocate().
     bool free()
     {
@@ -196,6 +225,9 @@ protected:
     // number of bytes used in buffer
     SizeType _allocatedSize;
 
+    // all bytes from this offset to the end of the buffer are zero
+    SizeType _dirtySize;
+
     // Flag used internally to indicate a special block (bit set in size on _buffer)
     static constexpr SizeType specialBlockFlag = (1 << (sizeof(StackBufferSizeType) * 8 - 1));
 
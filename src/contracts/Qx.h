@@ -220,8 +220,8 @@ public:
 		uint32 _transferFee; // Amount of qus
 		uint32 _tradeFee; // Number of billionths
 
-		Collection<AssetOrder, 2097152 * X_MULTIPLIER> _assetOrders;
-		Collection<EntityOrder, 2097152 * X_MULTIPLIER> _entityOrders;
+		// Ask and bid orders: book is issuer with assetName in u64._3 (see _issuerAndAssetName), owner is entity
+		OrderBook<EntityOrder, 2097152 * X_MULTIPLIER> _orders;
 
 		// TODO: change to "locals" variables and remove from state? -> every func/proc can define struct of "locals" that is passed as an argument (stored on stack structure per processor)
 		sint64 _elementIndex, _elementIndex2;
@@ -241,6 +241,37 @@ public:
 		_NumberOfReservedShares_output _numberOfReservedShares_output;
 	};
 
+	// State before switching from a pair of Collections to OrderBook (for MIGRATE)
+	struct OldStateData
+	{
+		uint64 _earnedAmount;
+		uint64 _distributedAmount;
+		uint64 _burnedAmount;
+
+		uint32 _assetIssuanceFee;
+		uint32 _transferFee;
+		uint32 _tradeFee;
+
+		Collection<AssetOrder, 2097152 * X_MULTIPLIER> _assetOrders; // pov: issuer with assetName in u64._3, priority: price of bid / -price of ask
+		Collection<EntityOrder, 2097152 * X_MULTIPLIER> _entityOrders; // pov: entity, priority: price of bid / -price of ask
+
+		sint64 _elementIndex, _elementIndex2;
+		id _issuerAndAssetName;
+		AssetOrder _assetOrder;
+		EntityOrder _entityOrder;
+		sint64 _price;
+		sint64 _fee;
+		AssetAskOrders_output::Order _assetAskOrder;
+		AssetBidOrders_output::Order _assetBidOrder;
+		EntityAskOrders_output::Order _entityAskOrder;
+		EntityBidOrders_output::Order _entityBidOrder;
+
+		TradeMessage _tradeMessage;
+
+		_NumberOfReservedShares_input _numberOfReservedShares_input;
+		_NumberOfReservedShares_output _numberOfReservedShares_output;
+	};
+
 
 protected:
 
@@ -254,17 +285,17 @@ protected:
 	{
 		output.numberOfShares = 0;
 
-		locals._elementIndex = state.get()._entityOrders.headIndex(qpi.invocator(), 0);
+		locals._elementIndex = state.get()._orders.ownerHeadIndex(qpi.invocator(), OrderBookSide::ask);
 		while (locals._elementIndex != NULL_INDEX)
 		{
-			locals._entityOrder = state.get()._entityOrders.element(locals._elementIndex);
+			locals._entityOrder = state.get()._orders.element(locals._elementIndex);
 			if (locals._entityOrder.assetName == input.assetName
 				&& locals._entityOrder.issuer == input.issuer)
 			{
 				output.numberOfShares += locals._entityOrder.numberOfShares;
 			}
 
-			locals._elementIndex = state.get()._entityOrders.nextElementIndex(locals._elementIndex);
+			locals._elementIndex = state.get()._orders.nextOwnerElementIndex(locals._elementIndex);
 		}
 	}
 
@@ -281,7 +312,6 @@ protected:
 	{
 		sint64 _elementIndex, _elementIndex2;
 		id _issuerAndAssetName;
-		AssetOrder _assetOrder;
 		AssetAskOrders_output::Order _assetAskOrder;
 	};
 
@@ -290,7 +320,7 @@ protected:
 		locals._issuerAndAssetName = input.issuer;
 		locals._issuerAndAssetName.u64._3 = input.assetName;
 
-		locals._elementIndex = state.get()._assetOrders.headIndex(locals._issuerAndAssetName, 0);
+		locals._elementIndex = state.get()._orders.headIndex(locals._issuerAndAssetName, OrderBookSide::ask);
 		locals._elementIndex2 = 0;
 		while (locals._elementIndex != NULL_INDEX
 			&& locals._elementIndex2 < 256)
@@ -301,15 +331,14 @@ protected:
 			}
 			else
 			{
-				locals._assetAskOrder.price = -state.get()._assetOrders.priority(locals._elementIndex);
-				locals._assetOrder = state.get()._assetOrders.element(locals._elementIndex);
-				locals._assetAskOrder.entity = locals._assetOrder.entity;
-				locals._assetAskOrder.numberOfShares = locals._assetOrder.numberOfShares;
+				locals._assetAskOrder.price = state.get()._orders.price(locals._elementIndex);
+				locals._assetAskOrder.entity = state.get()._orders.owner(locals._elementIndex);
+				locals._assetAskOrder.numberOfShares = state.get()._orders.element(locals._elementIndex).numberOfShares;
 				output.orders.set(locals._elementIndex2, locals._assetAskOrder);
 				locals._elementIndex2++;
 			}
 
-			locals._elementIndex = state.get()._assetOrders.nextElementIndex(locals._elementIndex);
+			locals._elementIndex = state.get()._orders.nextElementIndex(locals._elementIndex);
 		}
 
 		if (locals._elementIndex2 < 256)
@@ -330,7 +359,6 @@ protected:
 	{
 		sint64 _elementIndex, _elementIndex2;
 		id _issuerAndAssetName;
-		AssetOrder _assetOrder;
 		AssetBidOrders_output::Order _assetBidOrder;
 	};
 
@@ -339,32 +367,25 @@ protected:
 		locals._issuerAndAssetName = input.issuer;
 		locals._issuerAndAssetName.u64._3 = input.assetName;
 
-		locals._elementIndex = state.get()._assetOrders.headIndex(locals._issuerAndAssetName);
+		locals._elementIndex = state.get()._orders.headIndex(locals._issuerAndAssetName, OrderBookSide::bid);
 		locals._elementIndex2 = 0;
 		while (locals._elementIndex != NULL_INDEX
 			&& locals._elementIndex2 < 256)
 		{
-			locals._assetBidOrder.price = state.get()._assetOrders.priority(locals._elementIndex);
-
-			if (locals._assetBidOrder.price <= 0)
-			{
-				break;
-			}
-
 			if (input.offset > 0)
 			{
 				input.offset--;
 			}
 			else
 			{
-				locals._assetOrder = state.get()._assetOrders.element(locals._elementIndex);
-				locals._assetBidOrder.entity = locals._assetOrder.entity;
-				locals._assetBidOrder.numberOfShares = locals._assetOrder.numberOfShares;
+				locals._assetBidOrder.price = state.get()._orders.price(locals._elementIndex);
+				locals._assetBidOrder.entity = state.get()._orders.owner(locals._elementIndex);
+				locals._assetBidOrder.numberOfShares = state.get()._orders.element(locals._elementIndex).numberOfShares;
 				output.orders.set(locals._elementIndex2, locals._assetBidOrder);
 				locals._elementIndex2++;
 			}
 
-			locals._elementIndex = state.get()._assetOrders.nextElementIndex(locals._elementIndex);
+			locals._elementIndex = state.get()._orders.nextElementIndex(locals._elementIndex);
 		}
 
 		if (locals._elementIndex2 < 256)
@@ -390,7 +411,7 @@ protected:
 
 	PUBLIC_FUNCTION_WITH_LOCALS(EntityAskOrders)
 	{
-		locals._elementIndex = state.get()._entityOrders.headIndex(input.entity, 0);
+		locals._elementIndex = state.get()._orders.ownerHeadIndex(input.entity, OrderBookSide::ask);
 		locals._elementIndex2 = 0;
 		while (locals._elementIndex != NULL_INDEX
 			&& locals._elementIndex2 < 256)
@@ -401,8 +422,8 @@ protected:
 			}
 			else
 			{
-				locals._entityAskOrder.price = -state.get()._entityOrders.priority(locals._elementIndex);
-				locals._entityOrder = state.get()._entityOrders.element(locals._elementIndex);
+				locals._entityAskOrder.price = state.get()._orders.price(locals._elementIndex);
+				locals._entityOrder = state.get()._orders.element(locals._elementIndex);
 				locals._entityAskOrder.issuer = locals._entityOrder.issuer;
 				locals._entityAskOrder.assetName = locals._entityOrder.assetName;
 				locals._entityAskOrder.numberOfShares = locals._entityOrder.numberOfShares;
@@ -410,7 +431,7 @@ protected:
 				locals._elementIndex2++;
 			}
 
-			locals._elementIndex = state.get()._entityOrders.nextElementIndex(locals._elementIndex);
+			locals._elementIndex = state.get()._orders.nextOwnerElementIndex(locals._elementIndex);
 		}
 
 		if (locals._elementIndex2 < 256)
@@ -437,25 +458,19 @@ protected:
 
 	PUBLIC_FUNCTION_WITH_LOCALS(EntityBidOrders)
 	{
-		locals._elementIndex = state.get()._entityOrders.headIndex(input.entity);
+		locals._elementIndex = state.get()._orders.ownerHeadIndex(input.entity, OrderBookSide::bid);
 		locals._elementIndex2 = 0;
 		while (locals._elementIndex != NULL_INDEX
 			&& locals._elementIndex2 < 256)
 		{
-			locals._entityBidOrder.price = state.get()._entityOrders.priority(locals._elementIndex);
-
-			if (locals._entityBidOrder.price <= 0)
-			{
-				break;
-			}
-
 			if (input.offset > 0)
 			{
 				input.offset--;
 			}
 			else
 			{
-				locals._entityOrder = state.get()._entityOrders.element(locals._elementIndex);
+				locals._entityBidOrder.price = state.get()._orders.price(locals._elementIndex);
+				locals._entityOrder = state.get()._orders.element(locals._elementIndex);
 				locals._entityBidOrder.issuer = locals._entityOrder.issuer;
 				locals._entityBidOrder.assetName = locals._entityOrder.assetName;
 				locals._entityBidOrder.numberOfShares = locals._entityOrder.numberOfShares;
@@ -463,7 +478,7 @@ protected:
 				locals._elementIndex2++;
 			}
 
-			locals._elementIndex = state.get()._entityOrders.nextElementIndex(locals._elementIndex);
+			locals._elementIndex = state.get()._orders.nextOwnerElementIndex(locals._elementIndex);
 		}
 
 		if (locals._elementIndex2 < 256)
@@ -566,76 +581,48 @@ protected:
 				state.mut()._issuerAndAssetName = input.issuer;
 				state.mut()._issuerAndAssetName.u64._3 = input.assetName;
 
-				state.mut()._elementIndex = state.get()._entityOrders.headIndex(qpi.invocator(), -input.price);
+				state.mut()._elementIndex = state.get()._orders.ownerHeadIndex(qpi.invocator(), OrderBookSide::ask, input.price);
 				while (state.get()._elementIndex != NULL_INDEX)
 				{
-					if (state.get()._entityOrders.priority(state.get()._elementIndex) != -input.price)
+					if (state.get()._orders.price(state.get()._elementIndex) != input.price)
 					{
 						state.mut()._elementIndex = NULL_INDEX;
 
 						break;
 					}
 
-					state.mut()._entityOrder = state.get()._entityOrders.element(state.get()._elementIndex);
+					state.mut()._entityOrder = state.get()._orders.element(state.get()._elementIndex);
 					if (state.get()._entityOrder.assetName == input.assetName
 						&& state.get()._entityOrder.issuer == input.issuer)
 					{
 						state.mut()._entityOrder.numberOfShares += input.numberOfShares;
-						state.mut()._entityOrders.replace(state.get()._elementIndex, state.get()._entityOrder);
-
-						state.mut()._elementIndex = state.get()._assetOrders.headIndex(state.get()._issuerAndAssetName, -input.price);
-						while (true) // Impossible for the corresponding asset order to not exist
-						{
-							state.mut()._assetOrder = state.get()._assetOrders.element(state.get()._elementIndex);
-							if (state.get()._assetOrder.entity == qpi.invocator())
-							{
-								state.mut()._assetOrder.numberOfShares += input.numberOfShares;
-								state.mut()._assetOrders.replace(state.get()._elementIndex, state.get()._assetOrder);
-
-								break;
-							}
-
-							state.mut()._elementIndex = state.get()._assetOrders.nextElementIndex(state.get()._elementIndex);
-						}
+						state.mut()._orders.replace(state.get()._elementIndex, state.get()._entityOrder);
 
 						break;
 					}
 
-					state.mut()._elementIndex = state.get()._entityOrders.nextElementIndex(state.get()._elementIndex);
+					state.mut()._elementIndex = state.get()._orders.nextOwnerElementIndex(state.get()._elementIndex);
 				}
 
 				if (state.get()._elementIndex == NULL_INDEX) // No other ask orders for the same asset at the same price found
 				{
-					state.mut()._elementIndex = state.get()._assetOrders.headIndex(state.get()._issuerAndAssetName);
+					state.mut()._elementIndex = state.get()._orders.headIndex(state.get()._issuerAndAssetName, OrderBookSide::bid);
 					while (state.get()._elementIndex != NULL_INDEX
 						&& input.numberOfShares > 0)
 					{
-						state.mut()._price = state.get()._assetOrders.priority(state.get()._elementIndex);
+						state.mut()._price = state.get()._orders.price(state.get()._elementIndex);
 
 						if (state.get()._price < input.price)
 						{
 							break;
 						}
 
-						state.mut()._assetOrder = state.get()._assetOrders.element(state.get()._elementIndex);
+						state.mut()._assetOrder.entity = state.get()._orders.owner(state.get()._elementIndex);
+						state.mut()._assetOrder.numberOfShares = state.get()._orders.element(state.get()._elementIndex).numberOfShares;
 						if (state.get()._assetOrder.numberOfShares <= input.numberOfShares)
 						{
-							state.mut()._elementIndex = state.mut()._assetOrders.remove(state.get()._elementIndex);
+							state.mut()._elementIndex = state.mut()._orders.remove(state.get()._elementIndex);
 
-							state.mut()._elementIndex2 = state.get()._entityOrders.headIndex(state.get()._assetOrder.entity, state.get()._price);
-							while (true) // Impossible for the corresponding entity order to not exist
-							{
-								state.mut()._entityOrder = state.get()._entityOrders.element(state.get()._elementIndex2);
-								if (state.get()._entityOrder.assetName == input.assetName
-									&& state.get()._entityOrder.issuer == input.issuer)
-								{
-									state.mut()._entityOrders.remove(state.get()._elementIndex2);
-
-									break;
-								}
-
-								state.mut()._elementIndex2 = state.get()._entityOrders.nextElementIndex(state.get()._elementIndex2);
-							}
 							if (smul(state.get()._price, state.get()._assetOrder.numberOfShares) >= div<sint64>(INT64_MAX, state.get()._tradeFee))
 							{
 								// in this case, traders will pay more fee because it's rounding down, it's better to split the trade into multiple smaller trades
@@ -659,24 +646,10 @@ protected:
 						}
 						else
 						{
-							state.mut()._assetOrder.numberOfShares -= input.numberOfShares;
-							state.mut()._assetOrders.replace(state.get()._elementIndex, state.get()._assetOrder);
+							state.mut()._entityOrder = state.get()._orders.element(state.get()._elementIndex);
+							state.mut()._entityOrder.numberOfShares -= input.numberOfShares;
+							state.mut()._orders.replace(state.get()._elementIndex, state.get()._entityOrder);
 
-							state.mut()._elementIndex = state.get()._entityOrders.headIndex(state.get()._assetOrder.entity, state.get()._price);
-							while (true) // Impossible for the corresponding entity order to not exist
-							{
-								state.mut()._entityOrder = state.get()._entityOrders.element(state.get()._elementIndex);
-								if (state.get()._entityOrder.assetName == input.assetName
-									&& state.get()._entityOrder.issuer == input.issuer)
-								{
-									state.mut()._entityOrder.numberOfShares -= input.numberOfShares;
-									state.mut()._entityOrders.replace(state.get()._elementIndex, state.get()._entityOrder);
-
-									break;
-								}
-
-								state.mut()._elementIndex = state.get()._entityOrders.nextElementIndex(state.get()._elementIndex);
-							}
 							if (smul(state.get()._price, input.numberOfShares) >= div<sint64>(INT64_MAX, state.get()._tradeFee))
 							{
 								// in this case, traders will pay more fee because it's rounding down, it's better to split the trade into multiple smaller trades
@@ -704,14 +677,10 @@ protected:
 
 					if (input.numberOfShares > 0)
 					{
-						state.mut()._assetOrder.entity = qpi.invocator();
-						state.mut()._assetOrder.numberOfShares = input.numberOfShares;
-						state.mut()._assetOrders.add(state.get()._issuerAndAssetName, state.get()._assetOrder, -input.price);
-
 						state.mut()._entityOrder.issuer = input.issuer;
 						state.mut()._entityOrder.assetName = input.assetName;
 						state.mut()._entityOrder.numberOfShares = input.numberOfShares;
-						state.mut()._entityOrders.add(qpi.invocator(), state.get()._entityOrder, -input.price);
+						state.mut()._orders.add(state.get()._issuerAndAssetName, qpi.invocator(), OrderBookSide::ask, input.price, state.get()._entityOrder);
 					}
 				}
 			}
@@ -744,76 +713,47 @@ protected:
 			state.mut()._issuerAndAssetName = input.issuer;
 			state.mut()._issuerAndAssetName.u64._3 = input.assetName;
 
-			state.mut()._elementIndex = state.get()._entityOrders.tailIndex(qpi.invocator(), input.price);
+			state.mut()._elementIndex = state.get()._orders.ownerHeadIndex(qpi.invocator(), OrderBookSide::bid, input.price);
 			while (state.get()._elementIndex != NULL_INDEX)
 			{
-				if (state.get()._entityOrders.priority(state.get()._elementIndex) != input.price)
+				if (state.get()._orders.price(state.get()._elementIndex) != input.price)
 				{
 					state.mut()._elementIndex = NULL_INDEX;
 
 					break;
 				}
 
-				state.mut()._entityOrder = state.get()._entityOrders.element(state.get()._elementIndex);
+				state.mut()._entityOrder = state.get()._orders.element(state.get()._elementIndex);
 				if (state.get()._entityOrder.assetName == input.assetName
 					&& state.get()._entityOrder.issuer == input.issuer)
 				{
 					state.mut()._entityOrder.numberOfShares += input.numberOfShares;
-					state.mut()._entityOrders.replace(state.get()._elementIndex, state.get()._entityOrder);
-
-					state.mut()._elementIndex = state.get()._assetOrders.tailIndex(state.get()._issuerAndAssetName, input.price);
-					while (true) // Impossible for the corresponding asset order to not exist
-					{
-						state.mut()._assetOrder = state.get()._assetOrders.element(state.get()._elementIndex);
-						if (state.get()._assetOrder.entity == qpi.invocator())
-						{
-							state.mut()._assetOrder.numberOfShares += input.numberOfShares;
-							state.mut()._assetOrders.replace(state.get()._elementIndex, state.get()._assetOrder);
-
-							break;
-						}
-
-						state.mut()._elementIndex = state.get()._assetOrders.prevElementIndex(state.get()._elementIndex);
-					}
+					state.mut()._orders.replace(state.get()._elementIndex, state.get()._entityOrder);
 
 					break;
 				}
 
-				state.mut()._elementIndex = state.get()._entityOrders.prevElementIndex(state.get()._elementIndex);
+				state.mut()._elementIndex = state.get()._orders.nextOwnerElementIndex(state.get()._elementIndex);
 			}
 
 			if (state.get()._elementIndex == NULL_INDEX) // No other bid orders for the same asset at the same price found
 			{
-				state.mut()._elementIndex = state.get()._assetOrders.headIndex(state.get()._issuerAndAssetName, 0);
+				state.mut()._elementIndex = state.get()._orders.headIndex(state.get()._issuerAndAssetName, OrderBookSide::ask);
 				while (state.get()._elementIndex != NULL_INDEX
 					&& input.numberOfShares > 0)
 				{
-					state.mut()._price = -state.get()._assetOrders.priority(state.get()._elementIndex);
+					state.mut()._price = state.get()._orders.price(state.get()._elementIndex);
 
 					if (state.get()._price > input.price)
 					{
 						break;
 					}
 
-					state.mut()._assetOrder = state.get()._assetOrders.element(state.get()._elementIndex);
+					state.mut()._assetOrder.entity = state.get()._orders.owner(state.get()._elementIndex);
+					state.mut()._assetOrder.numberOfShares = state.get()._orders.element(state.get()._elementIndex).numberOfShares;
 					if (state.get()._assetOrder.numberOfShares <= input.numberOfShares)
 					{
-						state.mut()._elementIndex = state.mut()._assetOrders.remove(state.get()._elementIndex);
-
-						state.mut()._elementIndex2 = state.get()._entityOrders.headIndex(state.get()._assetOrder.entity, -state.get()._price);
-						while (true) // Impossible for the corresponding entity order to not exist
-						{
-							state.mut()._entityOrder = state.get()._entityOrders.element(state.get()._elementIndex2);
-							if (state.get()._entityOrder.assetName == input.assetName
-								&& state.get()._entityOrder.issuer == input.issuer)
-							{
-								state.mut()._entityOrders.remove(state.get()._elementIndex2);
-
-								break;
-							}
-
-							state.mut()._elementIndex2 = state.get()._entityOrders.nextElementIndex(state.get()._elementIndex2);
-						}
+						state.mut()._elementIndex = state.mut()._orders.remove(state.get()._elementIndex);
 
 						if (smul(state.get()._price, state.get()._assetOrder.numberOfShares) >= div<sint64>(INT64_MAX, state.get()._tradeFee))
 						{
@@ -841,24 +781,9 @@ protected:
 					}
 					else
 					{
-						state.mut()._assetOrder.numberOfShares -= input.numberOfShares;
-						state.mut()._assetOrders.replace(state.get()._elementIndex, state.get()._assetOrder);
-
-						state.mut()._elementIndex = state.get()._entityOrders.headIndex(state.get()._assetOrder.entity, -state.get()._price);
-						while (true) // Impossible for the corresponding entity order to not exist
-						{
-							state.mut()._entityOrder = state.get()._entityOrders.element(state.get()._elementIndex);
-							if (state.get()._entityOrder.assetName == input.assetName
-								&& state.get()._entityOrder.issuer == input.issuer)
-							{
-								state.mut()._entityOrder.numberOfShares -= input.numberOfShares;
-								state.mut()._entityOrders.replace(state.get()._elementIndex, state.get()._entityOrder);
-
-								break;
-							}
-
-							state.mut()._elementIndex = state.get()._entityOrders.nextElementIndex(state.get()._elementIndex);
-						}
+						state.mut()._entityOrder = state.get()._orders.element(state.get()._elementIndex);
+						state.mut()._entityOrder.numberOfShares -= input.numberOfShares;
+						state.mut()._orders.replace(state.get()._elementIndex, state.get()._entityOrder);
 
 						if (smul(state.get()._price, input.numberOfShares) >= div<sint64>(INT64_MAX, state.get()._tradeFee))
 						{
@@ -890,14 +815,10 @@ protected:
 
 				if (input.numberOfShares > 0)
 				{
-					state.mut()._assetOrder.entity = qpi.invocator();
-					state.mut()._assetOrder.numberOfShares = input.numberOfShares;
-					state.mut()._assetOrders.add(state.get()._issuerAndAssetName, state.get()._assetOrder, input.price);
-
 					state.mut()._entityOrder.issuer = input.issuer;
 					state.mut()._entityOrder.assetName = input.assetName;
 					state.mut()._entityOrder.numberOfShares = input.numberOfShares;
-					state.mut()._entityOrders.add(qpi.invocator(), state.get()._entityOrder, input.price);
+					state.mut()._orders.add(state.get()._issuerAndAssetName, qpi.invocator(), OrderBookSide::bid, input.price, state.get()._entityOrder);
 				}
 			}
 		}
@@ -918,20 +839,17 @@ protected:
 		}
 		else
 		{
-			state.mut()._issuerAndAssetName = input.issuer;
-			state.mut()._issuerAndAssetName.u64._3 = input.assetName;
-
-			state.mut()._elementIndex = state.get()._entityOrders.headIndex(qpi.invocator(), -input.price);
+			state.mut()._elementIndex = state.get()._orders.ownerHeadIndex(qpi.invocator(), OrderBookSide::ask, input.price);
 			while (state.get()._elementIndex != NULL_INDEX)
 			{
-				if (state.get()._entityOrders.priority(state.get()._elementIndex) != -input.price)
+				if (state.get()._orders.price(state.get()._elementIndex) != input.price)
 				{
 					state.mut()._elementIndex = NULL_INDEX;
 
 					break;
 				}
 
-				state.mut()._entityOrder = state.get()._entityOrders.element(state.get()._elementIndex);
+				state.mut()._entityOrder = state.get()._orders.element(state.get()._elementIndex);
 				if (state.get()._entityOrder.assetName == input.assetName
 					&& state.get()._entityOrder.issuer == input.issuer)
 				{
@@ -944,40 +862,18 @@ protected:
 						state.mut()._entityOrder.numberOfShares -= input.numberOfShares;
 						if (state.get()._entityOrder.numberOfShares > 0)
 						{
-							state.mut()._entityOrders.replace(state.get()._elementIndex, state.get()._entityOrder);
+							state.mut()._orders.replace(state.get()._elementIndex, state.get()._entityOrder);
 						}
 						else
 						{
-							state.mut()._entityOrders.remove(state.get()._elementIndex);
-						}
-
-						state.mut()._elementIndex = state.get()._assetOrders.headIndex(state.get()._issuerAndAssetName, -input.price);
-						while (true) // Impossible for the corresponding asset order to not exist
-						{
-							state.mut()._assetOrder = state.get()._assetOrders.element(state.get()._elementIndex);
-							if (state.get()._assetOrder.entity == qpi.invocator())
-							{
-								state.mut()._assetOrder.numberOfShares -= input.numberOfShares;
-								if (state.get()._assetOrder.numberOfShares > 0)
-								{
-									state.mut()._assetOrders.replace(state.get()._elementIndex, state.get()._assetOrder);
-								}
-								else
-								{
-									state.mut()._assetOrders.remove(state.get()._elementIndex);
-								}
-
-								break;
-							}
-
-							state.mut()._elementIndex = state.get()._assetOrders.nextElementIndex(state.get()._elementIndex);
+							state.mut()._orders.remove(state.get()._elementIndex);
 						}
 					}
 
 					break;
 				}
 
-				state.mut()._elementIndex = state.get()._entityOrders.nextElementIndex(state.get()._elementIndex);
+				state.mut()._elementIndex = state.get()._orders.nextOwnerElementIndex(state.get()._elementIndex);
 			}
 
 			if (state.get()._elementIndex == NULL_INDEX) // No other ask orders for the same asset at the same price found
@@ -1006,20 +902,17 @@ protected:
 		}
 		else
 		{
-			state.mut()._issuerAndAssetName = input.issuer;
-			state.mut()._issuerAndAssetName.u64._3 = input.assetName;
-
-			state.mut()._elementIndex = state.get()._entityOrders.tailIndex(qpi.invocator(), input.price);
+			state.mut()._elementIndex = state.get()._orders.ownerHeadIndex(qpi.invocator(), OrderBookSide::bid, input.price);
 			while (state.get()._elementIndex != NULL_INDEX)
 			{
-				if (state.get()._entityOrders.priority(state.get()._elementIndex) != input.price)
+				if (state.get()._orders.price(state.get()._elementIndex) != input.price)
 				{
 					state.mut()._elementIndex = NULL_INDEX;
 
 					break;
 				}
 
-				state.mut()._entityOrder = state.get()._entityOrders.element(state.get()._elementIndex);
+				state.mut()._entityOrder = state.get()._orders.element(state.get()._elementIndex);
 				if (state.get()._entityOrder.assetName == input.assetName
 					&& state.get()._entityOrder.issuer == input.issuer)
 				{
@@ -1032,40 +925,18 @@ protected:
 						state.mut()._entityOrder.numberOfShares -= input.numberOfShares;
 						if (state.get()._entityOrder.numberOfShares > 0)
 						{
-							state.mut()._entityOrders.replace(state.get()._elementIndex, state.get()._entityOrder);
+							state.mut()._orders.replace(state.get()._elementIndex, state.get()._entityOrder);
 						}
 						else
 						{
-							state.mut()._entityOrders.remove(state.get()._elementIndex);
-						}
-
-						state.mut()._elementIndex = state.get()._assetOrders.tailIndex(state.get()._issuerAndAssetName, input.price);
-						while (true) // Impossible for the corresponding asset order to not exist
-						{
-							state.mut()._assetOrder = state.get()._assetOrders.element(state.get()._elementIndex);
-							if (state.get()._assetOrder.entity == qpi.invocator())
-							{
-								state.mut()._assetOrder.numberOfShares -= input.numberOfShares;
-								if (state.get()._assetOrder.numberOfShares > 0)
-								{
-									state.mut()._assetOrders.replace(state.get()._elementIndex, state.get()._assetOrder);
-								}
-								else
-								{
-									state.mut()._assetOrders.remove(state.get()._elementIndex);
-								}
-
-								break;
-							}
-
-							state.mut()._elementIndex = state.get()._assetOrders.prevElementIndex(state.get()._elementIndex);
+							state.mut()._orders.remove(state.get()._elementIndex);
 						}
 					}
 
 					break;
 				}
 
-				state.mut()._elementIndex = state.get()._entityOrders.prevElementIndex(state.get()._elementIndex);
+				state.mut()._elementIndex = state.get()._orders.nextOwnerElementIndex(state.get()._elementIndex);
 			}
 
 			if (state.get()._elementIndex == NULL_INDEX) // No other bid orders for the same asset at the same price found
@@ -1158,10 +1029,120 @@ protected:
 				state.mut()._distributedAmount += div((state.get()._earnedAmount - state.get()._distributedAmount), 676ULL) * NUMBER_OF_COMPUTORS;
 			}
 		}
+	}
+
+	struct MIGRATE_locals
+	{
+		sint64 _assetOrderIndex, _entityOrderIndex;
+		sint64 _elementIndex, _elementIndex2;
+		sint64 _priority;
+		id _issuerAndAssetName;
+		id _entity;
+		AssetOrder _assetOrder;
+		EntityOrder _entityOrder;
+	};
+
+	MIGRATE_WITH_LOCALS()
+	{
+		state.mut()._earnedAmount = oldState._earnedAmount;
+		state.mut()._distributedAmount = oldState._distributedAmount;
+		state.mut()._burnedAmount = oldState._burnedAmount;
+		state.mut()._assetIssuanceFee = oldState._assetIssuanceFee;
+		state.mut()._transferFee = oldState._transferFee;
+		state.mut()._tradeFee = oldState._tradeFee;
+
+		// Add the orders of each asset in the order of its priority queue, so the matching order of orders with the same
+		// price is kept. The order of the entity listings is restored below.
+		for (locals._assetOrderIndex = 0; locals._assetOrderIndex < oldState._assetOrders.population(); locals._assetOrderIndex++)
+		{
+			locals._issuerAndAssetName = oldState._assetOrders.pov(locals._assetOrderIndex);
+			if (oldState._assetOrders.headIndex(locals._issuerAndAssetName) != locals._assetOrderIndex)
+			{
+				// Not the first order of the asset -> already added
+				continue;
+			}
+
+			locals._elementIndex = locals._assetOrderIndex;
+			while (locals._elementIndex != NULL_INDEX)
+			{
+				locals._priority = oldState._assetOrders.priority(locals._elementIndex);
+				locals._assetOrder = oldState._assetOrders.element(locals._elementIndex);
+
+				// Get full issuer from corresponding entity order (u64._3 of asset order pov is the asset name)
+				locals._elementIndex2 = oldState._entityOrders.headIndex(locals._assetOrder.entity, locals._priority);
+				while (locals._elementIndex2 != NULL_INDEX)
+				{
+					locals._entityOrder = oldState._entityOrders.element(locals._elementIndex2);
+					if (locals._entityOrder.assetName == locals._issuerAndAssetName.u64._3
+						&& locals._entityOrder.issuer.u64._0 == locals._issuerAndAssetName.u64._0
+						&& locals._entityOrder.issuer.u64._1 == locals._issuerAndAssetName.u64._1
+						&& locals._entityOrder.issuer.u64._2 == locals._issuerAndAssetName.u64._2)
+					{
+						break;
+					}
+
+					locals._elementIndex2 = oldState._entityOrders.nextElementIndex(locals._elementIndex2);
+				}
+
+				if (locals._elementIndex2 != NULL_INDEX)
+				{
+					locals._entityOrder.numberOfShares = locals._assetOrder.numberOfShares;
+					if (locals._priority > 0)
+					{
+						state.mut()._orders.add(locals._issuerAndAssetName, locals._assetOrder.entity, OrderBookSide::bid, locals._priority, locals._entityOrder);
+					}
+					else
+					{
+						state.mut()._orders.add(locals._issuerAndAssetName, locals._assetOrder.entity, OrderBookSide::ask, -locals._priority, locals._entityOrder);
+					}
+				}
+
+				locals._elementIndex = oldState._assetOrders.nextElementIndex(locals._elementIndex);
+			}
+		}
+
+		// Walk the priority queue of each entity and move each of its orders to the end of its price level in the owner
+		// view, so orders of an entity with the same price but different assets are listed in the old order
+		for (locals._entityOrderIndex = 0; locals._entityOrderIndex < oldState._entityOrders.population(); locals._entityOrderIndex++)
+		{
+			locals._entity = oldState._entityOrders.pov(locals._entityOrderIndex);
+			if (oldState._entityOrders.headIndex(locals._entity) != locals._entityOrderIndex)
+			{
+				// Not the first order of the entity -> already moved
+				continue;
+			}
+
+			locals._elementIndex = locals._entityOrderIndex;
+			while (locals._elementIndex != NULL_INDEX)
+			{
+				locals._priority = oldState._entityOrders.priority(locals._elementIndex);
+				locals._entityOrder = oldState._entityOrders.element(locals._elementIndex);
+				locals._issuerAndAssetName = locals._entityOrder.issuer;
+				locals._issuerAndAssetName.u64._3 = locals._entityOrder.assetName;
+
+				if (locals._priority > 0)
+				{
+					locals._elementIndex2 = state.get()._orders.ownerHeadIndex(locals._entity, OrderBookSide::bid, locals._priority);
+				}
+				else
+				{
+					locals._elementIndex2 = state.get()._orders.ownerHeadIndex(locals._entity, OrderBookSide::ask, -locals._priority);
+				}
+				while (locals._elementIndex2 != NULL_INDEX
+					&& state.get()._orders.price(locals._elementIndex2) == (locals._priority > 0 ? locals._priority : -locals._priority))
+				{
+					if (state.get()._orders.book(locals._elementIndex2) == locals._issuerAndAssetName)
+					{
+						state.mut()._orders.moveToOwnerTail(locals._elementIndex2);
+						break;
+					}
 
-		// Cleanup collections if more than 30% of hash maps are marked for removal
-		if (state.get()._assetOrders.needsCleanup(30)) { state.mut()._assetOrders.cleanup(); }
-		if (state.get()._entityOrders.needsCleanup(30)) { state.mut()._entityOrders.cleanup(); }
+					locals._elementIndex2 = state.get()._orders.nextOwnerElementIndex(locals._elementIndex2);
+				}
+
+				locals._elementIndex = oldState._entityOrders.nextElementIndex(locals._elementIndex);
+			}
+		}
 	}
 
 	PRE_RELEASE_SHARES()
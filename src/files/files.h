@@ -1,3 +1,5 @@
+#pragma once
+
 struct FileHeaderTransaction : public Transaction
 {
 	static constexpr unsigned char transactionType()
@@ -4,6 +4,7 @@
 
 #include "platform/memory.h"
 #include "platform/assert.h"
+#include "platform/chunked_job.h"
 
 // Compiler flag to determine AVX512 or generic implementation of K12
 
@@ -1534,6 +1535,284 @@ static inline void KangarooTwelve(const void* input, unsigned int inputByteLen,
     KangarooTwelve((const unsigned char*)input, inputByteLen, (unsigned char*)output, outputByteLen);
 }
 
+////////// Parallel KangarooTwelve of large inputs \\\\\\\\\\
+
+// The chaining values of the leaves of the K12 tree (all chunks after the first one) are independent of each other.
+// KangarooTwelveParallel() computes them K12_parallelLeaves at a time in the SIMD lanes and spreads groups of
+// leaves over the processors helping with a ChunkedJob. The output is identical to KangarooTwelve().
+
+#if defined (__AVX512F__)
+typedef __m512i K12LeafLanes;
+static constexpr unsigned int K12_parallelLeaves = 8;
+
+static inline K12LeafLanes k12LanesXor(K12LeafLanes a, K12LeafLanes b) { return _mm512_xor_si512(a, b); }
+static inline K12LeafLanes k12LanesAndNot(K12LeafLanes a, K12LeafLanes b) { return _mm512_andnot_si512(a, b); }
+template <unsigned int offset> static inline K12LeafLanes k12LanesRol(K12LeafLanes a) { return _mm512_rol_epi64(a, offset); }
+static inline K12LeafLanes k12LanesSet1(unsigned long long value) { return _mm512_set1_epi64(value); }
+static inline K12LeafLanes k12LanesZero() { return _mm512_setzero_si512(); }
+// Load the 8-byte lane at the same offset of each of the K12_parallelLeaves consecutive chunks
+static inline K12LeafLanes k12LanesLoad(const unsigned char* data)
+{
+    const __m512i chunkOffsets = _mm512_set_epi64(7 * K12_chunkSize, 6 * K12_chunkSize, 5 * K12_chunkSize, 4 * K12_chunkSize,
+        3 * K12_chunkSize, 2 * K12_chunkSize, K12_chunkSize, 0);
+    return _mm512_i64gather_epi64(chunkOffsets, data, 1);
+}
+#else
+typedef __m256i K12LeafLanes;
+static constexpr unsigned int K12_parallelLeaves = 4;
+
+static inline K12LeafLanes k12LanesXor(K12LeafLanes a, K12LeafLanes b) { return _mm256_xor_si256(a, b); }
+static inline K12LeafLanes k12LanesAndNot(K12LeafLanes a, K12LeafLanes b) { return _mm256_andnot_si256(a, b); }
+template <unsigned int offset> static inline K12LeafLanes k12LanesRol(K12LeafLanes a)
+{
+    return _mm256_or_si256(_mm256_slli_epi64(a, offset), _mm256_srli_epi64(a, 64 - offset));
+}
+static inline K12LeafLanes k12LanesSet1(unsigned long long value) { return _mm256_set1_epi64x(value); }
+static inline K12LeafLanes k12LanesZero() { return _mm256_setzero_si256(); }
+// Load the 8-byte lane at the same offset of each of the K12_parallelLeaves consecutive chunks
+static inline K12LeafLanes k12LanesLoad(const unsigned char* data)
+{
+    const __m256i chunkOffsets = _mm256_set_epi64x(3 * K12_chunkSize, 2 * K12_chunkSize, K12_chunkSize, 0);
+    return _mm256_i64gather_epi64((const long long*)data, chunkOffsets, 1);
+}
+#endif
+
+// Keccak-p[1600, 12] on K12_parallelLeaves states, lane x + 5 * y of all states in A[x + 5 * y]
+static void KeccakP1600Lanes_Permute_12rounds(K12LeafLanes* A)
+{
+    static constexpr unsigned long long roundConstants[12] = {
+        KeccakF1600RoundConstant0, KeccakF1600RoundConstant1, KeccakF1600RoundConstant2, KeccakF1600RoundConstant3,
+        KeccakF1600RoundConstant4, KeccakF1600RoundConstant5, KeccakF1600RoundConstant6, KeccakF1600RoundConstant7,
+        KeccakF1600RoundConstant8, KeccakF1600RoundConstant9, KeccakF1600RoundConstant10, 0x8000000080008008ULL };
+
+    K12LeafLanes B[25], C[5], D[5];
+    for (unsigned int round = 0; round < 12; ++round)
+    {
+        // theta
+        C[0] = k12LanesXor(k12LanesXor(k12LanesXor(A[0], A[5]), k12LanesXor(A[10], A[15])), A[20]);
+        C[1] = k12LanesXor(k12LanesXor(k12LanesXor(A[1], A[6]), k12LanesXor(A[11], A[16])), A[21]);
+        C[2] = k12LanesXor(k12LanesXor(k12LanesXor(A[2], A[7]), k12LanesXor(A[12], A[17])), A[22]);
+        C[3] = k12LanesXor(k12LanesXor(k12LanesXor(A[3], A[8]), k12LanesXor(A[13], A[18])), A[23]);
+        C[4] = k12LanesXor(k12LanesXor(k12LanesXor(A[4], A[9]), k12LanesXor(A[14], A[19])), A[24]);
+        D[0] = k12LanesXor(C[4], k12LanesRol<1>(C[1]));
+        D[1] = k12LanesXor(C[0], k12LanesRol<1>(C[2]));
+        D[2] = k12LanesXor(C[1], k12LanesRol<1>(C[3]));
+        D[3] = k12LanesXor(C[2], k12LanesRol<1>(C[4]));
+        D[4] = k12LanesXor(C[3], k12LanesRol<1>(C[0]));
+
+        // rho and pi: B[y, 2x + 3y] = ROL(A[x, y] ^ D[x])
+        B[0] = k12LanesXor(A[0], D[0]);
+        B[10] = k12LanesRol<1>(k12LanesXor(A[1], D[1]));
+        B[20] = k12LanesRol<62>(k12LanesXor(A[2], D[2]));
+        B[5] = k12LanesRol<28>(k12LanesXor(A[3], D[3]));
+        B[15] = k12LanesRol<27>(k12LanesXor(A[4], D[4]));
+        B[16] = k12LanesRol<36>(k12LanesXor(A[5], D[0]));
+        B[1] = k12LanesRol<44>(k12LanesXor(A[6], D[1]));
+        B[11] = k12LanesRol<6>(k12LanesXor(A[7], D[2]));
+        B[21] = k12LanesRol<55>(k12LanesXor(A[8], D[3]));
+        B[6] = k12LanesRol<20>(k12LanesXor(A[9], D[4]));
+        B[7] = k12LanesRol<3>(k12LanesXor(A[10], D[0]));
+        B[17] = k12LanesRol<10>(k12LanesXor(A[11], D[1]));
+        B[2] = k12LanesRol<43>(k12LanesXor(A[12], D[2]));
+        B[12] = k12LanesRol<25>(k12LanesXor(A[13], D[3]));
+        B[22] = k12LanesRol<39>(k12LanesXor(A[14], D[4]));
+        B[23] = k12LanesRol<41>(k12LanesXor(A[15], D[0]));
+        B[8] = k12LanesRol<45>(k12LanesXor(A[16], D[1]));
+        B[18] = k12LanesRol<15>(k12LanesXor(A[17], D[2]));
+        B[3] = k12LanesRol<21>(k12LanesXor(A[18], D[3]));
+        B[13] = k12LanesRol<8>(k12LanesXor(A[19], D[4]));
+        B[14] = k12LanesRol<18>(k12LanesXor(A[20], D[0]));
+        B[24] = k12LanesRol<2>(k12LanesXor(A[21], D[1]));
+        B[9] = k12LanesRol<61>(k12LanesXor(A[22], D[2]));
+        B[19] = k12LanesRol<56>(k12LanesXor(A[23], D[3]));
+        B[4] = k12LanesRol<14>(k12LanesXor(A[24], D[4]));
+
+        // chi
+        A[0] = k12LanesXor(B[0], k12LanesAndNot(B[1], B[2]));
+        A[1] = k12LanesXor(B[1], k12LanesAndNot(B[2], B[3]));
+        A[2] = k12LanesXor(B[2], k12LanesAndNot(B[3], B[4]));
+        A[3] = k12LanesXor(B[3], k12LanesAndNot(B[4], B[0]));
+        A[4] = k12LanesXor(B[4], k12LanesAndNot(B[0], B[1]));
+        A[5] = k12LanesXor(B[5], k12LanesAndNot(B[6], B[7]));
+        A[6] = k12LanesXor(B[6], k12LanesAndNot(B[7], B[8]));
+        A[7] = k12LanesXor(B[7], k12LanesAndNot(B[8], B[9]));
+        A[8] = k12LanesXor(B[8], k12LanesAndNot(B[9], B[5]));
+        A[9] = k12LanesXor(B[9], k12LanesAndNot(B[5], B[6]));
+        A[10] = k12LanesXor(B[10], k12LanesAndNot(B[11], B[12]));
+        A[11] = k12LanesXor(B[11], k12LanesAndNot(B[12], B[13]));
+        A[12] = k12LanesXor(B[12], k12LanesAndNot(B[13], B[14]));
+        A[13] = k12LanesXor(B[13], k12LanesAndNot(B[14], B[10]));
+        A[14] = k12LanesXor(B[14], k12LanesAndNot(B[10], B[11]));
+        A[15] = k12LanesXor(B[15], k12LanesAndNot(B[16], B[17]));
+        A[16] = k12LanesXor(B[16], k12LanesAndNot(B[17], B[18]));
+        A[17] = k12LanesXor(B[17], k12LanesAndNot(B[18], B[19]));
+        A[18] = k12LanesXor(B[18], k12LanesAndNot(B[19], B[15]));
+        A[19] = k12LanesXor(B[19], k12LanesAndNot(B[15], B[16]));
+        A[20] = k12LanesXor(B[20], k12LanesAndNot(B[21], B[22]));
+        A[21] = k12LanesXor(B[21], k12LanesAndNot(B[22], B[23]));
+        A[22] = k12LanesXor(B[22], k12LanesAndNot(B[23], B[24]));
+        A[23] = k12LanesXor(B[23], k12LanesAndNot(B[24], B[20]));
+        A[24] = k12LanesXor(B[24], k12LanesAndNot(B[20], B[21]));
+
+        // iota
+        A[0] = k12LanesXor(A[0], k12LanesSet1(roundConstants[round]));
+    }
+}
+
+// Compute the chaining values of K12_parallelLeaves consecutive full leaves (K12_chunkSize bytes each)
+static void KangarooTwelve_LeafChainingValues(const unsigned char* leaves, unsigned char* chainingValues)
+{
+    constexpr unsigned int rateInLanes = K12_rateInBytes / 8;
+    constexpr unsigned int fullBlocks = K12_chunkSize / K12_rateInBytes;
+    constexpr unsigned int lanesInLastBlock = (K12_chunkSize % K12_rateInBytes) / 8;
+    static_assert(K12_chunkSize % 8 == 0, "Leaf must consist of full lanes");
+
+    K12LeafLanes A[25];
+    for (unsigned int i = 0; i < 25; ++i)
+        A[i] = k12LanesZero();
+
+    for (unsigned int block = 0; block < fullBlocks; ++block, leaves += K12_rateInBytes)
+    {
+        for (unsigned int i = 0; i < rateInLanes; ++i)
+            A[i] = k12LanesXor(A[i], k12LanesLoad(leaves + 8 * i));
+        KeccakP1600Lanes_Permute_12rounds(A);
+    }
+    for (unsigned int i = 0; i < lanesInLastBlock; ++i)
+        A[i] = k12LanesXor(A[i], k12LanesLoad(leaves + 8 * i));
+
+    // leaf suffix after the data and padding at the end of the rate
+    A[lanesInLastBlock] = k12LanesXor(A[lanesInLastBlock], k12LanesSet1(K12_suffixLeaf));
+    A[rateInLanes - 1] = k12LanesXor(A[rateInLanes - 1], k12LanesSet1(0x80ULL << 56));
+    KeccakP1600Lanes_Permute_12rounds(A);
+
+    unsigned long long lanes[K12_parallelLeaves];
+    for (unsigned int i = 0; i < K12_capacityInBytes / 8; ++i)
+    {
+        copyMem(lanes, &A[i], sizeof(lanes));
+        for (unsigned int leaf = 0; leaf < K12_parallelLeaves; ++leaf)
+            ((unsigned long long*)(chainingValues + leaf * K12_capacityInBytes))[i] = lanes[leaf];
+    }
+}
+
+// Compute the chaining value of one full leaf (K12_chunkSize bytes)
+static void KangarooTwelve_LeafChainingValue(const unsigned char* leaf, unsigned char* chainingValue)
+{
+    KangarooTwelve_F queueNode;
+    setMem(&queueNode, sizeof(KangarooTwelve_F), 0);
+    KangarooTwelve_F_Absorb(&queueNode, leaf, K12_chunkSize);
+    queueNode.state[queueNode.byteIOIndex] ^= K12_suffixLeaf;
+    queueNode.state[K12_rateInBytes - 1] ^= 0x80;
+    KeccakP1600_Permute_12rounds(queueNode.state);
+    copyMem(chainingValue, queueNode.state, K12_capacityInBytes);
+}
+
+// Number of leaves whose chaining values are computed by one ChunkedJob::run() of KangarooTwelveParallel()
+static constexpr unsigned int K12_parallelBatchLeaves = 32 * K12_parallelLeaves;
+
+struct KangarooTwelveParallelBatch
+{
+    const unsigned char* leaves;
+    unsigned int leafCount;
+    unsigned char chainingValues[K12_parallelBatchLeaves][K12_capacityInBytes];
+};
+
+// Hash inputs of at least this size with KangarooTwelveParallel(), smaller ones with KangarooTwelve()
+static constexpr unsigned int K12_parallelMinInputSize = (2 * K12_parallelLeaves + 2) * K12_chunkSize;
+
+// KangarooTwelve() with the leaves processed in the SIMD lanes and by the processors helping with job.
+static void KangarooTwelveParallel(const unsigned char* input, unsigned int inputByteLen, unsigned char* output, unsigned int outputByteLen, ChunkedJob& job)
+{
+    if (inputByteLen < K12_parallelMinInputSize)
+    {
+        KangarooTwelve(input, inputByteLen, output, outputByteLen);
+        return;
+    }
+
+    // The message is followed by the zero byte encoding the empty customization string, so the last leaf, which
+    // holds this byte, is never a full leaf of input data.
+    const unsigned int fullLeafCount = inputByteLen / K12_chunkSize - 1;
+
+    KangarooTwelve_F finalNode;
+    setMem(&finalNode, sizeof(KangarooTwelve_F), 0);
+    KangarooTwelve_F_Absorb(&finalNode, input, K12_chunkSize);
+    finalNode.state[finalNode.byteIOIndex] ^= 0x03;
+    if (++finalNode.byteIOIndex == K12_rateInBytes)
+    {
+        KeccakP1600_Permute_12rounds(finalNode.state);
+        finalNode.byteIOIndex = 0;
+    }
+    else
+    {
+        finalNode.byteIOIndex = (finalNode.byteIOIndex + 7) & ~7;
+    }
+
+    KangarooTwelveParallelBatch batch;
+    for (unsigned int firstLeaf = 0; firstLeaf < fullLeafCount; firstLeaf += K12_parallelBatchLeaves)
+    {
+        batch.leaves = input + (unsigned long long)(firstLeaf + 1) * K12_chunkSize;
+        batch.leafCount = fullLeafCount - firstLeaf;
+        if (batch.leafCount > K12_parallelBatchLeaves)
+            batch.leafCount = K12_parallelBatchLeaves;
+
+        job.run([](void* context, unsigned int group)
+            {
+                KangarooTwelveParallelBatch* batch = (KangarooTwelveParallelBatch*)context;
+                const unsigned int leaf = group * K12_parallelLeaves;
+                if (leaf + K12_parallelLeaves <= batch->leafCount)
+                {
+                    KangarooTwelve_LeafChainingValues(batch->leaves + (unsigned long long)leaf * K12_chunkSize, batch->chainingValues[leaf]);
+                }
+                else
+                {
+                    for (unsigned int i = leaf; i < batch->leafCount; ++i)
+                        KangarooTwelve_LeafChainingValue(batch->leaves + (unsigned long long)i * K12_chunkSize, batch->chainingValues[i]);
+                }
+            }, &batch, (batch.leafCount + K12_parallelLeaves - 1) / K12_parallelLeaves);
+
+        KangarooTwelve_F_Absorb(&finalNode, batch.chainingValues[0], batch.leafCount * K12_capacityInBytes);
+    }
+
+    // last leaf: remaining input and the zero byte of the customization string
+    const unsigned int lastLeafOffset = (fullLeafCount + 1) * K12_chunkSize;
+    KangarooTwelve_F queueNode;
+    setMem(&queueNode, sizeof(KangarooTwelve_F), 0);
+    KangarooTwelve_F_Absorb(&queueNode, input + lastLeafOffset, inputByteLen - lastLeafOffset);
+    if (++queueNode.byteIOIndex == K12_rateInBytes)
+    {
+        KeccakP1600_Permute_12rounds(queueNode.state);
+        queueNode.byteIOIndex = 0;
+    }
+    queueNode.state[queueNode.byteIOIndex] ^= K12_suffixLeaf;
+    queueNode.state[K12_rateInBytes - 1] ^= 0x80;
+    KeccakP1600_Permute_12rounds(queueNode.state);
+    KangarooTwelve_F_Absorb(&finalNode, queueNode.state, K12_capacityInBytes);
+
+    // number of leaves, length-encoded, and final node suffix
+    const unsigned long long leafCount = fullLeafCount + 1;
+    unsigned int n = 0;
+    for (unsigned long long v = leafCount; v && (n < sizeof(unsigned long long)); ++n, v >>= 8)
+    {
+    }
+    unsigned char encbuf[sizeof(unsigned long long) + 1 + 2];
+    for (unsigned int i = 1; i <= n; ++i)
+    {
+        encbuf[i - 1] = (unsigned char)(leafCount >> (8 * (n - i)));
+    }
+    encbuf[n] = (unsigned char)n;
+    encbuf[++n] = 0xFF;
+    encbuf[++n] = 0xFF;
+    KangarooTwelve_F_Absorb(&finalNode, encbuf, ++n);
+    finalNode.state[finalNode.byteIOIndex] ^= 0x06;
+    finalNode.state[K12_rateInBytes - 1] ^= 0x80;
+    KeccakP1600_Permute_12rounds(finalNode.state);
+    copyMem(output, finalNode.state, outputByteLen);
+}
+
+static inline void KangarooTwelveParallel(const void* input, unsigned int inputByteLen, void* output, unsigned int outputByteLen, ChunkedJob& job)
+{
+    KangarooTwelveParallel((const unsigned char*)input, inputByteLen, (unsigned char*)output, outputByteLen, job);
+}
+
 static void KangarooTwelve64To32(const unsigned char* input, unsigned char* output)
 {
 #if defined (__AVX512F__) && !GENERIC_K12
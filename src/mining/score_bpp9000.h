@@ -86,6 +86,7 @@ struct ScoreBpp9000
     };
     ANN currentANN;
     ANN prevANN;
+    ANN rootANN;    // root LUT shared by the nonces of one computeScores() batch
 
     struct InitValue
     {
@@ -972,25 +973,13 @@ struct ScoreBpp9000
         currentANN.lut[storageIdx] = newTrit;
     }
 
-    // Seed the ANN: root LUT from the pubkey alone (each computor's fixed root); mutation seeds from
-    // pubkey+nonce (nonce[0..2] are the algo/L/K knobs, excluded from the RNG). Returns the start score.
-    unsigned int initializeANN(const unsigned char* publicKey, const unsigned char* nonce, const unsigned char* pRandom2Pool)
+    // Root LUT into currentANN, from the pubkey alone (each computor's fixed root).
+    void initializeRootLut(const unsigned char* publicKey, const unsigned char* pRandom2Pool)
     {
-        // PROFILE_NAMED_SCOPE("bpp9000:initializeANN");
         unsigned char rootHash[32];
         KangarooTwelve(publicKey, 32, rootHash, 32);
         random2(rootHash, pRandom2Pool, (unsigned char*)&initValue.lutInit, lutInitPaddedBytes);
 
-        unsigned char searchHash[32];
-        unsigned char combined[64];
-        copyMem(combined, publicKey, 32);
-        copyMem(combined + 32, nonce, 32);
-        combined[32] = 0;
-        combined[33] = 0;
-        combined[34] = 0;
-        KangarooTwelve(combined, 64, searchHash, 32);
-        random2(searchHash, pRandom2Pool, (unsigned char*)&initValue.mutationSeed, mutationSeedPaddedBytes);
-
         // Store the LUT densely by updated-neuron position k (row k): row k holds neuron
         // updatedNeuronIndices[k]'s LUT. RNG draw into initValue.lutInit unchanged (bit-exact).
         for (unsigned long long k = 0; k < numberOfUpdatedNeurons; ++k)
@@ -1001,15 +990,35 @@ struct ScoreBpp9000
                 currentANN.lut[k * lutStride + line] = (unsigned char)(initValue.lutInit[n * lutSize + line] % 3);
             }
         }
+    }
 
+    // Mutation seeds from pubkey+nonce (nonce[0..2] are the algo/L/K knobs, excluded from the RNG).
+    void initializeMutationSeeds(const unsigned char* publicKey, const unsigned char* nonce, const unsigned char* pRandom2Pool)
+    {
+        unsigned char searchHash[32];
+        unsigned char combined[64];
+        copyMem(combined, publicKey, 32);
+        copyMem(combined + 32, nonce, 32);
+        combined[32] = 0;
+        combined[33] = 0;
+        combined[34] = 0;
+        KangarooTwelve(combined, 64, searchHash, 32);
+        random2(searchHash, pRandom2Pool, (unsigned char*)&initValue.mutationSeed, mutationSeedPaddedBytes);
+    }
+
+    // Seed the ANN: root LUT and mutation seeds. Returns the start score.
+    unsigned int initializeANN(const unsigned char* publicKey, const unsigned char* nonce, const unsigned char* pRandom2Pool)
+    {
+        // PROFILE_NAMED_SCOPE("bpp9000:initializeANN");
+        initializeRootLut(publicKey, pRandom2Pool);
+        initializeMutationSeeds(publicKey, nonce, pRandom2Pool);
         return score();
     }
 
-    // Anti-attractor search: L mutations/step; accept worse-or-equal for the first K steps (explore),
-    // then better-or-equal (exploit); one-step rollback; keep and return the best score found.
-    unsigned int computeScore(const unsigned char* publicKey, const unsigned char* nonce, const unsigned char* pRandom2Pool)
+    // Anti-attractor search from the seeded ANN with start score cur: L mutations/step; accept worse-or-equal
+    // for the first K steps (explore), then better-or-equal (exploit); one-step rollback; return the best score.
+    unsigned int search(const unsigned char* nonce, unsigned int cur)
     {
-        // PROFILE_NAMED_SCOPE("bpp9000:computeScore");
         unsigned int L = nonce[1];
         if (L < 1)
         {
@@ -1022,7 +1031,6 @@ struct ScoreBpp9000
         // Explore disabled pre-ant-colony (K=0); restore K = nonce[2] when ants return.
         const unsigned long long K = 0;
 
-        unsigned int cur = initializeANN(publicKey, nonce, pRandom2Pool);
         unsigned int best = cur;
 
         for (unsigned long long s = 0; s < numberOfMutations; ++s)
@@ -1063,6 +1071,39 @@ struct ScoreBpp9000
         return best;
     }
 
+    unsigned int computeScore(const unsigned char* publicKey, const unsigned char* nonce, const unsigned char* pRandom2Pool)
+    {
+        // PROFILE_NAMED_SCOPE("bpp9000:computeScore");
+        return search(nonce, initializeANN(publicKey, nonce, pRandom2Pool));
+    }
+
+    // Score count nonces of one public key into scores[], bit-identical to computeScore() per nonce.
+    // The root LUT and its score depend only on the pubkey and the pool, so they are computed once and
+    // every search starts from a copy. Solutions are not interleaved across SIMD lanes: the lanes already
+    // hold the windows of one score() call, which share the per-vector LUT table.
+    void computeScores(const unsigned char* publicKey, const m256i* nonces, unsigned int count,
+                       const unsigned char* pRandom2Pool, unsigned int* scores)
+    {
+        // PROFILE_NAMED_SCOPE("bpp9000:computeScores");
+        if (count == 0)
+        {
+            return;
+        }
+        initializeRootLut(publicKey, pRandom2Pool);
+        const unsigned int rootScore = score();
+        copyMem(&rootANN, &currentANN, sizeof(rootANN));
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            if (i > 0)
+            {
+                copyMem(&currentANN, &rootANN, sizeof(currentANN));
+            }
+            initializeMutationSeeds(publicKey, nonces[i].m256i_u8, pRandom2Pool);
+            scores[i] = search(nonces[i].m256i_u8, rootScore);
+        }
+    }
+
     int getLastOutput(unsigned char* requestedOutput, int requestedSizeInBytes)
     {
         return 0;
@@ -47,6 +47,25 @@ struct ScoreEngine
             : failures;
     }
 
+    // Score several bpp9000 nonces of one public key (see ScoreBpp9000::computeScores). The caller makes sure
+    // all nonces are bpp9000 nonces.
+    void computeBpp9000Scores(const unsigned char* publicKey, const m256i* nonces, unsigned int count, const unsigned char* randomPool, unsigned int* scores)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        lastNonceByte0 = nonces[count - 1].m256i_u8[0];
+        _bpp9000Score.computeScores(publicKey, nonces, count, randomPool, scores);
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            if (scores[i] == ScoreBpp9000<Bpp9000ParamsT>::INFINITE_ERROR)
+            {
+                scores[i] = (unsigned int)ScoreBpp9000<Bpp9000ParamsT>::numberOfWindows;
+            }
+        }
+    }
+
     unsigned int computeScore(const unsigned char* publicKey, const unsigned char* nonce, const unsigned char* randomPool)
     {
         lastNonceByte0 = nonce[0];
@@ -0,0 +1,157 @@
+// filter for recognizing duplicates of received packets (dejavu filter)
+
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+#include "platform/assert.h"
+#include "platform/m256.h"
+#include "platform/memory.h"
+
+
+// Portable version of _rotl64() (n must be in 1..63), compiled to a single rotate instruction
+static inline unsigned long long rotateLeft64(unsigned long long x, int n)
+{
+    return (x << n) | (x >> (64 - n));
+}
+
+// Load 8 bytes from an address without alignment requirement (a single mov, without the undefined behavior of
+// dereferencing a misaligned unsigned long long pointer)
+static inline unsigned long long loadUnaligned64(const unsigned char* ptr)
+{
+    return (unsigned long long)_mm_cvtsi128_si64(_mm_loadu_si64(ptr));
+}
+
+// Keyed 64-bit hash of a packet (header and full payload), used for deriving IDs in DejavuFilter.
+// It processes 8-byte words in 4 independent multiply-rotate lanes (similar to xxHash64), which is several times
+// faster than K12. It is not a cryptographic hash, but the secret random key keeps peers from predicting IDs.
+static unsigned long long computeDejavuHash(const void* data, unsigned int size, const m256i& key)
+{
+    constexpr unsigned long long prime1 = 0x9E3779B185EBCA87ULL;
+    constexpr unsigned long long prime2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr unsigned long long prime3 = 0x165667B19E3779F9ULL;
+
+    const unsigned char* ptr = (const unsigned char*)data;
+    const unsigned char* const end = ptr + size;
+
+    unsigned long long lane0 = key.m256i_u64[0], lane1 = key.m256i_u64[1], lane2 = key.m256i_u64[2], lane3 = key.m256i_u64[3];
+    while (ptr + 32 <= end)
+    {
+        lane0 = rotateLeft64(lane0 + loadUnaligned64(ptr) * prime2, 31) * prime1;
+        lane1 = rotateLeft64(lane1 + loadUnaligned64(ptr + 8) * prime2, 31) * prime1;
+        lane2 = rotateLeft64(lane2 + loadUnaligned64(ptr + 16) * prime2, 31) * prime1;
+        lane3 = rotateLeft64(lane3 + loadUnaligned64(ptr + 24) * prime2, 31) * prime1;
+        ptr += 32;
+    }
+    unsigned long long hash = rotateLeft64(lane0, 1) + rotateLeft64(lane1, 7) + rotateLeft64(lane2, 12) + rotateLeft64(lane3, 18) + size;
+
+    while (ptr + 8 <= end)
+    {
+        hash ^= rotateLeft64(loadUnaligned64(ptr) * prime2, 31) * prime1;
+        hash = rotateLeft64(hash, 27) * prime1 + prime3;
+        ptr += 8;
+    }
+    while (ptr < end)
+    {
+        hash ^= (*ptr) * prime3;
+        hash = rotateLeft64(hash, 11) * prime1;
+        ++ptr;
+    }
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+
+// Filter for recognizing packets that have been received before. It stores the IDs of received packets (idBits
+// wide) in two bitmaps: the current generation (checked and set) and the previous generation (checked only).
+// After generationSize IDs have been added, the current generation becomes the previous one and the bitmap of the
+// previous generation is reused for the new current generation.
+// Instead of clearing a whole bitmap when rotating generations (512 MiB for 32-bit IDs), each block of the bitmaps
+// is tagged with the generation it belongs to. Blocks with outdated tag are treated as empty and cleared lazily when
+// the first ID is added to them. Not thread-safe, only used by the main thread.
+template <unsigned int idBits>
+class DejavuFilter
+{
+public:
+    static_assert(idBits > 12 && idBits <= 32, "unsupported number of ID bits");
+
+    static constexpr unsigned int blockBits = 12; // 4096 bits = 512 bytes per block
+    static constexpr unsigned long long bitmapSize = (1ULL << idBits) / 8;
+    static constexpr unsigned long long blockCount = 1ULL << (idBits - blockBits);
+    static constexpr unsigned long long bufferSize = 2 * bitmapSize + 2 * blockCount * sizeof(unsigned int);
+
+    // Set buffer of bufferSize bytes (doesn't need to be zeroed), key for hashing, and rotation period.
+    void init(void* buffer, const m256i& key, unsigned int generationSize)
+    {
+        ASSERT(buffer != nullptr);
+        ASSERT(generationSize > 0);
+        bitmaps[0] = (unsigned long long*)buffer;
+        bitmaps[1] = bitmaps[0] + bitmapSize / 8;
+        blockGenerations[0] = (unsigned int*)(bitmaps[1] + bitmapSize / 8);
+        blockGenerations[1] = blockGenerations[0] + blockCount;
+        setMem(blockGenerations[0], 2 * blockCount * sizeof(unsigned int), 0);
+
+        // Start with generation 2, so tag 0 of all blocks is neither current nor previous generation
+        generation = 2;
+        this->key = key;
+        this->generationSize = generationSize;
+        remainingIds = generationSize;
+    }
+
+    // Compute ID of packet with given total size (including header).
+    unsigned int computeId(const void* packet, unsigned int size) const
+    {
+        return (unsigned int)(computeDejavuHash(packet, size, key) >> (64 - idBits));
+    }
+
+    // Return if ID has been added in current or previous generation.
+    bool contains(unsigned int id) const
+    {
+        ASSERT((id >> blockBits) < blockCount);
+        const unsigned int block = id >> blockBits;
+        const unsigned long long mask = 1ULL << (id & 63);
+        const unsigned int current = generation & 1;
+        return (blockGenerations[current][block] == generation && (bitmaps[current][id >> 6] & mask))
+            || (blockGenerations[current ^ 1][block] == generation - 1 && (bitmaps[current ^ 1][id >> 6] & mask));
+    }
+
+    // Add ID to current generation. Rotates generations after generationSize calls.
+    void add(unsigned int id)
+    {
+        ASSERT((id >> blockBits) < blockCount);
+        const unsigned int block = id >> blockBits;
+        const unsigned int current = generation & 1;
+        if (blockGenerations[current][block] != generation)
+        {
+            // First ID in this block since the bitmap has been reused -> clear block
+            setMem(bitmaps[current] + ((unsigned long long)block << (blockBits - 6)), 1ULL << (blockBits - 3), 0);
+            blockGenerations[current][block] = generation;
+        }
+        bitmaps[current][id >> 6] |= 1ULL << (id & 63);
+
+        if (!--remainingIds)
+        {
+            ++generation;
+            remainingIds = generationSize;
+        }
+    }
+
+    // Return buffer passed to init().
+    void* getBuffer() const
+    {
+        return bitmaps[0];
+    }
+
+private:
+    unsigned long long* bitmaps[2];
+    unsigned int* blockGenerations[2];
+    unsigned int generation;
+    unsigned int generationSize;
+    unsigned int remainingIds;
+    m256i key;
+};
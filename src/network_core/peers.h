@@ -14,7 +14,8 @@
 #include "network_messages/common_response.h"
 
 #include "tcp4.h"
-#include "kangaroo_twelve.h"
+#include "transmit_queue.h"
+#include "dejavu_filter.h"
 
 #include "text_output.h"
 #include "private_settings.h"
@@ -40,6 +41,7 @@
 #define NUMBER_OF_PUBLIC_PEERS_TO_KEEP 10
 #define NUMBER_OF_WHITE_LIST_PEERS sizeof(whiteListPeers) / sizeof(whiteListPeers[0])
 #define NUMBER_OF_INCOMING_CONNECTIONS_RESERVED_FOR_WHITELIST_IPS 16
+#define PEER_TRANSMIT_QUEUE_SIZE (2 * BUFFER_SIZE) // Must be power of 2
 
 // OM related setting
 static constexpr unsigned int ORACLE_MACHINE_CONNECTION_TIMEOUT_SECS = 15; // Config timout for connecting attemp to OM
@@ -73,10 +75,9 @@ struct Peer
     void* receiveBuffer;
     EFI_TCP4_RECEIVE_DATA receiveData;
     EFI_TCP4_IO_TOKEN receiveToken;
-    EFI_TCP4_TRANSMIT_DATA transmitData;
+    Tcp4TransmitDataTwoFragments transmitData;
     EFI_TCP4_IO_TOKEN transmitToken;
-    char* dataToTransmit;
-    unsigned int dataToTransmitSize;
+    TransmitQueue transmitQueue;
     BOOLEAN isConnectingAccepting;
     BOOLEAN isConnectedAccepted;
     BOOLEAN isReceiving, isTransmitting;
@@ -172,7 +173,7 @@ struct Peer
         ocTransmitStartTime = 0;
         lastOcCloseTime = 0;
 
-        dataToTransmitSize = 0;
+        transmitQueue.reset();
         lastActiveTick = 0;
         trackRequestedCounter = 0;
         setMem(trackRequestedTick, sizeof(trackRequestedTick), 0);
@@ -209,9 +210,8 @@ IPv4Address ocIPv4Address[NUMBER_OF_OC_MACHINE_CONNECTIONS];
 static volatile long long numberOfOcInvocationsSent = 0;
 static volatile long long numberOfOcInvocationsDropped = 0;
 
-static unsigned long long* dejavu0 = NULL;
-static unsigned long long* dejavu1 = NULL;
-static unsigned int dejavuSwapCounter = DEJAVU_SWAP_LIMIT;
+// IDs of received packets for skipping duplicates, rotated after DEJAVU_SWAP_LIMIT packets
+static DejavuFilter<32> dejavuFilter;
 
 static volatile long long numberOfProcessedRequests = 0, prevNumberOfProcessedRequests = 0;
 static volatile long long numberOfDiscardedRequests = 0, prevNumberOfDiscardedRequests = 0;
@@ -385,38 +385,47 @@ static void closeAllPeers(bool closeMachineNodes = false)
     }
 }
 
-// Add message to sending buffer of specific peer, can only called from main thread (not thread-safe).
-static void push(Peer* peer, RequestResponseHeader* requestResponseHeader)
+// Add message given as header and payload (that may be stored separately) to sending buffer of specific peer.
+// Can be called from any thread. If the buffer is full, the peer is closed by the main thread in transmitData().
+static void pushParts(Peer* peer, const RequestResponseHeader* requestResponseHeader, const void* payload, unsigned int payloadSize)
 {
     PROFILE_SCOPE();
 
     // The sending buffer may queue multiple messages, each of which may need to transmitted in many small packets.
+    // The generation is read first, so the message is dropped if the peer is reset after checking the connection.
+    const long generation = peer->transmitQueue.getGeneration();
     if (peer->tcp4Protocol && peer->isConnectedAccepted && !peer->isClosing)
     {
-        if (peer->dataToTransmitSize + requestResponseHeader->size() > BUFFER_SIZE)
+        const unsigned int headerPartSize = requestResponseHeader->size() - payloadSize;
+        if (peer->transmitQueue.enqueue(generation, requestResponseHeader, headerPartSize, payload, payloadSize))
         {
-            // Buffer is full, which indicates a problem
-#ifndef NDEBUG
-            {
-                CHAR16 debugMessage[256];
-                setText(debugMessage, L"Warning: Peer transmit buffer overflow. IP: ");
-                appendIPv4Address(debugMessage, peer->address);
-                appendText(debugMessage, L" | dataToTransmitSize: ");
-                appendNumber(debugMessage, peer->dataToTransmitSize, true);
-                appendText(debugMessage, L" | requestResponseHeader->size(): ");
-                appendNumber(debugMessage, requestResponseHeader->size(), true);
-                addDebugMessage(debugMessage);
-            }
-#endif
-            closePeer(peer);
+            peer->trackDejavu(requestResponseHeader->dejavu());
+            _InterlockedIncrement64(&numberOfDisseminatedRequests);
         }
-        else
+    }
+}
+
+// Add message to sending buffer of specific peer. Can be called from any thread.
+static void push(Peer* peer, RequestResponseHeader* requestResponseHeader)
+{
+    pushParts(peer, requestResponseHeader, nullptr, 0);
+}
+
+// Add count messages with the same header and payloads + payloadIndices[i] * payloadSize to sending buffer of specific
+// peer at once (all or none). Can be called from any thread.
+static void pushBatch(Peer* peer, const RequestResponseHeader* requestResponseHeader, const void* payloads, unsigned int payloadSize,
+    const unsigned short* payloadIndices, unsigned int count)
+{
+    PROFILE_SCOPE();
+
+    const long generation = peer->transmitQueue.getGeneration();
+    if (peer->tcp4Protocol && peer->isConnectedAccepted && !peer->isClosing)
+    {
+        const unsigned int headerPartSize = requestResponseHeader->size() - payloadSize;
+        if (peer->transmitQueue.enqueueBatch(generation, requestResponseHeader, headerPartSize, payloads, payloadSize, payloadIndices, count))
         {
-            // Add message to buffer
-            copyMem(&peer->dataToTransmit[peer->dataToTransmitSize], requestResponseHeader, requestResponseHeader->size());
-            peer->dataToTransmitSize += requestResponseHeader->size();
             peer->trackDejavu(requestResponseHeader->dejavu());
-            _InterlockedIncrement64(&numberOfDisseminatedRequests);
+            ATOMIC_ADD64(numberOfDisseminatedRequests, count);
         }
     }
 }
@@ -492,11 +501,26 @@ static void pushToFullNodes(RequestResponseHeader* requestResponseHeader, int nu
     }
 }
 
+// Returns if the Peer pointer passed to enqueueResponse() is a placeholder for a group of peers
+// (NULL for random peers, 1 for Oracle Machine nodes, 2 for OC machine nodes) that is resolved by the main thread.
+static inline bool isPeerGroupPlaceholder(const Peer* peer)
+{
+    return ((unsigned long long)peer) <= 2;
+}
+
 // Add message to response queue of specific peer. If peer is NULL, it will be sent to random peers. Can be called from any thread.
+// Messages to a specific peer are added to the peer's transmit queue directly, messages to a group of peers go through
+// the global response queue, which is processed by the main thread.
 static void enqueueResponse(Peer* peer, RequestResponseHeader* responseHeader)
 {
     PROFILE_SCOPE();
 
+    if (!isPeerGroupPlaceholder(peer))
+    {
+        push(peer, responseHeader);
+        return;
+    }
+
     ACQUIRE(responseQueueHeadLock);
 
     if ((responseQueueBufferHead >= responseQueueBufferTail || responseQueueBufferHead + responseHeader->size() < responseQueueBufferTail)
@@ -637,6 +661,24 @@ static void enqueueResponse(Peer* peer, unsigned int dataSize, unsigned char typ
 {
     PROFILE_SCOPE();
 
+    if (!isPeerGroupPlaceholder(peer))
+    {
+        // Copy header and payload directly to transmit queue of the peer
+        ASSERT(data || !dataSize);
+        RequestResponseHeader responseHeader;
+        if (!responseHeader.checkAndSetSize(sizeof(RequestResponseHeader) + dataSize))
+        {
+#ifndef NDEBUG
+            addDebugMessage(L"Error: Message size exceeds maximum message size!");
+#endif
+            return;
+        }
+        responseHeader.setType(type);
+        responseHeader.setDejavu(dejavu);
+        pushParts(peer, &responseHeader, data, dataSize);
+        return;
+    }
+
     ACQUIRE(responseQueueHeadLock);
 
     if ((responseQueueBufferHead >= responseQueueBufferTail || responseQueueBufferHead + sizeof(RequestResponseHeader) + dataSize < responseQueueBufferTail)
@@ -672,6 +714,37 @@ static void enqueueResponse(Peer* peer, unsigned int dataSize, unsigned char typ
     RELEASE(responseQueueHeadLock);
 }
 
+// Add count messages of the same type with payloads of equal size (payloads + payloadIndices[i] * payloadSize) to
+// response queue of specific peer. Same as calling enqueueResponse() for each payload, but messages to a specific peer
+// are added to its transmit queue at once. Can be called from any thread.
+static void enqueueResponseBatch(Peer* peer, unsigned int payloadSize, unsigned char type, unsigned int dejavu,
+    const void* payloads, const unsigned short* payloadIndices, unsigned int count)
+{
+    PROFILE_SCOPE();
+
+    if (!count)
+        return;
+
+    if (isPeerGroupPlaceholder(peer))
+    {
+        for (unsigned int i = 0; i < count; ++i)
+            enqueueResponse(peer, payloadSize, type, dejavu, ((const unsigned char*)payloads) + (unsigned long long)payloadIndices[i] * payloadSize);
+        return;
+    }
+
+    RequestResponseHeader responseHeader;
+    if (!responseHeader.checkAndSetSize(sizeof(RequestResponseHeader) + payloadSize))
+    {
+#ifndef NDEBUG
+        addDebugMessage(L"Error: Message size exceeds maximum message size!");
+#endif
+        return;
+    }
+    responseHeader.setType(type);
+    responseHeader.setDejavu(dejavu);
+    pushBatch(peer, &responseHeader, payloads, payloadSize, payloadIndices, count);
+}
+
 /**
 * checks if a given address is a bogon address
 * a bogon address is an ip address which should not be used publicly (e.g. private networks)
@@ -931,7 +1004,7 @@ static bool peerConnectionNewlyEstablished(unsigned int i)
 // This function process all data that arrive in FragmentBuffer.
 // based on RequestResponseHeader to determine whether the received packet is completed or not
 // if it receives a completed packet, it will copy the packet to requestQueueElements to process later in requestProcessors
-static void processReceivedData(unsigned int i, unsigned int salt)
+static void processReceivedData(unsigned int i)
 {
     PROFILE_SCOPE();
 
@@ -977,25 +1050,19 @@ static void processReceivedData(unsigned int i, unsigned int salt)
                         {
                             if (receivedDataSize >= requestResponseHeader->size())
                             {
-                                // Compute saltId of packet with K12 of payload and header (size + type temporarily
-                                // overwritten with salt). This is used recognized and skip packet duplicates with
-                                // dejavu0 (checking/setting flag for received package). After receiving a certain
-                                // number of packages (DEJAVU_SWAP_LIMIT), dejavu0 is moved to dejavu1 for checking
-                                // and dejavu0 is initialized with an empty buffer for checking/setting.
-                                unsigned int saltedId;
-                                const unsigned int header = *((unsigned int*)requestResponseHeader);
-                                *((unsigned int*)requestResponseHeader) = salt;
-                                KangarooTwelve(requestResponseHeader, header & 0xFFFFFF, &saltedId, sizeof(saltedId));
-                                *((unsigned int*)requestResponseHeader) = header;
+                                // Compute ID of packet with keyed hash of header and payload. This is used to
+                                // recognize and skip packet duplicates with the dejavu filter, which remembers the
+                                // IDs of the last DEJAVU_SWAP_LIMIT to 2 * DEJAVU_SWAP_LIMIT accepted packets.
+                                const unsigned int dejavuId = dejavuFilter.computeId(requestResponseHeader, requestResponseHeader->size());
 
                                 // Initiate transfer of already received packet to processing thread
                                 // (or drop it without processing if Dejavu filter tells to ignore it)
-                                if (!((dejavu0[saltedId >> 6] | dejavu1[saltedId >> 6]) & (1ULL << (saltedId & 63))))
+                                if (!dejavuFilter.contains(dejavuId))
                                 {
                                     if ((requestQueueBufferHead >= requestQueueBufferTail || requestQueueBufferHead + requestResponseHeader->size() < requestQueueBufferTail)
                                         && (unsigned short)(requestQueueElementHead + 1) != requestQueueElementTail)
                                     {
-                                        dejavu0[saltedId >> 6] |= (1ULL << (saltedId & 63));
+                                        dejavuFilter.add(dejavuId);
 
                                         ASSERT(requestQueueElementHead < REQUEST_QUEUE_LENGTH);
                                         ASSERT(requestQueueBufferHead < REQUEST_QUEUE_BUFFER_SIZE);
@@ -1011,14 +1078,6 @@ static void processReceivedData(unsigned int i, unsigned int salt)
                                         }
                                         // TODO: Place a fence
                                         requestQueueElementHead++;
-
-                                        if (!(--dejavuSwapCounter))
-                                        {
-                                            unsigned long long* tmp = dejavu1;
-                                            dejavu1 = dejavu0;
-                                            setMem(dejavu0 = tmp, 536870912, 0);
-                                            dejavuSwapCounter = DEJAVU_SWAP_LIMIT;
-                                        }
                                     }
                                     else
                                     {
@@ -1046,7 +1105,7 @@ static void processReceivedData(unsigned int i, unsigned int salt)
 }
 
 // Signaling the system to receive data from this connection
-static void receiveData(unsigned int i, unsigned int salt)
+static void receiveData(unsigned int i)
 {
     PROFILE_SCOPE();
 
@@ -1094,7 +1153,7 @@ static void receiveData(unsigned int i, unsigned int salt)
 }
 
 // Checking the status last queued data for transmitting
-static void processTransmittedData(unsigned int i, unsigned int salt)
+static void processTransmittedData(unsigned int i)
 {
     PROFILE_SCOPE();
 
@@ -1145,8 +1204,9 @@ static void processTransmittedData(unsigned int i, unsigned int salt)
                 }
                 else
                 {
-                    // success
+                    // success -> free space in transmit queue
                     numberOfTransmittedBytes += peers[i].transmitData.DataLength;
+                    peers[i].transmitQueue.release(peers[i].transmitData.DataLength);
 
                     // Update OM activity time on successful transmit so the inactivity
                     // timer doesn't kill connections that are actively sending queries
@@ -1165,14 +1225,31 @@ static void processTransmittedData(unsigned int i, unsigned int salt)
 }
 
 // Enqueue data for transmitting
-static void transmitData(unsigned int i, unsigned int salt)
+static void transmitData(unsigned int i)
 {
     PROFILE_SCOPE();
 
     EFI_STATUS status;
     if (((unsigned long long)peers[i].tcp4Protocol) > 1)
     {
-        if (peers[i].dataToTransmitSize && !peers[i].isTransmitting && peers[i].isConnectedAccepted && !peers[i].isClosing)
+        if (peers[i].transmitQueue.hasOverflowed() && !peers[i].isClosing)
+        {
+            // Buffer is full, which indicates a problem
+#ifndef NDEBUG
+            {
+                CHAR16 debugMessage[256];
+                setText(debugMessage, L"Warning: Peer transmit buffer overflow. IP: ");
+                appendIPv4Address(debugMessage, peers[i].address);
+                appendText(debugMessage, L" | queued size: ");
+                appendNumber(debugMessage, peers[i].transmitQueue.size(), true);
+                addDebugMessage(debugMessage);
+            }
+#endif
+            closePeer(&peers[i]);
+            return;
+        }
+
+        if (peers[i].transmitQueue.size() && !peers[i].isTransmitting && peers[i].isConnectedAccepted && !peers[i].isClosing)
         {
             EFI_TCP4_CONNECTION_STATE state;
             if ((status = peers[i].tcp4Protocol->GetModeData(peers[i].tcp4Protocol, &state, NULL, NULL, NULL, NULL))
@@ -1182,9 +1259,17 @@ static void transmitData(unsigned int i, unsigned int salt)
             }
             else
             {
-                // initiate transmission
-                copyMem(peers[i].transmitData.FragmentTable[0].FragmentBuffer, peers[i].dataToTransmit, peers[i].transmitData.DataLength = peers[i].transmitData.FragmentTable[0].FragmentLength = peers[i].dataToTransmitSize);
-                peers[i].dataToTransmitSize = 0;
+                // initiate transmission directly from transmit queue (data is released after transmission has completed)
+                void* fragmentBuffers[2];
+                unsigned int fragmentSizes[2];
+                peers[i].transmitData.FragmentCount = peers[i].transmitQueue.getFragments(BUFFER_SIZE, fragmentBuffers, fragmentSizes);
+                peers[i].transmitData.DataLength = 0;
+                for (unsigned int j = 0; j < peers[i].transmitData.FragmentCount; j++)
+                {
+                    peers[i].transmitData.FragmentTable[j].FragmentBuffer = fragmentBuffers[j];
+                    peers[i].transmitData.FragmentTable[j].FragmentLength = fragmentSizes[j];
+                    peers[i].transmitData.DataLength += fragmentSizes[j];
+                }
                 if (status = peers[i].tcp4Protocol->Transmit(peers[i].tcp4Protocol, &peers[i].transmitToken))
                 {
                     logStatusToConsole(L"EFI_TCP4_PROTOCOL.Transmit() fails", status, __LINE__);
@@ -1208,17 +1293,17 @@ static void transmitData(unsigned int i, unsigned int salt)
     }
 }
 
-static void peerReceiveAndTransmit(unsigned int i, unsigned int salt)
+static void peerReceiveAndTransmit(unsigned int i)
 {
     // poll to receive incoming data and transmit outgoing segments
     if (((unsigned long long)peers[i].tcp4Protocol) > 1)
     {
         PROFILE_SCOPE();
         peers[i].tcp4Protocol->Poll(peers[i].tcp4Protocol);
-        processReceivedData(i, salt);
-        receiveData(i, salt);
-        processTransmittedData(i, salt);
-        transmitData(i, salt);
+        processReceivedData(i);
+        receiveData(i);
+        processTransmittedData(i);
+        transmitData(i);
     }
 }
 
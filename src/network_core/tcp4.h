@@ -11,6 +11,18 @@
 #define BUFFER_SIZE 33554432
 static_assert(RequestResponseHeader::max_size * 2 + 2 == BUFFER_SIZE, "unexpected buffer size");
 
+// EFI_TCP4_TRANSMIT_DATA with space for two fragments (the fragment table of the UEFI struct has variable length).
+// Used for transmitting data that wraps around the end of a ring buffer without copying it.
+struct Tcp4TransmitDataTwoFragments
+{
+    BOOLEAN Push;
+    BOOLEAN Urgent;
+    unsigned int DataLength;
+    unsigned int FragmentCount;
+    EFI_TCP4_FRAGMENT_DATA FragmentTable[2];
+};
+static_assert(offsetof(Tcp4TransmitDataTwoFragments, FragmentTable) == offsetof(EFI_TCP4_TRANSMIT_DATA, FragmentTable), "unexpected layout");
+
 
 static EFI_GUID tcp4ServiceBindingProtocolGuid = EFI_TCP4_SERVICE_BINDING_PROTOCOL_GUID;
 static EFI_SERVICE_BINDING_PROTOCOL* tcp4ServiceBindingProtocol = NULL;
@@ -0,0 +1,236 @@
+// per-peer transmit queue (lock-free ring buffer with multiple producers and a single consumer)
+
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+#include "platform/assert.h"
+#include "platform/concurrency.h"
+#include "platform/memory.h"
+
+
+// Ring buffer of outgoing messages of one peer connection.
+// Any thread may append complete messages with enqueue() without taking a global lock. Writers reserve space with a
+// compare-and-swap and publish their message in reservation order after copying it into the ring.
+// The main thread is the only consumer: it passes the committed bytes to the TCP4 protocol directly from the ring
+// (as up to two fragments if the data wraps around the end of the buffer) and calls release() after transmission
+// has completed. Thus, each message is copied only once between the producer and the network stack.
+// Each connection of the peer is a generation of the queue. Producers read the generation before checking the
+// connection state and pass it to enqueue(), which drops the message if the queue has been reset in the meantime.
+// So a message for a closed connection never ends up in the queue of the next connection.
+class TransmitQueue
+{
+public:
+    // Set buffer used as ring storage and discard all data. Capacity must be a power of 2. Not thread-safe.
+    void init(unsigned char* buffer, unsigned long long capacity)
+    {
+        ASSERT(buffer != nullptr);
+        ASSERT(capacity && (capacity & (capacity - 1)) == 0);
+        this->buffer = buffer;
+        this->capacity = capacity;
+        begin = 0;
+        reservedEnd = 0;
+        committedEnd = 0;
+        overflow = 0;
+        generation = 0;
+        activeWriters = 0;
+    }
+
+    // Discard all queued data, clear overflow flag, and start a new generation. Only call from consumer thread while
+    // no transmission of data from this queue is in progress. Waits until concurrent enqueue() calls of the old
+    // generation have published their data.
+    void reset()
+    {
+        // After the increment, enqueue() calls that have not registered as writers yet see the new generation and
+        // drop their message.
+        _InterlockedIncrement(&generation);
+        while (activeWriters)
+            _mm_pause();
+        begin = ATOMIC_LOAD64(committedEnd);
+        overflow = 0;
+    }
+
+    // Return the generation to pass to enqueue(). Read it before checking that the connection is open.
+    long getGeneration() const
+    {
+        return generation;
+    }
+
+    // Append message consisting of two parts (for example header and payload) as one contiguous byte sequence.
+    // Returns false if the queue has been reset since reading expectedGeneration. Returns false and sets overflow
+    // flag if there is not enough free space. Can be called from any thread.
+    bool enqueue(long expectedGeneration, const void* data0, unsigned int size0, const void* data1 = nullptr, unsigned int size1 = 0)
+    {
+        ASSERT(buffer != nullptr);
+        const long long size = (long long)size0 + size1;
+        if (!beginWrite(expectedGeneration))
+            return false;
+
+        // Reserve space
+        long long start;
+        while (1)
+        {
+            start = reservedEnd;
+            if (start + size - begin > (long long)capacity)
+            {
+                overflow = 1;
+                _InterlockedDecrement(&activeWriters);
+                return false;
+            }
+            if (_InterlockedCompareExchange64(&reservedEnd, start + size, start) == start)
+                break;
+        }
+
+        // Copy message into reserved space (may wrap around end of buffer)
+        copyToRing(start, data0, size0);
+        if (size1)
+            copyToRing(start + size0, data1, size1);
+
+        // Publish in order of reservation: wait for writers that reserved space before us
+        while (ATOMIC_LOAD64(committedEnd) != start)
+            _mm_pause();
+        ATOMIC_STORE64(committedEnd, start + size);
+
+        _InterlockedDecrement(&activeWriters);
+        return true;
+    }
+
+    // Append count messages with one reservation, each consisting of the same header followed by the payload at
+    // payloads + payloadIndices[i] * payloadSize. Either all or none of the messages are added.
+    // Returns false if the queue has been reset since reading expectedGeneration. Returns false and sets overflow
+    // flag if there is not enough free space. Can be called from any thread.
+    bool enqueueBatch(long expectedGeneration, const void* header, unsigned int headerSize, const void* payloads, unsigned int payloadSize,
+        const unsigned short* payloadIndices, unsigned int count)
+    {
+        ASSERT(buffer != nullptr);
+        const long long messageSize = (long long)headerSize + payloadSize;
+        const long long size = messageSize * count;
+        if (!beginWrite(expectedGeneration))
+            return false;
+
+        // Reserve space
+        long long start;
+        while (1)
+        {
+            start = reservedEnd;
+            if (start + size - begin > (long long)capacity)
+            {
+                overflow = 1;
+                _InterlockedDecrement(&activeWriters);
+                return false;
+            }
+            if (_InterlockedCompareExchange64(&reservedEnd, start + size, start) == start)
+                break;
+        }
+
+        // Copy messages into reserved space
+        long long pos = start;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            copyToRing(pos, header, headerSize);
+            copyToRing(pos + headerSize, ((const unsigned char*)payloads) + (unsigned long long)payloadIndices[i] * payloadSize, payloadSize);
+            pos += messageSize;
+        }
+
+        // Publish in order of reservation: wait for writers that reserved space before us
+        while (ATOMIC_LOAD64(committedEnd) != start)
+            _mm_pause();
+        ATOMIC_STORE64(committedEnd, start + size);
+
+        _InterlockedDecrement(&activeWriters);
+        return true;
+    }
+
+    // Return number of bytes that are published and not released yet (includes bytes in transmission).
+    unsigned long long size() const
+    {
+        return committedEnd - begin;
+    }
+
+    // Get up to maxSize bytes of published data starting at the oldest byte that has not been released, without copying.
+    // Returns number of fragments (0, 1, or 2) written to fragmentBuffers and fragmentSizes. Only call from consumer thread.
+    unsigned int getFragments(unsigned long long maxSize, void* fragmentBuffers[2], unsigned int fragmentSizes[2])
+    {
+        const long long start = begin;
+        const long long end = ATOMIC_LOAD64(committedEnd);
+        if (end <= start)
+            return 0;
+
+        unsigned long long totalSize = end - start;
+        if (totalSize > maxSize)
+            totalSize = maxSize;
+
+        const unsigned long long startIdx = start & (capacity - 1);
+        const unsigned long long firstSize = (startIdx + totalSize <= capacity) ? totalSize : capacity - startIdx;
+        fragmentBuffers[0] = buffer + startIdx;
+        fragmentSizes[0] = (unsigned int)firstSize;
+        if (firstSize == totalSize)
+            return 1;
+
+        fragmentBuffers[1] = buffer;
+        fragmentSizes[1] = (unsigned int)(totalSize - firstSize);
+        return 2;
+    }
+
+    // Release given number of the oldest bytes, making space for new messages. Only call from consumer thread.
+    void release(unsigned long long size)
+    {
+        ASSERT(begin + (long long)size <= committedEnd);
+        ATOMIC_STORE64(begin, begin + size);
+    }
+
+    // Return if enqueue() has failed due to lack of space since last reset().
+    bool hasOverflowed() const
+    {
+        return overflow != 0;
+    }
+
+    // Return buffer passed to init().
+    unsigned char* getBuffer() const
+    {
+        return buffer;
+    }
+
+private:
+    // Register as writer if the queue is still in the expected generation. reset() waits for registered writers,
+    // so the data of a successful call is either published before reset() discards it or not written at all.
+    bool beginWrite(long expectedGeneration)
+    {
+        _InterlockedIncrement(&activeWriters);
+        if (generation != expectedGeneration)
+        {
+            _InterlockedDecrement(&activeWriters);
+            return false;
+        }
+        return true;
+    }
+
+    void copyToRing(long long pos, const void* data, unsigned long long size)
+    {
+        const unsigned long long idx = pos & (capacity - 1);
+        if (idx + size <= capacity)
+        {
+            copyMem(buffer + idx, data, size);
+        }
+        else
+        {
+            const unsigned long long firstSize = capacity - idx;
+            copyMem(buffer + idx, data, firstSize);
+            copyMem(buffer, ((const unsigned char*)data) + firstSize, size - firstSize);
+        }
+    }
+
+    unsigned char* buffer;
+    unsigned long long capacity;
+
+    // Stream positions (increasing monotonically, buffer index is position modulo capacity):
+    // [begin, committedEnd) is published data, [committedEnd, reservedEnd) is being written by producers.
+    volatile long long begin;
+    volatile long long reservedEnd;
+    volatile long long committedEnd;
+
+    // Connection generation, incremented by reset(), and number of enqueue() calls in progress
+    volatile long generation;
+    volatile long activeWriters;
+
+    volatile char overflow;
+};
@@ -51,10 +51,13 @@ enum NetworkMessageType : unsigned char
     BROADCAST_CUSTOM_MINING_SOLUTION = 69,
     REQUEST_REVENUE_DATA = 70,
     RESPOND_REVENUE_DATA = 71,
+    REQUEST_TICK_RANGE = 72,
     ORACLE_MACHINE_QUERY = 190, // only on communication channel Core node <-> OM node
     ORACLE_MACHINE_REPLY = 191, // only on communication channel Core node <-> OM node
     OC_MACHINE_INVOCATION = 192, // only on communication channel Core node <-> OC machine
     REQUEST_TX_STATUS = 201, // tx addon only
     RESPOND_TX_STATUS = 202, // tx addon only
+    REQUEST_TX_STATUS_BATCH = 203, // tx addon only
+    RESPOND_TX_STATUS_BATCH = 204, // tx addon only
     SPECIAL_COMMAND = 255,
 };
@@ -115,4 +115,24 @@ struct SpecialCommandExecutionFeeMultiplierRequestAndResponse
     unsigned long long everIncreasingNonceAndCommandType;
     unsigned long long multiplierNumerator;
     unsigned long long multiplierDenominator;
-};
\ No newline at end of file
+};
+
+#define SPECIAL_COMMAND_GET_PROFILING_DATA 21ULL
+// Response to SPECIAL_COMMAND_GET_PROFILING_DATA (only filled in nodes built with ENABLE_PROFILING). The node sends one
+// response per profiling entry (scope name and line) of each processor, followed by END_RESPONSE. Run times are in
+// ticks of the time stamp counter with the given frequency. runtimeHistogram[i] counts the executions with a run time
+// in [2^i, 2^(i+1)) ticks, the last bucket counts all longer ones.
+struct SpecialCommandGetProfilingDataResponse
+{
+    unsigned long long everIncreasingNonceAndCommandType;
+    unsigned long long frequency;
+    char name[64]; // truncated if longer
+    unsigned long long line;
+    unsigned int processor; // processor ID modulo the number of profiling shards
+    unsigned int padding;
+    unsigned long long numOfExec;
+    unsigned long long runtimeSum;
+    unsigned long long runtimeMin;
+    unsigned long long runtimeMax;
+    unsigned long long runtimeHistogram[48];
+};
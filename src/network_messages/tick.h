@@ -120,6 +120,36 @@ struct RequestTickData
     }
 };
 
+
+// Request for catching up: the tick data, quorum votes, and transactions of the ticks [firstTick, firstTick + numberOfTicks[
+// that have already been processed by the peer. The response is a stream of BroadcastFutureTickData, BroadcastTick,
+// and BROADCAST_TRANSACTION messages (selected by flags), ordered by tick and ended by EndResponse. The peer may stop
+// early, for example if its send buffer is filling up, so the requester should continue after the last tick received.
+struct RequestTickRange
+{
+    enum
+    {
+        tickDataFlag = 1,
+        votesFlag = 2,
+        transactionsFlag = 4,
+        allFlags = tickDataFlag | votesFlag | transactionsFlag,
+    };
+
+    unsigned int firstTick;
+    unsigned short numberOfTicks;
+    unsigned char flags;
+    unsigned char _padding;
+
+    static constexpr unsigned short maxNumberOfTicks = 16;
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::REQUEST_TICK_RANGE;
+    }
+};
+
+static_assert(sizeof(RequestTickRange) == 8, "Something is wrong with the struct size.");
+
 struct RequestCurrentTickInfo
 {
     static constexpr unsigned char type()
@@ -0,0 +1,78 @@
+// parallel processing of the chunks of a job by the calling processor and idle helper processors
+
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+
+#include "platform/assert.h"
+#include "platform/concurrency.h"
+
+
+// Function processing one chunk of a job
+typedef void (*ChunkFunction)(void* context, unsigned int chunkIndex);
+
+// Splits a job into chunks that are processed concurrently by the processor calling run() and by helper processors,
+// which call tryHelp() in their idle loop (the request processors). run() processes chunks itself until none is left,
+// so it also finishes without any helper (for example in tests). Chunks must be independent of each other.
+// Only one job runs at a time, concurrent calls of run() are serialized.
+class ChunkedJob
+{
+public:
+    // Process chunks [0, chunkCount[ and return when all of them are finished.
+    void run(ChunkFunction function, void* context, unsigned int chunkCount)
+    {
+        ACQUIRE(runLock);
+        this->function = function;
+        this->context = context;
+        this->chunkCount = chunkCount;
+        nextChunk = 0;
+        unfinishedChunks = chunkCount;
+        ATOMIC_STORE8(active, 1);
+
+        processChunks();
+        WAIT_WHILE(unfinishedChunks);
+
+        // Wait until all helpers have left processChunks() before the job may be changed by the next run()
+        ATOMIC_STORE8(active, 0);
+        WAIT_WHILE(helpers);
+        RELEASE(runLock);
+    }
+
+    // Process chunks of the running job, if any. Returns false if there was no chunk left.
+    bool tryHelp()
+    {
+        // Cheap check without atomic operation, so idle processors don't contend for the cache line
+        if (!active)
+            return false;
+
+        _InterlockedIncrement(&helpers);
+        const bool helped = active && processChunks();
+        _InterlockedDecrement(&helpers);
+        return helped;
+    }
+
+private:
+    bool processChunks()
+    {
+        bool processed = false;
+        while (true)
+        {
+            const unsigned int chunkIndex = (unsigned int)_InterlockedIncrement(&nextChunk) - 1;
+            if (chunkIndex >= chunkCount)
+                break;
+            function(context, chunkIndex);
+            _InterlockedDecrement(&unfinishedChunks);
+            processed = true;
+        }
+        return processed;
+    }
+
+    ChunkFunction function;
+    void* context;
+    unsigned int chunkCount;
+    volatile long nextChunk;
+    volatile long unfinishedChunks;
+    volatile long helpers;
+    volatile char active;
+    volatile char runLock;
+};
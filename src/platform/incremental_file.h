@@ -0,0 +1,316 @@
+// incremental saving of large state buffers (only chunks with changed content are written)
+
+#pragma once
+
+#include "platform/m256.h"
+#include "platform/file_io.h"
+#include "platform/startup_workers.h"
+
+#include "kangaroo_twelve.h"
+
+
+#define INCREMENTAL_FILE_CHUNK_SIZE (16ULL * 1024 * 1024)
+#define INCREMENTAL_FILE_MAX_CHUNKS 1000 // limited by 3 digits of chunk file name extension
+
+// Manifest of a file saved with saveIncrementalFile(). The buffer is stored in chunk files "<fileName>.XXX" and
+// the manifest "<fileName>.mft" holds the K12 digest of each chunk. Only chunkCount digests are written to disk.
+struct IncrementalFileManifest
+{
+    unsigned long long totalSize;
+    unsigned long long chunkSize;
+    unsigned int chunkCount;
+    unsigned int padding;
+    m256i manifestDigest; // K12 of chunkDigests[0 ... chunkCount - 1]
+    m256i chunkDigests[INCREMENTAL_FILE_MAX_CHUNKS];
+
+    static unsigned int getChunkCount(unsigned long long totalSize, unsigned long long chunkSize)
+    {
+        return (unsigned int)((totalSize + chunkSize - 1) / chunkSize);
+    }
+
+    static unsigned long long getFileSize(unsigned int chunkCount)
+    {
+        return offsetof(IncrementalFileManifest, chunkDigests) + chunkCount * sizeof(m256i);
+    }
+
+    unsigned long long getChunkSize(unsigned int chunkIndex) const
+    {
+        return (chunkIndex + 1 < chunkCount) ? chunkSize : totalSize - chunkIndex * chunkSize;
+    }
+
+    void computeManifestDigest(m256i& digest) const
+    {
+        KangarooTwelve(chunkDigests, chunkCount * sizeof(m256i), &digest, sizeof(digest));
+    }
+};
+
+// Manifest buffer used by loadIncrementalFile() (static because of size, so only call from main thread)
+static IncrementalFileManifest incrementalFileLoadManifest;
+
+static void getIncrementalFileName(CHAR16* dst, const CHAR16* fileName, unsigned int chunkIndex)
+{
+    setText(dst, fileName);
+    appendText(dst, L".XXX");
+    addEpochToFileName(dst, getTextSize(dst, 64) + 1, chunkIndex);
+}
+
+static void getIncrementalFileManifestName(CHAR16* dst, const CHAR16* fileName)
+{
+    setText(dst, fileName);
+    appendText(dst, L".mft");
+}
+
+// Load manifest of file and check that it matches the expected sizes. Returns false if it is missing or invalid.
+static bool loadIncrementalFileManifest(IncrementalFileManifest& manifest, const CHAR16* fileName, unsigned long long totalSize, unsigned long long chunkSize, const CHAR16* directory)
+{
+    CHAR16 manifestName[64];
+    getIncrementalFileManifestName(manifestName, fileName);
+    const unsigned int chunkCount = IncrementalFileManifest::getChunkCount(totalSize, chunkSize);
+    const unsigned long long manifestSize = IncrementalFileManifest::getFileSize(chunkCount);
+    if (load(manifestName, manifestSize, (unsigned char*)&manifest, directory) != manifestSize)
+        return false;
+    if (manifest.totalSize != totalSize || manifest.chunkSize != chunkSize || manifest.chunkCount != chunkCount)
+        return false;
+    m256i digest;
+    manifest.computeManifestDigest(digest);
+    return digest == manifest.manifestDigest;
+}
+
+static bool saveIncrementalFileManifest(IncrementalFileManifest& manifest, const CHAR16* fileName, const CHAR16* directory)
+{
+    CHAR16 manifestName[64];
+    getIncrementalFileManifestName(manifestName, fileName);
+    manifest.computeManifestDigest(manifest.manifestDigest);
+    const unsigned long long manifestSize = IncrementalFileManifest::getFileSize(manifest.chunkCount);
+    return save(manifestName, manifestSize, (const unsigned char*)&manifest, directory) == manifestSize;
+}
+
+// Saves a buffer as chunk files plus manifest, only writing the chunks whose digest differs from the manifest of the
+// previous save. Before changed chunks are overwritten, their digests are cleared in the previous manifest on disk,
+// so an interrupted save never leaves a manifest that claims a chunk content that isn't on disk.
+// The work is split into steps of one chunk (hashing or writing), so saving can be interleaved with other work of
+// the main thread. The buffer must not change until saving is finished.
+class IncrementalFileWriter
+{
+public:
+    // Start saving. Returns false on error (too many chunks).
+    bool begin(const CHAR16* fileName, unsigned long long totalSize, const unsigned char* buffer, const CHAR16* directory = NULL,
+        unsigned long long chunkSize = INCREMENTAL_FILE_CHUNK_SIZE)
+    {
+        ASSERT(!isActive());
+        ASSERT(chunkSize > 0 && chunkSize <= 0xFFFFFFFF);
+        writtenSize = 0;
+        const unsigned int chunkCount = IncrementalFileManifest::getChunkCount(totalSize, chunkSize);
+        if (chunkCount > INCREMENTAL_FILE_MAX_CHUNKS)
+        {
+            logToConsole(L"IncrementalFileWriter: INCREMENTAL_FILE_MAX_CHUNKS exceeded!");
+            stage = FAILED;
+            return false;
+        }
+
+        setText(this->fileName, fileName);
+        hasDirectory = (directory != NULL);
+        if (hasDirectory)
+            setText(this->directory, directory);
+        this->buffer = buffer;
+
+        hasPrevManifest = loadIncrementalFileManifest(prevManifest, fileName, totalSize, chunkSize, directory);
+        newManifest.totalSize = totalSize;
+        newManifest.chunkSize = chunkSize;
+        newManifest.chunkCount = chunkCount;
+        newManifest.padding = 0;
+        changedChunks = 0;
+        nextChunk = 0;
+        stage = HASHING;
+        return true;
+    }
+
+    // Process next chunk. Returns true if there is more work to do, false if saving is finished or has failed.
+    bool step()
+    {
+        if (stage == HASHING)
+        {
+            if (nextChunk < newManifest.chunkCount)
+            {
+                const unsigned int i = nextChunk++;
+                KangarooTwelve(buffer + i * newManifest.chunkSize, (unsigned int)newManifest.getChunkSize(i), &newManifest.chunkDigests[i], sizeof(m256i));
+                if (!hasPrevManifest || prevManifest.chunkDigests[i] != newManifest.chunkDigests[i])
+                {
+                    prevManifest.chunkDigests[i] = m256i::zero();
+                    ++changedChunks;
+                }
+                return true;
+            }
+
+            if (hasPrevManifest && !changedChunks)
+            {
+                stage = DONE;
+                return false;
+            }
+            if (hasPrevManifest && !saveIncrementalFileManifest(prevManifest, fileName, getDirectory()))
+            {
+                stage = FAILED;
+                return false;
+            }
+            nextChunk = 0;
+            stage = WRITING;
+        }
+
+        if (stage == WRITING)
+        {
+            while (nextChunk < newManifest.chunkCount && hasPrevManifest && !isZero(prevManifest.chunkDigests[nextChunk]))
+                ++nextChunk;
+
+            if (nextChunk < newManifest.chunkCount)
+            {
+                const unsigned int i = nextChunk++;
+                CHAR16 chunkName[64];
+                getIncrementalFileName(chunkName, fileName, i);
+                const unsigned long long size = newManifest.getChunkSize(i);
+                if (save(chunkName, size, buffer + i * newManifest.chunkSize, getDirectory()) != size)
+                {
+                    stage = FAILED;
+                    return false;
+                }
+                writtenSize += size;
+                return true;
+            }
+
+            stage = (saveIncrementalFileManifest(newManifest, fileName, getDirectory())) ? DONE : FAILED;
+        }
+
+        return false;
+    }
+
+    bool isActive() const
+    {
+        return stage == HASHING || stage == WRITING;
+    }
+
+    bool hasFailed() const
+    {
+        return stage == FAILED;
+    }
+
+    // Return number of bytes written to chunk files by current/last save.
+    unsigned long long getWrittenSize() const
+    {
+        return writtenSize;
+    }
+
+private:
+    enum Stage { IDLE = 0, HASHING, WRITING, DONE, FAILED };
+
+    const CHAR16* getDirectory() const
+    {
+        return (hasDirectory) ? directory : NULL;
+    }
+
+    IncrementalFileManifest prevManifest;
+    IncrementalFileManifest newManifest;
+    const unsigned char* buffer;
+    unsigned long long writtenSize;
+    unsigned int changedChunks;
+    unsigned int nextChunk;
+    Stage stage;
+    bool hasPrevManifest;
+    bool hasDirectory;
+    CHAR16 fileName[64];
+    CHAR16 directory[64];
+};
+
+// Writer used by saveIncrementalFile() and for saving node states in the background (only used by main thread)
+static IncrementalFileWriter incrementalFileWriter;
+
+// Save buffer with IncrementalFileWriter at once (see above).
+// Returns totalSize on success and -1 on error. If writtenSize is passed, it receives the number of bytes written.
+static long long saveIncrementalFile(const CHAR16* fileName, unsigned long long totalSize, const unsigned char* buffer, const CHAR16* directory = NULL,
+    unsigned long long* writtenSize = NULL, unsigned long long chunkSize = INCREMENTAL_FILE_CHUNK_SIZE)
+{
+    if (incrementalFileWriter.begin(fileName, totalSize, buffer, directory, chunkSize))
+    {
+        while (incrementalFileWriter.step())
+        {
+        }
+    }
+    if (writtenSize)
+        *writtenSize = incrementalFileWriter.getWrittenSize();
+    return (incrementalFileWriter.hasFailed()) ? -1 : (long long)totalSize;
+}
+
+// Context of verifying loaded chunks with startupWorkers
+struct IncrementalFileVerification
+{
+    const IncrementalFileManifest* manifest;
+    const unsigned char* buffer;
+    volatile char mismatch;
+
+    static void verifyChunk(void* context, unsigned long long chunkIndex)
+    {
+        IncrementalFileVerification* verification = (IncrementalFileVerification*)context;
+        const IncrementalFileManifest& manifest = *verification->manifest;
+        m256i digest;
+        KangarooTwelve(verification->buffer + chunkIndex * manifest.chunkSize, (unsigned int)manifest.getChunkSize((unsigned int)chunkIndex), &digest, sizeof(digest));
+        if (digest != manifest.chunkDigests[chunkIndex])
+            verification->mismatch = 1;
+    }
+};
+
+// Load buffer saved with saveIncrementalFile(). If verify is true, the digest of each chunk is checked against the
+// manifest. Verification runs on startupWorkers in parallel to loading the next chunks (only call from BSP).
+// Returns totalSize on success and -1 on error.
+static long long loadIncrementalFile(const CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, const CHAR16* directory = NULL,
+    bool verify = true, unsigned long long chunkSize = INCREMENTAL_FILE_CHUNK_SIZE)
+{
+    IncrementalFileManifest& manifest = incrementalFileLoadManifest;
+    if (IncrementalFileManifest::getChunkCount(totalSize, chunkSize) > INCREMENTAL_FILE_MAX_CHUNKS
+        || !loadIncrementalFileManifest(manifest, fileName, totalSize, chunkSize, directory))
+    {
+        logToConsole(L"loadIncrementalFile(): missing or invalid manifest!");
+        return -1;
+    }
+
+    // Chunk digest is cleared while the chunk is rewritten -> save has been interrupted
+    for (unsigned int i = 0; i < manifest.chunkCount; ++i)
+    {
+        if (isZero(manifest.chunkDigests[i]))
+        {
+            logToConsole(L"loadIncrementalFile(): incomplete save!");
+            return -1;
+        }
+    }
+
+    IncrementalFileVerification verification;
+    verification.manifest = &manifest;
+    verification.buffer = buffer;
+    verification.mismatch = 0;
+    if (verify)
+        startupWorkers.start(IncrementalFileVerification::verifyChunk, &verification, manifest.chunkCount, 0);
+
+    for (unsigned int i = 0; i < manifest.chunkCount; ++i)
+    {
+        CHAR16 chunkName[64];
+        getIncrementalFileName(chunkName, fileName, i);
+        const unsigned long long size = manifest.getChunkSize(i);
+        if (load(chunkName, size, buffer + i * chunkSize, directory) != size)
+        {
+            if (verify)
+                startupWorkers.wait(/*cancel=*/true);
+            return -1;
+        }
+        if (verify)
+            startupWorkers.setAvailableItems(i + 1);
+    }
+
+    if (verify)
+    {
+        startupWorkers.wait();
+        if (verification.mismatch)
+        {
+            logToConsole(L"loadIncrementalFile(): chunk digest mismatch!");
+            return -1;
+        }
+    }
+
+    return totalSize;
+}
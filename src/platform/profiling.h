@@ -6,6 +6,16 @@
 #include "time_stamp_counter.h"
 #include "file_io.h"
 
+#include <lib/platform_common/processor.h>
+
+// Number of buckets of the run-time histogram of each profiling entry. Bucket i counts the run times in [2^i, 2^(i+1))
+// ticks (bucket 0 also counts 0), the last bucket counts all longer run times.
+constexpr unsigned int PROFILING_HISTOGRAM_BUCKETS = 48;
+
+// Number of shards of the profiling data collector. Measurements are added to the shard of the running processor
+// (processor ID modulo number of shards), so profiled processors don't compete for a shared lock.
+constexpr unsigned int PROFILING_SHARDS = 64;
+
 struct ProfilingData
 {
     const char* name;
@@ -14,45 +24,79 @@ struct ProfilingData
     unsigned long long runtimeSum;
     unsigned long long runtimeMax;
     unsigned long long runtimeMin;
+    unsigned long long runtimeHistogram[PROFILING_HISTOGRAM_BUCKETS];
+
+    static unsigned int getHistogramBucket(unsigned long long runtime)
+    {
+        const unsigned int bucket = 63 - (unsigned int)__lzcnt64(runtime | 1);
+        return (bucket < PROFILING_HISTOGRAM_BUCKETS) ? bucket : PROFILING_HISTOGRAM_BUCKETS - 1;
+    }
+
+    // Add measurements of other entry with same key (for example of another shard)
+    void merge(const ProfilingData& other)
+    {
+        numOfExec += other.numOfExec;
+        runtimeSum += other.runtimeSum;
+        if (runtimeMin > other.runtimeMin)
+            runtimeMin = other.runtimeMin;
+        if (runtimeMax < other.runtimeMax)
+            runtimeMax = other.runtimeMax;
+        for (unsigned int i = 0; i < PROFILING_HISTOGRAM_BUCKETS; ++i)
+            runtimeHistogram[i] += other.runtimeHistogram[i];
+    }
+
+    // Approximate run time not exceeded by perMille / 1000 of the executions: upper bound of the histogram bucket
+    // containing the percentile, limited to the range [runtimeMin, runtimeMax]. Returns 0 if there are no executions.
+    unsigned long long getRuntimePercentile(unsigned int perMille) const
+    {
+        if (!numOfExec)
+            return 0;
+        unsigned long long rank = (numOfExec * perMille + 999) / 1000;
+        if (!rank)
+            rank = 1;
+        unsigned long long count = 0;
+        unsigned int bucket = 0;
+        for (; bucket < PROFILING_HISTOGRAM_BUCKETS - 1; ++bucket)
+        {
+            count += runtimeHistogram[bucket];
+            if (count >= rank)
+                break;
+        }
+        const unsigned long long upperBound = (bucket < PROFILING_HISTOGRAM_BUCKETS - 1) ? (2ull << bucket) - 1 : runtimeMax;
+        if (upperBound < runtimeMin)
+            return runtimeMin;
+        return (upperBound < runtimeMax) ? upperBound : runtimeMax;
+    }
 };
 
 class ProfilingDataCollector
 {
 public:
-    // Init buffer (optional). This reduces the number of allocations.
-    bool init(unsigned int expectedProfilingDataItems = 8)
+    // Init buffers of all shards (optional, but recommended on UEFI, where memory should only be allocated by the main
+    // processor). This reduces the number of allocations.
+    bool init(unsigned int expectedProfilingDataItemsPerShard = 8)
     {
-        ACQUIRE_WITHOUT_DEBUG_LOGGING(mLock);
-        bool okay = doInit(expectedProfilingDataItems);
-        RELEASE(mLock);
+        bool okay = true;
+        for (unsigned int i = 0; i < PROFILING_SHARDS; ++i)
+            okay &= mShards[i].init(expectedProfilingDataItemsPerShard);
         return okay;
     }
 
-    // Clear buffer, discarding all measurements
+    // Clear buffers, discarding all measurements
     void clear()
     {
-        ACQUIRE_WITHOUT_DEBUG_LOGGING(mLock);
-        if (mDataPtr)
-        {
-            setMem(mDataPtr, mDataSize * sizeof(ProfilingData), 0);
-            mDataUsedEntryCount = 0;
-        }
-        RELEASE(mLock);
+        for (unsigned int i = 0; i < PROFILING_SHARDS; ++i)
+            mShards[i].clear();
     }
 
-    // Free buffer
+    // Free buffers
     void deinit()
     {
-        ACQUIRE_WITHOUT_DEBUG_LOGGING(mLock);
-        if (mDataPtr)
-            freePool(mDataPtr);
-        mDataPtr = nullptr;
-        mDataSize = 0;
-        mDataUsedEntryCount = 0;
-        RELEASE(mLock);
+        for (unsigned int i = 0; i < PROFILING_SHARDS; ++i)
+            mShards[i].deinit();
     }
 
-    // Add run-time measurement to profiling entry of given key (= name + line).
+    // Add run-time measurement to profiling entry of given key (= name + line) in the shard of the running processor.
     // For fast access, the address of the name is used to identify the measurement. Using string literals here is recommended.
     // Using a pointer to a dynamic buffer probably cuases problems.
     // The time stamp counter values startTsc and endTsc should be measured on the same processor, because TSC of
@@ -63,26 +107,42 @@ public:
         if (endTsc < startTsc)
             return;
 
-        ACQUIRE_WITHOUT_DEBUG_LOGGING(mLock);
+        mShards[getRunningProcessorID() % PROFILING_SHARDS].addMeasurement(name, line, endTsc - startTsc);
+    }
+
+    // Copy the first entry with measurements of the shard that is stored at entryIndex or after it to output and set
+    // entryIndex to the index of the entry. Returns false if there is no such entry. For iterating all entries of a
+    // shard, start with entryIndex = 0 and increment it after each call. The shard is only locked while copying an
+    // entry, so entries added concurrently by the profiled processor may be missed or returned twice.
+    bool getMeasurement(unsigned int shardIndex, unsigned int& entryIndex, ProfilingData& output)
+    {
+        ASSERT(shardIndex < PROFILING_SHARDS);
+        return mShards[shardIndex].getMeasurement(entryIndex, output);
+    }
 
-        // Make sure hash map is initialized
-        if (mDataPtr || doInit())
+    // Copy up to maxCount entries with measurements to output, merging the entries of all shards. Returns the number
+    // of entries copied.
+    unsigned int getMeasurements(ProfilingData* output, unsigned int maxCount)
+    {
+        unsigned int count = 0;
+        ProfilingData entry;
+        for (unsigned int shardIndex = 0; shardIndex < PROFILING_SHARDS; ++shardIndex)
         {
-            // Fill entry
-            const unsigned long long dt = endTsc - startTsc;
-            ProfilingData& newEntry = getEntry(name, line);
-            newEntry.numOfExec += 1;
-            newEntry.runtimeSum += dt;
-            if (newEntry.runtimeMin > dt)
-                newEntry.runtimeMin = dt;
-            if (newEntry.runtimeMax < dt)
-                newEntry.runtimeMax = dt;
+            for (unsigned int entryIndex = 0; getMeasurement(shardIndex, entryIndex, entry); ++entryIndex)
+            {
+                unsigned int i = 0;
+                while (i < count && (output[i].name != entry.name || output[i].line != entry.line))
+                    ++i;
+                if (i < count)
+                    output[i].merge(entry);
+                else if (count < maxCount)
+                    output[count++] = entry;
+            }
         }
-
-        RELEASE(mLock);
+        return count;
     }
     
-    // Write CSV file with ProfilingData and hash function values (to check distribution)
+    // Write CSV file with ProfilingData of each shard (processor), including percentiles estimated from the histograms
     bool writeToFile()
     {
         ASSERT(isMainProcessor());
@@ -114,37 +174,42 @@ public:
         }
 #endif
 
-        ACQUIRE_WITHOUT_DEBUG_LOGGING(mLock);
-
-        // output hash for each entry?
-        bool okay = writeStringToFile(file, L"idx,name,line,count,sum_microseconds,avg_microseconds,min_microseconds,max_microseconds\r\n");
-        for (unsigned int i = 0; i < mDataSize; ++i)
+        // Entries are copied one by one, so the profiled processors aren't blocked while writing the file
+        bool okay = writeStringToFile(file, L"idx,name,line,processor,count,sum_microseconds,avg_microseconds,min_microseconds,max_microseconds,p50_microseconds,p99_microseconds,p999_microseconds\r\n");
+        ProfilingData entry;
+        for (unsigned int shardIndex = 0; shardIndex < PROFILING_SHARDS; ++shardIndex)
         {
-            if (mDataPtr[i].name)
+            for (unsigned int entryIndex = 0; getMeasurement(shardIndex, entryIndex, entry); ++entryIndex)
             {
-                unsigned long long runtimeSumMicroseconds = ticksToMicroseconds(mDataPtr[i].runtimeSum);
-                setNumber(message, i, false);
+                unsigned long long runtimeSumMicroseconds = ticksToMicroseconds(entry.runtimeSum);
+                setNumber(message, entryIndex, false);
                 appendText(message, ",\"");
-                appendText(message, mDataPtr[i].name);
+                appendText(message, entry.name);
                 appendText(message, "\",");
-                appendNumber(message, mDataPtr[i].line, false);
+                appendNumber(message, entry.line, false);
+                appendText(message, ",");
+                appendNumber(message, shardIndex, false);
                 appendText(message, ",");
-                appendNumber(message, mDataPtr[i].numOfExec, false);
+                appendNumber(message, entry.numOfExec, false);
                 appendText(message, ",");
                 appendNumber(message, runtimeSumMicroseconds, false);
                 appendText(message, ",");
-                appendNumber(message, (mDataPtr[i].numOfExec > 0) ? runtimeSumMicroseconds / mDataPtr[i].numOfExec : 0, false);
+                appendNumber(message, (entry.numOfExec > 0) ? runtimeSumMicroseconds / entry.numOfExec : 0, false);
                 appendText(message, ",");
-                appendNumber(message, ticksToMicroseconds(mDataPtr[i].runtimeMin), false);
+                appendNumber(message, ticksToMicroseconds(entry.runtimeMin), false);
                 appendText(message, ",");
-                appendNumber(message, ticksToMicroseconds(mDataPtr[i].runtimeMax), false);
+                appendNumber(message, ticksToMicroseconds(entry.runtimeMax), false);
+                appendText(message, ",");
+                appendNumber(message, ticksToMicroseconds(entry.getRuntimePercentile(500)), false);
+                appendText(message, ",");
+                appendNumber(message, ticksToMicroseconds(entry.getRuntimePercentile(990)), false);
+                appendText(message, ",");
+                appendNumber(message, ticksToMicroseconds(entry.getRuntimePercentile(999)), false);
                 appendText(message, "\r\n");
                 okay &= writeStringToFile(file, message);
             }
         }
 
-        RELEASE(mLock);
-
 #ifdef NO_UEFI
         fclose(file);
 #else
@@ -179,111 +244,179 @@ public:
     }
 
 protected:
-    // Hash map of mDataSize = 2^N elements of ProfilingData
-    ProfilingData* mDataPtr = nullptr;
-    unsigned int mDataSize = 0;
-    unsigned int mDataUsedEntryCount = 0;
-    
-    // Lock preventing concurrent access (acquired and released in public functions)
-    volatile char mLock = 0;
-
-    // Init buffer. Assumes caller has acquired mLock.
-    bool doInit(unsigned int expectedProfilingDataItems = 8)
+    // Hash map of ProfilingData with own lock, used by one processor (or a few if there are more processors than shards)
+    class Shard
     {
-        // Compute size of new hash map
-        unsigned int newDataSize = 8;
-        while (newDataSize < expectedProfilingDataItems)
-            newDataSize <<= 1;
-
-        // Make sure there is enough space in the new hash map
-        if (newDataSize < mDataUsedEntryCount)
-            return false;
-        newDataSize <<= 1;
+    public:
+        bool init(unsigned int expectedProfilingDataItems)
+        {
+            ACQUIRE_WITHOUT_DEBUG_LOGGING(mLock);
+            bool okay = doInit(expectedProfilingDataItems);
+            RELEASE(mLock);
+            return okay;
+        }
 
-        // Keep old data for copying to new hash map
-        ProfilingData* oldDataPtr = mDataPtr;
-        const unsigned int oldDataSize = mDataSize;
-        const unsigned int oldDataUsedEntryCount = mDataUsedEntryCount;
+        void clear()
+        {
+            ACQUIRE_WITHOUT_DEBUG_LOGGING(mLock);
+            if (mDataPtr)
+            {
+                setMem(mDataPtr, mDataSize * sizeof(ProfilingData), 0);
+                mDataUsedEntryCount = 0;
+            }
+            RELEASE(mLock);
+        }
 
-        // Allocate new hash map (init to zero)
-        if (!allocPoolWithErrorLog(L"ProfilingDataCollector", newDataSize * sizeof(ProfilingData), (void**)&mDataPtr, __LINE__))
-            return false;
-        mDataSize = newDataSize;
-        mDataUsedEntryCount = 0;
+        void deinit()
+        {
+            ACQUIRE_WITHOUT_DEBUG_LOGGING(mLock);
+            if (mDataPtr)
+                freePool(mDataPtr);
+            mDataPtr = nullptr;
+            mDataSize = 0;
+            mDataUsedEntryCount = 0;
+            RELEASE(mLock);
+        }
 
-        // If there was a hash map before, fill entries in new map and free old map
-        if (oldDataPtr)
+        void addMeasurement(const char* name, unsigned long long line, unsigned long long dt)
         {
-            for (unsigned int i = 0; i < oldDataSize; ++i)
+            ACQUIRE_WITHOUT_DEBUG_LOGGING(mLock);
+
+            // Make sure hash map is initialized
+            if (mDataPtr || doInit())
             {
-                if (oldDataPtr[i].name)
-                {
-                    const ProfilingData& oldEntry = oldDataPtr[i];
-                    ProfilingData& newEntry = getEntry(oldEntry.name, oldEntry.line);
-                    newEntry.numOfExec = oldEntry.numOfExec;
-                    newEntry.runtimeSum = oldEntry.runtimeSum;
-                    newEntry.runtimeMin = oldEntry.runtimeMin;
-                    newEntry.runtimeMax = oldEntry.runtimeMax;
-                }
+                // Fill entry
+                ProfilingData& newEntry = getEntry(name, line);
+                newEntry.numOfExec += 1;
+                newEntry.runtimeSum += dt;
+                if (newEntry.runtimeMin > dt)
+                    newEntry.runtimeMin = dt;
+                if (newEntry.runtimeMax < dt)
+                    newEntry.runtimeMax = dt;
+                newEntry.runtimeHistogram[ProfilingData::getHistogramBucket(dt)] += 1;
             }
-            ASSERT(mDataUsedEntryCount == oldDataUsedEntryCount);
 
-            freePool(oldDataPtr);
+            RELEASE(mLock);
         }
 
-        return true;
-    }
+        bool getMeasurement(unsigned int& entryIndex, ProfilingData& output)
+        {
+            ACQUIRE_WITHOUT_DEBUG_LOGGING(mLock);
+            while (entryIndex < mDataSize && !mDataPtr[entryIndex].name)
+                ++entryIndex;
+            const bool found = entryIndex < mDataSize;
+            if (found)
+                output = mDataPtr[entryIndex];
+            RELEASE(mLock);
+            return found;
+        }
 
-    // Return entry of given key (pair of name and line), create entry if not found. Assumes caller has acquired mLock.
-    ProfilingData& getEntry(const char* name, unsigned long long line)
-    {
-        ASSERT(mDataPtr && mDataSize > 0);          // requires data to be initialized
-        ASSERT((mDataSize & (mDataSize - 1)) == 0); // mDataSize must be 2^N
+    protected:
+        // Hash map of mDataSize = 2^N elements of ProfilingData
+        ProfilingData* mDataPtr = nullptr;
+        unsigned int mDataSize = 0;
+        unsigned int mDataUsedEntryCount = 0;
+
+        // Lock preventing concurrent access (acquired and released in public functions)
+        volatile char mLock = 0;
 
-        const unsigned long long mask = (mDataSize - 1);
-        unsigned long long i = hashFunction(name, line) & mask;
-    iteration:
-        if (mDataPtr[i].name == name && mDataPtr[i].line == line)
+        // Init buffer. Assumes caller has acquired mLock.
+        bool doInit(unsigned int expectedProfilingDataItems = 8)
         {
-            // found entry in hash map
-            return mDataPtr[i];
+            // Compute size of new hash map
+            unsigned int newDataSize = 8;
+            while (newDataSize < expectedProfilingDataItems)
+                newDataSize <<= 1;
+
+            // Make sure there is enough space in the new hash map
+            if (newDataSize < mDataUsedEntryCount)
+                return false;
+            newDataSize <<= 1;
+
+            // Keep old data for copying to new hash map
+            ProfilingData* oldDataPtr = mDataPtr;
+            const unsigned int oldDataSize = mDataSize;
+            const unsigned int oldDataUsedEntryCount = mDataUsedEntryCount;
+
+            // Allocate new hash map (init to zero)
+            if (!allocPoolWithErrorLog(L"ProfilingDataCollector", newDataSize * sizeof(ProfilingData), (void**)&mDataPtr, __LINE__))
+                return false;
+            mDataSize = newDataSize;
+            mDataUsedEntryCount = 0;
+
+            // If there was a hash map before, fill entries in new map and free old map
+            if (oldDataPtr)
+            {
+                for (unsigned int i = 0; i < oldDataSize; ++i)
+                {
+                    if (oldDataPtr[i].name)
+                    {
+                        const ProfilingData& oldEntry = oldDataPtr[i];
+                        ProfilingData& newEntry = getEntry(oldEntry.name, oldEntry.line);
+                        copyMem(&newEntry, &oldEntry, sizeof(ProfilingData));
+                    }
+                }
+                ASSERT(mDataUsedEntryCount == oldDataUsedEntryCount);
+
+                freePool(oldDataPtr);
+            }
+
+            return true;
         }
-        else
+
+        // Return entry of given key (pair of name and line), create entry if not found. Assumes caller has acquired mLock.
+        ProfilingData& getEntry(const char* name, unsigned long long line)
         {
-            if (!mDataPtr[i].name)
+            ASSERT(mDataPtr && mDataSize > 0);          // requires data to be initialized
+            ASSERT((mDataSize & (mDataSize - 1)) == 0); // mDataSize must be 2^N
+
+            const unsigned long long mask = (mDataSize - 1);
+            unsigned long long i = hashFunction(name, line) & mask;
+        iteration:
+            if (mDataPtr[i].name == name && mDataPtr[i].line == line)
             {
-                // free slot -> entry not available yet -> add new entry
-                ++mDataUsedEntryCount;
-                mDataPtr[i].name = name;
-                mDataPtr[i].line = line;
-                mDataPtr[i].runtimeMin = (unsigned long long)-1;
+                // found entry in hash map
                 return mDataPtr[i];
             }
             else
             {
-                // hash collision
-                // -> check if hash map has enough free space
-                if (mDataUsedEntryCount * 2 > mDataSize)
+                if (!mDataPtr[i].name)
                 {
-                    if (doInit(mDataUsedEntryCount * 2))
+                    // free slot -> entry not available yet -> add new entry
+                    ++mDataUsedEntryCount;
+                    mDataPtr[i].name = name;
+                    mDataPtr[i].line = line;
+                    mDataPtr[i].runtimeMin = (unsigned long long)-1;
+                    return mDataPtr[i];
+                }
+                else
+                {
+                    // hash collision
+                    // -> check if hash map has enough free space
+                    if (mDataUsedEntryCount * 2 > mDataSize)
                     {
-                        // hash map has been extended -> restart getting entry
-                        return getEntry(name, line);
+                        if (doInit(mDataUsedEntryCount * 2))
+                        {
+                            // hash map has been extended -> restart getting entry
+                            return getEntry(name, line);
+                        }
                     }
-                }
 
-                // -> check next entry in hash map
-                i = (i + 1) & mask;
-                goto iteration;
+                    // -> check next entry in hash map
+                    i = (i + 1) & mask;
+                    goto iteration;
+                }
             }
         }
-    }
 
-    // Compute hash sum for given key
-    static unsigned long long hashFunction(const char* name, unsigned long long line)
-    {
-        return (((unsigned long long)name) ^ line);
-    }
+        // Compute hash sum for given key
+        static unsigned long long hashFunction(const char* name, unsigned long long line)
+        {
+            return (((unsigned long long)name) ^ line);
+        }
+    };
+
+    Shard mShards[PROFILING_SHARDS];
 
 #ifdef NO_UEFI
     static bool writeStringToFile(FILE* file, const CHAR16* str)
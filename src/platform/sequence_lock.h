@@ -0,0 +1,70 @@
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+#include "assert.h"
+
+// Prevent the compiler from moving memory accesses across this point (the CPU keeps the order of loads and the order of
+// stores on x86-64, so this is all that is needed for optimistic reading)
+#if defined(_MSC_VER) && !defined(__clang__)
+#define COMPILER_MEMORY_BARRIER() _ReadWriteBarrier()
+#else
+#define COMPILER_MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory")
+#endif
+
+// Sequence lock for optimistic reading of data that is rarely changed compared to how often it is read.
+// Readers don't write to shared memory, so they run in parallel to each other and to the writer without blocking them.
+// The writer makes the sequence number odd before changing the data and even again afterwards. Writers need to exclude
+// each other by other means (such as a lock). A reader gets the sequence number with beginRead(), copies the data it
+// needs, and checks with validateRead() that the data hasn't been changed meanwhile, repeating the read otherwise.
+// CAUTION: Until validated, the data read may be inconsistent. So indices read must be range-checked before they are
+// used and loops must not rely on consistent data to terminate.
+class SequenceLock
+{
+public:
+    // Set to initial state (no write in progress)
+    void reset()
+    {
+        sequence = 0;
+    }
+
+    // Start changing the protected data (exclusive access of writer is not ensured by this class)
+    void beginWrite()
+    {
+        ASSERT((sequence & 1) == 0);
+        _InterlockedIncrement64(&sequence);
+    }
+
+    // Finish changing the protected data (must follow beginWrite())
+    void endWrite()
+    {
+        ASSERT((sequence & 1) == 1);
+        _InterlockedIncrement64(&sequence);
+    }
+
+    // Start reading the protected data, waiting if write is in progress. Returns the sequence number to pass to
+    // validateRead().
+    long long beginRead() const
+    {
+        long long startSequence;
+        while ((startSequence = sequence) & 1)
+            _mm_pause();
+        COMPILER_MEMORY_BARRIER();
+        return startSequence;
+    }
+
+    // Return true if the data read since beginRead() returned startSequence is consistent (no write in between)
+    bool validateRead(long long startSequence) const
+    {
+        COMPILER_MEMORY_BARRIER();
+        return sequence == startSequence;
+    }
+
+    // Current sequence number (odd while a write is in progress)
+    long long getSequence() const
+    {
+        return sequence;
+    }
+
+private:
+    volatile long long sequence;
+};
@@ -0,0 +1,138 @@
+// parallel processing of work items on all application processors (APs) during startup
+
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+#include <lib/platform_efi/uefi.h>
+
+#include "platform/assert.h"
+#include "platform/concurrency.h"
+#include "platform/memory.h"
+
+
+// Function processing one work item. Runs on APs, so it must not call UEFI services that change firmware state (such
+// as allocatePool/freePool, events, file IO, or console output). The memory functions setMem/copyMem (SetMem/CopyMem
+// of the boot services) only access the given buffers and are used on APs by all processors of the node, including
+// in KangarooTwelve().
+typedef void (*StartupWorkFunction)(void* context, unsigned long long itemIndex);
+
+// Distributes work items among all enabled APs, which are idle during initialize() before the processors get their
+// roles. Items are taken in increasing order. Item i is only processed after setAvailableItems() has been called
+// with a value greater than i, allowing to overlap loading data on the BSP (which does all file IO) with processing
+// on the APs. The BSP joins processing in wait(). Without MP services (or in NO_UEFI builds), wait() processes all
+// items on the calling thread.
+// Only use from BSP before the processors are started.
+class StartupWorkers
+{
+public:
+    // Set MP services (may be NULL) and function called on each AP before processing items (for example for
+    // enabling AVX, may be NULL).
+    void init(EFI_MP_SERVICES_PROTOCOL* mpServices, void (*initAP)())
+    {
+        this->mpServices = mpServices;
+        this->initAP = initAP;
+        running = false;
+    }
+
+    // Start processing itemCount items, of which the first availableItems can be processed immediately.
+    void start(StartupWorkFunction function, void* context, unsigned long long itemCount, unsigned long long availableItems)
+    {
+        ASSERT(!running);
+        this->function = function;
+        this->context = context;
+        this->itemCount = itemCount;
+        this->availableItems = availableItems;
+        nextItem = 0;
+        cancelled = 0;
+        running = true;
+        apsStarted = false;
+
+#ifndef NO_UEFI
+        if (mpServices && itemCount > 1
+            && createEvent(0, 0, NULL, NULL, &apsFinishedEvent) == EFI_SUCCESS)
+        {
+            // Non-blocking mode: returns immediately, event is signaled when the procedure has returned on all APs
+            if (mpServices->StartupAllAPs(mpServices, workerProcedure, FALSE, apsFinishedEvent, 0, this, NULL) == EFI_SUCCESS)
+                apsStarted = true;
+            else
+                closeEvent(apsFinishedEvent);
+        }
+#endif
+    }
+
+    // Allow processing items with index lower than count.
+    void setAvailableItems(unsigned long long count)
+    {
+        ASSERT(count <= itemCount);
+        ATOMIC_STORE64(availableItems, (long long)count);
+    }
+
+    // Process remaining items on the BSP and wait until all APs are done. If cancel is true, items that have not been
+    // taken yet are skipped (use if not all items can be made available, for example after a load error).
+    void wait(bool cancel = false)
+    {
+        ASSERT(running);
+        if (cancel)
+            ATOMIC_STORE8(cancelled, 1);
+        else
+            setAvailableItems(itemCount);
+        processItems();
+
+#ifndef NO_UEFI
+        if (apsStarted)
+        {
+            while (bs->CheckEvent(apsFinishedEvent) == EFI_NOT_READY)
+                _mm_pause();
+            closeEvent(apsFinishedEvent);
+        }
+#endif
+        running = false;
+    }
+
+    // Process all items in parallel and return when finished.
+    void parallelFor(StartupWorkFunction function, void* context, unsigned long long itemCount)
+    {
+        start(function, context, itemCount, itemCount);
+        wait();
+    }
+
+private:
+    static void __cdecl workerProcedure(void* startupWorkers)
+    {
+        StartupWorkers* workers = (StartupWorkers*)startupWorkers;
+        if (workers->initAP)
+            workers->initAP();
+        workers->processItems();
+    }
+
+    void processItems()
+    {
+        while (!cancelled)
+        {
+            const unsigned long long itemIndex = _InterlockedIncrement64(&nextItem) - 1;
+            if (itemIndex >= itemCount)
+                break;
+            while ((unsigned long long)ATOMIC_LOAD64(availableItems) <= itemIndex)
+            {
+                if (cancelled)
+                    return;
+                _mm_pause();
+            }
+            function(context, itemIndex);
+        }
+    }
+
+    EFI_MP_SERVICES_PROTOCOL* mpServices;
+    void (*initAP)();
+    EFI_EVENT apsFinishedEvent;
+    StartupWorkFunction function;
+    void* context;
+    unsigned long long itemCount;
+    volatile long long availableItems;
+    volatile long long nextItem;
+    volatile char cancelled;
+    bool running;
+    bool apsStarted;
+};
+
+static StartupWorkers startupWorkers;
@@ -64,6 +64,8 @@ static_assert(AUTO_FORCE_NEXT_TICK_THRESHOLD* TARGET_TICK_DURATION >= PEER_REFRE
 
 // Addons: If you don't know it, leave it 0.
 #define ADDON_TX_STATUS_REQUEST 0
+#define ADDON_TX_STATUS_INDEX 0 // requires ADDON_TX_STATUS_REQUEST, enables RequestTxStatusBatch (64 bytes of RAM per TX_STATUS_INDEX_CAPACITY)
+#define TX_STATUS_INDEX_CAPACITY (1ULL << 24) // size of digest index, must be 2^N (up to 7/8 of it can be filled with TX's of current epoch + kept ticks)
 
 
 //////////////////////////////////////////////////////////////////////////
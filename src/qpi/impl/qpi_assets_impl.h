@@ -27,13 +27,13 @@ bool QPI::AssetIssuanceIterator::next()
 {
     ASSERT(_issuanceIdx < ASSETS_CAPACITY || _issuanceIdx == NO_ASSET_INDEX);
 
-    if (!_issuance.anyIssuer)
+    if (!_issuance.anyIssuer && !_issuance.anyName)
     {
-        // searching for specific issuer -> use hash map
+        // searching for specific issuer and name -> use hash map
         if (_issuanceIdx == NO_ASSET_INDEX)
         {
             // get first candidate for issuance in first call of next()
-            _issuanceIdx = _issuance.issuer.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+            _issuanceIdx = issuanceHashIndex(_issuance.issuer, _issuance.assetName);
         }
         else
         {
@@ -46,7 +46,7 @@ bool QPI::AssetIssuanceIterator::next()
         {
             if (assets[_issuanceIdx].varStruct.issuance.type == ISSUANCE
                 && assets[_issuanceIdx].varStruct.issuance.publicKey == _issuance.issuer
-                && (_issuance.anyName || ((*((unsigned long long*)assets[_issuanceIdx].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) == _issuance.assetName))
+                && ((*((unsigned long long*)assets[_issuanceIdx].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) == _issuance.assetName)
             {
                 // found matching entry
                 return true;
@@ -61,7 +61,7 @@ bool QPI::AssetIssuanceIterator::next()
     }
     else
     {
-        // issuer is unknow -> use index lists instead of hash map to iterate through issuances
+        // issuer or name is unknown -> use index lists instead of hash map to iterate through issuances
         if (_issuanceIdx == NO_ASSET_INDEX)
         {
             // get first issuance
@@ -76,11 +76,12 @@ bool QPI::AssetIssuanceIterator::next()
             || (_issuanceIdx < ASSETS_CAPACITY
                 && assets[_issuanceIdx].varStruct.issuance.type == ISSUANCE));
 
-        // if specific asset name is requested, make sure the issuance matches
-        if (!_issuance.anyName)
+        // if specific issuer or asset name is requested, make sure the issuance matches
+        if (!_issuance.anyName || !_issuance.anyIssuer)
         {
             while (_issuanceIdx != NO_ASSET_INDEX
-                && ((*((unsigned long long*)assets[_issuanceIdx].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) != _issuance.assetName)
+                && ((!_issuance.anyName && ((*((unsigned long long*)assets[_issuanceIdx].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) != _issuance.assetName)
+                    || (!_issuance.anyIssuer && assets[_issuanceIdx].varStruct.issuance.publicKey != _issuance.issuer)))
             {
                 _issuanceIdx = as.indexLists.nextIdx[_issuanceIdx];
                 ASSERT(_issuanceIdx == NO_ASSET_INDEX
@@ -138,7 +139,7 @@ bool QPI::AssetOwnershipIterator::next()
         if (_ownershipIdx == NO_ASSET_INDEX)
         {
             // get first candidate for ownership of issuance in first call of next()
-            _ownershipIdx = _ownership.owner.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+            _ownershipIdx = ownershipHashIndex(_ownership.owner, _issuanceIdx);
         }
         else
         {
@@ -276,7 +277,7 @@ bool QPI::AssetPossessionIterator::next()
         {
             if (_possessionIdx == NO_ASSET_INDEX)
             {
-                _possessionIdx = _possession.possessor.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+                _possessionIdx = possessionHashIndex(_possession.possessor, _issuanceIdx);
             }
             else
             {
@@ -704,7 +705,7 @@ long long QPI::QpiContextProcedureCall::transferShareOwnershipAndPossession(unsi
 
     ACQUIRE(universeLock);
 
-    int issuanceIndex = issuer.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+    int issuanceIndex = issuanceHashIndex(issuer, assetName);
 iteration:
     if (assets[issuanceIndex].varStruct.issuance.type == EMPTY)
     {
@@ -718,7 +719,7 @@ iteration:
             && ((*((unsigned long long*)assets[issuanceIndex].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) == assetName
             && assets[issuanceIndex].varStruct.issuance.publicKey == issuer)
         {
-            int ownershipIndex = owner.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+            int ownershipIndex = ownershipHashIndex(owner, issuanceIndex);
         iteration2:
             if (assets[ownershipIndex].varStruct.ownership.type == EMPTY)
             {
@@ -733,7 +734,7 @@ iteration:
                     && assets[ownershipIndex].varStruct.ownership.publicKey == owner
                     && assets[ownershipIndex].varStruct.ownership.managingContractIndex == _currentContractIndex) // TODO: This condition needs extra attention during refactoring!
                 {
-                    int possessionIndex = possessor.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+                    int possessionIndex = possessionHashIndex(possessor, issuanceIndex);
                 iteration3:
                     if (assets[possessionIndex].varStruct.possession.type == EMPTY)
                     {
@@ -0,0 +1,489 @@
+// Implements functions of QPI::OrderBook in order to:
+// 1. keep setMem() and copyMem() unavailable to contracts
+// 2. keep QPI file smaller and easier to read for contract devs
+// CAUTION: Include this AFTER the contract implementations!
+
+#pragma once
+
+#include "qpi/qpi.h"
+#include "platform/memory.h"
+
+namespace QPI
+{
+	// Hash of side key and type (bit 0: bid, bit 1: owner view)
+	static inline uint64 __orderBookSideHash(const id& key, uint32 type)
+	{
+		uint64 h = (key.u64._0 ^ type) * 0x9E3779B97F4A7C15ULL;
+		h = (h ^ (h >> 29) ^ key.u64._1) * 0xBF58476D1CE4E5B9ULL;
+		h = (h ^ (h >> 32) ^ key.u64._2) * 0x94D049BB133111EBULL;
+		h = (h ^ (h >> 29) ^ key.u64._3) * 0x9E3779B97F4A7C15ULL;
+		return h ^ (h >> 32);
+	}
+
+	// Hash of side (index + 1) and price of level
+	static inline uint64 __orderBookLevelHash(uint32 side, sint64 price)
+	{
+		uint64 h = ((uint64)price ^ ((uint64)side << 40)) * 0x9E3779B97F4A7C15ULL;
+		h = (h ^ (h >> 29) ^ side) * 0xBF58476D1CE4E5B9ULL;
+		return h ^ (h >> 32);
+	}
+
+	template <typename T, uint64 L>
+	uint64 OrderBook<T, L>::_findSideSlot(const id& key, uint32 type) const
+	{
+		uint64 slot = __orderBookSideHash(key, type) & (4 * L - 1);
+		while (_sideSlots[slot])
+		{
+			const Side& s = _sides[_sideSlots[slot] - 1];
+			if (s.type == type && s.key == key)
+				break;
+			slot = (slot + 1) & (4 * L - 1);
+		}
+		return slot;
+	}
+
+	template <typename T, uint64 L>
+	uint64 OrderBook<T, L>::_findLevelSlot(uint32 side, sint64 price) const
+	{
+		uint64 slot = __orderBookLevelHash(side, price) & (4 * L - 1);
+		while (_levelSlots[slot])
+		{
+			const Level& l = _levels[_levelSlots[slot] - 1];
+			if (l.side == side && l.price == price)
+				break;
+			slot = (slot + 1) & (4 * L - 1);
+		}
+		return slot;
+	}
+
+	template <typename T, uint64 L>
+	void OrderBook<T, L>::_eraseSlot(uint32* slots, uint64 slot, bool levelSlots)
+	{
+		// Move following entries of the probe sequence into the gap if their home slot is not between gap and entry
+		constexpr uint64 mask = 4 * L - 1;
+		uint64 next = (slot + 1) & mask;
+		while (slots[next])
+		{
+			uint64 home;
+			if (levelSlots)
+			{
+				const Level& l = _levels[slots[next] - 1];
+				home = __orderBookLevelHash(l.side, l.price) & mask;
+			}
+			else
+			{
+				const Side& s = _sides[slots[next] - 1];
+				home = __orderBookSideHash(s.key, s.type) & mask;
+			}
+			if (((next - home) & mask) >= ((next - slot) & mask))
+			{
+				slots[slot] = slots[next];
+				slot = next;
+			}
+			next = (next + 1) & mask;
+		}
+		slots[slot] = 0;
+	}
+
+	template <typename T, uint64 L>
+	uint32 OrderBook<T, L>::_acquireSide(const id& key, uint32 type)
+	{
+		const uint64 slot = _findSideSlot(key, type);
+		if (_sideSlots[slot])
+			return _sideSlots[slot];
+
+		// Pools of sides and levels have twice the order capacity, because each order needs at most one side and
+		// one level in book view and in owner view. So the pools cannot run out before the orders.
+		uint32 side;
+		if (_freeSide)
+		{
+			side = _freeSide;
+			_freeSide = _sides[side - 1].bestLevel;
+		}
+		else
+		{
+			ASSERT(_usedSides < 2 * L);
+			side = ++_usedSides;
+		}
+		Side& s = _sides[side - 1];
+		s.key = key;
+		s.type = type;
+		s.bestLevel = 0;
+		s.worstLevel = 0;
+		s.population = 0;
+		_sideSlots[slot] = side;
+		return side;
+	}
+
+	template <typename T, uint64 L>
+	inline bool OrderBook<T, L>::_isBetter(uint32 type, sint64 price, sint64 otherPrice)
+	{
+		return (type & 1) ? price > otherPrice : price < otherPrice;
+	}
+
+	template <typename T, uint64 L>
+	uint32 OrderBook<T, L>::_acquireLevel(uint32 side, sint64 price)
+	{
+		const uint64 slot = _findLevelSlot(side, price);
+		if (_levelSlots[slot])
+			return _levelSlots[slot];
+
+		uint32 level;
+		if (_freeLevel)
+		{
+			level = _freeLevel;
+			_freeLevel = _levels[level - 1].worse;
+		}
+		else
+		{
+			ASSERT(_usedLevels < 2 * L);
+			level = ++_usedLevels;
+		}
+		Level& l = _levels[level - 1];
+		l.price = price;
+		l.side = side;
+		l.head = 0;
+		l.tail = 0;
+		l.population = 0;
+		_levelSlots[slot] = level;
+
+		// Link into sorted list of levels, walking from the end of the side with the closer price
+		Side& s = _sides[side - 1];
+		uint32 better = 0, worse = 0;
+		if (s.bestLevel)
+		{
+			const sint64 bestPrice = _levels[s.bestLevel - 1].price;
+			const sint64 worstPrice = _levels[s.worstLevel - 1].price;
+			const uint64 bestDistance = (price > bestPrice) ? uint64(price) - uint64(bestPrice) : uint64(bestPrice) - uint64(price);
+			const uint64 worstDistance = (price > worstPrice) ? uint64(price) - uint64(worstPrice) : uint64(worstPrice) - uint64(price);
+			if (bestDistance <= worstDistance)
+			{
+				worse = s.bestLevel;
+				while (worse && _isBetter(s.type, _levels[worse - 1].price, price))
+				{
+					better = worse;
+					worse = _levels[worse - 1].worse;
+				}
+			}
+			else
+			{
+				better = s.worstLevel;
+				while (better && !_isBetter(s.type, _levels[better - 1].price, price))
+				{
+					worse = better;
+					better = _levels[better - 1].better;
+				}
+			}
+		}
+		l.better = better;
+		l.worse = worse;
+		if (better)
+			_levels[better - 1].worse = level;
+		else
+			s.bestLevel = level;
+		if (worse)
+			_levels[worse - 1].better = level;
+		else
+			s.worstLevel = level;
+
+		return level;
+	}
+
+	template <typename T, uint64 L>
+	void OrderBook<T, L>::_releaseLevel(uint32 level)
+	{
+		Level& l = _levels[level - 1];
+		const uint32 side = l.side;
+		Side& s = _sides[side - 1];
+		--s.population;
+		if (--l.population)
+			return;
+
+		// Level is empty -> unlink and free it
+		if (l.better)
+			_levels[l.better - 1].worse = l.worse;
+		else
+			s.bestLevel = l.worse;
+		if (l.worse)
+			_levels[l.worse - 1].better = l.better;
+		else
+			s.worstLevel = l.better;
+		_eraseSlot(_levelSlots, _findLevelSlot(side, l.price), true);
+		l.worse = _freeLevel;
+		_freeLevel = level;
+
+		if (!s.population)
+		{
+			// Side is empty -> free it
+			_eraseSlot(_sideSlots, _findSideSlot(s.key, s.type), false);
+			s.bestLevel = _freeSide;
+			_freeSide = side;
+		}
+	}
+
+	template <typename T, uint64 L>
+	sint64 OrderBook<T, L>::_headIndex(const id& key, uint32 type) const
+	{
+		const uint32 side = _sideSlots[_findSideSlot(key, type)];
+		if (!side)
+			return NULL_INDEX;
+		return sint64(_levels[_sides[side - 1].bestLevel - 1].head) - 1;
+	}
+
+	template <typename T, uint64 L>
+	sint64 OrderBook<T, L>::_headIndex(const id& key, uint32 type, sint64 price) const
+	{
+		const uint32 side = _sideSlots[_findSideSlot(key, type)];
+		if (!side)
+			return NULL_INDEX;
+		const uint32 level = _levelSlots[_findLevelSlot(side, price)];
+		if (!level)
+			return NULL_INDEX;
+		return sint64(_levels[level - 1].head) - 1;
+	}
+
+	template <typename T, uint64 L>
+	sint64 OrderBook<T, L>::add(const id& book, const id& owner, uint8 side, sint64 price, const T& element)
+	{
+		if (_population >= L)
+			return NULL_INDEX;
+
+		const uint32 bookSide = side & 1;
+		const uint32 level = _acquireLevel(_acquireSide(book, bookSide), price);
+		const uint32 ownerLevel = _acquireLevel(_acquireSide(owner, bookSide | 2), price);
+
+		uint32 order;
+		if (_freeOrder)
+		{
+			order = _freeOrder;
+			_freeOrder = _orders[order - 1].next;
+		}
+		else
+		{
+			order = ++_usedOrders;
+		}
+		Order& o = _orders[order - 1];
+		o.value = element;
+		o.level = level;
+		o.ownerLevel = ownerLevel;
+
+		// Append to FIFO of level in book view and in owner view
+		Level& l = _levels[level - 1];
+		o.prev = l.tail;
+		o.next = 0;
+		if (l.tail)
+			_orders[l.tail - 1].next = order;
+		else
+			l.head = order;
+		l.tail = order;
+		++l.population;
+		++_sides[l.side - 1].population;
+
+		Level& ol = _levels[ownerLevel - 1];
+		o.ownerPrev = ol.tail;
+		o.ownerNext = 0;
+		if (ol.tail)
+			_orders[ol.tail - 1].ownerNext = order;
+		else
+			ol.head = order;
+		ol.tail = order;
+		++ol.population;
+		++_sides[ol.side - 1].population;
+
+		++_population;
+		return sint64(order) - 1;
+	}
+
+	template <typename T, uint64 L>
+	inline const T& OrderBook<T, L>::element(sint64 orderIndex) const
+	{
+		return _orders[orderIndex & (L - 1)].value;
+	}
+
+	template <typename T, uint64 L>
+	sint64 OrderBook<T, L>::headIndex(const id& book, uint8 side) const
+	{
+		return _headIndex(book, side & 1);
+	}
+
+	template <typename T, uint64 L>
+	sint64 OrderBook<T, L>::headIndex(const id& book, uint8 side, sint64 price) const
+	{
+		return _headIndex(book, side & 1, price);
+	}
+
+	template <typename T, uint64 L>
+	inline bool OrderBook<T, L>::isEmptySlot(sint64 orderIndex) const
+	{
+		return orderIndex < 0 || orderIndex >= (sint64)L || !_orders[orderIndex].level;
+	}
+
+	template <typename T, uint64 L>
+	void OrderBook<T, L>::moveToOwnerTail(sint64 orderIndex)
+	{
+		if (isEmptySlot(orderIndex))
+			return;
+		const uint32 order = uint32(orderIndex + 1);
+		Order& o = _orders[orderIndex];
+		Level& ol = _levels[o.ownerLevel - 1];
+		if (ol.tail == order)
+			return;
+
+		// Unlink from FIFO of owner view (order is not the tail, so ownerNext is set)
+		if (o.ownerPrev)
+			_orders[o.ownerPrev - 1].ownerNext = o.ownerNext;
+		else
+			ol.head = o.ownerNext;
+		_orders[o.ownerNext - 1].ownerPrev = o.ownerPrev;
+
+		// Append again
+		o.ownerPrev = ol.tail;
+		o.ownerNext = 0;
+		_orders[ol.tail - 1].ownerNext = order;
+		ol.tail = order;
+	}
+
+	template <typename T, uint64 L>
+	sint64 OrderBook<T, L>::nextElementIndex(sint64 orderIndex) const
+	{
+		if (isEmptySlot(orderIndex))
+			return NULL_INDEX;
+		const Order& o = _orders[orderIndex];
+		if (o.next)
+			return sint64(o.next) - 1;
+		const uint32 worse = _levels[o.level - 1].worse;
+		return worse ? sint64(_levels[worse - 1].head) - 1 : NULL_INDEX;
+	}
+
+	template <typename T, uint64 L>
+	sint64 OrderBook<T, L>::nextOwnerElementIndex(sint64 orderIndex) const
+	{
+		if (isEmptySlot(orderIndex))
+			return NULL_INDEX;
+		const Order& o = _orders[orderIndex];
+		if (o.ownerNext)
+			return sint64(o.ownerNext) - 1;
+		const uint32 worse = _levels[o.ownerLevel - 1].worse;
+		return worse ? sint64(_levels[worse - 1].head) - 1 : NULL_INDEX;
+	}
+
+	template <typename T, uint64 L>
+	id OrderBook<T, L>::book(sint64 orderIndex) const
+	{
+		if (isEmptySlot(orderIndex))
+			return NULL_ID;
+		return _sides[_levels[_orders[orderIndex].level - 1].side - 1].key;
+	}
+
+	template <typename T, uint64 L>
+	id OrderBook<T, L>::owner(sint64 orderIndex) const
+	{
+		if (isEmptySlot(orderIndex))
+			return NULL_ID;
+		return _sides[_levels[_orders[orderIndex].ownerLevel - 1].side - 1].key;
+	}
+
+	template <typename T, uint64 L>
+	sint64 OrderBook<T, L>::ownerHeadIndex(const id& owner, uint8 side) const
+	{
+		return _headIndex(owner, (side & 1) | 2);
+	}
+
+	template <typename T, uint64 L>
+	sint64 OrderBook<T, L>::ownerHeadIndex(const id& owner, uint8 side, sint64 price) const
+	{
+		return _headIndex(owner, (side & 1) | 2, price);
+	}
+
+	template <typename T, uint64 L>
+	uint64 OrderBook<T, L>::ownerPopulation(const id& owner, uint8 side) const
+	{
+		const uint32 s = _sideSlots[_findSideSlot(owner, (side & 1) | 2)];
+		return s ? _sides[s - 1].population : 0;
+	}
+
+	template <typename T, uint64 L>
+	inline uint64 OrderBook<T, L>::population() const
+	{
+		return _population;
+	}
+
+	template <typename T, uint64 L>
+	uint64 OrderBook<T, L>::population(const id& book, uint8 side) const
+	{
+		const uint32 s = _sideSlots[_findSideSlot(book, side & 1)];
+		return s ? _sides[s - 1].population : 0;
+	}
+
+	template <typename T, uint64 L>
+	sint64 OrderBook<T, L>::price(sint64 orderIndex) const
+	{
+		if (isEmptySlot(orderIndex))
+			return 0;
+		return _levels[_orders[orderIndex].level - 1].price;
+	}
+
+	template <typename T, uint64 L>
+	sint64 OrderBook<T, L>::remove(sint64 orderIndex)
+	{
+		if (isEmptySlot(orderIndex))
+			return NULL_INDEX;
+		const sint64 nextIndex = nextElementIndex(orderIndex);
+		const uint32 order = uint32(orderIndex + 1);
+		Order& o = _orders[orderIndex];
+
+		// Unlink from FIFOs
+		Level& l = _levels[o.level - 1];
+		if (o.prev)
+			_orders[o.prev - 1].next = o.next;
+		else
+			l.head = o.next;
+		if (o.next)
+			_orders[o.next - 1].prev = o.prev;
+		else
+			l.tail = o.prev;
+
+		Level& ol = _levels[o.ownerLevel - 1];
+		if (o.ownerPrev)
+			_orders[o.ownerPrev - 1].ownerNext = o.ownerNext;
+		else
+			ol.head = o.ownerNext;
+		if (o.ownerNext)
+			_orders[o.ownerNext - 1].ownerPrev = o.ownerPrev;
+		else
+			ol.tail = o.ownerPrev;
+
+		_releaseLevel(o.level);
+		_releaseLevel(o.ownerLevel);
+
+		// Free order slot (zero the value to prevent data leaking between contract calls)
+		setMem(&o, sizeof(o), 0);
+		o.next = _freeOrder;
+		_freeOrder = order;
+		--_population;
+
+		return nextIndex;
+	}
+
+	template <typename T, uint64 L>
+	void OrderBook<T, L>::replace(sint64 orderIndex, const T& newElement)
+	{
+		if (isEmptySlot(orderIndex))
+			return;
+		_orders[orderIndex].value = newElement;
+	}
+
+	template <typename T, uint64 L>
+	void OrderBook<T, L>::reset()
+	{
+		setMem(this, sizeof(*this), 0);
+	}
+
+	template <typename T, uint64 L>
+	uint8 OrderBook<T, L>::side(sint64 orderIndex) const
+	{
+		if (isEmptySlot(orderIndex))
+			return OrderBookSide::ask;
+		return uint8(_sides[_levels[_orders[orderIndex].level - 1].side - 1].type & 1);
+	}
+}
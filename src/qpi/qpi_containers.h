@@ -750,4 +750,166 @@ namespace QPI
 		// Reinitialize as empty linked list.
 		void reset();
 	};
+
+
+	// Sides of the books of an OrderBook
+	namespace OrderBookSide
+	{
+		constexpr uint8 ask = 0;
+		constexpr uint8 bid = 1;
+	}
+
+	// Price-level order books with orders of type T and total order capacity L.
+	// Each book ID (for example an asset) has an ask side and a bid side. The orders of a side are grouped in price
+	// levels, which are sorted from the best price (lowest ask / highest bid) to the worst price. Orders of the same
+	// level are kept in FIFO order (order of adding). Each order also belongs to an owner ID, and the orders of each
+	// owner and side are kept in the same kind of price levels (owner view), so the orders of an entity can be listed
+	// without scanning the books.
+	// Getting the best order of a side, finding a price level, adding, replacing, and removing orders are O(1), except
+	// for adding an order with a new price, which walks the levels of the side from the end with the closer price.
+	// Removed orders, levels, and sides are recycled immediately, so indices of other orders stay valid and no cleanup
+	// is needed.
+	template <typename T, uint64 L>
+	struct OrderBook
+	{
+	private:
+		static_assert(L && !(L & (L - 1)),
+			"The capacity of the OrderBook must be 2^N."
+			);
+		static_assert(L <= (1ULL << 30),
+			"The capacity of the OrderBook must fit into 32-bit indices."
+			);
+
+		// All indices stored below are index + 1, so 0 means "none" and a zero-initialized OrderBook is empty.
+		struct Order
+		{
+			T value;
+			uint32 level, ownerLevel; // price level in book view / in owner view (0 if slot is empty)
+			uint32 prev, next; // neighbors in FIFO of level in book view (next is also used in free list)
+			uint32 ownerPrev, ownerNext; // neighbors in FIFO of level in owner view
+		} _orders[L];
+
+		// Side of book or owner with list of price levels
+		struct Side
+		{
+			id key;
+			uint32 bestLevel, worstLevel;
+			uint32 population;
+			uint32 type; // bit 0: bid side, bit 1: owner view
+		} _sides[2 * L];
+
+		struct Level
+		{
+			sint64 price;
+			uint32 side;
+			uint32 better, worse; // neighbor levels of side (worse is also used in free list)
+			uint32 head, tail; // first and last order of FIFO
+			uint32 population;
+		} _levels[2 * L];
+
+		// Hash maps (open addressing, linear probing) from side key + type and from side + price to index + 1
+		uint32 _sideSlots[4 * L];
+		uint32 _levelSlots[4 * L];
+
+		uint64 _population;
+		uint32 _freeOrder, _freeSide, _freeLevel; // heads of free lists
+		uint32 _usedOrders, _usedSides, _usedLevels; // number of slots that have ever been used
+
+		// Return slot of side in _sideSlots where it is stored or should be inserted.
+		uint64 _findSideSlot(const id& key, uint32 type) const;
+
+		// Return slot of level in _levelSlots where it is stored or should be inserted.
+		uint64 _findLevelSlot(uint32 side, sint64 price) const;
+
+		// Remove entry from hash map and close the gap (backward shift deletion).
+		void _eraseSlot(uint32* slots, uint64 slot, bool levelSlots);
+
+		// Return side (index + 1) of key and type, creating it if needed.
+		uint32 _acquireSide(const id& key, uint32 type);
+
+		// Return level (index + 1) of side and price, creating and linking it if needed.
+		uint32 _acquireLevel(uint32 side, sint64 price);
+
+		// Decrease population of level and its side, freeing them if they got empty.
+		void _releaseLevel(uint32 level);
+
+		// Return true if a price is better than another one on the given side type.
+		static inline bool _isBetter(uint32 type, sint64 price, sint64 otherPrice);
+
+		// Return first order (or NULL_INDEX) of side or of level of side with price.
+		sint64 _headIndex(const id& key, uint32 type) const;
+		sint64 _headIndex(const id& key, uint32 type, sint64 price) const;
+
+	public:
+		// Add order at the end of the FIFO of its price level in book and owner view.
+		// Return orderIndex of the new order, or NULL_INDEX if the order book is full.
+		sint64 add(const id& book, const id& owner, uint8 side, sint64 price, const T& element);
+
+		// Return maximum number of orders that may be stored.
+		static constexpr uint64 capacity()
+		{
+			return L;
+		}
+
+		// Return order value at orderIndex.
+		inline const T& element(sint64 orderIndex) const;
+
+		// Return orderIndex of first order with best price on side of book (or NULL_INDEX if side is empty).
+		sint64 headIndex(const id& book, uint8 side) const;
+
+		// Return orderIndex of first order with given price on side of book (or NULL_INDEX if there is none).
+		sint64 headIndex(const id& book, uint8 side, sint64 price) const;
+
+		// Return true if there is no order at orderIndex.
+		inline bool isEmptySlot(sint64 orderIndex) const;
+
+		// Move order to the end of the FIFO of its price level in owner view, keeping its position in book view.
+		// Do nothing if the slot is empty. (Used to restore the owner order when rebuilding an order book.)
+		void moveToOwnerTail(sint64 orderIndex);
+
+		// Return orderIndex of next order on the same side of the book: next in FIFO or first of next worse price
+		// level (or NULL_INDEX if this is the last order).
+		sint64 nextElementIndex(sint64 orderIndex) const;
+
+		// Return orderIndex of next order of the same owner and side: next in FIFO or first of next worse price level
+		// (or NULL_INDEX if this is the last order).
+		sint64 nextOwnerElementIndex(sint64 orderIndex) const;
+
+		// Return book of order (or NULL_ID if the slot is empty).
+		id book(sint64 orderIndex) const;
+
+		// Return owner of order (or NULL_ID if the slot is empty).
+		id owner(sint64 orderIndex) const;
+
+		// Return orderIndex of first order of owner with best price on side (or NULL_INDEX if there is none).
+		sint64 ownerHeadIndex(const id& owner, uint8 side) const;
+
+		// Return orderIndex of first order of owner with given price on side (or NULL_INDEX if there is none).
+		sint64 ownerHeadIndex(const id& owner, uint8 side, sint64 price) const;
+
+		// Return number of orders of owner on side.
+		uint64 ownerPopulation(const id& owner, uint8 side) const;
+
+		// Return overall number of orders.
+		inline uint64 population() const;
+
+		// Return number of orders on side of book.
+		uint64 population(const id& book, uint8 side) const;
+
+		// Return price of order (or 0 if the slot is empty).
+		sint64 price(sint64 orderIndex) const;
+
+		// Remove order. Return orderIndex of the next order on the same side of the book (see nextElementIndex()).
+		// Indices of other orders stay valid.
+		sint64 remove(sint64 orderIndex);
+
+		// Replace value of existing order, keeping its position in the FIFO. Do nothing if the slot is empty.
+		void replace(sint64 orderIndex, const T& newElement);
+
+		// Reinitialize as empty order book.
+		void reset();
+
+		// Return side of order (OrderBookSide::ask or OrderBookSide::bid).
+		uint8 side(sint64 orderIndex) const;
+	};
 }
@@ -60,10 +60,13 @@
 
 #include "ticking/ticking.h"
 #include "ticking/tick_storage.h"
+#include "ticking/tick_vote_tally.h"
+#include "ticking/quorum_tick_cache.h"
 #include "ticking/pending_txs_pool.h"
 #include "qpi/impl/qpi_ticking_impl.h"
 #include "vote_counter.h"
 #include "ticking/execution_fee_report_collector.h"
+#include "ticking/epoch_transition.h"
 #include "ticking/stable_computor_index.h"
 #include "network_messages/execution_fees.h"
 
@@ -89,14 +92,14 @@
 
 #include "qpi/impl/qpi_mining_impl.h"
 #include "revenue.h"
+#include "ticking/tick_transaction_processing.h"
 
 ////////// Qubic \\\\\\\\\\
 
 #define CONTRACT_STATES_DEPTH 10 // Is derived from MAX_NUMBER_OF_CONTRACTS (=N)
 #define TICK_REQUESTING_PERIOD 500ULL
-#define MAX_NUMBER_EPOCH 1000ULL
-#define MAX_NUMBER_OF_MINERS 8192
-#define NUMBER_OF_MINER_SOLUTION_FLAGS 0x100000000
+#define TICK_RANGE_REQUESTING_DISTANCE 3 // catch up with RequestTickRange if votes of tick >= system.tick + distance are received
+#define TICK_RANGE_REQUESTING_TIMEOUT 2000ULL
 #define MAX_MESSAGE_PAYLOAD_SIZE MAX_TRANSACTION_SIZE
 #define MAX_UNIVERSE_SIZE 1073741824
 #define MESSAGE_DISSEMINATION_THRESHOLD 1000000000
@@ -142,12 +145,10 @@ static int misalignedState = 0;
 static volatile unsigned char epochTransitionState = 0;
 static volatile unsigned char epochTransitionCleanMemoryFlag = 1;
 static volatile long epochTransitionWaitingRequestProcessors = 0;
+static EpochTransitionStages epochTransitionStages;
+static bool epochTransitionTickStorageReady = false; // ts.beginEpoch() has already been called in endEpoch()
 
 // data closely related to system
-static int solutionPublicationTicks[MAX_NUMBER_OF_SOLUTIONS]; // scheduled tick to broadcast solution, -1 means already broadcasted, -2 means obsolete solution
-#define SOLUTION_RECORDED_FLAG -1
-#define SOLUTION_OBSOLETE_FLAG -2
-
 static unsigned long long faultyComputorFlags[(NUMBER_OF_COMPUTORS + 63) / 64];
 static unsigned int gTickNumberOfComputors = 0, gTickTotalNumberOfComputors = 0, gFutureTickTotalNumberOfComputors = 0;
 static unsigned int nextTickTransactionsSemaphore = 0, numberOfNextTickTransactions = 0, numberOfKnownNextTickTransactions = 0;
@@ -155,19 +156,25 @@ static unsigned short numberOfOwnComputorIndices;
 static unsigned short ownComputorIndices[computorSeedsCount];
 static unsigned short ownComputorIndicesMapping[computorSeedsCount];
 
-static VoteCounter voteCounter;
-static ExecutionFeeReportCollector executionFeeReportCollector;
-static TickData nextTickData;
 static PendingTxsPool pendingTxsPool;
 
-static m256i uniqueNextTickTransactionDigests[NUMBER_OF_COMPUTORS];
-static unsigned int uniqueNextTickTransactionDigestCounters[NUMBER_OF_COMPUTORS];
-
-static unsigned int resourceTestingDigest = 0;
+static TickVoteTally tickVoteTally;
+static QuorumTickCache quorumTickCache;
+static volatile unsigned int computorLatestVotedTicks[NUMBER_OF_COMPUTORS] = { 0 }; // highest tick of verified votes received per computor, for detecting lag
 
-static unsigned int numberOfTransactions = 0;
+// Incremented whenever etalonTick is changed after initialization, used for detecting changes in updateVotesCount()
+static unsigned int etalonTickVersion = 0;
 
-static unsigned long long spectrumChangeFlags[SPECTRUM_CAPACITY / (sizeof(unsigned long long) * 8)];
+// Result of updateVotesCount(), reused while neither the votes nor the etalonTick have changed
+static struct
+{
+    unsigned int tick;
+    unsigned int votesVersion;
+    unsigned int resourceTestingDigest;
+    unsigned int etalonTickVersion;
+    unsigned int tickNumberOfComputors;
+    bool valid;
+} votesCountCache;
 
 static unsigned long long mainLoopNumerator = 0, mainLoopDenominator = 0;
 static volatile unsigned char contractProcessorState = 0;
@@ -178,8 +185,6 @@ static unsigned char contractProcessorPostIncomingTransferType = 0;
 static const UserProcedureRegistry::UserProcedureData* contractProcessorUserProcedureNotificationProc = 0;
 static const void* contractProcessorUserProcedureNotificationInput = 0;
 static EFI_EVENT contractProcessorEvent;
-static m256i contractStateDigests[MAX_NUMBER_OF_CONTRACTS * 2 - 1];
-const unsigned long long contractStateDigestsSizeInBytes = sizeof(contractStateDigests);
 
 // targetNextTickDataDigestIsKnown == true signals that we need to fetch TickData (update the version in this node)
 // targetNextTickDataDigestIsKnown == false means there is no consensus on next tick data yet
@@ -210,55 +215,12 @@ static int nRequestProcessorIDs = 0;
 static int nContractProcessorIDs = 0;
 static int nSolutionProcessorIDs = 0;
 
-static ScoreFunction<
-    NUMBER_OF_SOLUTION_PROCESSORS
-> * score = nullptr;
-static unsigned char* gBpp9000TaskBuffer = nullptr;
-static volatile char solutionsLock = 0;
-static unsigned long long* minerSolutionFlags = NULL;
-static volatile m256i minerPublicKeys[MAX_NUMBER_OF_MINERS + 1];
-static volatile unsigned int minerScores[MAX_NUMBER_OF_MINERS + 1];
-// Tick in which each miner reached its currently recorded best score, used as ranking tie-breaker
-static volatile unsigned int minerBestScoreTicks[MAX_NUMBER_OF_MINERS + 1];
-static volatile unsigned int numberOfMiners = NUMBER_OF_COMPUTORS;
-static m256i competitorPublicKeys[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
-static unsigned int competitorScores[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
-static unsigned int competitorTicks[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
-static bool competitorComputorStatuses[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
-static constexpr unsigned int NO_MINER_SCORE = 0xFFFFFFFFU;
-static unsigned int minimumComputorScore = NO_MINER_SCORE;
-static unsigned int minimumCandidateScore = NO_MINER_SCORE;
-static int solutionThreshold[MAX_NUMBER_EPOCH][score_engine::AlgoType::MaxAlgoCount];
 static unsigned long long solutionTotalExecutionTicks = 0;
-static unsigned long long K12MeasurementsCount = 0;
-static unsigned long long K12MeasurementsSum = 0;
-static volatile char minerScoreArrayLock = 0;
 static SpecialCommandGetMiningScoreRanking<MAX_NUMBER_OF_MINERS> requestMiningScoreRanking;
-static constexpr unsigned int gScoreMultiplier[score_engine::AlgoType::MaxAlgoCount] =
-{
-    NEURAXON_SOLUTION_MULTIPLER,   // Neuraxon (reserved)
-    BPP9000_SOLUTION_MULTIPLER     // Bpp9000
-};
-
-// Active solution threshold for an algorithm
-static int getSolutionThreshold(score_engine::AlgoType selectedAlgo)
-{
-    if (selectedAlgo >= score_engine::AlgoType::MaxAlgoCount)
-    {
-        return 0;
-    }
-    return (system.epoch < MAX_NUMBER_EPOCH)
-        ? solutionThreshold[system.epoch][selectedAlgo]
-        : score_engine::DEFAUL_SOLUTION_THRESHOLD[selectedAlgo];
-}
-static bool applyBpp9000Task();
 
 // DOGE merged-mining shares
 static volatile char gDogeMiningSharesCountLock = 0;
 static unsigned int gDogeMiningSharesCount[NUMBER_OF_COMPUTORS] = { 0 };
-static CustomMiningSharesCounter gDogeMiningSharesCounter;
-
-static CustomQubicMiningStorage customQubicMiningStorage;
 
 // variables and declare for persisting state
 static volatile int requestPersistingNodeState = 0;
@@ -268,31 +230,12 @@ static bool loadMiningSeedFromFile = false;
 static bool loadAllNodeStateFromFile = false;
 #if TICK_STORAGE_AUTOSAVE_MODE
 static unsigned int nextPersistingNodeStateTick = 0;
-struct
-{
-    Tick etalonTick;
-    m256i minerPublicKeys[MAX_NUMBER_OF_MINERS + 1];
-    unsigned int minerScores[MAX_NUMBER_OF_MINERS + 1];
-    unsigned int minerBestScoreTicks[MAX_NUMBER_OF_MINERS + 1];
-    m256i competitorPublicKeys[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
-    unsigned int competitorScores[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
-    unsigned int competitorTicks[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
-    bool competitorComputorStatuses[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
-    m256i currentRandomSeed;    
-    int solutionPublicationTicks[MAX_NUMBER_OF_SOLUTIONS];
-    unsigned long long faultyComputorFlags[(NUMBER_OF_COMPUTORS + 63) / 64];
-    unsigned char voteCounterData[VoteCounter::VoteCounterDataSize];
-    BroadcastComputors broadcastedComputors;
-    unsigned int resourceTestingDigest;
-    unsigned int numberOfMiners;
-    unsigned int numberOfTransactions;
-    unsigned char dogeMiningSharesCounterData[CustomMiningSharesCounter::_customMiningSolutionCounterDataSize];
-} nodeStateBuffer;
+NodeMiningStateSnapshot nodeStateBuffer;
 #endif
-static bool saveContractStateFiles(CHAR16* directory = NULL);
+static bool saveContractStateFiles(CHAR16* directory = NULL, bool incremental = false);
 static bool saveContractExecFeeFiles(CHAR16* directory = NULL, bool saveAccumulatedTime = false);
 static bool saveSystem(CHAR16* directory = NULL);
-static bool loadContractStateFiles(CHAR16* directory = NULL, bool forceLoadFromFile = false);
+static bool loadContractStateFiles(CHAR16* directory = NULL, bool forceLoadFromFile = false, bool incremental = false);
 static bool loadContractExecFeeFiles(CHAR16* directory = NULL, bool loadAccumulatedTime = false);
 
 #if ENABLED_LOGGING
@@ -318,6 +261,12 @@ static struct
     RequestResponseHeader header;
 } requestedComputors;
 
+static struct
+{
+    RequestResponseHeader header;
+    ExchangePublicPeers exchangePublicPeers;
+} exchangedPublicPeers;
+
 static struct
 {
     RequestResponseHeader header;
@@ -330,6 +279,12 @@ static struct
     RequestTickData requestTickData;
 } requestedTickData;
 
+static struct
+{
+    RequestResponseHeader header;
+    RequestTickRange requestTickRange;
+} requestedTickRange;
+
 static struct
 {
     RequestResponseHeader header;
@@ -435,77 +390,6 @@ static void enableAVX()
         ));
 }
 
-// Should only be called from tick processor to avoid concurrent state changes, which can cause race conditions as detailed in FIXME below.
-static void getComputerDigest(m256i& digest)
-{
-    PROFILE_SCOPE();
-
-    unsigned int digestIndex;
-    for (digestIndex = 0; digestIndex < MAX_NUMBER_OF_CONTRACTS; digestIndex++)
-    {
-        if (contractStateChangeFlags[digestIndex >> 6] & (1ULL << (digestIndex & 63)))
-        {
-            const unsigned long long size = digestIndex < contractCount ? contractDescriptions[digestIndex].stateSize : 0;
-            if (!size)
-            {
-                contractStateDigests[digestIndex] = m256i::zero();
-            }
-            else
-            {
-                // FIXME: We may have a race condition here if a digest is computed here by thread A, the state is changed
-                // + contractStateChangeFlags set afterwards by thread B and contractStateChangeFlags cleared below below
-                // by thread A. We then have a changed state but a cleared contractStateChangeFlags flag leading to wrong
-                // digest.
-                // This is currently avoided by calling getComputerDigest() from tick processor only (and in non-concurrent init)
-                contractStateLock[digestIndex].acquireRead();
-
-                const unsigned long long startTime = __rdtsc();
-                KangarooTwelve(contractStates[digestIndex], (unsigned int)size, &contractStateDigests[digestIndex], 32);
-                const unsigned long long executionTime = __rdtsc() - startTime;
-
-                contractStateLock[digestIndex].releaseRead();
-
-                // K12 of state is included in contract execution time
-                _interlockedadd64(&contractTotalExecutionTime[digestIndex], executionTime);
-                // do not charge contract 0 state digest computation,
-                // only charge execution time if contract is already constructed/not in IPO
-                // TODO: enable this after adding proper tracking of contract state writes
-                //if (digestIndex > 0 && system.epoch >= contractDescriptions[digestIndex].constructionEpoch)
-                //{
-                //    executionTimeAccumulator.addTime(digestIndex, executionTime);
-                //}
-
-                // Gather data for comparing different versions of K12
-                if (K12MeasurementsCount < 500)
-                {
-                    K12MeasurementsSum += executionTime;
-                    K12MeasurementsCount++;
-                }
-            }
-        }
-    }
-    unsigned int previousLevelBeginning = 0;
-    unsigned int numberOfLeafs = MAX_NUMBER_OF_CONTRACTS;
-    while (numberOfLeafs > 1)
-    {
-        for (unsigned int i = 0; i < numberOfLeafs; i += 2)
-        {
-            if (contractStateChangeFlags[i >> 6] & (3ULL << (i & 63)))
-            {
-                KangarooTwelve64To32(&contractStateDigests[previousLevelBeginning + i], &contractStateDigests[digestIndex]);
-                contractStateChangeFlags[i >> 6] &= ~(3ULL << (i & 63));
-                contractStateChangeFlags[i >> 7] |= (1ULL << ((i >> 1) & 63));
-            }
-            digestIndex++;
-        }
-        previousLevelBeginning += numberOfLeafs;
-        numberOfLeafs >>= 1;
-    }
-    contractStateChangeFlags[0] = 0;
-
-    digest = contractStateDigests[(MAX_NUMBER_OF_CONTRACTS * 2 - 1) - 1];
-}
-
 
 static void processExchangePublicPeers(Peer* peer, RequestResponseHeader* header)
 {
@@ -779,12 +663,22 @@ static void processBroadcastTick(Peer* peer, RequestResponseHeader* header)
                 enqueueResponse(NULL, header);
             }
 
+            // Racy update is fine, a lost maximum is restored by the next vote
+            if (request->tick.tick > computorLatestVotedTicks[request->tick.computorIndex])
+            {
+                computorLatestVotedTicks[request->tick.computorIndex] = request->tick.tick;
+            }
+
+            bool newVoteStored = false;
             ts.ticks.acquireLock(request->tick.computorIndex);
 
             // Find element in tick storage and check if contains data (epoch is set to 0 on init)
-            Tick* tsTick = ts.ticks.getByTickInCurrentEpoch(request->tick.tick) + request->tick.computorIndex;
-            if (tsTick->epoch == system.epoch)
+            const unsigned int tickIndex = ts.tickToIndexCurrentEpoch(request->tick.tick);
+            Tick storedTick;
+            if (ts.ticks.getByTickIndex(tickIndex)[request->tick.computorIndex].epoch == system.epoch
+                && ts.ticks.get(tickIndex, request->tick.computorIndex, storedTick))
             {
+                const Tick* tsTick = &storedTick;
                 // Check if the sent tick matches the tick in tick storage
                 if (*((unsigned long long*)&request->tick.millisecond) != *((unsigned long long*)&tsTick->millisecond)
                     || request->tick.prevSpectrumDigest != tsTick->prevSpectrumDigest
@@ -814,17 +708,59 @@ static void processBroadcastTick(Peer* peer, RequestResponseHeader* header)
                 }
                 if (isOk)
                 {
-                    // Copy the sent tick to the tick storage
-                    copyMem(tsTick, &request->tick, sizeof(Tick));
-                    peer->lastActiveTick = max(peer->lastActiveTick, peer->getDejavuTick(header->dejavu()));
+                    // Copy the sent tick to the tick storage (fails if the shared digests table of the tick is
+                    // full, which only happens for votes that cannot be part of a quorum or if all overflow blocks
+                    // of the tables are in use)
+                    if (ts.ticks.store(tickIndex, request->tick))
+                    {
+                        peer->lastActiveTick = max(peer->lastActiveTick, peer->getDejavuTick(header->dejavu()));
+                        newVoteStored = true;
+                    }
                 }
             }
 
             ts.ticks.releaseLock(request->tick.computorIndex);
+
+            // Update running tally after releasing the computor lock (see TickVoteTally)
+            if (newVoteStored)
+            {
+                tickVoteTally.addVote(request->tick);
+            }
         }
     }
 }
 
+// Return highest tick that at least NUMBER_OF_COMPUTORS - QUORUM + 1 computors have sent verified votes for (or for
+// later ticks). At least one of these computors is honest, so a few faulty computors cannot make the node believe it
+// is lagging.
+static unsigned int getLatestVotedTick()
+{
+    constexpr unsigned int minNumberOfComputors = NUMBER_OF_COMPUTORS - QUORUM + 1;
+    unsigned int ticks[NUMBER_OF_COMPUTORS];
+    unsigned int maxTick = 0;
+    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+    {
+        ticks[i] = computorLatestVotedTicks[i];
+        if (ticks[i] > maxTick)
+            maxTick = ticks[i];
+    }
+
+    // binary search: at least minNumberOfComputors voted for tick >= low, less than that for tick >= high
+    unsigned long long low = 0, high = (unsigned long long)maxTick + 1;
+    while (low + 1 < high)
+    {
+        const unsigned int mid = (unsigned int)((low + high) / 2);
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+            count += (ticks[i] >= mid);
+        if (count >= minNumberOfComputors)
+            low = mid;
+        else
+            high = mid;
+    }
+    return (unsigned int)low;
+}
+
 static void processBroadcastFutureTickData(Peer* peer, RequestResponseHeader* header)
 {
     if (!header->checkPayloadSize(sizeof(BroadcastFutureTickData)))
@@ -1058,9 +994,33 @@ static void processRequestComputors(Peer* peer, RequestResponseHeader* header)
     }
 }
 
+// Add the votes of tick stored at tickIndex with given epoch to the transmit queue of the peer, skipping computors
+// marked in voteFlags (if not NULL). Votes sharing the majority digests are sent first, starting at a random one so
+// peers asking several nodes get different votes first. All votes are added to the transmit queue of the peer at once.
+// Votes aren't stored anymore after the tick has been processed (see processBroadcastTick()), so the votes of older
+// ticks are final and kept in quorumTickCache (one tick of margin for votes being stored concurrently).
+static void enqueueQuorumTickVotes(Peer* peer, unsigned int dejavu, unsigned int tick, unsigned int tickIndex, unsigned short tickEpoch, const unsigned char* voteFlags)
+{
+    const bool final = tickEpoch != system.epoch || tick + 1 < system.tick;
+    QuorumTickCache::Entry& entry = quorumTickCache.acquire(tick, tickIndex, tickEpoch, final);
+    unsigned short computorIndices[NUMBER_OF_COMPUTORS];
+    unsigned int numberOfComputorIndices = 0;
+    const unsigned int start = (entry.majorityCount) ? random(entry.majorityCount) : 0;
+    for (unsigned int i = 0; i < entry.voteCount; i++)
+    {
+        const unsigned short computorIndex = entry.order[(i < entry.majorityCount) ? (start + i) % entry.majorityCount : i];
+        if (!voteFlags || !(voteFlags[computorIndex >> 3] & (1 << (computorIndex & 7))))
+        {
+            computorIndices[numberOfComputorIndices++] = computorIndex;
+        }
+    }
+    enqueueResponseBatch(peer, sizeof(Tick), BroadcastTick::type(), dejavu, entry.votes, computorIndices, numberOfComputorIndices);
+    quorumTickCache.release(entry);
+}
+
 /**
  * Sends Tick data for computors *not* marked in request->voteFlags (0 = requester wants the tick of this computer).
- * Shuffles order, ends with EndResponse.
+ * Sends votes of the majority first (in rotated order), ends with EndResponse.
  */
 static void processRequestQuorumTick(Peer* peer, RequestResponseHeader* header)
 {
@@ -1069,47 +1029,22 @@ static void processRequestQuorumTick(Peer* peer, RequestResponseHeader* header)
     RequestQuorumTick* request = header->getPayload<RequestQuorumTick>();
 
     unsigned short tickEpoch = 0;
-    const Tick* tsCompTicks;
+    unsigned int tickIndex = 0;
     if (ts.tickInCurrentEpochStorage(request->quorumTick.tick))
     {
         tickEpoch = system.epoch;
-        tsCompTicks = ts.ticks.getByTickInCurrentEpoch(request->quorumTick.tick);
+        tickIndex = ts.tickToIndexCurrentEpoch(request->quorumTick.tick);
     }
     else if (ts.tickInPreviousEpochStorage(request->quorumTick.tick))
     {
         tickEpoch = system.epoch - 1;
-        tsCompTicks = ts.ticks.getByTickInPreviousEpoch(request->quorumTick.tick);
+        tickIndex = ts.tickToIndexPreviousEpoch(request->quorumTick.tick);
     }
 
     if (tickEpoch != 0)
     {
         // Send Tick struct data from tick storage as requested by tick and voteFlags in request->quorumTick.
-        // The order of the computors is randomized using a Fisher–Yates shuffle
-        // Todo: This function may be optimized by moving the checking of voteFlags in the first loop, reducing the number of calls to random().
-        unsigned short computorIndices[NUMBER_OF_COMPUTORS];
-        unsigned short numberOfComputorIndices;
-        for (numberOfComputorIndices = 0; numberOfComputorIndices < NUMBER_OF_COMPUTORS; numberOfComputorIndices++)
-        {
-            computorIndices[numberOfComputorIndices] = numberOfComputorIndices;
-        }
-        while (numberOfComputorIndices)
-        {
-            const unsigned short index = random(numberOfComputorIndices);
-
-            if (!(request->quorumTick.voteFlags[computorIndices[index] >> 3] & (1 << (computorIndices[index] & 7))))
-            {
-                // Todo: We should acquire ts.ticks lock here if tick >= system.tick
-                const Tick* tsTick = tsCompTicks + computorIndices[index];
-                if (tsTick->epoch == tickEpoch)
-                {
-                    ts.ticks.acquireLock(computorIndices[index]);
-                    enqueueResponse(peer, sizeof(Tick), BroadcastTick::type(), header->dejavu(), tsTick);
-                    ts.ticks.releaseLock(computorIndices[index]);
-                }
-            }
-
-            computorIndices[index] = computorIndices[--numberOfComputorIndices];
-        }
+        enqueueQuorumTickVotes(peer, header->dejavu(), request->quorumTick.tick, tickIndex, tickEpoch, request->quorumTick.voteFlags);
     }
     enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
 }
@@ -1191,6 +1126,75 @@ static void processRequestTickTransactions(Peer* peer, RequestResponseHeader* he
     enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
 }
 
+/**
+ * Sends tick data, votes, and transactions (as selected by request->flags) of the ticks in the requested range that have
+ * already been processed, ordered by tick, ends with EndResponse. The messages are the same as the ones sent for
+ * RequestTickData, RequestQuorumTick, and RequestTickTransactions, so the requester verifies and stores them with the
+ * usual handlers. Stops early if the transmit queue of the peer is half full, so a catch-up cannot overflow it.
+ */
+static void processRequestTickRange(Peer* peer, RequestResponseHeader* header)
+{
+    if (!header->checkPayloadSize(sizeof(RequestTickRange)))
+        return;
+    RequestTickRange* request = header->getPayload<RequestTickRange>();
+
+    const unsigned int numberOfTicks = min((unsigned int)request->numberOfTicks, (unsigned int)RequestTickRange::maxNumberOfTicks);
+    for (unsigned int tick = request->firstTick; tick - request->firstTick < numberOfTicks && tick < system.tick; tick++)
+    {
+        if (!isPeerGroupPlaceholder(peer) && peer->transmitQueue.size() > PEER_TRANSMIT_QUEUE_SIZE / 2)
+            break;
+
+        unsigned short tickEpoch;
+        unsigned int tickIndex;
+        if (ts.tickInCurrentEpochStorage(tick))
+        {
+            tickEpoch = system.epoch;
+            tickIndex = ts.tickToIndexCurrentEpoch(tick);
+        }
+        else if (ts.tickInPreviousEpochStorage(tick))
+        {
+            tickEpoch = system.epoch - 1;
+            tickIndex = ts.tickToIndexPreviousEpoch(tick);
+        }
+        else
+        {
+            break;
+        }
+
+        if (request->flags & RequestTickRange::tickDataFlag)
+        {
+            const TickData* td = ts.tickData.getByTickIfNotEmpty(tick);
+            if (td)
+            {
+                enqueueResponse(peer, sizeof(TickData), BroadcastFutureTickData::type(), header->dejavu(), td);
+            }
+        }
+
+        if (request->flags & RequestTickRange::votesFlag)
+        {
+            enqueueQuorumTickVotes(peer, header->dejavu(), tick, tickIndex, tickEpoch, NULL);
+        }
+
+        if (request->flags & RequestTickRange::transactionsFlag)
+        {
+            const unsigned long long* tsReqTickTransactionOffsets = ts.tickTransactionOffsets.getByTickIndex(tickIndex);
+            for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; i++)
+            {
+                const unsigned long long tickTransactionOffset = tsReqTickTransactionOffsets[i];
+                if (tickTransactionOffset)
+                {
+                    const Transaction* transaction = ts.tickTransactions(tickTransactionOffset);
+                    if (transaction->tick == tick && transaction->checkValidity())
+                    {
+                        enqueueResponse(peer, transaction->totalSize(), BROADCAST_TRANSACTION, header->dejavu(), (void*)transaction);
+                    }
+                }
+            }
+        }
+    }
+    enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+}
+
 static void processRequestTransactionInfo(Peer* peer, RequestResponseHeader* header)
 {
     if (!header->checkPayloadSize(sizeof(RequestTransactionInfo)))
@@ -1763,6 +1767,37 @@ static void processSpecialCommand(Peer* peer, RequestResponseHeader* header)
             }
             break;
 
+            case SPECIAL_COMMAND_GET_PROFILING_DATA:
+            {
+                // Stream the entries of all processor shards without stopping profiling, one response per entry
+                static_assert(sizeof(SpecialCommandGetProfilingDataResponse::runtimeHistogram) == sizeof(ProfilingData::runtimeHistogram),
+                    "Histogram of SpecialCommandGetProfilingDataResponse and ProfilingData must match");
+                SpecialCommandGetProfilingDataResponse response;
+                response.everIncreasingNonceAndCommandType = request->everIncreasingNonceAndCommandType;
+                response.frequency = frequency;
+                response.padding = 0;
+                ProfilingData entry;
+                for (unsigned int shardIndex = 0; shardIndex < PROFILING_SHARDS; ++shardIndex)
+                {
+                    for (unsigned int entryIndex = 0; gProfilingDataCollector.getMeasurement(shardIndex, entryIndex, entry); ++entryIndex)
+                    {
+                        setMem(response.name, sizeof(response.name), 0);
+                        for (unsigned int i = 0; i < sizeof(response.name) - 1 && entry.name[i]; ++i)
+                            response.name[i] = entry.name[i];
+                        response.line = entry.line;
+                        response.processor = shardIndex;
+                        response.numOfExec = entry.numOfExec;
+                        response.runtimeSum = entry.runtimeSum;
+                        response.runtimeMin = entry.runtimeMin;
+                        response.runtimeMax = entry.runtimeMax;
+                        copyMem(response.runtimeHistogram, entry.runtimeHistogram, sizeof(response.runtimeHistogram));
+                        enqueueResponse(peer, sizeof(SpecialCommandGetProfilingDataResponse), SpecialCommand::type(), header->dejavu(), &response);
+                    }
+                }
+                enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+            }
+            break;
+
             }
         }
     }
@@ -1862,6 +1897,12 @@ static void requestProcessor(void* ProcedureArgument)
             _InterlockedIncrement(&epochTransitionWaitingRequestProcessors);
             BEGIN_WAIT_WHILE(epochTransitionState)
             {
+                // help the tick processor with independent stages of endEpoch()
+                if (epochTransitionStages.tryRunStage() || spectrumJob.tryHelp() || contractDigestJob.tryHelp())
+                {
+                    checkinTime(processorNumber);
+                }
+
                 {
                     // to avoid potential overflow: consume the queue without processing requests
                     ACQUIRE(requestQueueTailLock);
@@ -1898,6 +1939,12 @@ static void requestProcessor(void* ProcedureArgument)
             PROFILE_NAMED_SCOPE("requestProcessor(): solution processing");
             score->tryProcessSolution(processorNumber);
         }
+
+        // help the tick processor with parallel spectrum scans (such as anti-dust) and contract state digests
+        if (spectrumJob.tryHelp() || contractDigestJob.tryHelp())
+        {
+            checkinTime(processorNumber);
+        }
         
         if (requestQueueElementTail == requestQueueElementHead)
         {
@@ -1993,6 +2040,12 @@ static void requestProcessor(void* ProcedureArgument)
                 }
                 break;
 
+                case RequestTickRange::type():
+                {
+                    processRequestTickRange(peer, header);
+                }
+                break;
+
                 case RequestTransactionInfo::type():
                 {
                     processRequestTransactionInfo(peer, header);
@@ -2138,6 +2191,14 @@ static void requestProcessor(void* ProcedureArgument)
                     processRequestConfirmedTx(processorNumber, peer, header);
                 }
                 break;
+
+#if ADDON_TX_STATUS_INDEX
+                case RequestTxStatusBatch::type():
+                {
+                    processRequestTxStatusBatch(peer, header);
+                }
+                break;
+#endif
 #endif
 
                 }
@@ -2294,54 +2355,7 @@ static void contractProcessor(void*)
     case USER_PROCEDURE_CALL:
     case POST_INCOMING_TRANSFER:
     {
-        const Transaction* transaction = contractProcessorTransaction;
-        ASSERT(transaction && transaction->checkValidity());
-
-        ASSERT(transaction->destinationPublicKey.m256i_u64[0] < contractCount);
-        ASSERT(transaction->destinationPublicKey.m256i_u64[1] == 0);
-        ASSERT(transaction->destinationPublicKey.m256i_u64[2] == 0);
-        ASSERT(transaction->destinationPublicKey.m256i_u64[3] == 0);
-
-        unsigned int contractIndex = (unsigned int)transaction->destinationPublicKey.m256i_u64[0];
-        ASSERT(system.epoch >= contractDescriptions[contractIndex].constructionEpoch);
-        ASSERT(system.epoch < contractDescriptions[contractIndex].destructionEpoch);
-
-        if (transaction->amount > 0 && contractSystemProcedures[contractIndex][POST_INCOMING_TRANSFER])
-        {
-            // Run callback system procedure POST_INCOMING_TRANSFER
-            const unsigned char type = contractProcessorPostIncomingTransferType;
-            if (contractProcessorPhase == USER_PROCEDURE_CALL)
-            {
-                ASSERT(type == QPI::TransferType::procedureTransaction);
-            }
-            else
-            {
-                ASSERT(
-                    type == QPI::TransferType::standardTransaction
-                    || type == QPI::TransferType::revenueDonation
-                    || type == QPI::TransferType::ipoBidRefund
-                );
-            }
-
-            QpiContextSystemProcedureCall qpiContext(contractIndex, POST_INCOMING_TRANSFER);
-            QPI::PostIncomingTransfer_input input{ transaction->sourcePublicKey, transaction->amount, type };
-            qpiContext.call(input);
-        }
-
-        if (contractProcessorPhase == USER_PROCEDURE_CALL)
-        {
-            // Run user procedure
-            ASSERT(contractUserProcedures[contractIndex][transaction->inputType]);
-
-            QpiContextUserProcedureCall qpiContext(contractIndex, transaction->sourcePublicKey, transaction->amount);
-            qpiContext.call(transaction->inputType, transaction->inputPtr(), transaction->inputSize);
-
-            if (contractActionTracker.getOverallQuTransferBalance(transaction->sourcePublicKey) == 0)
-                contractProcessorTransactionMoneyflew = 0;
-            else
-                contractProcessorTransactionMoneyflew = 1;
-        }
-
+        contractProcessorTransactionMoneyflew = executeContractTransaction(contractProcessorTransaction, contractProcessorPhase, contractProcessorPostIncomingTransferType);
         contractProcessorTransaction = 0;
     }
     break;
@@ -2372,6 +2386,18 @@ static void contractProcessor(void*)
     }
 }
 
+// Hand over transaction to the contract processor and wait for completion (see executeContractTransaction())
+static bool runContractTransaction(const Transaction* transaction, unsigned int phase, unsigned char postIncomingTransferType)
+{
+    contractProcessorTransaction = transaction;
+    contractProcessorPostIncomingTransferType = postIncomingTransferType;
+    contractProcessorPhase = phase;
+    contractProcessorState = 1;
+    WAIT_WHILE(contractProcessorState);
+
+    return contractProcessorTransactionMoneyflew;
+}
+
 // Notify dest of incoming transfer if dest is a contract.
 // CAUTION: Cannot be called from contract processor or main processor! If called from QPI functions, it will get stuck.
 static void notifyContractOfIncomingTransfer(const m256i& source, const m256i& dest, long long amount, unsigned char type)
@@ -2396,655 +2422,81 @@ static void notifyContractOfIncomingTransfer(const m256i& source, const m256i& d
     tx.inputType = 0;
     tx.inputSize = 0;
 
-    contractProcessorTransaction = &tx;
-    contractProcessorPostIncomingTransferType = type;
-    contractProcessorPhase = POST_INCOMING_TRANSFER;
-    contractProcessorState = 1;
-    WAIT_WHILE(contractProcessorState);
-}
-
-
-static void processTickTransactionContractIPO(const Transaction* transaction, const int spectrumIndex, const unsigned int contractIndex)
-{
-    PROFILE_SCOPE();
-
-    ASSERT(nextTickData.epoch == system.epoch);
-    ASSERT(transaction != nullptr);
-    ASSERT(transaction->checkValidity());
-    ASSERT(transaction->tick == system.tick);
-    ASSERT(!transaction->amount && transaction->inputSize == sizeof(ContractIPOBid));
-    ASSERT(spectrumIndex >= 0);
-    ASSERT(contractIndex < contractCount);
-    ASSERT(system.epoch == (contractDescriptions[contractIndex].constructionEpoch - 1));
-
-    ContractIPOBid* contractIPOBid = (ContractIPOBid*)transaction->inputPtr();
-    bidInContractIPO(contractIPOBid->price, contractIPOBid->quantity, transaction->sourcePublicKey, spectrumIndex, contractIndex);
+    runContractTransaction(&tx, POST_INCOMING_TRANSFER, type);
 }
 
-// Return if money flew
-static bool processTickTransactionContractProcedure(const Transaction* transaction, const int spectrumIndex, const unsigned int contractIndex)
+static void makeAndBroadcastTickVotesTransaction(int i, BroadcastFutureTickData& td, int txSlot)
 {
-    PROFILE_SCOPE();
-
-    ASSERT(nextTickData.epoch == system.epoch);
-    ASSERT(transaction != nullptr);
-    ASSERT(transaction->checkValidity());
-    ASSERT(transaction->tick == system.tick);
-    ASSERT(spectrumIndex >= 0);
-    ASSERT(contractIndex < contractCount);
-    ASSERT(system.epoch >= contractDescriptions[contractIndex].constructionEpoch);
-    ASSERT(system.epoch < contractDescriptions[contractIndex].destructionEpoch);
-
-    if (contractUserProcedures[contractIndex][transaction->inputType])
-    {
-        // Run user procedure call of transaction in contract processor
-        // and wait for completion
-        // With USER_PROCEDURE_CALL, contract processor also notifies the contract
-        // of the incoming transfer if the invocation reward = amount > 0.
-        contractProcessorTransaction = transaction;
-        contractProcessorPostIncomingTransferType = QPI::TransferType::procedureTransaction;
-        contractProcessorPhase = USER_PROCEDURE_CALL;
-        contractProcessorState = 1;
-        WAIT_WHILE(contractProcessorState);
+    PROFILE_NAMED_SCOPE("processTick(): broadcast vote counter tx");
+    ASSERT(txSlot < NUMBER_OF_TRANSACTIONS_PER_TICK);
+    auto& payload = voteCounterPayload; // note: not thread-safe
+    payload.transaction.sourcePublicKey = computorPublicKeys[ownComputorIndicesMapping[i]];
+    payload.transaction.destinationPublicKey = m256i::zero();
+    payload.transaction.amount = 0;
+    payload.transaction.tick = system.tick + TICK_VOTE_COUNTER_PUBLICATION_OFFSET;
+    payload.transaction.inputType = VOTE_COUNTER_INPUT_TYPE;
+    payload.transaction.inputSize = sizeof(payload.data) + sizeof(payload.dataLock);
+    voteCounter.compressNewVotesPacket(system.tick - 675, system.tick + 1, ownComputorIndices[i], payload.data);
+    payload.dataLock = td.tickData.timelock;
+    unsigned char digest[32];
+    KangarooTwelve(&payload.transaction, sizeof(payload.transaction) + sizeof(payload.data) + sizeof(payload.dataLock), digest, sizeof(digest));
+    sign(computorSubseeds[ownComputorIndicesMapping[i]].m256i_u8, computorPublicKeys[ownComputorIndicesMapping[i]].m256i_u8, digest, payload.signature);
+    enqueueResponse(NULL, sizeof(payload), BROADCAST_TRANSACTION, 0, &payload);
 
-        return contractProcessorTransactionMoneyflew;
-    }
-    else if (transaction->amount > 0)
+    // copy the content of this vote packet to local memory
+    unsigned int tickIndex = ts.tickToIndexCurrentEpoch(td.tickData.tick);
+    unsigned int transactionSize = sizeof(voteCounterPayload);
+    KangarooTwelve(&payload, transactionSize, digest, sizeof(digest));
+    auto* tsReqTickTransactionOffsets = ts.tickTransactionOffsets.getByTickIndex(tickIndex);
+    if (txSlot < NUMBER_OF_TRANSACTIONS_PER_TICK) // valid slot
     {
-        // Transaction sending qu to contract without invoking registered user procedure:
-        // Run POST_INCOMING_TRANSFER notification in contract processor and wait for completion.
-        contractProcessorTransaction = transaction;
-        contractProcessorPostIncomingTransferType = QPI::TransferType::standardTransaction;
-        contractProcessorPhase = POST_INCOMING_TRANSFER;
-        contractProcessorState = 1;
-        WAIT_WHILE(contractProcessorState);
+        // TODO: refactor function add transaction to txStorage
+        ts.tickTransactions.acquireLock();
+        if (!tsReqTickTransactionOffsets[txSlot]) // not yet have value
+        {
+            if (ts.nextTickTransactionOffset + transactionSize <= ts.tickTransactions.storageSpaceCurrentEpoch) //have enough space
+            {
+                td.tickData.transactionDigests[txSlot] = m256i(digest);
+                tsReqTickTransactionOffsets[txSlot] = ts.nextTickTransactionOffset;
+                copyMem(ts.tickTransactions(ts.nextTickTransactionOffset), &payload, transactionSize);
+                ts.nextTickTransactionOffset += transactionSize;
+            }
+        }
+        ts.tickTransactions.releaseLock();
     }
-
-    // if transaction tries to invoke non-registered procedure, transaction amount is not reimbursed
-    return transaction->amount > 0;
 }
 
-// Ranking order of miners and competitors, the score is an error count, so the smaller score ranks
-// first, and on equal score the entry that reached it in the earlier tick ranks first. Returns true
-// if entry A ranks below entry B.
-static bool ranksBelow(unsigned int scoreA, unsigned int tickA, unsigned int scoreB, unsigned int tickB)
+// Generic mining share broadcast helper.
+// Takes the broadcast buffer + counter by reference so it can be reused for
+// any CustomMiningSharesCounter-based pipeline (DOGE today; future mining types tomorrow).
+static bool makeAndBroadcastCustomMiningTransaction(
+    BroadcastCustomMiningTransaction* broadcastTxBuffer,
+    CustomMiningSharesCounter& sharesCounter,
+    int i,
+    BroadcastFutureTickData& td,
+    int txSlot)
 {
-    if (scoreA != scoreB)
+    if (!broadcastTxBuffer[i].isBroadcasted)
     {
-        return scoreA > scoreB;
-    }
-    return tickA > tickB;
-}
-
-static void processTickTransactionSolution(const MiningSolutionTransaction* transaction, const unsigned long long processorNumber)
-{
-    PROFILE_SCOPE();
+        broadcastTxBuffer[i].isBroadcasted = true;
+        auto& payload = broadcastTxBuffer[i].payload;
+        if (sharesCounter.isEmptyPacket(payload.packedScore) == false)
+        {
+            payload.transaction.tick = system.tick + TICK_TRANSACTIONS_PUBLICATION_OFFSET;
+            payload.dataLock = td.tickData.timelock;
+            unsigned char digest[32];
+            KangarooTwelve(&payload.transaction, sizeof(payload.transaction) + sizeof(payload.packedScore) + sizeof(payload.dataLock), digest, sizeof(digest));
+            sign(computorSubseeds[ownComputorIndicesMapping[i]].m256i_u8, computorPublicKeys[ownComputorIndicesMapping[i]].m256i_u8, digest, payload.signature);
+            enqueueResponse(NULL, sizeof(payload), BROADCAST_TRANSACTION, 0, &payload);
 
-    ASSERT(nextTickData.epoch == system.epoch);
-    ASSERT(transaction != nullptr);
-    ASSERT(transaction->checkValidity());
-    ASSERT(transaction->tick == system.tick);
-    ASSERT(isZero(transaction->destinationPublicKey));
-    ASSERT(transaction->amount >=MiningSolutionTransaction::minAmount()
-            && transaction->inputSize == MiningSolutionTransaction::minInputSize()
-            && transaction->inputType == MiningSolutionTransaction::transactionType());
-
-    m256i data[3] = { transaction->sourcePublicKey, transaction->miningSeed, transaction->nonce };
-    static_assert(sizeof(data) == 3 * 32, "Unexpected array size");
-    unsigned int flagIndices[2];
-    KangarooTwelve(data, sizeof(data), flagIndices, sizeof(flagIndices));
-    // Two independent flag checks to reduce false-positive collision probability from ~N/2^32 to ~N^2/2^64
-    if (!(minerSolutionFlags[flagIndices[0] >> 6] & (1ULL << (flagIndices[0] & 63)))
-        || !(minerSolutionFlags[flagIndices[1] >> 6] & (1ULL << (flagIndices[1] & 63))))
-    {
-        minerSolutionFlags[flagIndices[0] >> 6] |= (1ULL << (flagIndices[0] & 63));
-        minerSolutionFlags[flagIndices[1] >> 6] |= (1ULL << (flagIndices[1] & 63));
-
-        unsigned int solutionScore = (*::score)(processorNumber, transaction->sourcePublicKey, transaction->miningSeed, transaction->nonce);
-        score_engine::AlgoType selectedAlgo = score_engine::getAlgoType(transaction->nonce.m256i_u8);
-        if (score->isValidScore(solutionScore, selectedAlgo))
-        {
-            resourceTestingDigest ^= solutionScore;
-            KangarooTwelve(&resourceTestingDigest, sizeof(resourceTestingDigest), &resourceTestingDigest, sizeof(resourceTestingDigest));
-            const int threshold = getSolutionThreshold(selectedAlgo);
-            // The deposit is only returned when the miner's claimed score matches the one computed
-            if (transaction->score == solutionScore
-                && score->isGoodScore(solutionScore, threshold, selectedAlgo))
+            unsigned int tickIndex = ts.tickToIndexCurrentEpoch(td.tickData.tick);
+            unsigned int transactionSize = sizeof(payload);
+            KangarooTwelve(&payload, transactionSize, digest, sizeof(digest));
+            auto* tsReqTickTransactionOffsets = ts.tickTransactionOffsets.getByTickIndex(tickIndex);
+            if (txSlot < NUMBER_OF_TRANSACTIONS_PER_TICK)
             {
-                // Solution deposit return
-                {
-                    increaseEnergy(transaction->sourcePublicKey, transaction->amount);
-
-                    const QuTransfer quTransfer = { m256i::zero(), transaction->sourcePublicKey, transaction->amount };
-                    logger.logQuTransfer(quTransfer);
-                }
-
-                for (unsigned int i = 0; i < computorSeedsCount; i++)
-                {
-                    if (transaction->sourcePublicKey == computorPublicKeys[i])
-                    {
-                        ACQUIRE(solutionsLock);
-
-                        unsigned int j;
-                        for (j = 0; j < system.numberOfSolutions; j++)
-                        {
-                            if (transaction->nonce == system.solutions[j].nonce
-                                && transaction->miningSeed == system.solutions[j].miningSeed
-                                && transaction->sourcePublicKey == system.solutions[j].computorPublicKey)
-                            {
-                                solutionPublicationTicks[j] = SOLUTION_RECORDED_FLAG;
-
-                                break;
-                            }
-                        }
-                        if (j == system.numberOfSolutions
-                            && system.numberOfSolutions < MAX_NUMBER_OF_SOLUTIONS)
-                        {
-                            system.solutions[system.numberOfSolutions].computorPublicKey = transaction->sourcePublicKey;
-                            system.solutions[system.numberOfSolutions].miningSeed = transaction->miningSeed;
-                            system.solutions[system.numberOfSolutions].nonce = transaction->nonce;
-                            system.solutions[system.numberOfSolutions].score = solutionScore;
-                            solutionPublicationTicks[system.numberOfSolutions++] = SOLUTION_RECORDED_FLAG;
-                        }
-
-                        RELEASE(solutionsLock);
-
-                        break;
-                    }
-                }
-
-                // A miner is ranked by its single best score of the epoch, not by the number of
-                // accepted solutions
-                const unsigned int newScore = solutionScore * gScoreMultiplier[selectedAlgo];
-                const unsigned int newTick = system.tick;
-
-                ACQUIRE(minerScoreArrayLock);
-                bool minerEntryChanged = false;
-                unsigned int minerIndex;
-                for (minerIndex = 0; minerIndex < numberOfMiners; minerIndex++)
-                {
-                    if (transaction->sourcePublicKey == minerPublicKeys[minerIndex])
-                    {
-                        if (newScore < minerScores[minerIndex])
-                        {
-                            minerScores[minerIndex] = newScore;
-                            minerBestScoreTicks[minerIndex] = newTick;
-                            minerEntryChanged = true;
-                        }
-
-                        break;
-                    }
-                }
-                if (minerIndex == numberOfMiners)
-                {
-                    if (numberOfMiners < MAX_NUMBER_OF_MINERS)
-                    {
-                        minerPublicKeys[numberOfMiners] = transaction->sourcePublicKey;
-                        minerBestScoreTicks[numberOfMiners] = newTick;
-                        minerScores[numberOfMiners++] = newScore;
-                        minerEntryChanged = true;
-                    }
-                    else
-                    {
-                        // The table is full. Entries beyond the computor block are kept sorted, so the
-                        // worst-ranked one sits at the end and is replaced only if the newcomer outranks it.
-                        const unsigned int worstIndex = numberOfMiners - 1;
-                        if (ranksBelow(minerScores[worstIndex], minerBestScoreTicks[worstIndex], newScore, newTick))
-                        {
-                            minerPublicKeys[worstIndex] = transaction->sourcePublicKey;
-                            minerScores[worstIndex] = newScore;
-                            minerBestScoreTicks[worstIndex] = newTick;
-                            minerIndex = worstIndex;
-                            minerEntryChanged = true;
-                        }
-                    }
-                }
-
-                if (minerEntryChanged)
-                {
-                    const m256i tmpPublicKey = minerPublicKeys[minerIndex];
-                    const unsigned int tmpScore = minerScores[minerIndex];
-                    const unsigned int tmpTick = minerBestScoreTicks[minerIndex];
-                    while (minerIndex > (unsigned int)(minerIndex < NUMBER_OF_COMPUTORS ? 0 : NUMBER_OF_COMPUTORS)
-                        && ranksBelow(minerScores[minerIndex - 1], minerBestScoreTicks[minerIndex - 1], minerScores[minerIndex], minerBestScoreTicks[minerIndex]))
-                    {
-                        minerPublicKeys[minerIndex] = minerPublicKeys[minerIndex - 1];
-                        minerScores[minerIndex] = minerScores[minerIndex - 1];
-                        minerBestScoreTicks[minerIndex] = minerBestScoreTicks[minerIndex - 1];
-                        minerPublicKeys[--minerIndex] = tmpPublicKey;
-                        minerScores[minerIndex] = tmpScore;
-                        minerBestScoreTicks[minerIndex] = tmpTick;
-                    }
-                }
-
-                // combine 225 worst current computors with 225 best candidates
-                for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS - QUORUM; i++)
-                {
-                    competitorPublicKeys[i] = minerPublicKeys[QUORUM + i];
-                    competitorScores[i] = minerScores[QUORUM + i];
-                    competitorTicks[i] = minerBestScoreTicks[QUORUM + i];
-                    competitorComputorStatuses[i] = true;
-
-                    if (NUMBER_OF_COMPUTORS + i < numberOfMiners)
-                    {
-                        competitorPublicKeys[i + (NUMBER_OF_COMPUTORS - QUORUM)] = minerPublicKeys[NUMBER_OF_COMPUTORS + i];
-                        competitorScores[i + (NUMBER_OF_COMPUTORS - QUORUM)] = minerScores[NUMBER_OF_COMPUTORS + i];
-                        competitorTicks[i + (NUMBER_OF_COMPUTORS - QUORUM)] = minerBestScoreTicks[NUMBER_OF_COMPUTORS + i];
-                    }
-                    else
-                    {
-                        competitorScores[i + (NUMBER_OF_COMPUTORS - QUORUM)] = NO_MINER_SCORE;
-                        competitorTicks[i + (NUMBER_OF_COMPUTORS - QUORUM)] = 0;
-                    }
-                    competitorComputorStatuses[i + (NUMBER_OF_COMPUTORS - QUORUM)] = false;
-                }
-                RELEASE(minerScoreArrayLock);
-
-                // bubble sorting -> top 225 from competitorPublicKeys have computors and candidates which are the best from that subset
-                for (unsigned int i = NUMBER_OF_COMPUTORS - QUORUM; i < (NUMBER_OF_COMPUTORS - QUORUM) * 2; i++)
-                {
-                    int j = i;
-                    const m256i tmpPublicKey = competitorPublicKeys[j];
-                    const unsigned int tmpScore = competitorScores[j];
-                    const unsigned int tmpTick = competitorTicks[j];
-                    const bool tmpComputorStatus = false;
-                    while (j
-                        && ranksBelow(competitorScores[j - 1], competitorTicks[j - 1], competitorScores[j], competitorTicks[j]))
-                    {
-                        competitorPublicKeys[j] = competitorPublicKeys[j - 1];
-                        competitorScores[j] = competitorScores[j - 1];
-                        competitorTicks[j] = competitorTicks[j - 1];
-                        competitorComputorStatuses[j] = competitorComputorStatuses[j - 1];
-                        competitorPublicKeys[--j] = tmpPublicKey;
-                        competitorScores[j] = tmpScore;
-                        competitorTicks[j] = tmpTick;
-                        competitorComputorStatuses[j] = tmpComputorStatus;
-                    }
-                }
-
-                minimumComputorScore = competitorScores[NUMBER_OF_COMPUTORS - QUORUM - 1];
-
-                unsigned char candidateCounter = 0;
-                for (unsigned int i = 0; i < (NUMBER_OF_COMPUTORS - QUORUM) * 2; i++)
-                {
-                    if (!competitorComputorStatuses[i])
-                    {
-                        minimumCandidateScore = competitorScores[i];
-                        candidateCounter++;
-                    }
-                }
-                if (candidateCounter < NUMBER_OF_COMPUTORS - QUORUM)
-                {
-                    minimumCandidateScore = minimumComputorScore;
-                }
-
-                ACQUIRE(minerScoreArrayLock);
-                for (unsigned int i = 0; i < QUORUM; i++)
-                {
-                    system.futureComputors[i] = minerPublicKeys[i];
-                }
-                RELEASE(minerScoreArrayLock);
-
-                for (unsigned int i = QUORUM; i < NUMBER_OF_COMPUTORS; i++)
-                {
-                    system.futureComputors[i] = competitorPublicKeys[i - QUORUM];
-                }
-            }
-        }        
-    }
-    else
-    {
-        for (unsigned int i = 0; i < computorSeedsCount; i++)
-        {
-            if (transaction->sourcePublicKey == computorPublicKeys[i])
-            {
-                ACQUIRE(solutionsLock);
-
-                unsigned int j;
-                for (j = 0; j < system.numberOfSolutions; j++)
-                {
-                    if (transaction->nonce == system.solutions[j].nonce
-                        && transaction->miningSeed == system.solutions[j].miningSeed
-                        && transaction->sourcePublicKey == system.solutions[j].computorPublicKey)
-                    {
-                        solutionPublicationTicks[j] = SOLUTION_RECORDED_FLAG;
-
-                        break;
-                    }
-                }
-                if (j == system.numberOfSolutions
-                    && system.numberOfSolutions < MAX_NUMBER_OF_SOLUTIONS)
-                {
-                    system.solutions[system.numberOfSolutions].computorPublicKey = transaction->sourcePublicKey;
-                    system.solutions[system.numberOfSolutions].miningSeed = transaction->miningSeed;
-                    system.solutions[system.numberOfSolutions].nonce = transaction->nonce;
-                    system.solutions[system.numberOfSolutions].score = transaction->score;
-                    solutionPublicationTicks[system.numberOfSolutions++] = SOLUTION_RECORDED_FLAG;
-                }
-
-                RELEASE(solutionsLock);
-
-                break;
-            }
-        }
-    }
-}
-
-static void processTickTransaction(const Transaction* transaction, unsigned int transactionIndex, unsigned long long processorNumber)
-{
-    PROFILE_SCOPE();
-
-    ASSERT(nextTickData.epoch == system.epoch);
-    ASSERT(transaction != nullptr);
-    ASSERT(transaction->checkValidity());
-    ASSERT(transaction->tick == system.tick);
-
-    const m256i& transactionDigest = nextTickData.transactionDigests[transactionIndex];
-    const m256i& dataLock = nextTickData.timelock;
-
-    // Reject transactions whose source is a smart-contract address ({contractIndex, 0, 0, 0}).
-    // No legitimate keypair maps to such an address, so it can never be a real signer. Some of
-    // these addresses are even low-order FourQ points whose signatures are forgeable (e.g. the
-    // QX contract address {1,0,0,0} is the identity point), which would let an attacker move
-    // funds "from" a contract. Never process such a transaction.
-    if (isPublicKeyOfContract(transaction->sourcePublicKey))
-    {
-        return;
-    }
-
-    // Record the tx with digest
-    ts.transactionsDigestAccess.acquireLock();
-    ts.transactionsDigestAccess.insertTransaction(transactionDigest, transaction);
-    ts.transactionsDigestAccess.releaseLock();
-
-#if !defined(NDEBUG)
-    if (isZero(transaction->destinationPublicKey))
-    {
-        CHAR16 dbgMsg[200];
-        /*
-        if (transaction->inputType == OracleReplyCommitTransactionPrefix::transactionType())
-        {
-            setText(dbgMsg, L"OracleReplyCommitTransaction found in processTickTransaction(), tick ");
-            appendNumber(dbgMsg, system.tick, FALSE);
-            addDebugMessage(dbgMsg);
-        }
-        */
-        if (transaction->inputType == OracleReplyRevealTransactionPrefix::transactionType())
-        {
-            setText(dbgMsg, L"OracleReplyRevealTransaction found in processTickTransaction(), tick ");
-            appendNumber(dbgMsg, system.tick, FALSE);
-            addDebugMessage(dbgMsg);
-        }
-    }
-#endif
-
-    const int spectrumIndex = ::spectrumIndex(transaction->sourcePublicKey);
-    if (spectrumIndex >= 0)
-    {
-        numberOfTransactions++;
-        bool moneyFlew = false;
-#if ADDON_TX_STATUS_REQUEST
-        txStatusData.tickTxIndexStart[system.tick - system.initialTick + 1] = numberOfTransactions; // qli: part of tx_status_request add-on
-#endif
-        if (decreaseEnergy(spectrumIndex, transaction->amount))
-        {
-            increaseEnergy(transaction->destinationPublicKey, transaction->amount);
-            {
-                const QuTransfer quTransfer = { transaction->sourcePublicKey , transaction->destinationPublicKey , transaction->amount };
-                logger.logQuTransfer(quTransfer);
-            }
-            if (transaction->amount)
-            {
-                moneyFlew = true;
-            }
-
-            if (isZero(transaction->destinationPublicKey))
-            {
-                // Destination is system
-                switch (transaction->inputType)
-                {
-                case VOTE_COUNTER_INPUT_TYPE:
-                {
-                    voteCounter.processTransactionData(transaction, dataLock);
-                }
-                break;
-
-                case FileHeaderTransaction::transactionType():
-                {
-                    if (transaction->amount >= FileFragmentTransactionPrefix::minAmount()
-                        && transaction->inputSize >= FileFragmentTransactionPrefix::minInputSize())
-                    {
-                        // Do nothing
-                    }
-                }
-                break;
-
-                case FileFragmentTransactionPrefix::transactionType():
-                {
-                    if (transaction->amount >= FileFragmentTransactionPrefix::minAmount()
-                        && transaction->inputSize >= FileFragmentTransactionPrefix::minInputSize())
-                    {
-                        // Do nothing
-                    }
-                }
-                break;
-
-                case FileTrailerTransaction::transactionType():
-                {
-                    if (transaction->amount >= FileFragmentTransactionPrefix::minAmount()
-                        && transaction->inputSize >= FileFragmentTransactionPrefix::minInputSize())
-                    {
-                        // Do nothing
-                    }
-                }
-                break;
-
-                case MiningSolutionTransaction::transactionType():
-                {
-                    if (transaction->amount >= MiningSolutionTransaction::minAmount()
-                        && transaction->inputSize >= MiningSolutionTransaction::minInputSize())
-                    {
-                        processTickTransactionSolution((MiningSolutionTransaction*)transaction, processorNumber);
-                    }
-                }
-                break;
-
-                case OracleReplyCommitTransactionPrefix::transactionType():
-                {
-                    oracleEngine.processOracleReplyCommitTransaction((OracleReplyCommitTransactionPrefix*)transaction);
-                }
-                break;
-
-                case OracleReplyRevealTransactionPrefix::transactionType():
-                {
-                    oracleEngine.processOracleReplyRevealTransaction((OracleReplyRevealTransactionPrefix*)transaction, transactionIndex);
-                }
-                break;
-
-                case OcAuthSignatureTransactionPrefix::transactionType():
-                {
-                    ocEngine.processOcAuthSignatureTransaction((OcAuthSignatureTransactionPrefix*)transaction);
-                }
-                break;
-
-                case OracleUserQueryTransactionPrefix::transactionType():
-                {
-                    // check for special cases
-                    const auto* queryTx = (const OracleUserQueryTransactionPrefix*)transaction;
-                    bool forceZeroFee = false;
-                    if (queryTx->oracleInterfaceIndex == OI::DogeShareValidation::oracleInterfaceIndex)
-                    {
-                        // doge share validation query does not cost fees for computors
-                        forceZeroFee = computorIndex(queryTx->sourcePublicKey) >= 0;
-                    }
-
-                    // start user query
-                    int64_t queryId = oracleEngine.startUserQuery(queryTx, transactionIndex, forceZeroFee);
-                    const bool error = queryId < 0;
-
-                    if (queryTx->oracleInterfaceIndex == OI::DogeShareValidation::oracleInterfaceIndex)
-                    {
-                        if (error)
-                        {
-                            // The query was included in the tick but could not be started, not necessary to try again.
-                            customQubicMiningStorage.removeOracleQuery((const OracleUserQueryTransactionPrefix*)transaction);
-                        }
-                        else
-                        {
-                            customQubicMiningStorage.markOracleQueryStarted((const OracleUserQueryTransactionPrefix*)transaction, queryId);
-                        }
-                    }
-
-                    if (error && transaction->amount)
-                    {
-                        oracleEngine.refundFees(transaction->sourcePublicKey, transaction->amount);
-                        moneyFlew = false;
-                    }
-                }
-                break;
-
-                case DogeMiningShareTransaction::transactionType():
-                {
-                    gDogeMiningSharesCounter.processTransactionData(transaction, dataLock);
-                }
-                break;
-
-                case EXECUTION_FEE_REPORT_INPUT_TYPE:
-                {
-                    executionFeeReportCollector.processTransactionData(transaction, dataLock);
-                }
-                break;
-
-                }
-            }
-            else
-            {
-                // Destination is a contract or any other entity.
-                // Contracts are identified by their index stored in the first 64 bits of the id, all
-                // other bits are zeroed. However, the max number of contracts is limited to 2^32 - 1,
-                // only 32 bits are used for the contract index.
-                if (isPublicKeyOfContract(transaction->destinationPublicKey))
-                {
-                    unsigned int contractIndex = (unsigned int)transaction->destinationPublicKey.m256i_u64[0];
-                    // Contract transactions
-                    if (system.epoch == (contractDescriptions[contractIndex].constructionEpoch - 1))
-                    {
-                        // IPO
-                        if (!transaction->amount
-                            && transaction->inputSize == sizeof(ContractIPOBid))
-                        {
-                            processTickTransactionContractIPO(transaction, spectrumIndex, contractIndex);
-                        }
-                    }
-                    else if (system.epoch >= contractDescriptions[contractIndex].constructionEpoch
-                        && system.epoch < contractDescriptions[contractIndex].destructionEpoch)
-                    {
-                        // Check if contract has sufficient execution fee reserve and is not in an error state
-                        if (getContractFeeReserve(contractIndex) <= 0 || contractError[contractIndex] != NoContractError)
-                        {
-                            // Contract has insufficient execution fees or is in error state - refund transaction amount
-                            if (transaction->amount > 0)
-                            {
-                                int destIndex = ::spectrumIndex(transaction->destinationPublicKey);
-                                if (destIndex >= 0)
-                                {
-                                    decreaseEnergy(destIndex, transaction->amount);
-                                    increaseEnergy(transaction->sourcePublicKey, transaction->amount);
-
-                                    const QuTransfer quTransfer = { transaction->destinationPublicKey, transaction->sourcePublicKey, transaction->amount };
-                                    logger.logQuTransfer(quTransfer);
-                                }
-                            }
-                            moneyFlew = false;
-                        }
-                        else
-                        {
-                            // Regular contract procedure invocation
-                            moneyFlew = processTickTransactionContractProcedure(transaction, spectrumIndex, contractIndex);
-                        }
-                    }
-                }
-            }
-        }
-
-#if ADDON_TX_STATUS_REQUEST
-        saveConfirmedTx(numberOfTransactions - 1, moneyFlew, system.tick, transactionDigest); // qli: save tx
-#endif
-    }
-}
-
-static void makeAndBroadcastTickVotesTransaction(int i, BroadcastFutureTickData& td, int txSlot)
-{
-    PROFILE_NAMED_SCOPE("processTick(): broadcast vote counter tx");
-    ASSERT(txSlot < NUMBER_OF_TRANSACTIONS_PER_TICK);
-    auto& payload = voteCounterPayload; // note: not thread-safe
-    payload.transaction.sourcePublicKey = computorPublicKeys[ownComputorIndicesMapping[i]];
-    payload.transaction.destinationPublicKey = m256i::zero();
-    payload.transaction.amount = 0;
-    payload.transaction.tick = system.tick + TICK_VOTE_COUNTER_PUBLICATION_OFFSET;
-    payload.transaction.inputType = VOTE_COUNTER_INPUT_TYPE;
-    payload.transaction.inputSize = sizeof(payload.data) + sizeof(payload.dataLock);
-    voteCounter.compressNewVotesPacket(system.tick - 675, system.tick + 1, ownComputorIndices[i], payload.data);
-    payload.dataLock = td.tickData.timelock;
-    unsigned char digest[32];
-    KangarooTwelve(&payload.transaction, sizeof(payload.transaction) + sizeof(payload.data) + sizeof(payload.dataLock), digest, sizeof(digest));
-    sign(computorSubseeds[ownComputorIndicesMapping[i]].m256i_u8, computorPublicKeys[ownComputorIndicesMapping[i]].m256i_u8, digest, payload.signature);
-    enqueueResponse(NULL, sizeof(payload), BROADCAST_TRANSACTION, 0, &payload);
-
-    // copy the content of this vote packet to local memory
-    unsigned int tickIndex = ts.tickToIndexCurrentEpoch(td.tickData.tick);
-    unsigned int transactionSize = sizeof(voteCounterPayload);
-    KangarooTwelve(&payload, transactionSize, digest, sizeof(digest));
-    auto* tsReqTickTransactionOffsets = ts.tickTransactionOffsets.getByTickIndex(tickIndex);
-    if (txSlot < NUMBER_OF_TRANSACTIONS_PER_TICK) // valid slot
-    {
-        // TODO: refactor function add transaction to txStorage
-        ts.tickTransactions.acquireLock();
-        if (!tsReqTickTransactionOffsets[txSlot]) // not yet have value
-        {
-            if (ts.nextTickTransactionOffset + transactionSize <= ts.tickTransactions.storageSpaceCurrentEpoch) //have enough space
-            {
-                td.tickData.transactionDigests[txSlot] = m256i(digest);
-                tsReqTickTransactionOffsets[txSlot] = ts.nextTickTransactionOffset;
-                copyMem(ts.tickTransactions(ts.nextTickTransactionOffset), &payload, transactionSize);
-                ts.nextTickTransactionOffset += transactionSize;
-            }
-        }
-        ts.tickTransactions.releaseLock();
-    }
-}
-
-// Generic mining share broadcast helper.
-// Takes the broadcast buffer + counter by reference so it can be reused for
-// any CustomMiningSharesCounter-based pipeline (DOGE today; future mining types tomorrow).
-static bool makeAndBroadcastCustomMiningTransaction(
-    BroadcastCustomMiningTransaction* broadcastTxBuffer,
-    CustomMiningSharesCounter& sharesCounter,
-    int i,
-    BroadcastFutureTickData& td,
-    int txSlot)
-{
-    if (!broadcastTxBuffer[i].isBroadcasted)
-    {
-        broadcastTxBuffer[i].isBroadcasted = true;
-        auto& payload = broadcastTxBuffer[i].payload;
-        if (sharesCounter.isEmptyPacket(payload.packedScore) == false)
-        {
-            payload.transaction.tick = system.tick + TICK_TRANSACTIONS_PUBLICATION_OFFSET;
-            payload.dataLock = td.tickData.timelock;
-            unsigned char digest[32];
-            KangarooTwelve(&payload.transaction, sizeof(payload.transaction) + sizeof(payload.packedScore) + sizeof(payload.dataLock), digest, sizeof(digest));
-            sign(computorSubseeds[ownComputorIndicesMapping[i]].m256i_u8, computorPublicKeys[ownComputorIndicesMapping[i]].m256i_u8, digest, payload.signature);
-            enqueueResponse(NULL, sizeof(payload), BROADCAST_TRANSACTION, 0, &payload);
-
-            unsigned int tickIndex = ts.tickToIndexCurrentEpoch(td.tickData.tick);
-            unsigned int transactionSize = sizeof(payload);
-            KangarooTwelve(&payload, transactionSize, digest, sizeof(digest));
-            auto* tsReqTickTransactionOffsets = ts.tickTransactionOffsets.getByTickIndex(tickIndex);
-            if (txSlot < NUMBER_OF_TRANSACTIONS_PER_TICK)
-            {
-                ts.tickTransactions.acquireLock();
-                if (!tsReqTickTransactionOffsets[txSlot])
+                ts.tickTransactions.acquireLock();
+                if (!tsReqTickTransactionOffsets[txSlot])
                 {
                     if (ts.nextTickTransactionOffset + transactionSize <= ts.tickTransactions.storageSpaceCurrentEpoch)
                     {
@@ -3142,6 +2594,7 @@ static void processTick(unsigned long long processorNumber)
         getUniverseDigest(etalonTick.prevUniverseDigest);
         getComputerDigest(etalonTick.prevComputerDigest);
         etalonTick.prevTransactionBodyDigest = etalonTick.saltedTransactionBodyDigest;
+        ++etalonTickVersion;
     }
     else if (system.tick == system.initialTick) // the first tick of an epoch
     {
@@ -3161,6 +2614,7 @@ static void processTick(unsigned long long processorNumber)
             getUniverseDigest(etalonTick.prevUniverseDigest);
             getComputerDigest(etalonTick.prevComputerDigest);
             etalonTick.prevTransactionBodyDigest = 0;
+            ++etalonTickVersion;
         }
 #endif
     }
@@ -3356,6 +2810,7 @@ static void processTick(unsigned long long processorNumber)
                 gEpochRevenueData.perTickContractTxCount[tickOffset] = (unsigned short)nContractTx;
                 gEpochRevenueData.perTickOtherTxCount[tickOffset] = (unsigned short)nOtherTx;
 
+                revenueV2OnTick(gEpochRevenueData, system.initialTick, tickOffset);
                 revenueOnTick(tickOffset, gTxObservation);
             }
         }
@@ -3554,42 +3009,21 @@ static void processTick(unsigned long long processorNumber)
     WAIT_WHILE(contractProcessorState);
     PROFILE_SCOPE_END();
 
+    // Burn dust if spectrum is filled to 75% (at the same point of the tick on all nodes, before the digest)
+    PROFILE_NAMED_SCOPE_BEGIN("processTick(): anti-dust");
+    runAntiDustIfNeeded();
+    PROFILE_SCOPE_END();
+
     PROFILE_NAMED_SCOPE_BEGIN("processTick(): get spectrum digest");
-    unsigned int digestIndex;
     ACQUIRE(spectrumLock);
-    for (digestIndex = 0; digestIndex < SPECTRUM_CAPACITY; digestIndex++)
-    {
-        if (spectrum[digestIndex].latestIncomingTransferTick == system.tick || spectrum[digestIndex].latestOutgoingTransferTick == system.tick)
-        {
-            KangarooTwelve64To32(&spectrum[digestIndex], &spectrumDigests[digestIndex]);
-            spectrumChangeFlags[digestIndex >> 6] |= (1ULL << (digestIndex & 63));
-        }
-    }
-    unsigned int previousLevelBeginning = 0;
-    unsigned int numberOfLeafs = SPECTRUM_CAPACITY;
-    while (numberOfLeafs > 1)
-    {
-        for (unsigned int i = 0; i < numberOfLeafs; i += 2)
-        {
-            if (spectrumChangeFlags[i >> 6] & (3ULL << (i & 63)))
-            {
-                KangarooTwelve64To32(&spectrumDigests[previousLevelBeginning + i], &spectrumDigests[digestIndex]);
-                spectrumChangeFlags[i >> 6] &= ~(3ULL << (i & 63));
-                spectrumChangeFlags[i >> 7] |= (1ULL << ((i >> 1) & 63));
-            }
-            digestIndex++;
-        }
-        previousLevelBeginning += numberOfLeafs;
-        numberOfLeafs >>= 1;
-    }
-    spectrumChangeFlags[0] = 0;
-
+    updateSpectrumDigests(system.tick);
     etalonTick.saltedSpectrumDigest = spectrumDigests[(SPECTRUM_CAPACITY * 2 - 1) - 1];
     RELEASE(spectrumLock);
     PROFILE_SCOPE_END();
 
     getUniverseDigest(etalonTick.saltedUniverseDigest);
     getComputerDigest(etalonTick.saltedComputerDigest);
+    ++etalonTickVersion;
 
 #if !defined(NDEBUG) && 1
     {
@@ -3982,11 +3416,14 @@ static void processTick(unsigned long long processorNumber)
     {
         addDebugMessage(L"BUG DETECTED: Spectrum info of continuous updating is inconsistent with counting from scratch!");
     }
+    if (!checkSpectrumBalances())
+    {
+        addDebugMessage(L"BUG DETECTED: Spectrum balance column is inconsistent with spectrum!");
+    }
 #endif
 
-    // Update entity category populations and dust thresholds each 8 ticks
-    if ((system.tick & 7) == 0)
-        updateAndAnalzeEntityCategoryPopulations();
+    // Update entity category populations and dust thresholds (cheap enough for every tick with the balance column)
+    updateAndAnalzeEntityCategoryPopulations();
     logger.updateTick(system.tick);
 }
 
@@ -4024,11 +3461,18 @@ static void beginEpoch()
     ts.checkStateConsistencyWithAssert();
     pendingTxsPool.checkStateConsistencyWithAssert();
 #endif
-    ts.beginEpoch(system.initialTick);
+    if (!epochTransitionTickStorageReady)
+    {
+        ts.beginEpoch(system.initialTick);
+    }
+    epochTransitionTickStorageReady = false;
     pendingTxsPool.beginEpoch(system.initialTick);
     oracleEngine.beginEpoch();
     ocEngine.beginEpoch();
     voteCounter.init();
+    tickVoteTally.reset();
+    quorumTickCache.reset();
+    votesCountCache.valid = false;
 #ifndef NDEBUG
     ts.checkStateConsistencyWithAssert();
     pendingTxsPool.checkStateConsistencyWithAssert();
@@ -4074,15 +3518,7 @@ static void beginEpoch()
     minimumComputorScore = NO_MINER_SCORE;
     minimumCandidateScore = NO_MINER_SCORE;
 
-    if (system.epoch < MAX_NUMBER_EPOCH && !score_engine::checkAlgoThreshold(solutionThreshold[system.epoch][score_engine::AlgoType::Bpp9000], score_engine::AlgoType::Bpp9000))
-    {
-        solutionThreshold[system.epoch][score_engine::AlgoType::Bpp9000] = BPP9000_SOLUTION_THRESHOLD_DEFAULT;
-    }
-    // Neuraxon slot is reserved (not minable); keep its threshold slot at the placeholder default.
-    if (system.epoch < MAX_NUMBER_EPOCH)
-    {
-        solutionThreshold[system.epoch][score_engine::AlgoType::Neuraxon] = NEURAXON_SOLUTION_THRESHOLD_DEFAULT;
-    }
+    initEpochSolutionThresholds();
 
     system.latestOperatorNonce = 0;
     system.numberOfSolutions = 0;
@@ -4094,6 +3530,7 @@ static void beginEpoch()
     setMem(&gMultiDimRevenue, sizeof(gMultiDimRevenue), 0);
     // interior ticks finalized in revenueOnTick() depend on initialTick being correct all epoch.
     gMultiDimRevenue.initialTick = system.initialTick;
+    gRevenueV2Stream.reset(system.initialTick);
 
     // Reset resource testing digest at beginning of the epoch
     // there are many global variables that were init at declaration, may need to re-check all of them again
@@ -4109,24 +3546,103 @@ static void beginEpoch()
 }
 
 
+// Stages of endEpoch() that run concurrently on tick processor and parked request processors (see epochTransitionStages)
+static void epochTransitionUniverseDigestStage()
+{
+    getUniverseDigest(etalonTick.prevUniverseDigest);
+}
+
+static void epochTransitionComputerDigestStage()
+{
+    getComputerDigest(etalonTick.prevComputerDigest);
+}
+
+static void epochTransitionRevenueStage()
+{
+    computeRevenueV2(gEpochRevenueData, gRevenueV2Stream);
+
+    // Multi-dimension revenue: computed for offline comparison; paid to computors
+    // only when USE_REVENUE_MULTI_DIMENSION is set (see src/revenue.h).
+    computeMultiDimRevenue();
+}
+
+static void epochTransitionSpectrumReorgStage()
+{
+    // Reorganize spectrum hash map (also updates spectrumInfo)
+    ACQUIRE(spectrumLock);
+    reorganizeSpectrum();
+    RELEASE(spectrumLock);
+}
+
+static void epochTransitionUniverseReorgStage()
+{
+    assetsEndEpoch();
+}
+
+static void epochTransitionTickStorageStage()
+{
+    // system.tick becomes system.initialTick of the new epoch
+    ts.beginEpoch(system.tick);
+    epochTransitionTickStorageReady = true;
+}
+
+// Collect the input data of the revenue computation
+static void prepareRevenueComputation()
+{
+    // Collect mining scores for V2
+    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+    {
+        gEpochRevenueData.dogeMiningScore[i] = gDogeMiningSharesCounter.getSharesCount(i);
+    }
+
+    // Per-tick TX counts already recorded during processTick()
+    gEpochRevenueData.initialTick = system.initialTick;
+    gEpochRevenueData.totalTicks = system.tick - system.initialTick;
+
+    // Fetch oracle revenue points (accumulated during epoch, reset at beginEpoch)
+    {
+        OracleRevenuePoints oracleRevPoints;
+        oracleEngine.getRevenuePoints(oracleRevPoints);
+        copyMemory(gEpochRevenueData.oracleScore, oracleRevPoints.computorRevPoints);
+    }
+
+    gMultiDimRevenue.totalTicks = system.tick - system.initialTick;
+}
+
 // called by tickProcessor() after system.tick has been incremented
 static void endEpoch()
 {
+    unsigned long long stageStartTick = __rdtsc();
     logger.registerNewTx(system.tick, logger.SC_END_EPOCH_TX);
     contractProcessorPhase = END_EPOCH;
     contractProcessorState = 1;
     WAIT_WHILE(contractProcessorState);
+    epochTransitionStages.setStageTicks(EPOCH_TRANSITION_END_EPOCH_PROCEDURES, __rdtsc() - stageStartTick);
 
     // treating endEpoch as a tick, start updating etalonTick:
     // this is the last tick of an epoch, should we set prevResourceTestingDigest to zero? nodes that start from scratch (for the new epoch)
     // would be unable to compute this value(!?)
     etalonTick.prevResourceTestingDigest = resourceTestingDigest;
     etalonTick.prevSpectrumDigest = spectrumDigests[(SPECTRUM_CAPACITY * 2 - 1) - 1];
-    getUniverseDigest(etalonTick.prevUniverseDigest);
-    getComputerDigest(etalonTick.prevComputerDigest);
     etalonTick.prevTransactionBodyDigest = etalonTick.saltedTransactionBodyDigest;
 
+    // Digests of universe and contract states don't depend on each other and the revenue computation only reads
+    // the data collected during the epoch, so run them concurrently. The revenue is computed in advance if qus are
+    // going to be issued (checked again below, because finishIPOs() changes the total amount).
+    epochTransitionStages.add(EPOCH_TRANSITION_UNIVERSE_DIGEST, epochTransitionUniverseDigestStage);
+    epochTransitionStages.add(EPOCH_TRANSITION_COMPUTER_DIGEST, epochTransitionComputerDigestStage);
+    bool revenueComputed = false;
+    if (spectrumInfo.totalAmount + ISSUANCE_RATE <= MAX_SUPPLY)
+    {
+        prepareRevenueComputation();
+        epochTransitionStages.add(EPOCH_TRANSITION_REVENUE_COMPUTATION, epochTransitionRevenueStage);
+        revenueComputed = true;
+    }
+    epochTransitionStages.run();
+    ++etalonTickVersion;
+
     // Handle IPO
+    stageStartTick = __rdtsc();
     finishIPOs();
 
     system.initialMillisecond = etalonTick.millisecond;
@@ -4141,30 +3657,12 @@ static void endEpoch()
     // Only issue qus if the max supply is not yet reached
     if (spectrumInfo.totalAmount + ISSUANCE_RATE <= MAX_SUPPLY)
     {
-
-        // Collect mining scores for V2
-        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+        if (!revenueComputed)
         {
-            gEpochRevenueData.dogeMiningScore[i] = gDogeMiningSharesCounter.getSharesCount(i);
+            prepareRevenueComputation();
+            epochTransitionRevenueStage();
         }
 
-        // Per-tick TX counts already recorded during processTick()
-        gEpochRevenueData.initialTick = system.initialTick;
-        gEpochRevenueData.totalTicks = system.tick - system.initialTick;
-
-        // Fetch oracle revenue points (accumulated during epoch, reset at beginEpoch)
-        {
-            OracleRevenuePoints oracleRevPoints;
-            oracleEngine.getRevenuePoints(oracleRevPoints);
-            copyMemory(gEpochRevenueData.oracleScore, oracleRevPoints.computorRevPoints);
-        }
-        computeRevenueV2(gEpochRevenueData);
-
-        // Multi-dimension revenue: computed for offline comparison; paid to computors
-        // only when USE_REVENUE_MULTI_DIMENSION is set (see src/revenue.h).
-        gMultiDimRevenue.totalTicks = system.tick - system.initialTick;
-        computeMultiDimRevenue();
-
         // Get revenue donation data by calling contract GQMPROP::GetRevenueDonation()
         QpiContextUserFunctionCall qpiContext(GQMPROP::__contract_index);
         qpiContext.call(5, "", 0);
@@ -4222,17 +3720,17 @@ static void endEpoch()
         const QuTransfer quTransfer = { m256i::zero(), arbitratorPublicKey, arbitratorRevenue };
         logger.logQuTransfer(quTransfer);
     }
+    epochTransitionStages.setStageTicks(EPOCH_TRANSITION_IPOS_AND_REVENUE_PAYOUT, __rdtsc() - stageStartTick);
 
-    // Reorganize spectrum hash map (also updates spectrumInfo)
-    {
-        ACQUIRE(spectrumLock);
-
-        reorganizeSpectrum();
-
-        RELEASE(spectrumLock);
-    }
+    // Spectrum, universe, and tick storage are independent of each other, so reorganize / reset them concurrently.
+    // Tick storage can only be prepared for the new epoch here if it isn't queried anymore before beginEpoch().
+    epochTransitionStages.add(EPOCH_TRANSITION_SPECTRUM_REORG, epochTransitionSpectrumReorgStage);
+    epochTransitionStages.add(EPOCH_TRANSITION_UNIVERSE_REORG, epochTransitionUniverseReorgStage);
+#if !PAUSE_BEFORE_CLEAR_MEMORY
+    epochTransitionStages.add(EPOCH_TRANSITION_TICK_STORAGE, epochTransitionTickStorageStage);
+#endif
+    epochTransitionStages.run();
 
-    assetsEndEpoch();
     {
         // this is the last logging event of the epoch
         // a hint message for 3rd party services the end of the epoch
@@ -4292,25 +3790,23 @@ static void initializeFirstTick()
             setMem(uniqueVoteCount, sizeof(uniqueVoteCount), 0);
             uniqueCount = 0;
 
-            const Tick* tsCompTicks = ts.ticks.getByTickIndex(firstTickIndex);
+            Tick tick, unique;
             for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
             {
                 ts.ticks.acquireLock(i);
-                const Tick* tick = &tsCompTicks[i];
-                if (tick->epoch == system.epoch)
+                if (ts.ticks.get(firstTickIndex, i, tick) && tick.epoch == system.epoch)
                 {
                     // compare tick with all ticks with unique digest+timestamp that we have found before
                     int unique_idx = -1;
                     for (int j = 0; j < uniqueCount; j++) {
                         ts.ticks.acquireLock(uniqueVoteIndex[j]);
-                        const Tick* unique = &tsCompTicks[uniqueVoteIndex[j]];
-                        if (haveSamePrevDigestsAndTime(*unique , *tick))
+                        const bool haveUnique = ts.ticks.get(firstTickIndex, uniqueVoteIndex[j], unique);
+                        ts.ticks.releaseLock(uniqueVoteIndex[j]);
+                        if (haveUnique && haveSamePrevDigestsAndTime(unique, tick))
                         {
                             unique_idx = j;
-                            ts.ticks.releaseLock(uniqueVoteIndex[j]);
                             break;
                         }
-                        ts.ticks.releaseLock(uniqueVoteIndex[j]);
                     }
 
                     if (unique_idx == -1)
@@ -4345,33 +3841,160 @@ static void initializeFirstTick()
                 
                 int numberOfVote = uniqueVoteCount[maxUniqueVoteCountIndex];
 
-                // accept the tick with most votes if it has more than 1/3 of quorum
-                if (numberOfVote >= NUMBER_OF_COMPUTORS - QUORUM)
-                {
-                    ts.ticks.acquireLock(uniqueVoteIndex[maxUniqueVoteCountIndex]);
-                    const Tick* unique = &tsCompTicks[uniqueVoteIndex[maxUniqueVoteCountIndex]];
-                    ts.ticks.releaseLock(uniqueVoteIndex[maxUniqueVoteCountIndex]);
-                    *((unsigned long long*) & etalonTick.millisecond) = *((unsigned long long*) & unique->millisecond);
-                    etalonTick.prevComputerDigest = unique->prevComputerDigest;
-                    etalonTick.prevResourceTestingDigest = unique->prevResourceTestingDigest;
-                    etalonTick.prevSpectrumDigest = unique->prevSpectrumDigest;
-                    etalonTick.prevUniverseDigest = unique->prevUniverseDigest;
-                    etalonTick.prevTransactionBodyDigest = unique->prevTransactionBodyDigest;
-                    return;
-                }
-            }
+                // accept the tick with most votes if it has more than 1/3 of quorum
+                if (numberOfVote >= NUMBER_OF_COMPUTORS - QUORUM)
+                {
+                    ts.ticks.acquireLock(uniqueVoteIndex[maxUniqueVoteCountIndex]);
+                    const bool haveUnique = ts.ticks.get(firstTickIndex, uniqueVoteIndex[maxUniqueVoteCountIndex], unique);
+                    ts.ticks.releaseLock(uniqueVoteIndex[maxUniqueVoteCountIndex]);
+                    if (haveUnique)
+                    {
+                        *((unsigned long long*) & etalonTick.millisecond) = *((unsigned long long*) & unique.millisecond);
+                        etalonTick.prevComputerDigest = unique.prevComputerDigest;
+                        etalonTick.prevResourceTestingDigest = unique.prevResourceTestingDigest;
+                        etalonTick.prevSpectrumDigest = unique.prevSpectrumDigest;
+                        etalonTick.prevUniverseDigest = unique.prevUniverseDigest;
+                        etalonTick.prevTransactionBodyDigest = unique.prevTransactionBodyDigest;
+                        ++etalonTickVersion;
+                        return;
+                    }
+                }
+            }
+        }
+        _mm_pause();
+    }
+}
+#endif
+
+#if TICK_STORAGE_AUTOSAVE_MODE
+
+// Invalid snapshot data
+static bool invalidateNodeStates(CHAR16* directory)
+{
+    return ts.saveInvalidateData(system.epoch, directory);
+}
+
+// Background saving of node states (only used by main thread): at the persisting barrier, spectrum, universe, and
+// contract states are copied to nodeStateShadowBuffer, so the tick processor can resume right after the barrier.
+// The main loop then writes the copies with incrementalFileWriter one chunk per iteration and finally writes the
+// tick storage metadata, which marks the snapshot as valid. Without shadow buffer, all is saved at the barrier.
+static unsigned char* nodeStateShadowBuffer = NULL;
+static unsigned long long nodeStateShadowBufferSize = 0;
+static unsigned int backgroundSaveNextFile = 0; // 0: inactive, 1: spectrum, 2: universe, 3 + i: contract i
+static unsigned long long backgroundSaveBufferOffset = 0;
+static unsigned long long backgroundSaveWrittenSize = 0;
+static unsigned long long backgroundSaveBeginningTick = 0;
+static CHAR16 backgroundSaveDirectory[16];
+
+// Allocate the optional shadow buffer (larger than 2 GiB). Call after all required buffers have been allocated, so it
+// only takes memory that is left over.
+static void allocateNodeStateShadowBuffer()
+{
+    nodeStateShadowBufferSize = SPECTRUM_CAPACITY * sizeof(EntityRecord) + ASSETS_CAPACITY * sizeof(AssetRecord);
+    for (unsigned int contractIndex = 0; contractIndex < contractCount; contractIndex++)
+    {
+        nodeStateShadowBufferSize += contractDescriptions[contractIndex].stateSize;
+    }
+    if (!allocatePool(nodeStateShadowBufferSize, (void**)&nodeStateShadowBuffer))
+    {
+        nodeStateShadowBuffer = NULL;
+        logToConsole(L"Not enough memory for saving node states in background, saving them at once.");
+    }
+}
+
+static bool isBackgroundNodeStateSaveActive()
+{
+    return backgroundSaveNextFile != 0;
+}
+
+// Process next step of background saving. Returns true if there is more work to do.
+static bool stepBackgroundNodeStateSave()
+{
+    if (!backgroundSaveNextFile)
+        return false;
+
+    if (incrementalFileWriter.isActive())
+    {
+        if (incrementalFileWriter.step())
+            return true;
+        if (incrementalFileWriter.hasFailed())
+        {
+            logToConsole(L"Failed to save node states in background");
+            backgroundSaveNextFile = 0;
+            return false;
         }
-        _mm_pause();
+        backgroundSaveWrittenSize += incrementalFileWriter.getWrittenSize();
+        return true;
     }
-}
-#endif
 
-#if TICK_STORAGE_AUTOSAVE_MODE
+    // Begin writing next file (file names are copied, because the global ones may be changed for other saves)
+    CHAR16 fileName[64];
+    unsigned long long size = 0;
+    if (backgroundSaveNextFile == 1)
+    {
+        setText(fileName, SPECTRUM_FILE_NAME);
+        size = SPECTRUM_CAPACITY * sizeof(EntityRecord);
+    }
+    else if (backgroundSaveNextFile == 2)
+    {
+        setText(fileName, UNIVERSE_FILE_NAME);
+        size = ASSETS_CAPACITY * sizeof(AssetRecord);
+    }
+    else if (backgroundSaveNextFile < 3 + contractCount)
+    {
+        const unsigned int contractIndex = backgroundSaveNextFile - 3;
+        setText(fileName, CONTRACT_FILE_NAME);
+        unsigned int len = getTextSize(fileName, 64);
+        fileName[len - 8] = contractIndex / 1000 + L'0';
+        fileName[len - 7] = (contractIndex % 1000) / 100 + L'0';
+        fileName[len - 6] = (contractIndex % 100) / 10 + L'0';
+        fileName[len - 5] = contractIndex % 10 + L'0';
+        size = contractDescriptions[contractIndex].stateSize;
+    }
+    else
+    {
+        backgroundSaveNextFile = 0;
+        if (!ts.saveMetaDataOfLastSave(backgroundSaveDirectory))
+        {
+            logToConsole(L"Failed to save tick storage metadata");
+            return false;
+        }
 
-// Invalid snapshot data
-static bool invalidateNodeStates(CHAR16* directory)
+        setNumber(message, backgroundSaveWrittenSize, TRUE);
+        appendText(message, L" bytes of node states are written in background (");
+        appendNumber(message, (__rdtsc() - backgroundSaveBeginningTick) * 1000000 / frequency, TRUE);
+        appendText(message, L" microseconds).");
+        logToConsole(message);
+        logToConsole(L"Complete saving all node states");
+        return false;
+    }
+
+    // Node state files are saved with epoch 000 in epoch directory
+    const unsigned int len = getTextSize(fileName, 64);
+    fileName[len - 3] = L'0';
+    fileName[len - 2] = L'0';
+    fileName[len - 1] = L'0';
+    if (!incrementalFileWriter.begin(fileName, size, nodeStateShadowBuffer + backgroundSaveBufferOffset, backgroundSaveDirectory))
+    {
+        logToConsole(L"Failed to save node states in background");
+        backgroundSaveNextFile = 0;
+        return false;
+    }
+    backgroundSaveBufferOffset += size;
+    ++backgroundSaveNextFile;
+    return true;
+}
+
+// Complete background saving at once (if active)
+static void finishBackgroundNodeStateSave()
 {
-    return ts.saveInvalidateData(system.epoch, directory);
+    if (isBackgroundNodeStateSaveActive())
+    {
+        logToConsole(L"Finishing background saving of node states ...");
+        while (stepBackgroundNodeStateSave())
+        {
+        }
+    }
 }
 
 // can only called from main thread
@@ -4383,6 +4006,9 @@ static bool saveAllNodeStates()
     forceLogToConsoleAsAddDebugMessage = true;
 #endif
 
+    // Previous snapshot must be complete before a new one is started
+    finishBackgroundNodeStateSave();
+
     CHAR16 directory[16];
     setText(directory, L"ep");
     appendNumber(directory, system.epoch, false);
@@ -4401,27 +4027,56 @@ static bool saveAllNodeStates()
     SPECTRUM_FILE_NAME[sizeof(SPECTRUM_FILE_NAME) / sizeof(SPECTRUM_FILE_NAME[0]) - 4] = L'0';
     SPECTRUM_FILE_NAME[sizeof(SPECTRUM_FILE_NAME) / sizeof(SPECTRUM_FILE_NAME[0]) - 3] = L'0';
     SPECTRUM_FILE_NAME[sizeof(SPECTRUM_FILE_NAME) / sizeof(SPECTRUM_FILE_NAME[0]) - 2] = L'0';
-    setText(message, L"Saving spectrum to ");
-    appendText(message, directory); appendText(message, L"/");
-    appendText(message, SPECTRUM_FILE_NAME);
-    logToConsole(message);
-    if (!saveSpectrum(SPECTRUM_FILE_NAME, directory))
+    if (nodeStateShadowBuffer)
     {
-        logToConsole(L"Failed to save spectrum");
-        return false;
+        // Copy states that are written to disk in background after the tick processor has resumed
+        logToConsole(L"Copying spectrum, universe, and contract states for saving in background");
+        backgroundSaveBeginningTick = __rdtsc();
+        unsigned long long offset = 0;
+        ACQUIRE(spectrumLock);
+        copyMem(nodeStateShadowBuffer + offset, spectrum, SPECTRUM_CAPACITY * sizeof(EntityRecord));
+        RELEASE(spectrumLock);
+        offset += SPECTRUM_CAPACITY * sizeof(EntityRecord);
+        ACQUIRE(universeLock);
+        copyMem(nodeStateShadowBuffer + offset, assets, ASSETS_CAPACITY * sizeof(AssetRecord));
+        RELEASE(universeLock);
+        offset += ASSETS_CAPACITY * sizeof(AssetRecord);
+        for (unsigned int contractIndex = 0; contractIndex < contractCount; contractIndex++)
+        {
+            contractStateLock[contractIndex].acquireRead();
+            copyMem(nodeStateShadowBuffer + offset, contractStates[contractIndex], contractDescriptions[contractIndex].stateSize);
+            contractStateLock[contractIndex].releaseRead();
+            offset += contractDescriptions[contractIndex].stateSize;
+        }
+        ASSERT(offset == nodeStateShadowBufferSize);
+    }
+    else
+    {
+        setText(message, L"Saving spectrum to ");
+        appendText(message, directory); appendText(message, L"/");
+        appendText(message, SPECTRUM_FILE_NAME);
+        logToConsole(message);
+        if (!saveSpectrum(SPECTRUM_FILE_NAME, directory, /*incremental=*/true))
+        {
+            logToConsole(L"Failed to save spectrum");
+            return false;
+        }
     }
 
     UNIVERSE_FILE_NAME[sizeof(UNIVERSE_FILE_NAME) / sizeof(UNIVERSE_FILE_NAME[0]) - 4] = L'0';
     UNIVERSE_FILE_NAME[sizeof(UNIVERSE_FILE_NAME) / sizeof(UNIVERSE_FILE_NAME[0]) - 3] = L'0';
     UNIVERSE_FILE_NAME[sizeof(UNIVERSE_FILE_NAME) / sizeof(UNIVERSE_FILE_NAME[0]) - 2] = L'0';
-    setText(message, L"Saving universe to ");
-    appendText(message, directory); appendText(message, L"/");
-    appendText(message, UNIVERSE_FILE_NAME);
-    logToConsole(message);
-    if (!saveUniverse(UNIVERSE_FILE_NAME, directory))
+    if (!nodeStateShadowBuffer)
     {
-        logToConsole(L"Failed to save universe");
-        return false;
+        setText(message, L"Saving universe to ");
+        appendText(message, directory); appendText(message, L"/");
+        appendText(message, UNIVERSE_FILE_NAME);
+        logToConsole(message);
+        if (!saveUniverse(UNIVERSE_FILE_NAME, directory, /*incremental=*/true))
+        {
+            logToConsole(L"Failed to save universe");
+            return false;
+        }
     }
     if (!saveSnapshotUniverseIndex(L"snapshotUniverseIndex", directory))
         return false;
@@ -4438,12 +4093,15 @@ static bool saveAllNodeStates()
     CONTRACT_EXEC_FEES_REC_FILE_NAME[sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME) / sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME[0]) - 3] = L'0';
     CONTRACT_EXEC_FEES_REC_FILE_NAME[sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME) / sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME[0]) - 2] = L'0';
 
-    setText(message, L"Saving computer files");
-    logToConsole(message);
-    if (!saveContractStateFiles(directory))
+    if (!nodeStateShadowBuffer)
     {
-        logToConsole(L"Failed to save contract state files");
-        return false;
+        setText(message, L"Saving computer files");
+        logToConsole(message);
+        if (!saveContractStateFiles(directory, /*incremental=*/true))
+        {
+            logToConsole(L"Failed to save contract state files");
+            return false;
+        }
     }
     if (!saveContractExecFeeFiles(directory, /*saveAccumulatedTime=*/true))
     {
@@ -4550,7 +4208,8 @@ static bool saveAllNodeStates()
 
     setText(message, L"Saving tick storage ");
     logToConsole(message);
-    if (ts.trySaveToFile(system.epoch, system.tick, directory) != 0)
+    // With background saving, the metadata marking the snapshot as valid is written after the other files
+    if (ts.trySaveToFile(system.epoch, system.tick, directory, /*saveMetaDataFile=*/!nodeStateShadowBuffer) != 0)
     {
         logToConsole(L"Failed to save tick storage");
         return false;
@@ -4580,6 +4239,14 @@ static bool saveAllNodeStates()
     logger.saveCurrentLoggingStates(directory);
 #endif
 
+    if (nodeStateShadowBuffer)
+    {
+        setText(backgroundSaveDirectory, directory);
+        backgroundSaveBufferOffset = 0;
+        backgroundSaveWrittenSize = 0;
+        backgroundSaveNextFile = 1;
+    }
+
 #if !defined(NDEBUG)
     forceLogToConsoleAsAddDebugMessage = false;
 #endif
@@ -4629,7 +4296,7 @@ static bool loadAllNodeStates()
     SPECTRUM_FILE_NAME[sizeof(SPECTRUM_FILE_NAME) / sizeof(SPECTRUM_FILE_NAME[0]) - 4] = L'0';
     SPECTRUM_FILE_NAME[sizeof(SPECTRUM_FILE_NAME) / sizeof(SPECTRUM_FILE_NAME[0]) - 3] = L'0';
     SPECTRUM_FILE_NAME[sizeof(SPECTRUM_FILE_NAME) / sizeof(SPECTRUM_FILE_NAME[0]) - 2] = L'0';
-    if (!loadSpectrum(SPECTRUM_FILE_NAME, directory))
+    if (!loadSpectrum(SPECTRUM_FILE_NAME, directory, /*incremental=*/true))
     {
         logToConsole(L"Failed to load spectrum");
         return false;
@@ -4640,7 +4307,7 @@ static bool loadAllNodeStates()
     UNIVERSE_FILE_NAME[sizeof(UNIVERSE_FILE_NAME) / sizeof(UNIVERSE_FILE_NAME[0]) - 4] = L'0';
     UNIVERSE_FILE_NAME[sizeof(UNIVERSE_FILE_NAME) / sizeof(UNIVERSE_FILE_NAME[0]) - 3] = L'0';
     UNIVERSE_FILE_NAME[sizeof(UNIVERSE_FILE_NAME) / sizeof(UNIVERSE_FILE_NAME[0]) - 2] = L'0';
-    if (!loadUniverse(UNIVERSE_FILE_NAME, directory, /*rebuildIndexLists=*/false))
+    if (!loadUniverse(UNIVERSE_FILE_NAME, directory, /*rebuildIndexLists=*/false, /*incremental=*/true))
     {
         logToConsole(L"Failed to load universe");
         return false;
@@ -4652,7 +4319,7 @@ static bool loadAllNodeStates()
     CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 3] = L'0';
     CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 2] = L'0';
 
-    if (!loadContractStateFiles(directory, /*forceLoadFromFile=*/true))
+    if (!loadContractStateFiles(directory, /*forceLoadFromFile=*/true, /*incremental=*/true))
     {
         logToConsole(L"Failed to load contract state files");
         return false;
@@ -4680,6 +4347,7 @@ static bool loadAllNodeStates()
         return false;
     }
     copyMem(&etalonTick, &nodeStateBuffer.etalonTick, sizeof(etalonTick));
+    ++etalonTickVersion;
     copyMem((void*)minerPublicKeys, nodeStateBuffer.minerPublicKeys, sizeof(minerPublicKeys));
     copyMem((void*)minerScores, nodeStateBuffer.minerScores, sizeof(minerScores));
     copyMem((void*)minerBestScoreTicks, nodeStateBuffer.minerBestScoreTicks, sizeof(minerBestScoreTicks));
@@ -4850,76 +4518,25 @@ static bool loadAllNodeStates()
 static void updateFutureTickCount()
 {
     const unsigned int nextTick = system.tick + 1;
-    const unsigned int nextTickIndex = ts.tickToIndexCurrentEpoch(nextTick);
-    const Tick* tsCompTicks = ts.ticks.getByTickIndex(nextTickIndex);
-    unsigned int futureTickTotalNumberOfComputors = 0;
-    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
-    {
-        if (tsCompTicks[i].epoch == system.epoch)
-        {
-            futureTickTotalNumberOfComputors++;
-        }
-    }
-    gFutureTickTotalNumberOfComputors = futureTickTotalNumberOfComputors;
+    TickVoteTally::Summary summary;
+    tickVoteTally.getSummary(nextTick, system.epoch, ts.ticks.getByTickInCurrentEpoch(nextTick), summary);
+    gFutureTickTotalNumberOfComputors = summary.numberOfVotes;
 }
 
-// find next tick data digest from next tick votes
-// Scan all tick votes of the next tick (system.tick + 1):
-// if there are 451+ (QUORUM) votes agree on the same transactionDigest - or 226+ (VETO) votes agree on empty tick
-// then next tick digest is known (from the point of view of the node) - targetNextTickDataDigest
-static void findNextTickDataDigestFromNextTickVotes()
+// Set targetNextTickDataDigest if the votes for the next tick data digest are decisive:
+// if there are 451+ (QUORUM) votes agree on the same digest - or 226+ (VETO) votes agree on empty tick
+// (or no digest can reach QUORUM anymore), then next tick digest is known (from the point of view of the node)
+static void findNextTickDataDigestFromSummary(unsigned int numberOfVotes, const TickVoteTally::DigestSummary& digestSummary)
 {
-    const unsigned int nextTick = system.tick + 1;
-    const unsigned int nextTickIndex = ts.tickToIndexCurrentEpoch(nextTick);
-    const Tick* tsCompTicks = ts.ticks.getByTickIndex(nextTickIndex);
-    unsigned int numberOfEmptyNextTickTransactionDigest = 0;
-    unsigned int numberOfUniqueNextTickTransactionDigests = 0;
-    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
-    {
-        if (tsCompTicks[i].epoch == system.epoch)
-        {
-            unsigned int j;
-            for (j = 0; j < numberOfUniqueNextTickTransactionDigests; j++)
-            {
-                if (tsCompTicks[i].transactionDigest == uniqueNextTickTransactionDigests[j])
-                {
-                    break;
-                }
-            }
-            if (j == numberOfUniqueNextTickTransactionDigests)
-            {
-                uniqueNextTickTransactionDigests[numberOfUniqueNextTickTransactionDigests] = tsCompTicks[i].transactionDigest;
-                uniqueNextTickTransactionDigestCounters[numberOfUniqueNextTickTransactionDigests++] = 1;
-            }
-            else
-            {
-                uniqueNextTickTransactionDigestCounters[j]++;
-            }
-
-            if (isZero(tsCompTicks[i].transactionDigest))
-            {
-                numberOfEmptyNextTickTransactionDigest++;
-            }
-        }
-    }
-    unsigned int mostPopularUniqueNextTickTransactionDigestIndex = 0, totalUniqueNextTickTransactionDigestCounter = uniqueNextTickTransactionDigestCounters[0];
-    for (unsigned int i = 1; i < numberOfUniqueNextTickTransactionDigests; i++)
-    {
-        if (uniqueNextTickTransactionDigestCounters[i] > uniqueNextTickTransactionDigestCounters[mostPopularUniqueNextTickTransactionDigestIndex])
-        {
-            mostPopularUniqueNextTickTransactionDigestIndex = i;
-        }
-        totalUniqueNextTickTransactionDigestCounter += uniqueNextTickTransactionDigestCounters[i];
-    }
-    if (uniqueNextTickTransactionDigestCounters[mostPopularUniqueNextTickTransactionDigestIndex] >= QUORUM)
+    if (digestSummary.mostPopularCount >= QUORUM)
     {
-        targetNextTickDataDigest = uniqueNextTickTransactionDigests[mostPopularUniqueNextTickTransactionDigestIndex];
+        targetNextTickDataDigest = digestSummary.mostPopularDigest;
         targetNextTickDataDigestIsKnown = true;
     }
     else
     {
-        if (numberOfEmptyNextTickTransactionDigest > NUMBER_OF_COMPUTORS - QUORUM
-            || uniqueNextTickTransactionDigestCounters[mostPopularUniqueNextTickTransactionDigestIndex] + (NUMBER_OF_COMPUTORS - totalUniqueNextTickTransactionDigestCounter) < QUORUM)
+        if (digestSummary.numberOfEmptyDigests > NUMBER_OF_COMPUTORS - QUORUM
+            || digestSummary.mostPopularCount + (NUMBER_OF_COMPUTORS - numberOfVotes) < QUORUM)
         {
             // Create empty tick
             targetNextTickDataDigest = m256i::zero();
@@ -4928,88 +4545,34 @@ static void findNextTickDataDigestFromNextTickVotes()
     }
 }
 
+// find next tick data digest from next tick votes
+// Uses the tally of transactionDigest in the tick votes of the next tick (system.tick + 1)
+static void findNextTickDataDigestFromNextTickVotes()
+{
+    const unsigned int nextTick = system.tick + 1;
+    TickVoteTally::Summary summary;
+    tickVoteTally.getSummary(nextTick, system.epoch, ts.ticks.getByTickInCurrentEpoch(nextTick), summary);
+    findNextTickDataDigestFromSummary(summary.numberOfVotes, summary.transactionDigests);
+}
+
 // working the same as findNextTickDataDigestFromNextTickVotes
-// but it will scan current tick (system.tick) votes, instead of next tick
+// but it uses the tally of expectedNextTickTransactionDigest in the current tick (system.tick) votes
 static void findNextTickDataDigestFromCurrentTickVotes()
 {
-    const unsigned int currentTickIndex = ts.tickToIndexCurrentEpoch(system.tick);
-    const Tick* tsCompTicks = ts.ticks.getByTickIndex(currentTickIndex);
-    unsigned int numberOfEmptyNextTickTransactionDigest = 0;
-    unsigned int numberOfUniqueNextTickTransactionDigests = 0;
-    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
-    {
-        if (tsCompTicks[i].epoch == system.epoch)
-        {
-            unsigned int j;
-            for (j = 0; j < numberOfUniqueNextTickTransactionDigests; j++)
-            {
-                if (tsCompTicks[i].expectedNextTickTransactionDigest == uniqueNextTickTransactionDigests[j])
-                {
-                    break;
-                }
-            }
-            if (j == numberOfUniqueNextTickTransactionDigests)
-            {
-                uniqueNextTickTransactionDigests[numberOfUniqueNextTickTransactionDigests] = tsCompTicks[i].expectedNextTickTransactionDigest;
-                uniqueNextTickTransactionDigestCounters[numberOfUniqueNextTickTransactionDigests++] = 1;
-            }
-            else
-            {
-                uniqueNextTickTransactionDigestCounters[j]++;
-            }
-
-            if (isZero(tsCompTicks[i].expectedNextTickTransactionDigest))
-            {
-                numberOfEmptyNextTickTransactionDigest++;
-            }
-        }
-    }
-    if (numberOfUniqueNextTickTransactionDigests)
+    TickVoteTally::Summary summary;
+    tickVoteTally.getSummary(system.tick, system.epoch, ts.ticks.getByTickInCurrentEpoch(system.tick), summary);
+    if (summary.numberOfVotes)
     {
-        unsigned int mostPopularUniqueNextTickTransactionDigestIndex = 0, totalUniqueNextTickTransactionDigestCounter = uniqueNextTickTransactionDigestCounters[0];
-        for (unsigned int i = 1; i < numberOfUniqueNextTickTransactionDigests; i++)
-        {
-            if (uniqueNextTickTransactionDigestCounters[i] > uniqueNextTickTransactionDigestCounters[mostPopularUniqueNextTickTransactionDigestIndex])
-            {
-                mostPopularUniqueNextTickTransactionDigestIndex = i;
-            }
-            totalUniqueNextTickTransactionDigestCounter += uniqueNextTickTransactionDigestCounters[i];
-        }
-        if (uniqueNextTickTransactionDigestCounters[mostPopularUniqueNextTickTransactionDigestIndex] >= QUORUM)
-        {
-            targetNextTickDataDigest = uniqueNextTickTransactionDigests[mostPopularUniqueNextTickTransactionDigestIndex];
-            targetNextTickDataDigestIsKnown = true;
-        }
-        else
-        {
-            if (numberOfEmptyNextTickTransactionDigest > NUMBER_OF_COMPUTORS - QUORUM
-                || uniqueNextTickTransactionDigestCounters[mostPopularUniqueNextTickTransactionDigestIndex] + (NUMBER_OF_COMPUTORS - totalUniqueNextTickTransactionDigestCounter) < QUORUM)
-            {
-                targetNextTickDataDigest = m256i::zero();
-                targetNextTickDataDigestIsKnown = true;
-            }
-        }
+        findNextTickDataDigestFromSummary(summary.numberOfVotes, summary.expectedNextTickTransactionDigests);
     }
 }
 
 // return number of current tick vote
 static unsigned int countCurrentTickVote()
 {
-    const unsigned int currentTickIndex = ts.tickToIndexCurrentEpoch(system.tick);
-    unsigned int tickTotalNumberOfComputors = 0;
-    const Tick* tsCompTicks = ts.ticks.getByTickIndex(currentTickIndex);
-    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
-    {
-        ts.ticks.acquireLock(i);
-
-        if (tsCompTicks[i].epoch == system.epoch)
-        {
-            tickTotalNumberOfComputors++;
-        }
-
-        ts.ticks.releaseLock(i);
-    }
-    return tickTotalNumberOfComputors;
+    TickVoteTally::Summary summary;
+    tickVoteTally.getSummary(system.tick, system.epoch, ts.ticks.getByTickInCurrentEpoch(system.tick), summary);
+    return summary.numberOfVotes;
 }
 
 // This function scans through all transactions digest in next tickData
@@ -5219,6 +4782,7 @@ static void computeTxBodyDigestBase(const int tick)
         }
 #endif
     }
+    ++etalonTickVersion;
 }
 
 // special procedure to sign the tick vote
@@ -5283,17 +4847,35 @@ static void broadcastTickVotes()
 static void updateVotesCount(unsigned int& tickNumberOfComputors, unsigned int& tickTotalNumberOfComputors)
 {
     const unsigned int currentTickIndex = ts.tickToIndexCurrentEpoch(system.tick);
-    const Tick* tsCompTicks = ts.ticks.getByTickIndex(currentTickIndex);
+    const CompactTick* tsCompTicks = ts.ticks.getByTickIndex(currentTickIndex);
+
+    // Skip comparing all votes if no vote has arrived and etalonTick is unchanged since last call
+    TickVoteTally::Summary summary;
+    tickVoteTally.getSummary(system.tick, system.epoch, tsCompTicks, summary);
+    if (votesCountCache.valid
+        && votesCountCache.tick == system.tick
+        && votesCountCache.votesVersion == summary.version
+        && votesCountCache.resourceTestingDigest == resourceTestingDigest
+        && votesCountCache.etalonTickVersion == etalonTickVersion)
+    {
+        tickNumberOfComputors += votesCountCache.tickNumberOfComputors;
+        tickTotalNumberOfComputors += summary.numberOfVotes;
+        return;
+    }
+
+    const unsigned int tickNumberOfComputorsBefore = tickNumberOfComputors;
     for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
     {
         ts.ticks.acquireLock(i);
 
-        const Tick* tick = &tsCompTicks[i];
-        if (tick->epoch == system.epoch)
+        Tick storedTick;
+        const Tick* tick = &storedTick;
+        if (tsCompTicks[i].epoch == system.epoch)
         {
             tickTotalNumberOfComputors++;
 
-            if (*((unsigned long long*) & tick->millisecond) == *((unsigned long long*) & etalonTick.millisecond)
+            if (ts.ticks.get(currentTickIndex, i, storedTick)
+                && *((unsigned long long*) & tick->millisecond) == *((unsigned long long*) & etalonTick.millisecond)
                 && tick->prevSpectrumDigest == etalonTick.prevSpectrumDigest
                 && tick->prevUniverseDigest == etalonTick.prevUniverseDigest
                 && tick->prevComputerDigest == etalonTick.prevComputerDigest
@@ -5347,6 +4929,13 @@ static void updateVotesCount(unsigned int& tickNumberOfComputors, unsigned int&
         }
         ts.ticks.releaseLock(i);
     }
+
+    votesCountCache.tick = system.tick;
+    votesCountCache.votesVersion = summary.version;
+    votesCountCache.resourceTestingDigest = resourceTestingDigest;
+    votesCountCache.etalonTickVersion = etalonTickVersion;
+    votesCountCache.tickNumberOfComputors = tickNumberOfComputors - tickNumberOfComputorsBefore;
+    votesCountCache.valid = true;
 }
 
 // try to resend tick votes if local system.tick gets stuck for too long
@@ -5556,6 +5145,7 @@ static void tickProcessor(void*)
                     else
                     {
                         KangarooTwelve(&nextTickData, sizeof(TickData), &etalonTick.expectedNextTickTransactionDigest, 32);
+                        ++etalonTickVersion;
                         tickDataSuits = (etalonTick.expectedNextTickTransactionDigest == targetNextTickDataDigest); // make sure the digests are matched
                     }
                 }
@@ -5694,6 +5284,7 @@ static void tickProcessor(void*)
                         etalonTick.saltedTransactionBodyDigest = 0;
                         lastExpectedTickTransactionDigest = etalonTick.expectedNextTickTransactionDigest;
                     }
+                    ++etalonTickVersion;
 
 
                     if (system.tick > system.latestCreatedTick || system.tick == system.initialTick)
@@ -5740,6 +5331,7 @@ static void tickProcessor(void*)
                                 else
                                 {
                                     KangarooTwelve(&nextTickData, sizeof(TickData), &etalonTick.expectedNextTickTransactionDigest, 32);
+                                    ++etalonTickVersion;
                                     tickDataSuits = (etalonTick.expectedNextTickTransactionDigest == targetNextTickDataDigest);
                                 }
                             }
@@ -5811,6 +5403,7 @@ static void tickProcessor(void*)
                                         }
                                     }
                                     ts.tickData.releaseLock();
+                                    ++etalonTickVersion;
                                 }
 
                                 system.tick++;
@@ -5829,6 +5422,7 @@ static void tickProcessor(void*)
 
                                     // wait until all request processors are in waiting state
                                     WAIT_WHILE(epochTransitionWaitingRequestProcessors < nRequestProcessorIDs);
+                                    epochTransitionStages.beginTransition();
 
                                     // end current epoch
                                     endEpoch();
@@ -5852,8 +5446,10 @@ static void tickProcessor(void*)
                                     WAIT_WHILE(systemMustBeSaved);
                                     epochTransitionState = 2;
 
+                                    const unsigned long long beginEpochStartTick = __rdtsc();
                                     beginEpoch();
                                     isBeginEpoch = true;
+                                    epochTransitionStages.setStageTicks(EPOCH_TRANSITION_BEGIN_EPOCH, __rdtsc() - beginEpochStartTick);
 
                                     // beginEpoch() called score->initMemory(), which zeroed the scorer, so re-apply
                                     // the task from the resident buffer. This assumes the task is unchanged across the transition; 
@@ -5891,7 +5487,9 @@ static void tickProcessor(void*)
                                     etalonTick.saltedSpectrumDigest = spectrumDigests[(SPECTRUM_CAPACITY * 2 - 1) - 1];
                                     getUniverseDigest(etalonTick.saltedUniverseDigest);
                                     getComputerDigest(etalonTick.saltedComputerDigest);
+                                    ++etalonTickVersion;
 
+                                    epochTransitionStages.endTransition();
                                     epochTransitionState = 0;
                                 }
                                 ASSERT(epochTransitionWaitingRequestProcessors >= 0 && epochTransitionWaitingRequestProcessors <= nRequestProcessorIDs);
@@ -5968,7 +5566,7 @@ static void contractProcessorShutdownCallback(EFI_EVENT Event, void* Context)
 
 // directory: source directory to load the file. Default: NULL - load from root dir /
 // forceLoadFromFile: when loading node states from file, we want to make sure it load from file and ignore constructionEpoch == system.epoch case
-static bool loadContractStateFiles(CHAR16* directory, bool forceLoadFromFile)
+static bool loadContractStateFiles(CHAR16* directory, bool forceLoadFromFile, bool incremental)
 {
     // Make sure you define all contracts that are allowed to be padded automatically in contract_def.h
 
@@ -5989,7 +5587,9 @@ static bool loadContractStateFiles(CHAR16* directory, bool forceLoadFromFile)
         }
         else
         {
-            long long loadedSize = load(CONTRACT_FILE_NAME, contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], directory);
+            long long loadedSize = (incremental)
+                ? loadIncrementalFile(CONTRACT_FILE_NAME, contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], directory)
+                : load(CONTRACT_FILE_NAME, contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], directory);
             setText(message, L" -> "); // set the message after loading otherwise `message` will contain potential messages from load()
             appendText(message, CONTRACT_FILE_NAME);
             if (loadedSize != contractDescriptions[contractIndex].stateSize)
@@ -6111,13 +5711,13 @@ static bool loadContractExecFeeFiles(CHAR16* directory, bool loadAccumulatedTime
     return true;
 }
 
-static bool saveContractStateFiles(CHAR16* directory)
+static bool saveContractStateFiles(CHAR16* directory, bool incremental)
 {
     logToConsole(L"Saving contract files...");
 
     unsigned long long beginningTick = __rdtsc();
 
-    unsigned long long totalSize = 0;
+    unsigned long long totalSize = 0, totalWrittenSize = 0;
     long long savedSize = 0;
 
     for (unsigned int contractIndex = 0; contractIndex < contractCount; contractIndex++)
@@ -6126,10 +5726,14 @@ static bool saveContractStateFiles(CHAR16* directory)
         CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 8] = (contractIndex % 1000) / 100 + L'0';
         CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 7] = (contractIndex % 100) / 10 + L'0';
         CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 6] = contractIndex % 10 + L'0';
+        unsigned long long writtenSize = contractDescriptions[contractIndex].stateSize;
         contractStateLock[contractIndex].acquireRead();
-        savedSize = save(CONTRACT_FILE_NAME, contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], directory);
+        savedSize = (incremental)
+            ? saveIncrementalFile(CONTRACT_FILE_NAME, contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], directory, &writtenSize)
+            : save(CONTRACT_FILE_NAME, contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], directory);
         contractStateLock[contractIndex].releaseRead();
         totalSize += savedSize;
+        totalWrittenSize += writtenSize;
         if (savedSize != contractDescriptions[contractIndex].stateSize)
         {
             return false;
@@ -6137,7 +5741,9 @@ static bool saveContractStateFiles(CHAR16* directory)
     }
 
     setNumber(message, totalSize, TRUE);
-    appendText(message, L" bytes of the contract state files are saved (");
+    appendText(message, L" bytes of the contract state files are saved, ");
+    appendNumber(message, totalWrittenSize, TRUE);
+    appendText(message, L" bytes written (");
     appendNumber(message, (__rdtsc() - beginningTick) * 1000000 / frequency, TRUE);
     appendText(message, L" microseconds).");
     logToConsole(message);
@@ -6185,91 +5791,6 @@ static bool saveSystem(CHAR16* directory)
     return false;
 }
 
-// Load and verify the bpp9000 task file (topology + windowed data) and hand it to the scorer
-static bool loadBpp9000Task()
-{
-    const unsigned int N = (unsigned int)BPP9000_NUMBER_OF_INPUT_NEURONS;
-    const unsigned int M = (unsigned int)BPP9000_NUMBER_OF_OUTPUT_NEURONS;
-    const unsigned int P = (unsigned int)BPP9000_POPULATION_THRESHOLD;
-    const unsigned int K = (unsigned int)BPP9000_NUMBER_OF_NEIGHBORS;
-    const unsigned long long T = BPP9000_SEQUENCE_LENGTH;
-
-    const unsigned long long topoBytes = score_task_file::topologyBytes(N, M, P, K);
-    const unsigned long long dataBytes = score_task_file::dataBytes(N, M, T);
-    const unsigned long long headerBytes = sizeof(score_task_file::TaskFileHeader);
-    const unsigned long long totalBytes = headerBytes + topoBytes + dataBytes;
-
-    if (!allocPoolWithErrorLog(L"bpp9000Task", totalBytes, (void**)&gBpp9000TaskBuffer, __LINE__))
-    {
-        return false;
-    }
-
-    bool ok = false;
-    const long long loadedSize = load(SCORE_BPP9000_TASK_FILE_NAME, totalBytes, gBpp9000TaskBuffer, NULL);
-    if (loadedSize != (long long)totalBytes)
-    {
-        logToConsole(L"bpp9000 task file missing or wrong size - node will not do score verification.");
-    }
-    else
-    {
-        const score_task_file::TaskFileHeader* h = (const score_task_file::TaskFileHeader*)gBpp9000TaskBuffer;
-        const unsigned char* topoBlock = gBpp9000TaskBuffer + headerBytes;
-        const unsigned char* dataBlock = topoBlock + topoBytes;
-
-        unsigned char topoHash[32];
-        unsigned char dataHash[32];
-        KangarooTwelve(topoBlock, (unsigned int)topoBytes, topoHash, 32);
-        KangarooTwelve(dataBlock, (unsigned int)dataBytes, dataHash, 32);
-
-        if (h->magic != score_task_file::MAGIC || h->version != score_task_file::VERSION
-            || h->numInputTrits != N || h->numOutputTrits != M || h->population != P
-            || h->numNeighbors != K || h->numPairs < T)
-        {
-            logToConsole(L"bpp9000 task header does not match configured parameters - node will not do score verification.");
-        }
-        else if (*(const m256i*)topoHash != *(const m256i*)BPP9000_TOPOLOGY_HASH
-              || *(const m256i*)dataHash != *(const m256i*)BPP9000_DATA_HASH)
-        {
-            logToConsole(L"bpp9000 task hash mismatch (not the pinned canonical task) - node will not do score verification.");
-        }
-        else if (!score->loadTask(topoBlock, dataBlock))
-        {
-            logToConsole(L"bpp9000 task failed topology validation - node will not do score verification.");
-        }
-        else
-        {
-            logToConsole(L"Loaded bpp9000 task file");
-            ok = true;
-        }
-    }
-
-    // Keep the verified buffer resident (for applyBpp9000Task) on success; release it on failure.
-    if (!ok)
-    {
-        freePool(gBpp9000TaskBuffer);
-        gBpp9000TaskBuffer = nullptr;
-    }
-    return ok;
-}
-
-// Re-apply the already-verified, resident task to the scorer. Used after beginEpoch() zeroes the scorer:
-// no file I/O and no re-hashing (the blocks were verified once at init), so it cannot fail on a missing or
-// altered file. Returns false only if the task was never loaded.
-static bool applyBpp9000Task()
-{
-    if (gBpp9000TaskBuffer == nullptr)
-    {
-        return false;
-    }
-    const unsigned long long headerBytes = sizeof(score_task_file::TaskFileHeader);
-    const unsigned long long topoBytes = score_task_file::topologyBytes(
-        (unsigned int)BPP9000_NUMBER_OF_INPUT_NEURONS, (unsigned int)BPP9000_NUMBER_OF_OUTPUT_NEURONS,
-        (unsigned int)BPP9000_POPULATION_THRESHOLD, (unsigned int)BPP9000_NUMBER_OF_NEIGHBORS);
-    const unsigned char* topoBlock = gBpp9000TaskBuffer + headerBytes;
-    const unsigned char* dataBlock = topoBlock + topoBytes;
-    return score->loadTask(topoBlock, dataBlock);
-}
-
 static bool initialize()
 {
     enableAVX();
@@ -6281,13 +5802,23 @@ static bool initialize()
     initAVX512FourQConstants();
 #endif
 
+    // Use idle APs for parallel loading and hashing until the processors are started
+    {
+        EFI_GUID mpServiceProtocolGuid = EFI_MP_SERVICES_PROTOCOL_GUID;
+        EFI_MP_SERVICES_PROTOCOL* startupMpServices = NULL;
+        if (bs->LocateProtocol(&mpServiceProtocolGuid, NULL, (void**)&startupMpServices) != EFI_SUCCESS)
+            startupMpServices = NULL;
+        startupWorkers.init(startupMpServices, enableAVX);
+    }
+
     if (!initSpecialEntities())
         return false;
 
     initTimeStampCounter();
 
 #ifdef ENABLE_PROFILING
-    if (!gProfilingDataCollector.init(1024))
+    // Pre-allocate the hash maps of all processor shards, because other processors shouldn't allocate memory
+    if (!gProfilingDataCollector.init(256))
     {
         logToConsole(L"gProfilingDataCollector.init() failed!");
         return false;
@@ -6302,10 +5833,15 @@ static bool initialize()
 
     requestedComputors.header.setSize<sizeof(requestedComputors)>();
     requestedComputors.header.setType(RequestComputors::type());
+    exchangedPublicPeers.header.setSize<sizeof(exchangedPublicPeers)>();
+    exchangedPublicPeers.header.setType(ExchangePublicPeers::type());
     requestedQuorumTick.header.setSize<sizeof(requestedQuorumTick)>();
     requestedQuorumTick.header.setType(RequestQuorumTick::type());
     requestedTickData.header.setSize<sizeof(requestedTickData)>();
     requestedTickData.header.setType(RequestTickData::type());
+    requestedTickRange.header.setSize<sizeof(requestedTickRange)>();
+    requestedTickRange.header.setType(RequestTickRange::type());
+    requestedTickRange.requestTickRange.flags = RequestTickRange::allFlags;
     requestedTickTransactions.header.setSize<sizeof(requestedTickTransactions)>();
     requestedTickTransactions.header.setType(RequestTickTransactions::type());
     requestedTickTransactions.requestedTickTransactions.tick = 0;
@@ -6318,6 +5854,9 @@ static bool initialize()
         if (!ts.init())
             return false;
 
+        if (!quorumTickCache.init())
+            return false;
+
         if (!pendingTxsPool.init())
             return false;        
 
@@ -6454,24 +5993,8 @@ static bool initialize()
             {
                 const unsigned long long beginningTick = __rdtsc();
 
-                // compute spectrum digest
-                unsigned int digestIndex;
-                for (digestIndex = 0; digestIndex < SPECTRUM_CAPACITY; digestIndex++)
-                {
-                    KangarooTwelve64To32(&spectrum[digestIndex], &spectrumDigests[digestIndex]);
-                }
-                unsigned int previousLevelBeginning = 0;
-                unsigned int numberOfLeafs = SPECTRUM_CAPACITY;
-                while (numberOfLeafs > 1)
-                {
-                    for (unsigned int i = 0; i < numberOfLeafs; i += 2)
-                    {
-                        KangarooTwelve64To32(&spectrumDigests[previousLevelBeginning + i], &spectrumDigests[digestIndex++]);
-                    }
-
-                    previousLevelBeginning += numberOfLeafs;
-                    numberOfLeafs >>= 1;
-                }
+                // compute spectrum digest (in parallel on all APs)
+                computeSpectrumDigests(/*useStartupWorkers=*/true);
 
                 setNumber(message, SPECTRUM_CAPACITY * sizeof(EntityRecord), TRUE);
                 appendText(message, L" bytes of the spectrum data are hashed (");
@@ -6567,13 +6090,16 @@ static bool initialize()
     }
 
     logToConsole(L"Allocating buffers ...");
-    if ((!allocPoolWithErrorLog(L"dejavu0", 536870912, (void**)&dejavu0, __LINE__)) ||
-        (!allocPoolWithErrorLog(L"dejavu1", 536870912, (void**)&dejavu1, __LINE__)))
     {
-        return false;
+        void* dejavuFilterBuffer;
+        if (!allocPoolWithErrorLog(L"dejavuFilter", DejavuFilter<32>::bufferSize, &dejavuFilterBuffer, __LINE__))
+        {
+            return false;
+        }
+        m256i dejavuKey;
+        random256(&dejavuKey);
+        dejavuFilter.init(dejavuFilterBuffer, dejavuKey, DEJAVU_SWAP_LIMIT);
     }
-    setMem((void*)dejavu0, 536870912, 0);
-    setMem((void*)dejavu1, 536870912, 0);
 
     if ((!allocPoolWithErrorLog(L"requestQueueBuffer", REQUEST_QUEUE_BUFFER_SIZE, (void**)&requestQueueBuffer, __LINE__)) ||
         (!allocPoolWithErrorLog(L"respondQueueBuffer", RESPONSE_QUEUE_BUFFER_SIZE, (void**)&responseQueueBuffer, __LINE__)))
@@ -6584,14 +6110,15 @@ static bool initialize()
     for (unsigned int i = 0; i < NUMBER_OF_OUTGOING_CONNECTIONS + NUMBER_OF_INCOMING_CONNECTIONS; i++)
     {
         peers[i].receiveData.FragmentCount = 1;
-        peers[i].transmitData.FragmentCount = 1;
+        peers[i].transmitData.FragmentCount = 0;
 
+        unsigned char* transmitQueueBuffer = nullptr;
         if ((!allocPoolWithErrorLog(L"receiveBuffer", BUFFER_SIZE, &peers[i].receiveBuffer, __LINE__))  ||
-            (!allocPoolWithErrorLog(L"FragmentBuffer", BUFFER_SIZE, &peers[i].transmitData.FragmentTable[0].FragmentBuffer, __LINE__)) ||
-            (!allocPoolWithErrorLog(L"dataToTransmit", BUFFER_SIZE, (void**)&peers[i].dataToTransmit, __LINE__)))
+            (!allocPoolWithErrorLog(L"transmitQueueBuffer", PEER_TRANSMIT_QUEUE_SIZE, (void**)&transmitQueueBuffer, __LINE__)))
         {
             return false;
         }
+        peers[i].transmitQueue.init(transmitQueueBuffer, PEER_TRANSMIT_QUEUE_SIZE);
 
         if ((status = createEvent(EVT_NOTIFY_SIGNAL, TPL_CALLBACK, emptyCallback, NULL, &peers[i].connectAcceptToken.CompletionToken.Event))
             || (status = createEvent(EVT_NOTIFY_SIGNAL, TPL_CALLBACK, emptyCallback, NULL, &peers[i].receiveToken.CompletionToken.Event))
@@ -6605,7 +6132,7 @@ static bool initialize()
         peers[i].receiveToken.CompletionToken.Status = -1;
         peers[i].receiveToken.Packet.RxData = &peers[i].receiveData;
         peers[i].transmitToken.CompletionToken.Status = -1;
-        peers[i].transmitToken.Packet.TxData = &peers[i].transmitData;
+        peers[i].transmitToken.Packet.TxData = (EFI_TCP4_TRANSMIT_DATA*)&peers[i].transmitData;
 
         // Init the connection type as 
         if (i < NUMBER_OF_OUTGOING_CONNECTIONS)
@@ -6724,6 +6251,7 @@ static void deinitialize()
     }
 
     ts.deinit();
+    quorumTickCache.deinit();
 
     pendingTxsPool.deinit();
 
@@ -6736,14 +6264,17 @@ static void deinitialize()
         freePool(minerSolutionFlags);
     }
 
-    if (dejavu0)
+    if (dejavuFilter.getBuffer())
     {
-        freePool((void*)dejavu0);
+        freePool(dejavuFilter.getBuffer());
     }
-    if (dejavu1)
+
+#if TICK_STORAGE_AUTOSAVE_MODE
+    if (nodeStateShadowBuffer)
     {
-        freePool((void*)dejavu1);
+        freePool(nodeStateShadowBuffer);
     }
+#endif
 
     if (requestQueueBuffer)
     {
@@ -6768,13 +6299,9 @@ static void deinitialize()
         {
             freePool(peers[i].receiveBuffer);
         }
-        if (peers[i].transmitData.FragmentTable[0].FragmentBuffer)
-        {
-            freePool(peers[i].transmitData.FragmentTable[0].FragmentBuffer);
-        }
-        if (peers[i].dataToTransmit)
+        if (peers[i].transmitQueue.getBuffer())
         {
-            freePool(peers[i].dataToTransmit);
+            freePool(peers[i].transmitQueue.getBuffer());
 
             closeEvent(peers[i].connectAcceptToken.CompletionToken.Event);
             closeEvent(peers[i].receiveToken.CompletionToken.Event);
@@ -6796,7 +6323,7 @@ static void logInfo()
     {
         if (peers[i].tcp4Protocol)
         {
-            numberOfWaitingBytes += peers[i].dataToTransmitSize;
+            numberOfWaitingBytes += peers[i].transmitQueue.size();
         }
     }
 
@@ -6992,6 +6519,25 @@ static void logInfo()
     appendText(message, L" ms.");
     logToConsole(message);
 
+    if (epochTransitionStages.getTransitionCount())
+    {
+        setText(message, L"Last epoch transition time = ");
+        appendNumber(message, epochTransitionStages.getTotalTicks() * 1000 / frequency, TRUE);
+        appendText(message, L" ms (");
+        for (unsigned int i = 0; i < EPOCH_TRANSITION_STAGE_COUNT; i++)
+        {
+            if (i)
+            {
+                appendText(message, L" | ");
+            }
+            appendText(message, epochTransitionStageNames[i]);
+            appendText(message, L" = ");
+            appendNumber(message, epochTransitionStages.getStageTicks((EpochTransitionStage)i) * 1000 / frequency, TRUE);
+        }
+        appendText(message, L" ms).");
+        logToConsole(message);
+    }
+
     // Log infomation about custom mining
     setText(message, L"CustomMining: ");
 
@@ -7179,6 +6725,21 @@ static void logHealthStatus()
     appendNumber(message, commonBuffers.getMaxWaitingProcessorCount(), FALSE);
     logToConsole(message);
 
+#if ADDON_TX_STATUS_REQUEST && ADDON_TX_STATUS_INDEX
+    setText(message, L"TX status index: ");
+    appendNumber(message, txStatusData.confirmedTxIndexEntries, TRUE);
+    appendText(message, L" / ");
+    appendNumber(message, confirmedTxIndexMaxEntries, TRUE);
+    appendText(message, L" entries used, ");
+    appendNumber(message, txStatusData.confirmedTxIndexDroppedTxs, TRUE);
+    appendText(message, L" TX's not indexed");
+    logToConsole(message);
+    if (txStatusData.confirmedTxIndexDroppedTxs)
+    {
+        logToConsole(L"WARNING: TX status index is full, increase TX_STATUS_INDEX_CAPACITY!");
+    }
+#endif
+
     setText(message, L"Connections:");
     for (int i = 0; i < NUMBER_OF_OUTGOING_CONNECTIONS + NUMBER_OF_INCOMING_CONNECTIONS; ++i)
     {
@@ -7200,7 +6761,7 @@ static void logHealthStatus()
             if (peers[i].isTransmitting)
             {
                 appendText(message, L"t");
-                appendNumber(message, peers[i].dataToTransmitSize, FALSE);
+                appendNumber(message, peers[i].transmitQueue.size(), FALSE);
             }
             appendText(message, L"]");
         }
@@ -7766,18 +7327,21 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                 logToConsole(L"WARNING: NUMBER_OF_SOLUTION_PROCESSORS should not be greater than half of the total processor number!");
             }
 
+#if TICK_STORAGE_AUTOSAVE_MODE
+            // Optional buffer for saving node states in background (without it, node states are saved at the persisting
+            // barrier), allocated after the buffers of initialize() and the processors
+            allocateNodeStateShadowBuffer();
+#endif
+
             // -----------------------------------------------------
             // Main loop
-            unsigned int salt;
-            _rdrand32_step(&salt);
-
 #if TICK_STORAGE_AUTOSAVE_MODE == 1
             // Use random tick offset to reduce risk of several nodes doing auto-save in parallel (which can lead to bad topology and misalignment)
             nextPersistingNodeStateTick = system.tick + random(TICK_STORAGE_AUTOSAVE_TICK_PERIOD) + TICK_STORAGE_AUTOSAVE_TICK_PERIOD / 10;
 #endif
             
-            unsigned long long clockTick = 0, systemDataSavingTick = 0, loggingTick = 0, peerRefreshingTick = 0, tickRequestingTick = 0;
-            unsigned int tickRequestingIndicator = 0, futureTickRequestingIndicator = 0;
+            unsigned long long clockTick = 0, systemDataSavingTick = 0, loggingTick = 0, peerRefreshingTick = 0, tickRequestingTick = 0, tickRangeRequestingTick = 0;
+            unsigned int tickRequestingIndicator = 0, futureTickRequestingIndicator = 0, tickRangeRequestedEnd = 0;
             autoResendTickVotes.lastTick = system.initialTick;
             autoResendTickVotes.lastCheck = __rdtsc();
             logToConsole(L"Init complete! Entering main loop ...");
@@ -7842,7 +7406,7 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                     {
                         // new connection established:
                         // prepare and send ExchangePublicPeers message
-                        ExchangePublicPeers* request = (ExchangePublicPeers*)&peers[i].dataToTransmit[sizeof(RequestResponseHeader)];
+                        ExchangePublicPeers* request = &exchangedPublicPeers.exchangePublicPeers;
                         bool noVerifiedPublicPeers = true;
                         // Only check non-private peers for handshake status
                         for (unsigned int k = NUMBER_OF_PRIVATE_IP; k < numberOfPublicPeers; k++)
@@ -7885,26 +7449,20 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                             }
                         }
 
-                        RequestResponseHeader* requestHeader = (RequestResponseHeader*)peers[i].dataToTransmit;
-                        requestHeader->setSize<sizeof(RequestResponseHeader) + sizeof(ExchangePublicPeers)>();
-                        requestHeader->randomizeDejavu();
-                        requestHeader->setType(ExchangePublicPeers::type());
-                        peers[i].dataToTransmitSize = requestHeader->size();
-                        _InterlockedIncrement64(&numberOfDisseminatedRequests);
+                        exchangedPublicPeers.header.randomizeDejavu();
+                        push(&peers[i], &exchangedPublicPeers.header);
 
                         // send RequestComputors message at beginning of epoch
                         if (!broadcastedComputors.computors.epoch
                             || broadcastedComputors.computors.epoch != system.epoch)
                         {
                             requestedComputors.header.randomizeDejavu();
-                            copyMem(&peers[i].dataToTransmit[peers[i].dataToTransmitSize], &requestedComputors, requestedComputors.header.size());
-                            peers[i].dataToTransmitSize += requestedComputors.header.size();
-                            _InterlockedIncrement64(&numberOfDisseminatedRequests);
+                            push(&peers[i], &requestedComputors.header);
                         }
                     }
 
                     // receive and transmit on active connections
-                    peerReceiveAndTransmit(i, salt);
+                    peerReceiveAndTransmit(i);
 
                     // reconnect if this peer slot has no active connection
                     peerReconnectIfInactive(i, PORT);
@@ -8014,7 +7572,7 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                         requestedQuorumTick.header.randomizeDejavu();
                         requestedQuorumTick.requestQuorumTick.quorumTick.tick = system.tick;
                         setMem(&requestedQuorumTick.requestQuorumTick.quorumTick.voteFlags, sizeof(requestedQuorumTick.requestQuorumTick.quorumTick.voteFlags), 0);
-                        const Tick* tsCompTicks = ts.ticks.getByTickInCurrentEpoch(system.tick);
+                        const CompactTick* tsCompTicks = ts.ticks.getByTickInCurrentEpoch(system.tick);
                         for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
                         {
                             if (tsCompTicks[i].epoch == system.epoch)
@@ -8032,7 +7590,7 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                         requestedQuorumTick.header.randomizeDejavu();
                         requestedQuorumTick.requestQuorumTick.quorumTick.tick = system.tick + 1;
                         setMem(&requestedQuorumTick.requestQuorumTick.quorumTick.voteFlags, sizeof(requestedQuorumTick.requestQuorumTick.quorumTick.voteFlags), 0);
-                        const Tick* tsCompTicks = ts.ticks.getByTickInCurrentEpoch(system.tick + 1);
+                        const CompactTick* tsCompTicks = ts.ticks.getByTickInCurrentEpoch(system.tick + 1);
                         for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
                         {
                             if (tsCompTicks[i].epoch == system.epoch)
@@ -8080,9 +7638,32 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                             requestedTickTransactions.requestedTickTransactions.tick = 0;
                         }
                     }
+
+                    // Catch up with ranges of ticks if the quorum is several ticks ahead (after restart or network
+                    // split), instead of one round trip per tick. The next range is requested when half of the previous
+                    // one has been processed, so responses keep flowing. If the responses don't arrive in time (the peer
+                    // may have stopped early or lack the ticks), request again from system.tick. Ranges are large, so
+                    // they are requested from one peer only.
+                    const bool tickRangeTimeout = curTimeTick - tickRangeRequestingTick >= TICK_RANGE_REQUESTING_TIMEOUT * frequency / 1000;
+                    const unsigned int latestVotedTick = ((tickRangeTimeout || system.tick + RequestTickRange::maxNumberOfTicks / 2 >= tickRangeRequestedEnd) && isNewTick) ? getLatestVotedTick() : 0;
+                    if (latestVotedTick >= system.tick + TICK_RANGE_REQUESTING_DISTANCE)
+                    {
+                        const unsigned int firstTick = (tickRangeTimeout || system.tick >= tickRangeRequestedEnd) ? system.tick : tickRangeRequestedEnd;
+                        if (firstTick < latestVotedTick)
+                        {
+                            const unsigned int numberOfTicks = min(latestVotedTick - firstTick, (unsigned int)RequestTickRange::maxNumberOfTicks);
+                            requestedTickRange.header.randomizeDejavu();
+                            requestedTickRange.requestTickRange.firstTick = firstTick;
+                            requestedTickRange.requestTickRange.numberOfTicks = numberOfTicks;
+                            pushToAnyFullNode(&requestedTickRange.header);
+                            tickRangeRequestedEnd = firstTick + numberOfTicks;
+                            tickRangeRequestingTick = curTimeTick;
+                        }
+                    }
                 }
 
-                // Add messages from response queue to sending buffer
+                // Add messages for groups of peers from response queue to sending buffers (messages for specific
+                // peers are added to the peer's transmit queue directly by enqueueResponse())
                 const unsigned short responseQueueElementHead = ::responseQueueElementHead;
                 if (responseQueueElementTail != responseQueueElementHead)
                 {
@@ -8188,7 +7769,13 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                     gProfilingDataCollector.writeToFile();
 #endif
                     ATOMIC_STORE32(requestPersistingNodeState, 0);
-                    logToConsole(L"Complete saving all node states");
+                    if (!isBackgroundNodeStateSaveActive())
+                        logToConsole(L"Complete saving all node states");
+                }
+                else
+                {
+                    // Write one chunk of node states copied at last persisting barrier
+                    stepBackgroundNodeStateSave();
                 }
 #if TICK_STORAGE_AUTOSAVE_MODE == 1
                 if (nextAutoSaveTickUpdated)
@@ -8288,6 +7875,10 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                 while (remainedItem > 0 && ((__rdtsc() - curTimeTick) * 1000000 / frequency < TARGET_MAINTHREAD_LOOP_DURATION));
             }
 
+#if TICK_STORAGE_AUTOSAVE_MODE
+            finishBackgroundNodeStateSave();
+#endif
+
             saveSystem();
             score->saveScoreCache(system.epoch);
 #ifdef ENABLE_PROFILING
@@ -462,64 +462,127 @@ static bool remapEpochRevenueData(const unsigned char* saved, unsigned long long
 // Intermediate buffers for V2 revenue computation
 struct RevenueV2Buffers
 {
-    unsigned int slidingWindowLogScore[MAX_NUMBER_OF_TICKS_PER_EPOCH];
     unsigned long long txFactor[NUMBER_OF_COMPUTORS];
     unsigned long long oracleFactor[NUMBER_OF_COMPUTORS];
     unsigned long long miningFactor[NUMBER_OF_COMPUTORS];
 };
 static RevenueV2Buffers gRevenueV2Buffers;
 
-static void computeRevenueV2(EpochRevenueData& rEpochReveneuData)
+// Log score of the transactions of tick t
+static unsigned int revenueV2LogScore(const EpochRevenueData& rEpochReveneuData, unsigned int t)
 {
-    // Defensive: need at least WINDOW_SIZE ticks for circular sliding window to be valid.
-    if (rEpochReveneuData.totalTicks < REVENUE_WINDOW_SIZE)
-    {
-        setMem(rEpochReveneuData.slidingWindowTxScore, sizeof(rEpochReveneuData.slidingWindowTxScore), 0);
-        setMem(rEpochReveneuData.v2Revenue, sizeof(rEpochReveneuData.v2Revenue), 0);
-        return;
-    }
+    unsigned int txCount = rEpochReveneuData.perTickTxCount[t];
+    txCount = txCount > MAX_TX_LUT_INDEX ? MAX_TX_LUT_INDEX : txCount;
+    return gTxRevenuePoints[txCount];
+}
 
-    setMem(rEpochReveneuData.slidingWindowTxScore, sizeof(rEpochReveneuData.slidingWindowTxScore), 0);
+// Running state of the V2 transaction score. Ticks are added while the epoch runs, finalizing the score of each
+// interior tick (whose window [t-H, t+H] doesn't wrap around) as soon as tick t+H is added. So computeRevenueV2()
+// only has to score the 2H ticks at the epoch boundary, whose circular windows depend on the total number of ticks.
+struct RevenueV2Stream
+{
+    unsigned int initialTick;
+    unsigned int nextTickOffset;                                    // number of ticks added
+    unsigned long long windowSum;                                   // sum of log scores of the last W ticks added
+    unsigned long long txScore[NUMBER_OF_COMPUTORS];                // accumulated score of finalized interior ticks
 
-    // Transaction score computation
-    for (unsigned int t = 0; t < rEpochReveneuData.totalTicks; t++)
+    void reset(unsigned int newInitialTick)
     {
-        unsigned int txCount = rEpochReveneuData.perTickTxCount[t];
-        txCount = txCount > MAX_TX_LUT_INDEX ? MAX_TX_LUT_INDEX : txCount;
-
-        // Get the log of total transaction
-        gRevenueV2Buffers.slidingWindowLogScore[t] = gTxRevenuePoints[txCount];
+        setMem(this, sizeof(*this), 0);
+        initialTick = newInitialTick;
     }
 
-    // Pre-calculate window sum for t = 0: indices [-675, +675] with circular wrap
-    unsigned long long windowSum = 0;
-    for (int i = -(int)REVENUE_HALF_WINDOW; i <= (int)REVENUE_HALF_WINDOW; ++i)
+    // Add ticks up to tickCount - 1 from perTickTxCount (which must not change for ticks already added)
+    void addTicks(const EpochRevenueData& rEpochReveneuData, unsigned int tickCount)
     {
-        unsigned int idx = ((i % (int)rEpochReveneuData.totalTicks) + (int)rEpochReveneuData.totalTicks) % (int)rEpochReveneuData.totalTicks;
-        windowSum += gRevenueV2Buffers.slidingWindowLogScore[idx];
+        ASSERT(tickCount <= MAX_NUMBER_OF_TICKS_PER_EPOCH);
+        for (unsigned int t = nextTickOffset; t < tickCount; t++)
+        {
+            windowSum += revenueV2LogScore(rEpochReveneuData, t);
+            if (t >= REVENUE_WINDOW_SIZE)
+            {
+                windowSum -= revenueV2LogScore(rEpochReveneuData, t - REVENUE_WINDOW_SIZE);
+            }
+
+            // now windowSum covers ticks [t-2H, t], so the centered tick c = t-H can be scored
+            if (t >= 2u * REVENUE_HALF_WINDOW)
+            {
+                scoreTick(rEpochReveneuData, t - REVENUE_HALF_WINDOW, windowSum, txScore);
+            }
+        }
+        if (tickCount > nextTickOffset)
+        {
+            nextTickOffset = tickCount;
+        }
     }
 
-    for (unsigned int t = 0; t < rEpochReveneuData.totalTicks; t++)
+    // Add score of tick c compared to the window sum around it to the score of the tick leader
+    void scoreTick(const EpochRevenueData& rEpochReveneuData, unsigned int c, unsigned long long windowVal, unsigned long long* score) const
     {
-        // Compute score using current window sum
-        unsigned long long windowVal = windowSum;
         if (windowVal == 0)
         {
             windowVal = 1;
         }
-
-        // Score of center compare to windows
-        unsigned long long txScore = (unsigned long long)gRevenueV2Buffers.slidingWindowLogScore[t];
-        txScore = txScore * REVENUE_SCALE * REVENUE_WINDOW_SIZE / windowVal;
+        unsigned long long tickScore = (unsigned long long)revenueV2LogScore(rEpochReveneuData, c);
+        tickScore = tickScore * REVENUE_SCALE * REVENUE_WINDOW_SIZE / windowVal;
 
         // Absolute tick number for computor tick leader
-        unsigned int computorIndex = (rEpochReveneuData.initialTick + t) % NUMBER_OF_COMPUTORS;
-        rEpochReveneuData.slidingWindowTxScore[computorIndex] += txScore;
+        const unsigned int computorIndex = (initialTick + c) % NUMBER_OF_COMPUTORS;
+        score[computorIndex] += tickScore;
+    }
+};
+
+// Stream of V2 transaction scores of the current epoch, fed by revenueV2OnTick()
+static RevenueV2Stream gRevenueV2Stream;
+
+// Called by tick processor after perTickTxCount[tickOffset] has been set
+static void revenueV2OnTick(const EpochRevenueData& rEpochReveneuData, unsigned int initialTick, unsigned int tickOffset)
+{
+    // New epoch, first tick after loading a snapshot, or tick processed again -> rebuild from perTickTxCount
+    if (gRevenueV2Stream.initialTick != initialTick || tickOffset < gRevenueV2Stream.nextTickOffset)
+    {
+        gRevenueV2Stream.reset(initialTick);
+    }
+    gRevenueV2Stream.addTicks(rEpochReveneuData, tickOffset + 1);
+}
+
+// Compute V2 revenue, using the ticks already scored by stream (it is caught up or rebuilt if needed)
+static void computeRevenueV2(EpochRevenueData& rEpochReveneuData, RevenueV2Stream& stream)
+{
+    // Defensive: need at least WINDOW_SIZE ticks for circular sliding window to be valid.
+    if (rEpochReveneuData.totalTicks < REVENUE_WINDOW_SIZE)
+    {
+        setMem(rEpochReveneuData.slidingWindowTxScore, sizeof(rEpochReveneuData.slidingWindowTxScore), 0);
+        setMem(rEpochReveneuData.v2Revenue, sizeof(rEpochReveneuData.v2Revenue), 0);
+        return;
+    }
+
+    // Transaction score of interior ticks
+    const unsigned int N = rEpochReveneuData.totalTicks;
+    if (stream.initialTick != rEpochReveneuData.initialTick || stream.nextTickOffset > N)
+    {
+        stream.reset(rEpochReveneuData.initialTick);
+    }
+    stream.addTicks(rEpochReveneuData, N);
+    copyMem(rEpochReveneuData.slidingWindowTxScore, stream.txScore, sizeof(rEpochReveneuData.slidingWindowTxScore));
+
+    // Transaction score of the 2H edge ticks [N-H, N-1] and [0, H-1], whose windows wrap around circularly.
+    // Pre-calculate window sum for c = N-H: indices [N-2H, N]
+    unsigned int c = N - REVENUE_HALF_WINDOW;
+    unsigned long long windowSum = 0;
+    for (unsigned int x = N - 2 * REVENUE_HALF_WINDOW; x <= N; ++x)
+    {
+        windowSum += revenueV2LogScore(rEpochReveneuData, (x < N) ? x : x - N);
+    }
+    for (unsigned int step = 0; step < 2u * REVENUE_HALF_WINDOW; step++)
+    {
+        stream.scoreTick(rEpochReveneuData, c, windowSum, rEpochReveneuData.slidingWindowTxScore);
 
         // Slide the window: subtract leaving element, add entering element
-        unsigned int leavingIdx = (t + rEpochReveneuData.totalTicks - REVENUE_HALF_WINDOW) % rEpochReveneuData.totalTicks;
-        unsigned int enteringIdx = (t + REVENUE_HALF_WINDOW + 1) % rEpochReveneuData.totalTicks;
-        windowSum = windowSum - gRevenueV2Buffers.slidingWindowLogScore[leavingIdx] + gRevenueV2Buffers.slidingWindowLogScore[enteringIdx];
+        const unsigned int leavingIdx = (c + N - REVENUE_HALF_WINDOW) % N;
+        const unsigned int enteringIdx = (c + REVENUE_HALF_WINDOW + 1) % N;
+        windowSum = windowSum - revenueV2LogScore(rEpochReveneuData, leavingIdx) + revenueV2LogScore(rEpochReveneuData, enteringIdx);
+        c = (c + 1 < N) ? c + 1 : 0;
     }
 
     // Compute each independent factor
@@ -568,6 +631,14 @@ static void computeRevenueV2(EpochRevenueData& rEpochReveneuData)
     }
 }
 
+// Compute V2 revenue from scratch
+static void computeRevenueV2(EpochRevenueData& rEpochReveneuData)
+{
+    static RevenueV2Stream stream;
+    stream.reset(rEpochReveneuData.initialTick);
+    computeRevenueV2(rEpochReveneuData, stream);
+}
+
 static unsigned int gTxObservation[REVENUE_TX_DIM];
 struct MultiDimRevenue
 {
@@ -607,21 +678,57 @@ static unsigned int revenueMul(unsigned int d)
     return m_TRANSFER;
 }
 
+// Window sums and W * observations fit in 32 bits, so squares can be computed with _mm256_mul_epu32()
+static_assert(REVENUE_TX_WINDOWSUM_MAX <= 0xFFFFFFFFULL, "Window sum must fit in 32 bits for AVX2 multiplication");
+
+// Add sum of squared deficits and sum of squared window sums of the dimensions [begin, end) to sumDef and sumCap
+// (without the per-dimension multiplier, which is constant within a category)
+static void accumulateSquaredDeficits(unsigned int begin, unsigned int end, const unsigned short* observed, const unsigned long long* windowSum,
+    unsigned long long& sumDef, unsigned long long& sumCap)
+{
+    const __m256i w = _mm256_set1_epi64x(REVENUE_WINDOW_SIZE);
+    __m256i vSumDef = _mm256_setzero_si256();
+    __m256i vSumCap = _mm256_setzero_si256();
+    unsigned int d = begin;
+    for (; d + 4 <= end; d += 4)
+    {
+        const __m256i ws = _mm256_loadu_si256((const __m256i*)(windowSum + d));
+        const __m256i wo = _mm256_mul_epu32(_mm256_cvtepu16_epi64(_mm_loadl_epi64((const __m128i*)(observed + d))), w);
+        const __m256i deficit = _mm256_and_si256(_mm256_cmpgt_epi64(ws, wo), _mm256_sub_epi64(ws, wo));
+        vSumDef = _mm256_add_epi64(vSumDef, _mm256_mul_epu32(deficit, deficit));
+        vSumCap = _mm256_add_epi64(vSumCap, _mm256_mul_epu32(ws, ws));
+    }
+    sumDef += _mm256_extract_epi64(vSumDef, 0) + _mm256_extract_epi64(vSumDef, 1) + _mm256_extract_epi64(vSumDef, 2) + _mm256_extract_epi64(vSumDef, 3);
+    sumCap += _mm256_extract_epi64(vSumCap, 0) + _mm256_extract_epi64(vSumCap, 1) + _mm256_extract_epi64(vSumCap, 2) + _mm256_extract_epi64(vSumCap, 3);
+
+    for (; d < end; d++)
+    {
+        const unsigned long long ws = windowSum[d];
+        const unsigned long long wo = (unsigned long long)REVENUE_WINDOW_SIZE * observed[d];
+        const unsigned long long deficit = (wo >= ws) ? 0ULL : ws - wo;
+        sumDef += deficit * deficit;
+        sumCap += ws * ws;
+    }
+}
+
 // Compute the score at tickOffset and accumulate it into gMultiDimRevenue.txScore
 // windowSum is accumulated windows around tickOffset
 static void finalizeTickScore(unsigned int tickOffset, const unsigned short* observed, const unsigned long long* windowSum)
 {
+    // Sums per category, weighted with the squared multiplier of the category (see revenueMul())
+    constexpr unsigned int categoryEnd[3] = { NUMBER_OF_COMPUTORS, NUMBER_OF_COMPUTORS + REVENUE_CONTRACT_DIMS, REVENUE_TX_DIM };
     unsigned long long sumDef = 0;
     unsigned long long sumCap = 0;
-    for (unsigned int d = 0; d < REVENUE_TX_DIM; d++)
+    unsigned int begin = 0;
+    for (unsigned int category = 0; category < 3; category++)
     {
-        const unsigned long long ws = windowSum[d];
-        const unsigned long long wo = (unsigned long long)REVENUE_WINDOW_SIZE * observed[d];
-        const unsigned long long m = revenueMul(d);
-        const unsigned long long deficit = (wo >= ws) ? 0ULL : m * (ws - wo);
-        const unsigned long long cap = m * ws;
-        sumDef += deficit * deficit;
-        sumCap += cap * cap;
+        unsigned long long categorySumDef = 0;
+        unsigned long long categorySumCap = 0;
+        accumulateSquaredDeficits(begin, categoryEnd[category], observed, windowSum, categorySumDef, categorySumCap);
+        const unsigned long long m = revenueMul(begin);
+        sumDef += m * m * categorySumDef;
+        sumCap += m * m * categorySumCap;
+        begin = categoryEnd[category];
     }
 
     unsigned long long tickScore;
@@ -639,31 +746,56 @@ static void finalizeTickScore(unsigned int tickOffset, const unsigned short* obs
     gMultiDimRevenue.txScore[leader] += tickScore;
 }
 
+// windowSum[d] += entering[d] - leaving[d] for all dimensions (leaving may be NULL)
+static void slideWindowSum(unsigned long long* windowSum, const unsigned short* leaving, const unsigned short* entering)
+{
+    unsigned int d = 0;
+    for (; d + 4 <= REVENUE_TX_DIM; d += 4)
+    {
+        __m256i ws = _mm256_loadu_si256((const __m256i*)(windowSum + d));
+        ws = _mm256_add_epi64(ws, _mm256_cvtepu16_epi64(_mm_loadl_epi64((const __m128i*)(entering + d))));
+        if (leaving)
+        {
+            ws = _mm256_sub_epi64(ws, _mm256_cvtepu16_epi64(_mm_loadl_epi64((const __m128i*)(leaving + d))));
+        }
+        _mm256_storeu_si256((__m256i*)(windowSum + d), ws);
+    }
+    for (; d < REVENUE_TX_DIM; d++)
+    {
+        windowSum[d] += entering[d];
+        if (leaving)
+        {
+            windowSum[d] -= leaving[d];
+        }
+    }
+}
+
 static void revenueOnTick(unsigned int tickOffset, unsigned int* obs)
 {
     // slot currently holds tick (t - W)
     unsigned short* slot = ringRow(tickOffset);
 
-    // evict the tick that currently occupies this ring slot (tick t-W), if any
-    if (tickOffset >= REVENUE_WINDOW_SIZE)
+    // convert observation to 16 bit (at most NUMBER_OF_TRANSACTIONS_PER_TICK per dimension)
+    unsigned short v[REVENUE_TX_DIM];
+    unsigned int d = 0;
+    for (; d + 8 <= REVENUE_TX_DIM; d += 8)
     {
-        for (unsigned int d = 0; d < REVENUE_TX_DIM; d++) 
-        { 
-            gMultiDimRevenue.windowSum[d] -= slot[d];
-        }
+        const __m256i o = _mm256_loadu_si256((const __m256i*)(obs + d));
+        _mm_storeu_si128((__m128i*)(v + d), _mm_packus_epi32(_mm256_castsi256_si128(o), _mm256_extracti128_si256(o, 1)));
     }
-    // write this tick into the ring + windowSum (and into the frozen head for the first 2H ticks)
-    const bool inHead = (tickOffset < 2u * REVENUE_HALF_WINDOW);
-    unsigned short* h = inHead ? headRow(tickOffset) : nullptr;
-    for (unsigned int d = 0; d < REVENUE_TX_DIM; d++)
+    for (; d < REVENUE_TX_DIM; d++)
     {
-        const unsigned short v = (unsigned short)obs[d];
-        slot[d] = v;
-        gMultiDimRevenue.windowSum[d] += v;
-        if (inHead) 
-        { 
-            h[d] = v;
-        }
+        v[d] = (unsigned short)obs[d];
+    }
+
+    // evict the tick that currently occupies this ring slot (tick t-W), if any, and add this tick to windowSum
+    slideWindowSum(gMultiDimRevenue.windowSum, (tickOffset >= REVENUE_WINDOW_SIZE) ? slot : nullptr, v);
+
+    // write this tick into the ring (and into the frozen head for the first 2H ticks)
+    copyMem(slot, v, sizeof(v));
+    if (tickOffset < 2u * REVENUE_HALF_WINDOW)
+    {
+        copyMem(headRow(tickOffset), v, sizeof(v));
     }
 
     // now windowSum covers ticks [t-2H, t] (W entries). Finalize the centered INTERIOR tick c = t-H.
@@ -695,19 +827,11 @@ static void scoreEpochEdgeTicks(unsigned int tickEdge)
     setMem(edgeWindowSum, sizeof(edgeWindowSum), 0);
     for (unsigned int x = tickEdge - 2 * H; x <= tickEdge - 1; x++)
     {
-        const unsigned short* row = ringRow(x);
-        for (unsigned int d = 0; d < REVENUE_TX_DIM; d++)
-        {
-            edgeWindowSum[d] += row[d];
-        }
+        slideWindowSum(edgeWindowSum, nullptr, ringRow(x));
     }
 
     // The last element of windows is circular to the first tick
-    const unsigned short* row = headRow(0);
-    for (unsigned int d = 0; d < REVENUE_TX_DIM; d++)
-    {
-        edgeWindowSum[d] += row[d];
-    }
+    slideWindowSum(edgeWindowSum, nullptr, headRow(0));
 
     // Slide the windows start at tick = N - REVENUE_HALF_WINDOW
     unsigned int c = tickEdge - H;
@@ -723,12 +847,7 @@ static void scoreEpochEdgeTicks(unsigned int tickEdge)
         // Determine the enterring and leaving data
         const unsigned int leaving = (c >= H) ? (c - H) : (c + tickEdge - H);
         const unsigned int entering = (c + H + 1u < tickEdge) ? (c + H + 1u) : (c + H + 1u - tickEdge);
-        const unsigned short* lv = obsAt(leaving);
-        const unsigned short* en = obsAt(entering);
-        for (unsigned int d = 0; d < REVENUE_TX_DIM; d++) 
-        { 
-            edgeWindowSum[d] = edgeWindowSum[d] - lv[d] + en[d];
-        }
+        slideWindowSum(edgeWindowSum, obsAt(leaving), obsAt(entering));
         c = (c + 1u < tickEdge) ? (c + 1u) : 0u;
     }
 }
@@ -237,6 +237,68 @@ struct ScoreFunction
     unsigned long long stackSize = 0;
 #endif
 
+    // Maximum number of queued solutions of one public key that a worker takes and scores at once
+    static constexpr unsigned int maxTaskBatchSize = 8;
+
+    // Score count (<= maxTaskBatchSize) solutions of one public key and mining seed into scores[], like
+    // operator() per nonce. Cache misses are computed together under one engine lock, sharing the per-key
+    // setup of the engine (see ScoreBpp9000::computeScores).
+    void computeScores(const unsigned long long processor_Number, const m256i& publicKey, const m256i& miningSeed,
+                       const m256i* nonces, unsigned int count, unsigned int* scores)
+    {
+        PROFILE_SCOPE();
+        ASSERT(count <= maxTaskBatchSize);
+
+        m256i batchNonces[maxTaskBatchSize];
+        unsigned int batchIndices[maxTaskBatchSize];
+        unsigned int batchScores[maxTaskBatchSize];
+#if USE_SCORE_CACHE
+        unsigned int scoreCacheIndices[maxTaskBatchSize];
+#endif
+        const bool validSeed = !isZero(miningSeed) && miningSeed == currentRandomSeed;
+        unsigned int batchCount = 0;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            scores[i] = score_engine::INVALID_SCORE_VALUE;
+            // TODO: When neuraxon's going, this check need to be modified
+            if (!validSeed || !score_engine::isCanonicalBpp9000Nonce(nonces[i].m256i_u8))
+            {
+                continue;
+            }
+#if USE_SCORE_CACHE
+            scoreCacheIndices[i] = scoreCache.getCacheIndex(publicKey, miningSeed, nonces[i]);
+            const int cachedScore = scoreCache.tryFetching(publicKey, miningSeed, nonces[i], scoreCacheIndices[i]);
+            if (cachedScore >= scoreCache.MIN_VALID_SCORE)
+            {
+                scores[i] = cachedScore;
+                continue;
+            }
+#endif
+            batchNonces[batchCount] = nonces[i];
+            batchIndices[batchCount] = i;
+            batchCount++;
+        }
+        if (!batchCount)
+        {
+            return;
+        }
+
+        const int solutionBufIdx = (int)(processor_Number % solutionBufferCount);
+        ACQUIRE(solutionEngineLock[solutionBufIdx]);
+
+        _computeBuffer[solutionBufIdx].computeBpp9000Scores(publicKey.m256i_u8, batchNonces, batchCount, poolVec, batchScores);
+
+        RELEASE(solutionEngineLock[solutionBufIdx]);
+        for (unsigned int k = 0; k < batchCount; k++)
+        {
+            const unsigned int i = batchIndices[k];
+            scores[i] = batchScores[k];
+#if USE_SCORE_CACHE
+            scoreCache.addEntry(publicKey, miningSeed, nonces[i], scoreCacheIndices[i], scores[i]);
+#endif
+        }
+    }
+
     // Multithreaded solutions verification:
     // This module mainly serve tick processor in qubic core node, thus the queue size is limited at NUMBER_OF_TRANSACTIONS_PER_TICK 
     // for future use for somewhere else, you can only increase the size.
@@ -316,10 +378,55 @@ struct ScoreFunction
         RELEASE(taskQueueLock);
         return result;
     }
-    void finishTask()
+
+    // get up to maxCount tasks with the public key and mining seed of the next queued task, can call on any thread.
+    // Matching tasks further back in the queue are moved forward. While fewer than maxCount tasks per compute
+    // buffer are left, fewer are taken, so the other threads still get work. Returns the number of tasks.
+    unsigned int getTasks(m256i* publicKey, m256i* miningSeed, m256i* nonces, unsigned int maxCount)
+    {
+        if (!_nIsTaskQueueReady)
+        {
+            return 0;
+        }
+        unsigned int count = 0;
+        ACQUIRE(taskQueueLock);
+        if (_nProcessing < _nTask)
+        {
+            const unsigned long long tasksPerBuffer = (_nTask - _nProcessing) / solutionBufferCount;
+            if (maxCount > tasksPerBuffer)
+            {
+                maxCount = (tasksPerBuffer) ? (unsigned int)tasksPerBuffer : 1;
+            }
+            const unsigned int first = _nProcessing;
+            *publicKey = taskQueue.publicKey[first];
+            *miningSeed = taskQueue.miningSeed[first];
+            nonces[count++] = taskQueue.nonce[first];
+            for (unsigned int index = first + 1; index < _nTask && count < maxCount; index++)
+            {
+                if (taskQueue.publicKey[index] == *publicKey && taskQueue.miningSeed[index] == *miningSeed)
+                {
+                    // swap with the first unprocessed task that does not match
+                    const unsigned int target = first + count;
+                    const m256i nonce = taskQueue.nonce[index];
+                    taskQueue.publicKey[index] = taskQueue.publicKey[target];
+                    taskQueue.miningSeed[index] = taskQueue.miningSeed[target];
+                    taskQueue.nonce[index] = taskQueue.nonce[target];
+                    taskQueue.publicKey[target] = *publicKey;
+                    taskQueue.miningSeed[target] = *miningSeed;
+                    taskQueue.nonce[target] = nonce;
+                    nonces[count++] = nonce;
+                }
+            }
+            _nProcessing += count;
+        }
+        RELEASE(taskQueueLock);
+        return count;
+    }
+
+    void finishTask(unsigned int count = 1)
     {
         ACQUIRE(taskQueueLock);
-        _nFinished++;
+        _nFinished += count;
         RELEASE(taskQueueLock);
     }
 
@@ -332,12 +439,13 @@ struct ScoreFunction
     {
         m256i publicKey;
         m256i miningSeed;
-        m256i nonce;
-        bool res = this->getTask(&publicKey, &miningSeed, &nonce);
-        if (res)
+        m256i nonces[maxTaskBatchSize];
+        unsigned int scores[maxTaskBatchSize];
+        unsigned int count = this->getTasks(&publicKey, &miningSeed, nonces, maxTaskBatchSize);
+        if (count)
         {
-            (*this)(processorNumber, publicKey, miningSeed, nonce);
-            this->finishTask();
+            this->computeScores(processorNumber, publicKey, miningSeed, nonces, count, scores);
+            this->finishTask(count);
         }
     }
 };
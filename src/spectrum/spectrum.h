@@ -4,6 +4,9 @@
 #include "platform/m256.h"
 #include "platform/concurrency.h"
 #include "platform/file_io.h"
+#include "platform/incremental_file.h"
+#include "platform/startup_workers.h"
+#include "platform/chunked_job.h"
 #include "platform/time_stamp_counter.h"
 #include "platform/memory.h"
 #include "platform/profiling.h"
@@ -31,24 +34,118 @@ GLOBAL_VAR_DECL unsigned long long dustThresholdBurnAll GLOBAL_VAR_INIT(0), dust
 GLOBAL_VAR_DECL m256i* spectrumDigests GLOBAL_VAR_INIT(nullptr);
 static constexpr unsigned long long spectrumDigestsSizeInByte = (SPECTRUM_CAPACITY * 2 - 1) * 32ULL;
 
+// One bit per node of a level of the digest tree, marking the digests updateSpectrumDigests() has to recompute
+GLOBAL_VAR_DECL unsigned long long spectrumChangeFlags[SPECTRUM_CAPACITY / (sizeof(unsigned long long) * 8)];
+
 GLOBAL_VAR_DECL unsigned long long spectrumReorgTotalExecutionTicks GLOBAL_VAR_INIT(0);
 
+// Balances (incomingAmount - outgoingAmount) of the spectrum as dense column, so the scans over all entities read 8
+// instead of 64 bytes per entity. Free slots of the hash map (publicKey and balance zero) are marked with
+// spectrumBalanceOfFreeSlot. Kept in sync by increaseEnergy(), decreaseEnergy(), and reorganizeSpectrum(). After
+// changing spectrum otherwise (loading, direct writes in tests), rebuildSpectrumBalances() has to be called.
+GLOBAL_VAR_DECL long long* spectrumBalances GLOBAL_VAR_INIT(nullptr);
+static constexpr long long spectrumBalanceOfFreeSlot = -1;
+static constexpr long long maxSpectrumBalance = 0x7FFFFFFFFFFFFFFF;
+static constexpr unsigned long long spectrumBalancesSizeInBytes = SPECTRUM_CAPACITY * sizeof(long long);
+
+#if defined (__AVX512F__)
+static constexpr unsigned int spectrumBalancesPerBlock = 8;
+#else
+static constexpr unsigned int spectrumBalancesPerBlock = 4;
+#endif
+static_assert(SPECTRUM_CAPACITY % spectrumBalancesPerBlock == 0, "SPECTRUM_CAPACITY must be multiple of block size");
+
+// The full spectrum scans are split into chunks that are processed in parallel by the calling processor and the
+// request processors helping with spectrumJob (see ChunkedJob).
+GLOBAL_VAR_DECL ChunkedJob spectrumJob;
+static constexpr unsigned int spectrumChunkCount = 256;
+static constexpr unsigned int spectrumChunkSize = SPECTRUM_CAPACITY / spectrumChunkCount;
+static_assert(spectrumChunkSize % spectrumBalancesPerBlock == 0, "Spectrum chunk size must be multiple of block size");
 
-// Update SpectrumInfo data (exensive, because it iterates the whole spectrum), acquire no lock
-static void updateSpectrumInfo(SpectrumInfo& si = spectrumInfo)
+// Anti-dust runs at the end of the tick if the spectrum is filled to this level (see runAntiDustIfNeeded())
+static constexpr unsigned int antiDustSpectrumFill = (SPECTRUM_CAPACITY / 2) + (SPECTRUM_CAPACITY / 4);
+// Anti-dust runs immediately in increaseEnergy() if this level is reached within one tick
+static constexpr unsigned int antiDustEmergencySpectrumFill = SPECTRUM_CAPACITY - (SPECTRUM_CAPACITY / 8);
+
+
+// Return bit mask of the spectrumBalancesPerBlock balances starting at firstIndex that are within
+// [minBalance, maxBalance] (bit i is set for spectrumBalances[firstIndex + i]).
+static inline unsigned int getSpectrumBalancesInRange(unsigned int firstIndex, long long minBalance, long long maxBalance)
+{
+#if defined (__AVX512F__)
+    const __m512i balances = _mm512_loadu_si512(spectrumBalances + firstIndex);
+    return _mm512_cmpge_epi64_mask(balances, _mm512_set1_epi64(minBalance))
+        & _mm512_cmple_epi64_mask(balances, _mm512_set1_epi64(maxBalance));
+#else
+    const __m256i balances = _mm256_loadu_si256((const __m256i*)(spectrumBalances + firstIndex));
+    const __m256i outOfRange = _mm256_or_si256(
+        _mm256_cmpgt_epi64(_mm256_set1_epi64x(minBalance), balances),
+        _mm256_cmpgt_epi64(balances, _mm256_set1_epi64x(maxBalance)));
+    return ~_mm256_movemask_pd(_mm256_castsi256_pd(outOfRange)) & 0xf;
+#endif
+}
+
+// Rebuild spectrumBalances from spectrum (expensive, because it iterates the whole spectrum), acquire no lock
+static void rebuildSpectrumBalances()
 {
     PROFILE_SCOPE();
-    si.numberOfEntities = 0;
-    si.totalAmount = 0;
+    spectrumJob.run([](void*, unsigned int chunk)
+        {
+            for (unsigned int i = chunk * spectrumChunkSize; i < (chunk + 1) * spectrumChunkSize; i++)
+            {
+                const long long balance = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
+                spectrumBalances[i] = (balance || !isZero(spectrum[i].publicKey)) ? balance : spectrumBalanceOfFreeSlot;
+            }
+        }, nullptr, spectrumChunkCount);
+}
+
+// Check that spectrumBalances matches spectrum (expensive, because it iterates the whole spectrum), acquire no lock
+static bool checkSpectrumBalances()
+{
     for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
     {
-        long long balance = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
-        if (balance || !isZero(spectrum[i].publicKey))
-        {
-            si.numberOfEntities++;
-            si.totalAmount += balance;
-        }
+        const long long balance = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
+        if (spectrumBalances[i] != ((balance || !isZero(spectrum[i].publicKey)) ? balance : spectrumBalanceOfFreeSlot))
+            return false;
+    }
+    return true;
+}
+
+// Update SpectrumInfo data from spectrumBalances (iterates the whole balance column), acquire no lock
+static void updateSpectrumInfo(SpectrumInfo& si = spectrumInfo)
+{
+    PROFILE_SCOPE();
+#if defined (__AVX512F__)
+    const __m512i freeSlot = _mm512_set1_epi64(spectrumBalanceOfFreeSlot);
+    const __m512i one = _mm512_set1_epi64(1);
+    __m512i numberOfEntities = _mm512_setzero_si512();
+    __m512i totalAmount = _mm512_setzero_si512();
+    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i += spectrumBalancesPerBlock)
+    {
+        const __m512i balances = _mm512_loadu_si512(spectrumBalances + i);
+        const __mmask8 occupied = _mm512_cmpneq_epi64_mask(balances, freeSlot);
+        numberOfEntities = _mm512_mask_add_epi64(numberOfEntities, occupied, numberOfEntities, one);
+        totalAmount = _mm512_mask_add_epi64(totalAmount, occupied, totalAmount, balances);
+    }
+    si.numberOfEntities = (unsigned int)_mm512_reduce_add_epi64(numberOfEntities);
+    si.totalAmount = _mm512_reduce_add_epi64(totalAmount);
+#else
+    const __m256i freeSlot = _mm256_set1_epi64x(spectrumBalanceOfFreeSlot);
+    __m256i numberOfFreeSlots = _mm256_setzero_si256();
+    __m256i totalAmount = _mm256_setzero_si256();
+    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i += spectrumBalancesPerBlock)
+    {
+        const __m256i balances = _mm256_loadu_si256((const __m256i*)(spectrumBalances + i));
+        const __m256i free = _mm256_cmpeq_epi64(balances, freeSlot);
+        numberOfFreeSlots = _mm256_sub_epi64(numberOfFreeSlots, free);
+        totalAmount = _mm256_add_epi64(totalAmount, _mm256_andnot_si256(free, balances));
     }
+    si.numberOfEntities = (unsigned int)(SPECTRUM_CAPACITY
+        - (_mm256_extract_epi64(numberOfFreeSlots, 0) + _mm256_extract_epi64(numberOfFreeSlots, 1)
+            + _mm256_extract_epi64(numberOfFreeSlots, 2) + _mm256_extract_epi64(numberOfFreeSlots, 3)));
+    si.totalAmount = _mm256_extract_epi64(totalAmount, 0) + _mm256_extract_epi64(totalAmount, 1)
+        + _mm256_extract_epi64(totalAmount, 2) + _mm256_extract_epi64(totalAmount, 3);
+#endif
 }
 
 // Compute balances that count as dust and are burned if 75% of spectrum hash map is filled.
@@ -58,14 +155,28 @@ static void updateAndAnalzeEntityCategoryPopulations()
 {
     PROFILE_SCOPE();
     static_assert(MAX_SUPPLY < (1llu << entityCategoryCount));
-    setMem(entityCategoryPopulations, sizeof(entityCategoryPopulations), 0);
 
-    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
+    // Count populations of each chunk in parallel, then add them up
+    static unsigned int chunkPopulations[spectrumChunkCount][entityCategoryCount];
+    spectrumJob.run([](void*, unsigned int chunk)
+        {
+            unsigned int* populations = chunkPopulations[chunk];
+            setMem(populations, sizeof(chunkPopulations[0]), 0);
+            for (unsigned int i = chunk * spectrumChunkSize; i < (chunk + 1) * spectrumChunkSize; i += spectrumBalancesPerBlock)
+            {
+                for (unsigned int mask = getSpectrumBalancesInRange(i, 1, maxSpectrumBalance); mask; mask &= mask - 1)
+                {
+                    populations[63 - __lzcnt64(spectrumBalances[i + _tzcnt_u32(mask)])]++;
+                }
+            }
+        }, nullptr, spectrumChunkCount);
+
+    setMem(entityCategoryPopulations, sizeof(entityCategoryPopulations), 0);
+    for (unsigned int chunk = 0; chunk < spectrumChunkCount; chunk++)
     {
-        const unsigned long long balance = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
-        if (balance)
+        for (unsigned int categoryIndex = 0; categoryIndex < entityCategoryCount; categoryIndex++)
         {
-            entityCategoryPopulations[63 - __lzcnt64(balance)]++;
+            entityCategoryPopulations[categoryIndex] += chunkPopulations[chunk][categoryIndex];
         }
     }
 
@@ -151,42 +262,172 @@ private:
     DustBurning* buf;
 };
 
-// Clean up spectrum hash map, removing all entities with balance 0. Updates spectrumInfo.
-static void reorganizeSpectrum()
+// Log the burns that burnDust() will do, in the order of the former sequential burning: first all balances
+// <= dustThresholdBurnAll, then every second balance <= dustThresholdBurnHalf among the remaining ones (by index).
+static void logDustBurns()
+{
+    DustBurnLogger dbl;
+    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i += spectrumBalancesPerBlock)
+    {
+        for (unsigned int mask = getSpectrumBalancesInRange(i, 1, dustThresholdBurnAll); mask; mask &= mask - 1)
+        {
+            const unsigned int j = i + _tzcnt_u32(mask);
+            dbl.addDustBurn(spectrum[j].publicKey, spectrumBalances[j]);
+        }
+    }
+    unsigned int countBurnCandidates = 0;
+    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i += spectrumBalancesPerBlock)
+    {
+        for (unsigned int mask = getSpectrumBalancesInRange(i, dustThresholdBurnAll + 1, dustThresholdBurnHalf); mask; mask &= mask - 1)
+        {
+            if (++countBurnCandidates & 1)
+            {
+                const unsigned int j = i + _tzcnt_u32(mask);
+                dbl.addDustBurn(spectrum[j].publicKey, spectrumBalances[j]);
+            }
+        }
+    }
+    dbl.finished();
+}
+
+// Burn every balance <= dustThresholdBurnAll and every second balance <= dustThresholdBurnHalf among the remaining
+// ones (counted by index), in parallel chunks. Each chunk needs to know the number of candidates for burning half in
+// the chunks before it, which are counted in a first parallel pass. Acquire no lock.
+static void burnDust()
 {
     PROFILE_SCOPE();
+    static unsigned int chunkBurnHalfCandidates[spectrumChunkCount];
+    if (dustThresholdBurnHalf > dustThresholdBurnAll)
+    {
+        spectrumJob.run([](void*, unsigned int chunk)
+            {
+                unsigned int count = 0;
+                for (unsigned int i = chunk * spectrumChunkSize; i < (chunk + 1) * spectrumChunkSize; i += spectrumBalancesPerBlock)
+                {
+                    count += __popcnt(getSpectrumBalancesInRange(i, dustThresholdBurnAll + 1, dustThresholdBurnHalf));
+                }
+                chunkBurnHalfCandidates[chunk] = count;
+            }, nullptr, spectrumChunkCount);
 
-    unsigned long long spectrumReorgStartTick = __rdtsc();
+        // Exclusive prefix sum: number of candidates in the chunks before
+        unsigned int count = 0;
+        for (unsigned int chunk = 0; chunk < spectrumChunkCount; chunk++)
+        {
+            const unsigned int chunkCount = chunkBurnHalfCandidates[chunk];
+            chunkBurnHalfCandidates[chunk] = count;
+            count += chunkCount;
+        }
+    }
+    else
+    {
+        setMem(chunkBurnHalfCandidates, sizeof(chunkBurnHalfCandidates), 0);
+    }
 
-    EntityRecord* reorgSpectrum = (EntityRecord*)commonBuffers.acquireBuffer(spectrumSizeInBytes);
-    ASSERT(reorgSpectrum);
-    setMem(reorgSpectrum, spectrumSizeInBytes, 0);
-    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
+    spectrumJob.run([](void*, unsigned int chunk)
+        {
+            unsigned int countBurnCandidates = chunkBurnHalfCandidates[chunk];
+            for (unsigned int i = chunk * spectrumChunkSize; i < (chunk + 1) * spectrumChunkSize; i += spectrumBalancesPerBlock)
+            {
+                unsigned int burnMask = getSpectrumBalancesInRange(i, 1, dustThresholdBurnAll);
+                for (unsigned int mask = getSpectrumBalancesInRange(i, dustThresholdBurnAll + 1, dustThresholdBurnHalf); mask; mask &= mask - 1)
+                {
+                    if (++countBurnCandidates & 1)
+                        burnMask |= mask & (0 - mask);
+                }
+                for (; burnMask; burnMask &= burnMask - 1)
+                {
+                    const unsigned int j = i + _tzcnt_u32(burnMask);
+                    spectrum[j].outgoingAmount = spectrum[j].incomingAmount;
+                    spectrumBalances[j] = 0;
+                }
+            }
+        }, nullptr, spectrumChunkCount);
+}
+
+// Compute spectrum digests of subtree with leafCount leaves (power of 2) starting at firstLeaf, including the root of
+// the subtree. The digests of each level are stored after those of the level below.
+static void computeSpectrumDigestSubtree(unsigned int firstLeaf, unsigned int leafCount)
+{
+    for (unsigned int i = firstLeaf; i < firstLeaf + leafCount; i++)
+    {
+        KangarooTwelve64To32(&spectrum[i], &spectrumDigests[i]);
+    }
+    unsigned long long previousLevelBeginning = 0;
+    unsigned int numberOfLeafs = SPECTRUM_CAPACITY;
+    while (leafCount > 1)
     {
-        if (spectrum[i].incomingAmount - spectrum[i].outgoingAmount)
+        const unsigned long long levelBeginning = previousLevelBeginning + numberOfLeafs;
+        for (unsigned int i = firstLeaf; i < firstLeaf + leafCount; i += 2)
         {
-            unsigned int index = spectrum[i].publicKey.m256i_u32[0] & (SPECTRUM_CAPACITY - 1);
+            KangarooTwelve64To32(&spectrumDigests[previousLevelBeginning + i], &spectrumDigests[levelBeginning + (i >> 1)]);
+        }
 
-        iteration:
-            if (isZero(reorgSpectrum[index].publicKey))
+        previousLevelBeginning = levelBeginning;
+        numberOfLeafs >>= 1;
+        firstLeaf >>= 1;
+        leafCount >>= 1;
+    }
+}
+
+// Compute all spectrum digests from scratch. The lower subtrees are hashed in parallel, on the APs if useStartupWorkers
+// is true (only use it in initialize() before the processors are started), otherwise with spectrumJob.
+static void computeSpectrumDigests(bool useStartupWorkers = false)
+{
+    constexpr unsigned int subtreeCount = (SPECTRUM_CAPACITY >= 1024) ? 1024 : 1;
+    constexpr unsigned int subtreeLeafCount = SPECTRUM_CAPACITY / subtreeCount;
+    if (subtreeCount == 1)
+    {
+        computeSpectrumDigestSubtree(0, SPECTRUM_CAPACITY);
+        return;
+    }
+
+    if (useStartupWorkers)
+    {
+        startupWorkers.parallelFor([](void*, unsigned long long subtree)
             {
-                copyMem(&reorgSpectrum[index], &spectrum[i], sizeof(EntityRecord));
-            }
-            else
+                computeSpectrumDigestSubtree((unsigned int)subtree * subtreeLeafCount, subtreeLeafCount);
+            }, nullptr, subtreeCount);
+    }
+    else
+    {
+        spectrumJob.run([](void*, unsigned int subtree)
             {
-                index = (index + 1) & (SPECTRUM_CAPACITY - 1);
+                computeSpectrumDigestSubtree(subtree * subtreeLeafCount, subtreeLeafCount);
+            }, nullptr, subtreeCount);
+    }
 
-                goto iteration;
-            }
+    // Hash upper levels on top of the subtree roots
+    unsigned long long previousLevelBeginning = 0;
+    unsigned int numberOfLeafs = SPECTRUM_CAPACITY;
+    while (numberOfLeafs > subtreeCount)
+    {
+        previousLevelBeginning += numberOfLeafs;
+        numberOfLeafs >>= 1;
+    }
+    while (numberOfLeafs > 1)
+    {
+        const unsigned long long levelBeginning = previousLevelBeginning + numberOfLeafs;
+        for (unsigned int i = 0; i < numberOfLeafs; i += 2)
+        {
+            KangarooTwelve64To32(&spectrumDigests[previousLevelBeginning + i], &spectrumDigests[levelBeginning + (i >> 1)]);
         }
+        previousLevelBeginning = levelBeginning;
+        numberOfLeafs >>= 1;
     }
-    copyMem(spectrum, reorgSpectrum, SPECTRUM_CAPACITY * sizeof(EntityRecord));
-    commonBuffers.releaseBuffer(reorgSpectrum);
+}
 
+// Update the spectrum digests at the end of a tick: rehash the entities with a transfer in the given tick and the
+// nodes above them. The root digest is spectrumDigests[(SPECTRUM_CAPACITY * 2 - 1) - 1]. Caller must hold spectrumLock.
+static void updateSpectrumDigests(unsigned int tick)
+{
     unsigned int digestIndex;
     for (digestIndex = 0; digestIndex < SPECTRUM_CAPACITY; digestIndex++)
     {
-        KangarooTwelve64To32(&spectrum[digestIndex], &spectrumDigests[digestIndex]);
+        if (spectrum[digestIndex].latestIncomingTransferTick == tick || spectrum[digestIndex].latestOutgoingTransferTick == tick)
+        {
+            KangarooTwelve64To32(&spectrum[digestIndex], &spectrumDigests[digestIndex]);
+            spectrumChangeFlags[digestIndex >> 6] |= (1ULL << (digestIndex & 63));
+        }
     }
     unsigned int previousLevelBeginning = 0;
     unsigned int numberOfLeafs = SPECTRUM_CAPACITY;
@@ -194,18 +435,110 @@ static void reorganizeSpectrum()
     {
         for (unsigned int i = 0; i < numberOfLeafs; i += 2)
         {
-            KangarooTwelve64To32(&spectrumDigests[previousLevelBeginning + i], &spectrumDigests[digestIndex++]);
+            if (spectrumChangeFlags[i >> 6] & (3ULL << (i & 63)))
+            {
+                KangarooTwelve64To32(&spectrumDigests[previousLevelBeginning + i], &spectrumDigests[digestIndex]);
+                spectrumChangeFlags[i >> 6] &= ~(3ULL << (i & 63));
+                spectrumChangeFlags[i >> 7] |= (1ULL << ((i >> 1) & 63));
+            }
+            digestIndex++;
         }
-
         previousLevelBeginning += numberOfLeafs;
         numberOfLeafs >>= 1;
     }
+    spectrumChangeFlags[0] = 0;
+}
+
+// Clean up spectrum hash map, removing all entities with balance 0. Updates spectrumInfo.
+static void reorganizeSpectrum()
+{
+    PROFILE_SCOPE();
+
+    unsigned long long spectrumReorgStartTick = __rdtsc();
+
+    EntityRecord* reorgSpectrum = (EntityRecord*)commonBuffers.acquireBuffer(spectrumSizeInBytes);
+    ASSERT(reorgSpectrum);
+    spectrumJob.run([](void* reorgSpectrum, unsigned int chunk)
+        {
+            setMem((EntityRecord*)reorgSpectrum + chunk * spectrumChunkSize, spectrumChunkSize * sizeof(EntityRecord), 0);
+        }, reorgSpectrum, spectrumChunkCount);
+
+    // Insert in order of index, so the resulting hash map is the same on all nodes
+    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i += spectrumBalancesPerBlock)
+    {
+        // Only the records with balance > 0 are touched, found by scanning the balance column
+        for (unsigned int mask = getSpectrumBalancesInRange(i, 1, maxSpectrumBalance); mask; mask &= mask - 1)
+        {
+            const EntityRecord& record = spectrum[i + _tzcnt_u32(mask)];
+            unsigned int index = record.publicKey.m256i_u32[0] & (SPECTRUM_CAPACITY - 1);
+
+        iteration:
+            if (isZero(reorgSpectrum[index].publicKey))
+            {
+                copyMem(&reorgSpectrum[index], &record, sizeof(EntityRecord));
+            }
+            else
+            {
+                index = (index + 1) & (SPECTRUM_CAPACITY - 1);
+
+                goto iteration;
+            }
+        }
+    }
+    spectrumJob.run([](void* reorgSpectrum, unsigned int chunk)
+        {
+            copyMem(spectrum + chunk * spectrumChunkSize, (EntityRecord*)reorgSpectrum + chunk * spectrumChunkSize, spectrumChunkSize * sizeof(EntityRecord));
+        }, reorgSpectrum, spectrumChunkCount);
+    commonBuffers.releaseBuffer(reorgSpectrum);
+
+    rebuildSpectrumBalances();
+
+    computeSpectrumDigests();
 
     updateSpectrumInfo();
 
     spectrumReorgTotalExecutionTicks += __rdtsc() - spectrumReorgStartTick;
 }
 
+// Anti-dust feature: burn dust balances and remove entities with balance 0 from the hash map, to keep hash map lookup
+// fast. Logs spectrum stats before and after if LOG_SPECTRUM is set. Caller has to hold spectrumLock.
+static void runAntiDust()
+{
+    PROFILE_SCOPE();
+
+    // Update anti-dust burn thresholds (and log spectrum stats before burning)
+    updateAndAnalzeEntityCategoryPopulations();
+#if LOG_SPECTRUM
+    logSpectrumStats();
+
+    // Log the burns before burning in parallel, so the log messages keep their order
+    logDustBurns();
+#endif
+
+    burnDust();
+
+    // Remove entries with balance zero from hash map
+    reorganizeSpectrum();
+
+#if LOG_SPECTRUM
+    // Log spectrum stats after burning
+    updateAndAnalzeEntityCategoryPopulations();
+    logSpectrumStats();
+#endif
+}
+
+// Run anti-dust if the spectrum is filled to antiDustSpectrumFill. Called by the tick processor at the end of each
+// tick, so the transfer that hits the fill level isn't stalled and all nodes burn at the same point.
+static void runAntiDustIfNeeded()
+{
+    ACQUIRE(spectrumLock);
+    if (spectrumInfo.numberOfEntities >= antiDustSpectrumFill)
+    {
+        runAntiDust();
+    }
+    RELEASE(spectrumLock);
+}
+
 static int spectrumIndex(const m256i& publicKey)
 {
     if (isZero(publicKey))
@@ -255,72 +588,11 @@ static void increaseEnergy(const m256i& publicKey, long long amount)
 
         ACQUIRE(spectrumLock);
 
-        // Anti-dust feature: prevent that spectrum fills to more than 75% of capacity to keep hash map lookup fast
-        if (spectrumInfo.numberOfEntities >= (SPECTRUM_CAPACITY / 2) + (SPECTRUM_CAPACITY / 4))
+        // Anti-dust usually runs at the end of the tick (see runAntiDustIfNeeded()). Only if a single tick fills the
+        // spectrum far beyond, it needs to run immediately to keep the hash map from filling up.
+        if (spectrumInfo.numberOfEntities >= antiDustEmergencySpectrumFill)
         {
-            // Update anti-dust burn thresholds (and log spectrum stats before burning)
-            updateAndAnalzeEntityCategoryPopulations();
-#if LOG_SPECTRUM
-            logSpectrumStats();
-#endif
-
-            // Burn the dust and log the burns. The extra scope is needed to make sure that DurstBurnLogger is
-            // destructed (and its common buffer is released) before reorganizeSpectrum() is called.
-            {
-#if LOG_SPECTRUM
-                DustBurnLogger dbl;
-#endif
-
-                if (dustThresholdBurnAll > 0)
-                {
-                    // Burn every balance with balance < dustThresholdBurnAll
-                    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
-                    {
-                        const unsigned long long balance = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
-                        if (balance <= dustThresholdBurnAll && balance)
-                        {
-                            spectrum[i].outgoingAmount = spectrum[i].incomingAmount;
-#if LOG_SPECTRUM
-                            dbl.addDustBurn(spectrum[i].publicKey, balance);
-#endif
-                        }
-                    }
-                }
-
-                if (dustThresholdBurnHalf > 0)
-                {
-                    // Burn every second balance with balance < dustThresholdBurnHalf
-                    unsigned int countBurnCanadiates = 0;
-                    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
-                    {
-                        const unsigned long long balance = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
-                        if (balance <= dustThresholdBurnHalf && balance)
-                        {
-                            if (++countBurnCanadiates & 1)
-                            {
-                                spectrum[i].outgoingAmount = spectrum[i].incomingAmount;
-#if LOG_SPECTRUM
-                                dbl.addDustBurn(spectrum[i].publicKey, balance);
-#endif
-                            }
-                        }
-                    }
-                }
-
-#if LOG_SPECTRUM
-                // Finished dust burning (pass message to log)
-                dbl.finished();
-#endif
-            }
-
-            // Remove entries with balance zero from hash map
-            reorganizeSpectrum();
-
-#if LOG_SPECTRUM
-            // Log spectrum stats after burning (before increasing energy / potenitally creating entity)
-            updateAndAnalzeEntityCategoryPopulations();
-            logSpectrumStats();
-#endif
+            runAntiDust();
         }
 
     iteration:
@@ -329,6 +601,7 @@ static void increaseEnergy(const m256i& publicKey, long long amount)
             spectrum[index].incomingAmount += amount;
             spectrum[index].numberOfIncomingTransfers++;
             spectrum[index].latestIncomingTransferTick = system.tick;
+            spectrumBalances[index] += amount;
 
             spectrumInfo.totalAmount += amount;
         }
@@ -340,6 +613,7 @@ static void increaseEnergy(const m256i& publicKey, long long amount)
                 spectrum[index].incomingAmount = amount;
                 spectrum[index].numberOfIncomingTransfers = 1;
                 spectrum[index].latestIncomingTransferTick = system.tick;
+                spectrumBalances[index] = amount;
 
                 spectrumInfo.numberOfEntities++;
                 spectrumInfo.totalAmount += amount;
@@ -378,6 +652,7 @@ static bool decreaseEnergy(const int index, long long amount)
             spectrum[index].outgoingAmount += amount;
             spectrum[index].numberOfOutgoingTransfers++;
             spectrum[index].latestOutgoingTransferTick = system.tick;
+            spectrumBalances[index] -= amount;
 
             spectrumInfo.totalAmount -= amount;
 
@@ -393,34 +668,43 @@ static bool decreaseEnergy(const int index, long long amount)
 }
 
 
-static bool loadSpectrum(const CHAR16* fileName = SPECTRUM_FILE_NAME, const CHAR16* directory = nullptr)
+// If incremental is true, the spectrum is loaded from chunk files written by saveSpectrum() with incremental = true.
+static bool loadSpectrum(const CHAR16* fileName = SPECTRUM_FILE_NAME, const CHAR16* directory = nullptr, bool incremental = false)
 {
     logToConsole(L"Loading spectrum file ...");
-    long long loadedSize = load(fileName, SPECTRUM_CAPACITY * sizeof(EntityRecord), (unsigned char*)spectrum, directory);
+    long long loadedSize = (incremental)
+        ? loadIncrementalFile(fileName, SPECTRUM_CAPACITY * sizeof(EntityRecord), (unsigned char*)spectrum, directory)
+        : load(fileName, SPECTRUM_CAPACITY * sizeof(EntityRecord), (unsigned char*)spectrum, directory);
     if (loadedSize != SPECTRUM_CAPACITY * sizeof(EntityRecord))
     {
         logStatusToConsole(L"EFI_FILE_PROTOCOL.Read() reads invalid number of bytes", loadedSize, __LINE__);
 
         return false;
     }
+    rebuildSpectrumBalances();
     updateSpectrumInfo();
     return true;
 }
 
-static bool saveSpectrum(const CHAR16* fileName = SPECTRUM_FILE_NAME, const CHAR16* directory = nullptr)
+// If incremental is true, the spectrum is saved in chunks and only chunks changed since the last save are written
+// (used for node state snapshots).
+static bool saveSpectrum(const CHAR16* fileName = SPECTRUM_FILE_NAME, const CHAR16* directory = nullptr, bool incremental = false)
 {
     logToConsole(L"Saving spectrum file...");
 
     const unsigned long long beginningTick = __rdtsc();
 
+    unsigned long long writtenSize = SPECTRUM_CAPACITY * sizeof(EntityRecord);
     ACQUIRE(spectrumLock);
-    long long savedSize = save(fileName, SPECTRUM_CAPACITY * sizeof(EntityRecord), (unsigned char*)spectrum, directory);
+    long long savedSize = (incremental)
+        ? saveIncrementalFile(fileName, SPECTRUM_CAPACITY * sizeof(EntityRecord), (unsigned char*)spectrum, directory, &writtenSize)
+        : save(fileName, SPECTRUM_CAPACITY * sizeof(EntityRecord), (unsigned char*)spectrum, directory);
     RELEASE(spectrumLock);
 
     if (savedSize == SPECTRUM_CAPACITY * sizeof(EntityRecord))
     {
-        setNumber(message, savedSize, TRUE);
-        appendText(message, L" bytes of the spectrum data are saved (");
+        setNumber(message, writtenSize, TRUE);
+        appendText(message, L" bytes of the spectrum data are written (");
         appendNumber(message, (__rdtsc() - beginningTick) * 1000000 / frequency, TRUE);
         appendText(message, L" microseconds).");
         logToConsole(message);
@@ -432,10 +716,12 @@ static bool saveSpectrum(const CHAR16* fileName = SPECTRUM_FILE_NAME, const CHAR
 static bool initSpectrum()
 {
     if (!allocPoolWithErrorLog(L"spectrum", spectrumSizeInBytes, (void**)&spectrum, __LINE__)
+        || !allocPoolWithErrorLog(L"spectrumBalances", spectrumBalancesSizeInBytes, (void**)&spectrumBalances, __LINE__)
         || !allocPoolWithErrorLog(L"spectrumDigests", spectrumDigestsSizeInByte, (void**)&spectrumDigests, __LINE__))
     {
         return false;
     }
+    setMem(spectrumBalances, spectrumBalancesSizeInBytes, 0xff); // all slots free (spectrumBalanceOfFreeSlot)
     spectrumLock = 0;
 
     return true;
@@ -448,6 +734,11 @@ static void deinitSpectrum()
         freePool(spectrumDigests);
         spectrumDigests = nullptr;
     }
+    if (spectrumBalances)
+    {
+        freePool(spectrumBalances);
+        spectrumBalances = nullptr;
+    }
     if (spectrum)
     {
         freePool(spectrum);
@@ -0,0 +1,152 @@
+// concurrent execution and timing of the stages of the epoch transition
+
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+#include <lib/platform_efi/uefi.h>
+
+#include "platform/assert.h"
+#include "platform/concurrency.h"
+
+
+// Stages of the epoch transition (in order of execution in endEpoch() / beginEpoch())
+enum EpochTransitionStage
+{
+    EPOCH_TRANSITION_END_EPOCH_PROCEDURES = 0,
+    EPOCH_TRANSITION_UNIVERSE_DIGEST,
+    EPOCH_TRANSITION_COMPUTER_DIGEST,
+    EPOCH_TRANSITION_REVENUE_COMPUTATION,
+    EPOCH_TRANSITION_IPOS_AND_REVENUE_PAYOUT,
+    EPOCH_TRANSITION_SPECTRUM_REORG,
+    EPOCH_TRANSITION_UNIVERSE_REORG,
+    EPOCH_TRANSITION_TICK_STORAGE,
+    EPOCH_TRANSITION_BEGIN_EPOCH,
+    EPOCH_TRANSITION_STAGE_COUNT
+};
+
+static const CHAR16* const epochTransitionStageNames[EPOCH_TRANSITION_STAGE_COUNT] = {
+    L"END_EPOCH", L"universe digest", L"computer digest", L"revenue", L"IPOs + payout",
+    L"spectrum reorg", L"universe reorg", L"tick storage", L"beginEpoch"
+};
+
+
+// Runs independent stages of the epoch transition concurrently. The tick processor adds a group of stages with
+// add() and calls run(), which processes stages itself until none is left and waits until the stages taken by
+// other processors are finished. The request processors, which are parked during the epoch transition, take
+// stages with tryRunStage() in their waiting loop. Stages must not depend on each other or share unprotected data.
+// The duration of each stage (in TSC ticks) is kept until the next transition for reporting in logInfo().
+class EpochTransitionStages
+{
+public:
+    typedef void (*StageFunction)();
+
+    // Start timing of a new epoch transition (only tick processor).
+    void beginTransition()
+    {
+        for (unsigned int i = 0; i < EPOCH_TRANSITION_STAGE_COUNT; ++i)
+            stageTicks[i] = 0;
+        totalTicks = 0;
+        transitionStartTick = __rdtsc();
+    }
+
+    // Finish timing of the epoch transition (only tick processor).
+    void endTransition()
+    {
+        totalTicks = __rdtsc() - transitionStartTick;
+        ++transitionCount;
+    }
+
+    // Record duration of stage that has been executed sequentially by the tick processor.
+    void setStageTicks(EpochTransitionStage stage, unsigned long long ticks)
+    {
+        ASSERT(stage < EPOCH_TRANSITION_STAGE_COUNT);
+        stageTicks[stage] = ticks;
+    }
+
+    // Add stage to current group (only tick processor, before calling run()).
+    void add(EpochTransitionStage stage, StageFunction function)
+    {
+        ASSERT(stage < EPOCH_TRANSITION_STAGE_COUNT);
+        ACQUIRE(lock);
+        ASSERT(queuedCount < EPOCH_TRANSITION_STAGE_COUNT);
+        queue[queuedCount].stage = stage;
+        queue[queuedCount].function = function;
+        ++queuedCount;
+        _InterlockedIncrement(&unfinishedCount);
+        RELEASE(lock);
+    }
+
+    // Run all stages added since last call and return when all of them are finished (only tick processor).
+    void run()
+    {
+        while (tryRunStage())
+        {
+        }
+        WAIT_WHILE(unfinishedCount);
+
+        ACQUIRE(lock);
+        queuedCount = 0;
+        nextStage = 0;
+        RELEASE(lock);
+    }
+
+    // Take and execute one pending stage, if any. Returns false if there is no pending stage.
+    // Called by run() and by the request processors while waiting in the epoch transition.
+    bool tryRunStage()
+    {
+        // Cheap check without lock, so waiting processors don't contend for the lock
+        if (nextStage == queuedCount)
+            return false;
+
+        ACQUIRE(lock);
+        if (nextStage == queuedCount)
+        {
+            RELEASE(lock);
+            return false;
+        }
+        const QueueEntry entry = queue[nextStage++];
+        RELEASE(lock);
+
+        const unsigned long long startTick = __rdtsc();
+        entry.function();
+        stageTicks[entry.stage] = __rdtsc() - startTick;
+        _InterlockedDecrement(&unfinishedCount);
+        return true;
+    }
+
+    // Duration of stage in last epoch transition (TSC ticks, 0 if stage has been skipped)
+    unsigned long long getStageTicks(EpochTransitionStage stage) const
+    {
+        ASSERT(stage < EPOCH_TRANSITION_STAGE_COUNT);
+        return stageTicks[stage];
+    }
+
+    // Duration of whole last epoch transition (TSC ticks)
+    unsigned long long getTotalTicks() const
+    {
+        return totalTicks;
+    }
+
+    // Number of epoch transitions since the node has been started
+    unsigned int getTransitionCount() const
+    {
+        return transitionCount;
+    }
+
+private:
+    struct QueueEntry
+    {
+        EpochTransitionStage stage;
+        StageFunction function;
+    };
+
+    QueueEntry queue[EPOCH_TRANSITION_STAGE_COUNT];
+    volatile unsigned long long stageTicks[EPOCH_TRANSITION_STAGE_COUNT];
+    unsigned long long transitionStartTick;
+    unsigned long long totalTicks;
+    unsigned int transitionCount;
+    volatile unsigned int queuedCount;
+    volatile unsigned int nextStage;
+    volatile long unfinishedCount;
+    volatile char lock;
+};
@@ -0,0 +1,171 @@
+// cache of the restored tick votes of recently requested ticks for answering RequestQuorumTick
+
+#pragma once
+
+#include "network_messages/tick.h"
+
+#include "platform/memory_util.h"
+#include "platform/concurrency.h"
+
+#include "ticking/tick_storage.h"
+
+#include "public_settings.h"
+
+
+// Votes of a tick restored from the compact tick storage, ordered with the votes of the majority (most common shared
+// digests, see TickVoteSharedDigestsTable) first. Sync clients and lagging peers request the same ticks from many
+// nodes and repeatedly, so the votes of ticks that cannot change anymore (tick < system.tick, which means that quorum
+// has been reached, or ticks of the previous epoch) are kept and reused. Votes of other ticks are restored again
+// when requested.
+// Each slot holds the votes of one tick (tick % slotCount) in its published entry and has a spare entry. Votes are
+// restored into the spare entry without holding the slot lock, which is then swapped in. While one processor
+// restores the votes of a tick, concurrent requests of the same tick get the previously published votes.
+class QuorumTickCache
+{
+public:
+    static constexpr unsigned int slotCount = 8;
+
+    struct Entry
+    {
+        Tick votes[NUMBER_OF_COMPUTORS]; // indexed by computor, only valid for computors in order
+        unsigned short order[NUMBER_OF_COMPUTORS]; // computor indices of available votes, majority first
+        unsigned short voteCount;
+        unsigned short majorityCount; // number of votes at the beginning of order that share the majority digests
+        unsigned int tick;
+        unsigned short epoch; // 0 if entry is invalid
+        bool final;
+        volatile long users; // number of processors using the entry for a response
+    };
+
+    // Init at node startup
+    bool init()
+    {
+        if (!allocPoolWithErrorLog(L"quorumTickCache", 2 * slotCount * sizeof(Entry), (void**)&entries, __LINE__))
+            return false;
+        setMem(entries, 2 * slotCount * sizeof(Entry), 0);
+        for (unsigned int i = 0; i < slotCount; ++i)
+        {
+            slots[i].published = &entries[2 * i];
+            slots[i].spare = &entries[2 * i + 1];
+            slots[i].building = false;
+            slots[i].lock = 0;
+        }
+        return true;
+    }
+
+    // Cleanup at node shutdown
+    void deinit()
+    {
+        if (entries)
+        {
+            freePool(entries);
+            entries = nullptr;
+        }
+    }
+
+    // Invalidate all entries (for example when tick storage is reset)
+    void reset()
+    {
+        for (unsigned int i = 0; i < slotCount; ++i)
+        {
+            ACQUIRE(slots[i].lock);
+            slots[i].published->epoch = 0;
+            slots[i].published->final = false;
+            RELEASE(slots[i].lock);
+        }
+    }
+
+    // Return entry with votes of tick stored at tickIndex in tick storage with given epoch. The votes are restored from
+    // tick storage unless the entry already holds the final votes of the tick or another processor is restoring the
+    // votes of the tick (in this case the votes published before are returned). If final is set, the votes of the tick
+    // are not changed anymore and the entry is kept for later calls. Call release() when done.
+    Entry& acquire(unsigned int tick, unsigned int tickIndex, unsigned short epoch, bool final)
+    {
+        Slot& slot = slots[tick % slotCount];
+        while (true)
+        {
+            ACQUIRE(slot.lock);
+            Entry* entry = slot.published;
+            const bool sameTick = entry->tick == tick && entry->epoch == epoch;
+            if (sameTick && (entry->final || slot.building))
+            {
+                _InterlockedIncrement(&entry->users);
+                RELEASE(slot.lock);
+                return *entry;
+            }
+            if (!slot.building)
+                break;
+
+            // another processor is restoring the votes of another tick in this slot
+            RELEASE(slot.lock);
+            _mm_pause();
+        }
+
+        // restore votes into spare entry without holding the slot lock (wait until last user of the spare is done)
+        slot.building = true;
+        Entry* entry = slot.spare;
+        RELEASE(slot.lock);
+        while (entry->users)
+            _mm_pause();
+        build(*entry, tickIndex, epoch);
+        entry->tick = tick;
+        entry->epoch = epoch;
+        entry->final = final;
+        entry->users = 1;
+
+        // publish
+        ACQUIRE(slot.lock);
+        slot.spare = slot.published;
+        slot.published = entry;
+        slot.building = false;
+        RELEASE(slot.lock);
+        return *entry;
+    }
+
+    // Finish using entry returned by acquire()
+    void release(Entry& entry)
+    {
+        _InterlockedDecrement(&entry.users);
+    }
+
+private:
+    struct Slot
+    {
+        Entry* published;
+        Entry* spare;
+        bool building;
+        volatile char lock;
+    };
+
+    // Restore votes from tick storage
+    static void build(Entry& entry, unsigned int tickIndex, unsigned short epoch)
+    {
+        const CompactTick* tsCompTicks = TickStorage::TicksAccess::getByTickIndex(tickIndex);
+        const unsigned char majorityIndex = TickStorage::TicksAccess::getMostCommonSharedDigestsIndex(tickIndex);
+        unsigned short otherVotes[NUMBER_OF_COMPUTORS];
+        unsigned short otherCount = 0;
+        entry.voteCount = 0;
+        for (unsigned short i = 0; i < NUMBER_OF_COMPUTORS; i++)
+        {
+            if (tsCompTicks[i].epoch != epoch)
+                continue;
+            TickStorage::TicksAccess::acquireLock(i);
+            const bool available = TickStorage::TicksAccess::get(tickIndex, i, entry.votes[i]);
+            const bool majority = tsCompTicks[i].sharedDigestsIndex == majorityIndex;
+            TickStorage::TicksAccess::releaseLock(i);
+            if (available && entry.votes[i].epoch == epoch)
+            {
+                if (majority)
+                    entry.order[entry.voteCount++] = i;
+                else
+                    otherVotes[otherCount++] = i;
+            }
+        }
+        entry.majorityCount = entry.voteCount;
+        for (unsigned short i = 0; i < otherCount; i++)
+            entry.order[entry.voteCount++] = otherVotes[i];
+    }
+
+    Entry* entries = nullptr;
+    Slot slots[slotCount];
+};
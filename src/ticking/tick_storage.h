@@ -9,16 +9,121 @@
 #include "platform/debugging.h"
 #include "platform/global_var.h"
 
+#include "contracts/math_lib.h"
+
 #include "public_settings.h"
 
+#include <lib/platform_common/processor.h>
+
 #if TICK_STORAGE_AUTOSAVE_MODE
 static unsigned short SNAPSHOT_METADATA_FILE_NAME[] = L"snapshotMetadata.???";
 static unsigned short SNAPSHOT_TICK_DATA_FILE_NAME[] = L"snapshotTickdata.???";
 static unsigned short SNAPSHOT_TICKS_FILE_NAME[] = L"snapshotTicks.???";
+static unsigned short SNAPSHOT_TICK_VOTE_DIGESTS_FILE_NAME[] = L"snapshotTickVoteDigests.???";
+static unsigned short SNAPSHOT_TICK_VOTE_OVERFLOW_FILE_NAME[] = L"snapshotTickVoteOverflow.???";
 static unsigned short SNAPSHOT_TICK_TRANSACTION_OFFSET_FILE_NAME[] = L"snapshotTickTransactionOffsets.???";
 static unsigned short SNAPSHOT_TRANSACTIONS_FILE_NAME[] = L"snapshotTickTransaction.???";
 #endif
 constexpr unsigned short INVALIDATED_TICK_DATA = 0xffff;
+
+// Number of bits needed for storing values up to maxValue
+constexpr unsigned int getBitCount(unsigned long long maxValue)
+{
+    unsigned int bits = 0;
+    while (maxValue)
+    {
+        ++bits;
+        maxValue >>= 1;
+    }
+    return bits;
+}
+
+// Max number of distinct TickVoteSharedDigests stored per tick. If all entries are referenced by votes of other
+// computors, at most NUMBER_OF_COMPUTORS - TICK_VOTE_SHARED_DIGESTS_PER_TICK < QUORUM computors can still vote with
+// new shared digests, so the shared digests of a vote that can reach quorum always fit into the table (if the tick
+// has got an overflow block, see below).
+constexpr unsigned char TICK_VOTE_SHARED_DIGESTS_PER_TICK = NUMBER_OF_COMPUTORS - QUORUM + 1;
+
+// Number of TickVoteSharedDigests stored inline per tick. Usually almost all computors agree on the previous tick, so
+// a tick has very few distinct shared digests. The other entries are stored in an overflow block, which is only
+// allocated for ticks with more distinct shared digests.
+constexpr unsigned char TICK_VOTE_SHARED_DIGESTS_INLINE = 8;
+
+// Number of overflow blocks for the ticks of the current epoch (one per 256 ticks). If all are in use, ticks without
+// overflow block can only store votes with up to TICK_VOTE_SHARED_DIGESTS_INLINE distinct shared digests.
+constexpr unsigned long long TICK_VOTE_SHARED_DIGESTS_OVERFLOW_BLOCKS = (MAX_NUMBER_OF_TICKS_PER_EPOCH + 255) / 256;
+
+// Fields of a tick vote that are the same in the votes of all computors that agree on the previous tick (time and
+// digests of the state before the tick). They are stored once per tick in a TickVoteSharedDigestsTable.
+struct TickVoteSharedDigests
+{
+    unsigned long long time; // millisecond, second, minute, hour, day, month, year of Tick
+
+    unsigned int prevResourceTestingDigest;
+    unsigned int prevTransactionBodyDigest;
+
+    m256i prevSpectrumDigest;
+    m256i prevUniverseDigest;
+    m256i prevComputerDigest;
+
+    bool operator==(const TickVoteSharedDigests& other) const
+    {
+        return time == other.time
+            && prevResourceTestingDigest == other.prevResourceTestingDigest
+            && prevTransactionBodyDigest == other.prevTransactionBodyDigest
+            && prevSpectrumDigest == other.prevSpectrumDigest
+            && prevUniverseDigest == other.prevUniverseDigest
+            && prevComputerDigest == other.prevComputerDigest;
+    }
+};
+
+// Distinct TickVoteSharedDigests of the votes of one tick. The first TICK_VOTE_SHARED_DIGESTS_INLINE entries are
+// stored inline, the others in the overflow block of the tick. Entries are never replaced while referenced by a stored
+// vote. A vote with new shared digests is rejected if all entries are in use (see TICK_VOTE_SHARED_DIGESTS_PER_TICK)
+// or if all inline entries are in use and no overflow block is left.
+struct TickVoteSharedDigestsTable
+{
+    TickVoteSharedDigests entries[TICK_VOTE_SHARED_DIGESTS_INLINE];
+    unsigned short refCounts[TICK_VOTE_SHARED_DIGESTS_INLINE];
+    unsigned int overflowBlock; // index + 1 of TickVoteSharedDigestsOverflowBlock (0 if none)
+    unsigned char count;
+    volatile char lock;
+};
+
+// Entries TICK_VOTE_SHARED_DIGESTS_INLINE to TICK_VOTE_SHARED_DIGESTS_PER_TICK - 1 of a TickVoteSharedDigestsTable
+struct TickVoteSharedDigestsOverflowBlock
+{
+    TickVoteSharedDigests entries[TICK_VOTE_SHARED_DIGESTS_PER_TICK - TICK_VOTE_SHARED_DIGESTS_INLINE];
+    unsigned short refCounts[TICK_VOTE_SHARED_DIGESTS_PER_TICK - TICK_VOTE_SHARED_DIGESTS_INLINE];
+};
+
+// Tick vote of one computor in tick storage without the shared digests (tick and computorIndex are given by the
+// position in the storage).
+struct CompactTick
+{
+    static constexpr unsigned char noSharedDigests = 0xff;
+
+    unsigned short epoch; // 0 if no vote is stored
+    unsigned char sharedDigestsIndex; // index in TickVoteSharedDigestsTable of tick
+
+    unsigned int saltedResourceTestingDigest;
+    unsigned int saltedTransactionBodyDigest;
+
+    m256i saltedSpectrumDigest;
+    m256i saltedUniverseDigest;
+    m256i saltedComputerDigest;
+
+    m256i transactionDigest;
+    m256i expectedNextTickTransactionDigest;
+
+    unsigned char signature[SIGNATURE_SIZE];
+};
+
+static_assert(sizeof(TickVoteSharedDigests) == 8 + 2 * 4 + 3 * 32, "Something is wrong with the struct size.");
+static_assert(sizeof(CompactTick) == 8 + 2 * 4 + 5 * 32 + SIGNATURE_SIZE, "Something is wrong with the struct size.");
+static_assert(TICK_VOTE_SHARED_DIGESTS_PER_TICK < CompactTick::noSharedDigests, "Index of shared digests must fit into CompactTick.");
+static_assert(TICK_VOTE_SHARED_DIGESTS_INLINE < TICK_VOTE_SHARED_DIGESTS_PER_TICK, "Inline shared digests must not exceed the maximum per tick.");
+
 // Encapsulated tick storage of current epoch that can additionally keep the last ticks of the previous epoch.
 // The number of ticks to keep from the previous epoch is TICKS_TO_KEEP_FROM_PRIOR_EPOCH (defined in public_settings.h).
 //
@@ -26,7 +131,8 @@ constexpr unsigned short INVALIDATED_TICK_DATA = 0xffff;
 //
 // It comprises:
 // - tickData (one TickData struct per tick)
-// - ticks (one Tick struct per tick and Computor)
+// - ticks (one CompactTick per tick and Computor, plus one TickVoteSharedDigestsTable per tick and overflow blocks of
+//   the tables of ticks with many distinct shared digests)
 // - tickTransactions (continuous buffer efficiently storing the variable-size transactions)
 // - tickTransactionOffsets (offsets of transactions in buffer, order in tickTransactions may differ)
 // - nextTickTransactionOffset (offset of next transaction to be added)
@@ -39,7 +145,10 @@ private:
     static constexpr unsigned long long ticksLengthCurrentEpoch = ((unsigned long long)MAX_NUMBER_OF_TICKS_PER_EPOCH) * NUMBER_OF_COMPUTORS;
     static constexpr unsigned long long ticksLengthPreviousEpoch = ((unsigned long long)TICKS_TO_KEEP_FROM_PRIOR_EPOCH) * NUMBER_OF_COMPUTORS;
     static constexpr unsigned long long ticksLength = ticksLengthCurrentEpoch + ticksLengthPreviousEpoch;
-    static constexpr unsigned long long ticksSize = ticksLength * sizeof(Tick);
+    static constexpr unsigned long long ticksSize = ticksLength * sizeof(CompactTick);
+    static constexpr unsigned long long tickVoteDigestsSize = tickDataLength * sizeof(TickVoteSharedDigestsTable);
+    static constexpr unsigned long long tickVoteOverflowBlocksLength = TICK_VOTE_SHARED_DIGESTS_OVERFLOW_BLOCKS + TICKS_TO_KEEP_FROM_PRIOR_EPOCH;
+    static constexpr unsigned long long tickVoteOverflowBlocksSize = tickVoteOverflowBlocksLength * sizeof(TickVoteSharedDigestsOverflowBlock);
 
     static constexpr unsigned long long tickTransactionsSizeCurrentEpoch = FIRST_TICK_TRANSACTION_OFFSET + (((unsigned long long)MAX_NUMBER_OF_TICKS_PER_EPOCH) * NUMBER_OF_TRANSACTIONS_PER_TICK * MAX_TRANSACTION_SIZE / TRANSACTION_SPARSENESS);
     static constexpr unsigned long long tickTransactionsSizePreviousEpoch = (((unsigned long long)TICKS_TO_KEEP_FROM_PRIOR_EPOCH) * NUMBER_OF_TRANSACTIONS_PER_TICK * MAX_TRANSACTION_SIZE / TRANSACTION_SPARSENESS);
@@ -52,6 +161,10 @@ private:
     static constexpr unsigned long long tickTransactionOffsetsSizePreviousEpoch = tickTransactionOffsetsLengthPreviousEpoch * sizeof(unsigned long long);
     static constexpr unsigned long long tickTransactionOffsetsSize = tickTransactionOffsetsLength * sizeof(unsigned long long);
 
+    // Transaction digest index: smallest power of 2 not below the number of transaction slots
+    static constexpr unsigned long long tickTransactionsDigestIndexLength = math_lib::findNextPowerOf2(tickTransactionOffsetsLength);
+    static constexpr unsigned long long tickTransactionsDigestIndexSize = tickTransactionsDigestIndexLength * sizeof(unsigned long long);
+
 
     // Tick number range of current epoch storage
     inline static unsigned int tickBegin = 0;
@@ -65,7 +178,10 @@ private:
     inline static TickData* tickDataPtr = nullptr;
 
     // Allocated ticks buffer with ticksLength elements (includes current and previous epoch data)
-    inline static Tick* ticksPtr = nullptr;
+    inline static CompactTick* ticksPtr = nullptr;
+
+    // Allocated buffer of shared digests of tick votes with tickDataLength elements (includes current and previous epoch data)
+    inline static TickVoteSharedDigestsTable* tickVoteDigestsPtr = nullptr;
 
     // Allocated tickTransactions buffer with tickTransactionsSize bytes (includes current and previous epoch data)
     inline static unsigned char* tickTransactionsPtr = nullptr;
@@ -77,7 +193,18 @@ private:
     inline static TickData* oldTickDataPtr = nullptr;
 
     // Ticks of previous epoch. Points to ticksPtr + ticksLengthCurrentEpoch
-    inline static Tick* oldTicksPtr = nullptr;
+    inline static CompactTick* oldTicksPtr = nullptr;
+
+    // Shared digests of tick votes of previous epoch. Points to tickVoteDigestsPtr + MAX_NUMBER_OF_TICKS_PER_EPOCH
+    inline static TickVoteSharedDigestsTable* oldTickVoteDigestsPtr = nullptr;
+
+    // Allocated buffer of overflow blocks of the shared digests tables with tickVoteOverflowBlocksLength elements. The
+    // first TICK_VOTE_SHARED_DIGESTS_OVERFLOW_BLOCKS are handed out to ticks of the current epoch in order, the others
+    // are used by the kept ticks of the previous epoch (one per tick).
+    inline static TickVoteSharedDigestsOverflowBlock* tickVoteOverflowBlocksPtr = nullptr;
+
+    // Number of overflow blocks handed out to ticks of the current epoch
+    inline static unsigned int tickVoteOverflowBlocksUsed = 0;
 
     // Tick transaction buffer of previous epoch. Points to tickTransactionsPtr + tickTransactionsSizeCurrentEpoch.
     inline static unsigned char* oldTickTransactionsPtr = nullptr;
@@ -85,8 +212,8 @@ private:
     // Tick transaction offsets of previous epoch. Points to tickTransactionOffsetsPtr + tickTransactionOffsetsLengthCurrentEpoch.
     inline static unsigned long long* oldTickTransactionOffsetsPtr = nullptr;
 
-    // Allocated transaction access digest buffer with current epoch transactions.
-    inline static unsigned char* tickTransactionsDigestPtr = nullptr;
+    // Allocated transaction digest index with tickTransactionsDigestIndexLength entries (includes current and previous epoch data)
+    inline static unsigned long long* tickTransactionsDigestPtr = nullptr;
 
     // Lock for securing tickData
     inline static volatile char tickDataLock = 0;
@@ -97,8 +224,59 @@ private:
     // Lock for securing tickTransactions and tickTransactionOffsets
     inline static volatile char tickTransactionsLock = 0;
 
-    // Lock for securing tickTransactions and tickTransactionsDigestPtr
-    inline static volatile char tickTransactionsDigestAccessLock = 0;
+    // Lock for securing tickVoteOverflowBlocksUsed
+    inline static volatile char tickVoteOverflowBlocksLock = 0;
+
+    // Probe statistics of the transaction digest index (since start of epoch)
+    inline static long long tickTransactionsDigestInsertCount = 0;
+    inline static long long tickTransactionsDigestInsertProbes = 0;
+    inline static long long tickTransactionsDigestMaxProbeLength = 0;
+
+    // Lookup statistics are counted per processor, because lookups run concurrently on all processors without lock.
+    // Each processor only writes its own cache line. They are summed in getStats().
+    struct alignas(64) DigestLookupCounters
+    {
+        long long count;
+        long long probes;
+    };
+    inline static DigestLookupCounters tickTransactionsDigestLookupCounters[MAX_NUMBER_OF_PROCESSORS];
+
+    // Return entry of shared digests table at index (inline or in overflow block, caller needs to hold the table lock)
+    static TickVoteSharedDigests& sharedDigestsEntry(TickVoteSharedDigestsTable& table, unsigned int index)
+    {
+        ASSERT(index < TICK_VOTE_SHARED_DIGESTS_PER_TICK);
+        if (index < TICK_VOTE_SHARED_DIGESTS_INLINE)
+            return table.entries[index];
+        ASSERT(table.overflowBlock && table.overflowBlock <= tickVoteOverflowBlocksLength);
+        return tickVoteOverflowBlocksPtr[table.overflowBlock - 1].entries[index - TICK_VOTE_SHARED_DIGESTS_INLINE];
+    }
+
+    // Return reference count of entry of shared digests table at index (caller needs to hold the table lock)
+    static unsigned short& sharedDigestsRefCount(TickVoteSharedDigestsTable& table, unsigned int index)
+    {
+        ASSERT(index < TICK_VOTE_SHARED_DIGESTS_PER_TICK);
+        if (index < TICK_VOTE_SHARED_DIGESTS_INLINE)
+            return table.refCounts[index];
+        ASSERT(table.overflowBlock && table.overflowBlock <= tickVoteOverflowBlocksLength);
+        return tickVoteOverflowBlocksPtr[table.overflowBlock - 1].refCounts[index - TICK_VOTE_SHARED_DIGESTS_INLINE];
+    }
+
+    // Hand out a cleared overflow block of the current epoch to table (caller needs to hold the table lock). Returns
+    // false if all are in use.
+    static bool allocateOverflowBlock(TickVoteSharedDigestsTable& table)
+    {
+        ACQUIRE(tickVoteOverflowBlocksLock);
+        const unsigned int block = tickVoteOverflowBlocksUsed;
+        if (block < TICK_VOTE_SHARED_DIGESTS_OVERFLOW_BLOCKS)
+            ++tickVoteOverflowBlocksUsed;
+        RELEASE(tickVoteOverflowBlocksLock);
+        if (block >= TICK_VOTE_SHARED_DIGESTS_OVERFLOW_BLOCKS)
+            return false;
+
+        setMem(tickVoteOverflowBlocksPtr + block, sizeof(TickVoteSharedDigestsOverflowBlock), 0);
+        table.overflowBlock = block + 1;
+        return true;
+    }
 
 #if TICK_STORAGE_AUTOSAVE_MODE
     struct MetaData {
@@ -107,6 +285,7 @@ private:
         unsigned int tickEnd;
         long long outTotalTransactionSize;
         unsigned long long outNextTickTransactionOffset;
+        unsigned int tickVoteOverflowBlocks;
         // may need to store more meta data here to verify consistency when loading (ie: some nodes have different configs and can't use the saved files)
     } metaData;
     inline static unsigned long long lastCheckTransactionOffset = 0; // use for save/load transaction state
@@ -119,16 +298,21 @@ private:
         prepareMetaDataFilename(epoch);
         addEpochToFileName(SNAPSHOT_TICK_DATA_FILE_NAME, sizeof(SNAPSHOT_TICK_DATA_FILE_NAME) / sizeof(SNAPSHOT_TICK_DATA_FILE_NAME[0]), epoch);
         addEpochToFileName(SNAPSHOT_TICKS_FILE_NAME, sizeof(SNAPSHOT_TICKS_FILE_NAME) / sizeof(SNAPSHOT_TICKS_FILE_NAME[0]), epoch);
+        addEpochToFileName(SNAPSHOT_TICK_VOTE_DIGESTS_FILE_NAME, sizeof(SNAPSHOT_TICK_VOTE_DIGESTS_FILE_NAME) / sizeof(SNAPSHOT_TICK_VOTE_DIGESTS_FILE_NAME[0]), epoch);
+        addEpochToFileName(SNAPSHOT_TICK_VOTE_OVERFLOW_FILE_NAME, sizeof(SNAPSHOT_TICK_VOTE_OVERFLOW_FILE_NAME) / sizeof(SNAPSHOT_TICK_VOTE_OVERFLOW_FILE_NAME[0]), epoch);
         addEpochToFileName(SNAPSHOT_TICK_TRANSACTION_OFFSET_FILE_NAME, sizeof(SNAPSHOT_TICK_TRANSACTION_OFFSET_FILE_NAME) / sizeof(SNAPSHOT_TICK_TRANSACTION_OFFSET_FILE_NAME[0]), epoch);
         addEpochToFileName(SNAPSHOT_TRANSACTIONS_FILE_NAME, sizeof(SNAPSHOT_TRANSACTIONS_FILE_NAME) / sizeof(SNAPSHOT_TRANSACTIONS_FILE_NAME[0]), epoch);
     }
-    bool saveMetaData(short epoch, unsigned int tickEnd, long long outTotalTransactionSize, unsigned long long outNextTickTransactionOffset, CHAR16* directory = NULL)
+    bool saveMetaData(short epoch, unsigned int tickEnd, long long outTotalTransactionSize, unsigned long long outNextTickTransactionOffset, unsigned int tickVoteOverflowBlocks, CHAR16* directory = NULL, bool writeFile = true)
     {
         metaData.epoch = epoch;
         metaData.tickBegin = tickBegin;
         metaData.tickEnd = tickEnd;
         metaData.outTotalTransactionSize = outTotalTransactionSize;
         metaData.outNextTickTransactionOffset = outNextTickTransactionOffset;
+        metaData.tickVoteOverflowBlocks = tickVoteOverflowBlocks;
+        if (!writeFile)
+            return true;
         auto sz = saveLargeFile(SNAPSHOT_METADATA_FILE_NAME, sizeof(metaData), (unsigned char*) & metaData, directory);
         if (sz != sizeof(metaData))
         {
@@ -146,14 +330,30 @@ private:
         }
         return true;
     }
-    bool saveTicks(unsigned long long nTick, CHAR16* directory = NULL)
+    bool saveTicks(unsigned long long nTick, unsigned int& outTickVoteOverflowBlocks, CHAR16* directory = NULL)
     {
-        long long totalWriteSize = nTick * sizeof(Tick) * NUMBER_OF_COMPUTORS;
+        long long totalWriteSize = nTick * sizeof(CompactTick) * NUMBER_OF_COMPUTORS;
         auto sz = saveLargeFile(SNAPSHOT_TICKS_FILE_NAME, totalWriteSize, (unsigned char*)ticksPtr, directory);
         if (sz != totalWriteSize)
         {
             return false;
         }
+        totalWriteSize = nTick * sizeof(TickVoteSharedDigestsTable);
+        sz = saveLargeFile(SNAPSHOT_TICK_VOTE_DIGESTS_FILE_NAME, totalWriteSize, (unsigned char*)tickVoteDigestsPtr, directory);
+        if (sz != totalWriteSize)
+        {
+            return false;
+        }
+        outTickVoteOverflowBlocks = tickVoteOverflowBlocksUsed;
+        totalWriteSize = outTickVoteOverflowBlocks * sizeof(TickVoteSharedDigestsOverflowBlock);
+        if (totalWriteSize)
+        {
+            sz = saveLargeFile(SNAPSHOT_TICK_VOTE_OVERFLOW_FILE_NAME, totalWriteSize, (unsigned char*)tickVoteOverflowBlocksPtr, directory);
+            if (sz != totalWriteSize)
+            {
+                return false;
+            }
+        }
         return true;
     }
     bool saveTickTransactionOffsets(unsigned long long nTick, CHAR16* directory = NULL)
@@ -229,6 +429,9 @@ private:
         if (metaData.tickBegin + MAX_NUMBER_OF_TICKS_PER_EPOCH < metaData.tickEnd) {
             return false;
         }
+        if (metaData.tickVoteOverflowBlocks > TICK_VOTE_SHARED_DIGESTS_OVERFLOW_BLOCKS) {
+            return false;
+        }
 #ifndef NO_UEFI
         if (metaData.epoch != EPOCH) {
             return false;
@@ -248,12 +451,30 @@ private:
     }
     bool loadTicks(unsigned long long nTick, CHAR16* directory = NULL)
     {
-        long long totalLoadSize = nTick * sizeof(Tick) * NUMBER_OF_COMPUTORS;
+        long long totalLoadSize = nTick * sizeof(CompactTick) * NUMBER_OF_COMPUTORS;
         auto sz = loadLargeFile(SNAPSHOT_TICKS_FILE_NAME, totalLoadSize, (unsigned char*)ticksPtr, directory);
         if (sz != totalLoadSize)
         {
             return false;
         }
+        totalLoadSize = nTick * sizeof(TickVoteSharedDigestsTable);
+        sz = loadLargeFile(SNAPSHOT_TICK_VOTE_DIGESTS_FILE_NAME, totalLoadSize, (unsigned char*)tickVoteDigestsPtr, directory);
+        if (sz != totalLoadSize)
+        {
+            return false;
+        }
+        for (unsigned long long i = 0; i < nTick; ++i)
+            tickVoteDigestsPtr[i].lock = 0;
+        tickVoteOverflowBlocksUsed = metaData.tickVoteOverflowBlocks;
+        totalLoadSize = tickVoteOverflowBlocksUsed * sizeof(TickVoteSharedDigestsOverflowBlock);
+        if (totalLoadSize)
+        {
+            sz = loadLargeFile(SNAPSHOT_TICK_VOTE_OVERFLOW_FILE_NAME, totalLoadSize, (unsigned char*)tickVoteOverflowBlocksPtr, directory);
+            if (sz != totalLoadSize)
+            {
+                return false;
+            }
+        }
         return true;
     }
     bool loadTickTransactionOffsets(unsigned long long nTick, CHAR16* directory = NULL)
@@ -296,7 +517,9 @@ public:
     // (1) check current meta data state
     // (2) write all missing chunks to disk
     // (3) update metadata state
-    int trySaveToFile(unsigned int epoch, unsigned int tick, CHAR16* directory = NULL)
+    // If saveMetaDataFile is false, the metadata file is not written, keeping the snapshot invalid until
+    // saveMetaDataOfLastSave() is called.
+    int trySaveToFile(unsigned int epoch, unsigned int tick, CHAR16* directory = NULL, bool saveMetaDataFile = true)
     {   
         if (tick <= tickBegin) {
             return 6;
@@ -315,8 +538,9 @@ public:
         tickData.releaseLock();
 
         logToConsole(L"Saving quorum ticks");
+        unsigned int outTickVoteOverflowBlocks = 0;
         for (int i = 0; i < NUMBER_OF_COMPUTORS; i++) ticks.acquireLock(i);
-        if (!saveTicks(nTick, directory))
+        if (!saveTicks(nTick, outTickVoteOverflowBlocks, directory))
         {
             for (int i = 0; i < NUMBER_OF_COMPUTORS; i++) ticks.releaseLock(i);
             logToConsole(L"Failed to save Ticks");
@@ -345,7 +569,7 @@ public:
         tickTransactions.releaseLock();
 
         logToConsole(L"Saving meta data");
-        if (!saveMetaData(epoch, tick, outTotalTransactionSize, outNextTickTransactionOffset, directory))
+        if (!saveMetaData(epoch, tick, outTotalTransactionSize, outNextTickTransactionOffset, outTickVoteOverflowBlocks, directory, saveMetaDataFile))
         {
             logToConsole(L"Failed to save metaData");
             return 1;
@@ -354,6 +578,14 @@ public:
         return 0;
     }
 
+    // Write metadata file of last trySaveToFile() call with saveMetaDataFile = false, marking the snapshot as valid
+    bool saveMetaDataOfLastSave(CHAR16* directory = NULL)
+    {
+        prepareMetaDataFilename(metaData.epoch);
+        auto sz = saveLargeFile(SNAPSHOT_METADATA_FILE_NAME, sizeof(metaData), (unsigned char*)&metaData, directory);
+        return sz == sizeof(metaData);
+    }
+
     // Load procedure:
     // (1) try to load metadata file
     // (2) sanity check meta data file
@@ -421,6 +653,7 @@ public:
         invalidMetaData.tickEnd = 0;
         invalidMetaData.outTotalTransactionSize = 0;
         invalidMetaData.outNextTickTransactionOffset = 0;
+        invalidMetaData.tickVoteOverflowBlocks = 0;
         prepareMetaDataFilename(epoch);
         auto sz = saveLargeFile(SNAPSHOT_METADATA_FILE_NAME, sizeof(invalidMetaData), (unsigned char*)&invalidMetaData, directory);
         if (sz != sizeof(invalidMetaData))
@@ -446,9 +679,11 @@ public:
         // TODO: allocate everything with one continuous buffer
         if (!allocPoolWithErrorLog(L"tickDataPtr ", tickDataSize, (void**)&tickDataPtr, __LINE__)
             || !allocPoolWithErrorLog(L"tickPtr", ticksSize, (void**)&ticksPtr, __LINE__)
+            || !allocPoolWithErrorLog(L"tickVoteDigestsPtr", tickVoteDigestsSize, (void**)&tickVoteDigestsPtr, __LINE__)
+            || !allocPoolWithErrorLog(L"tickVoteOverflowBlocksPtr", tickVoteOverflowBlocksSize, (void**)&tickVoteOverflowBlocksPtr, __LINE__)
             || !allocPoolWithErrorLog(L"tickTransactionPtr", tickTransactionsSize, (void**)&tickTransactionsPtr, __LINE__)
             || !allocPoolWithErrorLog(L"tickTransactionOffset", tickTransactionOffsetsSize, (void**)&tickTransactionOffsetsPtr, __LINE__)
-            || !allocPoolWithErrorLog(L"tickTransactionsDigestPtr", tickTransactionOffsetsLengthCurrentEpoch * sizeof(TransactionsDigestAccess::HashMapEntry), (void**)&tickTransactionsDigestPtr, __LINE__))
+            || !allocPoolWithErrorLog(L"tickTransactionsDigestPtr", tickTransactionsDigestIndexSize, (void**)&tickTransactionsDigestPtr, __LINE__))
         {
             return false;
         }
@@ -456,10 +691,13 @@ public:
         ASSERT(tickDataLock == 0);
         setMem((void*)ticksLocks, sizeof(ticksLocks), 0);
         ASSERT(tickTransactionsLock == 0);
+        ASSERT(tickVoteOverflowBlocksLock == 0);
         nextTickTransactionOffset = FIRST_TICK_TRANSACTION_OFFSET;
+        tickVoteOverflowBlocksUsed = 0;
 
         oldTickDataPtr = tickDataPtr + MAX_NUMBER_OF_TICKS_PER_EPOCH;
         oldTicksPtr = ticksPtr + ticksLengthCurrentEpoch;
+        oldTickVoteDigestsPtr = tickVoteDigestsPtr + MAX_NUMBER_OF_TICKS_PER_EPOCH;
         oldTickTransactionsPtr = tickTransactionsPtr + tickTransactionsSizeCurrentEpoch;
         oldTickTransactionOffsetsPtr = tickTransactionOffsetsPtr + tickTransactionOffsetsLengthCurrentEpoch;
 
@@ -468,7 +706,7 @@ public:
         oldTickBegin = 0;
         oldTickEnd = 0;
 
-        setMem((void*)tickTransactionsDigestPtr, tickTransactionOffsetsLengthCurrentEpoch * sizeof(TransactionsDigestAccess::HashMapEntry), 0);
+        TransactionsDigestAccess::reset();
 
         return true;
     }
@@ -486,6 +724,16 @@ public:
             freePool(ticksPtr);
         }
 
+        if (tickVoteDigestsPtr)
+        {
+            freePool(tickVoteDigestsPtr);
+        }
+
+        if (tickVoteOverflowBlocksPtr)
+        {
+            freePool(tickVoteOverflowBlocksPtr);
+        }
+
         if (tickTransactionOffsetsPtr)
         {
             freePool(tickTransactionOffsetsPtr);
@@ -531,7 +779,20 @@ public:
 
             // copy ticks and tick data from recently ended epoch into storage of previous epoch
             copyMem(oldTickDataPtr, tickDataPtr + tickIndex, tickCount * sizeof(TickData));
-            copyMem(oldTicksPtr, ticksPtr + (tickIndex * NUMBER_OF_COMPUTORS), tickCount * NUMBER_OF_COMPUTORS * sizeof(Tick));
+            copyMem(oldTicksPtr, ticksPtr + (tickIndex * NUMBER_OF_COMPUTORS), tickCount * NUMBER_OF_COMPUTORS * sizeof(CompactTick));
+            copyMem(oldTickVoteDigestsPtr, tickVoteDigestsPtr + tickIndex, tickCount * sizeof(TickVoteSharedDigestsTable));
+
+            // move overflow blocks of kept ticks to the blocks of previous epoch
+            for (unsigned int i = 0; i < tickCount; ++i)
+            {
+                TickVoteSharedDigestsTable& table = oldTickVoteDigestsPtr[i];
+                if (table.overflowBlock)
+                {
+                    ASSERT(table.overflowBlock <= tickVoteOverflowBlocksUsed);
+                    copyMem(tickVoteOverflowBlocksPtr + TICK_VOTE_SHARED_DIGESTS_OVERFLOW_BLOCKS + i, tickVoteOverflowBlocksPtr + (table.overflowBlock - 1), sizeof(TickVoteSharedDigestsOverflowBlock));
+                    table.overflowBlock = (unsigned int)(TICK_VOTE_SHARED_DIGESTS_OVERFLOW_BLOCKS + i + 1);
+                }
+            }
 
             // copy transactions and transactionOffsets
             {
@@ -586,7 +847,8 @@ public:
 
             // reset data storage of new epoch
             setMem(tickDataPtr, MAX_NUMBER_OF_TICKS_PER_EPOCH * sizeof(TickData), 0);
-            setMem(ticksPtr, ticksLengthCurrentEpoch * sizeof(Tick), 0);
+            setMem(ticksPtr, ticksLengthCurrentEpoch * sizeof(CompactTick), 0);
+            setMem(tickVoteDigestsPtr, MAX_NUMBER_OF_TICKS_PER_EPOCH * sizeof(TickVoteSharedDigestsTable), 0);
             setMem(tickTransactionOffsetsPtr, tickTransactionOffsetsSizeCurrentEpoch, 0);
             setMem(tickTransactionsPtr, tickTransactionsSizeCurrentEpoch, 0);
         }
@@ -595,23 +857,60 @@ public:
             // node startup with no data of prior epoch
             setMem(tickDataPtr, tickDataSize, 0);
             setMem(ticksPtr, ticksSize, 0);
+            setMem(tickVoteDigestsPtr, tickVoteDigestsSize, 0);
             setMem(tickTransactionOffsetsPtr, tickTransactionOffsetsSize, 0);
             setMem(tickTransactionsPtr, tickTransactionsSize, 0);
             oldTickBegin = 0;
             oldTickEnd = 0;
         }
-        // Transaction digest look up need to reset at the begining of epoch for pointing to valid current epoch transaction
-        setMem((void*)tickTransactionsDigestPtr, tickTransactionOffsetsLengthCurrentEpoch * sizeof(TransactionsDigestAccess::HashMapEntry), 0);
+
+        // overflow blocks are cleared when handed out
+        tickVoteOverflowBlocksUsed = 0;
 
         tickBegin = newInitialTick;
         tickEnd = newInitialTick + MAX_NUMBER_OF_TICKS_PER_EPOCH;
 
+        // Transaction digest index needs to be rebuilt, because offsets of kept transactions have changed
+        TransactionsDigestAccess::reset();
+        for (unsigned int tickId = oldTickBegin; tickId < oldTickEnd; ++tickId)
+        {
+            const unsigned long long* tickOffsetsPrevEp = TickTransactionOffsetsAccess::getByTickInPreviousEpoch(tickId);
+            const TickData& tickDataPrevEp = TickDataAccess::getByTickInPreviousEpoch(tickId);
+            for (unsigned int transactionIdx = 0; transactionIdx < NUMBER_OF_TRANSACTIONS_PER_TICK; ++transactionIdx)
+            {
+                if (tickOffsetsPrevEp[transactionIdx])
+                    TransactionsDigestAccess::insertEntry(tickDataPrevEp.transactionDigests[transactionIdx], tickOffsetsPrevEp[transactionIdx], transactionIdx);
+            }
+        }
+
         nextTickTransactionOffset = FIRST_TICK_TRANSACTION_OFFSET;
 #if !defined(NDEBUG) && !defined(NO_UEFI)
         addDebugMessage(L"End ts.beginEpoch()");
 #endif
     }
 
+    // Check that the references of the compact ticks of the tick at tickIndex match the shared digests table
+    static void checkTicksConsistencyWithAssert(unsigned int tickIndex)
+    {
+        const CompactTick* computorsTicks = TicksAccess::getByTickIndex(tickIndex);
+        TickVoteSharedDigestsTable& table = tickVoteDigestsPtr[tickIndex];
+        ASSERT(table.count <= TICK_VOTE_SHARED_DIGESTS_PER_TICK);
+        ASSERT(table.count <= TICK_VOTE_SHARED_DIGESTS_INLINE || table.overflowBlock);
+        unsigned short refCounts[TICK_VOTE_SHARED_DIGESTS_PER_TICK] = { 0 };
+        for (unsigned int computor = 0; computor < NUMBER_OF_COMPUTORS; ++computor)
+        {
+            const CompactTick& computorTick = computorsTicks[computor];
+            if (computorTick.epoch)
+            {
+                ASSERT(computorTick.sharedDigestsIndex < table.count);
+                if (computorTick.sharedDigestsIndex < TICK_VOTE_SHARED_DIGESTS_PER_TICK)
+                    ++refCounts[computorTick.sharedDigestsIndex];
+            }
+        }
+        for (unsigned int i = 0; i < TICK_VOTE_SHARED_DIGESTS_PER_TICK; ++i)
+            ASSERT(refCounts[i] == ((i < table.count) ? sharedDigestsRefCount(table, i) : 0));
+    }
+
     // Useful for debugging, but expensive: check that everything is as expected.
     static void checkStateConsistencyWithAssert()
     {
@@ -636,10 +935,14 @@ public:
 
         ASSERT(tickDataPtr != nullptr);
         ASSERT(ticksPtr != nullptr);
+        ASSERT(tickVoteDigestsPtr != nullptr);
+        ASSERT(tickVoteOverflowBlocksPtr != nullptr);
+        ASSERT(tickVoteOverflowBlocksUsed <= TICK_VOTE_SHARED_DIGESTS_OVERFLOW_BLOCKS);
         ASSERT(tickTransactionsPtr != nullptr);
         ASSERT(tickTransactionOffsetsPtr != nullptr);
         ASSERT(oldTickDataPtr == tickDataPtr + MAX_NUMBER_OF_TICKS_PER_EPOCH);
         ASSERT(oldTicksPtr == ticksPtr + ticksLengthCurrentEpoch);
+        ASSERT(oldTickVoteDigestsPtr == tickVoteDigestsPtr + MAX_NUMBER_OF_TICKS_PER_EPOCH);
         ASSERT(oldTickTransactionsPtr == tickTransactionsPtr + tickTransactionsSizeCurrentEpoch);
         ASSERT(oldTickTransactionOffsetsPtr == tickTransactionOffsetsPtr + tickTransactionOffsetsLengthCurrentEpoch);
 
@@ -652,12 +955,7 @@ public:
             const TickData& tickData = TickDataAccess::getByTickInPreviousEpoch(tickId);
             ASSERT(tickData.epoch == 0 || tickData.epoch == INVALIDATED_TICK_DATA || (tickData.tick == tickId));
 
-            const Tick* computorsTicks = TicksAccess::getByTickInPreviousEpoch(tickId);
-            for (unsigned int computor = 0; computor < NUMBER_OF_COMPUTORS; ++computor)
-            {
-                const Tick& computorTick = computorsTicks[computor];
-                ASSERT(computorTick.epoch == 0 || (computorTick.tick == tickId && computorTick.computorIndex == computor));
-            }
+            checkTicksConsistencyWithAssert(tickToIndexPreviousEpoch(tickId));
 
             const unsigned long long* tickOffsets = TickTransactionOffsetsAccess::getByTickInPreviousEpoch(tickId);
             for (unsigned int transactionIdx = 0; transactionIdx < NUMBER_OF_TRANSACTIONS_PER_TICK; ++transactionIdx)
@@ -705,12 +1003,7 @@ public:
             const TickData& tickData = TickDataAccess::getByTickInCurrentEpoch(tickId);
             ASSERT(tickData.epoch == 0 || tickData.epoch == INVALIDATED_TICK_DATA || (tickData.tick == tickId));
 
-            const Tick* computorsTicks = TicksAccess::getByTickInCurrentEpoch(tickId);
-            for (unsigned int computor = 0; computor < NUMBER_OF_COMPUTORS; ++computor)
-            {
-                const Tick& computorTick = computorsTicks[computor];
-                ASSERT(computorTick.epoch == 0 || (computorTick.tick == tickId && computorTick.computorIndex == computor));
-            }
+            checkTicksConsistencyWithAssert(tickToIndexCurrentEpoch(tickId));
 
             const unsigned long long* tickOffsets = TickTransactionOffsetsAccess::getByTickInCurrentEpoch(tickId);
             for (unsigned int transactionIdx = 0; transactionIdx < NUMBER_OF_TRANSACTIONS_PER_TICK; ++transactionIdx)
@@ -782,6 +1075,12 @@ public:
         return tick - oldTickBegin + MAX_NUMBER_OF_TICKS_PER_EPOCH;
     }
 
+    // Return tick of index in current or previous epoch storage (inverse of tickToIndexCurrentEpoch() and tickToIndexPreviousEpoch()).
+    inline static unsigned int indexToTick(unsigned int tickIndex)
+    {
+        return (tickIndex < MAX_NUMBER_OF_TICKS_PER_EPOCH) ? tickBegin + tickIndex : oldTickBegin + (tickIndex - MAX_NUMBER_OF_TICKS_PER_EPOCH);
+    }
+
     // Struct for structured, convenient access via ".tickData"
     struct TickDataAccess
     {
@@ -860,39 +1159,156 @@ public:
             RELEASE(ticksLocks[computorIndex]);
         }
 
-        // Return pointer to array of one Tick per computor by tick index independent of epoch (checking index with ASSERT)
-        inline static Tick* getByTickIndex(unsigned int tickIndex)
+        // Return pointer to array of one CompactTick per computor by tick index independent of epoch (checking index with ASSERT)
+        inline static CompactTick* getByTickIndex(unsigned int tickIndex)
         {
             ASSERT(tickIndex < tickDataLength);
             return ticksPtr + static_cast<unsigned long long>(tickIndex) * NUMBER_OF_COMPUTORS;
         }
 
-        // Return pointer to array of one Tick per computor in current epoch by tick (checking tick with ASSERT)
-        inline static Tick* getByTickInCurrentEpoch(unsigned int tick)
+        // Return pointer to array of one CompactTick per computor in current epoch by tick (checking tick with ASSERT)
+        inline static CompactTick* getByTickInCurrentEpoch(unsigned int tick)
         {
             ASSERT(tickInCurrentEpochStorage(tick));
             return ticksPtr + static_cast<unsigned long long>(tickToIndexCurrentEpoch(tick)) * NUMBER_OF_COMPUTORS;
         }
 
-        // Return pointer to array of one Tick per computor in previous epoch by tick (checking tick with ASSERT)
-        inline static Tick* getByTickInPreviousEpoch(unsigned int tick)
+        // Return pointer to array of one CompactTick per computor in previous epoch by tick (checking tick with ASSERT)
+        inline static CompactTick* getByTickInPreviousEpoch(unsigned int tick)
         {
             ASSERT(tickInPreviousEpochStorage(tick));
             return ticksPtr + static_cast<unsigned long long>(tickToIndexPreviousEpoch(tick)) * NUMBER_OF_COMPUTORS;
         }
 
-        // Get ticks element at offset (checking offset with ASSERT)
-        inline Tick& operator[](unsigned long long offset)
+        // Restore full Tick of computor from compact tick and shared digests (caller needs to hold the lock of the
+        // computor). Returns false if no vote is stored.
+        static bool get(unsigned int tickIndex, unsigned short computorIndex, Tick& vote)
+        {
+            ASSERT(computorIndex < NUMBER_OF_COMPUTORS);
+            const CompactTick& compactTick = getByTickIndex(tickIndex)[computorIndex];
+            if (!compactTick.epoch)
+                return false;
+
+            TickVoteSharedDigestsTable& table = tickVoteDigestsPtr[tickIndex];
+            ACQUIRE(table.lock);
+            ASSERT(compactTick.sharedDigestsIndex < table.count);
+            const TickVoteSharedDigests& shared = sharedDigestsEntry(table, compactTick.sharedDigestsIndex);
+            *((unsigned long long*)&vote.millisecond) = shared.time;
+            vote.prevResourceTestingDigest = shared.prevResourceTestingDigest;
+            vote.prevTransactionBodyDigest = shared.prevTransactionBodyDigest;
+            vote.prevSpectrumDigest = shared.prevSpectrumDigest;
+            vote.prevUniverseDigest = shared.prevUniverseDigest;
+            vote.prevComputerDigest = shared.prevComputerDigest;
+            RELEASE(table.lock);
+
+            vote.computorIndex = computorIndex;
+            vote.epoch = compactTick.epoch;
+            vote.tick = indexToTick(tickIndex);
+            vote.saltedResourceTestingDigest = compactTick.saltedResourceTestingDigest;
+            vote.saltedTransactionBodyDigest = compactTick.saltedTransactionBodyDigest;
+            vote.saltedSpectrumDigest = compactTick.saltedSpectrumDigest;
+            vote.saltedUniverseDigest = compactTick.saltedUniverseDigest;
+            vote.saltedComputerDigest = compactTick.saltedComputerDigest;
+            vote.transactionDigest = compactTick.transactionDigest;
+            vote.expectedNextTickTransactionDigest = compactTick.expectedNextTickTransactionDigest;
+            copyMem(vote.signature, compactTick.signature, SIGNATURE_SIZE);
+            return true;
+        }
+
+        // Return index of the shared digests referenced by most votes of the tick (the digests of the majority if
+        // quorum is reached), or CompactTick::noSharedDigests if no vote is stored. Compare with sharedDigestsIndex.
+        static unsigned char getMostCommonSharedDigestsIndex(unsigned int tickIndex)
         {
-            ASSERT(offset < ticksLength);
-            return ticksPtr[offset];
+            ASSERT(tickIndex < tickDataLength);
+            TickVoteSharedDigestsTable& table = tickVoteDigestsPtr[tickIndex];
+            unsigned char index = CompactTick::noSharedDigests;
+            unsigned short maxRefCount = 0;
+            ACQUIRE(table.lock);
+            for (unsigned char i = 0; i < table.count; ++i)
+            {
+                if (sharedDigestsRefCount(table, i) > maxRefCount)
+                {
+                    maxRefCount = sharedDigestsRefCount(table, i);
+                    index = i;
+                }
+            }
+            RELEASE(table.lock);
+            return index;
         }
 
-        // Get ticks element at offset (checking offset with ASSERT)
-        inline const Tick& operator[](unsigned long long offset) const
+        // Store vote in compact form, replacing the vote of vote.computorIndex if any (caller needs to hold the lock
+        // of the computor). Returns false without changing the storage if the vote has new shared digests and all
+        // entries of the shared digests table of the tick are referenced by other votes. Such a vote cannot be part
+        // of a quorum (see TICK_VOTE_SHARED_DIGESTS_PER_TICK). It is also rejected if all inline entries are
+        // referenced and no overflow block is left (see TICK_VOTE_SHARED_DIGESTS_OVERFLOW_BLOCKS).
+        static bool store(unsigned int tickIndex, const Tick& vote)
         {
-            ASSERT(offset < ticksLength);
-            return ticksPtr[offset];
+            ASSERT(vote.computorIndex < NUMBER_OF_COMPUTORS);
+            CompactTick& compactTick = getByTickIndex(tickIndex)[vote.computorIndex];
+
+            TickVoteSharedDigests shared;
+            shared.time = *((unsigned long long*)&vote.millisecond);
+            shared.prevResourceTestingDigest = vote.prevResourceTestingDigest;
+            shared.prevTransactionBodyDigest = vote.prevTransactionBodyDigest;
+            shared.prevSpectrumDigest = vote.prevSpectrumDigest;
+            shared.prevUniverseDigest = vote.prevUniverseDigest;
+            shared.prevComputerDigest = vote.prevComputerDigest;
+
+            TickVoteSharedDigestsTable& table = tickVoteDigestsPtr[tickIndex];
+            ACQUIRE(table.lock);
+
+            // drop reference of vote that is replaced
+            if (compactTick.epoch)
+            {
+                ASSERT(sharedDigestsRefCount(table, compactTick.sharedDigestsIndex) > 0);
+                --sharedDigestsRefCount(table, compactTick.sharedDigestsIndex);
+            }
+
+            // find entry with same shared digests, otherwise use an unreferenced or new entry
+            unsigned char index = 0;
+            unsigned char unusedIndex = CompactTick::noSharedDigests;
+            while (index < table.count && !(sharedDigestsEntry(table, index) == shared))
+            {
+                if (!sharedDigestsRefCount(table, index) && unusedIndex == CompactTick::noSharedDigests)
+                    unusedIndex = index;
+                ++index;
+            }
+            if (index == table.count)
+            {
+                if (unusedIndex != CompactTick::noSharedDigests)
+                {
+                    index = unusedIndex;
+                }
+                else if (table.count < TICK_VOTE_SHARED_DIGESTS_PER_TICK
+                    && (table.count < TICK_VOTE_SHARED_DIGESTS_INLINE || table.overflowBlock || allocateOverflowBlock(table)))
+                {
+                    ++table.count;
+                }
+                else
+                {
+                    // keep the stored vote
+                    if (compactTick.epoch)
+                        ++sharedDigestsRefCount(table, compactTick.sharedDigestsIndex);
+                    RELEASE(table.lock);
+                    return false;
+                }
+                sharedDigestsEntry(table, index) = shared;
+            }
+            ++sharedDigestsRefCount(table, index);
+            RELEASE(table.lock);
+
+            compactTick.sharedDigestsIndex = index;
+            compactTick.saltedResourceTestingDigest = vote.saltedResourceTestingDigest;
+            compactTick.saltedTransactionBodyDigest = vote.saltedTransactionBodyDigest;
+            compactTick.saltedSpectrumDigest = vote.saltedSpectrumDigest;
+            compactTick.saltedUniverseDigest = vote.saltedUniverseDigest;
+            compactTick.saltedComputerDigest = vote.saltedComputerDigest;
+            compactTick.transactionDigest = vote.transactionDigest;
+            compactTick.expectedNextTickTransactionDigest = vote.expectedNextTickTransactionDigest;
+            copyMem(compactTick.signature, vote.signature, SIGNATURE_SIZE);
+            compactTick.epoch = vote.epoch;
+
+            return true;
         }
     } ticks;
 
@@ -963,78 +1379,159 @@ public:
         }
     } tickTransactions;
 
-    // Struct for access the transaction using its digest. It contains the offset in tickTransactionsPtr
+    // Struct for finding transactions by digest (current epoch and kept ticks of previous epoch).
+    // Insert-only hash map with open addressing (linear probing) and power-of-2 size. Each entry is a single 64-bit
+    // word packing transaction offset, index of transaction in tick, and a tag of the digest (0 marks a free entry).
+    // Entries are published with an atomic compare-exchange, so lookups don't need a lock. Because an entry
+    // doesn't store the full digest, it is verified against tickTransactionOffsets and the digest in tickData.
     struct TransactionsDigestAccess
     {
-        inline static void acquireLock()
+        static constexpr unsigned int offsetBits = getBitCount(tickTransactionsSize - 1);
+        static constexpr unsigned int transactionIndexBits = getBitCount(NUMBER_OF_TRANSACTIONS_PER_TICK - 1);
+        static constexpr unsigned int tagBits = 64 - offsetBits - transactionIndexBits;
+        static_assert(tagBits >= 8, "Not enough bits left for digest tag in transaction digest index entry");
+        static constexpr unsigned long long offsetMask = (1ULL << offsetBits) - 1;
+        static constexpr unsigned long long transactionIndexMask = (1ULL << transactionIndexBits) - 1;
+        static constexpr unsigned long long indexMask = tickTransactionsDigestIndexLength - 1;
+
+        struct Stats
         {
-            ACQUIRE(tickTransactionsDigestAccessLock);
-        }
+            unsigned long long insertCount;
+            unsigned long long insertProbes;
+            unsigned long long maxProbeLength;
+            unsigned long long lookupCount;
+            unsigned long long lookupProbes;
+        };
 
-        inline static void releaseLock()
+        // Clear index and statistics (not thread-safe)
+        static void reset()
         {
-            RELEASE(tickTransactionsDigestAccessLock);
+            setMem((void*)tickTransactionsDigestPtr, tickTransactionsDigestIndexSize, 0);
+            tickTransactionsDigestInsertCount = 0;
+            tickTransactionsDigestInsertProbes = 0;
+            tickTransactionsDigestMaxProbeLength = 0;
+            setMem(tickTransactionsDigestLookupCounters, sizeof(tickTransactionsDigestLookupCounters), 0);
         }
 
-        struct HashMapEntry
+        // Add transaction of tick in current epoch, which must have been stored in tickTransactions with
+        // its digest in tickData. Only one processor may insert at a time. Returns false if index is full.
+        static bool insertTransaction(const m256i& digest, unsigned int tick, unsigned int transactionIndex)
         {
-            m256i digest; // isZero mean not occupied
-            const Transaction* transaction;
-        };
-        unsigned long long hashFunc(const m256i& digest)
-        {
-            return digest.m256i_u32[7] % tickTransactionOffsetsLengthCurrentEpoch;
+            ASSERT(transactionIndex < NUMBER_OF_TRANSACTIONS_PER_TICK);
+            return insertEntry(digest, TickTransactionOffsetsAccess::getByTickInCurrentEpoch(tick)[transactionIndex], transactionIndex);
         }
 
-        void insertTransaction(const m256i& digest, const Transaction* transaction)
+        // Add transaction stored at offset. Returns false if index is full.
+        static bool insertEntry(const m256i& digest, unsigned long long offset, unsigned int transactionIndex)
         {
             // Zero digest. No further process
             if (isZero(digest))
-            {
-                return;
-            }
+                return true;
 
-            HashMapEntry* pHashMap = (HashMapEntry*)tickTransactionsDigestPtr;
-            unsigned long long index = hashFunc(digest);
-            unsigned long long original_index = index;
-            // TODO: check alraeady added tx ?
-            while (!isZero(pHashMap[index].digest))
+            ASSERT(offset >= FIRST_TICK_TRANSACTION_OFFSET && offset < tickTransactionsSize);
+            const unsigned long long tag = getTag(digest);
+            const unsigned long long newEntry = offset | ((unsigned long long)transactionIndex << offsetBits) | (tag << (offsetBits + transactionIndexBits));
+            unsigned long long index = getIndex(digest);
+            for (unsigned long long probes = 1; probes <= tickTransactionsDigestIndexLength; ++probes)
             {
-                index = (index + 1) % tickTransactionOffsetsLengthCurrentEpoch;
-                if (index == original_index)
+                const unsigned long long entry = (unsigned long long)_InterlockedCompareExchange64((volatile long long*)&tickTransactionsDigestPtr[index], newEntry, 0);
+                if (!entry || (entry >> (offsetBits + transactionIndexBits) == tag && getVerifiedTransaction(entry, digest)))
                 {
-                    // Don't have enough place in the table
-                    return;
+                    // Stored in free entry or already added before (insert stats are only written by the inserting processor)
+                    ++tickTransactionsDigestInsertCount;
+                    tickTransactionsDigestInsertProbes += probes;
+                    if ((long long)probes > tickTransactionsDigestMaxProbeLength)
+                        tickTransactionsDigestMaxProbeLength = probes;
+                    return true;
                 }
+                index = (index + 1) & indexMask;
             }
-            pHashMap[index].transaction = transaction;
-            pHashMap[index].digest = digest;
+
+            // Don't have enough place in the table
+            return false;
         }
 
-        const Transaction* findTransaction(const m256i& digest)
+        // Return transaction with digest or NULL if not found. Can be called from any processor without lock.
+        static const Transaction* findTransaction(const m256i& digest)
         {
             // Zero digest. No further process
             if (isZero(digest))
-            {
                 return NULL;
-            }
 
-            HashMapEntry* pHashMap = (HashMapEntry*)tickTransactionsDigestPtr;
-            unsigned long long index = hashFunc(digest);
-            unsigned long long original_index = index;
-            while (!isZero(pHashMap[index].digest))
+            const unsigned long long tag = getTag(digest);
+            unsigned long long index = getIndex(digest);
+            unsigned long long probes = 1;
+            const Transaction* transaction = NULL;
+            for (; probes <= tickTransactionsDigestIndexLength; ++probes)
             {
-                if (pHashMap[index].digest == digest)
-                {
-                    return pHashMap[index].transaction;
-                }
-                index = (index + 1) % tickTransactionOffsetsLengthCurrentEpoch;
-                if (index == original_index)
-                {
+                const unsigned long long entry = tickTransactionsDigestPtr[index];
+                if (!entry)
                     break;
+                if (entry >> (offsetBits + transactionIndexBits) == tag)
+                {
+                    transaction = getVerifiedTransaction(entry, digest);
+                    if (transaction)
+                        break;
                 }
+                index = (index + 1) & indexMask;
+            }
+            DigestLookupCounters& counters = tickTransactionsDigestLookupCounters[getRunningProcessorID() % MAX_NUMBER_OF_PROCESSORS];
+            ++counters.count;
+            counters.probes += probes;
+            return transaction;
+        }
+
+        // Get probe statistics since beginning of epoch.
+        static void getStats(Stats& stats)
+        {
+            stats.insertCount = tickTransactionsDigestInsertCount;
+            stats.insertProbes = tickTransactionsDigestInsertProbes;
+            stats.maxProbeLength = tickTransactionsDigestMaxProbeLength;
+            stats.lookupCount = 0;
+            stats.lookupProbes = 0;
+            for (unsigned int i = 0; i < MAX_NUMBER_OF_PROCESSORS; ++i)
+            {
+                stats.lookupCount += tickTransactionsDigestLookupCounters[i].count;
+                stats.lookupProbes += tickTransactionsDigestLookupCounters[i].probes;
             }
-            return NULL;
+        }
+
+    private:
+        static unsigned long long getIndex(const m256i& digest)
+        {
+            return digest.m256i_u64[1] & indexMask;
+        }
+
+        static unsigned long long getTag(const m256i& digest)
+        {
+            // Use other bits than index and avoid tag 0, so entry 0 means free
+            const unsigned long long tag = digest.m256i_u64[3] >> (64 - tagBits);
+            return (tag) ? tag : 1;
+        }
+
+        // Return transaction referenced by entry if it is still in storage and has the digest, NULL otherwise.
+        static const Transaction* getVerifiedTransaction(unsigned long long entry, const m256i& digest)
+        {
+            const unsigned long long offset = entry & offsetMask;
+            const unsigned int transactionIndex = (unsigned int)((entry >> offsetBits) & transactionIndexMask);
+            if (offset < FIRST_TICK_TRANSACTION_OFFSET || offset + sizeof(Transaction) > tickTransactionsSize)
+                return NULL;
+
+            const Transaction* transaction = TickTransactionsAccess::ptr(offset);
+            const unsigned int tick = transaction->tick;
+            unsigned int tickIndex;
+            if (tickInCurrentEpochStorage(tick))
+                tickIndex = tickToIndexCurrentEpoch(tick);
+            else if (tickInPreviousEpochStorage(tick))
+                tickIndex = tickToIndexPreviousEpoch(tick);
+            else
+                return NULL;
+
+            if (TickTransactionOffsetsAccess::getByTickIndex(tickIndex)[transactionIndex] != offset
+                || tickDataPtr[tickIndex].transactionDigests[transactionIndex] != digest)
+                return NULL;
+
+            return transaction;
         }
     } transactionsDigestAccess;
 };
@@ -0,0 +1,837 @@
+// Processing of the transactions of a tick (transfers, protocol transactions such as votes, solutions, oracle replies,
+// and files, IPO bids, and contract procedures) and the mining and protocol state it updates. Shared by the tick
+// processor in qubic.cpp and the tick replay in the tests, which makes sure that the replay runs the same code.
+
+#pragma once
+
+#include "platform/m256.h"
+#include "platform/assert.h"
+#include "platform/concurrency.h"
+#include "platform/console_logging.h"
+#include "platform/file_io.h"
+#include "platform/memory_util.h"
+#include "platform/profiling.h"
+
+#include "network_messages/computors.h"
+#include "network_messages/execution_fees.h"
+#include "network_messages/tick.h"
+#include "network_messages/transactions.h"
+
+#include "system.h"
+#include "contract_core/contract_exec.h"
+#include "contract_core/ipo.h"
+#include "spectrum/spectrum.h"
+#include "spectrum/special_entities.h"
+#include "logging/logging.h"
+#include "ticking/tick_storage.h"
+#include "ticking/execution_fee_report_collector.h"
+#include "addons/tx_status_request.h"
+#include "files/files.h"
+#include "mining/mining.h"
+#include "mining/custom_qubic_mining_storage.h"
+#include "mining/task_file.h"
+#include "oracle_core/oracle_engine.h"
+#include "oc_core/oc_engine.h"
+
+#include "public_settings.h"
+#include "kangaroo_twelve.h"
+#include "score.h"
+#include "vote_counter.h"
+
+
+#define MAX_NUMBER_EPOCH 1000ULL
+#define MAX_NUMBER_OF_MINERS 8192
+#define NUMBER_OF_MINER_SOLUTION_FLAGS 0x100000000
+
+static int solutionPublicationTicks[MAX_NUMBER_OF_SOLUTIONS]; // scheduled tick to broadcast solution, -1 means already broadcasted, -2 means obsolete solution
+#define SOLUTION_RECORDED_FLAG -1
+#define SOLUTION_OBSOLETE_FLAG -2
+
+static VoteCounter voteCounter;
+static ExecutionFeeReportCollector executionFeeReportCollector;
+static TickData nextTickData; // tick data of the tick being processed (or received from the network before that)
+
+static unsigned int resourceTestingDigest = 0;
+
+static unsigned int numberOfTransactions = 0;
+
+static ScoreFunction<
+    NUMBER_OF_SOLUTION_PROCESSORS
+> * score = nullptr;
+static unsigned char* gBpp9000TaskBuffer = nullptr;
+static volatile char solutionsLock = 0;
+static unsigned long long* minerSolutionFlags = NULL;
+static volatile m256i minerPublicKeys[MAX_NUMBER_OF_MINERS + 1];
+static volatile unsigned int minerScores[MAX_NUMBER_OF_MINERS + 1];
+// Tick in which each miner reached its currently recorded best score, used as ranking tie-breaker
+static volatile unsigned int minerBestScoreTicks[MAX_NUMBER_OF_MINERS + 1];
+static volatile unsigned int numberOfMiners = NUMBER_OF_COMPUTORS;
+static m256i competitorPublicKeys[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
+static unsigned int competitorScores[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
+static unsigned int competitorTicks[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
+static bool competitorComputorStatuses[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
+static constexpr unsigned int NO_MINER_SCORE = 0xFFFFFFFFU;
+static unsigned int minimumComputorScore = NO_MINER_SCORE;
+static unsigned int minimumCandidateScore = NO_MINER_SCORE;
+static int solutionThreshold[MAX_NUMBER_EPOCH][score_engine::AlgoType::MaxAlgoCount];
+static volatile char minerScoreArrayLock = 0;
+static constexpr unsigned int gScoreMultiplier[score_engine::AlgoType::MaxAlgoCount] =
+{
+    NEURAXON_SOLUTION_MULTIPLER,   // Neuraxon (reserved)
+    BPP9000_SOLUTION_MULTIPLER     // Bpp9000
+};
+
+// Active solution threshold for an algorithm
+static int getSolutionThreshold(score_engine::AlgoType selectedAlgo)
+{
+    if (selectedAlgo >= score_engine::AlgoType::MaxAlgoCount)
+    {
+        return 0;
+    }
+    return (system.epoch < MAX_NUMBER_EPOCH)
+        ? solutionThreshold[system.epoch][selectedAlgo]
+        : score_engine::DEFAUL_SOLUTION_THRESHOLD[selectedAlgo];
+}
+
+// DOGE merged-mining shares
+static CustomMiningSharesCounter gDogeMiningSharesCounter;
+
+static CustomQubicMiningStorage customQubicMiningStorage;
+
+// Layout of the file "snapshotNodeMiningState" saved with the other node states (TICK_STORAGE_AUTOSAVE_MODE)
+struct NodeMiningStateSnapshot
+{
+    Tick etalonTick;
+    m256i minerPublicKeys[MAX_NUMBER_OF_MINERS + 1];
+    unsigned int minerScores[MAX_NUMBER_OF_MINERS + 1];
+    unsigned int minerBestScoreTicks[MAX_NUMBER_OF_MINERS + 1];
+    m256i competitorPublicKeys[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
+    unsigned int competitorScores[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
+    unsigned int competitorTicks[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
+    bool competitorComputorStatuses[(NUMBER_OF_COMPUTORS - QUORUM) * 2];
+    m256i currentRandomSeed;
+    int solutionPublicationTicks[MAX_NUMBER_OF_SOLUTIONS];
+    unsigned long long faultyComputorFlags[(NUMBER_OF_COMPUTORS + 63) / 64];
+    unsigned char voteCounterData[VoteCounter::VoteCounterDataSize];
+    BroadcastComputors broadcastedComputors;
+    unsigned int resourceTestingDigest;
+    unsigned int numberOfMiners;
+    unsigned int numberOfTransactions;
+    unsigned char dogeMiningSharesCounterData[CustomMiningSharesCounter::_customMiningSolutionCounterDataSize];
+};
+
+
+// Run the contract code of a transaction (phase USER_PROCEDURE_CALL or POST_INCOMING_TRANSFER) and return if money
+// flew. Has to be defined by the compile unit that includes this header: qubic.cpp hands the transaction over to the
+// contract processor, which calls executeContractTransaction().
+static bool runContractTransaction(const Transaction* transaction, unsigned int phase, unsigned char postIncomingTransferType);
+
+// Run the contract code of a transaction in the current processor. With USER_PROCEDURE_CALL, the contract is also
+// notified of the incoming transfer if the invocation reward = amount > 0. Returns if money flew in the user procedure.
+static bool executeContractTransaction(const Transaction* transaction, unsigned int phase, unsigned char postIncomingTransferType)
+{
+    PROFILE_SCOPE();
+
+    ASSERT(transaction && transaction->checkValidity());
+    ASSERT(phase == USER_PROCEDURE_CALL || phase == POST_INCOMING_TRANSFER);
+
+    ASSERT(transaction->destinationPublicKey.m256i_u64[0] < contractCount);
+    ASSERT(transaction->destinationPublicKey.m256i_u64[1] == 0);
+    ASSERT(transaction->destinationPublicKey.m256i_u64[2] == 0);
+    ASSERT(transaction->destinationPublicKey.m256i_u64[3] == 0);
+
+    unsigned int contractIndex = (unsigned int)transaction->destinationPublicKey.m256i_u64[0];
+    ASSERT(system.epoch >= contractDescriptions[contractIndex].constructionEpoch);
+    ASSERT(system.epoch < contractDescriptions[contractIndex].destructionEpoch);
+
+    if (transaction->amount > 0 && contractSystemProcedures[contractIndex][POST_INCOMING_TRANSFER])
+    {
+        // Run callback system procedure POST_INCOMING_TRANSFER
+        const unsigned char type = postIncomingTransferType;
+        if (phase == USER_PROCEDURE_CALL)
+        {
+            ASSERT(type == QPI::TransferType::procedureTransaction);
+        }
+        else
+        {
+            ASSERT(
+                type == QPI::TransferType::standardTransaction
+                || type == QPI::TransferType::revenueDonation
+                || type == QPI::TransferType::ipoBidRefund
+            );
+        }
+
+        QpiContextSystemProcedureCall qpiContext(contractIndex, POST_INCOMING_TRANSFER);
+        QPI::PostIncomingTransfer_input input{ transaction->sourcePublicKey, transaction->amount, type };
+        qpiContext.call(input);
+    }
+
+    if (phase == USER_PROCEDURE_CALL)
+    {
+        // Run user procedure
+        ASSERT(contractUserProcedures[contractIndex][transaction->inputType]);
+
+        QpiContextUserProcedureCall qpiContext(contractIndex, transaction->sourcePublicKey, transaction->amount);
+        qpiContext.call(transaction->inputType, transaction->inputPtr(), transaction->inputSize);
+
+        return contractActionTracker.getOverallQuTransferBalance(transaction->sourcePublicKey) != 0;
+    }
+
+    return false;
+}
+
+// Set the solution thresholds of the current epoch to the defaults if they haven't been set to valid values before
+static void initEpochSolutionThresholds()
+{
+    if (system.epoch < MAX_NUMBER_EPOCH && !score_engine::checkAlgoThreshold(solutionThreshold[system.epoch][score_engine::AlgoType::Bpp9000], score_engine::AlgoType::Bpp9000))
+    {
+        solutionThreshold[system.epoch][score_engine::AlgoType::Bpp9000] = BPP9000_SOLUTION_THRESHOLD_DEFAULT;
+    }
+    // Neuraxon slot is reserved (not minable); keep its threshold slot at the placeholder default.
+    if (system.epoch < MAX_NUMBER_EPOCH)
+    {
+        solutionThreshold[system.epoch][score_engine::AlgoType::Neuraxon] = NEURAXON_SOLUTION_THRESHOLD_DEFAULT;
+    }
+}
+
+// Load and verify the bpp9000 task file (topology + windowed data) and hand it to the scorer
+static bool loadBpp9000Task()
+{
+    const unsigned int N = (unsigned int)BPP9000_NUMBER_OF_INPUT_NEURONS;
+    const unsigned int M = (unsigned int)BPP9000_NUMBER_OF_OUTPUT_NEURONS;
+    const unsigned int P = (unsigned int)BPP9000_POPULATION_THRESHOLD;
+    const unsigned int K = (unsigned int)BPP9000_NUMBER_OF_NEIGHBORS;
+    const unsigned long long T = BPP9000_SEQUENCE_LENGTH;
+
+    const unsigned long long topoBytes = score_task_file::topologyBytes(N, M, P, K);
+    const unsigned long long dataBytes = score_task_file::dataBytes(N, M, T);
+    const unsigned long long headerBytes = sizeof(score_task_file::TaskFileHeader);
+    const unsigned long long totalBytes = headerBytes + topoBytes + dataBytes;
+
+    if (!allocPoolWithErrorLog(L"bpp9000Task", totalBytes, (void**)&gBpp9000TaskBuffer, __LINE__))
+    {
+        return false;
+    }
+
+    bool ok = false;
+    const long long loadedSize = load(SCORE_BPP9000_TASK_FILE_NAME, totalBytes, gBpp9000TaskBuffer, NULL);
+    if (loadedSize != (long long)totalBytes)
+    {
+        logToConsole(L"bpp9000 task file missing or wrong size - node will not do score verification.");
+    }
+    else
+    {
+        const score_task_file::TaskFileHeader* h = (const score_task_file::TaskFileHeader*)gBpp9000TaskBuffer;
+        const unsigned char* topoBlock = gBpp9000TaskBuffer + headerBytes;
+        const unsigned char* dataBlock = topoBlock + topoBytes;
+
+        unsigned char topoHash[32];
+        unsigned char dataHash[32];
+        KangarooTwelve(topoBlock, (unsigned int)topoBytes, topoHash, 32);
+        KangarooTwelve(dataBlock, (unsigned int)dataBytes, dataHash, 32);
+
+        if (h->magic != score_task_file::MAGIC || h->version != score_task_file::VERSION
+            || h->numInputTrits != N || h->numOutputTrits != M || h->population != P
+            || h->numNeighbors != K || h->numPairs < T)
+        {
+            logToConsole(L"bpp9000 task header does not match configured parameters - node will not do score verification.");
+        }
+        else if (*(const m256i*)topoHash != *(const m256i*)BPP9000_TOPOLOGY_HASH
+              || *(const m256i*)dataHash != *(const m256i*)BPP9000_DATA_HASH)
+        {
+            logToConsole(L"bpp9000 task hash mismatch (not the pinned canonical task) - node will not do score verification.");
+        }
+        else if (!score->loadTask(topoBlock, dataBlock))
+        {
+            logToConsole(L"bpp9000 task failed topology validation - node will not do score verification.");
+        }
+        else
+        {
+            logToConsole(L"Loaded bpp9000 task file");
+            ok = true;
+        }
+    }
+
+    // Keep the verified buffer resident (for applyBpp9000Task) on success; release it on failure.
+    if (!ok)
+    {
+        freePool(gBpp9000TaskBuffer);
+        gBpp9000TaskBuffer = nullptr;
+    }
+    return ok;
+}
+
+// Re-apply the already-verified, resident task to the scorer. Used after beginEpoch() zeroes the scorer:
+// no file I/O and no re-hashing (the blocks were verified once at init), so it cannot fail on a missing or
+// altered file. Returns false only if the task was never loaded.
+static bool applyBpp9000Task()
+{
+    if (gBpp9000TaskBuffer == nullptr)
+    {
+        return false;
+    }
+    const unsigned long long headerBytes = sizeof(score_task_file::TaskFileHeader);
+    const unsigned long long topoBytes = score_task_file::topologyBytes(
+        (unsigned int)BPP9000_NUMBER_OF_INPUT_NEURONS, (unsigned int)BPP9000_NUMBER_OF_OUTPUT_NEURONS,
+        (unsigned int)BPP9000_POPULATION_THRESHOLD, (unsigned int)BPP9000_NUMBER_OF_NEIGHBORS);
+    const unsigned char* topoBlock = gBpp9000TaskBuffer + headerBytes;
+    const unsigned char* dataBlock = topoBlock + topoBytes;
+    return score->loadTask(topoBlock, dataBlock);
+}
+
+
+static void processTickTransactionContractIPO(const Transaction* transaction, const int spectrumIndex, const unsigned int contractIndex)
+{
+    PROFILE_SCOPE();
+
+    ASSERT(nextTickData.epoch == system.epoch);
+    ASSERT(transaction != nullptr);
+    ASSERT(transaction->checkValidity());
+    ASSERT(transaction->tick == system.tick);
+    ASSERT(!transaction->amount && transaction->inputSize == sizeof(ContractIPOBid));
+    ASSERT(spectrumIndex >= 0);
+    ASSERT(contractIndex < contractCount);
+    ASSERT(system.epoch == (contractDescriptions[contractIndex].constructionEpoch - 1));
+
+    ContractIPOBid* contractIPOBid = (ContractIPOBid*)transaction->inputPtr();
+    bidInContractIPO(contractIPOBid->price, contractIPOBid->quantity, transaction->sourcePublicKey, spectrumIndex, contractIndex);
+}
+
+// Return if money flew
+static bool processTickTransactionContractProcedure(const Transaction* transaction, const int spectrumIndex, const unsigned int contractIndex)
+{
+    PROFILE_SCOPE();
+
+    ASSERT(nextTickData.epoch == system.epoch);
+    ASSERT(transaction != nullptr);
+    ASSERT(transaction->checkValidity());
+    ASSERT(transaction->tick == system.tick);
+    ASSERT(spectrumIndex >= 0);
+    ASSERT(contractIndex < contractCount);
+    ASSERT(system.epoch >= contractDescriptions[contractIndex].constructionEpoch);
+    ASSERT(system.epoch < contractDescriptions[contractIndex].destructionEpoch);
+
+    if (contractUserProcedures[contractIndex][transaction->inputType])
+    {
+        // Run user procedure call of transaction and wait for completion
+        // With USER_PROCEDURE_CALL, the contract is also notified
+        // of the incoming transfer if the invocation reward = amount > 0.
+        return runContractTransaction(transaction, USER_PROCEDURE_CALL, QPI::TransferType::procedureTransaction);
+    }
+    else if (transaction->amount > 0)
+    {
+        // Transaction sending qu to contract without invoking registered user procedure:
+        // Run POST_INCOMING_TRANSFER notification and wait for completion.
+        runContractTransaction(transaction, POST_INCOMING_TRANSFER, QPI::TransferType::standardTransaction);
+    }
+
+    // if transaction tries to invoke non-registered procedure, transaction amount is not reimbursed
+    return transaction->amount > 0;
+}
+
+// Ranking order of miners and competitors, the score is an error count, so the smaller score ranks
+// first, and on equal score the entry that reached it in the earlier tick ranks first. Returns true
+// if entry A ranks below entry B.
+static bool ranksBelow(unsigned int scoreA, unsigned int tickA, unsigned int scoreB, unsigned int tickB)
+{
+    if (scoreA != scoreB)
+    {
+        return scoreA > scoreB;
+    }
+    return tickA > tickB;
+}
+
+static void processTickTransactionSolution(const MiningSolutionTransaction* transaction, const unsigned long long processorNumber)
+{
+    PROFILE_SCOPE();
+
+    ASSERT(nextTickData.epoch == system.epoch);
+    ASSERT(transaction != nullptr);
+    ASSERT(transaction->checkValidity());
+    ASSERT(transaction->tick == system.tick);
+    ASSERT(isZero(transaction->destinationPublicKey));
+    ASSERT(transaction->amount >=MiningSolutionTransaction::minAmount()
+            && transaction->inputSize == MiningSolutionTransaction::minInputSize()
+            && transaction->inputType == MiningSolutionTransaction::transactionType());
+
+    m256i data[3] = { transaction->sourcePublicKey, transaction->miningSeed, transaction->nonce };
+    static_assert(sizeof(data) == 3 * 32, "Unexpected array size");
+    unsigned int flagIndices[2];
+    KangarooTwelve(data, sizeof(data), flagIndices, sizeof(flagIndices));
+    // Two independent flag checks to reduce false-positive collision probability from ~N/2^32 to ~N^2/2^64
+    if (!(minerSolutionFlags[flagIndices[0] >> 6] & (1ULL << (flagIndices[0] & 63)))
+        || !(minerSolutionFlags[flagIndices[1] >> 6] & (1ULL << (flagIndices[1] & 63))))
+    {
+        minerSolutionFlags[flagIndices[0] >> 6] |= (1ULL << (flagIndices[0] & 63));
+        minerSolutionFlags[flagIndices[1] >> 6] |= (1ULL << (flagIndices[1] & 63));
+
+        unsigned int solutionScore = (*::score)(processorNumber, transaction->sourcePublicKey, transaction->miningSeed, transaction->nonce);
+        score_engine::AlgoType selectedAlgo = score_engine::getAlgoType(transaction->nonce.m256i_u8);
+        if (score->isValidScore(solutionScore, selectedAlgo))
+        {
+            resourceTestingDigest ^= solutionScore;
+            KangarooTwelve(&resourceTestingDigest, sizeof(resourceTestingDigest), &resourceTestingDigest, sizeof(resourceTestingDigest));
+            const int threshold = getSolutionThreshold(selectedAlgo);
+            // The deposit is only returned when the miner's claimed score matches the one computed
+            if (transaction->score == solutionScore
+                && score->isGoodScore(solutionScore, threshold, selectedAlgo))
+            {
+                // Solution deposit return
+                {
+                    increaseEnergy(transaction->sourcePublicKey, transaction->amount);
+
+                    const QuTransfer quTransfer = { m256i::zero(), transaction->sourcePublicKey, transaction->amount };
+                    logger.logQuTransfer(quTransfer);
+                }
+
+                for (unsigned int i = 0; i < computorSeedsCount; i++)
+                {
+                    if (transaction->sourcePublicKey == computorPublicKeys[i])
+                    {
+                        ACQUIRE(solutionsLock);
+
+                        unsigned int j;
+                        for (j = 0; j < system.numberOfSolutions; j++)
+                        {
+                            if (transaction->nonce == system.solutions[j].nonce
+                                && transaction->miningSeed == system.solutions[j].miningSeed
+                                && transaction->sourcePublicKey == system.solutions[j].computorPublicKey)
+                            {
+                                solutionPublicationTicks[j] = SOLUTION_RECORDED_FLAG;
+
+                                break;
+                            }
+                        }
+                        if (j == system.numberOfSolutions
+                            && system.numberOfSolutions < MAX_NUMBER_OF_SOLUTIONS)
+                        {
+                            system.solutions[system.numberOfSolutions].computorPublicKey = transaction->sourcePublicKey;
+                            system.solutions[system.numberOfSolutions].miningSeed = transaction->miningSeed;
+                            system.solutions[system.numberOfSolutions].nonce = transaction->nonce;
+                            system.solutions[system.numberOfSolutions].score = solutionScore;
+                            solutionPublicationTicks[system.numberOfSolutions++] = SOLUTION_RECORDED_FLAG;
+                        }
+
+                        RELEASE(solutionsLock);
+
+                        break;
+                    }
+                }
+
+                // A miner is ranked by its single best score of the epoch, not by the number of
+                // accepted solutions
+                const unsigned int newScore = solutionScore * gScoreMultiplier[selectedAlgo];
+                const unsigned int newTick = system.tick;
+
+                ACQUIRE(minerScoreArrayLock);
+                bool minerEntryChanged = false;
+                unsigned int minerIndex;
+                for (minerIndex = 0; minerIndex < numberOfMiners; minerIndex++)
+                {
+                    if (transaction->sourcePublicKey == minerPublicKeys[minerIndex])
+                    {
+                        if (newScore < minerScores[minerIndex])
+                        {
+                            minerScores[minerIndex] = newScore;
+                            minerBestScoreTicks[minerIndex] = newTick;
+                            minerEntryChanged = true;
+                        }
+
+                        break;
+                    }
+                }
+                if (minerIndex == numberOfMiners)
+                {
+                    if (numberOfMiners < MAX_NUMBER_OF_MINERS)
+                    {
+                        minerPublicKeys[numberOfMiners] = transaction->sourcePublicKey;
+                        minerBestScoreTicks[numberOfMiners] = newTick;
+                        minerScores[numberOfMiners++] = newScore;
+                        minerEntryChanged = true;
+                    }
+                    else
+                    {
+                        // The table is full. Entries beyond the computor block are kept sorted, so the
+                        // worst-ranked one sits at the end and is replaced only if the newcomer outranks it.
+                        const unsigned int worstIndex = numberOfMiners - 1;
+                        if (ranksBelow(minerScores[worstIndex], minerBestScoreTicks[worstIndex], newScore, newTick))
+                        {
+                            minerPublicKeys[worstIndex] = transaction->sourcePublicKey;
+                            minerScores[worstIndex] = newScore;
+                            minerBestScoreTicks[worstIndex] = newTick;
+                            minerIndex = worstIndex;
+                            minerEntryChanged = true;
+                        }
+                    }
+                }
+
+                if (minerEntryChanged)
+                {
+                    const m256i tmpPublicKey = minerPublicKeys[minerIndex];
+                    const unsigned int tmpScore = minerScores[minerIndex];
+                    const unsigned int tmpTick = minerBestScoreTicks[minerIndex];
+                    while (minerIndex > (unsigned int)(minerIndex < NUMBER_OF_COMPUTORS ? 0 : NUMBER_OF_COMPUTORS)
+                        && ranksBelow(minerScores[minerIndex - 1], minerBestScoreTicks[minerIndex - 1], minerScores[minerIndex], minerBestScoreTicks[minerIndex]))
+                    {
+                        minerPublicKeys[minerIndex] = minerPublicKeys[minerIndex - 1];
+                        minerScores[minerIndex] = minerScores[minerIndex - 1];
+                        minerBestScoreTicks[minerIndex] = minerBestScoreTicks[minerIndex - 1];
+                        minerPublicKeys[--minerIndex] = tmpPublicKey;
+                        minerScores[minerIndex] = tmpScore;
+                        minerBestScoreTicks[minerIndex] = tmpTick;
+                    }
+                }
+
+                // combine 225 worst current computors with 225 best candidates
+                for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS - QUORUM; i++)
+                {
+                    competitorPublicKeys[i] = minerPublicKeys[QUORUM + i];
+                    competitorScores[i] = minerScores[QUORUM + i];
+                    competitorTicks[i] = minerBestScoreTicks[QUORUM + i];
+                    competitorComputorStatuses[i] = true;
+
+                    if (NUMBER_OF_COMPUTORS + i < numberOfMiners)
+                    {
+                        competitorPublicKeys[i + (NUMBER_OF_COMPUTORS - QUORUM)] = minerPublicKeys[NUMBER_OF_COMPUTORS + i];
+                        competitorScores[i + (NUMBER_OF_COMPUTORS - QUORUM)] = minerScores[NUMBER_OF_COMPUTORS + i];
+                        competitorTicks[i + (NUMBER_OF_COMPUTORS - QUORUM)] = minerBestScoreTicks[NUMBER_OF_COMPUTORS + i];
+                    }
+                    else
+                    {
+                        competitorScores[i + (NUMBER_OF_COMPUTORS - QUORUM)] = NO_MINER_SCORE;
+                        competitorTicks[i + (NUMBER_OF_COMPUTORS - QUORUM)] = 0;
+                    }
+                    competitorComputorStatuses[i + (NUMBER_OF_COMPUTORS - QUORUM)] = false;
+                }
+                RELEASE(minerScoreArrayLock);
+
+                // bubble sorting -> top 225 from competitorPublicKeys have computors and candidates which are the best from that subset
+                for (unsigned int i = NUMBER_OF_COMPUTORS - QUORUM; i < (NUMBER_OF_COMPUTORS - QUORUM) * 2; i++)
+                {
+                    int j = i;
+                    const m256i tmpPublicKey = competitorPublicKeys[j];
+                    const unsigned int tmpScore = competitorScores[j];
+                    const unsigned int tmpTick = competitorTicks[j];
+                    const bool tmpComputorStatus = false;
+                    while (j
+                        && ranksBelow(competitorScores[j - 1], competitorTicks[j - 1], competitorScores[j], competitorTicks[j]))
+                    {
+                        competitorPublicKeys[j] = competitorPublicKeys[j - 1];
+                        competitorScores[j] = competitorScores[j - 1];
+                        competitorTicks[j] = competitorTicks[j - 1];
+                        competitorComputorStatuses[j] = competitorComputorStatuses[j - 1];
+                        competitorPublicKeys[--j] = tmpPublicKey;
+                        competitorScores[j] = tmpScore;
+                        competitorTicks[j] = tmpTick;
+                        competitorComputorStatuses[j] = tmpComputorStatus;
+                    }
+                }
+
+                minimumComputorScore = competitorScores[NUMBER_OF_COMPUTORS - QUORUM - 1];
+
+                unsigned char candidateCounter = 0;
+                for (unsigned int i = 0; i < (NUMBER_OF_COMPUTORS - QUORUM) * 2; i++)
+                {
+                    if (!competitorComputorStatuses[i])
+                    {
+                        minimumCandidateScore = competitorScores[i];
+                        candidateCounter++;
+                    }
+                }
+                if (candidateCounter < NUMBER_OF_COMPUTORS - QUORUM)
+                {
+                    minimumCandidateScore = minimumComputorScore;
+                }
+
+                ACQUIRE(minerScoreArrayLock);
+                for (unsigned int i = 0; i < QUORUM; i++)
+                {
+                    system.futureComputors[i] = minerPublicKeys[i];
+                }
+                RELEASE(minerScoreArrayLock);
+
+                for (unsigned int i = QUORUM; i < NUMBER_OF_COMPUTORS; i++)
+                {
+                    system.futureComputors[i] = competitorPublicKeys[i - QUORUM];
+                }
+            }
+        }        
+    }
+    else
+    {
+        for (unsigned int i = 0; i < computorSeedsCount; i++)
+        {
+            if (transaction->sourcePublicKey == computorPublicKeys[i])
+            {
+                ACQUIRE(solutionsLock);
+
+                unsigned int j;
+                for (j = 0; j < system.numberOfSolutions; j++)
+                {
+                    if (transaction->nonce == system.solutions[j].nonce
+                        && transaction->miningSeed == system.solutions[j].miningSeed
+                        && transaction->sourcePublicKey == system.solutions[j].computorPublicKey)
+                    {
+                        solutionPublicationTicks[j] = SOLUTION_RECORDED_FLAG;
+
+                        break;
+                    }
+                }
+                if (j == system.numberOfSolutions
+                    && system.numberOfSolutions < MAX_NUMBER_OF_SOLUTIONS)
+                {
+                    system.solutions[system.numberOfSolutions].computorPublicKey = transaction->sourcePublicKey;
+                    system.solutions[system.numberOfSolutions].miningSeed = transaction->miningSeed;
+                    system.solutions[system.numberOfSolutions].nonce = transaction->nonce;
+                    system.solutions[system.numberOfSolutions].score = transaction->score;
+                    solutionPublicationTicks[system.numberOfSolutions++] = SOLUTION_RECORDED_FLAG;
+                }
+
+                RELEASE(solutionsLock);
+
+                break;
+            }
+        }
+    }
+}
+
+static void processTickTransaction(const Transaction* transaction, unsigned int transactionIndex, unsigned long long processorNumber)
+{
+    PROFILE_SCOPE();
+
+    ASSERT(nextTickData.epoch == system.epoch);
+    ASSERT(transaction != nullptr);
+    ASSERT(transaction->checkValidity());
+    ASSERT(transaction->tick == system.tick);
+
+    const m256i& transactionDigest = nextTickData.transactionDigests[transactionIndex];
+    const m256i& dataLock = nextTickData.timelock;
+
+    // Reject transactions whose source is a smart-contract address ({contractIndex, 0, 0, 0}).
+    // No legitimate keypair maps to such an address, so it can never be a real signer. Some of
+    // these addresses are even low-order FourQ points whose signatures are forgeable (e.g. the
+    // QX contract address {1,0,0,0} is the identity point), which would let an attacker move
+    // funds "from" a contract. Never process such a transaction.
+    if (isPublicKeyOfContract(transaction->sourcePublicKey))
+    {
+        return;
+    }
+
+    // Record the tx with digest
+    ts.transactionsDigestAccess.insertTransaction(transactionDigest, system.tick, transactionIndex);
+
+#if !defined(NDEBUG)
+    if (isZero(transaction->destinationPublicKey))
+    {
+        CHAR16 dbgMsg[200];
+        /*
+        if (transaction->inputType == OracleReplyCommitTransactionPrefix::transactionType())
+        {
+            setText(dbgMsg, L"OracleReplyCommitTransaction found in processTickTransaction(), tick ");
+            appendNumber(dbgMsg, system.tick, FALSE);
+            addDebugMessage(dbgMsg);
+        }
+        */
+        if (transaction->inputType == OracleReplyRevealTransactionPrefix::transactionType())
+        {
+            setText(dbgMsg, L"OracleReplyRevealTransaction found in processTickTransaction(), tick ");
+            appendNumber(dbgMsg, system.tick, FALSE);
+            addDebugMessage(dbgMsg);
+        }
+    }
+#endif
+
+    const int spectrumIndex = ::spectrumIndex(transaction->sourcePublicKey);
+    if (spectrumIndex >= 0)
+    {
+        numberOfTransactions++;
+        bool moneyFlew = false;
+#if ADDON_TX_STATUS_REQUEST
+        txStatusData.tickTxIndexStart[system.tick - system.initialTick + 1] = numberOfTransactions; // qli: part of tx_status_request add-on
+#endif
+        if (decreaseEnergy(spectrumIndex, transaction->amount))
+        {
+            increaseEnergy(transaction->destinationPublicKey, transaction->amount);
+            {
+                const QuTransfer quTransfer = { transaction->sourcePublicKey , transaction->destinationPublicKey , transaction->amount };
+                logger.logQuTransfer(quTransfer);
+            }
+            if (transaction->amount)
+            {
+                moneyFlew = true;
+            }
+
+            if (isZero(transaction->destinationPublicKey))
+            {
+                // Destination is system
+                switch (transaction->inputType)
+                {
+                case VOTE_COUNTER_INPUT_TYPE:
+                {
+                    voteCounter.processTransactionData(transaction, dataLock);
+                }
+                break;
+
+                case FileHeaderTransaction::transactionType():
+                {
+                    if (transaction->amount >= FileFragmentTransactionPrefix::minAmount()
+                        && transaction->inputSize >= FileFragmentTransactionPrefix::minInputSize())
+                    {
+                        // Do nothing
+                    }
+                }
+                break;
+
+                case FileFragmentTransactionPrefix::transactionType():
+                {
+                    if (transaction->amount >= FileFragmentTransactionPrefix::minAmount()
+                        && transaction->inputSize >= FileFragmentTransactionPrefix::minInputSize())
+                    {
+                        // Do nothing
+                    }
+                }
+                break;
+
+                case FileTrailerTransaction::transactionType():
+                {
+                    if (transaction->amount >= FileFragmentTransactionPrefix::minAmount()
+                        && transaction->inputSize >= FileFragmentTransactionPrefix::minInputSize())
+                    {
+                        // Do nothing
+                    }
+                }
+                break;
+
+                case MiningSolutionTransaction::transactionType():
+                {
+                    if (transaction->amount >= MiningSolutionTransaction::minAmount()
+                        && transaction->inputSize >= MiningSolutionTransaction::minInputSize())
+                    {
+                        processTickTransactionSolution((MiningSolutionTransaction*)transaction, processorNumber);
+                    }
+                }
+                break;
+
+                case OracleReplyCommitTransactionPrefix::transactionType():
+                {
+                    oracleEngine.processOracleReplyCommitTransaction((OracleReplyCommitTransactionPrefix*)transaction);
+                }
+                break;
+
+                case OracleReplyRevealTransactionPrefix::transactionType():
+                {
+                    oracleEngine.processOracleReplyRevealTransaction((OracleReplyRevealTransactionPrefix*)transaction, transactionIndex);
+                }
+                break;
+
+                case OcAuthSignatureTransactionPrefix::transactionType():
+                {
+                    ocEngine.processOcAuthSignatureTransaction((OcAuthSignatureTransactionPrefix*)transaction);
+                }
+                break;
+
+                case OracleUserQueryTransactionPrefix::transactionType():
+                {
+                    // check for special cases
+                    const auto* queryTx = (const OracleUserQueryTransactionPrefix*)transaction;
+                    bool forceZeroFee = false;
+                    if (queryTx->oracleInterfaceIndex == OI::DogeShareValidation::oracleInterfaceIndex)
+                    {
+                        // doge share validation query does not cost fees for computors
+                        forceZeroFee = computorIndex(queryTx->sourcePublicKey) >= 0;
+                    }
+
+                    // start user query
+                    int64_t queryId = oracleEngine.startUserQuery(queryTx, transactionIndex, forceZeroFee);
+                    const bool error = queryId < 0;
+
+                    if (queryTx->oracleInterfaceIndex == OI::DogeShareValidation::oracleInterfaceIndex)
+                    {
+                        if (error)
+                        {
+                            // The query was included in the tick but could not be started, not necessary to try again.
+                            customQubicMiningStorage.removeOracleQuery((const OracleUserQueryTransactionPrefix*)transaction);
+                        }
+                        else
+                        {
+                            customQubicMiningStorage.markOracleQueryStarted((const OracleUserQueryTransactionPrefix*)transaction, queryId);
+                        }
+                    }
+
+                    if (error && transaction->amount)
+                    {
+                        oracleEngine.refundFees(transaction->sourcePublicKey, transaction->amount);
+                        moneyFlew = false;
+                    }
+                }
+                break;
+
+                case DogeMiningShareTransaction::transactionType():
+                {
+                    gDogeMiningSharesCounter.processTransactionData(transaction, dataLock);
+                }
+                break;
+
+                case EXECUTION_FEE_REPORT_INPUT_TYPE:
+                {
+                    executionFeeReportCollector.processTransactionData(transaction, dataLock);
+                }
+                break;
+
+                }
+            }
+            else
+            {
+                // Destination is a contract or any other entity.
+                // Contracts are identified by their index stored in the first 64 bits of the id, all
+                // other bits are zeroed. However, the max number of contracts is limited to 2^32 - 1,
+                // only 32 bits are used for the contract index.
+                if (isPublicKeyOfContract(transaction->destinationPublicKey))
+                {
+                    unsigned int contractIndex = (unsigned int)transaction->destinationPublicKey.m256i_u64[0];
+                    // Contract transactions
+                    if (system.epoch == (contractDescriptions[contractIndex].constructionEpoch - 1))
+                    {
+                        // IPO
+                        if (!transaction->amount
+                            && transaction->inputSize == sizeof(ContractIPOBid))
+                        {
+                            processTickTransactionContractIPO(transaction, spectrumIndex, contractIndex);
+                        }
+                    }
+                    else if (system.epoch >= contractDescriptions[contractIndex].constructionEpoch
+                        && system.epoch < contractDescriptions[contractIndex].destructionEpoch)
+                    {
+                        // Check if contract has sufficient execution fee reserve and is not in an error state
+                        if (getContractFeeReserve(contractIndex) <= 0 || contractError[contractIndex] != NoContractError)
+                        {
+                            // Contract has insufficient execution fees or is in error state - refund transaction amount
+                            if (transaction->amount > 0)
+                            {
+                                int destIndex = ::spectrumIndex(transaction->destinationPublicKey);
+                                if (destIndex >= 0)
+                                {
+                                    decreaseEnergy(destIndex, transaction->amount);
+                                    increaseEnergy(transaction->sourcePublicKey, transaction->amount);
+
+                                    const QuTransfer quTransfer = { transaction->destinationPublicKey, transaction->sourcePublicKey, transaction->amount };
+                                    logger.logQuTransfer(quTransfer);
+                                }
+                            }
+                            moneyFlew = false;
+                        }
+                        else
+                        {
+                            // Regular contract procedure invocation
+                            moneyFlew = processTickTransactionContractProcedure(transaction, spectrumIndex, contractIndex);
+                        }
+                    }
+                }
+            }
+        }
+
+#if ADDON_TX_STATUS_REQUEST
+        saveConfirmedTx(numberOfTransactions - 1, moneyFlew, system.tick, transactionDigest); // qli: save tx
+#endif
+    }
+}
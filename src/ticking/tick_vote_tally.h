@@ -0,0 +1,158 @@
+#pragma once
+
+#include "network_messages/tick.h"
+
+#include "platform/m256.h"
+#include "platform/memory.h"
+#include "platform/concurrency.h"
+
+#include "ticking/tick_storage.h"
+
+#include "public_settings.h"
+
+
+// Running tallies of the tick votes of the ticks the tick processor is waiting for (usually system.tick and
+// system.tick + 1), so it doesn't need to rescan all NUMBER_OF_COMPUTORS votes in each loop iteration.
+//
+// The tally of a tick is built once from the votes in the tick storage by the tick processor (rebuild()). After that,
+// processBroadcastTick() adds each newly stored vote with addVote(). Each slot holds the tally of one tick
+// (tick % slotCount). If a slot is taken by another tick, the tally of the former tick is rebuilt on next access.
+//
+// Writers store the vote in tick storage (under the computor lock) before calling addVote() (after releasing the
+// computor lock), so the bitmap of counted votes prevents counting a vote twice if rebuild() runs in between.
+class TickVoteTally
+{
+public:
+    static constexpr unsigned int slotCount = 4;
+    static constexpr unsigned int hashTableSize = 1024;
+    static_assert(hashTableSize > NUMBER_OF_COMPUTORS && (hashTableSize & (hashTableSize - 1)) == 0, "hashTableSize must be power of 2 > NUMBER_OF_COMPUTORS");
+
+    // Summary of digests voted for
+    struct DigestSummary
+    {
+        unsigned int numberOfEmptyDigests;
+        unsigned int mostPopularCount;
+        m256i mostPopularDigest;
+    };
+
+    // Summary of all votes of a tick
+    struct Summary
+    {
+        unsigned int numberOfVotes;
+        unsigned int version; // increased with every vote added
+        DigestSummary transactionDigests;
+        DigestSummary expectedNextTickTransactionDigests;
+    };
+
+    // Invalidate all tallies (for example on begin of epoch)
+    void reset()
+    {
+        for (unsigned int i = 0; i < slotCount; ++i)
+        {
+            ACQUIRE(slots[i].lock);
+            slots[i].valid = false;
+            RELEASE(slots[i].lock);
+        }
+    }
+
+    // Get summary of the votes of tick, rebuilding the tally from the votes in tick storage if needed.
+    // tsCompTicks are the NUMBER_OF_COMPUTORS votes of the tick in tick storage. Only call from tick processor.
+    void getSummary(unsigned int tick, unsigned short epoch, const CompactTick* tsCompTicks, Summary& summary)
+    {
+        Slot& slot = slots[tick % slotCount];
+        ACQUIRE(slot.lock);
+        if (!slot.valid || slot.tick != tick || slot.epoch != epoch)
+            rebuild(slot, tick, epoch, tsCompTicks);
+        summary = slot.summary;
+        RELEASE(slot.lock);
+    }
+
+    // Add vote that has just been stored in tick storage. Can be called from any processor.
+    void addVote(const Tick& vote)
+    {
+        ASSERT(vote.computorIndex < NUMBER_OF_COMPUTORS);
+        Slot& slot = slots[vote.tick % slotCount];
+        ACQUIRE(slot.lock);
+        if (slot.valid && slot.tick == vote.tick && slot.epoch == vote.epoch)
+            slot.add(vote.computorIndex, vote.transactionDigest, vote.expectedNextTickTransactionDigest);
+        RELEASE(slot.lock);
+    }
+
+private:
+    // Groups of equal digests (open addressing with linear probing, count 0 marks free entry)
+    struct DigestGroups
+    {
+        m256i digests[hashTableSize];
+        unsigned short counts[hashTableSize];
+
+        void reset(DigestSummary& summary)
+        {
+            setMem(counts, sizeof(counts), 0);
+            summary.numberOfEmptyDigests = 0;
+            summary.mostPopularCount = 0;
+            summary.mostPopularDigest = m256i::zero();
+        }
+
+        void add(const m256i& digest, DigestSummary& summary)
+        {
+            unsigned int index = digest.m256i_u32[0] & (hashTableSize - 1);
+            while (counts[index] && digests[index] != digest)
+                index = (index + 1) & (hashTableSize - 1);
+            if (!counts[index])
+                digests[index] = digest;
+            if (++counts[index] > summary.mostPopularCount)
+            {
+                summary.mostPopularCount = counts[index];
+                summary.mostPopularDigest = digest;
+            }
+            if (isZero(digest))
+                ++summary.numberOfEmptyDigests;
+        }
+    };
+
+    struct Slot
+    {
+        Summary summary;
+        unsigned long long countedVotes[(NUMBER_OF_COMPUTORS + 63) / 64];
+        DigestGroups transactionDigests;
+        DigestGroups expectedNextTickTransactionDigests;
+        unsigned int tick;
+        unsigned short epoch;
+        bool valid;
+        volatile char lock;
+
+        void add(unsigned short computorIndex, const m256i& transactionDigest, const m256i& expectedNextTickTransactionDigest)
+        {
+            const unsigned long long mask = 1ULL << (computorIndex & 63);
+            if (countedVotes[computorIndex >> 6] & mask)
+                return;
+            countedVotes[computorIndex >> 6] |= mask;
+            ++summary.numberOfVotes;
+            ++summary.version;
+            transactionDigests.add(transactionDigest, summary.transactionDigests);
+            expectedNextTickTransactionDigests.add(expectedNextTickTransactionDigest, summary.expectedNextTickTransactionDigests);
+        }
+    };
+
+    // Build tally from tick storage (slot lock is held by caller)
+    static void rebuild(Slot& slot, unsigned int tick, unsigned short epoch, const CompactTick* tsCompTicks)
+    {
+        slot.tick = tick;
+        slot.epoch = epoch;
+        slot.valid = true;
+        slot.summary.numberOfVotes = 0;
+        slot.summary.version = 0;
+        setMem(slot.countedVotes, sizeof(slot.countedVotes), 0);
+        slot.transactionDigests.reset(slot.summary.transactionDigests);
+        slot.expectedNextTickTransactionDigests.reset(slot.summary.expectedNextTickTransactionDigests);
+        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+        {
+            TickStorage::TicksAccess::acquireLock(i);
+            if (tsCompTicks[i].epoch == epoch)
+                slot.add(i, tsCompTicks[i].transactionDigest, tsCompTicks[i].expectedNextTickTransactionDigest);
+            TickStorage::TicksAccess::releaseLock(i);
+        }
+    }
+
+    Slot slots[slotCount];
+};
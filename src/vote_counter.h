@@ -1,4 +1,5 @@
 #pragma once
+#include <lib/platform_common/qintrin.h>
 #include "platform/memory.h"
 #include "network_messages/transactions.h"
 #define VOTE_COUNTER_INPUT_TYPE 1
@@ -6,6 +7,9 @@
 #define VOTE_COUNTER_NUM_BIT_PER_COMP 10
 static_assert((1<< VOTE_COUNTER_NUM_BIT_PER_COMP) >= NUMBER_OF_COMPUTORS, "Invalid number of bit per datum");
 static_assert(VOTE_COUNTER_DATA_SIZE_IN_BYTES * 8 >= NUMBER_OF_COMPUTORS * VOTE_COUNTER_NUM_BIT_PER_COMP, "Invalid data size");
+// the packet kernels handle groups of 4 10-bit counts, which are 40-bit big-endian words of 5 bytes
+static_assert(VOTE_COUNTER_NUM_BIT_PER_COMP == 10 && NUMBER_OF_COMPUTORS % 4 == 0, "Packet kernels require 10-bit counts of full groups of 4");
+#define VOTE_COUNTER_PACKED_SIZE_IN_BYTES (NUMBER_OF_COMPUTORS * VOTE_COUNTER_NUM_BIT_PER_COMP / 8)
 
 class VoteCounter
 {
@@ -47,6 +51,148 @@ protected:
 		accumulatedVoteCount[computorIdx] += value;
 	}
 
+	// add 1 to counts[j] for each computor j that voted for tick (votes[slotId] of the tick)
+	static void countVotesOfTick(const unsigned int* slotVotes, unsigned int tick, unsigned int* counts)
+	{
+		unsigned int j = 0;
+#if defined (__AVX512F__)
+		const __m512i tick512 = _mm512_set1_epi32(tick);
+		const __m512i one512 = _mm512_set1_epi32(1);
+		for (; j + 16 <= NUMBER_OF_COMPUTORS; j += 16)
+		{
+			const __mmask16 voted = _mm512_cmpeq_epi32_mask(_mm512_loadu_si512(slotVotes + j), tick512);
+			const __m512i c = _mm512_loadu_si512(counts + j);
+			_mm512_storeu_si512(counts + j, _mm512_mask_add_epi32(c, voted, c, one512));
+		}
+#endif
+		const __m256i tick256 = _mm256_set1_epi32(tick);
+		for (; j + 8 <= NUMBER_OF_COMPUTORS; j += 8)
+		{
+			// cmpeq yields -1 in the lanes of the computors that voted
+			const __m256i voted = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(slotVotes + j)), tick256);
+			const __m256i c = _mm256_loadu_si256((const __m256i*)(counts + j));
+			_mm256_storeu_si256((__m256i*)(counts + j), _mm256_sub_epi32(c, voted));
+		}
+		for (; j < NUMBER_OF_COMPUTORS; j++)
+		{
+			if (slotVotes[j] == tick)
+			{
+				counts[j]++;
+			}
+		}
+	}
+
+	// pack NUMBER_OF_COMPUTORS counts to 10 bits each (same layout as update10Bit()), writing the first
+	// VOTE_COUNTER_PACKED_SIZE_IN_BYTES bytes of the packet only. Counts must be < 1024.
+	static void packVoteCounts(const unsigned int* counts, unsigned char* votePacket)
+	{
+		unsigned int i = 0, byteOffset = 0;
+		// Each vector iteration stores 16 bytes, of which the bytes after the packed counts are overwritten by the next iteration.
+#if defined (__AVX512F__)
+		for (; i + 16 <= NUMBER_OF_COMPUTORS && byteOffset + 26 <= VOTE_COUNTER_PACKED_SIZE_IN_BYTES; i += 16, byteOffset += 20)
+		{
+			// (v0 << 10 | v1) in low dword of each qword, then (v0 << 30 | v1 << 20 | v2 << 10 | v3) in low qword of each 128-bit lane
+			__m512i x = _mm512_sllv_epi32(_mm512_loadu_si512(counts + i), _mm512_set1_epi64(10));
+			x = _mm512_and_si512(_mm512_add_epi32(x, _mm512_srli_epi64(x, 32)), _mm512_set1_epi64(0xFFFFF));
+			x = _mm512_sllv_epi64(x, _mm512_set_epi64(0, 20, 0, 20, 0, 20, 0, 20));
+			x = _mm512_add_epi64(x, _mm512_bsrli_epi128(x, 8));
+			// 2 groups per 128-bit lane, stored as 5 big-endian bytes each
+			__m256i groups = _mm512_castsi512_si256(_mm512_permutexvar_epi64(_mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0), x));
+			groups = _mm256_shuffle_epi8(groups, _mm256_setr_epi8(4, 3, 2, 1, 0, 12, 11, 10, 9, 8, -1, -1, -1, -1, -1, -1,
+				4, 3, 2, 1, 0, 12, 11, 10, 9, 8, -1, -1, -1, -1, -1, -1));
+			_mm_storeu_si128((__m128i*)(votePacket + byteOffset), _mm256_castsi256_si128(groups));
+			_mm_storeu_si128((__m128i*)(votePacket + byteOffset + 10), _mm256_extracti128_si256(groups, 1));
+		}
+#endif
+		for (; i + 8 <= NUMBER_OF_COMPUTORS && byteOffset + 16 <= VOTE_COUNTER_PACKED_SIZE_IN_BYTES; i += 8, byteOffset += 10)
+		{
+			__m256i x = _mm256_sllv_epi32(_mm256_loadu_si256((const __m256i*)(counts + i)), _mm256_set1_epi64x(10));
+			x = _mm256_and_si256(_mm256_add_epi32(x, _mm256_srli_epi64(x, 32)), _mm256_set1_epi64x(0xFFFFF));
+			x = _mm256_sllv_epi64(x, _mm256_set_epi64x(0, 20, 0, 20));
+			x = _mm256_add_epi64(x, _mm256_bsrli_epi128(x, 8));
+			__m128i groups = _mm256_castsi256_si128(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 1, 2, 0)));
+			groups = _mm_shuffle_epi8(groups, _mm_setr_epi8(4, 3, 2, 1, 0, 12, 11, 10, 9, 8, -1, -1, -1, -1, -1, -1));
+			_mm_storeu_si128((__m128i*)(votePacket + byteOffset), groups);
+		}
+		for (; i < NUMBER_OF_COMPUTORS; i += 4, byteOffset += 5)
+		{
+			const unsigned long long group = ((unsigned long long)counts[i] << 30) | ((unsigned long long)counts[i + 1] << 20)
+				| ((unsigned long long)counts[i + 2] << 10) | counts[i + 3];
+			for (unsigned int k = 0; k < 5; k++)
+			{
+				votePacket[byteOffset + k] = (unsigned char)(group >> (32 - 8 * k));
+			}
+		}
+	}
+
+	// unpack NUMBER_OF_COMPUTORS 10-bit counts from a packet of VOTE_COUNTER_DATA_SIZE_IN_BYTES bytes (inverse of packVoteCounts())
+	static void unpackVoteCounts(const unsigned char* votePacket, unsigned int* counts)
+	{
+		unsigned int i = 0, byteOffset = 0;
+		// Count k of a group of 4 is in the 16-bit big-endian word at byte k of the group, shifted left by 6 - 2 * k.
+		// Each vector lane loads its word with a byte shuffle (bytes L + k and L + k + 1 of 128-bit lane L, which
+		// starts at dword L of the group).
+#if defined (__AVX512F__)
+		const __m512i wordShuffle512 = _mm512_set_epi8(
+			-1, -1, 6, 7, -1, -1, 5, 6, -1, -1, 4, 5, -1, -1, 3, 4,
+			-1, -1, 5, 6, -1, -1, 4, 5, -1, -1, 3, 4, -1, -1, 2, 3,
+			-1, -1, 4, 5, -1, -1, 3, 4, -1, -1, 2, 3, -1, -1, 1, 2,
+			-1, -1, 3, 4, -1, -1, 2, 3, -1, -1, 1, 2, -1, -1, 0, 1);
+		for (; i + 16 <= NUMBER_OF_COMPUTORS && byteOffset + 32 <= VOTE_COUNTER_DATA_SIZE_IN_BYTES; i += 16, byteOffset += 20)
+		{
+			__m512i x = _mm512_castsi256_si512(_mm256_loadu_si256((const __m256i*)(votePacket + byteOffset)));
+			x = _mm512_permutexvar_epi32(_mm512_set_epi32(6, 5, 4, 3, 5, 4, 3, 2, 4, 3, 2, 1, 3, 2, 1, 0), x);
+			x = _mm512_srlv_epi32(_mm512_shuffle_epi8(x, wordShuffle512), _mm512_set_epi32(0, 2, 4, 6, 0, 2, 4, 6, 0, 2, 4, 6, 0, 2, 4, 6));
+			_mm512_storeu_si512(counts + i, _mm512_and_si512(x, _mm512_set1_epi32(0x3FF)));
+		}
+#endif
+		const __m256i wordShuffle256 = _mm256_set_epi8(
+			-1, -1, 4, 5, -1, -1, 3, 4, -1, -1, 2, 3, -1, -1, 1, 2,
+			-1, -1, 3, 4, -1, -1, 2, 3, -1, -1, 1, 2, -1, -1, 0, 1);
+		for (; i + 8 <= NUMBER_OF_COMPUTORS && byteOffset + 16 <= VOTE_COUNTER_DATA_SIZE_IN_BYTES; i += 8, byteOffset += 10)
+		{
+			__m256i x = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(votePacket + byteOffset)));
+			x = _mm256_permutevar8x32_epi32(x, _mm256_set_epi32(4, 3, 2, 1, 3, 2, 1, 0));
+			x = _mm256_srlv_epi32(_mm256_shuffle_epi8(x, wordShuffle256), _mm256_set_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+			_mm256_storeu_si256((__m256i*)(counts + i), _mm256_and_si256(x, _mm256_set1_epi32(0x3FF)));
+		}
+		for (; i < NUMBER_OF_COMPUTORS; i += 4, byteOffset += 5)
+		{
+			unsigned long long group = 0;
+			for (unsigned int k = 0; k < 5; k++)
+			{
+				group = (group << 8) | votePacket[byteOffset + k];
+			}
+			counts[i] = (unsigned int)(group >> 30) & 0x3FF;
+			counts[i + 1] = (unsigned int)(group >> 20) & 0x3FF;
+			counts[i + 2] = (unsigned int)(group >> 10) & 0x3FF;
+			counts[i + 3] = (unsigned int)group & 0x3FF;
+		}
+	}
+
+	// accumulatedVoteCount[i] += counts[i] for all computors
+	void accumulateVoteCounts(const unsigned int* counts)
+	{
+		unsigned int i = 0;
+#if defined (__AVX512F__)
+		for (; i + 8 <= NUMBER_OF_COMPUTORS; i += 8)
+		{
+			const __m512i c = _mm512_cvtepu32_epi64(_mm256_loadu_si256((const __m256i*)(counts + i)));
+			_mm512_storeu_si512(accumulatedVoteCount + i, _mm512_add_epi64(_mm512_loadu_si512(accumulatedVoteCount + i), c));
+		}
+#endif
+		for (; i + 4 <= NUMBER_OF_COMPUTORS; i += 4)
+		{
+			const __m256i c = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(counts + i)));
+			const __m256i a = _mm256_loadu_si256((const __m256i*)(accumulatedVoteCount + i));
+			_mm256_storeu_si256((__m256i*)(accumulatedVoteCount + i), _mm256_add_epi64(a, c));
+		}
+		for (; i < NUMBER_OF_COMPUTORS; i++)
+		{
+			accumulateVoteCount(i, counts[i]);
+		}
+	}
+
 public:
 	static constexpr unsigned int VoteCounterDataSize = sizeof(votes) + sizeof(accumulatedVoteCount);
 	void init()
@@ -62,34 +208,25 @@ public:
 	}
 
 	// get and compress number of votes of 676 computors to 676x10 bit numbers between [fromTick, toTick)
+	// (the bytes after the VOTE_COUNTER_PACKED_SIZE_IN_BYTES bytes of counts are left unchanged)
 	void compressNewVotesPacket(unsigned int fromTick, unsigned int toTick, unsigned int computorIdx, unsigned char votePacket[VOTE_COUNTER_DATA_SIZE_IN_BYTES])
 	{
-		setMem(votePacket, sizeof(votePacket), 0);
 		setMem(buffer, sizeof(buffer), 0);
 		for (unsigned int i = fromTick; i < toTick; i++)
 		{
 			unsigned int slotId = i % (NUMBER_OF_COMPUTORS * 2);
-			for (int j = 0; j < NUMBER_OF_COMPUTORS; j++)
-			{
-				if (votes[slotId][j] == i)
-				{
-					buffer[j]++;
-				}
-			}
+			countVotesOfTick(votes[slotId], i, buffer);
 		}
 		buffer[computorIdx] = 0; // remove self-report
-		for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
-		{
-			update10Bit(votePacket, i, buffer[i]);
-		}
+		packVoteCounts(buffer, votePacket);
 	}
 
 	bool validateNewVotesPacket(const unsigned char* votePacket, unsigned int computorIdx)
 	{
 		unsigned long long sum = 0;
+		unpackVoteCounts(votePacket, buffer);
 		for (int i = 0; i < NUMBER_OF_COMPUTORS; i++)
 		{
-			buffer[i] = extract10Bit(votePacket, i);
 			if (buffer[i] > NUMBER_OF_COMPUTORS)
 			{
 				return false;
@@ -111,13 +248,10 @@ public:
 
 	void addVotes(const unsigned char* newVotePacket, unsigned int computorIdx)
 	{
+		// validateNewVotesPacket() leaves the unpacked counts in buffer
 		if (validateNewVotesPacket(newVotePacket, computorIdx))
 		{
-			for (int i = 0; i < NUMBER_OF_COMPUTORS; i++)
-			{
-				unsigned int vote_count = extract10Bit(newVotePacket, i);
-				accumulateVoteCount(i, vote_count);
-			}
+			accumulateVoteCounts(buffer);
 		}
 	}
 
@@ -146,6 +280,9 @@ public:
 #endif
 			}
 		}
+#else
+		(void)transaction;
+		(void)dataLock;
 #endif
 	}
 
@@ -12,6 +12,12 @@
 #include "qpi/impl/qpi_spectrum_impl.h"
 #include "qpi/impl/qpi_assets_impl.h"
 
+#include <atomic>
+#include <filesystem>
+#include <numeric>
+#include <random>
+#include <thread>
+
 
 
 
@@ -21,12 +27,12 @@ public:
     AssetsTest()
     {
         initAssets();
-        commonBuffers.init(1, universeSizeInBytes);
+        commonBuffers.init(1, universeSizeInBytes);
     }
 
     ~AssetsTest()
     {
-        commonBuffers.deinit();
+        commonBuffers.deinit();
         deinitAssets();
     }
 
@@ -575,6 +581,7 @@ TEST(TestCoreAssets, AssetIterators)
         {
             // iterate all possession records, compare results of numberOfShares() and numberOfPossessedShares()
             std::map<AssetSharesKey, long long> ownedShares;
+            std::map<AssetSharesKey, long long> possessedShares;
             for (AssetPossessionIterator iter(issuances[i].id); !iter.reachedEnd(); iter.next())
             {
                 long long numOfShares = numberOfShares(issuances[i].id, { iter.owner(), issuances[i].managingContract }, { iter.possessor(), issuances[i].managingContract });
@@ -585,6 +592,14 @@ TEST(TestCoreAssets, AssetIterators)
 
                 AssetSharesKey key{ iter.owner(), issuances[i].managingContract };
                 ownedShares[key] += numOfShares;
+                possessedShares[{ iter.possessor(), iter.possessionManagingContract() }] += numOfShares;
+            }
+
+            // possessions of any owner
+            for (const auto& possessorShares : possessedShares)
+            {
+                const AssetPossessionSelect possession{ possessorShares.first.publicKey, (uint16)possessorShares.first.managingContract };
+                EXPECT_EQ(possessorShares.second, numberOfShares(issuances[i].id, AssetOwnershipSelect::any(), possession));
             }
 
             // iterate all ownership records, compare results of numberOfShares() and numberOfOwnedShares()
@@ -749,9 +764,280 @@ TEST(TestCoreAssets, AssetTransferShareManagementRights)
             }
         }
     }
+}
+
+// Place records of current universe like layout version 1 (all records by the low 32 bits of the public key) and
+// return probe lengths, references are updated if update is true
+static std::vector<unsigned int> placeRecordsLikeLayoutVersion1(bool update)
+{
+    std::vector<unsigned int> probeLengths;
+    AssetRecord* v1Assets = (AssetRecord*)commonBuffers.acquireBuffer(universeSizeInBytes);
+    memset(v1Assets, 0, universeSizeInBytes);
+    std::map<unsigned int, unsigned int> v1Index;
+    for (unsigned int i = 0; i < ASSETS_CAPACITY; i++)
+    {
+        if (assets[i].varStruct.issuance.type == EMPTY)
+            continue;
+        unsigned int idx = assets[i].varStruct.issuance.publicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+        unsigned int probeLength = 1;
+        while (v1Assets[idx].varStruct.issuance.type != EMPTY)
+        {
+            idx = (idx + 1) & (ASSETS_CAPACITY - 1);
+            ++probeLength;
+        }
+        memcpy(&v1Assets[idx], &assets[i], sizeof(AssetRecord));
+        v1Index[i] = idx;
+        probeLengths.push_back(probeLength);
+    }
+    if (update)
+    {
+        for (const auto& [oldIdx, newIdx] : v1Index)
+        {
+            if (v1Assets[newIdx].varStruct.ownership.type == OWNERSHIP)
+                v1Assets[newIdx].varStruct.ownership.issuanceIndex = v1Index[v1Assets[newIdx].varStruct.ownership.issuanceIndex];
+            else if (v1Assets[newIdx].varStruct.possession.type == POSSESSION)
+                v1Assets[newIdx].varStruct.possession.ownershipIndex = v1Index[v1Assets[newIdx].varStruct.possession.ownershipIndex];
+        }
+        memcpy(assets, v1Assets, universeSizeInBytes);
+        as.indexLists.rebuild();
+    }
+    commonBuffers.releaseBuffer(v1Assets);
+    return probeLengths;
+}
+
+// Build universe with contract-like issuers (small keys), an exchange holding shares of all assets, and a few hot
+// assets with many holders
+static void buildUniverseWithHotAssets(unsigned int assetCount, unsigned int hotAssetHolders, unsigned int holders)
+{
+    std::mt19937_64 gen64(42);
+    const m256i exchange(1, 0, 0, 0);
+    for (unsigned int a = 0; a < assetCount; ++a)
+    {
+        const m256i issuer(a % 50 + 2, 0, 0, 0);
+        char name[8] = { 0 };
+        snprintf(name, sizeof(name), "A%u", a);
+        const unsigned int holderCount = (a < 3) ? hotAssetHolders : holders;
+        const long long numberOfShares = (holderCount + 1) * 10;
+        int issuanceIdx, ownershipIdx, possessionIdx, destOwnershipIdx, destPossessionIdx;
+        ASSERT_EQ(issueAsset(issuer, name, 0, CONTRACT_ASSET_UNIT_OF_MEASUREMENT, numberOfShares, 1, &issuanceIdx, &ownershipIdx, &possessionIdx), numberOfShares);
+        ASSERT_TRUE(transferShareOwnershipAndPossession(ownershipIdx, possessionIdx, exchange, 10, &destOwnershipIdx, &destPossessionIdx, false));
+        for (unsigned int h = 1; h < holderCount; ++h)
+        {
+            const m256i holder(gen64(), gen64(), gen64(), gen64());
+            ASSERT_TRUE(transferShareOwnershipAndPossession(ownershipIdx, possessionIdx, holder, 10, &destOwnershipIdx, &destPossessionIdx, false));
+        }
+    }
+}
+
+static void printProbeLengthHistogram(const char* title, const std::vector<unsigned int>& probeLengths)
+{
+    // bins of powers of 2
+    unsigned int histogram[32] = { 0 };
+    for (unsigned int probeLength : probeLengths)
+    {
+        unsigned int bin = 0;
+        while ((2u << bin) <= probeLength)
+            ++bin;
+        ++histogram[bin];
+    }
+    std::cout << title << " probe length histogram:";
+    for (int i = 0; i < 32; ++i)
+    {
+        if (histogram[i])
+            std::cout << " [" << (1u << i) << ", " << (2u << i) << "[: " << histogram[i];
+    }
+    std::cout << std::endl;
+}
+
+TEST(TestCoreAssets, ProbeLengthsWithHotAssets)
+{
+    AssetsTest test;
+    test.clearUniverse();
+    buildUniverseWithHotAssets(1000, 20000, 20);
+    test.checkAssetsConsistency();
+    EXPECT_TRUE(isUniverseLayoutCurrent());
+
+    // probe lengths of current layout
+    std::vector<unsigned int> probeLengths;
+    for (unsigned int i = 0; i < ASSETS_CAPACITY; i++)
+    {
+        if (assets[i].varStruct.issuance.type != EMPTY)
+            probeLengths.push_back(((i - universeHashIndexOfRecord(i)) & (ASSETS_CAPACITY - 1)) + 1);
+    }
+
+    // probe lengths of the same records in layout version 1
+    std::vector<unsigned int> v1ProbeLengths = placeRecordsLikeLayoutVersion1(false);
+    ASSERT_EQ(probeLengths.size(), v1ProbeLengths.size());
+
+    printProbeLengthHistogram("Layout version 1", v1ProbeLengths);
+    printProbeLengthHistogram("Current layout", probeLengths);
+
+    const unsigned int maxProbeLength = *std::max_element(probeLengths.begin(), probeLengths.end());
+    const unsigned int v1MaxProbeLength = *std::max_element(v1ProbeLengths.begin(), v1ProbeLengths.end());
+    const unsigned long long sumProbeLength = std::accumulate(probeLengths.begin(), probeLengths.end(), 0ull);
+    const unsigned long long v1SumProbeLength = std::accumulate(v1ProbeLengths.begin(), v1ProbeLengths.end(), 0ull);
+    EXPECT_GT(v1MaxProbeLength, 1000u);
+    EXPECT_LE(maxProbeLength, 16u);
+    EXPECT_LT(sumProbeLength * 10, v1SumProbeLength);
+}
+
+TEST(TestCoreAssets, MigrateUniverseLayout)
+{
+    AssetsTest test;
+    test.clearUniverse();
+    buildUniverseWithHotAssets(100, 1000, 10);
+
+    // remember shares of all possessions
+    struct PossessionKey
+    {
+        Asset asset;
+        m256i owner, possessor;
+        long long shares;
+    };
+    std::vector<PossessionKey> possessions;
+    for (AssetIssuanceIterator iterI(AssetIssuanceSelect::any()); !iterI.reachedEnd(); iterI.next())
+    {
+        const Asset asset{ iterI.issuer(), iterI.assetName() };
+        for (AssetPossessionIterator iterP(asset); !iterP.reachedEnd(); iterP.next())
+            possessions.push_back({ asset, iterP.owner(), iterP.possessor(), iterP.numberOfPossessedShares() });
+    }
+    EXPECT_EQ(possessions.size(), 3 * 1001 + 97 * 11u);
+
+    // convert to layout version 1 and save
+    placeRecordsLikeLayoutVersion1(true);
+    EXPECT_FALSE(isUniverseLayoutCurrent());
+    ASSERT_EQ(save(L"universe.tst", universeSizeInBytes, (unsigned char*)assets), (long long)universeSizeInBytes);
+
+    // loading migrates
+    test.clearUniverse();
+    EXPECT_FALSE(loadUniverse(L"universe.tst", nullptr, /*rebuildIndexLists=*/false));
+    EXPECT_TRUE(loadUniverse(L"universe.tst"));
+    EXPECT_TRUE(isUniverseLayoutCurrent());
+    test.checkAssetsConsistency();
+    for (const auto& p : possessions)
+        EXPECT_EQ(numberOfPossessedShares(p.asset.assetName, p.asset.issuer, p.owner, p.possessor, 1, 1), p.shares);
+    std::filesystem::remove("universe.tst");
+}
+
+TEST(TestCoreAssets, OptimisticReadsDuringWrites)
+{
+    AssetsTest test;
+    test.clearUniverse();
+
+    // asset whose shares are moved between holders by the writer thread
+    constexpr unsigned int holderCount = 16;
+    constexpr long long sharesPerHolder = 100000;
+    constexpr long long totalShares = holderCount * sharesPerHolder;
+    constexpr long long newAssetShares = 1000;
+    const m256i issuer(2, 0, 0, 0);
+    const Asset asset{ issuer, assetNameFromString("STRESS") };
+    m256i holders[holderCount];
+    int ownershipIndices[holderCount], possessionIndices[holderCount];
+    int issuanceIdx;
+    ASSERT_EQ(issueAsset(issuer, "STRESS", 0, CONTRACT_ASSET_UNIT_OF_MEASUREMENT, totalShares, 1, &issuanceIdx, &ownershipIndices[0], &possessionIndices[0]), totalShares);
+    holders[0] = issuer;
+    std::mt19937_64 gen64(42);
+    for (unsigned int h = 1; h < holderCount; ++h)
+    {
+        holders[h] = m256i(gen64(), gen64(), gen64(), gen64());
+        ASSERT_TRUE(transferShareOwnershipAndPossession(ownershipIndices[0], possessionIndices[0], holders[h], sharesPerHolder, &ownershipIndices[h], &possessionIndices[h], false));
+    }
+
+    // writer like the tick / contract processor: transfers shares between holders and issues new assets
+    constexpr unsigned int transferCount = 100000;
+    std::atomic<bool> writerDone = false;
+    std::atomic<unsigned int> newAssetsIssued = 0;
+    std::thread writer([&]()
+        {
+            std::mt19937_64 gen(1);
+            int destinationOwnershipIdx, destinationPossessionIdx;
+            for (unsigned int i = 0; i < transferCount; ++i)
+            {
+                const unsigned int from = gen() % holderCount, to = gen() % holderCount;
+                transferShareOwnershipAndPossession(ownershipIndices[from], possessionIndices[from], holders[to], 1 + gen() % 1000,
+                    &destinationOwnershipIdx, &destinationPossessionIdx, true);
+                if (i % 1000 == 0)
+                {
+                    char name[8] = { 0 };
+                    snprintf(name, sizeof(name), "N%u", newAssetsIssued.load());
+                    int newIssuanceIdx, newOwnershipIdx, newPossessionIdx;
+                    issueAsset(issuer, name, 0, CONTRACT_ASSET_UNIT_OF_MEASUREMENT, newAssetShares, 1, &newIssuanceIdx, &newOwnershipIdx, &newPossessionIdx);
+                    ++newAssetsIssued;
+                }
+            }
+            writerDone = true;
+        });
+
+    // readers like the request processors, counting inconsistencies instead of using EXPECT in threads
+    std::atomic<unsigned long long> tornRecords = 0, wrongTotals = 0, wrongBalances = 0, reads = 0;
+    std::vector<std::thread> readers;
+    readers.emplace_back([&]()
+        {
+            // copy possession records of all holders and check that the copy is consistent
+            while (!writerDone)
+            {
+                AssetRecord records[holderCount];
+                long long sequence;
+                do
+                {
+                    sequence = universeSequenceLock.beginRead();
+                    for (unsigned int h = 0; h < holderCount; ++h)
+                        copyMem(&records[h], &assets[possessionIndices[h]], sizeof(AssetRecord));
+                } while (!universeSequenceLock.validateRead(sequence));
+
+                long long sum = 0;
+                for (unsigned int h = 0; h < holderCount; ++h)
+                {
+                    const auto& possession = records[h].varStruct.possession;
+                    if (possession.type != POSSESSION || possession.publicKey != holders[h] || possession.ownershipIndex != (unsigned int)ownershipIndices[h]
+                        || possession.numberOfShares < 0 || possession.numberOfShares > totalShares)
+                        ++tornRecords;
+                    sum += possession.numberOfShares;
+                }
+                if (sum != totalShares)
+                    ++wrongTotals;
+                ++reads;
+            }
+        });
+    readers.emplace_back([&]()
+        {
+            while (!writerDone)
+            {
+                if (numberOfShares(asset) != totalShares || numberOfShares(asset, AssetOwnershipSelect::any(), AssetPossessionSelect::byManagingContract(1)) != totalShares)
+                    ++wrongTotals;
+                ++reads;
+            }
+        });
+    readers.emplace_back([&]()
+        {
+            std::mt19937_64 gen(2);
+            while (!writerDone)
+            {
+                const m256i& holder = holders[gen() % holderCount];
+                const long long shares = numberOfPossessedShares(asset.assetName, issuer, holder, holder, 1, 1);
+                if (shares < 0 || shares > totalShares)
+                    ++wrongBalances;
+
+                // new assets are either not issued yet or have all shares
+                char name[8] = { 0 };
+                snprintf(name, sizeof(name), "N%u", (unsigned int)(gen() % (transferCount / 1000)));
+                const long long newShares = numberOfPossessedShares(assetNameFromString(name), issuer, issuer, issuer, 1, 1);
+                if (newShares != 0 && newShares != newAssetShares)
+                    ++wrongBalances;
+                ++reads;
+            }
+        });
+
+    writer.join();
+    for (auto& reader : readers)
+        reader.join();
+
+    EXPECT_EQ(tornRecords, 0ull);
+    EXPECT_EQ(wrongTotals, 0ull);
+    EXPECT_EQ(wrongBalances, 0ull);
+    EXPECT_GT(reads, 0ull);
+    EXPECT_EQ(newAssetsIssued, transferCount / 1000);
+    EXPECT_EQ(universeSequenceLock.getSequence() & 1, 0);
+    EXPECT_EQ(numberOfShares(asset), totalShares);
+    test.checkAssetsConsistency();
 }
-
-
-
-
-
@@ -0,0 +1,11 @@
+// Entry point of the benchmark build (qubic_core_benchmarks), see benchmark_util.h
+
+#include "gtest/gtest.h"
+
+int main(int argc, char** argv)
+{
+    // run only the benchmarks unless another filter is given on the command line
+    GTEST_FLAG_SET(filter, "Benchmark.*");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+// Minimal microbenchmark harness for the gtest build.
+//
+// Benchmarks are gtest tests in the suite BENCHMARK_SUITE, placed next to the tests of the component they measure,
+// so they reuse its setup code. The suite is "Benchmark" in the benchmark build (QUBIC_BENCHMARK_BUILD defined, see
+// benchmark_main.cpp), which runs only benchmarks by default. In the test build, the suite is "DISABLED_Benchmark",
+// so benchmarks are skipped unless --gtest_also_run_disabled_tests is given.
+//
+// Each benchmark reports cycles (time stamp counter) and nanoseconds per operation on stdout. If the environment
+// variable QUBIC_BENCHMARK_OUTPUT is set to a file name, all results of the run are written to that file when
+// the test program exits, as CSV if the name ends with ".csv" and as JSON otherwise.
+// QUBIC_BENCHMARK_MIN_TIME_MS overrides the minimum measurement time per benchmark (default 100 ms).
+
+#include "gtest/gtest.h"
+
+#include <lib/platform_common/qintrin.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef QUBIC_BENCHMARK_BUILD
+#define BENCHMARK_SUITE Benchmark
+#else
+#define BENCHMARK_SUITE DISABLED_Benchmark
+#endif
+
+namespace benchmark_util
+{
+
+struct Result
+{
+    std::string name;
+    unsigned long long operations;
+    unsigned long long cycles;
+    unsigned long long nanoseconds;
+
+    double cyclesPerOperation() const
+    {
+        return (operations) ? (double)cycles / (double)operations : 0.0;
+    }
+
+    double nanosecondsPerOperation() const
+    {
+        return (operations) ? (double)nanoseconds / (double)operations : 0.0;
+    }
+};
+
+inline std::vector<Result>& results()
+{
+    static std::vector<Result> r;
+    return r;
+}
+
+// Fixed-point notation with one decimal, also for the large per-operation numbers of long-running operations
+inline std::string formatNumber(double value)
+{
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(1) << value;
+    return s.str();
+}
+
+inline unsigned long long minTimeNanoseconds()
+{
+    const char* env = std::getenv("QUBIC_BENCHMARK_MIN_TIME_MS");
+    const unsigned long long ms = (env && *env) ? std::strtoull(env, nullptr, 10) : 100;
+    return ms * 1000000;
+}
+
+inline void record(const Result& result)
+{
+    results().push_back(result);
+    std::cout << "[benchmark] " << result.name << ": " << formatNumber(result.cyclesPerOperation()) << " cycles/op, "
+        << formatNumber(result.nanosecondsPerOperation()) << " ns/op (" << result.operations << " ops)" << std::endl;
+}
+
+// Measure op(i) for i = 0, 1, 2, ... until the minimum measurement time has passed or maxOperations have been run.
+// The index lets the operation work on fresh data (for example distinct keys for inserts). The clock is only
+// read between batches of doubling size, so the per-operation overhead is the call of op.
+template <typename Op>
+inline Result run(const char* name, Op op, unsigned long long maxOperations = 0xffffffffffffffffllu)
+{
+    const unsigned long long minTime = minTimeNanoseconds();
+    unsigned long long operations = 0;
+    unsigned long long batchSize = 1;
+
+    const auto startTime = std::chrono::steady_clock::now();
+    const unsigned long long startTsc = __rdtsc();
+    unsigned long long elapsed = 0;
+    while (operations < maxOperations && elapsed < minTime)
+    {
+        unsigned long long batchEnd = operations + batchSize;
+        if (batchEnd > maxOperations || batchEnd < operations)
+            batchEnd = maxOperations;
+        for (; operations < batchEnd; ++operations)
+            op(operations);
+        batchSize *= 2;
+        elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    }
+    const unsigned long long cycles = __rdtsc() - startTsc;
+
+    Result result{ name, operations, cycles, elapsed };
+    record(result);
+    return result;
+}
+
+// Measure a single call of a long-running operation (for example a full rebuild), which is counted as one operation.
+template <typename Op>
+inline Result runOnce(const char* name, Op op)
+{
+    return run(name, [&op](unsigned long long) { op(); }, 1);
+}
+
+inline bool endsWith(const std::string& s, const char* suffix)
+{
+    const size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+inline void writeCsv(std::ostream& out)
+{
+    out << "name,operations,cycles_per_op,ns_per_op\n";
+    for (const Result& r : results())
+        out << r.name << "," << r.operations << "," << formatNumber(r.cyclesPerOperation()) << "," << formatNumber(r.nanosecondsPerOperation()) << "\n";
+}
+
+inline void writeJson(std::ostream& out)
+{
+    out << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results().size(); ++i)
+    {
+        const Result& r = results()[i];
+        out << ((i) ? ",\n" : "\n") << "    { \"name\": \"" << r.name << "\", \"operations\": " << r.operations
+            << ", \"cycles_per_op\": " << formatNumber(r.cyclesPerOperation()) << ", \"ns_per_op\": " << formatNumber(r.nanosecondsPerOperation()) << " }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+// Writes the collected results to QUBIC_BENCHMARK_OUTPUT after all tests have run.
+class OutputEnvironment : public ::testing::Environment
+{
+public:
+    void TearDown() override
+    {
+        const char* fileName = std::getenv("QUBIC_BENCHMARK_OUTPUT");
+        if (!fileName || !*fileName || results().empty())
+            return;
+        std::ofstream out(fileName);
+        if (!out)
+        {
+            std::cout << "[benchmark] cannot write " << fileName << std::endl;
+            return;
+        }
+        if (endsWith(fileName, ".csv"))
+            writeCsv(out);
+        else
+            writeJson(out);
+        std::cout << "[benchmark] wrote " << results().size() << " results to " << fileName << std::endl;
+    }
+};
+
+// Registered once per program, even though every benchmark translation unit includes this header.
+inline ::testing::Environment* const outputEnvironment = ::testing::AddGlobalTestEnvironment(new OutputEnvironment);
+
+}
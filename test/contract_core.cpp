@@ -118,6 +118,65 @@ TEST(TestCoreContractCore, StackBuffer)
     }
 }
 
+static bool isZeroMemory(const char* p, unsigned int size)
+{
+    for (unsigned int i = 0; i < size; ++i)
+        if (p[i])
+            return false;
+    return true;
+}
+
+TEST(TestCoreContractCore, StackBufferZeroed)
+{
+    StackBuffer<unsigned int, 1000> s;
+    s.init();
+
+    // memory isn't known to be zero after init
+    char* p = s.allocate(200);
+    setMem(p, 200, 0xab);
+    s.free();
+    char* q;
+    EXPECT_EQ(q = s.allocateZeroed(100), p);
+    EXPECT_TRUE(isZeroMemory(q, 100));
+    setMem(q, 100, 0xcd);
+    s.free();
+
+    // clean the whole buffer, afterwards zeroed allocations see written memory as zero again
+    s.zeroUnused();
+    EXPECT_TRUE(isZeroMemory(p, 200));
+    for (int round = 0; round < 3; ++round)
+    {
+        EXPECT_NE(p = s.allocateZeroed(50), nullptr);
+        EXPECT_TRUE(isZeroMemory(p, 50));
+        setMem(p, 50, 0x11);
+        EXPECT_NE(q = s.allocateZeroed(300), nullptr);
+        EXPECT_TRUE(isZeroMemory(q, 300));
+        setMem(q, 300, 0x22);
+        s.free();
+        EXPECT_NE(q = s.allocateZeroed(400), nullptr);
+        EXPECT_TRUE(isZeroMemory(q, 400));
+        setMem(q, 400, 0x33);
+        s.free();
+        s.free();
+        EXPECT_EQ(s.size(), 0);
+        if (round == 1)
+            s.zeroUnused();
+    }
+
+    // zeroUnused() keeps the allocated part
+    EXPECT_NE(p = s.allocate(10), nullptr);
+    setMem(p, 10, 0x44);
+    EXPECT_NE(q = s.allocate(20), nullptr);
+    setMem(q, 20, 0x55);
+    s.free();
+    s.zeroUnused();
+    EXPECT_EQ(p[0], 0x44);
+    EXPECT_EQ(p[9], 0x44);
+    EXPECT_TRUE(isZeroMemory(q, 20));
+    EXPECT_NE(q = s.allocateZeroed(900), nullptr);
+    EXPECT_TRUE(isZeroMemory(q, 900));
+}
+
 TEST(TestCoreContractCore, ContractActionTracker)
 {
     m256i id0(0, 1, 2, 3);
@@ -2,6 +2,10 @@
 
 #include "contract_testing.h"
 
+#include <algorithm>
+#include <chrono>
+#include <random>
+
 #define PRINT_DETAILS 0
 
 static constexpr uint64 QX_ISSUE_ASSET_FEE = 1000000000ull;
@@ -25,82 +29,35 @@ public:
         }
     };
 
-    void checkCollectionConsistency()
+    void checkOrderBookConsistency()
     {
-        EXPECT_EQ(_entityOrders.population(), _assetOrders.population());
-
-        std::set<Order> entityOrders;
-        std::map<id, unsigned int> entityCounter;
-        for (uint64 i = 0; i < _entityOrders.capacity(); ++i)
+        // at most one order per entity, asset, side, and price (orders are merged)
+        std::set<Order> orders;
+        uint64 population = 0;
+        for (uint64 i = 0; i < _orders.capacity(); ++i)
         {
-            QX::EntityOrder order = _entityOrders.element(i);
-            if (!order.numberOfShares)
+            if (_orders.isEmptySlot(i))
                 continue;
+            const QX::EntityOrder& order = _orders.element(i);
+            const id book = _orders.book(i);
+            EXPECT_EQ(order.issuer.u64._0, book.u64._0);
+            EXPECT_EQ(order.issuer.u64._1, book.u64._1);
+            EXPECT_EQ(order.issuer.u64._2, book.u64._2);
+            EXPECT_EQ(order.assetName, book.u64._3);
+            EXPECT_GT(order.numberOfShares, 0);
+            EXPECT_GT(_orders.price(i), 0);
+
             Order o;
+            setMemory(o, 0);
             o.issuer = order.issuer;
             o.assetName = order.assetName;
-            o.entity = _entityOrders.pov(i);
-            o.price = _entityOrders.priority(i);
-            o.numberOfShares = order.numberOfShares;
-            entityOrders.insert(o);
-
-            ++entityCounter[o.entity];
-        }
-
-        for (const auto& p : entityCounter)
-        {
-            EXPECT_EQ(_entityOrders.population(p.first), p.second);
-        }
-
-        std::set<Order> assetOrders;
-        for (uint64 i = 0; i < _assetOrders.capacity(); ++i)
-        {
-            QX::AssetOrder order = _assetOrders.element(i);
-            if (!order.numberOfShares)
-                continue;
-            Order o;
-            id pov = _assetOrders.pov(i);
-            o.issuer = id(pov.u64._0, pov.u64._1, pov.u64._2, 0);
-            o.assetName = pov.u64._3;
-            o.entity = order.entity;
-            o.price = _assetOrders.priority(i);
-            o.numberOfShares = order.numberOfShares;
-            assetOrders.insert(o);
-        }
-
-        EXPECT_EQ(entityOrders.size(), assetOrders.size());
-        auto it1 = entityOrders.begin(), it2 = assetOrders.begin();
-        while (it1 != entityOrders.end())
-        {
-            // issuer cannot be fully obtained from assetOrder (4th element missing)
-            EXPECT_EQ(it1->issuer.u64._0, it2->issuer.u64._0);
-            EXPECT_EQ(it1->issuer.u64._1, it2->issuer.u64._1);
-            EXPECT_EQ(it1->issuer.u64._2, it2->issuer.u64._2);
-            EXPECT_EQ(it1->assetName, it2->assetName);
-            EXPECT_EQ(it1->entity, it2->entity);
-            EXPECT_EQ(it1->price, it2->price);
-            EXPECT_EQ(it1->numberOfShares, it2->numberOfShares);
-            ++it1; ++it2;
-        }
-    }
-
-    void cleanupCollections()
-    {
-        constexpr bool forceCleanup = false;
-        const auto population = _entityOrders.population();
-        checkCollectionConsistency();
-        if (forceCleanup)
-        {
-            _entityOrders.cleanup();
-            _assetOrders.cleanup();
+            o.entity = _orders.owner(i);
+            o.price = (_orders.side(i) == OrderBookSide::bid) ? _orders.price(i) : -_orders.price(i);
+            o.numberOfShares = 0;
+            EXPECT_TRUE(orders.insert(o).second);
+            ++population;
         }
-        else
-        {
-            _entityOrders.cleanupIfNeeded(30);
-            _assetOrders.cleanupIfNeeded(30);
-        }
-        checkCollectionConsistency();
-        EXPECT_EQ(population, _entityOrders.population());
+        EXPECT_EQ(population, _orders.population());
     }
 };
 
@@ -120,13 +77,34 @@ public:
         return (QxChecker*)contractStates[QX_CONTRACT_INDEX];
     }
 
+    // Load state file, migrating it if it has the layout before switching to OrderBook
     bool loadState(const CHAR16* filename)
     {
-        return load(filename, sizeof(QX), contractStates[QX_CONTRACT_INDEX]) == sizeof(QX);
+        QX::OldStateData* oldState = (QX::OldStateData*)malloc(sizeof(QX::OldStateData));
+        bool migrated = load(filename, sizeof(QX::OldStateData), (unsigned char*)oldState) == sizeof(QX::OldStateData);
+        if (migrated)
+            migrateState(*oldState);
+        free(oldState);
+        return migrated || load(filename, sizeof(QX), contractStates[QX_CONTRACT_INDEX]) == sizeof(QX);
+    }
+
+    void migrateState(QX::OldStateData& oldState)
+    {
+        setMem(contractStates[QX_CONTRACT_INDEX], sizeof(QX), 0);
+        QpiContextMigrateProcedureCall qpiContext(QX_CONTRACT_INDEX);
+        EXPECT_EQ(qpiContext.call(&oldState), NoContractError);
     }
 
     // TODO: add other functions
 
+    QX::AssetAskOrders_output assetAskOrders(const id& issuer, uint64 assetName, uint64 offset)
+    {
+        QX::AssetAskOrders_input input{ issuer, assetName, offset };
+        QX::AssetAskOrders_output output;
+        callFunction(QX_CONTRACT_INDEX, 2, input, output);
+        return output;
+    }
+
     QX::AssetBidOrders_output assetBidOrders(const id& issuer, uint64 assetName, uint64 offset)
     {
         QX::AssetBidOrders_input input{ issuer, assetName, offset };
@@ -135,6 +113,14 @@ public:
         return output;
     }
 
+    QX::EntityAskOrders_output entityAskOrders(const id& entity, uint64 offset)
+    {
+        QX::EntityAskOrders_input input{ entity, offset };
+        QX::EntityAskOrders_output output;
+        callFunction(QX_CONTRACT_INDEX, 4, input, output);
+        return output;
+    }
+
     QX::EntityBidOrders_output entityBidOrders(const id& entity, uint64 offset)
     {
         QX::EntityBidOrders_input input{ entity, offset };
@@ -143,6 +129,50 @@ public:
         return output;
     }
 
+    // Get all ask or bid orders of asset, calling AssetAskOrders / AssetBidOrders with increasing offset
+    std::vector<QxChecker::Order> getAssetOrders(const id& issuer, uint64 assetName, bool bids)
+    {
+        std::vector<QxChecker::Order> orders;
+        for (uint64 offset = 0; offset == orders.size(); offset += 256)
+        {
+            if (bids)
+            {
+                const auto output = assetBidOrders(issuer, assetName, offset);
+                for (uint64 i = 0; i < 256 && output.orders.get(i).price; ++i)
+                    orders.push_back({ issuer, assetName, output.orders.get(i).entity, output.orders.get(i).price, output.orders.get(i).numberOfShares });
+            }
+            else
+            {
+                const auto output = assetAskOrders(issuer, assetName, offset);
+                for (uint64 i = 0; i < 256 && output.orders.get(i).price; ++i)
+                    orders.push_back({ issuer, assetName, output.orders.get(i).entity, output.orders.get(i).price, output.orders.get(i).numberOfShares });
+            }
+        }
+        return orders;
+    }
+
+    // Get all ask or bid orders of entity, calling EntityAskOrders / EntityBidOrders with increasing offset
+    std::vector<QxChecker::Order> getEntityOrders(const id& entity, bool bids)
+    {
+        std::vector<QxChecker::Order> orders;
+        for (uint64 offset = 0; offset == orders.size(); offset += 256)
+        {
+            if (bids)
+            {
+                const auto output = entityBidOrders(entity, offset);
+                for (uint64 i = 0; i < 256 && output.orders.get(i).price; ++i)
+                    orders.push_back({ output.orders.get(i).issuer, output.orders.get(i).assetName, entity, output.orders.get(i).price, output.orders.get(i).numberOfShares });
+            }
+            else
+            {
+                const auto output = entityAskOrders(entity, offset);
+                for (uint64 i = 0; i < 256 && output.orders.get(i).price; ++i)
+                    orders.push_back({ output.orders.get(i).issuer, output.orders.get(i).assetName, entity, output.orders.get(i).price, output.orders.get(i).numberOfShares });
+            }
+        }
+        return orders;
+    }
+
     sint64 issueAsset(const id& issuer, uint64 assetName, sint64 numberOfShares, uint64 unitOfMeasurement, sint8 numberOfDecimalPlaces)
     {
         QX::IssueAsset_input input{ assetName, numberOfShares, unitOfMeasurement, numberOfDecimalPlaces };
@@ -151,6 +181,46 @@ public:
         return output.issuedNumberOfShares;
     }
 
+    sint64 transferShareOwnershipAndPossession(const id& issuer, uint64 assetName, const id& currentOwnerAndPossessor, const id& newOwnerAndPossessor, sint64 numberOfShares)
+    {
+        QX::TransferShareOwnershipAndPossession_input input{ issuer, newOwnerAndPossessor, assetName, numberOfShares };
+        QX::TransferShareOwnershipAndPossession_output output;
+        invokeUserProcedure(QX_CONTRACT_INDEX, 2, input, output, currentOwnerAndPossessor, getState()->_transferFee);
+        return output.transferredNumberOfShares;
+    }
+
+    sint64 addToAskOrder(const id& entity, const id& issuer, uint64 assetName, sint64 price, sint64 numberOfShares)
+    {
+        QX::AddToAskOrder_input input{ issuer, assetName, price, numberOfShares };
+        QX::AddToAskOrder_output output;
+        invokeUserProcedure(QX_CONTRACT_INDEX, 5, input, output, entity, 0);
+        return output.addedNumberOfShares;
+    }
+
+    sint64 addToBidOrder(const id& entity, const id& issuer, uint64 assetName, sint64 price, sint64 numberOfShares)
+    {
+        QX::AddToBidOrder_input input{ issuer, assetName, price, numberOfShares };
+        QX::AddToBidOrder_output output;
+        invokeUserProcedure(QX_CONTRACT_INDEX, 6, input, output, entity, price * numberOfShares);
+        return output.addedNumberOfShares;
+    }
+
+    sint64 removeFromAskOrder(const id& entity, const id& issuer, uint64 assetName, sint64 price, sint64 numberOfShares)
+    {
+        QX::RemoveFromAskOrder_input input{ issuer, assetName, price, numberOfShares };
+        QX::RemoveFromAskOrder_output output;
+        invokeUserProcedure(QX_CONTRACT_INDEX, 7, input, output, entity, 0);
+        return output.removedNumberOfShares;
+    }
+
+    sint64 removeFromBidOrder(const id& entity, const id& issuer, uint64 assetName, sint64 price, sint64 numberOfShares)
+    {
+        QX::RemoveFromBidOrder_input input{ issuer, assetName, price, numberOfShares };
+        QX::RemoveFromBidOrder_output output;
+        invokeUserProcedure(QX_CONTRACT_INDEX, 8, input, output, entity, 0);
+        return output.removedNumberOfShares;
+    }
+
     // TODO: add other procedures
 
     void endTick(bool expectSuccess = true)
@@ -189,7 +259,7 @@ TEST(ContractQx, BugEntityBidOrders)
         return;
     }
 
-    qx.getState()->checkCollectionConsistency();
+    qx.getState()->checkOrderBookConsistency();
 
     auto entityBidOrders = qx.entityBidOrders(entityPubkey, 0);
     int entityBidOrdersCount = 0;
@@ -236,18 +306,395 @@ TEST(ContractQx, BugEntityBidOrders)
     EXPECT_EQ(assertBidOrdersCount, entityBidOrdersCount);
 }
 
-TEST(ContractQx, CleanupCollections)
+TEST(ContractQx, LoadStateFile)
 {
     ContractTestingQx qx;
     if (qx.loadState(L"contract0001.163"))
     {
         std::cout << "QX state file:" << std::endl;
         QxChecker* state = qx.getState();
+        state->checkOrderBookConsistency();
         qx.endTick();
-        state->cleanupCollections();
+        state->checkOrderBookConsistency();
     }
     else
     {
         std::cout << "QX state file not found. Skipping file test..." << std::endl;
     }
 }
+
+TEST(ContractQx, MigrateOrders)
+{
+    ContractTestingQx qx;
+
+    // Build state with layout before switching to OrderBook, adding and removing orders like QX did before
+    QX::OldStateData* oldState = (QX::OldStateData*)malloc(sizeof(QX::OldStateData));
+    setMem(oldState, sizeof(QX::OldStateData), 0);
+    oldState->_earnedAmount = 123456;
+    oldState->_distributedAmount = 12345;
+    oldState->_burnedAmount = 1234;
+    oldState->_assetIssuanceFee = 1000000000;
+    oldState->_transferFee = 100;
+    oldState->_tradeFee = 3000000;
+    oldState->_assetOrders.reset();
+    oldState->_entityOrders.reset();
+
+    constexpr unsigned int assetCount = 4;
+    constexpr unsigned int entityCount = 30;
+    std::vector<id> issuers, entities;
+    for (unsigned int a = 0; a < assetCount; ++a)
+        issuers.push_back(id(7, 8, 9, 10 + a));
+    for (unsigned int e = 0; e < entityCount; ++e)
+        entities.push_back(id(e, 1, 2, 3));
+
+    std::mt19937_64 gen(1337);
+    std::set<std::tuple<unsigned int, unsigned int, sint64>> existing;
+    for (int i = 0; i < 4000; ++i)
+    {
+        if (gen() % 4 == 0 && oldState->_assetOrders.population() > 0)
+        {
+            // remove order
+            const sint64 assetOrderIndex = gen() % oldState->_assetOrders.population();
+            const id pov = oldState->_assetOrders.pov(assetOrderIndex);
+            const sint64 priority = oldState->_assetOrders.priority(assetOrderIndex);
+            const QX::AssetOrder assetOrder = oldState->_assetOrders.element(assetOrderIndex);
+            sint64 entityOrderIndex = oldState->_entityOrders.headIndex(assetOrder.entity, priority);
+            while (oldState->_entityOrders.element(entityOrderIndex).assetName != pov.u64._3)
+                entityOrderIndex = oldState->_entityOrders.nextElementIndex(entityOrderIndex);
+            oldState->_assetOrders.remove(assetOrderIndex);
+            oldState->_entityOrders.remove(entityOrderIndex);
+            existing.erase(std::make_tuple((unsigned int)assetOrder.entity.u64._0, (unsigned int)(pov.u64._3 - 1000), priority));
+            continue;
+        }
+
+        const unsigned int e = gen() % entityCount;
+        const unsigned int a = gen() % assetCount;
+        const sint64 priority = (gen() & 1) ? sint64(100 + gen() % 20) : -sint64(110 + gen() % 20);
+        if (!existing.insert(std::make_tuple(e, a, priority)).second)
+            continue;
+        id pov = issuers[a];
+        pov.u64._3 = 1000 + a;
+        const sint64 numberOfShares = 1 + gen() % 1000;
+        oldState->_assetOrders.add(pov, QX::AssetOrder{ entities[e], numberOfShares }, priority);
+        oldState->_entityOrders.add(entities[e], QX::EntityOrder{ issuers[a], 1000 + a, numberOfShares }, priority);
+    }
+
+    qx.migrateState(*oldState);
+    QxChecker* state = qx.getState();
+    state->checkOrderBookConsistency();
+    EXPECT_EQ(state->_orders.population(), oldState->_assetOrders.population());
+    EXPECT_EQ(state->_earnedAmount, oldState->_earnedAmount);
+    EXPECT_EQ(state->_distributedAmount, oldState->_distributedAmount);
+    EXPECT_EQ(state->_burnedAmount, oldState->_burnedAmount);
+    EXPECT_EQ(state->_assetIssuanceFee, oldState->_assetIssuanceFee);
+    EXPECT_EQ(state->_transferFee, oldState->_transferFee);
+    EXPECT_EQ(state->_tradeFee, oldState->_tradeFee);
+
+    // Orders of assets are listed exactly like before (priority queue order)
+    for (unsigned int a = 0; a < assetCount; ++a)
+    {
+        id pov = issuers[a];
+        pov.u64._3 = 1000 + a;
+        for (int bids = 0; bids < 2; ++bids)
+        {
+            std::vector<QxChecker::Order> expected;
+            sint64 idx = (bids) ? oldState->_assetOrders.headIndex(pov) : oldState->_assetOrders.headIndex(pov, 0);
+            while (idx != NULL_INDEX && (!bids || oldState->_assetOrders.priority(idx) > 0))
+            {
+                const QX::AssetOrder& order = oldState->_assetOrders.element(idx);
+                const sint64 priority = oldState->_assetOrders.priority(idx);
+                expected.push_back({ issuers[a], 1000 + a, order.entity, (bids) ? priority : -priority, order.numberOfShares });
+                idx = oldState->_assetOrders.nextElementIndex(idx);
+            }
+            const auto actual = qx.getAssetOrders(issuers[a], 1000 + a, bids);
+            ASSERT_EQ(actual.size(), expected.size());
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                EXPECT_EQ(actual[i].entity, expected[i].entity);
+                EXPECT_EQ(actual[i].price, expected[i].price);
+                EXPECT_EQ(actual[i].numberOfShares, expected[i].numberOfShares);
+            }
+        }
+    }
+
+    // Orders of entities are listed exactly like before (priority queue order, also among assets with the same price)
+    for (unsigned int e = 0; e < entityCount; ++e)
+    {
+        for (int bids = 0; bids < 2; ++bids)
+        {
+            std::vector<QxChecker::Order> expected;
+            sint64 idx = (bids) ? oldState->_entityOrders.headIndex(entities[e]) : oldState->_entityOrders.headIndex(entities[e], 0);
+            while (idx != NULL_INDEX && (!bids || oldState->_entityOrders.priority(idx) > 0))
+            {
+                const QX::EntityOrder& order = oldState->_entityOrders.element(idx);
+                const sint64 priority = oldState->_entityOrders.priority(idx);
+                expected.push_back({ order.issuer, order.assetName, entities[e], (bids) ? priority : -priority, order.numberOfShares });
+                idx = oldState->_entityOrders.nextElementIndex(idx);
+            }
+            const auto actual = qx.getEntityOrders(entities[e], bids);
+            ASSERT_EQ(actual.size(), expected.size());
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                EXPECT_EQ(actual[i].issuer, expected[i].issuer);
+                EXPECT_EQ(actual[i].assetName, expected[i].assetName);
+                EXPECT_EQ(actual[i].price, expected[i].price);
+                EXPECT_EQ(actual[i].numberOfShares, expected[i].numberOfShares);
+            }
+        }
+    }
+
+    free(oldState);
+}
+
+// Simple reference model of the order matching of QX, used to check that the contract behaves as expected (and as
+// before) when replaying an order flow
+class QxOrderFlowModel
+{
+public:
+    struct Order
+    {
+        unsigned int entity;
+        unsigned int asset;
+        bool isBid;
+        sint64 price;
+        sint64 numberOfShares;
+        uint64 sequence; // time of adding, which decides among orders with the same price
+    };
+
+    std::vector<Order> orders;
+    std::vector<sint64> balances;
+    std::vector<std::vector<sint64>> shares; // [entity][asset]
+    uint64 earnedAmount = 0;
+    uint64 nextSequence = 0;
+    uint64 tradeCount = 0;
+    sint64 tradeFee;
+
+    QxOrderFlowModel(unsigned int entityCount, unsigned int assetCount, sint64 initialBalance, sint64 initialShares, sint64 tradeFee)
+        : balances(entityCount, initialBalance), shares(entityCount, std::vector<sint64>(assetCount, initialShares)), tradeFee(tradeFee)
+    {
+    }
+
+    // Orders of asset or entity side, best price first
+    std::vector<Order> list(bool isBid, int asset, int entity) const
+    {
+        std::vector<Order> result;
+        for (const auto& o : orders)
+        {
+            if (o.isBid == isBid && (asset < 0 || int(o.asset) == asset) && (entity < 0 || int(o.entity) == entity))
+                result.push_back(o);
+        }
+        std::sort(result.begin(), result.end(), [isBid](const Order& a, const Order& b)
+            {
+                if (a.price != b.price)
+                    return isBid ? a.price > b.price : a.price < b.price;
+                return a.sequence < b.sequence;
+            });
+        return result;
+    }
+
+    sint64 addToOrder(unsigned int entity, unsigned int asset, bool isBid, sint64 price, sint64 numberOfShares)
+    {
+        if (isBid)
+        {
+            balances[entity] -= price * numberOfShares;
+        }
+        else
+        {
+            sint64 reserved = 0;
+            for (const auto& o : orders)
+            {
+                if (!o.isBid && o.entity == entity && o.asset == asset)
+                    reserved += o.numberOfShares;
+            }
+            if (shares[entity][asset] - reserved < numberOfShares)
+                return 0;
+        }
+
+        Order* existing = find(entity, asset, isBid, price);
+        if (existing)
+        {
+            existing->numberOfShares += numberOfShares;
+            return numberOfShares;
+        }
+
+        const sint64 addedNumberOfShares = numberOfShares;
+        std::vector<Order> opposite = list(!isBid, asset, -1);
+        for (const auto& o : opposite)
+        {
+            if (numberOfShares == 0 || (isBid ? o.price > price : o.price < price))
+                break;
+            const sint64 n = std::min(o.numberOfShares, numberOfShares);
+            const sint64 fee = o.price * n * tradeFee / 1000000000LL + 1;
+            const unsigned int seller = isBid ? o.entity : entity;
+            const unsigned int buyer = isBid ? entity : o.entity;
+            earnedAmount += fee;
+            balances[seller] += o.price * n - fee;
+            shares[seller][asset] -= n;
+            shares[buyer][asset] += n;
+            if (isBid)
+                balances[entity] += (price - o.price) * n;
+            find(o.entity, asset, !isBid, o.price)->numberOfShares -= n;
+            numberOfShares -= n;
+            ++tradeCount;
+        }
+        removeEmpty();
+
+        if (numberOfShares > 0)
+            orders.push_back(Order{ entity, asset, isBid, price, numberOfShares, nextSequence++ });
+        return addedNumberOfShares;
+    }
+
+    sint64 removeFromOrder(unsigned int entity, unsigned int asset, bool isBid, sint64 price, sint64 numberOfShares)
+    {
+        Order* existing = find(entity, asset, isBid, price);
+        if (!existing || existing->numberOfShares < numberOfShares)
+            return 0;
+        existing->numberOfShares -= numberOfShares;
+        removeEmpty();
+        if (isBid)
+            balances[entity] += price * numberOfShares;
+        return numberOfShares;
+    }
+
+private:
+    Order* find(unsigned int entity, unsigned int asset, bool isBid, sint64 price)
+    {
+        for (auto& o : orders)
+        {
+            if (o.entity == entity && o.asset == asset && o.isBid == isBid && o.price == price)
+                return &o;
+        }
+        return nullptr;
+    }
+
+    void removeEmpty()
+    {
+        orders.erase(std::remove_if(orders.begin(), orders.end(), [](const Order& o) { return o.numberOfShares == 0; }), orders.end());
+    }
+};
+
+TEST(ContractQx, OrderBookReplay)
+{
+    ContractTestingQx qx;
+
+    constexpr unsigned int assetCount = 3;
+    constexpr unsigned int entityCount = 24;
+    constexpr sint64 initialBalance = 1000000000000LL;
+    constexpr sint64 initialShares = 1000000;
+    constexpr int orderCount = 6000;
+
+    // issue assets and distribute shares
+    std::vector<id> issuers, entities;
+    std::vector<uint64> assetNames;
+    for (unsigned int a = 0; a < assetCount; ++a)
+    {
+        issuers.push_back(id(1000 + a, 2, 3, 4 + a));
+        assetNames.push_back(assetNameFromString(("ASSET" + std::to_string(a)).c_str()));
+        increaseEnergy(issuers[a], QX_ISSUE_ASSET_FEE + entityCount * qx.getState()->_transferFee);
+        EXPECT_EQ(qx.issueAsset(issuers[a], assetNames[a], entityCount * initialShares, 0, 0), entityCount * initialShares);
+    }
+    for (unsigned int e = 0; e < entityCount; ++e)
+    {
+        entities.push_back(id(e, 100, 200, 300));
+        increaseEnergy(entities[e], initialBalance);
+        for (unsigned int a = 0; a < assetCount; ++a)
+            EXPECT_EQ(qx.transferShareOwnershipAndPossession(issuers[a], assetNames[a], issuers[a], entities[e], initialShares), initialShares);
+    }
+    const uint64 initialEarnedAmount = qx.getState()->_earnedAmount;
+    QxOrderFlowModel model(entityCount, assetCount, initialBalance, initialShares, qx.getState()->_tradeFee);
+
+    auto checkListings = [&]()
+    {
+        for (unsigned int a = 0; a < assetCount; ++a)
+        {
+            for (int isBid = 0; isBid < 2; ++isBid)
+            {
+                const auto expected = model.list(isBid, a, -1);
+                const auto actual = qx.getAssetOrders(issuers[a], assetNames[a], isBid);
+                ASSERT_EQ(actual.size(), expected.size());
+                for (size_t i = 0; i < expected.size(); ++i)
+                {
+                    EXPECT_EQ(actual[i].entity, entities[expected[i].entity]);
+                    EXPECT_EQ(actual[i].price, expected[i].price);
+                    EXPECT_EQ(actual[i].numberOfShares, expected[i].numberOfShares);
+                }
+            }
+        }
+        for (unsigned int e = 0; e < entityCount; ++e)
+        {
+            for (int isBid = 0; isBid < 2; ++isBid)
+            {
+                const auto expected = model.list(isBid, -1, e);
+                const auto actual = qx.getEntityOrders(entities[e], isBid);
+                ASSERT_EQ(actual.size(), expected.size());
+                for (size_t i = 0; i < expected.size(); ++i)
+                {
+                    EXPECT_EQ(actual[i].issuer, issuers[expected[i].asset]);
+                    EXPECT_EQ(actual[i].assetName, assetNames[expected[i].asset]);
+                    EXPECT_EQ(actual[i].price, expected[i].price);
+                    EXPECT_EQ(actual[i].numberOfShares, expected[i].numberOfShares);
+                }
+            }
+            EXPECT_EQ(getBalance(entities[e]), model.balances[e]);
+            for (unsigned int a = 0; a < assetCount; ++a)
+                EXPECT_EQ(numberOfPossessedShares(assetNames[a], issuers[a], entities[e], entities[e], QX_CONTRACT_INDEX, QX_CONTRACT_INDEX), model.shares[e][a]);
+        }
+        EXPECT_EQ(qx.getState()->_earnedAmount - initialEarnedAmount, model.earnedAmount);
+        qx.getState()->checkOrderBookConsistency();
+    };
+
+    // Synthetic order flow: deep books around price 1000 on a coarse price grid (to also get merged orders),
+    // occasional large orders sweeping many price levels, and removal of existing orders
+    std::mt19937_64 gen(20240611);
+    std::chrono::nanoseconds contractTime(0);
+    for (int step = 0; step < orderCount; ++step)
+    {
+        const unsigned int e = gen() % entityCount;
+        const unsigned int a = gen() % assetCount;
+        const int p = gen() % 100;
+        sint64 expected, actual;
+        auto t0 = std::chrono::high_resolution_clock::now();
+        if (p < 15 && !model.orders.empty())
+        {
+            // remove (part of) an existing order or try to remove too many shares
+            const auto o = model.orders[gen() % model.orders.size()];
+            const sint64 n = (p < 2) ? o.numberOfShares + 1 : 1 + gen() % o.numberOfShares;
+            t0 = std::chrono::high_resolution_clock::now();
+            actual = (o.isBid)
+                ? qx.removeFromBidOrder(entities[o.entity], issuers[o.asset], assetNames[o.asset], o.price, n)
+                : qx.removeFromAskOrder(entities[o.entity], issuers[o.asset], assetNames[o.asset], o.price, n);
+            contractTime += std::chrono::high_resolution_clock::now() - t0;
+            expected = model.removeFromOrder(o.entity, o.asset, o.isBid, o.price, n);
+        }
+        else
+        {
+            const bool isBid = gen() & 1;
+            sint64 price = isBid ? 700 + 5 * (gen() % 60) : 1000 + 5 * (gen() % 60);
+            sint64 numberOfShares = 1 + gen() % 500;
+            if (p >= 97)
+            {
+                // sweep
+                price = isBid ? 1400 : 600;
+                numberOfShares *= 40;
+            }
+            t0 = std::chrono::high_resolution_clock::now();
+            actual = (isBid)
+                ? qx.addToBidOrder(entities[e], issuers[a], assetNames[a], price, numberOfShares)
+                : qx.addToAskOrder(entities[e], issuers[a], assetNames[a], price, numberOfShares);
+            contractTime += std::chrono::high_resolution_clock::now() - t0;
+            expected = model.addToOrder(e, a, isBid, price, numberOfShares);
+        }
+        EXPECT_EQ(actual, expected);
+
+        if (step % 50 == 49)
+            qx.endTick();
+
+        if (step % 1000 == 999)
+            checkListings();
+    }
+    checkListings();
+
+    std::cout << orderCount << " orders, " << model.tradeCount << " trades, " << model.orders.size() << " orders left, "
+        << std::chrono::duration_cast<std::chrono::microseconds>(contractTime).count() / double(orderCount)
+        << " us per order in contract" << std::endl;
+}
@@ -66,6 +66,7 @@ public:
     {
         initSpectrum();
         memset(spectrum, 0, spectrumSizeInBytes);
+        rebuildSpectrumBalances();
         updateSpectrumInfo();
     }
 
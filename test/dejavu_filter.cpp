@@ -0,0 +1,119 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "network_core/dejavu_filter.h"
+
+#include <cstring>
+#include <set>
+#include <vector>
+
+
+TEST(TestDejavuFilter, HashDependsOnDataAndKey)
+{
+    m256i key0(1, 2, 3, 4), key1(1, 2, 3, 5);
+    unsigned char data[200];
+    for (unsigned int i = 0; i < sizeof(data); ++i)
+        data[i] = (unsigned char)(i * 7);
+
+    // same input -> same hash
+    EXPECT_EQ(computeDejavuHash(data, sizeof(data), key0), computeDejavuHash(data, sizeof(data), key0));
+
+    // different key -> different hash
+    EXPECT_NE(computeDejavuHash(data, sizeof(data), key0), computeDejavuHash(data, sizeof(data), key1));
+
+    // all sizes (covering block, word, and byte processing) and single bit flips give different hashes
+    std::set<unsigned long long> hashes;
+    for (unsigned int size = 0; size <= sizeof(data); ++size)
+        hashes.insert(computeDejavuHash(data, size, key0));
+    EXPECT_EQ(hashes.size(), sizeof(data) + 1);
+    hashes.clear();
+    for (unsigned int i = 0; i < sizeof(data) * 8; ++i)
+    {
+        data[i / 8] ^= 1 << (i % 8);
+        hashes.insert(computeDejavuHash(data, sizeof(data), key0));
+        data[i / 8] ^= 1 << (i % 8);
+    }
+    EXPECT_EQ(hashes.size(), sizeof(data) * 8);
+
+    // swapping two 32-byte blocks changes the hash
+    unsigned char swapped[200];
+    memcpy(swapped, data, sizeof(data));
+    memcpy(swapped, data + 32, 32);
+    memcpy(swapped + 32, data, 32);
+    EXPECT_NE(computeDejavuHash(data, sizeof(data), key0), computeDejavuHash(swapped, sizeof(swapped), key0));
+}
+
+TEST(TestDejavuFilter, HashIndependentOfAlignment)
+{
+    // packets may start at any offset of a receive buffer
+    m256i key(11, 22, 33, 44);
+    alignas(8) unsigned char buffer[8 + 200];
+    for (unsigned int i = 0; i < 200; ++i)
+        buffer[i] = (unsigned char)(i * 13 + 5);
+    const unsigned long long expected = computeDejavuHash(buffer, 200, key);
+    for (unsigned int offset = 1; offset < 8; ++offset)
+    {
+        memmove(buffer + offset, buffer + offset - 1, 200);
+        EXPECT_EQ(computeDejavuHash(buffer + offset, 200, key), expected);
+    }
+}
+
+TEST(TestDejavuFilter, GenerationRotation)
+{
+    typedef DejavuFilter<16> Filter;
+    constexpr unsigned int generationSize = 100;
+
+    // buffer with garbage content to check that init() doesn't require zeroed memory
+    std::vector<unsigned char> buffer(Filter::bufferSize, 0xff);
+    Filter filter;
+    filter.init(buffer.data(), m256i(5, 6, 7, 8), generationSize);
+    for (unsigned int id = 0; id < (1 << 16); ++id)
+        EXPECT_FALSE(filter.contains(id));
+
+    // fill generations with IDs 0..99, 100..199, 200..299, 300..399, spread over all blocks
+    auto idOf = [](unsigned int i) { return (i * 40503) & 0xffff; };
+    for (unsigned int gen = 0; gen < 4; ++gen)
+    {
+        for (unsigned int i = gen * generationSize; i < (gen + 1) * generationSize; ++i)
+        {
+            EXPECT_FALSE(filter.contains(idOf(i)));
+            filter.add(idOf(i));
+            EXPECT_TRUE(filter.contains(idOf(i)));
+        }
+
+        // after rotation, IDs of the last two generations are known and older ones are forgotten
+        for (unsigned int i = 0; i < (gen + 1) * generationSize; ++i)
+            EXPECT_EQ(filter.contains(idOf(i)), i >= gen * generationSize) << "gen " << gen << ", i " << i;
+    }
+
+    // reused bitmap has been cleared block-wise, so only IDs added since are set
+    filter.add(idOf(0));
+    EXPECT_TRUE(filter.contains(idOf(0)));
+    EXPECT_FALSE(filter.contains(idOf(generationSize)));
+    for (unsigned int id = 0; id < (1 << 16); ++id)
+    {
+        bool added = false;
+        for (unsigned int i = 3 * generationSize; i < 4 * generationSize; ++i)
+            added = added || (idOf(i) == id);
+        EXPECT_EQ(filter.contains(id), added || id == idOf(0));
+    }
+}
+
+TEST(TestDejavuFilter, ComputeId)
+{
+    typedef DejavuFilter<16> Filter;
+    std::vector<unsigned char> buffer(Filter::bufferSize);
+    Filter filter;
+    filter.init(buffer.data(), m256i(9, 10, 11, 12), 1000);
+
+    // IDs are in range and roughly uniformly distributed
+    std::set<unsigned int> ids;
+    for (unsigned long long i = 0; i < 1000; ++i)
+    {
+        unsigned int id = filter.computeId(&i, sizeof(i));
+        EXPECT_LT(id, 1u << 16);
+        ids.insert(id);
+    }
+    EXPECT_GT(ids.size(), 980);
+}
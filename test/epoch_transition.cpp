@@ -0,0 +1,95 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "ticking/epoch_transition.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+static EpochTransitionStages stages;
+static std::atomic<unsigned int> stageRuns[EPOCH_TRANSITION_STAGE_COUNT];
+static volatile bool stopHelpers = false;
+
+template <EpochTransitionStage stage>
+static void countingStage()
+{
+    // some work, so helpers have a chance to take other stages in the meantime
+    volatile unsigned long long x = 0;
+    for (unsigned int i = 0; i < 100000; ++i)
+        x = x + i;
+    ++stageRuns[stage];
+}
+
+TEST(TestEpochTransitionStages, RunWithoutHelpers)
+{
+    for (auto& runs : stageRuns)
+        runs = 0;
+    stages.beginTransition();
+    stages.add(EPOCH_TRANSITION_UNIVERSE_DIGEST, countingStage<EPOCH_TRANSITION_UNIVERSE_DIGEST>);
+    stages.add(EPOCH_TRANSITION_COMPUTER_DIGEST, countingStage<EPOCH_TRANSITION_COMPUTER_DIGEST>);
+    stages.run();
+    stages.setStageTicks(EPOCH_TRANSITION_BEGIN_EPOCH, 123);
+    stages.endTransition();
+
+    EXPECT_EQ(stageRuns[EPOCH_TRANSITION_UNIVERSE_DIGEST], 1u);
+    EXPECT_EQ(stageRuns[EPOCH_TRANSITION_COMPUTER_DIGEST], 1u);
+    EXPECT_EQ(stageRuns[EPOCH_TRANSITION_SPECTRUM_REORG], 0u);
+    EXPECT_GT(stages.getStageTicks(EPOCH_TRANSITION_UNIVERSE_DIGEST), 0u);
+    EXPECT_EQ(stages.getStageTicks(EPOCH_TRANSITION_SPECTRUM_REORG), 0u);
+    EXPECT_EQ(stages.getStageTicks(EPOCH_TRANSITION_BEGIN_EPOCH), 123u);
+    EXPECT_GE(stages.getTotalTicks(), stages.getStageTicks(EPOCH_TRANSITION_UNIVERSE_DIGEST));
+    EXPECT_FALSE(stages.tryRunStage());
+}
+
+TEST(TestEpochTransitionStages, RunWithHelpers)
+{
+    // emulate request processors waiting in epoch transition
+    stopHelpers = false;
+    std::vector<std::thread> helpers;
+    for (int i = 0; i < 3; ++i)
+    {
+        helpers.emplace_back([]()
+            {
+                while (!stopHelpers)
+                    stages.tryRunStage();
+            });
+    }
+
+    const unsigned int transitionCount = stages.getTransitionCount();
+    for (int iteration = 0; iteration < 100; ++iteration)
+    {
+        for (auto& runs : stageRuns)
+            runs = 0;
+        stages.beginTransition();
+
+        stages.add(EPOCH_TRANSITION_UNIVERSE_DIGEST, countingStage<EPOCH_TRANSITION_UNIVERSE_DIGEST>);
+        stages.add(EPOCH_TRANSITION_COMPUTER_DIGEST, countingStage<EPOCH_TRANSITION_COMPUTER_DIGEST>);
+        stages.add(EPOCH_TRANSITION_REVENUE_COMPUTATION, countingStage<EPOCH_TRANSITION_REVENUE_COMPUTATION>);
+        stages.run();
+        // all stages of group are finished when run() returns
+        EXPECT_EQ(stageRuns[EPOCH_TRANSITION_UNIVERSE_DIGEST], 1u);
+        EXPECT_EQ(stageRuns[EPOCH_TRANSITION_COMPUTER_DIGEST], 1u);
+        EXPECT_EQ(stageRuns[EPOCH_TRANSITION_REVENUE_COMPUTATION], 1u);
+
+        stages.add(EPOCH_TRANSITION_SPECTRUM_REORG, countingStage<EPOCH_TRANSITION_SPECTRUM_REORG>);
+        stages.add(EPOCH_TRANSITION_UNIVERSE_REORG, countingStage<EPOCH_TRANSITION_UNIVERSE_REORG>);
+        stages.add(EPOCH_TRANSITION_TICK_STORAGE, countingStage<EPOCH_TRANSITION_TICK_STORAGE>);
+        stages.run();
+        stages.endTransition();
+
+        for (unsigned int i = EPOCH_TRANSITION_UNIVERSE_DIGEST; i <= EPOCH_TRANSITION_TICK_STORAGE; ++i)
+        {
+            const unsigned int expectedRuns = (i == EPOCH_TRANSITION_IPOS_AND_REVENUE_PAYOUT) ? 0 : 1;
+            EXPECT_EQ(stageRuns[i], expectedRuns);
+            EXPECT_EQ(stages.getStageTicks((EpochTransitionStage)i) > 0, expectedRuns > 0);
+        }
+    }
+    EXPECT_EQ(stages.getTransitionCount(), transitionCount + 100);
+
+    stopHelpers = true;
+    for (auto& helper : helpers)
+        helper.join();
+}
@@ -6,6 +6,7 @@
 
 #include <lib/platform_common/qintrin.h>
 #include "gtest/gtest.h"
+#include "benchmark_util.h"
 
 #include <chrono>
 #include <iostream>
@@ -692,4 +693,18 @@ TEST(TestFourQ, TestVerifyRejectsNetworkForgeries)
         EXPECT_FALSE(verify(tx, digest, signature))
             << " FORGERY ACCEPTED for vector " << i << " -- the fix is NOT working";
     }
-}
\ No newline at end of file
+}
+
+TEST(BENCHMARK_SUITE, FourQVerify)
+{
+    initAVX512FourQConstants();
+
+    unsigned char publicKey[32], digest[32], signature[64];
+    makeValidSignature(0, publicKey, digest, signature);
+    bool allValid = true;
+    benchmark_util::run("FourQ verify", [&](unsigned long long)
+        {
+            allValid &= verify(publicKey, digest, signature);
+        });
+    EXPECT_TRUE(allValid);
+}
@@ -0,0 +1,151 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/platform/incremental_file.h"
+
+#include <cstdio>
+#include <vector>
+
+
+static constexpr unsigned long long chunkSize = 4096;
+static constexpr unsigned long long totalSize = 3 * chunkSize + 100;
+
+static void fillRandom(std::vector<unsigned char>& data)
+{
+    for (auto& value : data)
+    {
+        unsigned int r;
+        _rdrand32_step(&r);
+        value = (unsigned char)r;
+    }
+}
+
+static void removeIncrementalFile(const CHAR16* fileName, unsigned int chunkCount)
+{
+    CHAR16 name[64];
+    for (unsigned int i = 0; i < chunkCount; ++i)
+    {
+        getIncrementalFileName(name, fileName, i);
+        _wremove(name);
+    }
+    getIncrementalFileManifestName(name, fileName);
+    _wremove(name);
+}
+
+TEST(TestIncrementalFile, SaveOnlyChangedChunks)
+{
+    const CHAR16* fileName = L"incremental_test.000";
+    const unsigned int chunkCount = IncrementalFileManifest::getChunkCount(totalSize, chunkSize);
+    EXPECT_EQ(chunkCount, 4);
+    removeIncrementalFile(fileName, chunkCount);
+
+    std::vector<unsigned char> data(totalSize), loaded(totalSize);
+    fillRandom(data);
+
+    // first save writes everything
+    unsigned long long writtenSize = 0;
+    EXPECT_EQ(saveIncrementalFile(fileName, totalSize, data.data(), NULL, &writtenSize, chunkSize), totalSize);
+    EXPECT_EQ(writtenSize, totalSize);
+    EXPECT_EQ(loadIncrementalFile(fileName, totalSize, loaded.data(), NULL, true, chunkSize), totalSize);
+    EXPECT_EQ(loaded, data);
+
+    // saving unchanged data writes nothing
+    EXPECT_EQ(saveIncrementalFile(fileName, totalSize, data.data(), NULL, &writtenSize, chunkSize), totalSize);
+    EXPECT_EQ(writtenSize, 0);
+
+    // only changed chunks are written (including the last chunk, which is smaller)
+    data[chunkSize + 17] ^= 1;
+    data[totalSize - 1] ^= 1;
+    EXPECT_EQ(saveIncrementalFile(fileName, totalSize, data.data(), NULL, &writtenSize, chunkSize), totalSize);
+    EXPECT_EQ(writtenSize, chunkSize + 100);
+    EXPECT_EQ(loadIncrementalFile(fileName, totalSize, loaded.data(), NULL, true, chunkSize), totalSize);
+    EXPECT_EQ(loaded, data);
+
+    // manifest with different size is ignored, so everything is written
+    EXPECT_EQ(saveIncrementalFile(fileName, totalSize - 1, data.data(), NULL, &writtenSize, chunkSize), totalSize - 1);
+    EXPECT_EQ(writtenSize, totalSize - 1);
+    EXPECT_EQ(loadIncrementalFile(fileName, totalSize, loaded.data(), NULL, true, chunkSize), -1);
+    EXPECT_EQ(loadIncrementalFile(fileName, totalSize - 1, loaded.data(), NULL, true, chunkSize), totalSize - 1);
+
+    removeIncrementalFile(fileName, chunkCount);
+}
+
+TEST(TestIncrementalFile, DetectCorruptedAndIncompleteFiles)
+{
+    const CHAR16* fileName = L"incremental_test.001";
+    const unsigned int chunkCount = IncrementalFileManifest::getChunkCount(totalSize, chunkSize);
+    removeIncrementalFile(fileName, chunkCount);
+
+    std::vector<unsigned char> data(totalSize), loaded(totalSize);
+    fillRandom(data);
+
+    // missing manifest
+    EXPECT_EQ(loadIncrementalFile(fileName, totalSize, loaded.data(), NULL, true, chunkSize), -1);
+
+    // corrupted chunk is detected if verification is enabled
+    EXPECT_EQ(saveIncrementalFile(fileName, totalSize, data.data(), NULL, NULL, chunkSize), totalSize);
+    std::vector<unsigned char> corrupted(data.begin() + 2 * chunkSize, data.begin() + 3 * chunkSize);
+    corrupted[5] ^= 0x80;
+    CHAR16 chunkName[64];
+    getIncrementalFileName(chunkName, fileName, 2);
+    EXPECT_EQ(save(chunkName, chunkSize, corrupted.data()), chunkSize);
+    EXPECT_EQ(loadIncrementalFile(fileName, totalSize, loaded.data(), NULL, true, chunkSize), -1);
+    EXPECT_EQ(loadIncrementalFile(fileName, totalSize, loaded.data(), NULL, false, chunkSize), totalSize);
+    EXPECT_EQ(save(chunkName, chunkSize, data.data() + 2 * chunkSize), chunkSize);
+
+    // manifest of interrupted save (digest of chunk being rewritten cleared) is rejected even without verification
+    static IncrementalFileManifest manifest;
+    EXPECT_TRUE(loadIncrementalFileManifest(manifest, fileName, totalSize, chunkSize, NULL));
+    manifest.chunkDigests[1] = m256i::zero();
+    EXPECT_TRUE(saveIncrementalFileManifest(manifest, fileName, NULL));
+    EXPECT_EQ(loadIncrementalFile(fileName, totalSize, loaded.data(), NULL, false, chunkSize), -1);
+
+    // next save rewrites the chunks with unknown content and fixes the file
+    unsigned long long writtenSize = 0;
+    EXPECT_EQ(saveIncrementalFile(fileName, totalSize, data.data(), NULL, &writtenSize, chunkSize), totalSize);
+    EXPECT_EQ(writtenSize, chunkSize);
+    EXPECT_EQ(loadIncrementalFile(fileName, totalSize, loaded.data(), NULL, false, chunkSize), totalSize);
+    EXPECT_EQ(loaded, data);
+
+    removeIncrementalFile(fileName, chunkCount);
+}
+
+TEST(TestIncrementalFile, StepwiseWriter)
+{
+    const CHAR16* fileName = L"incremental_test.002";
+    const unsigned int chunkCount = IncrementalFileManifest::getChunkCount(totalSize, chunkSize);
+    removeIncrementalFile(fileName, chunkCount);
+
+    std::vector<unsigned char> data(totalSize), loaded(totalSize);
+    fillRandom(data);
+    EXPECT_EQ(saveIncrementalFile(fileName, totalSize, data.data(), NULL, NULL, chunkSize), totalSize);
+
+    // one step per chunk for hashing, one per changed chunk for writing, and a final one for the manifest
+    static IncrementalFileWriter writer;
+    data[2 * chunkSize] ^= 1;
+    EXPECT_TRUE(writer.begin(fileName, totalSize, data.data(), NULL, chunkSize));
+    EXPECT_TRUE(writer.isActive());
+    for (unsigned int i = 0; i < chunkCount + 1; ++i)
+        EXPECT_TRUE(writer.step());
+
+    // snapshot isn't valid before the writer has finished
+    EXPECT_EQ(loadIncrementalFile(fileName, totalSize, loaded.data(), NULL, true, chunkSize), -1);
+
+    EXPECT_FALSE(writer.step());
+    EXPECT_FALSE(writer.isActive());
+    EXPECT_FALSE(writer.hasFailed());
+    EXPECT_EQ(writer.getWrittenSize(), chunkSize);
+    EXPECT_EQ(loadIncrementalFile(fileName, totalSize, loaded.data(), NULL, true, chunkSize), totalSize);
+    EXPECT_EQ(loaded, data);
+
+    // without changes, the writer finishes after hashing
+    EXPECT_TRUE(writer.begin(fileName, totalSize, data.data(), NULL, chunkSize));
+    unsigned int steps = 0;
+    while (writer.step())
+        ++steps;
+    EXPECT_EQ(steps, chunkCount);
+    EXPECT_EQ(writer.getWrittenSize(), 0);
+
+    removeIncrementalFile(fileName, chunkCount);
+}
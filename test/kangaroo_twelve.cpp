@@ -5,9 +5,12 @@
 #include "../src/platform/memory.h"
 #include <lib/platform_common/qintrin.h>
 #include "gtest/gtest.h"
+#include "benchmark_util.h"
 
 #include <chrono>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 
 TEST(TestCoreK12, PerformanceDigest32Of1GB)
@@ -90,3 +93,109 @@ TEST(TestCoreK12, CompareK12Implementations)
     ASSERT_EQ(memcmp(outputArrayXKCP, outputArray, outputN), 0);
     delete [] inputPtr;
 }
+
+static void compareParallelK12(const unsigned char* input, const std::vector<unsigned int>& sizes, ChunkedJob& job)
+{
+    for (unsigned int size : sizes)
+    {
+        unsigned char expected[64], parallel[64];
+        KangarooTwelve(input, size, expected, sizeof(expected));
+        KangarooTwelveParallel(input, size, parallel, sizeof(parallel), job);
+        EXPECT_EQ(memcmp(expected, parallel, sizeof(expected)), 0) << "input size " << size;
+    }
+}
+
+static std::vector<unsigned int> parallelK12TestSizes()
+{
+    std::vector<unsigned int> sizes = { 0, 1, 8191, 8192, 8193, 2 * 8192, K12_parallelMinInputSize - 1 };
+    const unsigned int leafCounts[] = { 2 * K12_parallelLeaves + 1, 2 * K12_parallelLeaves + 2, 3 * K12_parallelLeaves + 3,
+        K12_parallelBatchLeaves, K12_parallelBatchLeaves + 1, K12_parallelBatchLeaves + K12_parallelLeaves + 1, 3 * K12_parallelBatchLeaves + 5 };
+    for (unsigned int leafCount : leafCounts)
+    {
+        // with the first chunk, the leaves, and a last leaf of 0, 1, 167, 168, 8191 bytes
+        const unsigned int fullSize = (leafCount + 1) * K12_chunkSize;
+        for (unsigned int rest : { 0u, 1u, 7u, 167u, 168u, 8190u, 8191u })
+            sizes.push_back(fullSize + rest);
+    }
+    return sizes;
+}
+
+TEST(TestCoreK12, ParallelMatchesSequential)
+{
+    const std::vector<unsigned int> sizes = parallelK12TestSizes();
+    std::vector<unsigned char> input(sizes.back());
+    for (unsigned int i = 0; i < input.size(); ++i)
+        input[i] = (unsigned char)(i * 131 + (i >> 13));
+
+    static ChunkedJob job;
+    compareParallelK12(input.data(), sizes, job);
+}
+
+TEST(TestCoreK12, ParallelMatchesSequentialWithHelpers)
+{
+    const std::vector<unsigned int> sizes = parallelK12TestSizes();
+    std::vector<unsigned char> input(sizes.back());
+    for (unsigned int i = 0; i < input.size(); ++i)
+        input[i] = (unsigned char)(i * 29 + (i >> 11));
+
+    // helpers like the request processors
+    static ChunkedJob job;
+    static volatile bool stopHelpers = false;
+    std::vector<std::thread> helpers;
+    for (int i = 0; i < 3; ++i)
+    {
+        helpers.emplace_back([]()
+            {
+                while (!stopHelpers)
+                    job.tryHelp();
+            });
+    }
+
+    compareParallelK12(input.data(), sizes, job);
+
+    stopHelpers = true;
+    for (auto& helper : helpers)
+        helper.join();
+}
+
+TEST(BENCHMARK_SUITE, KangarooTwelveParallelOf16MB)
+{
+    // large contract state digest, sequential and with the leaves in SIMD lanes (without helping processors)
+    std::vector<unsigned char> input(16 * 1024 * 1024, 0);
+    unsigned char digest[32];
+    static ChunkedJob job;
+    benchmark_util::run("KangarooTwelve 16MB to 32 bytes", [&](unsigned long long i)
+        {
+            *(unsigned long long*)input.data() = i;
+            KangarooTwelve(input.data(), (unsigned int)input.size(), digest, sizeof(digest));
+        });
+    benchmark_util::run("KangarooTwelveParallel 16MB to 32 bytes", [&](unsigned long long i)
+        {
+            *(unsigned long long*)input.data() = i;
+            KangarooTwelveParallel(input.data(), (unsigned int)input.size(), digest, sizeof(digest), job);
+        });
+}
+
+TEST(BENCHMARK_SUITE, KangarooTwelveOf1KB)
+{
+    // typical size of a transaction
+    unsigned char input[1024] = { 0 };
+    unsigned char digest[32];
+    benchmark_util::run("KangarooTwelve 1KB to 32 bytes", [&](unsigned long long i)
+        {
+            *(unsigned long long*)input = i;
+            KangarooTwelve(input, sizeof(input), digest, sizeof(digest));
+        });
+}
+
+TEST(BENCHMARK_SUITE, KangarooTwelve64To32)
+{
+    // node hash of the spectrum and universe Merkle trees, chained so that every call depends on the previous one
+    unsigned char input[64] = { 0 };
+    unsigned char digest[32];
+    benchmark_util::run("KangarooTwelve64To32", [&](unsigned long long)
+        {
+            KangarooTwelve64To32(input, digest);
+            copyMem(input, digest, sizeof(digest));
+        });
+}
@@ -1,6 +1,7 @@
 #define NO_UEFI
 
 #include "gtest/gtest.h"
+#include "benchmark_util.h"
 
 // workaround for name clash with stdlib
 #define system qubicSystemStruct
@@ -42,6 +43,7 @@ public:
             spectrum[NUM_INITIALIZED_ENTITIES + i].outgoingAmount = 0;
             spectrum[NUM_INITIALIZED_ENTITIES + i].publicKey = m256i{ 0, 0, 0, NUM_INITIALIZED_ENTITIES + i + 1 };
         }
+        rebuildSpectrumBalances();
         updateSpectrumInfo();
         commonBuffers.init(1, sizeof(*txsPriorities));
     }
@@ -549,4 +551,35 @@ TEST(TestPendingTxsPool, TxsWithSrcBalance0AreRejected)
 
         pendingTxsPool.deinit();
     }
-}
\ No newline at end of file
+}
+
+TEST(BENCHMARK_SUITE, PendingTxsPoolAddGet)
+{
+    TestPendingTxsPool pendingTxsPool;
+    pendingTxsPool.init();
+
+    const unsigned int firstEpochTick0 = 1000;
+    pendingTxsPool.beginEpoch(firstEpochTick0);
+
+    // fill all ticks of the pool up to the max number of txs per tick (no replacement by priority)
+    const unsigned long long numTxs = (unsigned long long)PENDING_TXS_POOL_NUM_TICKS * pendingTxsPool.getMaxNumTxsPerTick();
+    bool allAdded = true;
+    benchmark_util::run("PendingTxsPool add", [&](unsigned long long i)
+        {
+            const m256i dest{ i + 1, 0, 0, 0 };
+            const m256i src{ 0, 0, 0, (i % NUM_INITIALIZED_ENTITIES) + 1 };
+            allAdded &= pendingTxsPool.addTransaction(firstEpochTick0 + (unsigned int)(i % PENDING_TXS_POOL_NUM_TICKS), /*amount=*/i + 1, /*inputSize=*/64, &dest, &src);
+        }, numTxs);
+    EXPECT_TRUE(allAdded);
+
+    const unsigned int numTicks = (unsigned int)PENDING_TXS_POOL_NUM_TICKS;
+    const unsigned int numTickTxs = pendingTxsPool.getNumberOfPendingTickTxs(firstEpochTick0);
+    bool allFound = true;
+    benchmark_util::run("PendingTxsPool getTx", [&](unsigned long long i)
+        {
+            allFound &= (pendingTxsPool.getTx(firstEpochTick0 + (unsigned int)(i % numTicks), (unsigned int)((i / numTicks) % numTickTxs)) != nullptr);
+        });
+    EXPECT_TRUE(allFound);
+
+    pendingTxsPool.deinit();
+}
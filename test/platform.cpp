@@ -277,6 +277,65 @@ TEST(TestCoreProfiling, AddMeasurementSpeedTest)
     gProfilingDataCollector.writeToFile();
 }
 
+TEST(TestCoreProfiling, HistogramAndPercentiles)
+{
+    EXPECT_EQ(ProfilingData::getHistogramBucket(0), 0);
+    EXPECT_EQ(ProfilingData::getHistogramBucket(1), 0);
+    EXPECT_EQ(ProfilingData::getHistogramBucket(2), 1);
+    EXPECT_EQ(ProfilingData::getHistogramBucket(100), 6);
+    EXPECT_EQ(ProfilingData::getHistogramBucket(0xffffffffffffffffllu), PROFILING_HISTOGRAM_BUCKETS - 1);
+
+    static const char* scopeName = "HistogramAndPercentiles";
+    gProfilingDataCollector.clear();
+    for (int i = 0; i < 990; ++i)
+        gProfilingDataCollector.addMeasurement(scopeName, 1, 1000, 1100);
+    for (int i = 0; i < 10; ++i)
+        gProfilingDataCollector.addMeasurement(scopeName, 1, 1000, 101000);
+    gProfilingDataCollector.addMeasurement(scopeName, 1, 1000, 999); // TSC overflow is discarded
+
+    // All measurements of this thread are in the shard of the running processor
+    ProfilingData entry;
+    unsigned int entryIndex = 0;
+    ASSERT_TRUE(gProfilingDataCollector.getMeasurement(getRunningProcessorID() % PROFILING_SHARDS, entryIndex, entry));
+    EXPECT_EQ(entry.name, scopeName);
+    EXPECT_EQ(entry.numOfExec, 1000);
+    EXPECT_EQ(entry.runtimeMin, 100);
+    EXPECT_EQ(entry.runtimeMax, 100000);
+    EXPECT_EQ(entry.runtimeHistogram[6], 990);
+    EXPECT_EQ(entry.runtimeHistogram[16], 10);
+    ++entryIndex;
+    EXPECT_FALSE(gProfilingDataCollector.getMeasurement(getRunningProcessorID() % PROFILING_SHARDS, entryIndex, entry));
+
+    // Percentiles are upper bounds of histogram buckets, limited to min and max
+    EXPECT_EQ(entry.getRuntimePercentile(0), 127);
+    EXPECT_EQ(entry.getRuntimePercentile(500), 127);
+    EXPECT_EQ(entry.getRuntimePercentile(990), 127);
+    EXPECT_EQ(entry.getRuntimePercentile(999), 100000);
+    EXPECT_EQ(entry.getRuntimePercentile(1000), 100000);
+
+    // Merging entries of different shards
+    ProfilingData other;
+    setMem(&other, sizeof(other), 0);
+    other.name = scopeName;
+    other.line = 1;
+    other.numOfExec = 1;
+    other.runtimeSum = other.runtimeMin = other.runtimeMax = 10;
+    other.runtimeHistogram[ProfilingData::getHistogramBucket(10)] = 1;
+    entry.merge(other);
+    EXPECT_EQ(entry.numOfExec, 1001);
+    EXPECT_EQ(entry.runtimeSum, 990 * 100 + 10 * 100000 + 10);
+    EXPECT_EQ(entry.runtimeMin, 10);
+    EXPECT_EQ(entry.runtimeMax, 100000);
+    EXPECT_EQ(entry.getRuntimePercentile(0), 15);
+
+    ProfilingData merged[4];
+    EXPECT_EQ(gProfilingDataCollector.getMeasurements(merged, 4), 1);
+    EXPECT_EQ(merged[0].numOfExec, 1000);
+
+    gProfilingDataCollector.clear();
+    EXPECT_EQ(gProfilingDataCollector.getMeasurements(merged, 4), 0);
+}
+
 void checkTicksToMicroseconds(int type, unsigned long long ticks, unsigned long long frequency)
 {
     ::frequency = frequency;
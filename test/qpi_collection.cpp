@@ -1,6 +1,7 @@
 #define NO_UEFI
 
 #include "gtest/gtest.h"
+#include "benchmark_util.h"
 
 #include "contract_core/pre_qpi_def.h"
 #include "qpi/qpi.h"
@@ -1314,7 +1315,7 @@ TEST(TestCoreQPI, CollectionSubCollectionsRandom)
         tailIdx = coll.tailIndex(pov, priorities[size - 1]);
         EXPECT_EQ(coll.priority(tailIdx), priorities[size - 1]);
 
-        std::vector<size_t> indices(std::min(size, std::max(1llu, size / 5)));
+        std::vector<size_t> indices(std::min(size, std::max<size_t>(1, size / 5)));
         for (size_t i = 0; i < indices.size(); i++) {
             indices[i] = std::abs((QPI::sint64)gen64()) % indices.size();
         }
@@ -1714,3 +1715,41 @@ TEST(TestCoreQPI, CollectionPerformance)
         std::cout << "* [CollectionPerformance] Total:\t\t" << total << " ms\n";
     }
 }
+
+TEST(BENCHMARK_SUITE, CollectionAddHeadIndex)
+{
+    constexpr QPI::uint64 capacity = 1024 * 1024;
+    constexpr QPI::uint64 population = capacity / 2;
+    constexpr QPI::uint64 povCount = 1024;
+    auto* coll = new QPI::Collection<QPI::uint64, capacity>();
+    coll->reset();
+    commonBuffers.init(1, sizeof(*coll));
+
+    std::mt19937_64 gen64(42);
+    std::vector<QPI::id> povs(povCount);
+    for (auto& pov : povs)
+        pov = QPI::id(gen64(), gen64(), gen64(), gen64());
+    std::vector<QPI::sint64> priorities(population);
+    for (auto& priority : priorities)
+        priority = gen64() % 1000000;
+
+    // fill up to 50% population, distributed over povCount povs
+    bool allAdded = true;
+    benchmark_util::run("Collection<uint64, 1M> add (1024 povs)", [&](unsigned long long i)
+        {
+            allAdded &= (coll->add(povs[i % povCount], i, priorities[i]) != QPI::NULL_INDEX);
+        }, population);
+    EXPECT_TRUE(allAdded);
+    for (QPI::uint64 i = coll->population(); i < population; ++i)
+        coll->add(povs[i % povCount], i, priorities[i]);
+
+    bool allFound = true;
+    benchmark_util::run("Collection<uint64, 1M> headIndex (50% population)", [&](unsigned long long i)
+        {
+            allFound &= (coll->headIndex(povs[i % povCount]) != QPI::NULL_INDEX);
+        });
+    EXPECT_TRUE(allFound);
+
+    delete coll;
+    commonBuffers.deinit();
+}
@@ -1,6 +1,7 @@
 #define NO_UEFI
 
 #include "gtest/gtest.h"
+#include "benchmark_util.h"
 
 #include "contract_core/pre_qpi_def.h"
 #include "qpi/qpi.h"
@@ -12,6 +13,7 @@
 #include <set>
 #include <random>
 #include <chrono>
+#include <vector>
 
 
 // New KeyT, ValueT combinations for testing need to implement the following functions:
@@ -526,7 +528,7 @@ REGISTER_TYPED_TEST_CASE_P(QPIHashMapTest,
 typedef Types<std::pair<QPI::id, int>, std::pair<QPI::sint64, char>, std::pair<QPI::bit_1024, QPI::uint64>> KeyValueTypesToTest;
 INSTANTIATE_TYPED_TEST_CASE_P(TypedQPIHashMapTests, QPIHashMapTest, KeyValueTypesToTest);
 
-template <class KeyT, class ValueT, unsigned int capacity>
+template <class KeyT, class ValueT, QPI::uint64 capacity>
 void hasSameContent(QPI::HashMap<KeyT, ValueT, capacity>& map, const std::map<KeyT, ValueT>& referenceMap)
 {
 	EXPECT_EQ(map.population(), referenceMap.size());
@@ -579,7 +581,7 @@ void hasSameContent(QPI::HashMap<KeyT, ValueT, capacity>& map, const std::map<Ke
 	EXPECT_EQ(cnt, referenceMap.size());
 }
 
-template <class KeyT, class ValueT, unsigned int capacity>
+template <class KeyT, class ValueT, QPI::uint64 capacity>
 void cleanupHashMap(QPI::HashMap<KeyT, ValueT, capacity>& map, const std::map<KeyT, ValueT>& referenceMap)
 {
 	hasSameContent(map, referenceMap);
@@ -805,7 +807,7 @@ TEST(QPIHashMapTest, HashSet)
 	commonBuffers.deinit();
 }
 
-template <class T, unsigned int capacity>
+template <class T, QPI::uint64 capacity>
 void hasSameContent(QPI::HashSet<T, capacity>& set, const std::set<T>& referenceSet)
 {
 	EXPECT_EQ(set.population(), referenceSet.size());
@@ -853,7 +855,7 @@ void hasSameContent(QPI::HashSet<T, capacity>& set, const std::set<T>& reference
 	EXPECT_EQ(cnt, referenceSet.size());
 }
 
-template <class T, unsigned int capacity>
+template <class T, QPI::uint64 capacity>
 void cleanupHashSet(QPI::HashSet<T, capacity>& set, const std::set<T>& referenceSet)
 {
 	hasSameContent(set, referenceSet);
@@ -1007,3 +1009,36 @@ TEST(QPIHashMapTest, HashSetPerfTest)
 
 	// measure lookups/seconds -> O(1) if population is sparse -> O(N) if population is high with N = max population since last cleanup
 }
+
+TEST(BENCHMARK_SUITE, HashMapSetGet)
+{
+	constexpr QPI::uint64 capacity = 1024 * 1024;
+	constexpr QPI::uint64 population = capacity / 2;
+	auto* map = new QPI::HashMap<QPI::id, QPI::uint64, capacity>();
+	map->reset();
+
+	std::mt19937_64 gen64(42);
+	std::vector<QPI::id> keys(population);
+	for (auto& key : keys)
+		key = QPI::id(gen64(), gen64(), gen64(), gen64());
+
+	// fill up to 50% population
+	bool allAdded = true;
+	benchmark_util::run("HashMap<id, uint64, 1M> set", [&](unsigned long long i)
+		{
+			allAdded &= (map->set(keys[i], i) != QPI::NULL_INDEX);
+		}, population);
+	EXPECT_TRUE(allAdded);
+	for (QPI::uint64 i = map->population(); i < population; ++i)
+		map->set(keys[i], i);
+
+	bool allFound = true;
+	benchmark_util::run("HashMap<id, uint64, 1M> get (50% population)", [&](unsigned long long i)
+		{
+			QPI::uint64 value;
+			allFound &= map->get(keys[i % population], value);
+		});
+	EXPECT_TRUE(allFound);
+
+	delete map;
+}
@@ -0,0 +1,638 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "contract_core/pre_qpi_def.h"
+#include "qpi/qpi.h"
+#include "common_buffers.h"
+#include "qpi/impl/qpi_collection_impl.h"
+#include "qpi/impl/qpi_trivial_impl.h"
+#include "qpi/impl/qpi_order_book_impl.h"
+#include <vector>
+#include <deque>
+#include <map>
+#include <random>
+#include <chrono>
+
+using QPI::OrderBookSide::ask;
+using QPI::OrderBookSide::bid;
+
+
+// Helper: return orders of a book side (or of an owner side if ownerView is set) in iteration order
+template <typename T, QPI::uint64 L>
+std::vector<QPI::sint64> listOrders(const QPI::OrderBook<T, L>& ob, const QPI::id& key, QPI::uint8 side, bool ownerView = false)
+{
+	std::vector<QPI::sint64> indices;
+	QPI::sint64 idx = ownerView ? ob.ownerHeadIndex(key, side) : ob.headIndex(key, side);
+	while (idx != QPI::NULL_INDEX)
+	{
+		EXPECT_FALSE(ob.isEmptySlot(idx));
+		EXPECT_EQ(ob.side(idx), side);
+		EXPECT_EQ(ownerView ? ob.owner(idx) : ob.book(idx), key);
+		indices.push_back(idx);
+		EXPECT_LE(indices.size(), ob.population());
+		if (indices.size() > ob.population())
+			break;
+		idx = ownerView ? ob.nextOwnerElementIndex(idx) : ob.nextElementIndex(idx);
+	}
+	EXPECT_EQ(indices.size(), ownerView ? ob.ownerPopulation(key, side) : ob.population(key, side));
+	return indices;
+}
+
+template <typename T, QPI::uint64 L>
+std::vector<T> listValues(const QPI::OrderBook<T, L>& ob, const QPI::id& key, QPI::uint8 side, bool ownerView = false)
+{
+	std::vector<T> values;
+	for (QPI::sint64 idx : listOrders(ob, key, side, ownerView))
+		values.push_back(ob.element(idx));
+	return values;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Test: empty order book
+
+TEST(QPIOrderBookTest, EmptyOrderBook)
+{
+	// Zero-initialized memory is a valid empty order book (contract state)
+	QPI::OrderBook<int, 8>* ob = new QPI::OrderBook<int, 8>();
+	setMem(ob, sizeof(*ob), 0);
+
+	EXPECT_EQ(ob->population(), 0u);
+	EXPECT_EQ(ob->capacity(), 8u);
+	EXPECT_EQ(ob->headIndex(QPI::id(1, 2, 3, 4), ask), QPI::NULL_INDEX);
+	EXPECT_EQ(ob->headIndex(QPI::id(1, 2, 3, 4), bid, 10), QPI::NULL_INDEX);
+	EXPECT_EQ(ob->ownerHeadIndex(QPI::id(1, 2, 3, 4), bid), QPI::NULL_INDEX);
+	EXPECT_EQ(ob->population(QPI::id(1, 2, 3, 4), ask), 0u);
+	EXPECT_EQ(ob->ownerPopulation(QPI::id(1, 2, 3, 4), ask), 0u);
+	for (QPI::sint64 i = -1; i <= 8; ++i)
+	{
+		EXPECT_TRUE(ob->isEmptySlot(i));
+		EXPECT_EQ(ob->nextElementIndex(i), QPI::NULL_INDEX);
+		EXPECT_EQ(ob->nextOwnerElementIndex(i), QPI::NULL_INDEX);
+		EXPECT_EQ(ob->remove(i), QPI::NULL_INDEX);
+		EXPECT_EQ(ob->price(i), 0);
+		EXPECT_EQ(ob->book(i), QPI::NULL_ID);
+		EXPECT_EQ(ob->owner(i), QPI::NULL_ID);
+	}
+	delete ob;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Test: price levels and FIFO
+
+TEST(QPIOrderBookTest, PriceLevelsAndFifo)
+{
+	QPI::OrderBook<int, 32> ob;
+	ob.reset();
+	const QPI::id book(1, 0, 0, 0), owner(2, 0, 0, 0);
+
+	// asks: best is lowest price
+	ob.add(book, owner, ask, 50, 1);
+	ob.add(book, owner, ask, 30, 2);
+	ob.add(book, owner, ask, 40, 3);
+	ob.add(book, owner, ask, 30, 4);
+	ob.add(book, owner, ask, 60, 5);
+	ob.add(book, owner, ask, 10, 6);
+	ob.add(book, owner, ask, 50, 7);
+	EXPECT_EQ(listValues(ob, book, ask), std::vector<int>({ 6, 2, 4, 3, 1, 7, 5 }));
+
+	// bids: best is highest price
+	ob.add(book, owner, bid, 5, 11);
+	ob.add(book, owner, bid, 9, 12);
+	ob.add(book, owner, bid, 5, 13);
+	ob.add(book, owner, bid, 7, 14);
+	ob.add(book, owner, bid, 9, 15);
+	EXPECT_EQ(listValues(ob, book, bid), std::vector<int>({ 12, 15, 14, 11, 13 }));
+	EXPECT_EQ(ob.population(), 12u);
+	EXPECT_EQ(ob.population(book, ask), 7u);
+	EXPECT_EQ(ob.population(book, bid), 5u);
+
+	// head of specific level
+	EXPECT_EQ(ob.element(ob.headIndex(book, ask, 30)), 2);
+	EXPECT_EQ(ob.element(ob.headIndex(book, ask, 50)), 1);
+	EXPECT_EQ(ob.element(ob.headIndex(book, bid, 5)), 11);
+	EXPECT_EQ(ob.headIndex(book, ask, 5), QPI::NULL_INDEX);
+	EXPECT_EQ(ob.headIndex(book, bid, 50), QPI::NULL_INDEX);
+	EXPECT_EQ(ob.price(ob.headIndex(book, ask)), 10);
+	EXPECT_EQ(ob.price(ob.headIndex(book, bid)), 9);
+
+	// other books are not affected
+	EXPECT_EQ(ob.headIndex(owner, ask), QPI::NULL_INDEX);
+	EXPECT_EQ(ob.headIndex(QPI::id(1, 0, 0, 1), bid), QPI::NULL_INDEX);
+}
+
+TEST(QPIOrderBookTest, ExtremePrices)
+{
+	QPI::OrderBook<int, 16> ob;
+	ob.reset();
+	const QPI::id book(1, 0, 0, 0), owner(2, 0, 0, 0);
+
+	ob.add(book, owner, ask, 0, 1);
+	ob.add(book, owner, ask, INT64_MAX, 2);
+	ob.add(book, owner, ask, INT64_MIN, 3);
+	ob.add(book, owner, ask, -1, 4);
+	ob.add(book, owner, ask, INT64_MAX - 1, 5);
+	ob.add(book, owner, ask, INT64_MIN + 1, 6);
+	EXPECT_EQ(listValues(ob, book, ask), std::vector<int>({ 3, 6, 4, 1, 5, 2 }));
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Test: owner view
+
+TEST(QPIOrderBookTest, OwnerView)
+{
+	QPI::OrderBook<int, 32> ob;
+	ob.reset();
+	const QPI::id book1(1, 0, 0, 0), book2(1, 0, 0, 1), owner1(2, 0, 0, 0), owner2(3, 0, 0, 0);
+
+	ob.add(book1, owner1, ask, 20, 1);
+	ob.add(book2, owner1, ask, 10, 2);
+	ob.add(book1, owner2, ask, 10, 3);
+	ob.add(book2, owner1, ask, 20, 4);
+	ob.add(book1, owner1, bid, 5, 5);
+	ob.add(book2, owner1, bid, 6, 6);
+
+	EXPECT_EQ(listValues(ob, owner1, ask, true), std::vector<int>({ 2, 1, 4 }));
+	EXPECT_EQ(listValues(ob, owner1, bid, true), std::vector<int>({ 6, 5 }));
+	EXPECT_EQ(listValues(ob, owner2, ask, true), std::vector<int>({ 3 }));
+	EXPECT_EQ(listValues(ob, owner2, bid, true), std::vector<int>());
+	EXPECT_EQ(listValues(ob, book1, ask), std::vector<int>({ 3, 1 }));
+	EXPECT_EQ(listValues(ob, book2, ask), std::vector<int>({ 2, 4 }));
+
+	// owner level lookup
+	QPI::sint64 idx = ob.ownerHeadIndex(owner1, ask, 20);
+	EXPECT_EQ(ob.element(idx), 1);
+	EXPECT_EQ(ob.book(idx), book1);
+	EXPECT_EQ(ob.owner(idx), owner1);
+	idx = ob.nextOwnerElementIndex(idx);
+	EXPECT_EQ(ob.element(idx), 4);
+	EXPECT_EQ(ob.book(idx), book2);
+	EXPECT_EQ(ob.ownerHeadIndex(owner2, ask, 20), QPI::NULL_INDEX);
+
+	// move to end of owner level, keeping book view
+	const QPI::sint64 idx1 = ob.ownerHeadIndex(owner1, ask, 20);
+	ob.moveToOwnerTail(idx1);
+	EXPECT_EQ(listValues(ob, owner1, ask, true), std::vector<int>({ 2, 4, 1 }));
+	ob.moveToOwnerTail(idx1);
+	EXPECT_EQ(listValues(ob, owner1, ask, true), std::vector<int>({ 2, 4, 1 }));
+	ob.moveToOwnerTail(ob.ownerHeadIndex(owner1, ask, 20));
+	EXPECT_EQ(listValues(ob, owner1, ask, true), std::vector<int>({ 2, 1, 4 }));
+	ob.moveToOwnerTail(ob.ownerHeadIndex(owner1, ask, 10));
+	EXPECT_EQ(listValues(ob, owner1, ask, true), std::vector<int>({ 2, 1, 4 }));
+	EXPECT_EQ(listValues(ob, book1, ask), std::vector<int>({ 3, 1 }));
+	EXPECT_EQ(listValues(ob, book2, ask), std::vector<int>({ 2, 4 }));
+
+	// book and owner with same ID are different
+	ob.add(owner1, book1, ask, 1, 7);
+	EXPECT_EQ(listValues(ob, owner1, ask), std::vector<int>({ 7 }));
+	EXPECT_EQ(listValues(ob, owner1, ask, true), std::vector<int>({ 2, 1, 4 }));
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Test: remove, replace, recycling
+
+TEST(QPIOrderBookTest, RemoveAndReplace)
+{
+	QPI::OrderBook<int, 16> ob;
+	ob.reset();
+	const QPI::id book(1, 0, 0, 0), owner(2, 0, 0, 0);
+
+	QPI::sint64 i1 = ob.add(book, owner, bid, 10, 1);
+	QPI::sint64 i2 = ob.add(book, owner, bid, 10, 2);
+	QPI::sint64 i3 = ob.add(book, owner, bid, 8, 3);
+	QPI::sint64 i4 = ob.add(book, owner, bid, 7, 4);
+
+	// replace keeps position
+	ob.replace(i2, 22);
+	EXPECT_EQ(listValues(ob, book, bid), std::vector<int>({ 1, 22, 3, 4 }));
+
+	// remove returns next order of book side, other indices stay valid
+	EXPECT_EQ(ob.remove(i1), i2);
+	EXPECT_EQ(ob.remove(i2), i3);
+	EXPECT_TRUE(ob.isEmptySlot(i1));
+	EXPECT_TRUE(ob.isEmptySlot(i2));
+	EXPECT_EQ(ob.element(i3), 3);
+	EXPECT_EQ(ob.element(i4), 4);
+	EXPECT_EQ(ob.headIndex(book, bid, 10), QPI::NULL_INDEX);
+	EXPECT_EQ(ob.headIndex(book, bid), i3);
+	EXPECT_EQ(listValues(ob, owner, bid, true), std::vector<int>({ 3, 4 }));
+	EXPECT_EQ(ob.remove(i4), QPI::NULL_INDEX);
+	EXPECT_EQ(ob.remove(i4), QPI::NULL_INDEX);
+	ob.replace(i4, 44);
+	EXPECT_TRUE(ob.isEmptySlot(i4));
+	EXPECT_EQ(ob.population(), 1u);
+
+	// removed level is created again and sorted correctly
+	ob.add(book, owner, bid, 10, 5);
+	ob.add(book, owner, bid, 9, 6);
+	EXPECT_EQ(listValues(ob, book, bid), std::vector<int>({ 5, 6, 3 }));
+
+	// remove last order of side
+	while (ob.headIndex(book, bid) != QPI::NULL_INDEX)
+		ob.remove(ob.headIndex(book, bid));
+	EXPECT_EQ(ob.population(), 0u);
+	EXPECT_EQ(ob.ownerHeadIndex(owner, bid), QPI::NULL_INDEX);
+	EXPECT_EQ(ob.population(book, bid), 0u);
+}
+
+TEST(QPIOrderBookTest, FullOrderBook)
+{
+	QPI::OrderBook<int, 8> ob;
+	ob.reset();
+
+	// each order in its own book, owner, and level to use up as many sides and levels as possible
+	std::vector<QPI::sint64> indices;
+	for (int i = 0; i < 8; ++i)
+	{
+		QPI::sint64 idx = ob.add(QPI::id(i, 1, 0, 0), QPI::id(i, 2, 0, 0), QPI::uint8(i & 1), i, i);
+		EXPECT_NE(idx, QPI::NULL_INDEX);
+		indices.push_back(idx);
+	}
+	EXPECT_EQ(ob.population(), 8u);
+	EXPECT_EQ(ob.add(QPI::id(1, 1, 0, 0), QPI::id(1, 2, 0, 0), ask, 1, 100), QPI::NULL_INDEX);
+	EXPECT_EQ(ob.population(), 8u);
+
+	// free slot is reused
+	ob.remove(indices[3]);
+	QPI::sint64 idx = ob.add(QPI::id(9, 1, 0, 0), QPI::id(9, 2, 0, 0), bid, 9, 9);
+	EXPECT_EQ(idx, indices[3]);
+	EXPECT_EQ(ob.element(idx), 9);
+	EXPECT_EQ(ob.price(idx), 9);
+	EXPECT_EQ(ob.side(idx), bid);
+
+	// many cycles of removing and adding do not leak slots
+	std::mt19937_64 gen(42);
+	for (int i = 0; i < 10000; ++i)
+	{
+		QPI::sint64 r = gen() % 8;
+		ob.remove(r);
+		EXPECT_EQ(ob.add(QPI::id(gen() % 5, 0, 0, 0), QPI::id(gen() % 5, 0, 0, 0), QPI::uint8(gen() & 1), gen() % 7, i), r);
+	}
+	EXPECT_EQ(ob.population(), 8u);
+}
+
+TEST(QPIOrderBookTest, ResetCleansState)
+{
+	QPI::OrderBook<int, 16> ob;
+	ob.reset();
+	const QPI::id book(1, 0, 0, 0), owner(2, 0, 0, 0);
+	for (int i = 0; i < 10; ++i)
+		ob.add(book, owner, QPI::uint8(i & 1), i, i);
+	EXPECT_EQ(ob.population(), 10u);
+
+	ob.reset();
+	EXPECT_EQ(ob.population(), 0u);
+	EXPECT_EQ(ob.headIndex(book, ask), QPI::NULL_INDEX);
+	EXPECT_EQ(ob.headIndex(book, bid), QPI::NULL_INDEX);
+	EXPECT_EQ(ob.ownerHeadIndex(owner, ask), QPI::NULL_INDEX);
+	for (QPI::sint64 i = 0; i < 16; ++i)
+		EXPECT_TRUE(ob.isEmptySlot(i));
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Test: random operations compared with simple reference model
+
+struct OrderBookModel
+{
+	// orders of book/owner side: price -> FIFO of order indices
+	typedef std::map<QPI::sint64, std::deque<QPI::sint64>> Side;
+	std::map<std::pair<QPI::uint64, int>, Side> books, owners;
+
+	static std::vector<QPI::sint64> list(const Side& s, QPI::uint8 side)
+	{
+		std::vector<QPI::sint64> indices;
+		if (side == ask)
+		{
+			for (auto it = s.begin(); it != s.end(); ++it)
+				indices.insert(indices.end(), it->second.begin(), it->second.end());
+		}
+		else
+		{
+			for (auto it = s.rbegin(); it != s.rend(); ++it)
+				indices.insert(indices.end(), it->second.begin(), it->second.end());
+		}
+		return indices;
+	}
+
+	static void erase(std::map<std::pair<QPI::uint64, int>, Side>& sides, std::pair<QPI::uint64, int> key, QPI::sint64 price, QPI::sint64 idx)
+	{
+		auto& fifo = sides[key][price];
+		for (auto it = fifo.begin(); it != fifo.end(); ++it)
+		{
+			if (*it == idx)
+			{
+				fifo.erase(it);
+				break;
+			}
+		}
+		if (fifo.empty())
+			sides[key].erase(price);
+		if (sides[key].empty())
+			sides.erase(key);
+	}
+};
+
+template <QPI::uint64 L>
+void testRandomOperations(QPI::uint64 bookCount, QPI::uint64 ownerCount, QPI::uint64 priceCount, QPI::uint64 seed)
+{
+	QPI::OrderBook<QPI::uint64, L>* ob = new QPI::OrderBook<QPI::uint64, L>();
+	ob->reset();
+	OrderBookModel model;
+	std::map<QPI::sint64, std::pair<QPI::uint64, QPI::uint64>> orders; // idx -> (book, owner)
+	std::mt19937_64 gen(seed);
+
+	for (int step = 0; step < 20000; ++step)
+	{
+		const int p = gen() % 100;
+		if (p < 55 || orders.empty())
+		{
+			const QPI::uint64 b = gen() % bookCount, o = gen() % ownerCount;
+			const QPI::uint8 side = QPI::uint8(gen() & 1);
+			const QPI::sint64 price = QPI::sint64(gen() % priceCount) - QPI::sint64(priceCount / 3);
+			const QPI::sint64 idx = ob->add(QPI::id(b, 7, 0, 0), QPI::id(o, 8, 0, 0), side, price, gen());
+			if (orders.size() == L)
+			{
+				EXPECT_EQ(idx, QPI::NULL_INDEX);
+				continue;
+			}
+			ASSERT_NE(idx, QPI::NULL_INDEX);
+			EXPECT_EQ(orders.count(idx), 0u);
+			orders[idx] = std::make_pair(b, o);
+			model.books[std::make_pair(b, side)][price].push_back(idx);
+			model.owners[std::make_pair(o, side)][price].push_back(idx);
+		}
+		else if (p < 95)
+		{
+			// remove random order
+			auto it = orders.begin();
+			std::advance(it, gen() % orders.size());
+			const QPI::sint64 idx = it->first;
+			const QPI::uint8 side = ob->side(idx);
+			const QPI::sint64 price = ob->price(idx);
+			EXPECT_EQ(ob->book(idx), QPI::id(it->second.first, 7, 0, 0));
+			EXPECT_EQ(ob->owner(idx), QPI::id(it->second.second, 8, 0, 0));
+			const QPI::sint64 expectedNext = ob->nextElementIndex(idx);
+			EXPECT_EQ(ob->remove(idx), expectedNext);
+			OrderBookModel::erase(model.books, std::make_pair(it->second.first, side), price, idx);
+			OrderBookModel::erase(model.owners, std::make_pair(it->second.second, side), price, idx);
+			orders.erase(it);
+		}
+		else
+		{
+			// sweep best orders of a side, like matching does
+			const QPI::uint64 b = gen() % bookCount;
+			const QPI::uint8 side = QPI::uint8(gen() & 1);
+			QPI::sint64 idx = ob->headIndex(QPI::id(b, 7, 0, 0), side);
+			for (int n = gen() % 8; n > 0 && idx != QPI::NULL_INDEX; --n)
+			{
+				const QPI::sint64 price = ob->price(idx);
+				const QPI::uint64 o = orders[idx].second;
+				OrderBookModel::erase(model.books, std::make_pair(b, side), price, idx);
+				OrderBookModel::erase(model.owners, std::make_pair(o, side), price, idx);
+				orders.erase(idx);
+				idx = ob->remove(idx);
+			}
+		}
+		ASSERT_EQ(ob->population(), orders.size());
+
+		if (step % 500 == 0)
+		{
+			for (QPI::uint64 b = 0; b < bookCount; ++b)
+			{
+				for (QPI::uint8 side = 0; side < 2; ++side)
+				{
+					auto it = model.books.find(std::make_pair(b, int(side)));
+					const std::vector<QPI::sint64> expected = (it == model.books.end()) ? std::vector<QPI::sint64>() : OrderBookModel::list(it->second, side);
+					EXPECT_EQ(listOrders(*ob, QPI::id(b, 7, 0, 0), side), expected);
+				}
+			}
+			for (QPI::uint64 o = 0; o < ownerCount; ++o)
+			{
+				for (QPI::uint8 side = 0; side < 2; ++side)
+				{
+					auto it = model.owners.find(std::make_pair(o, int(side)));
+					const std::vector<QPI::sint64> expected = (it == model.owners.end()) ? std::vector<QPI::sint64>() : OrderBookModel::list(it->second, side);
+					EXPECT_EQ(listOrders(*ob, QPI::id(o, 8, 0, 0), side, true), expected);
+				}
+			}
+		}
+	}
+
+	delete ob;
+}
+
+TEST(QPIOrderBookTest, RandomOperationsDeepBooks)
+{
+	testRandomOperations<256>(3, 5, 40, 1);
+	testRandomOperations<256>(2, 2, 1000, 2);
+}
+
+TEST(QPIOrderBookTest, RandomOperationsManyBooks)
+{
+	// many sides and levels, which stresses hash map insertion and deletion
+	testRandomOperations<512>(200, 300, 10, 3);
+	testRandomOperations<64>(1000, 1000, 1000000, 4);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Performance: Qx-like order flow with pair of Collections (former implementation of Qx) vs. OrderBook
+
+struct PerfAssetOrder
+{
+	QPI::id entity;
+	QPI::sint64 numberOfShares;
+};
+
+struct PerfEntityOrder
+{
+	QPI::id issuer;
+	QPI::uint64 assetName;
+	QPI::sint64 numberOfShares;
+};
+
+struct PerfOrder
+{
+	bool isBid;
+	QPI::uint64 asset;
+	QPI::uint64 entity;
+	QPI::sint64 price;
+	QPI::sint64 numberOfShares;
+};
+
+static std::vector<PerfOrder> generatePerfOrderFlow(QPI::uint64 count, QPI::uint64 seed)
+{
+	std::mt19937_64 gen(seed);
+	std::vector<PerfOrder> flow(count);
+	for (auto& o : flow)
+	{
+		o.isBid = gen() & 1;
+		o.asset = gen() % 4;
+		o.entity = gen() % 1000;
+		// prices around 1000, spread wide enough for deep books; every 50th order sweeps many levels
+		const QPI::sint64 offset = QPI::sint64(gen() % 400);
+		o.price = o.isBid ? 800 + offset : 1200 - offset;
+		o.numberOfShares = 1 + gen() % 100;
+		if (gen() % 50 == 0)
+		{
+			o.price = o.isBid ? 1300 : 700;
+			o.numberOfShares *= 200;
+		}
+	}
+	return flow;
+}
+
+// Matching of former Qx implementation (without merging and transfers), returning number of trades
+template <QPI::uint64 L>
+static QPI::uint64 runCollectionOrderFlow(QPI::Collection<PerfAssetOrder, L>& assetOrders, QPI::Collection<PerfEntityOrder, L>& entityOrders, const std::vector<PerfOrder>& flow)
+{
+	QPI::uint64 trades = 0;
+	for (const auto& order : flow)
+	{
+		const QPI::id asset(order.asset, 0, 0, 1), entity(order.entity, 0, 0, 2);
+		QPI::sint64 n = order.numberOfShares;
+		QPI::sint64 idx = order.isBid ? assetOrders.headIndex(asset, 0) : assetOrders.headIndex(asset);
+		while (idx != QPI::NULL_INDEX && n > 0)
+		{
+			const QPI::sint64 priority = assetOrders.priority(idx);
+			if (order.isBid ? (-priority > order.price) : (priority < order.price))
+				break;
+			PerfAssetOrder ao = assetOrders.element(idx);
+			++trades;
+			if (ao.numberOfShares <= n)
+			{
+				idx = assetOrders.remove(idx);
+				QPI::sint64 idx2 = entityOrders.headIndex(ao.entity, priority);
+				while (entityOrders.element(idx2).issuer != asset)
+					idx2 = entityOrders.nextElementIndex(idx2);
+				entityOrders.remove(idx2);
+				n -= ao.numberOfShares;
+			}
+			else
+			{
+				ao.numberOfShares -= n;
+				assetOrders.replace(idx, ao);
+				QPI::sint64 idx2 = entityOrders.headIndex(ao.entity, priority);
+				while (entityOrders.element(idx2).issuer != asset)
+					idx2 = entityOrders.nextElementIndex(idx2);
+				PerfEntityOrder eo = entityOrders.element(idx2);
+				eo.numberOfShares -= n;
+				entityOrders.replace(idx2, eo);
+				n = 0;
+			}
+		}
+		if (n > 0)
+		{
+			const QPI::sint64 priority = order.isBid ? order.price : -order.price;
+			assetOrders.add(asset, PerfAssetOrder{ entity, n }, priority);
+			entityOrders.add(entity, PerfEntityOrder{ asset, 0, n }, priority);
+		}
+		assetOrders.cleanupIfNeeded(30);
+		entityOrders.cleanupIfNeeded(30);
+	}
+	return trades;
+}
+
+template <QPI::uint64 L>
+static QPI::uint64 runOrderBookOrderFlow(QPI::OrderBook<PerfEntityOrder, L>& orders, const std::vector<PerfOrder>& flow)
+{
+	QPI::uint64 trades = 0;
+	for (const auto& order : flow)
+	{
+		const QPI::id asset(order.asset, 0, 0, 1), entity(order.entity, 0, 0, 2);
+		QPI::sint64 n = order.numberOfShares;
+		QPI::sint64 idx = orders.headIndex(asset, order.isBid ? ask : bid);
+		while (idx != QPI::NULL_INDEX && n > 0)
+		{
+			const QPI::sint64 price = orders.price(idx);
+			if (order.isBid ? (price > order.price) : (price < order.price))
+				break;
+			PerfEntityOrder eo = orders.element(idx);
+			++trades;
+			if (eo.numberOfShares <= n)
+			{
+				idx = orders.remove(idx);
+				n -= eo.numberOfShares;
+			}
+			else
+			{
+				eo.numberOfShares -= n;
+				orders.replace(idx, eo);
+				n = 0;
+			}
+		}
+		if (n > 0)
+		{
+			orders.add(asset, entity, order.isBid ? bid : ask, order.price, PerfEntityOrder{ asset, 0, n });
+		}
+	}
+	return trades;
+}
+
+TEST(QPIOrderBookTest, OrderBookPerformance)
+{
+	commonBuffers.init(1, 16 * 1024 * 1024);
+
+	constexpr QPI::uint64 capacity = 1 << 16;
+	const std::vector<PerfOrder> flow = generatePerfOrderFlow(200000, 1234);
+
+	auto* assetOrders = new QPI::Collection<PerfAssetOrder, capacity>();
+	auto* entityOrders = new QPI::Collection<PerfEntityOrder, capacity>();
+	assetOrders->reset();
+	entityOrders->reset();
+	auto t0 = std::chrono::high_resolution_clock::now();
+	const QPI::uint64 collectionTrades = runCollectionOrderFlow(*assetOrders, *entityOrders, flow);
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	auto* orders = new QPI::OrderBook<PerfEntityOrder, capacity>();
+	orders->reset();
+	auto t2 = std::chrono::high_resolution_clock::now();
+	const QPI::uint64 orderBookTrades = runOrderBookOrderFlow(*orders, flow);
+	auto t3 = std::chrono::high_resolution_clock::now();
+
+	// same trades and same remaining books
+	EXPECT_EQ(collectionTrades, orderBookTrades);
+	EXPECT_EQ(assetOrders->population(), orders->population());
+	for (QPI::uint64 a = 0; a < 4; ++a)
+	{
+		const QPI::id asset(a, 0, 0, 1);
+		QPI::sint64 i1 = assetOrders->headIndex(asset);
+		QPI::sint64 i2 = orders->headIndex(asset, bid);
+		while (i2 != QPI::NULL_INDEX)
+		{
+			ASSERT_NE(i1, QPI::NULL_INDEX);
+			EXPECT_EQ(assetOrders->priority(i1), orders->price(i2));
+			EXPECT_EQ(assetOrders->element(i1).entity, orders->owner(i2));
+			EXPECT_EQ(assetOrders->element(i1).numberOfShares, orders->element(i2).numberOfShares);
+			i1 = assetOrders->nextElementIndex(i1);
+			i2 = orders->nextElementIndex(i2);
+		}
+		i2 = orders->headIndex(asset, ask);
+		while (i2 != QPI::NULL_INDEX)
+		{
+			ASSERT_NE(i1, QPI::NULL_INDEX);
+			EXPECT_EQ(-assetOrders->priority(i1), orders->price(i2));
+			EXPECT_EQ(assetOrders->element(i1).entity, orders->owner(i2));
+			EXPECT_EQ(assetOrders->element(i1).numberOfShares, orders->element(i2).numberOfShares);
+			i1 = assetOrders->nextElementIndex(i1);
+			i2 = orders->nextElementIndex(i2);
+		}
+		EXPECT_EQ(i1, QPI::NULL_INDEX);
+	}
+
+	delete assetOrders;
+	delete entityOrders;
+	delete orders;
+	commonBuffers.deinit();
+
+	const auto collectionMs = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+	const auto orderBookMs = std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count();
+	std::cout << "- [OrderBookPerformance] " << flow.size() << " orders, " << collectionTrades << " trades" << std::endl;
+	std::cout << "- [OrderBookPerformance] Collection pair:\t" << collectionMs << " ms" << std::endl;
+	std::cout << "- [OrderBookPerformance] OrderBook:\t\t" << orderBookMs << " ms" << std::endl;
+}
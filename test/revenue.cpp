@@ -566,3 +566,83 @@ TEST(TestCoreRevenue, MultiDimSerializeDeserialize)
 }
 
 
+
+// AVX2 version of finalizeTickScore() must match the plain per-dimension formula.
+TEST(TestCoreRevenue, FinalizeTickScoreMatchesScalar)
+{
+    unsigned short observed[REVENUE_TX_DIM];
+    unsigned long long windowSum[REVENUE_TX_DIM];
+    for (int iteration = 0; iteration < 100; iteration++)
+    {
+        const unsigned int activeRange = 1 + random(NUMBER_OF_TRANSACTIONS_PER_TICK);
+        for (unsigned int d = 0; d < REVENUE_TX_DIM; d++)
+        {
+            observed[d] = (unsigned short)random(activeRange);
+            windowSum[d] = random(activeRange * REVENUE_WINDOW_SIZE);
+        }
+
+        unsigned long long sumDef = 0;
+        unsigned long long sumCap = 0;
+        for (unsigned int d = 0; d < REVENUE_TX_DIM; d++)
+        {
+            const unsigned long long wo = (unsigned long long)REVENUE_WINDOW_SIZE * observed[d];
+            const unsigned long long m = revenueMul(d);
+            const unsigned long long deficit = (wo >= windowSum[d]) ? 0ULL : m * (windowSum[d] - wo);
+            sumDef += deficit * deficit;
+            sumCap += m * windowSum[d] * m * windowSum[d];
+        }
+        const unsigned long long expected = (sumCap == 0) ? REVENUE_SCALE
+            : REVENUE_SCALE - (REVENUE_SCALE * math_lib::irootK64<2>(sumDef)) / math_lib::irootK64<2>(sumCap);
+
+        EXPECT_EQ(invokeFinalizeTickScore(iteration, observed, windowSum), expected);
+    }
+}
+
+// V2 transaction scores computed while ticks are processed (including a rebuild as after loading a snapshot)
+// must match the scores of the circular sliding window over the whole epoch.
+TEST(TestCoreRevenue, V2StreamingMatchesFullComputation)
+{
+    auto dataPtr = std::make_unique<EpochRevenueData>();
+    EpochRevenueData& data = *dataPtr;
+    for (unsigned int N : { REVENUE_WINDOW_SIZE, REVENUE_WINDOW_SIZE + 1, 3 * REVENUE_WINDOW_SIZE + 17 })
+    {
+        setMem(&data, sizeof(data), 0);
+        data.initialTick = 1000 + random(1000);
+        data.totalTicks = N;
+
+        // Feed ticks as the tick processor does, with a restart in the middle
+        const unsigned int restartTick = random(N);
+        for (unsigned int t = 0; t < N; t++)
+        {
+            data.perTickTxCount[t] = (unsigned short)random(NUMBER_OF_TRANSACTIONS_PER_TICK + 1);
+            if (t == restartTick)
+                setMem(&gRevenueV2Stream, sizeof(gRevenueV2Stream), 0);
+            revenueV2OnTick(data, data.initialTick, t);
+        }
+        EXPECT_EQ(gRevenueV2Stream.nextTickOffset, N);
+
+        // Reference: circular window around each tick
+        unsigned long long expected[NUMBER_OF_COMPUTORS] = { 0 };
+        for (unsigned int t = 0; t < N; t++)
+        {
+            unsigned long long windowSum = 0;
+            for (int i = -(int)REVENUE_HALF_WINDOW; i <= (int)REVENUE_HALF_WINDOW; ++i)
+                windowSum += gTxRevenuePoints[data.perTickTxCount[(t + N + i) % N]];
+            expected[(data.initialTick + t) % NUMBER_OF_COMPUTORS] += gTxRevenuePoints[data.perTickTxCount[t]] * REVENUE_SCALE * REVENUE_WINDOW_SIZE / (windowSum ? windowSum : 1);
+        }
+
+        computeRevenueV2(data, gRevenueV2Stream);
+        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+            EXPECT_EQ(data.slidingWindowTxScore[i], expected[i]);
+        long long v2Revenue[NUMBER_OF_COMPUTORS];
+        copyMem(v2Revenue, data.v2Revenue, sizeof(v2Revenue));
+
+        // Computing from scratch gives same result
+        computeRevenueV2(data);
+        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+        {
+            EXPECT_EQ(data.slidingWindowTxScore[i], expected[i]);
+            EXPECT_EQ(data.v2Revenue[i], v2Revenue[i]);
+        }
+    }
+}
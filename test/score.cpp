@@ -1,6 +1,7 @@
 #define NO_UEFI
 
 #include "gtest/gtest.h"
+#include "benchmark_util.h"
 
 #define ENABLE_PROFILING 0
 
@@ -40,6 +41,9 @@ static constexpr unsigned long long TEST_NUMBER_OF_SAMPLES = 32;
 // Worker threads for the parallel path; effective count = min(this, hardware_concurrency, numSamples).
 static constexpr unsigned int TEST_NUMBER_OF_THREADS = 0;
 
+// Nonces per public key in the Bpp9000BatchVsSingle run.
+static constexpr unsigned int TEST_BATCH_SIZE = 4;
+
 // Samples and worker threads for the Bpp9000Profile timing run.
 static constexpr unsigned long long PROFILING_NUMBER_OF_SAMPLES = 48;
 static constexpr unsigned int MAX_NUMBER_OF_PROFILING_THREADS = 12;
@@ -335,6 +339,43 @@ static void runRefVsEngineConfig(const std::vector<m256i>& seeds, const std::vec
     });
 }
 
+// computeScores() vs computeScore() on the real task subview. Each batch scores the nonces of TEST_BATCH_SIZE
+// samples under the public key of the batch's first sample, whose score must also match the groundtruth.
+template<std::size_t I>
+static void runBatchVsSingleConfig(const std::vector<m256i>& seeds, const std::vector<m256i>& pubkeys, const std::vector<m256i>& nonces,
+                                   const std::vector<unsigned char>& taskBytes, const std::vector<std::vector<unsigned int>>& golden)
+{
+    using Cfg = std::tuple_element_t<I, ConfigList>;
+
+    const TaskBlocks tb = taskSubview<Cfg>(taskBytes);
+    std::vector<unsigned char> pool;
+    generatePool(seeds[0], pool);
+
+    const unsigned long long numBatches = seeds.size() / TEST_BATCH_SIZE;
+    runWorkers(workerThreadCount(numBatches), [&](unsigned int threadIdx, unsigned int numThreads)
+    {
+        auto engine = makeEngine<Cfg>(tb.topo, tb.data);
+        if (!engine)
+        {
+            return;
+        }
+        for (unsigned long long b = threadIdx; b < numBatches; b += numThreads)
+        {
+            const unsigned long long first = b * TEST_BATCH_SIZE;
+            const m256i& publicKey = pubkeys[first];
+            unsigned int batchScores[TEST_BATCH_SIZE];
+            engine->computeScores(publicKey.m256i_u8, &nonces[first], TEST_BATCH_SIZE, pool.data(), batchScores);
+
+            EXPECT_EQ(batchScores[0], golden[first][I]) << "config " << I << " sample " << first;
+            for (unsigned int i = 0; i < TEST_BATCH_SIZE; ++i)
+            {
+                unsigned int single = engine->computeScore(publicKey.m256i_u8, nonces[first + i].m256i_u8, pool.data());
+                EXPECT_EQ(batchScores[i], single) << "config " << I << " batch " << b << " nonce " << i;
+            }
+        }
+    });
+}
+
 template<std::size_t I = 0>
 static void runRegression(const std::vector<m256i>& seeds, const std::vector<m256i>& pubkeys, const std::vector<m256i>& nonces,
                           const std::vector<unsigned char>& taskBytes, const std::vector<std::vector<unsigned int>>& golden)
@@ -346,6 +387,17 @@ static void runRegression(const std::vector<m256i>& seeds, const std::vector<m25
     }
 }
 
+template<std::size_t I = 0>
+static void runBatchVsSingle(const std::vector<m256i>& seeds, const std::vector<m256i>& pubkeys, const std::vector<m256i>& nonces,
+                             const std::vector<unsigned char>& taskBytes, const std::vector<std::vector<unsigned int>>& golden)
+{
+    if constexpr (I < CONFIG_COUNT)
+    {
+        runBatchVsSingleConfig<I>(seeds, pubkeys, nonces, taskBytes, golden);
+        runBatchVsSingle<I + 1>(seeds, pubkeys, nonces, taskBytes, golden);
+    }
+}
+
 template<std::size_t I = 0>
 static void runRefVsEngine(const std::vector<m256i>& seeds, const std::vector<m256i>& pubkeys, const std::vector<m256i>& nonces)
 {
@@ -390,6 +442,21 @@ TEST(TestQubicScoreFunction, Bpp9000EngineVsReference)
     }
 }
 
+// TestBpp9000, multi-nonce batch of one public key vs scoring each nonce on its own
+TEST(TestQubicScoreFunction, Bpp9000BatchVsSingle)
+{
+    std::vector<m256i> seeds, pubkeys, nonces;
+    loadSamples(seeds, pubkeys, nonces, TEST_NUMBER_OF_SAMPLES);
+
+    auto golden = loadGolden();
+    ASSERT_GE(golden.size(), seeds.size()) << "fewer golden rows than samples";
+
+    auto taskBytes = readBinaryFile(TASK_FILE_NAME);
+    ASSERT_GT(taskBytes.size(), sizeof(score_task_file::TaskFileHeader)) << "missing/short " << TASK_FILE_NAME;
+
+    runBatchVsSingle(seeds, pubkeys, nonces, taskBytes, golden);
+}
+
 static void runBpp9000Profile()
 {
     using Cfg = ProductionConfig;
@@ -508,3 +575,49 @@ TEST(TestQubicScoreFunction, Bpp9000Profile)
 
 
 
+
+TEST(BENCHMARK_SUITE, Bpp9000ComputeScore)
+{
+    using Cfg = ProductionConfig;
+
+    std::vector<m256i> seeds, pubkeys, nonces;
+    loadSamples(seeds, pubkeys, nonces, PROFILING_NUMBER_OF_SAMPLES);
+    if (seeds.empty())
+    {
+        return;
+    }
+
+    std::vector<unsigned char> pool;
+    generatePool(seeds[0], pool);
+    std::vector<unsigned char> topo, data;
+    buildSyntheticTask<Cfg>(pool.data(), topo, data);
+    auto engine = makeEngine<Cfg>(topo.data(), data.data());
+    if (!engine)
+    {
+        return;
+    }
+
+    // one solution of the production config per operation, single-threaded
+    unsigned long long scoreSum = 0;
+    benchmark_util::run("Bpp9000 computeScore (production config)", [&](unsigned long long i)
+        {
+            const unsigned long long s = i % seeds.size();
+            scoreSum += engine->computeScore(pubkeys[s].m256i_u8, nonces[s].m256i_u8, pool.data());
+        }, seeds.size());
+    EXPECT_GT(scoreSum, 0ull);
+
+    // batches of TEST_BATCH_SIZE nonces under one public key, one batch per operation
+    scoreSum = 0;
+    const unsigned long long numBatches = seeds.size() / TEST_BATCH_SIZE;
+    benchmark_util::run("Bpp9000 computeScores batch (production config)", [&](unsigned long long i)
+        {
+            const unsigned long long first = (i % numBatches) * TEST_BATCH_SIZE;
+            unsigned int batchScores[TEST_BATCH_SIZE];
+            engine->computeScores(pubkeys[first].m256i_u8, &nonces[first], TEST_BATCH_SIZE, pool.data(), batchScores);
+            for (unsigned int k = 0; k < TEST_BATCH_SIZE; ++k)
+            {
+                scoreSum += batchScores[k];
+            }
+        }, numBatches);
+    EXPECT_GT(scoreSum, 0ull);
+}
@@ -3,9 +3,12 @@
 #define PRINT_TEST_INFO 0
 
 #include "gtest/gtest.h"
+#include "benchmark_util.h"
 
 #include <chrono>
 #include <random>
+#include <thread>
+#include <vector>
 
 #include "logging_test.h"
 #include "spectrum/spectrum.h"
@@ -78,6 +81,7 @@ static SpectrumInfo checkAndGetInfo()
     EXPECT_LE((unsigned long long)si.totalAmount, MAX_SUPPLY);
     EXPECT_EQ(si.totalAmount, spectrumInfo.totalAmount);
     EXPECT_EQ(si.numberOfEntities, spectrumInfo.numberOfEntities);
+    EXPECT_TRUE(checkSpectrumBalances());
     return si;
 }
 
@@ -147,6 +151,7 @@ struct SpectrumTest : public LoggingTest
     void clearSpectrum()
     {
         memset(spectrum, 0, spectrumSizeInBytes);
+        rebuildSpectrumBalances();
         updateSpectrumInfo();
     }
 
@@ -167,6 +172,8 @@ struct SpectrumTest : public LoggingTest
 
     void afterAntiDust()
     {
+        // Anti-dust is run by the tick processor at the end of the tick
+        runAntiDustIfNeeded();
         checkAndGetInfo();
 
         // Print anti-dust info
@@ -315,10 +322,10 @@ TEST(TestCoreSpectrum, AntiDustEdgeCaseHugeBinsAndLogging)
         increaseEnergy(m256i(i, 1, 2, 3), amount);
     }
 
-    // test anti-dust
+    // test anti-dust (at the end of the tick, followed by the transfer of the next tick)
     test.beforeAntiDust();
-    increaseEnergy(m256i(SPECTRUM_CAPACITY - 1, 1, 2, 3), 1000llu);
     test.afterAntiDust();
+    increaseEnergy(m256i(SPECTRUM_CAPACITY - 1, 1, 2, 3), 1000llu);
 
     // check logs:
     // first 24 are from building up spectrum
@@ -407,3 +414,139 @@ TEST(TestCoreSpectrum, AntiDustEdgeCaseHugeBinZeroBalance)
     test.afterAntiDust();
 }
 
+
+TEST(TestCoreSpectrum, ComputeDigestsInSubtrees)
+{
+    SpectrumTest test;
+    for (int i = 0; i < 1000; ++i)
+        increaseEnergy(m256i(test.rnd64(), test.rnd64(), test.rnd64(), test.rnd64()), test.rnd64() % 1000000 + 1);
+
+    // reference: hash level by level
+    unsigned int digestIndex;
+    for (digestIndex = 0; digestIndex < SPECTRUM_CAPACITY; digestIndex++)
+        KangarooTwelve64To32(&spectrum[digestIndex], &spectrumDigests[digestIndex]);
+    unsigned int previousLevelBeginning = 0;
+    unsigned int numberOfLeafs = SPECTRUM_CAPACITY;
+    while (numberOfLeafs > 1)
+    {
+        for (unsigned int i = 0; i < numberOfLeafs; i += 2)
+            KangarooTwelve64To32(&spectrumDigests[previousLevelBeginning + i], &spectrumDigests[digestIndex++]);
+        previousLevelBeginning += numberOfLeafs;
+        numberOfLeafs >>= 1;
+    }
+    m256i expectedDigestOfTree;
+    KangarooTwelve(spectrumDigests, spectrumDigestsSizeInByte, &expectedDigestOfTree, 32);
+
+    // serial and subtree-based computation (subtrees run on the calling thread without MP services)
+    for (bool useStartupWorkers : { false, true })
+    {
+        memset(spectrumDigests, 0, spectrumDigestsSizeInByte);
+        computeSpectrumDigests(useStartupWorkers);
+        m256i digestOfTree;
+        KangarooTwelve(spectrumDigests, spectrumDigestsSizeInByte, &digestOfTree, 32);
+        EXPECT_EQ(digestOfTree, expectedDigestOfTree);
+    }
+}
+
+TEST(TestCoreSpectrum, BalanceColumnScans)
+{
+    SpectrumTest test;
+    for (int i = 0; i < 100000; ++i)
+    {
+        const m256i id(test.rnd64(), test.rnd64(), test.rnd64(), test.rnd64());
+        const long long amount = (i % 7 == 0) ? 1 : (test.rnd64() >> (test.rnd64() % 64)) % 1000000000000 + 1;
+        increaseEnergy(id, amount);
+        if (i % 10 == 0)
+            decreaseEnergy(spectrumIndex(id), amount); // keep entity with balance 0
+    }
+    EXPECT_TRUE(checkSpectrumBalances());
+
+    // reference: scan records
+    SpectrumInfo expectedInfo{ 0, 0 };
+    unsigned int expectedPopulations[entityCategoryCount] = { 0 };
+    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
+    {
+        const long long balance = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
+        if (balance || !isZero(spectrum[i].publicKey))
+        {
+            expectedInfo.numberOfEntities++;
+            expectedInfo.totalAmount += balance;
+        }
+        if (balance)
+            expectedPopulations[63 - __lzcnt64(balance)]++;
+    }
+    EXPECT_EQ(expectedInfo.numberOfEntities, 100000u);
+
+    SpectrumInfo si;
+    updateSpectrumInfo(si);
+    EXPECT_EQ(si.numberOfEntities, expectedInfo.numberOfEntities);
+    EXPECT_EQ(si.totalAmount, expectedInfo.totalAmount);
+    EXPECT_EQ(spectrumInfo.numberOfEntities, expectedInfo.numberOfEntities);
+    EXPECT_EQ(spectrumInfo.totalAmount, expectedInfo.totalAmount);
+
+    updateAndAnalzeEntityCategoryPopulations();
+    for (unsigned int i = 0; i < entityCategoryCount; i++)
+        EXPECT_EQ(entityCategoryPopulations[i], expectedPopulations[i]);
+
+    // reorganization removes entities with balance 0 and keeps column in sync
+    reorganizeSpectrum();
+    EXPECT_TRUE(checkSpectrumBalances());
+    EXPECT_EQ(spectrumInfo.numberOfEntities, 90000u);
+    EXPECT_EQ(spectrumInfo.totalAmount, expectedInfo.totalAmount);
+}
+
+TEST(TestCoreSpectrum, AntiDustWithHelpers)
+{
+    SpectrumTest test;
+    for (unsigned int i = 0; i < SPECTRUM_CAPACITY / 2 + SPECTRUM_CAPACITY / 4; ++i)
+        increaseEnergy(m256i(test.rnd64(), test.rnd64(), test.rnd64(), test.rnd64()), test.rnd64() % 100000 + 1);
+    std::vector<EntityRecord> spectrumBeforeAntiDust(spectrum, spectrum + SPECTRUM_CAPACITY);
+
+    // reference: anti-dust processed by calling thread only
+    runAntiDustIfNeeded();
+    EXPECT_TRUE(checkSpectrumBalances());
+    const SpectrumInfo expectedInfo = spectrumInfo;
+    const m256i expectedDigest = spectrumDigests[(SPECTRUM_CAPACITY * 2 - 1) - 1];
+    EXPECT_LT(expectedInfo.numberOfEntities, SPECTRUM_CAPACITY / 2);
+
+    // emulate request processors helping with chunks of the spectrum scans
+    static volatile bool stopHelpers = false;
+    std::vector<std::thread> helpers;
+    for (int i = 0; i < 3; ++i)
+    {
+        helpers.emplace_back([]()
+            {
+                while (!stopHelpers)
+                    spectrumJob.tryHelp();
+            });
+    }
+
+    copyMem(spectrum, spectrumBeforeAntiDust.data(), spectrumSizeInBytes);
+    rebuildSpectrumBalances();
+    computeSpectrumDigests();
+    updateSpectrumInfo();
+    runAntiDustIfNeeded();
+
+    stopHelpers = true;
+    for (auto& helper : helpers)
+        helper.join();
+
+    // same result, because burning and inserting into the hash map don't depend on the order of processing chunks
+    EXPECT_TRUE(checkSpectrumBalances());
+    EXPECT_EQ(spectrumInfo.numberOfEntities, expectedInfo.numberOfEntities);
+    EXPECT_EQ(spectrumInfo.totalAmount, expectedInfo.totalAmount);
+    EXPECT_EQ(spectrumDigests[(SPECTRUM_CAPACITY * 2 - 1) - 1], expectedDigest);
+}
+
+TEST(BENCHMARK_SUITE, SpectrumDigests)
+{
+    SpectrumTest test(42);
+    for (int i = 0; i < 100000; ++i)
+        increaseEnergy(m256i(test.rnd64(), test.rnd64(), test.rnd64(), test.rnd64()), test.rnd64() % 1000000 + 1);
+
+    // full rebuild of the Merkle tree (SPECTRUM_CAPACITY leaves), all subtrees on the calling thread
+    benchmark_util::runOnce("Spectrum digests full rebuild", []()
+        {
+            computeSpectrumDigests();
+        });
+}
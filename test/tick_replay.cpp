@@ -0,0 +1,687 @@
+#define NO_UEFI
+
+// Tick replay harness: replays recorded ticks on top of a node state snapshot with the tick processing code of the
+// node, checks the resulting digests against the votes of the computors, and measures the processing time using the
+// PROFILE_SCOPE instrumentation of the core code (enabled for this compile unit).
+//
+// The harness loads the snapshot files written by saveAllNodeStates() (directory "epXXX" of the node, requires
+// TICK_STORAGE_AUTOSAVE_MODE in the node that saved it) and replays the stored ticks starting at the tick of the
+// snapshot, mirroring processTick() in qubic.cpp: BEGIN_TICK, the transactions of the tick processed by
+// processTickTransaction() (see ticking/tick_transaction_processing.h), oracle and OC timeouts and notifications,
+// execution fee reports, END_TICK, anti-dust, and the spectrum, universe, and computer digests.
+//
+// After each tick, the digests and the resource testing digest are compared to the prev digests that a quorum of
+// computors voted for in the next tick. The test fails at the first tick with a differing digest and if no tick could
+// be verified. Known limitations of the test build:
+// - The oracle and OC engine states aren't restored (their snapshots are only compiled with
+//   TICK_STORAGE_AUTOSAVE_MODE), so replies to queries started before the snapshot tick aren't processed.
+// - Solution thresholds set by the operator aren't part of the snapshot, the defaults are used.
+// - Scores of solutions can only be computed if the bpp9000 task file is in the parent directory of the snapshot
+//   (the working directory of the node).
+// - The tick storage only holds MAX_NUMBER_OF_TICKS_PER_EPOCH ticks, so ticks are replayed in windows that keep the
+//   preceding half window in the storage for transactions that refer to earlier ticks.
+//
+// Environment variables:
+// - QUBIC_REPLAY_SNAPSHOT_DIR: snapshot directory with spectrum, universe, contract states, and system.snp (required)
+// - QUBIC_REPLAY_TICKS_DIR: directory with the tick storage snapshot files providing the ticks to replay and the
+//   votes, usually a later snapshot of the same epoch (default: QUBIC_REPLAY_SNAPSHOT_DIR)
+// - QUBIC_REPLAY_TICK_COUNT: maximum number of ticks to replay (default: all stored ticks after the snapshot tick)
+//
+// The per-phase cycles are printed to stdout and written to profiling.csv in the working directory.
+#define ENABLE_PROFILING
+
+#include "contract_testing.h"
+#include "ticking/tick_transaction_processing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Layout of TickStorage::MetaData (file "snapshotMetadata.XXX"), which is only compiled with TICK_STORAGE_AUTOSAVE_MODE
+struct TickStorageSnapshotMetaData
+{
+    unsigned int epoch;
+    unsigned int tickBegin;
+    unsigned int tickEnd;
+    long long outTotalTransactionSize;
+    unsigned long long outNextTickTransactionOffset;
+    unsigned int tickVoteOverflowBlocks;
+};
+
+struct ReplayStats
+{
+    unsigned int ticks = 0;
+    unsigned int emptyTicks = 0;
+    unsigned int verifiedTicks = 0;
+    unsigned long long transactions = 0;
+    unsigned long long contractTransactions = 0;
+    unsigned long long protocolTransactions = 0;
+    unsigned long long cycles = 0;
+    unsigned long long nanoseconds = 0;
+};
+
+// Offset of the tick in which execution fee reports are processed (TICK_TRANSACTIONS_PUBLICATION_OFFSET in qubic.cpp)
+static constexpr unsigned int REPLAY_TICK_TRANSACTIONS_PUBLICATION_OFFSET = 2;
+
+static std::string threeDigits(unsigned long long value)
+{
+    std::string s = std::to_string(value % 1000);
+    return std::string(3 - s.size(), '0') + s;
+}
+
+static const char* getEnvironmentVariable(const char* name)
+{
+    const char* value = std::getenv(name);
+    return (value && *value) ? value : nullptr;
+}
+
+// Read size bytes at offset of a file saved with saveLargeFile(), which is split into chunk files "<fileName>.XXX"
+// of FILE_CHUNK_SIZE bytes if totalSize >= FILE_CHUNK_SIZE.
+static bool readLargeFileRange(const std::filesystem::path& fileName, unsigned long long totalSize, unsigned long long offset, unsigned long long size, void* buffer)
+{
+    unsigned char* out = (unsigned char*)buffer;
+    while (size)
+    {
+        std::filesystem::path chunkFileName = fileName;
+        unsigned long long chunkOffset = offset;
+        unsigned long long chunkSize = totalSize;
+        if (totalSize >= FILE_CHUNK_SIZE)
+        {
+            chunkFileName += "." + threeDigits(offset / FILE_CHUNK_SIZE);
+            chunkOffset = offset % FILE_CHUNK_SIZE;
+            chunkSize = FILE_CHUNK_SIZE;
+        }
+        const unsigned long long readSize = std::min(size, chunkSize - chunkOffset);
+        std::ifstream file(chunkFileName, std::ios::binary);
+        if (!file.seekg(chunkOffset) || !file.read((char*)out, readSize))
+        {
+            std::cout << "Cannot read " << readSize << " bytes at offset " << chunkOffset << " of " << chunkFileName.string() << std::endl;
+            return false;
+        }
+        out += readSize;
+        offset += readSize;
+        size -= readSize;
+    }
+    return true;
+}
+
+static std::string digestToIdentity(const m256i& digest)
+{
+    CHAR16 identity[61];
+    getIdentity(digest.m256i_u8, identity, true);
+    return std::string(identity, identity + 60);
+}
+
+// Contracts whose state has been loaded from the snapshot. Others (for example the test contracts, which don't exist
+// in the node) are not executed, because their state and the engines they use aren't initialized.
+static bool contractInSnapshot[contractCount];
+
+// Mirror of the BEGIN_TICK and END_TICK phases of contractProcessor() in qubic.cpp
+static void runContractSystemProcedures(SystemProcedureID systemProcedure)
+{
+    for (unsigned int i = 1; i < contractCount; i++)
+    {
+        const unsigned int contractIndex = (systemProcedure == END_TICK) ? contractCount - i : i;
+        if (contractInSnapshot[contractIndex]
+            && system.epoch >= contractDescriptions[contractIndex].constructionEpoch
+            && system.epoch < contractDescriptions[contractIndex].destructionEpoch
+            && getContractFeeReserve(contractIndex) > 0
+            && contractError[contractIndex] == NoContractError)
+        {
+            QpiContextSystemProcedureCall qpiContext(contractIndex, systemProcedure);
+            qpiContext.call();
+        }
+    }
+}
+
+// Called by processTickTransaction(). Without contract processor, the contract code runs in the replaying thread.
+static bool runContractTransaction(const Transaction* transaction, unsigned int phase, unsigned char postIncomingTransferType)
+{
+    if (!contractInSnapshot[transaction->destinationPublicKey.m256i_u64[0]])
+        return false;
+    return executeContractTransaction(transaction, phase, postIncomingTransferType);
+}
+
+
+class TickReplay : public ContractTesting
+{
+public:
+    TickReplay()
+    {
+        // Needed for the load times logged by the spectrum and universe functions and for the profiling output
+        if (!frequency)
+            initTimeStampCounter();
+
+        initEmptySpectrum();
+        initEmptyUniverse();
+        for (unsigned int contractIndex = 1; contractIndex < contractCount; ++contractIndex)
+        {
+            contractStates[contractIndex] = (unsigned char*)malloc(contractDescriptions[contractIndex].stateSize);
+            setMem(contractStates[contractIndex], contractDescriptions[contractIndex].stateSize, 0);
+        }
+        initializeContracts();
+
+        // State of processTickTransaction() and the engines, allocated as in initialize() of qubic.cpp
+        EXPECT_TRUE(ts.init());
+        EXPECT_TRUE(allocPoolWithErrorLog(L"score", sizeof(*score), (void**)&score, __LINE__));
+        EXPECT_TRUE(allocPoolWithErrorLog(L"minerSolutionFlags", NUMBER_OF_MINER_SOLUTION_FLAGS / 8, (void**)&minerSolutionFlags, __LINE__));
+        score->initMemory();
+        voteCounter.init();
+        gDogeMiningSharesCounter.init();
+        executionFeeReportCollector.init();
+        EXPECT_TRUE(customQubicMiningStorage.init());
+        EXPECT_TRUE(OI::initOracleInterfaces());
+        EXPECT_TRUE(oracleEngine.init(broadcastedComputors.computors.publicKeys));
+        EXPECT_TRUE(OCI::initOcInterfaces());
+        EXPECT_TRUE(ocEngine.init(broadcastedComputors.computors.publicKeys));
+    }
+
+    ~TickReplay()
+    {
+        ocEngine.deinit();
+        oracleEngine.deinit();
+        customQubicMiningStorage.deinit();
+        if (gBpp9000TaskBuffer)
+        {
+            freePool(gBpp9000TaskBuffer);
+            gBpp9000TaskBuffer = nullptr;
+        }
+        freePool(minerSolutionFlags);
+        minerSolutionFlags = nullptr;
+        freePool(score);
+        score = nullptr;
+        ts.deinit();
+    }
+
+    // Load node states saved by saveAllNodeStates(), mirroring loadAllNodeStates() and initialize() in qubic.cpp.
+    // The NO_UEFI file functions don't support directories, so the working directory is changed while loading.
+    bool loadNodeStates(const std::filesystem::path& directory)
+    {
+        const std::filesystem::path previousWorkingDirectory = std::filesystem::current_path();
+        std::filesystem::current_path(directory);
+        bool okay = loadNodeStatesFromWorkingDirectory();
+
+        // The task file is loaded from the working directory of the node, which contains the snapshot directory
+        std::filesystem::current_path(std::filesystem::absolute(directory).parent_path());
+        if (okay && !loadBpp9000Task())
+            std::cout << "Scores of solutions can't be computed, resource testing digests will differ if there are solutions" << std::endl;
+
+        std::filesystem::current_path(previousWorkingDirectory);
+        return okay;
+    }
+
+    // Prepare replaying the ticks stored in the tick storage snapshot files in directory.
+    // maxTickCount == 0 replays all stored ticks after the snapshot tick.
+    bool openTicks(const std::filesystem::path& directory, unsigned int maxTickCount)
+    {
+        ticksDirectory = directory;
+        const std::string epoch = threeDigits(system.epoch);
+        if (!readLargeFileRange(directory / ("snapshotMetadata." + epoch), sizeof(metaData), 0, sizeof(metaData), &metaData))
+            return false;
+        if (metaData.epoch != system.epoch || metaData.tickBegin > metaData.tickEnd)
+        {
+            std::cout << "Invalid tick storage snapshot" << std::endl;
+            return false;
+        }
+
+        // Replay from the tick of the node state snapshot, which hasn't been processed when the snapshot was saved
+        firstTick = std::max(system.tick, metaData.tickBegin);
+        lastTick = (maxTickCount) ? std::min(metaData.tickEnd, firstTick + maxTickCount - 1) : metaData.tickEnd;
+        if (firstTick > lastTick)
+        {
+            std::cout << "Tick storage snapshot ends with tick " << metaData.tickEnd << " before snapshot tick " << firstTick
+                << ". Set QUBIC_REPLAY_TICKS_DIR to a later snapshot of epoch " << system.epoch << "." << std::endl;
+            return false;
+        }
+
+        // Shared digests of the votes, including the votes of the tick after the last tick to verify its digests
+        const unsigned int lastVotesTick = std::min(lastTick + 1, metaData.tickEnd);
+        voteDigests.resize(lastVotesTick - firstTick + 1);
+        if (!readLargeFileRange(directory / ("snapshotTickVoteDigests." + epoch), storedTickCount() * sizeof(TickVoteSharedDigestsTable),
+            (firstTick - metaData.tickBegin) * sizeof(TickVoteSharedDigestsTable), voteDigests.size() * sizeof(TickVoteSharedDigestsTable), voteDigests.data()))
+            return false;
+        voteOverflowBlocks.resize(metaData.tickVoteOverflowBlocks);
+        if (!voteOverflowBlocks.empty() && !readLargeFileRange(directory / ("snapshotTickVoteOverflow." + epoch), voteOverflowBlocks.size() * sizeof(TickVoteSharedDigestsOverflowBlock),
+            0, voteOverflowBlocks.size() * sizeof(TickVoteSharedDigestsOverflowBlock), voteOverflowBlocks.data()))
+            return false;
+
+        std::cout << "Replaying ticks " << firstTick << " to " << lastTick << " of epoch " << system.epoch << std::endl;
+        return true;
+    }
+
+    // Compute all digests from scratch as in initialization of the node (not part of the measurement)
+    void computeInitialDigests()
+    {
+        computeSpectrumDigests();
+        setMem(spectrumChangeFlags, sizeof(spectrumChangeFlags), 0);
+        getUniverseDigest(universeDigest);
+        getComputerDigest(computerDigest);
+    }
+
+    // Replay the ticks and verify the digests. Stops at the first tick with digests that differ from the votes,
+    // because the digests of all later ticks depend on it.
+    bool replayTicks(ReplayStats& stats)
+    {
+        // The votes of the first tick contain the digests of the loaded state (except in the first tick of the epoch,
+        // which votes for the digests of the prior epoch)
+        if (firstTick > system.initialTick && !verifyDigests(firstTick, stats))
+            return false;
+
+        constexpr unsigned int windowTickCount = MAX_NUMBER_OF_TICKS_PER_EPOCH / 2;
+        for (unsigned int windowBegin = firstTick; windowBegin <= lastTick; windowBegin += windowTickCount)
+        {
+            const unsigned int windowEnd = std::min(lastTick, windowBegin + windowTickCount - 1);
+            if (!loadTicks(std::max(metaData.tickBegin, windowBegin - std::min(windowBegin, windowTickCount)), windowBegin, windowEnd))
+                return false;
+
+            for (unsigned int tick = windowBegin; tick <= windowEnd; ++tick)
+            {
+                const TickVoteSharedDigests* votedDigests = getQuorumDigests(tick);
+                if (votedDigests)
+                    copyMem(&etalonTick.millisecond, &votedDigests->time, sizeof(votedDigests->time));
+
+                const auto startTime = std::chrono::steady_clock::now();
+                const unsigned long long startTsc = __rdtsc();
+                replayTick(tick, stats);
+                stats.cycles += __rdtsc() - startTsc;
+                stats.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+                if (!verifyDigests(tick + 1, stats))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    void printDigests() const
+    {
+        std::cout << "Spectrum digest: " << digestToIdentity(spectrumDigests[(SPECTRUM_CAPACITY * 2 - 1) - 1]) << std::endl;
+        std::cout << "Universe digest: " << digestToIdentity(universeDigest) << std::endl;
+        std::cout << "Computer digest: " << digestToIdentity(computerDigest) << std::endl;
+        std::cout << "Resource testing digest: " << resourceTestingDigest << std::endl;
+    }
+
+private:
+    std::filesystem::path ticksDirectory;
+    TickStorageSnapshotMetaData metaData;
+    unsigned int firstTick = 0;
+    unsigned int lastTick = 0;
+    std::vector<TickVoteSharedDigestsTable> voteDigests;
+    std::vector<TickVoteSharedDigestsOverflowBlock> voteOverflowBlocks;
+    std::vector<unsigned long long> transactionOffsets;
+    std::vector<unsigned char> transactions;
+
+    m256i universeDigest, computerDigest;
+
+    unsigned long long storedTickCount() const
+    {
+        return metaData.tickEnd - metaData.tickBegin + 1;
+    }
+
+    bool loadNodeStatesFromWorkingDirectory()
+    {
+        CHAR16 SYSTEM_SNAPSHOT_FILE_NAME[] = L"system.snp";
+        if (load(SYSTEM_SNAPSHOT_FILE_NAME, sizeof(system), (unsigned char*)&system) != sizeof(system))
+        {
+            std::cout << "Failed to load system.snp" << std::endl;
+            return false;
+        }
+
+        SPECTRUM_FILE_NAME[sizeof(SPECTRUM_FILE_NAME) / sizeof(SPECTRUM_FILE_NAME[0]) - 4] = L'0';
+        SPECTRUM_FILE_NAME[sizeof(SPECTRUM_FILE_NAME) / sizeof(SPECTRUM_FILE_NAME[0]) - 3] = L'0';
+        SPECTRUM_FILE_NAME[sizeof(SPECTRUM_FILE_NAME) / sizeof(SPECTRUM_FILE_NAME[0]) - 2] = L'0';
+        if (!loadSpectrum(SPECTRUM_FILE_NAME, nullptr, /*incremental=*/true))
+        {
+            std::cout << "Failed to load spectrum" << std::endl;
+            return false;
+        }
+
+        UNIVERSE_FILE_NAME[sizeof(UNIVERSE_FILE_NAME) / sizeof(UNIVERSE_FILE_NAME[0]) - 4] = L'0';
+        UNIVERSE_FILE_NAME[sizeof(UNIVERSE_FILE_NAME) / sizeof(UNIVERSE_FILE_NAME[0]) - 3] = L'0';
+        UNIVERSE_FILE_NAME[sizeof(UNIVERSE_FILE_NAME) / sizeof(UNIVERSE_FILE_NAME[0]) - 2] = L'0';
+        // The index lists are loaded instead of being rebuilt, because rebuilding may change the order of asset
+        // iteration (see loadSnapshotUniverseIndex(), which is only compiled with TICK_STORAGE_AUTOSAVE_MODE)
+        CHAR16 UNIVERSE_INDEX_FILE_NAME[] = L"snapshotUniverseIndex";
+        if (!loadUniverse(UNIVERSE_FILE_NAME, nullptr, /*rebuildIndexLists=*/false, /*incremental=*/true)
+            || load(UNIVERSE_INDEX_FILE_NAME, sizeof(as.indexLists), (unsigned char*)&as.indexLists) != sizeof(as.indexLists))
+        {
+            std::cout << "Failed to load universe" << std::endl;
+            return false;
+        }
+
+        CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 4] = L'0';
+        CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 3] = L'0';
+        CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 2] = L'0';
+        for (unsigned int contractIndex = 0; contractIndex < contractCount; contractIndex++)
+        {
+            CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 9] = contractIndex / 1000 + L'0';
+            CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 8] = (contractIndex % 1000) / 100 + L'0';
+            CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 7] = (contractIndex % 100) / 10 + L'0';
+            CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 6] = contractIndex % 10 + L'0';
+            const unsigned long long stateSize = contractDescriptions[contractIndex].stateSize;
+            contractInSnapshot[contractIndex] = (loadIncrementalFile(CONTRACT_FILE_NAME, stateSize, contractStates[contractIndex]) == (long long)stateSize);
+            if (!contractInSnapshot[contractIndex])
+            {
+                if (!contractIndex)
+                {
+                    std::cout << "Failed to load state of contract 0" << std::endl;
+                    return false;
+                }
+                std::cout << "Contract state " << contractIndex << " not loaded, contract is not executed" << std::endl;
+                setMem(contractStates[contractIndex], stateSize, 0);
+            }
+        }
+
+        CONTRACT_EXEC_FEES_ACC_FILE_NAME[sizeof(CONTRACT_EXEC_FEES_ACC_FILE_NAME) / sizeof(CONTRACT_EXEC_FEES_ACC_FILE_NAME[0]) - 4] = L'0';
+        CONTRACT_EXEC_FEES_ACC_FILE_NAME[sizeof(CONTRACT_EXEC_FEES_ACC_FILE_NAME) / sizeof(CONTRACT_EXEC_FEES_ACC_FILE_NAME[0]) - 3] = L'0';
+        CONTRACT_EXEC_FEES_ACC_FILE_NAME[sizeof(CONTRACT_EXEC_FEES_ACC_FILE_NAME) / sizeof(CONTRACT_EXEC_FEES_ACC_FILE_NAME[0]) - 2] = L'0';
+        CONTRACT_EXEC_FEES_REC_FILE_NAME[sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME) / sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME[0]) - 4] = L'0';
+        CONTRACT_EXEC_FEES_REC_FILE_NAME[sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME) / sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME[0]) - 3] = L'0';
+        CONTRACT_EXEC_FEES_REC_FILE_NAME[sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME) / sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME[0]) - 2] = L'0';
+        if (!executionFeeReportCollector.loadFromFile(CONTRACT_EXEC_FEES_REC_FILE_NAME)
+            || !executionTimeAccumulator.loadFromFile(CONTRACT_EXEC_FEES_ACC_FILE_NAME))
+        {
+            std::cout << "Failed to load contract execution fee files" << std::endl;
+            return false;
+        }
+
+        CHAR16 NODE_STATE_FILE_NAME[] = L"snapshotNodeMiningState";
+        std::unique_ptr<NodeMiningStateSnapshot> nodeState = std::make_unique<NodeMiningStateSnapshot>();
+        if (load(NODE_STATE_FILE_NAME, sizeof(*nodeState), (unsigned char*)nodeState.get()) != sizeof(*nodeState))
+        {
+            std::cout << "Failed to load mining state" << std::endl;
+            return false;
+        }
+        copyMem(&etalonTick, &nodeState->etalonTick, sizeof(etalonTick));
+        copyMem((void*)minerPublicKeys, nodeState->minerPublicKeys, sizeof(minerPublicKeys));
+        copyMem((void*)minerScores, nodeState->minerScores, sizeof(minerScores));
+        copyMem((void*)minerBestScoreTicks, nodeState->minerBestScoreTicks, sizeof(minerBestScoreTicks));
+        copyMem(competitorPublicKeys, nodeState->competitorPublicKeys, sizeof(competitorPublicKeys));
+        copyMem(competitorScores, nodeState->competitorScores, sizeof(competitorScores));
+        copyMem(competitorTicks, nodeState->competitorTicks, sizeof(competitorTicks));
+        copyMem(competitorComputorStatuses, nodeState->competitorComputorStatuses, sizeof(competitorComputorStatuses));
+        copyMem(solutionPublicationTicks, nodeState->solutionPublicationTicks, sizeof(solutionPublicationTicks));
+        copyMem(&broadcastedComputors, &nodeState->broadcastedComputors, sizeof(broadcastedComputors));
+        resourceTestingDigest = nodeState->resourceTestingDigest;
+        numberOfMiners = nodeState->numberOfMiners;
+        numberOfTransactions = nodeState->numberOfTransactions;
+        voteCounter.loadAllDataFromArray(nodeState->voteCounterData);
+        gDogeMiningSharesCounter.loadAllDataFromArray(nodeState->dogeMiningSharesCounterData);
+        score->initMiningData(nodeState->currentRandomSeed);
+
+        CHAR16 MINER_SOL_FLAG_FILE_NAME[] = L"snapshotMinerSolutionFlag";
+        if (load(MINER_SOL_FLAG_FILE_NAME, NUMBER_OF_MINER_SOLUTION_FLAGS / 8, (unsigned char*)minerSolutionFlags) != NUMBER_OF_MINER_SOLUTION_FLAGS / 8)
+        {
+            std::cout << "Failed to load miner solution flags" << std::endl;
+            return false;
+        }
+
+        initEpochSolutionThresholds();
+
+        std::cout << "Loaded node states of epoch " << system.epoch << ", tick " << system.tick << std::endl;
+        return true;
+    }
+
+    // Load the tick data and transactions of the ticks [storageBegin, windowEnd] into the tick storage. The ticks
+    // before windowBegin have already been replayed and are only kept for transactions referring to earlier ticks.
+    bool loadTicks(unsigned int storageBegin, unsigned int windowBegin, unsigned int windowEnd)
+    {
+        PROFILE_SCOPE();
+
+        const std::string epoch = threeDigits(system.epoch);
+        const unsigned long long tickCount = windowEnd - storageBegin + 1;
+        const unsigned long long firstTickIndex = storageBegin - metaData.tickBegin;
+        ASSERT(tickCount <= MAX_NUMBER_OF_TICKS_PER_EPOCH);
+
+        ts.beginEpoch(storageBegin);
+        if (!readLargeFileRange(ticksDirectory / ("snapshotTickdata." + epoch), storedTickCount() * sizeof(TickData),
+            firstTickIndex * sizeof(TickData), tickCount * sizeof(TickData), &ts.tickData.getByTickInCurrentEpoch(storageBegin)))
+            return false;
+
+        transactionOffsets.resize(tickCount * NUMBER_OF_TRANSACTIONS_PER_TICK);
+        constexpr unsigned long long offsetsSizePerTick = NUMBER_OF_TRANSACTIONS_PER_TICK * sizeof(unsigned long long);
+        if (!readLargeFileRange(ticksDirectory / ("snapshotTickTransactionOffsets." + epoch), storedTickCount() * offsetsSizePerTick,
+            firstTickIndex * offsetsSizePerTick, tickCount * offsetsSizePerTick, transactionOffsets.data()))
+            return false;
+
+        // Only load the part of the transaction buffer used by the ticks
+        unsigned long long beginOffset = metaData.outTotalTransactionSize, endOffset = 0;
+        for (unsigned long long offset : transactionOffsets)
+        {
+            if (offset)
+            {
+                beginOffset = std::min(beginOffset, offset);
+                endOffset = std::max(endOffset, offset + MAX_TRANSACTION_SIZE);
+            }
+        }
+        endOffset = std::min(endOffset, (unsigned long long)metaData.outTotalTransactionSize);
+        if (beginOffset < endOffset)
+        {
+            transactions.resize(endOffset - beginOffset);
+            if (!readLargeFileRange(ticksDirectory / ("snapshotTickTransaction." + epoch), metaData.outTotalTransactionSize,
+                beginOffset, endOffset - beginOffset, transactions.data()))
+                return false;
+        }
+
+        // Add transactions to tick storage as the node does when receiving them
+        for (unsigned int tick = storageBegin; tick <= windowEnd; ++tick)
+        {
+            const TickData& tickData = ts.tickData.getByTickInCurrentEpoch(tick);
+            const unsigned long long* fileOffsets = &transactionOffsets[(tick - storageBegin) * NUMBER_OF_TRANSACTIONS_PER_TICK];
+            unsigned long long* tsOffsets = ts.tickTransactionOffsets.getByTickInCurrentEpoch(tick);
+            for (unsigned int transactionIndex = 0; transactionIndex < NUMBER_OF_TRANSACTIONS_PER_TICK; transactionIndex++)
+            {
+                if (!fileOffsets[transactionIndex])
+                    continue;
+
+                const Transaction* transaction = (const Transaction*)&transactions[fileOffsets[transactionIndex] - beginOffset];
+                const unsigned int transactionSize = transaction->totalSize();
+                if (fileOffsets[transactionIndex] + transactionSize > endOffset || !transaction->checkValidity() || transaction->tick != tick)
+                {
+                    std::cout << "Invalid transaction " << transactionIndex << " in tick " << tick << std::endl;
+                    return false;
+                }
+                if (ts.nextTickTransactionOffset + transactionSize > ts.tickTransactions.storageSpaceCurrentEpoch)
+                {
+                    std::cout << "Transactions of ticks " << storageBegin << " to " << windowEnd << " exceed tick storage" << std::endl;
+                    return false;
+                }
+                tsOffsets[transactionIndex] = ts.nextTickTransactionOffset;
+                copyMem(ts.tickTransactions(ts.nextTickTransactionOffset), transaction, transactionSize);
+                ts.nextTickTransactionOffset += transactionSize;
+
+                // Transactions of replayed ticks have been recorded by processTickTransaction() before
+                if (tick < windowBegin && tickData.epoch == system.epoch)
+                    ts.transactionsDigestAccess.insertTransaction(tickData.transactionDigests[transactionIndex], tick, transactionIndex);
+            }
+        }
+        return true;
+    }
+
+    // Shared digests that a quorum of computors voted for in tick, or nullptr
+    const TickVoteSharedDigests* getQuorumDigests(unsigned int tick) const
+    {
+        if (tick < firstTick || tick - firstTick >= voteDigests.size())
+            return nullptr;
+        const TickVoteSharedDigestsTable& table = voteDigests[tick - firstTick];
+        for (unsigned int i = 0; i < table.count && i < TICK_VOTE_SHARED_DIGESTS_INLINE; ++i)
+        {
+            if (table.refCounts[i] >= QUORUM)
+                return &table.entries[i];
+        }
+        if (table.overflowBlock && table.overflowBlock <= voteOverflowBlocks.size())
+        {
+            const TickVoteSharedDigestsOverflowBlock& block = voteOverflowBlocks[table.overflowBlock - 1];
+            for (unsigned int i = TICK_VOTE_SHARED_DIGESTS_INLINE; i < table.count && i < TICK_VOTE_SHARED_DIGESTS_PER_TICK; ++i)
+            {
+                if (block.refCounts[i - TICK_VOTE_SHARED_DIGESTS_INLINE] >= QUORUM)
+                    return &block.entries[i - TICK_VOTE_SHARED_DIGESTS_INLINE];
+            }
+        }
+        return nullptr;
+    }
+
+    // Compare the current digests to the prev digests voted for in tick. Returns false if a digest differs.
+    bool verifyDigests(unsigned int tick, ReplayStats& stats) const
+    {
+        const TickVoteSharedDigests* votedDigests = getQuorumDigests(tick);
+        if (!votedDigests)
+            return true;
+
+        const m256i& spectrumDigest = spectrumDigests[(SPECTRUM_CAPACITY * 2 - 1) - 1];
+        bool okay = true;
+        auto check = [&](const char* name, const std::string& replayed, const std::string& voted)
+        {
+            if (replayed != voted)
+            {
+                std::cout << name << " digest before tick " << tick << " differs: replayed " << replayed << ", voted " << voted << std::endl;
+                okay = false;
+            }
+        };
+        check("Spectrum", digestToIdentity(spectrumDigest), digestToIdentity(votedDigests->prevSpectrumDigest));
+        check("Universe", digestToIdentity(universeDigest), digestToIdentity(votedDigests->prevUniverseDigest));
+        check("Computer", digestToIdentity(computerDigest), digestToIdentity(votedDigests->prevComputerDigest));
+        check("Resource testing", std::to_string(resourceTestingDigest), std::to_string(votedDigests->prevResourceTestingDigest));
+        if (okay)
+            ++stats.verifiedTicks;
+        return okay;
+    }
+
+    // Mirror of processTick() in qubic.cpp, starting at BEGIN_TICK. INITIALIZE and BEGIN_EPOCH are not replayed,
+    // because the snapshot tick is after the first tick of the epoch. Solutions aren't pre-scanned (their scores are
+    // computed when processing the transactions) and network messages of the node aren't sent.
+    void replayTick(unsigned int tick, ReplayStats& stats)
+    {
+        PROFILE_NAMED_SCOPE("replayTick()");
+
+        system.tick = tick;
+        ++stats.ticks;
+
+        PROFILE_NAMED_SCOPE_BEGIN("processTick(): BEGIN_TICK");
+        logger.registerNewTx(system.tick, logger.SC_BEGIN_TICK_TX);
+        runContractSystemProcedures(BEGIN_TICK);
+        PROFILE_SCOPE_END();
+
+        copyMem(&nextTickData, &ts.tickData.getByTickInCurrentEpoch(system.tick), sizeof(TickData));
+        if (nextTickData.epoch == system.epoch)
+        {
+            PROFILE_NAMED_SCOPE("processTick(): process transactions");
+            const unsigned long long* tsOffsets = ts.tickTransactionOffsets.getByTickInCurrentEpoch(system.tick);
+            for (unsigned int transactionIndex = 0; transactionIndex < NUMBER_OF_TRANSACTIONS_PER_TICK; transactionIndex++)
+            {
+                if (!isZero(nextTickData.transactionDigests[transactionIndex]) && tsOffsets[transactionIndex])
+                {
+                    const Transaction* transaction = ts.tickTransactions(tsOffsets[transactionIndex]);
+                    ++stats.transactions;
+                    if (isZero(transaction->destinationPublicKey))
+                        ++stats.protocolTransactions;
+                    else if (isPublicKeyOfContract(transaction->destinationPublicKey))
+                        ++stats.contractTransactions;
+
+                    logger.registerNewTx(transaction->tick, transactionIndex);
+                    processTickTransaction(transaction, transactionIndex, 0);
+                }
+            }
+        }
+        else
+        {
+            ++stats.emptyTicks;
+        }
+
+        oracleEngine.generateSubscriptionQueries();
+        oracleEngine.processTimeouts();
+        ocEngine.processTimeouts();
+
+        const OracleNotificationData* oracleNotification = oracleEngine.getNotification();
+        while (oracleNotification)
+        {
+            PROFILE_NAMED_SCOPE("processTick(): run oracle contract notification");
+            logger.registerNewTx(system.tick, logger.SC_NOTIFICATION_TX);
+            const auto* notification = userProcedureRegistry->get(oracleNotification->procedureId);
+            ASSERT(notification && notification->contractIndex == oracleNotification->contractIndex);
+            if (notification && contractInSnapshot[notification->contractIndex])
+            {
+                QpiContextUserProcedureNotificationCall qpiContext(*notification);
+                qpiContext.call(oracleNotification->inputBuffer);
+            }
+            oracleNotification = oracleEngine.getNotification();
+        }
+
+        if (system.tick % NUMBER_OF_COMPUTORS == REPLAY_TICK_TRANSACTIONS_PUBLICATION_OFFSET - 1)
+            executionFeeReportCollector.processReports();
+
+        PROFILE_NAMED_SCOPE_BEGIN("processTick(): END_TICK");
+        logger.registerNewTx(system.tick, logger.SC_END_TICK_TX);
+        runContractSystemProcedures(END_TICK);
+        PROFILE_SCOPE_END();
+
+        PROFILE_NAMED_SCOPE_BEGIN("processTick(): anti-dust");
+        runAntiDustIfNeeded();
+        PROFILE_SCOPE_END();
+
+        PROFILE_NAMED_SCOPE_BEGIN("processTick(): get spectrum digest");
+        ACQUIRE(spectrumLock);
+        updateSpectrumDigests(system.tick);
+        RELEASE(spectrumLock);
+        PROFILE_SCOPE_END();
+
+        getUniverseDigest(universeDigest);
+        getComputerDigest(computerDigest);
+    }
+};
+
+static void printProfilingData(unsigned int tickCount)
+{
+    std::vector<ProfilingData> measurements(1024);
+    measurements.resize(gProfilingDataCollector.getMeasurements(measurements.data(), (unsigned int)measurements.size()));
+    std::sort(measurements.begin(), measurements.end(), [](const ProfilingData& a, const ProfilingData& b) { return a.runtimeSum > b.runtimeSum; });
+
+    std::cout << "Phase cycles per tick (scope, executions, cycles per tick, cycles per execution, p99 cycles per execution):" << std::endl;
+    for (const ProfilingData& m : measurements)
+    {
+        std::cout << "  " << m.name << ":" << m.line << ", " << m.numOfExec << ", " << m.runtimeSum / tickCount
+            << ", " << m.runtimeSum / m.numOfExec << ", " << m.getRuntimePercentile(990) << std::endl;
+    }
+}
+
+
+TEST(TestCoreTickReplay, ReplaySnapshot)
+{
+    const char* snapshotDirectory = getEnvironmentVariable("QUBIC_REPLAY_SNAPSHOT_DIR");
+    if (!snapshotDirectory)
+    {
+        std::cout << "QUBIC_REPLAY_SNAPSHOT_DIR not set. Skipping tick replay..." << std::endl;
+        return;
+    }
+    const char* ticksDirectory = getEnvironmentVariable("QUBIC_REPLAY_TICKS_DIR");
+    const char* tickCount = getEnvironmentVariable("QUBIC_REPLAY_TICK_COUNT");
+
+    TickReplay replay;
+    ASSERT_TRUE(replay.loadNodeStates(snapshotDirectory));
+    ASSERT_TRUE(replay.openTicks((ticksDirectory) ? ticksDirectory : snapshotDirectory, (tickCount) ? (unsigned int)std::strtoul(tickCount, nullptr, 10) : 0));
+    replay.computeInitialDigests();
+
+    gProfilingDataCollector.clear();
+    ReplayStats stats;
+    const bool digestsMatch = replay.replayTicks(stats);
+
+    std::cout << "Replayed " << stats.ticks << " ticks (" << stats.emptyTicks << " empty) with " << stats.transactions << " transactions ("
+        << stats.contractTransactions << " to contracts, " << stats.protocolTransactions << " to protocol), digests verified for " << stats.verifiedTicks << " ticks" << std::endl;
+    if (stats.ticks)
+    {
+        std::cout << "Average per tick: " << stats.cycles / stats.ticks << " cycles, " << stats.nanoseconds / stats.ticks / 1000 << " microseconds" << std::endl;
+        printProfilingData(stats.ticks);
+    }
+    replay.printDigests();
+    gProfilingDataCollector.writeToFile();
+
+    EXPECT_TRUE(digestsMatch) << "Replayed digests differ from the votes of the computors";
+    EXPECT_GT(stats.verifiedTicks, 0u) << "No tick with quorum votes to verify the replayed digests";
+}
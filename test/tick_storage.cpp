@@ -1,6 +1,7 @@
 #define NO_UEFI
 
 #include "gtest/gtest.h"
+#include "benchmark_util.h"
 
 #include "../src/public_settings.h"
 #undef MAX_NUMBER_OF_TICKS_PER_EPOCH
@@ -8,8 +9,12 @@
 #undef TICKS_TO_KEEP_FROM_PRIOR_EPOCH
 #define TICKS_TO_KEEP_FROM_PRIOR_EPOCH 5
 #include "../src/ticking/tick_storage.h"
+#include "../src/ticking/quorum_tick_cache.h"
+#include "../src/kangaroo_twelve.h"
 
+#include <atomic>
 #include <random>
+#include <thread>
 
 
 class TestTickStorage : public TickStorage
@@ -50,14 +55,20 @@ public:
         td.epoch = 1234;
         td.tick = tick;
 
-        // add computor ticks
-        Tick* computorTicks = ticks.getByTickInCurrentEpoch(tick);
+        // add computor ticks (few different shared digests per tick)
+        const unsigned int prevResourceTestingDigest = gen32();
         for (int i = 0; i < NUMBER_OF_COMPUTORS; ++i)
         {
-            computorTicks[i].epoch = 1234;
-            computorTicks[i].computorIndex = i;
-            computorTicks[i].tick = tick;
-            computorTicks[i].prevResourceTestingDigest = gen32();
+            Tick computorTick;
+            memset(&computorTick, 0, sizeof(computorTick));
+            computorTick.epoch = 1234;
+            computorTick.computorIndex = i;
+            computorTick.tick = tick;
+            computorTick.prevResourceTestingDigest = prevResourceTestingDigest + (i % 8);
+            computorTick.saltedResourceTestingDigest = gen32();
+            ticks.acquireLock(i);
+            EXPECT_TRUE(ticks.store(tickToIndexCurrentEpoch(tick), computorTick));
+            ticks.releaseLock(i);
         }
 
         // add transactions of tick
@@ -90,13 +101,17 @@ public:
         EXPECT_EQ(td.tick, tick);
 
         // check computor ticks
-        Tick* computorTicks = previousEpoch ? ticks.getByTickInPreviousEpoch(tick) : ticks.getByTickInCurrentEpoch(tick);
+        const unsigned int tickIndex = previousEpoch ? tickToIndexPreviousEpoch(tick) : tickToIndexCurrentEpoch(tick);
+        const unsigned int prevResourceTestingDigest = gen32();
         for (int i = 0; i < NUMBER_OF_COMPUTORS; ++i)
         {
-            EXPECT_EQ((int)computorTicks[i].epoch, (int)1234);
-            EXPECT_EQ((int)computorTicks[i].computorIndex, (int)i);
-            EXPECT_EQ(computorTicks[i].tick, tick);
-            EXPECT_EQ(computorTicks[i].prevResourceTestingDigest, gen32());
+            Tick computorTick;
+            EXPECT_TRUE(ticks.get(tickIndex, i, computorTick));
+            EXPECT_EQ((int)computorTick.epoch, (int)1234);
+            EXPECT_EQ((int)computorTick.computorIndex, (int)i);
+            EXPECT_EQ(computorTick.tick, tick);
+            EXPECT_EQ(computorTick.prevResourceTestingDigest, prevResourceTestingDigest + (i % 8));
+            EXPECT_EQ(computorTick.saltedResourceTestingDigest, gen32());
         }
 
         // check transactions of tick
@@ -207,3 +222,396 @@ TEST(TestCoreTickStorage, EpochTransition)
         ts.deinit();
     }
 }
+
+TEST(TestCoreTickStorage, TransactionsDigestIndex)
+{
+    TestTickStorage ts;
+    ts.init();
+    unsigned int seed = 42;
+    std::mt19937 gen32(seed);
+
+    const unsigned int firstEpochTick0 = 1000;
+    const unsigned int firstEpochTicks = 20;
+    const unsigned int secondEpochTick0 = firstEpochTick0 + firstEpochTicks;
+    ts.beginEpoch(firstEpochTick0);
+
+    // add transactions with random digests, inserting some twice
+    auto addTransactions = [&](unsigned int tick)
+    {
+        TickData& td = ts.tickData.getByTickInCurrentEpoch(tick);
+        td.epoch = 1234;
+        td.tick = tick;
+        for (unsigned int i = 0; i < 30; ++i)
+        {
+            const unsigned int transactionIndex = (i * 97) % NUMBER_OF_TRANSACTIONS_PER_TICK;
+            ts.addTransaction(tick, transactionIndex, gen32() % 100);
+            for (int j = 0; j < 4; ++j)
+                td.transactionDigests[transactionIndex].m256i_u64[j] = ((unsigned long long)gen32() << 32) | gen32();
+            EXPECT_TRUE(ts.transactionsDigestAccess.insertTransaction(td.transactionDigests[transactionIndex], tick, transactionIndex));
+            if (i % 3 == 0)
+                EXPECT_TRUE(ts.transactionsDigestAccess.insertTransaction(td.transactionDigests[transactionIndex], tick, transactionIndex));
+        }
+    };
+    auto checkTransactions = [&](unsigned int tick, bool previousEpoch)
+    {
+        const TickData& td = previousEpoch ? ts.tickData.getByTickInPreviousEpoch(tick) : ts.tickData.getByTickInCurrentEpoch(tick);
+        const unsigned long long* offsets = previousEpoch ? ts.tickTransactionOffsets.getByTickInPreviousEpoch(tick) : ts.tickTransactionOffsets.getByTickInCurrentEpoch(tick);
+        for (unsigned int i = 0; i < 30; ++i)
+        {
+            const unsigned int transactionIndex = (i * 97) % NUMBER_OF_TRANSACTIONS_PER_TICK;
+            const Transaction* transaction = ts.transactionsDigestAccess.findTransaction(td.transactionDigests[transactionIndex]);
+            if (!offsets[transactionIndex])
+            {
+                EXPECT_EQ(transaction, nullptr);
+                continue;
+            }
+            EXPECT_EQ(transaction, ts.tickTransactions(offsets[transactionIndex]));
+            EXPECT_EQ(transaction->tick, tick);
+        }
+    };
+
+    for (unsigned int tick = firstEpochTick0; tick < secondEpochTick0; ++tick)
+        addTransactions(tick);
+    for (unsigned int tick = firstEpochTick0; tick < secondEpochTick0; ++tick)
+        checkTransactions(tick, false);
+
+    // unknown digests and zero digest are not found
+    m256i unknownDigest;
+    unknownDigest.setRandomValue();
+    EXPECT_EQ(ts.transactionsDigestAccess.findTransaction(unknownDigest), nullptr);
+    EXPECT_EQ(ts.transactionsDigestAccess.findTransaction(m256i::zero()), nullptr);
+
+    // duplicates don't take additional entries, so max probe length stays short with low load
+    TickStorage::TransactionsDigestAccess::Stats stats;
+    ts.transactionsDigestAccess.getStats(stats);
+    EXPECT_EQ(stats.insertCount, firstEpochTicks * 40);
+    EXPECT_GE(stats.insertProbes, stats.insertCount);
+    EXPECT_LE(stats.maxProbeLength, 4);
+    EXPECT_EQ(stats.lookupCount, firstEpochTicks * 30 + 1); // zero digest is not looked up
+
+    // after epoch transition, kept ticks of previous epoch are still found, others not
+    const TickData tickDataOfDroppedTick = ts.tickData.getByTickInCurrentEpoch(firstEpochTick0);
+    ts.beginEpoch(secondEpochTick0);
+    for (unsigned int tick = secondEpochTick0 - TICKS_TO_KEEP_FROM_PRIOR_EPOCH; tick < secondEpochTick0; ++tick)
+        checkTransactions(tick, true);
+    EXPECT_EQ(ts.transactionsDigestAccess.findTransaction(tickDataOfDroppedTick.transactionDigests[0]), nullptr);
+
+    // transactions of new epoch are added
+    addTransactions(secondEpochTick0);
+    checkTransactions(secondEpochTick0, false);
+
+    // transaction is not found anymore if its tick data has been changed (for example invalidated)
+    TickData& td = ts.tickData.getByTickInCurrentEpoch(secondEpochTick0);
+    const m256i digest = td.transactionDigests[0];
+    EXPECT_NE(ts.transactionsDigestAccess.findTransaction(digest), nullptr);
+    td.transactionDigests[0] = m256i::zero();
+    EXPECT_EQ(ts.transactionsDigestAccess.findTransaction(digest), nullptr);
+
+    ts.deinit();
+}
+
+TEST(TestCoreTickStorage, CompactTickVotes)
+{
+    TestTickStorage ts;
+    ts.init();
+    std::mt19937_64 gen64(42);
+
+    const unsigned int tick0 = 1000;
+    ts.beginEpoch(tick0);
+    const unsigned int tickIndex = ts.tickToIndexCurrentEpoch(tick0 + 1);
+
+    auto makeVote = [&](unsigned short computorIndex, unsigned int sharedVariant)
+    {
+        Tick vote;
+        for (unsigned int i = 0; i < sizeof(vote); ++i)
+            ((unsigned char*)&vote)[i] = (unsigned char)gen64();
+        vote.computorIndex = computorIndex;
+        vote.epoch = 1234;
+        vote.tick = tick0 + 1;
+        *((unsigned long long*)&vote.millisecond) = 12345;
+        vote.prevResourceTestingDigest = 1;
+        vote.prevTransactionBodyDigest = 2;
+        vote.prevSpectrumDigest = m256i(sharedVariant, 3, 4, 5);
+        vote.prevUniverseDigest = m256i(6, 7, 8, 9);
+        vote.prevComputerDigest = m256i(10, 11, 12, 13);
+        return vote;
+    };
+    auto store = [&](const Tick& vote)
+    {
+        ts.ticks.acquireLock(vote.computorIndex);
+        const bool stored = ts.ticks.store(tickIndex, vote);
+        ts.ticks.releaseLock(vote.computorIndex);
+        return stored;
+    };
+    auto checkVotes = [&](const std::vector<Tick>& votes)
+    {
+        Tick restored;
+        for (unsigned short i = 0; i < votes.size(); ++i)
+        {
+            EXPECT_TRUE(ts.ticks.get(tickIndex, i, restored));
+            EXPECT_EQ(memcmp(&restored, &votes[i], sizeof(Tick)), 0);
+        }
+    };
+
+    // no vote stored
+    Tick restored;
+    EXPECT_FALSE(ts.ticks.get(tickIndex, 0, restored));
+
+    // all but one computors vote: QUORUM - 1 with same shared digests, each of the others with different ones
+    std::vector<Tick> votes;
+    const unsigned short lastComputor = NUMBER_OF_COMPUTORS - 1;
+    for (unsigned short i = 0; i < lastComputor; ++i)
+    {
+        votes.push_back(makeVote(i, (i < QUORUM - 1) ? 0 : 1 + i));
+        EXPECT_TRUE(store(votes.back()));
+    }
+    ts.checkStateConsistencyWithAssert();
+    checkVotes(votes);
+
+    // shared digests table is full: vote with new shared digests is rejected and no stored vote is lost
+    const Tick rejectedVote = makeVote(lastComputor, 10000);
+    EXPECT_FALSE(store(rejectedVote));
+    EXPECT_FALSE(ts.ticks.get(tickIndex, lastComputor, restored));
+    ts.checkStateConsistencyWithAssert();
+    checkVotes(votes);
+
+    // vote with shared digests of the majority is stored
+    votes.push_back(makeVote(lastComputor, 0));
+    EXPECT_TRUE(store(votes.back()));
+    ts.checkStateConsistencyWithAssert();
+    checkVotes(votes);
+
+    // replacing a vote reuses the entry that isn't referenced anymore, but doesn't replace entries of other votes
+    votes[QUORUM] = makeVote(QUORUM, 10001);
+    EXPECT_TRUE(store(votes[QUORUM]));
+    EXPECT_FALSE(store(makeVote(0, 10002)));
+    ts.checkStateConsistencyWithAssert();
+    checkVotes(votes);
+
+    // the only overflow block (with MAX_NUMBER_OF_TICKS_PER_EPOCH of test) is used by the tick above, so another tick
+    // can only store votes with up to TICK_VOTE_SHARED_DIGESTS_INLINE distinct shared digests
+    ASSERT_EQ(TICK_VOTE_SHARED_DIGESTS_OVERFLOW_BLOCKS, 1ull);
+    const unsigned int otherTickIndex = ts.tickToIndexCurrentEpoch(tick0 + 2);
+    auto storeOtherTick = [&](unsigned short computorIndex, unsigned int sharedVariant)
+    {
+        Tick vote = makeVote(computorIndex, sharedVariant);
+        vote.tick = tick0 + 2;
+        ts.ticks.acquireLock(computorIndex);
+        const bool stored = ts.ticks.store(otherTickIndex, vote);
+        ts.ticks.releaseLock(computorIndex);
+        return stored;
+    };
+    for (unsigned short i = 0; i < TICK_VOTE_SHARED_DIGESTS_INLINE; ++i)
+        EXPECT_TRUE(storeOtherTick(i, i));
+    EXPECT_FALSE(storeOtherTick(TICK_VOTE_SHARED_DIGESTS_INLINE, TICK_VOTE_SHARED_DIGESTS_INLINE));
+    EXPECT_TRUE(storeOtherTick(TICK_VOTE_SHARED_DIGESTS_INLINE, 0));
+    ts.checkStateConsistencyWithAssert();
+
+    // all votes are kept in storage of previous epoch (also the ones with shared digests in the overflow block)
+    ts.beginEpoch(tick0 + 3);
+    ts.checkStateConsistencyWithAssert();
+    const unsigned int prevTickIndex = ts.tickToIndexPreviousEpoch(tick0 + 1);
+    for (unsigned short i = 0; i < votes.size(); ++i)
+    {
+        EXPECT_TRUE(ts.ticks.get(prevTickIndex, i, restored));
+        EXPECT_EQ(memcmp(&restored, &votes[i], sizeof(Tick)), 0);
+    }
+    EXPECT_FALSE(ts.ticks.get(ts.tickToIndexCurrentEpoch(tick0 + 3), 0, restored));
+
+    ts.deinit();
+}
+
+TEST(TestCoreTickStorage, QuorumTickCache)
+{
+    TestTickStorage ts;
+    ts.init();
+    QuorumTickCache cache;
+    EXPECT_TRUE(cache.init());
+
+    const unsigned int tick0 = 1000;
+    const unsigned int tick = tick0 + 2;
+    ts.beginEpoch(tick0);
+    const unsigned int tickIndex = ts.tickToIndexCurrentEpoch(tick);
+
+    // majority shares prevResourceTestingDigest 1, others use 2 or 3, some computors haven't voted
+    auto store = [&](unsigned short computorIndex, unsigned int prevResourceTestingDigest)
+    {
+        Tick vote;
+        memset(&vote, 0, sizeof(vote));
+        vote.computorIndex = computorIndex;
+        vote.epoch = 1234;
+        vote.tick = tick;
+        vote.prevResourceTestingDigest = prevResourceTestingDigest;
+        vote.saltedResourceTestingDigest = computorIndex;
+        ts.ticks.acquireLock(computorIndex);
+        EXPECT_TRUE(ts.ticks.store(tickIndex, vote));
+        ts.ticks.releaseLock(computorIndex);
+    };
+    for (unsigned short i = 0; i < NUMBER_OF_COMPUTORS; ++i)
+    {
+        if (i % 10 == 9)
+            continue;
+        store(i, (i % 3) ? 1 : 2 + (i % 2));
+    }
+
+    auto checkEntry = [&](const QuorumTickCache::Entry& entry, unsigned int expectedVoteCount)
+    {
+        EXPECT_EQ(entry.voteCount, expectedVoteCount);
+        std::vector<bool> seen(NUMBER_OF_COMPUTORS, false);
+        for (unsigned int i = 0; i < entry.voteCount; ++i)
+        {
+            const unsigned short computorIndex = entry.order[i];
+            ASSERT_LT(computorIndex, NUMBER_OF_COMPUTORS);
+            EXPECT_FALSE(seen[computorIndex]);
+            seen[computorIndex] = true;
+            const Tick& vote = entry.votes[computorIndex];
+            EXPECT_EQ(vote.computorIndex, computorIndex);
+            EXPECT_EQ(vote.tick, tick);
+            EXPECT_EQ(vote.saltedResourceTestingDigest, computorIndex);
+            EXPECT_EQ(vote.prevResourceTestingDigest == 1, i < entry.majorityCount);
+        }
+    };
+
+    unsigned int voteCount = 0, majorityCount = 0;
+    for (unsigned short i = 0; i < NUMBER_OF_COMPUTORS; ++i)
+    {
+        voteCount += (i % 10 != 9);
+        majorityCount += (i % 10 != 9) && (i % 3);
+    }
+
+    // not final: rebuilt on each access
+    QuorumTickCache::Entry* entry = &cache.acquire(tick, tickIndex, 1234, false);
+    checkEntry(*entry, voteCount);
+    EXPECT_EQ(entry->majorityCount, majorityCount);
+    cache.release(*entry);
+    store(9, 1);
+    ++voteCount;
+    entry = &cache.acquire(tick, tickIndex, 1234, true);
+    checkEntry(*entry, voteCount);
+    cache.release(*entry);
+
+    // final: kept even if storage changes (doesn't happen in practice), until reset
+    store(19, 1);
+    entry = &cache.acquire(tick, tickIndex, 1234, true);
+    checkEntry(*entry, voteCount);
+    cache.release(*entry);
+    cache.reset();
+    entry = &cache.acquire(tick, tickIndex, 1234, true);
+    checkEntry(*entry, voteCount + 1);
+    cache.release(*entry);
+
+    // votes of other epoch are ignored
+    entry = &cache.acquire(tick, tickIndex, 1235, false);
+    checkEntry(*entry, 0);
+    cache.release(*entry);
+
+    // votes are restored into another entry while the published one is in use
+    entry = &cache.acquire(tick, tickIndex, 1234, false);
+    checkEntry(*entry, voteCount + 1);
+    QuorumTickCache::Entry* entry2 = &cache.acquire(tick, tickIndex, 1234, false);
+    EXPECT_NE(entry, entry2);
+    checkEntry(*entry2, voteCount + 1);
+    cache.release(*entry);
+    cache.release(*entry2);
+
+    // concurrent requests get the published votes while one processor restores the votes
+    std::vector<std::thread> threads;
+    std::atomic<unsigned int> responses = 0;
+    for (unsigned int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&]()
+            {
+                for (unsigned int i = 0; i < 200; ++i)
+                {
+                    QuorumTickCache::Entry& e = cache.acquire(tick, tickIndex, 1234, false);
+                    if (e.voteCount == voteCount + 1)
+                        ++responses;
+                    cache.release(e);
+                }
+            });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    EXPECT_EQ(responses, 800u);
+
+    cache.deinit();
+    ts.deinit();
+}
+
+TEST(BENCHMARK_SUITE, TickStorage)
+{
+    TestTickStorage ts;
+    ts.init();
+    const unsigned int tick0 = 1000;
+    ts.beginEpoch(tick0);
+
+    // Fill transaction storage of the epoch slot by slot (not measured) and set the digests in the tick data
+    unsigned long long numTransactions = 0;
+    for (unsigned int tick = tick0; tick < tick0 + MAX_NUMBER_OF_TICKS_PER_EPOCH; ++tick)
+    {
+        TickData& td = ts.tickData.getByTickInCurrentEpoch(tick);
+        const unsigned long long* offsets = ts.tickTransactionOffsets.getByTickInCurrentEpoch(tick);
+        for (unsigned int transactionIndex = 0; transactionIndex < NUMBER_OF_TRANSACTIONS_PER_TICK; ++transactionIndex)
+        {
+            ts.addTransaction(tick, transactionIndex, 64);
+            if (!offsets[transactionIndex])
+                break;
+            const Transaction* transaction = ts.tickTransactions.ptr(offsets[transactionIndex]);
+            KangarooTwelve(transaction, transaction->totalSize(), &td.transactionDigests[transactionIndex], sizeof(m256i));
+            ++numTransactions;
+        }
+    }
+    auto getDigest = [&](unsigned long long i) -> const m256i&
+        {
+            const unsigned int tick = tick0 + (unsigned int)(i / NUMBER_OF_TRANSACTIONS_PER_TICK);
+            return ts.tickData.getByTickInCurrentEpoch(tick).transactionDigests[i % NUMBER_OF_TRANSACTIONS_PER_TICK];
+        };
+
+    // Add the stored transactions to the digest index, like the node does when executing them
+    bool allInserted = true;
+    benchmark_util::run("TickStorage::TransactionsDigestAccess::insertTransaction", [&](unsigned long long i)
+        {
+            const unsigned int tick = tick0 + (unsigned int)(i / NUMBER_OF_TRANSACTIONS_PER_TICK);
+            allInserted &= ts.transactionsDigestAccess.insertTransaction(getDigest(i), tick, (unsigned int)(i % NUMBER_OF_TRANSACTIONS_PER_TICK));
+        }, numTransactions);
+    EXPECT_TRUE(allInserted);
+
+    bool allFound = true;
+    benchmark_util::run("TickStorage::TransactionsDigestAccess::findTransaction", [&](unsigned long long i)
+        {
+            allFound &= ts.transactionsDigestAccess.findTransaction(getDigest((i * 7919) % numTransactions)) != nullptr;
+        });
+    EXPECT_TRUE(allFound);
+
+    // Store and restore the votes of all computors tick by tick (most votes share the digests of the majority)
+    Tick vote;
+    memset(&vote, 0, sizeof(vote));
+    vote.epoch = 1234;
+    bool allStored = true;
+    const benchmark_util::Result storeResult = benchmark_util::run("TickStorage::TicksAccess::store", [&](unsigned long long i)
+        {
+            vote.computorIndex = (unsigned short)(i % NUMBER_OF_COMPUTORS);
+            vote.tick = tick0 + (unsigned int)((i / NUMBER_OF_COMPUTORS) % MAX_NUMBER_OF_TICKS_PER_EPOCH);
+            vote.prevResourceTestingDigest = (vote.computorIndex % 10 == 9) ? vote.computorIndex : 0;
+            vote.saltedResourceTestingDigest = (unsigned int)i;
+            ts.ticks.acquireLock(vote.computorIndex);
+            allStored &= ts.ticks.store(ts.tickToIndexCurrentEpoch(vote.tick), vote);
+            ts.ticks.releaseLock(vote.computorIndex);
+        });
+    EXPECT_TRUE(allStored);
+
+    const unsigned long long numVotes = std::min(storeResult.operations, (unsigned long long)MAX_NUMBER_OF_TICKS_PER_EPOCH * NUMBER_OF_COMPUTORS);
+    bool allRestored = true;
+    benchmark_util::run("TickStorage::TicksAccess::get", [&](unsigned long long i)
+        {
+            const unsigned long long voteIndex = i % numVotes;
+            const unsigned short computorIndex = (unsigned short)(voteIndex % NUMBER_OF_COMPUTORS);
+            const unsigned int tickIndex = (unsigned int)(voteIndex / NUMBER_OF_COMPUTORS);
+            ts.ticks.acquireLock(computorIndex);
+            allRestored &= ts.ticks.get(tickIndex, computorIndex, vote);
+            ts.ticks.releaseLock(computorIndex);
+        });
+    EXPECT_TRUE(allRestored);
+
+    ts.deinit();
+}
@@ -0,0 +1,154 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/ticking/tick_vote_tally.h"
+
+#include <map>
+#include <random>
+#include <vector>
+
+
+static TickVoteTally tally;
+
+// Compute summary from votes by brute force for comparison
+static void computeReference(const std::vector<Tick>& votes, unsigned short epoch, unsigned int& numberOfVotes,
+    TickVoteTally::DigestSummary& transactionDigests, TickVoteTally::DigestSummary& expectedDigests)
+{
+    std::map<std::vector<unsigned long long>, unsigned int> txCounts, expectedCounts;
+    numberOfVotes = 0;
+    transactionDigests.numberOfEmptyDigests = expectedDigests.numberOfEmptyDigests = 0;
+    transactionDigests.mostPopularCount = expectedDigests.mostPopularCount = 0;
+    for (const Tick& vote : votes)
+    {
+        if (vote.epoch != epoch)
+            continue;
+        ++numberOfVotes;
+        const m256i& tx = vote.transactionDigest;
+        const m256i& ex = vote.expectedNextTickTransactionDigest;
+        unsigned int txCount = ++txCounts[{ tx.m256i_u64[0], tx.m256i_u64[1], tx.m256i_u64[2], tx.m256i_u64[3] }];
+        unsigned int exCount = ++expectedCounts[{ ex.m256i_u64[0], ex.m256i_u64[1], ex.m256i_u64[2], ex.m256i_u64[3] }];
+        transactionDigests.mostPopularCount = std::max(transactionDigests.mostPopularCount, txCount);
+        expectedDigests.mostPopularCount = std::max(expectedDigests.mostPopularCount, exCount);
+        transactionDigests.numberOfEmptyDigests += isZero(tx);
+        expectedDigests.numberOfEmptyDigests += isZero(ex);
+    }
+}
+
+static void checkSummary(const TickVoteTally::Summary& summary, const std::vector<Tick>& votes, unsigned short epoch)
+{
+    unsigned int numberOfVotes;
+    TickVoteTally::DigestSummary transactionDigests, expectedDigests;
+    computeReference(votes, epoch, numberOfVotes, transactionDigests, expectedDigests);
+    EXPECT_EQ(summary.numberOfVotes, numberOfVotes);
+    EXPECT_EQ(summary.transactionDigests.mostPopularCount, transactionDigests.mostPopularCount);
+    EXPECT_EQ(summary.transactionDigests.numberOfEmptyDigests, transactionDigests.numberOfEmptyDigests);
+    EXPECT_EQ(summary.expectedNextTickTransactionDigests.mostPopularCount, expectedDigests.mostPopularCount);
+    EXPECT_EQ(summary.expectedNextTickTransactionDigests.numberOfEmptyDigests, expectedDigests.numberOfEmptyDigests);
+}
+
+// Compact ticks as in tick storage
+static std::vector<CompactTick> toCompact(const std::vector<Tick>& votes)
+{
+    std::vector<CompactTick> compactTicks(votes.size());
+    memset(compactTicks.data(), 0, compactTicks.size() * sizeof(CompactTick));
+    for (size_t i = 0; i < votes.size(); ++i)
+    {
+        compactTicks[i].epoch = votes[i].epoch;
+        compactTicks[i].transactionDigest = votes[i].transactionDigest;
+        compactTicks[i].expectedNextTickTransactionDigest = votes[i].expectedNextTickTransactionDigest;
+    }
+    return compactTicks;
+}
+
+static Tick makeVote(unsigned int tick, unsigned short epoch, unsigned short computorIndex, std::mt19937_64& rnd)
+{
+    Tick vote;
+    memset(&vote, 0, sizeof(vote));
+    vote.tick = tick;
+    vote.epoch = epoch;
+    vote.computorIndex = computorIndex;
+    // few different digests, including empty ones
+    unsigned long long tx = rnd() % 4, ex = rnd() % 3;
+    vote.transactionDigest = (tx) ? m256i(tx, 1, 2, 3) : m256i::zero();
+    vote.expectedNextTickTransactionDigest = (ex) ? m256i(ex, 4, 5, 6) : m256i::zero();
+    return vote;
+}
+
+TEST(TestTickVoteTally, RebuildAndAddVotes)
+{
+    constexpr unsigned short epoch = 150;
+    constexpr unsigned int tick = 1000;
+    std::mt19937_64 rnd(42);
+    std::vector<Tick> votes(NUMBER_OF_COMPUTORS);
+    memset(votes.data(), 0, votes.size() * sizeof(Tick));
+    tally.reset();
+
+    // votes already in storage before first access
+    for (unsigned short i = 0; i < NUMBER_OF_COMPUTORS; i += 3)
+        votes[i] = makeVote(tick, epoch, i, rnd);
+    TickVoteTally::Summary summary;
+    tally.getSummary(tick, epoch, toCompact(votes).data(), summary);
+    checkSummary(summary, votes, epoch);
+    const unsigned int version = summary.version;
+
+    // votes arriving later are added to the tally (each only counted once)
+    for (unsigned short i = 1; i < NUMBER_OF_COMPUTORS; i += 3)
+    {
+        votes[i] = makeVote(tick, epoch, i, rnd);
+        tally.addVote(votes[i]);
+        tally.addVote(votes[i]);
+    }
+    tally.getSummary(tick, epoch, toCompact(votes).data(), summary);
+    checkSummary(summary, votes, epoch);
+    EXPECT_GT(summary.version, version);
+
+    // votes of other epoch and other tick aren't counted
+    Tick otherVote = makeVote(tick, epoch - 1, 2, rnd);
+    tally.addVote(otherVote);
+    otherVote = makeVote(tick + 1, epoch, 2, rnd);
+    tally.addVote(otherVote);
+    tally.getSummary(tick, epoch, toCompact(votes).data(), summary);
+    checkSummary(summary, votes, epoch);
+
+    // slot taken by other tick -> tally is rebuilt from storage on next access
+    std::vector<Tick> otherVotes(NUMBER_OF_COMPUTORS);
+    memset(otherVotes.data(), 0, otherVotes.size() * sizeof(Tick));
+    TickVoteTally::Summary otherSummary;
+    tally.getSummary(tick + TickVoteTally::slotCount, epoch, toCompact(otherVotes).data(), otherSummary);
+    EXPECT_EQ(otherSummary.numberOfVotes, 0);
+    votes[2] = makeVote(tick, epoch, 2, rnd);
+    tally.addVote(votes[2]);
+    tally.getSummary(tick, epoch, toCompact(votes).data(), summary);
+    checkSummary(summary, votes, epoch);
+}
+
+TEST(TestTickVoteTally, QuorumDigest)
+{
+    constexpr unsigned short epoch = 150;
+    constexpr unsigned int tick = 2000;
+    std::vector<Tick> votes(NUMBER_OF_COMPUTORS);
+    memset(votes.data(), 0, votes.size() * sizeof(Tick));
+    tally.reset();
+
+    TickVoteTally::Summary summary;
+    tally.getSummary(tick, epoch, toCompact(votes).data(), summary);
+    EXPECT_EQ(summary.numberOfVotes, 0);
+
+    const m256i digest(1, 2, 3, 4);
+    for (unsigned short i = 0; i < QUORUM; ++i)
+    {
+        Tick& vote = votes[i];
+        vote.tick = tick;
+        vote.epoch = epoch;
+        vote.computorIndex = i;
+        vote.transactionDigest = digest;
+        tally.addVote(vote);
+    }
+    tally.getSummary(tick, epoch, toCompact(votes).data(), summary);
+    EXPECT_EQ(summary.numberOfVotes, QUORUM);
+    EXPECT_EQ(summary.transactionDigests.mostPopularCount, QUORUM);
+    EXPECT_EQ(summary.transactionDigests.mostPopularDigest, digest);
+    EXPECT_EQ(summary.transactionDigests.numberOfEmptyDigests, 0);
+    EXPECT_EQ(summary.expectedNextTickTransactionDigests.numberOfEmptyDigests, QUORUM);
+}
@@ -0,0 +1,255 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "network_core/transmit_queue.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+
+// Consume all published data of queue by copying fragments to output buffer, emulating transmit + completion
+static unsigned long long consume(TransmitQueue& queue, std::vector<unsigned char>& output, unsigned long long maxSize)
+{
+    void* fragmentBuffers[2];
+    unsigned int fragmentSizes[2];
+    unsigned int fragmentCount = queue.getFragments(maxSize, fragmentBuffers, fragmentSizes);
+    EXPECT_LE(fragmentCount, 2u);
+    unsigned long long totalSize = 0;
+    for (unsigned int i = 0; i < fragmentCount; ++i)
+    {
+        const unsigned char* data = (const unsigned char*)fragmentBuffers[i];
+        output.insert(output.end(), data, data + fragmentSizes[i]);
+        totalSize += fragmentSizes[i];
+    }
+    EXPECT_LE(totalSize, maxSize);
+    queue.release(totalSize);
+    return totalSize;
+}
+
+TEST(TestTransmitQueue, SingleThreadWrapAround)
+{
+    constexpr unsigned long long capacity = 64;
+    std::vector<unsigned char> ring(capacity);
+    TransmitQueue queue;
+    queue.init(ring.data(), capacity);
+    EXPECT_EQ(queue.size(), 0);
+
+    std::vector<unsigned char> expected, output;
+    unsigned char value = 0;
+    for (int iteration = 0; iteration < 100; ++iteration)
+    {
+        // message of 2 parts with sizes 1..40
+        unsigned char part0[24], part1[16];
+        unsigned int size0 = 1 + iteration % 24, size1 = iteration % 17;
+        if (size1 > 16)
+            size1 = 16;
+        for (unsigned int i = 0; i < size0; ++i)
+            part0[i] = value++;
+        for (unsigned int i = 0; i < size1; ++i)
+            part1[i] = value++;
+
+        EXPECT_TRUE(queue.enqueue(queue.getGeneration(), part0, size0, part1, size1));
+        expected.insert(expected.end(), part0, part0 + size0);
+        expected.insert(expected.end(), part1, part1 + size1);
+        EXPECT_EQ(queue.size(), size0 + size1);
+
+        // consume in two steps to get different positions of the ring
+        consume(queue, output, 7);
+        consume(queue, output, capacity);
+        EXPECT_EQ(queue.size(), 0);
+    }
+    EXPECT_EQ(output, expected);
+    EXPECT_FALSE(queue.hasOverflowed());
+}
+
+TEST(TestTransmitQueue, Overflow)
+{
+    constexpr unsigned long long capacity = 32;
+    std::vector<unsigned char> ring(capacity);
+    TransmitQueue queue;
+    queue.init(ring.data(), capacity);
+
+    unsigned char data[32] = { 0 };
+    EXPECT_TRUE(queue.enqueue(queue.getGeneration(), data, 20));
+    EXPECT_FALSE(queue.hasOverflowed());
+    EXPECT_FALSE(queue.enqueue(queue.getGeneration(), data, 13));
+    EXPECT_TRUE(queue.hasOverflowed());
+    EXPECT_EQ(queue.size(), 20);
+    EXPECT_TRUE(queue.enqueue(queue.getGeneration(), data, 12));
+    EXPECT_EQ(queue.size(), 32);
+
+    // reset discards data and clears overflow flag
+    queue.reset();
+    EXPECT_EQ(queue.size(), 0);
+    EXPECT_FALSE(queue.hasOverflowed());
+    EXPECT_TRUE(queue.enqueue(queue.getGeneration(), data, 32));
+}
+
+TEST(TestTransmitQueue, ResetDropsMessagesOfOldGeneration)
+{
+    constexpr unsigned long long capacity = 64;
+    std::vector<unsigned char> ring(capacity);
+    TransmitQueue queue;
+    queue.init(ring.data(), capacity);
+
+    unsigned char data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    const long oldGeneration = queue.getGeneration();
+    EXPECT_TRUE(queue.enqueue(oldGeneration, data, 8));
+
+    // producer that checked the connection before the reset must not write into the queue of the next connection
+    queue.reset();
+    EXPECT_NE(queue.getGeneration(), oldGeneration);
+    const unsigned short index = 0;
+    EXPECT_FALSE(queue.enqueue(oldGeneration, data, 8));
+    EXPECT_FALSE(queue.enqueueBatch(oldGeneration, data, 4, data, 4, &index, 1));
+    EXPECT_EQ(queue.size(), 0);
+    EXPECT_FALSE(queue.hasOverflowed());
+
+    EXPECT_TRUE(queue.enqueue(queue.getGeneration(), data, 8));
+    EXPECT_EQ(queue.size(), 8);
+}
+
+TEST(TestTransmitQueue, ResetWithConcurrentProducers)
+{
+    constexpr unsigned long long capacity = 1 << 10;
+    std::vector<unsigned char> ring(capacity);
+    TransmitQueue queue;
+    queue.init(ring.data(), capacity);
+
+    // producers tag each 8-byte message with the generation they read before enqueuing
+    volatile bool stop = false;
+    auto producer = [&queue, &stop]()
+    {
+        while (!stop)
+        {
+            const long generation = queue.getGeneration();
+            unsigned long long message = generation;
+            queue.enqueue(generation, &message, sizeof(message));
+            std::this_thread::yield();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i)
+        threads.emplace_back(producer);
+
+    // after each reset, the queue must only contain messages of the current generation
+    for (int round = 0; round < 2000; ++round)
+    {
+        queue.reset();
+        std::vector<unsigned char> stream;
+        consume(queue, stream, capacity);
+        const long generation = queue.getGeneration();
+        ASSERT_EQ(stream.size() % 8, 0u);
+        for (size_t pos = 0; pos < stream.size(); pos += 8)
+        {
+            unsigned long long message;
+            memcpy(&message, &stream[pos], 8);
+            EXPECT_EQ(message, (unsigned long long)generation);
+        }
+    }
+
+    stop = true;
+    for (auto& thread : threads)
+        thread.join();
+}
+
+TEST(TestTransmitQueue, MultipleProducers)
+{
+    constexpr unsigned long long capacity = 1 << 12;
+    constexpr unsigned int producerCount = 4;
+    constexpr unsigned int messagesPerProducer = 5000;
+    std::vector<unsigned char> ring(capacity);
+    TransmitQueue queue;
+    queue.init(ring.data(), capacity);
+
+    // message: producer ID (1 byte), message counter (4 bytes), payload size (1 byte), payload filled with counter's low byte
+    auto producer = [&queue](unsigned char producerId)
+    {
+        unsigned char message[6 + 255];
+        for (unsigned int counter = 0; counter < messagesPerProducer; ++counter)
+        {
+            const unsigned char payloadSize = (unsigned char)((counter * 37 + producerId) % 256);
+            message[0] = producerId;
+            memcpy(message + 1, &counter, 4);
+            message[5] = payloadSize;
+            memset(message + 6, counter & 0xff, payloadSize);
+            while (!queue.enqueue(queue.getGeneration(), message, 6, message + 6, payloadSize))
+                std::this_thread::yield();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned char i = 0; i < producerCount; ++i)
+        threads.emplace_back(producer, i);
+
+    // consume and parse messages
+    std::vector<unsigned char> stream;
+    unsigned int nextCounter[producerCount] = { 0 };
+    unsigned long long parsePos = 0;
+    unsigned int receivedMessages = 0;
+    while (receivedMessages < producerCount * messagesPerProducer)
+    {
+        consume(queue, stream, 1000);
+        while (stream.size() - parsePos >= 6 && stream.size() - parsePos >= 6ull + stream[parsePos + 5])
+        {
+            const unsigned char producerId = stream[parsePos];
+            unsigned int counter;
+            memcpy(&counter, &stream[parsePos + 1], 4);
+            const unsigned char payloadSize = stream[parsePos + 5];
+            ASSERT_LT(producerId, producerCount);
+            EXPECT_EQ(counter, nextCounter[producerId]);
+            EXPECT_EQ(payloadSize, (unsigned char)((counter * 37 + producerId) % 256));
+            for (unsigned int i = 0; i < payloadSize; ++i)
+                EXPECT_EQ(stream[parsePos + 6 + i], counter & 0xff);
+            nextCounter[producerId] = counter + 1;
+            parsePos += 6ull + payloadSize;
+            ++receivedMessages;
+        }
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(parsePos, stream.size());
+    EXPECT_EQ(queue.size(), 0);
+}
+
+TEST(TestTransmitQueue, EnqueueBatch)
+{
+    constexpr unsigned long long capacity = 256;
+    std::vector<unsigned char> ring(capacity);
+    TransmitQueue queue;
+    queue.init(ring.data(), capacity);
+
+    // 4 payloads of 10 bytes, header of 3 bytes
+    unsigned char payloads[4][10];
+    for (unsigned int i = 0; i < 4; ++i)
+        memset(payloads[i], 0x10 + i, sizeof(payloads[i]));
+    const unsigned char header[3] = { 1, 2, 3 };
+    const unsigned short indices[5] = { 3, 0, 2, 2, 1 };
+
+    std::vector<unsigned char> expected, output;
+    for (int iteration = 0; iteration < 20; ++iteration)
+    {
+        const unsigned int count = 1 + iteration % 5;
+        EXPECT_TRUE(queue.enqueueBatch(queue.getGeneration(), header, sizeof(header), payloads, sizeof(payloads[0]), indices, count));
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            expected.insert(expected.end(), header, header + sizeof(header));
+            expected.insert(expected.end(), payloads[indices[i]], payloads[indices[i]] + sizeof(payloads[0]));
+        }
+        EXPECT_EQ(queue.size(), count * 13ull);
+
+        // consume in two steps to get different positions of the ring
+        consume(queue, output, 11);
+        consume(queue, output, capacity);
+    }
+    EXPECT_EQ(output, expected);
+
+    // all or nothing
+    EXPECT_FALSE(queue.enqueueBatch(queue.getGeneration(), header, sizeof(header), payloads, sizeof(payloads[0]), indices, 20));
+    EXPECT_TRUE(queue.hasOverflowed());
+    EXPECT_EQ(queue.size(), 0);
+}
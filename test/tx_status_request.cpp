@@ -13,9 +13,14 @@ void enqueueResponse(Peer* peer, unsigned int dataSize, unsigned char type, unsi
 #define TICKS_TO_KEEP_FROM_PRIOR_EPOCH 32
 #undef ADDON_TX_STATUS_REQUEST
 #define ADDON_TX_STATUS_REQUEST 1
+#undef ADDON_TX_STATUS_INDEX
+#define ADDON_TX_STATUS_INDEX 1
+#undef TX_STATUS_INDEX_CAPACITY
+#define TX_STATUS_INDEX_CAPACITY (1ULL << 20)
 #include "../src/addons/tx_status_request.h"
 
 #include <random>
+#include <vector>
 
 unsigned int numberOfTransactions = 0;
 
@@ -52,9 +57,24 @@ struct {
 
 RespondTxStatus responseMessage;
 
+struct {
+    RequestResponseHeader header;
+    RequestTxStatusBatch payload;
+} batchRequestMessage;
+
+RespondTxStatusBatch batchResponseMessage;
+
 
 static void enqueueResponse(Peer* peer, unsigned int dataSize, unsigned char type, unsigned int dejavu, const void* data)
 {
+    if (type == RespondTxStatusBatch::type())
+    {
+        EXPECT_EQ(dejavu, batchRequestMessage.header.dejavu());
+        EXPECT_EQ(dataSize, sizeof(RespondTxStatusBatch));
+        copyMem(&batchResponseMessage, data, sizeof(RespondTxStatusBatch));
+        return;
+    }
+
     const RespondTxStatus* txStatus = (const RespondTxStatus*)data;
 
     EXPECT_EQ(type, RespondTxStatus::type());
@@ -134,6 +154,9 @@ TEST(TestCoreTxStatusRequestAddOn, EpochTransition)
     // use pseudo-random sequence
     std::mt19937_64 gen64(seed);
 
+    initFilesystem();
+    registerAsynFileIO(NULL);
+
     // 5x test with running 2 epoch transitions
     for (int testIdx = 0; testIdx < 20; ++testIdx)
     {
@@ -222,3 +245,184 @@ TEST(TestCoreTxStatusRequestAddOn, EpochTransition)
     }
 }
 
+
+// Send batch request for digests and check that the response matches the expected ticks (0 = unknown) and money flows
+static void checkBatch(const std::vector<m256i>& digests, const std::vector<unsigned int>& expectedTicks, const std::vector<unsigned char>& expectedMoneyFlew)
+{
+    batchRequestMessage.payload.digestCount = (unsigned int)digests.size();
+    for (unsigned int i = 0; i < digests.size(); ++i)
+        batchRequestMessage.payload.digests[i] = digests[i];
+    const unsigned int messageSize = sizeof(RequestResponseHeader) + batchRequestMessage.payload.size();
+    batchRequestMessage.header.checkAndSetSize(messageSize);
+    batchRequestMessage.header.setType(RequestTxStatusBatch::type());
+    batchRequestMessage.header.setDejavu(messageSize);
+
+    setMem(&batchResponseMessage, sizeof(batchResponseMessage), 0xff);
+    processRequestTxStatusBatch(nullptr, &batchRequestMessage.header);
+
+    EXPECT_EQ(batchResponseMessage.currentTickOfNode, system.tick);
+    ASSERT_EQ(batchResponseMessage.digestCount, digests.size());
+    for (unsigned int i = 0; i < digests.size(); ++i)
+    {
+        EXPECT_EQ(batchResponseMessage.ticks[i], expectedTicks[i]);
+        unsigned char receivedMoneyFlow = (batchResponseMessage.moneyFlew[i / 8] >> (i % 8)) & 1;
+        EXPECT_EQ(receivedMoneyFlow, expectedMoneyFlew[i]);
+    }
+}
+
+TEST(TestCoreTxStatusRequestAddOn, BatchRequest)
+{
+    initFilesystem();
+    registerAsynFileIO(NULL);
+    initTxStatusRequestAddOn();
+
+    std::mt19937_64 gen64(1234);
+    const unsigned int firstEpochTick0 = 1000;
+    const unsigned int secondEpochTick0 = firstEpochTick0 + MAX_NUMBER_OF_TICKS_PER_EPOCH;
+
+    // first epoch: the last TICKS_TO_KEEP_FROM_PRIOR_EPOCH ticks stay available after the transition
+    numberOfTransactions = 0;
+    system.initialTick = firstEpochTick0;
+    beginEpochTxStatusRequestAddOn(firstEpochTick0);
+    std::vector<m256i> digests;
+    std::vector<unsigned int> ticks;
+    std::vector<unsigned char> moneyFlews;
+    for (unsigned int tick = firstEpochTick0; tick < secondEpochTick0; ++tick)
+    {
+        system.tick = tick;
+        txStatusData.tickTxIndexStart[tick - system.initialTick] = numberOfTransactions;
+        for (unsigned int i = 0; i < 100; ++i)
+        {
+            m256i digest(gen64(), gen64(), gen64(), gen64());
+            const unsigned char moneyFlew = gen64() % 2;
+            ++numberOfTransactions;
+            EXPECT_TRUE(saveConfirmedTx(numberOfTransactions - 1, moneyFlew, tick, digest));
+            digests.push_back(digest);
+            ticks.push_back(tick);
+            moneyFlews.push_back(moneyFlew);
+        }
+    }
+    system.tick = secondEpochTick0;
+
+    // query known and unknown digests in random order
+    std::vector<m256i> requestDigests;
+    std::vector<unsigned int> expectedTicks;
+    std::vector<unsigned char> expectedMoneyFlew;
+    for (unsigned int i = 0; i < RequestTxStatusBatch::maxDigests; ++i)
+    {
+        if (i % 4 == 3)
+        {
+            requestDigests.push_back(m256i(gen64(), gen64(), gen64(), gen64()));
+            expectedTicks.push_back(0);
+            expectedMoneyFlew.push_back(0);
+        }
+        else
+        {
+            const unsigned int txIdx = gen64() % digests.size();
+            requestDigests.push_back(digests[txIdx]);
+            expectedTicks.push_back(ticks[txIdx]);
+            expectedMoneyFlew.push_back(moneyFlews[txIdx]);
+        }
+    }
+    checkBatch(requestDigests, expectedTicks, expectedMoneyFlew);
+
+    // after epoch transition, only TX's of kept ticks are known
+    numberOfTransactions = 0;
+    system.initialTick = secondEpochTick0;
+    beginEpochTxStatusRequestAddOn(secondEpochTick0);
+    for (unsigned int i = 0; i < requestDigests.size(); ++i)
+    {
+        if (expectedTicks[i] < secondEpochTick0 - TICKS_TO_KEEP_FROM_PRIOR_EPOCH)
+        {
+            expectedTicks[i] = 0;
+            expectedMoneyFlew[i] = 0;
+        }
+    }
+    checkBatch(requestDigests, expectedTicks, expectedMoneyFlew);
+
+    // invalid requests are ignored
+    batchRequestMessage.payload.digestCount = RequestTxStatusBatch::maxDigests + 1;
+    batchRequestMessage.header.checkAndSetSize(sizeof(batchRequestMessage));
+    batchResponseMessage.digestCount = 0;
+    processRequestTxStatusBatch(nullptr, &batchRequestMessage.header);
+    EXPECT_EQ(batchResponseMessage.digestCount, 0);
+    batchRequestMessage.payload.digestCount = 2;
+    batchRequestMessage.header.checkAndSetSize(sizeof(RequestResponseHeader) + batchRequestMessage.payload.size() - 1);
+    processRequestTxStatusBatch(nullptr, &batchRequestMessage.header);
+    EXPECT_EQ(batchResponseMessage.digestCount, 0);
+
+    deinitTxStatusRequestAddOn();
+}
+
+TEST(TestCoreTxStatusRequestAddOn, BatchRequestDigestCollisions)
+{
+    initFilesystem();
+    registerAsynFileIO(NULL);
+    initTxStatusRequestAddOn();
+
+    const unsigned int tick0 = 1000;
+    numberOfTransactions = 0;
+    system.initialTick = tick0;
+    system.tick = tick0;
+    beginEpochTxStatusRequestAddOn(tick0);
+    txStatusData.tickTxIndexStart[0] = 0;
+
+    // digests that only differ in the last 64 bits map to the same slot and share the first 64 bits
+    std::vector<m256i> digests;
+    std::vector<unsigned int> expectedTicks;
+    std::vector<unsigned char> expectedMoneyFlew;
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        digests.push_back(m256i(0x1234, 0x5678, 0, i));
+        if (i < 6)
+        {
+            ++numberOfTransactions;
+            EXPECT_TRUE(saveConfirmedTx(numberOfTransactions - 1, i % 2, tick0, digests[i]));
+            expectedTicks.push_back(tick0);
+            expectedMoneyFlew.push_back(i % 2);
+        }
+        else
+        {
+            // not stored
+            expectedTicks.push_back(0);
+            expectedMoneyFlew.push_back(0);
+        }
+    }
+    system.tick = tick0 + 1;
+    checkBatch(digests, expectedTicks, expectedMoneyFlew);
+    EXPECT_EQ(txStatusData.confirmedTxIndexEntries, 6);
+    EXPECT_EQ(txStatusData.confirmedTxIndexDroppedTxs, 0);
+
+    // TX's that don't fit into the full index are counted (and still stored)
+    txStatusData.confirmedTxIndexEntries = confirmedTxIndexMaxEntries;
+    ++numberOfTransactions;
+    EXPECT_TRUE(saveConfirmedTx(numberOfTransactions - 1, true, tick0 + 1, digests[6]));
+    EXPECT_EQ(txStatusData.confirmedTxIndexDroppedTxs, 1);
+    checkBatch(digests, expectedTicks, expectedMoneyFlew);
+
+    // after an epoch transition without kept ticks, the entries of the previous epoch are unused and get reused
+    const unsigned int tick1 = tick0 + 2 * MAX_NUMBER_OF_TICKS_PER_EPOCH;
+    numberOfTransactions = 0;
+    system.initialTick = tick1;
+    system.tick = tick1;
+    beginEpochTxStatusRequestAddOn(tick1);
+    txStatusData.tickTxIndexStart[0] = 0;
+    EXPECT_EQ(txStatusData.confirmedTxIndexEntries, 0);
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        expectedTicks[i] = 0;
+        expectedMoneyFlew[i] = 0;
+    }
+    ++numberOfTransactions;
+    EXPECT_TRUE(saveConfirmedTx(numberOfTransactions - 1, true, tick1, digests[7]));
+    expectedTicks[7] = tick1;
+    expectedMoneyFlew[7] = 1;
+    ++numberOfTransactions;
+    EXPECT_TRUE(saveConfirmedTx(numberOfTransactions - 1, false, tick1, digests[2]));
+    expectedTicks[2] = tick1;
+    system.tick = tick1 + 1;
+    checkBatch(digests, expectedTicks, expectedMoneyFlew);
+    EXPECT_EQ(txStatusData.confirmedTxIndexEntries, 2);
+
+    deinitTxStatusRequestAddOn();
+}
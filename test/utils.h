@@ -5,6 +5,8 @@
 #include <iomanip>
 #include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <vector>
 
 namespace test_utils
 {
@@ -4,6 +4,7 @@
 
 #include "../src/public_settings.h"
 #include "../src/vote_counter.h"
+#include "benchmark_util.h"
 
 #include <random>
 
@@ -19,6 +20,14 @@ public:
     {
         update10Bit(data, idx, value);
     }
+    static void testPackVoteCounts(const unsigned int* counts, unsigned char* votePacket)
+    {
+        packVoteCounts(counts, votePacket);
+    }
+    static void testUnpackVoteCounts(const unsigned char* votePacket, unsigned int* counts)
+    {
+        unpackVoteCounts(votePacket, counts);
+    }
 };
 
 TestVoteCounter tvc;
@@ -110,7 +119,7 @@ TEST(TestCoreVoteCounter, AddGetVotes) {
         if (tvc.getVoteCount(i) != data_u32[i])
         {
             isMatched = false;
-            printf("[FAILED] comp %d: %llu vs %lu\n", i, tvc.getVoteCount(i), data_u32[i]);
+            printf("[FAILED] comp %d: %llu vs %u\n", i, tvc.getVoteCount(i), data_u32[i]);
             break;
         }
     }
@@ -169,4 +178,142 @@ TEST(TestCoreVoteCounter, RegisterNewCompressVotes) {
         EXPECT_TRUE(isMatched);
         //printf("[PASSED] tick %u\n", tick);
     }
-}
\ No newline at end of file
+}
+
+TEST(TestCoreVoteCounter, PackUnpackMatchesScalar) {
+    std::mt19937 gen(42);
+    unsigned char packet[848], scalarPacket[848];
+    unsigned int counts[676], unpacked[676];
+    for (int round = 0; round < 64; round++)
+    {
+        const unsigned int maxCount = (round & 1) ? 1024 : 677;
+        for (int i = 0; i < 676; i++)
+        {
+            counts[i] = gen() % maxCount;
+        }
+        // bytes after the packed counts must stay untouched
+        for (int i = 0; i < 848; i++)
+        {
+            packet[i] = scalarPacket[i] = (unsigned char)gen();
+        }
+        for (int i = 0; i < 676; i++)
+        {
+            tvc.testUpdate10Bit(scalarPacket, i, counts[i]);
+        }
+        TestVoteCounter::testPackVoteCounts(counts, packet);
+        EXPECT_EQ(memcmp(packet, scalarPacket, sizeof(packet)), 0);
+
+        TestVoteCounter::testUnpackVoteCounts(scalarPacket, unpacked);
+        for (int i = 0; i < 676; i++)
+        {
+            EXPECT_EQ(unpacked[i], tvc.testExtract10Bit(scalarPacket, i));
+            EXPECT_EQ(unpacked[i], counts[i]);
+        }
+    }
+}
+
+// compressNewVotesPacket() and addVotes() of the scalar code before vectorization
+static void scalarCompressNewVotesPacket(const unsigned int (*votes)[676], unsigned int fromTick, unsigned int toTick, unsigned int computorIdx, unsigned char* votePacket)
+{
+    unsigned int counts[676] = { 0 };
+    for (unsigned int i = fromTick; i < toTick; i++)
+    {
+        unsigned int slotId = i % (676 * 2);
+        for (int j = 0; j < 676; j++)
+        {
+            if (votes[slotId][j] == i)
+            {
+                counts[j]++;
+            }
+        }
+    }
+    counts[computorIdx] = 0;
+    for (unsigned int i = 0; i < 676; i++)
+    {
+        tvc.testUpdate10Bit(votePacket, i, counts[i]);
+    }
+}
+
+TEST(TestCoreVoteCounter, CompressAddVotesMatchesScalar) {
+    static unsigned int votes[676 * 2][676];
+    static unsigned long long accumulated[676];
+    std::mt19937 gen(7);
+    setMem(votes, sizeof(votes), 0);
+    setMem(accumulated, sizeof(accumulated), 0);
+    tvc.init();
+    for (unsigned int tick = 1000; tick < 1000 + 3 * 676; tick++)
+    {
+        const unsigned int voteProbability = 60 + gen() % 41;
+        for (unsigned int comp = 0; comp < 676; comp++)
+        {
+            if (gen() % 100 < voteProbability)
+            {
+                tvc.registerNewVote(tick, comp);
+                votes[tick % (676 * 2)][comp] = tick;
+            }
+        }
+        if (tick < 1000 + 676)
+            continue;
+
+        const unsigned int comp = gen() % 676;
+        unsigned char packet[848], scalarPacket[848];
+        for (int i = 0; i < 848; i++)
+        {
+            packet[i] = scalarPacket[i] = (unsigned char)gen();
+        }
+        tvc.compressNewVotesPacket(tick - 675, tick + 1, comp, packet);
+        scalarCompressNewVotesPacket(votes, tick - 675, tick + 1, comp, scalarPacket);
+        ASSERT_EQ(memcmp(packet, scalarPacket, sizeof(packet)), 0);
+
+        const bool valid = tvc.validateNewVotesPacket(packet, comp);
+        tvc.addVotes(packet, comp);
+        if (valid)
+        {
+            for (int i = 0; i < 676; i++)
+            {
+                accumulated[i] += tvc.testExtract10Bit(scalarPacket, i);
+            }
+        }
+    }
+    for (int i = 0; i < 676; i++)
+    {
+        EXPECT_EQ(tvc.getVoteCount(i), accumulated[i]);
+    }
+}
+
+TEST(BENCHMARK_SUITE, VoteCounterCompressNewVotesPacket)
+{
+    // run by the tick processor for each own computor on every tick
+    static TestVoteCounter vc;
+    vc.init();
+    for (unsigned int tick = 1000; tick < 1000 + 676; tick++)
+    {
+        for (unsigned int comp = 0; comp < 676; comp++)
+        {
+            if ((tick + comp) % 5)
+                vc.registerNewVote(tick, comp);
+        }
+    }
+    unsigned char packet[848] = { 0 };
+    benchmark_util::run("VoteCounter::compressNewVotesPacket", [&](unsigned long long i)
+        {
+            vc.compressNewVotesPacket(1000, 1000 + 676, (unsigned int)(i % 676), packet);
+        });
+}
+
+TEST(BENCHMARK_SUITE, VoteCounterAddVotes)
+{
+    // run for the vote counter transaction of every tick
+    static TestVoteCounter vc;
+    vc.init();
+    unsigned char packet[848] = { 0 };
+    for (int i = 0; i < 676; i++)
+    {
+        vc.testUpdate10Bit(packet, i, 451 + i % 200);
+    }
+    vc.testUpdate10Bit(packet, 0, 0);
+    benchmark_util::run("VoteCounter::addVotes", [&](unsigned long long)
+        {
+            vc.addVotes(packet, 0);
+        });
+}